@@ -0,0 +1,276 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Benchmark of the savestate hot path.
+ *
+ * Checkpoint::writeAllAreas()/readAllAreas() only run inside the injected
+ * game process, from a signal handler, with the whole thread suspension
+ * machinery around them. This harness reproduces their per-page work on a
+ * synthetic address space instead: scanning /proc/self/pagemap for present
+ * and soft-dirty bits, detecting zero pages, dumping modified pages to a
+ * file or memfd, clearing soft-dirty bits through /proc/self/clear_refs,
+ * and reading the dump back in place. The kernel-side costs measured here
+ * are the ones dominating the real checkpoint path, so a regression in one
+ * of them shows up with the same magnitude.
+ *
+ * Usage: savestatebench [--size-mb N] [--dirty-percent N] [--iterations N]
+ *                       [--in-ram] [--incremental]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <ctime>
+#include <algorithm>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+static size_t size_mb = 512;
+static int dirty_percent = 10;
+static int iterations = 50;
+static bool in_ram = false;
+static bool incremental = false;
+
+static const size_t PAGE_SIZE = 4096;
+
+static double elapsedMs(const struct timespec& start, const struct timespec& end)
+{
+    return (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1000000.0;
+}
+
+static void clearSoftDirty()
+{
+    int fd = open("/proc/self/clear_refs", O_WRONLY);
+    if (fd == -1) {
+        fprintf(stderr, "Could not open /proc/self/clear_refs\n");
+        exit(1);
+    }
+    if (write(fd, "4\n", 2) != 2) {
+        fprintf(stderr, "Could not clear soft-dirty bits\n");
+        exit(1);
+    }
+    close(fd);
+}
+
+/* Touch a spread-out fraction of the arena pages, like a game frame would */
+static void dirtyPages(char* arena, size_t num_pages, int percent)
+{
+    if (percent <= 0)
+        return;
+    size_t stride = 100 / percent;
+    if (stride == 0)
+        stride = 1;
+    for (size_t i = 0; i < num_pages; i += stride) {
+        arena[i * PAGE_SIZE] = static_cast<char>(i);
+    }
+}
+
+static bool isZeroPage(const char* page)
+{
+    const uint64_t* w = reinterpret_cast<const uint64_t*>(page);
+    for (size_t i = 0; i < PAGE_SIZE / 8; i++) {
+        if (w[i])
+            return false;
+    }
+    return true;
+}
+
+/* One savestate: scan the pagemap and dump the relevant pages, like
+ * writeAnArea() does. Returns the number of bytes written. */
+static size_t saveArena(char* arena, size_t num_pages, int pagemap_fd, int state_fd)
+{
+    static std::vector<uint64_t> pagemap;
+    pagemap.resize(num_pages);
+
+    lseek(pagemap_fd, (reinterpret_cast<uintptr_t>(arena) / PAGE_SIZE) * 8, SEEK_SET);
+    size_t toread = num_pages * 8;
+    char* dest = reinterpret_cast<char*>(pagemap.data());
+    while (toread > 0) {
+        ssize_t ret = read(pagemap_fd, dest, toread);
+        if (ret <= 0) {
+            fprintf(stderr, "Could not read /proc/self/pagemap\n");
+            exit(1);
+        }
+        dest += ret;
+        toread -= ret;
+    }
+
+    lseek(state_fd, 0, SEEK_SET);
+    if (ftruncate(state_fd, 0) < 0) {
+        fprintf(stderr, "Could not truncate the state file\n");
+        exit(1);
+    }
+
+    size_t written = 0;
+    for (size_t i = 0; i < num_pages; i++) {
+        bool page_present = pagemap[i] & (0x1ull << 63);
+        bool soft_dirty = pagemap[i] & (0x1ull << 55);
+
+        if (!page_present)
+            continue;
+        if (incremental && !soft_dirty)
+            continue;
+
+        char* page = arena + i * PAGE_SIZE;
+        if (isZeroPage(page))
+            continue;
+
+        if (write(state_fd, page, PAGE_SIZE) != static_cast<ssize_t>(PAGE_SIZE)) {
+            fprintf(stderr, "Could not write a page to the state file\n");
+            exit(1);
+        }
+        written += PAGE_SIZE;
+    }
+
+    if (incremental)
+        clearSoftDirty();
+
+    return written;
+}
+
+/* One state loading: read the dump back over the arena */
+static void loadArena(char* arena, int state_fd, size_t state_size)
+{
+    lseek(state_fd, 0, SEEK_SET);
+    size_t toread = state_size;
+    char* addr = arena;
+    while (toread > 0) {
+        ssize_t ret = read(state_fd, addr, std::min(toread, size_t(1024*1024)));
+        if (ret <= 0) {
+            fprintf(stderr, "Could not read the state file\n");
+            exit(1);
+        }
+        addr += ret;
+        toread -= ret;
+    }
+}
+
+static double percentile(std::vector<double>& values, int pct)
+{
+    std::sort(values.begin(), values.end());
+    size_t idx = (values.size() * pct) / 100;
+    if (idx >= values.size())
+        idx = values.size() - 1;
+    return values[idx];
+}
+
+int main(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--size-mb") && (i+1 < argc))
+            size_mb = atoll(argv[++i]);
+        else if (!strcmp(argv[i], "--dirty-percent") && (i+1 < argc))
+            dirty_percent = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--iterations") && (i+1 < argc))
+            iterations = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--in-ram"))
+            in_ram = true;
+        else if (!strcmp(argv[i], "--incremental"))
+            incremental = true;
+        else {
+            fprintf(stderr, "Usage: %s [--size-mb N] [--dirty-percent N] [--iterations N] [--in-ram] [--incremental]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    size_t arena_size = size_mb * 1024 * 1024;
+    size_t num_pages = arena_size / PAGE_SIZE;
+
+    char* arena = static_cast<char*>(mmap(nullptr, arena_size, PROT_READ | PROT_WRITE,
+                                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (arena == MAP_FAILED) {
+        fprintf(stderr, "Could not map a %zu MB arena\n", size_mb);
+        return 1;
+    }
+
+    /* Fault in and fill the arena with non-zero content */
+    memset(arena, 0x5a, arena_size);
+
+    int pagemap_fd = open("/proc/self/pagemap", O_RDONLY);
+    if (pagemap_fd == -1) {
+        fprintf(stderr, "Could not open /proc/self/pagemap\n");
+        return 1;
+    }
+
+    int state_fd;
+    if (in_ram) {
+        state_fd = syscall(SYS_memfd_create, "savestatebench", 0);
+    }
+    else {
+        char path[] = "/tmp/savestatebench-XXXXXX";
+        state_fd = mkstemp(path);
+        unlink(path);
+    }
+    if (state_fd == -1) {
+        fprintf(stderr, "Could not create the state file\n");
+        return 1;
+    }
+
+    if (incremental)
+        clearSoftDirty();
+
+    std::vector<double> save_times, load_times;
+    size_t total_written = 0;
+    size_t last_written = 0;
+    struct timespec start, end;
+
+    for (int it = 0; it < iterations; it++) {
+        dirtyPages(arena, num_pages, dirty_percent);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        last_written = saveArena(arena, num_pages, pagemap_fd, state_fd);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        save_times.push_back(elapsedMs(start, end));
+        total_written += last_written;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        loadArena(arena, state_fd, last_written);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        load_times.push_back(elapsedMs(start, end));
+    }
+
+    double save_total = 0, load_total = 0;
+    for (double t : save_times) save_total += t;
+    for (double t : load_times) load_total += t;
+
+    printf("config: size %zu MB, dirty %d%%, %d iterations, %s, %s\n",
+           size_mb, dirty_percent, iterations,
+           in_ram ? "in ram" : "on disk",
+           incremental ? "incremental" : "full");
+    printf("save: avg %.2f ms, p99 %.2f ms, %.0f MB/s scanned\n",
+           save_total / iterations, percentile(save_times, 99),
+           (size_mb * iterations) / (save_total / 1000.0));
+    printf("load: avg %.2f ms, p99 %.2f ms, %.0f MB/s read\n",
+           load_total / iterations, percentile(load_times, 99),
+           (total_written / (1024.0*1024.0)) / (load_total / 1000.0));
+    printf("bytes written: %zu MB total, %zu MB last state\n",
+           total_written / (1024*1024), last_written / (1024*1024));
+
+    if (incremental && (total_written == 0)) {
+        fprintf(stderr, "Warning: no page was seen as soft-dirty, the kernel probably lacks CONFIG_MEM_SOFT_DIRTY\n");
+    }
+
+    close(pagemap_fd);
+    close(state_fd);
+    return 0;
+}
@@ -0,0 +1,151 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "AllocTrace.h"
+#include "../shared/AllocStats.h"
+#include "../shared/messages.h"
+#include "../shared/sockethelpers.h"
+#include "logging.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+
+namespace libtas {
+
+/* One allocation out of SAMPLE_RATE is aggregated. Must be a power of two */
+static const unsigned int SAMPLE_RATE = 64;
+
+/* Interval between two flushes to the program */
+static const uint64_t flush_interval_ns = 1000000000;
+
+/* Callsite table. Open addressing with linear probing, sized well above
+ * the callsite count of typical games so probe chains stay short. Slots
+ * are claimed by compare-and-swap on the address, then only touched with
+ * relaxed atomic adds, so recording never takes a lock. The table is
+ * never shrunk: callsites are stable across frames, and bucket counters
+ * are simply reset at each flush. */
+static const int TABLE_SIZE = 512;
+static std::atomic<uintptr_t> site_addr[TABLE_SIZE];
+static std::atomic<uint64_t> site_count[TABLE_SIZE];
+static std::atomic<uint64_t> site_bytes[TABLE_SIZE];
+
+/* Sampled totals, including allocations dropped on a full table */
+static std::atomic<uint64_t> total_count(0);
+static std::atomic<uint64_t> total_bytes(0);
+
+/* Timestamp of the last flush */
+static struct timespec interval_start_time = {0, 0};
+
+void AllocTrace::record(void *caller, size_t size)
+{
+    if (!shared_config.alloc_profiling)
+        return;
+
+    /* Only aggregate one call out of SAMPLE_RATE */
+    static thread_local unsigned int calls = 0;
+    if ((calls++ & (SAMPLE_RATE - 1)) != 0)
+        return;
+
+    total_count.fetch_add(1, std::memory_order_relaxed);
+    total_bytes.fetch_add(size, std::memory_order_relaxed);
+
+    /* Find or claim the bucket of this callsite */
+    const uintptr_t addr = reinterpret_cast<uintptr_t>(caller);
+    int i = ((addr >> 2) * 2654435761u) & (TABLE_SIZE - 1);
+
+    for (int probe = 0; probe < 16; probe++, i = (i + 1) & (TABLE_SIZE - 1)) {
+        uintptr_t key = site_addr[i].load(std::memory_order_relaxed);
+        if (key == 0) {
+            /* On failure, key holds the address of whoever claimed the
+             * slot first, which may still be ours */
+            site_addr[i].compare_exchange_strong(key, addr,
+                                                 std::memory_order_relaxed);
+        }
+        if ((key != 0) && (key != addr))
+            continue;
+
+        site_count[i].fetch_add(1, std::memory_order_relaxed);
+        site_bytes[i].fetch_add(size, std::memory_order_relaxed);
+        return;
+    }
+
+    /* Table full around this hash, the sample only counts in the totals */
+}
+
+void AllocTrace::frameDone(void)
+{
+    if (!shared_config.alloc_profiling) {
+        /* Reopen the interval when profiling gets enabled */
+        interval_start_time = {0, 0};
+        return;
+    }
+
+    struct timespec now;
+    NATIVECALL(clock_gettime(CLOCK_MONOTONIC, &now));
+
+    /* First call, just open the interval */
+    if ((interval_start_time.tv_sec == 0) && (interval_start_time.tv_nsec == 0)) {
+        interval_start_time = now;
+        return;
+    }
+
+    const uint64_t elapsed_ns = (now.tv_sec - interval_start_time.tv_sec) * 1000000000ULL
+        + now.tv_nsec - interval_start_time.tv_nsec;
+
+    if (elapsed_ns < flush_interval_ns)
+        return;
+
+    /* Harvest the table. Recording may still add to buckets concurrently,
+     * those samples are simply credited to the next interval */
+    AllocStats::Site sites[TABLE_SIZE];
+    int count = 0;
+    for (int i = 0; i < TABLE_SIZE; i++) {
+        const uint64_t c = site_count[i].exchange(0, std::memory_order_relaxed);
+        if (c == 0)
+            continue;
+        sites[count].address = site_addr[i].load(std::memory_order_relaxed);
+        sites[count].count = c;
+        sites[count].bytes = site_bytes[i].exchange(0, std::memory_order_relaxed);
+        count++;
+    }
+
+    /* Keep the heaviest callsites by bytes */
+    const int kept = std::min(count, AllocStats::MAX_SITES);
+    std::partial_sort(sites, sites + kept, sites + count,
+        [](const AllocStats::Site &a, const AllocStats::Site &b) {
+            return a.bytes > b.bytes;
+        });
+
+    AllocStats stats;
+    for (int i = 0; i < kept; i++)
+        stats.sites[i] = sites[i];
+    stats.site_count = kept;
+    stats.sample_rate = SAMPLE_RATE;
+    stats.total_count = total_count.exchange(0, std::memory_order_relaxed);
+    stats.total_bytes = total_bytes.exchange(0, std::memory_order_relaxed);
+    stats.interval_ns = elapsed_ns;
+
+    sendMessage(MSGB_ALLOC_STATS);
+    sendData(&stats, sizeof(stats));
+
+    interval_start_time = now;
+}
+
+}
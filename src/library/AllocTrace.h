@@ -0,0 +1,50 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_ALLOCTRACE_H_INCL
+#define LIBTAS_ALLOCTRACE_H_INCL
+
+#include <cstddef>
+
+namespace libtas {
+/* Sampled allocation profiler behind the malloc wrappers, showing which
+ * callsites dirty memory between savestates.
+ *
+ * One allocation out of N is recorded into a fixed-size lock-free hash
+ * table keyed by the caller return address, so the hot path costs a
+ * thread-local counter decrement when not sampling, and a few atomic
+ * adds when sampling. Aggregates are flushed to the program about once
+ * per second, as part of the start-of-frame message batch.
+ */
+class AllocTrace
+{
+    public:
+        /* Record one allocation request. caller is the return address of
+         * the wrapper, size the requested byte count. Only one call out
+         * of the sampling rate is aggregated. Safe from any thread */
+        static void record(void *caller, size_t size);
+
+        /* Send the aggregated samples to the program when the current
+         * interval is old enough. Must be called while the program pulls
+         * our start-of-frame messages */
+        static void frameDone(void);
+};
+}
+
+#endif
@@ -24,6 +24,7 @@
 #include "frame.h"
 #include "timewrappers.h" // clock_gettime
 #include "sleepwrappers.h" // nanosleep
+#include "FrameTrace.h"
 #include "audio/AudioContext.h"
 #include "GlobalState.h"
 #include "renderhud/RenderHUD.h"
@@ -38,6 +39,22 @@ struct timespec DeterministicTimer::getTicks()
     return getTicks(SharedConfig::TIMETYPE_UNTRACKED);
 }
 
+TimeHolder DeterministicTimer::readTicks()
+{
+    TimeHolder snapshot;
+    unsigned int seq;
+
+    do {
+        seq = ticks_seq.load(std::memory_order_acquire);
+        snapshot = ticks;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        /* Retry if a writer was in the middle of a modification (odd
+         * sequence number), or modified ticks while we were reading it */
+    } while ((seq & 1) || (seq != ticks_seq.load(std::memory_order_relaxed)));
+
+    return snapshot;
+}
+
 struct timespec DeterministicTimer::getTicks(SharedConfig::TimeCallType type)
 {
     /* If we are in the native global state, just return the real time */
@@ -52,7 +69,7 @@ struct timespec DeterministicTimer::getTicks(SharedConfig::TimeCallType type)
     }
 
     if (type == SharedConfig::TIMETYPE_UNTRACKED) {
-        TimeHolder fakeTicks = ticks + fakeExtraTicks;
+        TimeHolder fakeTicks = readTicks() + fakeExtraTicks;
         return fakeTicks;
     }
 
@@ -73,27 +90,71 @@ struct timespec DeterministicTimer::getTicks(SharedConfig::TimeCallType type)
     if (!insideFrameBoundary && /* Don't track is already inside a frame boundary */
         gettimes_threshold >= 0) {
 
-        /* We actually track this time call */
-        std::lock_guard<std::mutex> lock(mutex);
+        /* We actually track this time call. The counter increment is atomic,
+         * so the common case of staying below the threshold does not need
+         * to take the mutex */
         debuglog(LCF_TIMESET | LCF_FREQUENT, "subticks ", type, " increased");
-        int* gettimes_count = mainT ? &main_gettimes[type] : &sec_gettimes[type];
-        (*gettimes_count)++;
+        std::atomic<int>* gettimes_count = mainT ? &main_gettimes[type] : &sec_gettimes[type];
+
+        bool overflowed = false;
+        if (mainT) {
+            /* Main-thread counts drive deterministic time advances, so they
+             * are counted exactly. Only the main thread increments them */
+            int count = gettimes_count->fetch_add(1, std::memory_order_relaxed) + 1;
+            overflowed = count > gettimes_threshold;
+        }
+        else {
+            /* Secondary-thread advances are nondeterministic anyway (they
+             * depend on thread scheduling), so those counts are batched in
+             * a thread-local cache and flushed into the shared counter every
+             * few calls, removing the cross-thread cache-line traffic from
+             * the hot path. A spinning thread still flushes often enough for
+             * the anti-freeze advance to trigger promptly */
+            static thread_local int sec_gettimes_cache[SharedConfig::TIMETYPE_NUMTRACKEDTYPES];
+            static thread_local unsigned int sec_gettimes_epoch = 0;
+
+            /* Discard the cache if the counts were reset since we last
+             * flushed */
+            unsigned int epoch = gettimes_epoch.load(std::memory_order_relaxed);
+            if (sec_gettimes_epoch != epoch) {
+                for (int i = 0; i < SharedConfig::TIMETYPE_NUMTRACKEDTYPES; i++)
+                    sec_gettimes_cache[i] = 0;
+                sec_gettimes_epoch = epoch;
+            }
 
-        if(*gettimes_count > gettimes_threshold) {
-            /*
-             * We reached the limit of the number of calls.
-             * We advance the deterministic timer by some value
-             */
-            int tickDelta = 1;
+            int batch = gettimes_threshold / 4 + 1;
+            if (batch > 16)
+                batch = 16;
+
+            if (++sec_gettimes_cache[type] >= batch) {
+                int count = gettimes_count->fetch_add(sec_gettimes_cache[type], std::memory_order_relaxed) + sec_gettimes_cache[type];
+                sec_gettimes_cache[type] = 0;
+                overflowed = count > gettimes_threshold;
+            }
+        }
+
+        if(overflowed) {
+            std::lock_guard<std::mutex> lock(mutex);
 
-            debuglog(LCF_TIMESET | LCF_FREQUENT, "WARNING! force-advancing time of type ", type);
+            /* Another thread might have advanced time and reset the counts
+             * while we were waiting for the mutex, so check again */
+            if (gettimes_count->load(std::memory_order_relaxed) > gettimes_threshold) {
+                /*
+                 * We reached the limit of the number of calls.
+                 * We advance the deterministic timer by some value
+                 */
+                int tickDelta = 1;
 
-            ticksExtra += tickDelta;
+                debuglog(LCF_TIMESET | LCF_FREQUENT, "WARNING! force-advancing time of type ", type);
 
-            /* Reseting the number of calls from all functions */
-            for (int i = 0; i < SharedConfig::TIMETYPE_NUMTRACKEDTYPES; i++) {
-                main_gettimes[i] = 0;
-                sec_gettimes[i] = 0;
+                ticksExtra += tickDelta;
+
+                /* Reseting the number of calls from all functions */
+                for (int i = 0; i < SharedConfig::TIMETYPE_NUMTRACKEDTYPES; i++) {
+                    main_gettimes[i] = 0;
+                    sec_gettimes[i] = 0;
+                }
+                gettimes_epoch.fetch_add(1, std::memory_order_relaxed);
             }
         }
     }
@@ -104,7 +165,7 @@ struct timespec DeterministicTimer::getTicks(SharedConfig::TimeCallType type)
         addDelay(delay);
     }
 
-    TimeHolder fakeTicks = ticks + fakeExtraTicks;
+    TimeHolder fakeTicks = readTicks() + fakeExtraTicks;
     return fakeTicks;
 }
 
@@ -130,7 +191,13 @@ void DeterministicTimer::addDelay(struct timespec delayTicks)
         std::lock_guard<std::mutex> lock(mutex);
 
         addedDelay += delayTicks;
+
+        /* Bump the sequence number around the modification so that
+         * lock-free readers can detect it (see readTicks()) */
+        ticks_seq.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
         ticks += delayTicks;
+        ticks_seq.fetch_add(1, std::memory_order_release);
     }
 
     if(!shared_config.fastforward)
@@ -173,6 +240,7 @@ void DeterministicTimer::exitFrameBoundary()
         main_gettimes[i] = 0;
         sec_gettimes[i] = 0;
     }
+    gettimes_epoch.fetch_add(1, std::memory_order_relaxed);
 
     if (shared_config.debug_state & SharedConfig::DEBUG_UNCONTROLLED_TIME)
         return nonDetTimer.exitFrameBoundary();
@@ -189,8 +257,47 @@ void DeterministicTimer::exitFrameBoundary()
     if (!(shared_config.fastforward && (shared_config.fastforward_mode & SharedConfig::FF_SLEEP))) {
         TimeHolder desiredTime = lastEnterTime + baseTimeIncrement * shared_config.speed_divisor;
 
-        /* Call the real nanosleep function */
-        NATIVECALL(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &desiredTime, NULL));
+        /* A plain absolute sleep to the deadline is at the mercy of
+         * scheduler wakeup jitter, tens to hundreds of µs. Sleep to the
+         * deadline minus a margin and busy-wait the remainder, which paces
+         * within the clock read granularity. The margin tracks the
+         * observed oversleep plus some headroom, so the spin stays about
+         * as short as the jitter it absorbs. */
+        static const int64_t SPIN_HEADROOM_NS = 20000;
+        static const int64_t SPIN_MARGIN_MAX_NS = 2000000;
+        static int64_t spin_margin_ns = SPIN_HEADROOM_NS;
+
+        FrameTrace::begin(FrameTimeStats::SPAN_SLEEP);
+
+        TimeHolder margin;
+        margin.tv_sec = 0;
+        margin.tv_nsec = spin_margin_ns;
+        TimeHolder wakeTime = desiredTime - margin;
+
+        if (wakeTime > currentTime) {
+            NATIVECALL(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wakeTime, NULL));
+
+            TimeHolder wokenTime;
+            NATIVECALL(clock_gettime(CLOCK_MONOTONIC, &wokenTime));
+            if (wokenTime > wakeTime) {
+                const TimeHolder overTime = wokenTime - wakeTime;
+                const int64_t oversleep_ns = overTime.tv_sec * 1000000000LL + overTime.tv_nsec;
+                spin_margin_ns += (oversleep_ns + SPIN_HEADROOM_NS - spin_margin_ns) / 8;
+                if (spin_margin_ns > SPIN_MARGIN_MAX_NS)
+                    spin_margin_ns = SPIN_MARGIN_MAX_NS;
+                if (spin_margin_ns < SPIN_HEADROOM_NS)
+                    spin_margin_ns = SPIN_HEADROOM_NS;
+            }
+        }
+
+        /* Spin out the rest of the frame */
+        TimeHolder spinTime;
+        NATIVECALL(clock_gettime(CLOCK_MONOTONIC, &spinTime));
+        while (desiredTime > spinTime) {
+            NATIVECALL(clock_gettime(CLOCK_MONOTONIC, &spinTime));
+        }
+
+        FrameTrace::end(FrameTimeStats::SPAN_SLEEP);
 
         /* We assume that our sleep was perfect, so we save the desired time as our
          * current time, except if our current time was longer than the desired time.
@@ -236,18 +343,27 @@ void DeterministicTimer::enterFrameBoundary()
      * decrement addedDelay by the time increment.
      */
     if (timeIncrement > addedDelay) {
+        std::lock_guard<std::mutex> lock(mutex);
         TimeHolder deltaTicks = timeIncrement - addedDelay;
+
+        ticks_seq.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
         ticks += deltaTicks;
+        ticks_seq.fetch_add(1, std::memory_order_release);
+
         debuglog(LCF_TIMESET, __func__, " added ", deltaTicks.tv_sec * 1000000000 + deltaTicks.tv_nsec, " nsec");
         addedDelay = {0, 0};
     }
     else {
+        std::lock_guard<std::mutex> lock(mutex);
         addedDelay -= timeIncrement;
     }
 
     /* Doing the audio mixing here, except if the game opened a loopback context */
     if (! audiocontext.isLoopback) {
+        FrameTrace::begin(FrameTimeStats::SPAN_AUDIO);
         audiocontext.mixAllSources(timeIncrement);
+        FrameTrace::end(FrameTimeStats::SPAN_AUDIO);
     }
 }
 
@@ -258,6 +374,7 @@ void DeterministicTimer::fakeAdvanceTimer(struct timespec extraTicks) {
 void DeterministicTimer::initialize(void)
 {
     ticks = shared_config.initial_time;
+    ticks_seq = 0;
 
     if (shared_config.framerate_num > 0) {
         baseTimeIncrement.tv_sec = shared_config.framerate_den / shared_config.framerate_num;
@@ -272,6 +389,7 @@ void DeterministicTimer::initialize(void)
         main_gettimes[i] = 0;
         sec_gettimes[i] = 0;
     }
+    gettimes_epoch = 0;
 
     addedDelay = {0, 0};
     fakeExtraTicks = {0, 0};
@@ -23,6 +23,7 @@
 #include "TimeHolder.h"
 #include "../shared/SharedConfig.h"
 #include <mutex>
+#include <atomic>
 
 namespace libtas {
 /* A timer that gives deterministic values, at least in the main thread.
@@ -109,15 +110,32 @@ private:
 
     /* Count for each time-getting method before time auto-advances to
      * avoid a freeze. Distinguish between main and secondary threads.
+     * Atomic, so that the common case of a time query below the threshold
+     * does not need to take the mutex.
      */
-    int main_gettimes[SharedConfig::TIMETYPE_NUMTRACKEDTYPES];
-    int sec_gettimes[SharedConfig::TIMETYPE_NUMTRACKEDTYPES];
+    std::atomic<int> main_gettimes[SharedConfig::TIMETYPE_NUMTRACKEDTYPES];
+    std::atomic<int> sec_gettimes[SharedConfig::TIMETYPE_NUMTRACKEDTYPES];
+
+    /* Generation number of the counts above, bumped whenever they are
+     * reset. Secondary threads batch their counts in thread-local caches
+     * before flushing them into sec_gettimes, and use this number to
+     * discard a cache that predates a reset */
+    std::atomic<unsigned int> gettimes_epoch;
 
     /* Are we inside a frame boudary */
     bool insideFrameBoundary = false;
 
-    /* Mutex to protect access to the ticks value */
+    /* Mutex to protect modifications of the ticks value */
     std::mutex mutex;
+
+    /* Sequence number guarding reads of the ticks value (seqlock scheme).
+     * Writers hold the mutex and bump it to an odd value before modifying
+     * ticks and to an even value after, so readers can get a consistent
+     * snapshot without taking the mutex */
+    std::atomic<unsigned int> ticks_seq;
+
+    /* Get a consistent snapshot of the ticks value without taking the mutex */
+    TimeHolder readTicks();
 };
 
 extern DeterministicTimer detTimer;
@@ -0,0 +1,109 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FrameTrace.h"
+#include "../shared/messages.h"
+#include "../shared/sockethelpers.h"
+#include "logging.h"
+#include <cstring>
+#include <ctime>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h> // __rdtsc
+#endif
+
+namespace libtas {
+
+/* Interval between two flushes to the program */
+static const uint64_t flush_interval_ns = 1000000000;
+
+/* Spans accumulated since the last flush */
+static uint64_t span_ticks[FrameTimeStats::SPAN_COUNT];
+
+/* Start timestamp of the currently running spans */
+static uint64_t span_start[FrameTimeStats::SPAN_COUNT];
+
+/* Frame boundaries since the last flush */
+static uint32_t frames = 0;
+
+/* Timestamps of the last flush */
+static uint64_t interval_start_ticks = 0;
+static struct timespec interval_start_time = {0, 0};
+
+static uint64_t readTicks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    /* Fall back on the monotonic clock, making ticks nanoseconds */
+    struct timespec now;
+    NATIVECALL(clock_gettime(CLOCK_MONOTONIC, &now));
+    return now.tv_sec * 1000000000ULL + now.tv_nsec;
+#endif
+}
+
+void FrameTrace::begin(FrameTimeStats::Span span)
+{
+    span_start[span] = readTicks();
+}
+
+void FrameTrace::end(FrameTimeStats::Span span)
+{
+    span_ticks[span] += readTicks() - span_start[span];
+}
+
+void FrameTrace::frameDone(void)
+{
+    frames++;
+
+    struct timespec now;
+    NATIVECALL(clock_gettime(CLOCK_MONOTONIC, &now));
+
+    /* First call, just open the interval */
+    if ((interval_start_time.tv_sec == 0) && (interval_start_time.tv_nsec == 0)) {
+        interval_start_time = now;
+        interval_start_ticks = readTicks();
+        return;
+    }
+
+    const uint64_t elapsed_ns = (now.tv_sec - interval_start_time.tv_sec) * 1000000000ULL
+        + now.tv_nsec - interval_start_time.tv_nsec;
+
+    if (elapsed_ns < flush_interval_ns)
+        return;
+
+    const uint64_t now_ticks = readTicks();
+
+    FrameTimeStats stats;
+    memcpy(stats.span_ticks, span_ticks, sizeof(span_ticks));
+    stats.interval_ticks = now_ticks - interval_start_ticks;
+    stats.interval_ns = elapsed_ns;
+    stats.frames = frames;
+
+    sendMessage(MSGB_FRAMETIME_STATS);
+    sendData(&stats, sizeof(stats));
+
+    /* Open the next interval */
+    memset(span_ticks, 0, sizeof(span_ticks));
+    frames = 0;
+    interval_start_time = now;
+    interval_start_ticks = now_ticks;
+}
+
+}
@@ -0,0 +1,51 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_FRAMETRACE_H_INCL
+#define LIBTAS_FRAMETRACE_H_INCL
+
+#include "../shared/FrameTimeStats.h"
+
+namespace libtas {
+/* Lightweight per-frame span recorder, showing where frame time goes
+ * inside the library (sleeps, audio mixing, capture, encoding, ...).
+ *
+ * Spans are timed with the timestamp counter into preallocated arrays,
+ * so recording never allocates or enters the kernel. All spans belong to
+ * frame-boundary code, which runs on the main thread only. Aggregates
+ * are flushed to the program about once per second, as part of the
+ * start-of-frame message batch.
+ */
+class FrameTrace
+{
+    public:
+        /* Start timing a span. Spans of the same kind must not nest */
+        static void begin(FrameTimeStats::Span span);
+
+        /* Stop timing a span and accumulate its duration */
+        static void end(FrameTimeStats::Span span);
+
+        /* Account for one frame boundary, and send the aggregated stats
+         * to the program when the current interval is old enough. Must be
+         * called while the program pulls our start-of-frame messages */
+        static void frameDone(void);
+};
+}
+
+#endif
@@ -21,77 +21,6 @@
 
 namespace libtas {
 
-thread_local int GlobalState::native = 0;
-thread_local int GlobalState::owncode = 0;
-thread_local int GlobalState::nolog = 0;
-
-void GlobalState::setNative(bool state)
-{
-    if (state)
-        native++;
-    else
-        native--;
-}
-
-bool GlobalState::isNative()
-{
-    return (native > 0);
-}
-
-void GlobalState::setOwnCode(bool state)
-{
-    if (state)
-        owncode++;
-    else
-        owncode--;
-}
-
-bool GlobalState::isOwnCode()
-{
-    return (owncode > 0);
-}
-
-void GlobalState::setNoLog(bool state)
-{
-    if (state)
-        nolog++;
-    else
-        nolog--;
-}
-
-bool GlobalState::isNoLog()
-{
-    return (nolog > 0);
-}
-
-GlobalNative::GlobalNative()
-{
-    GlobalState::setNative(true);
-}
-
-GlobalNative::~GlobalNative()
-{
-    GlobalState::setNative(false);
-}
-
-GlobalOwnCode::GlobalOwnCode()
-{
-    GlobalState::setOwnCode(true);
-}
-
-GlobalOwnCode::~GlobalOwnCode()
-{
-    GlobalState::setOwnCode(false);
-}
-
-GlobalNoLog::GlobalNoLog()
-{
-    GlobalState::setNoLog(true);
-}
-
-GlobalNoLog::~GlobalNoLog()
-{
-    GlobalState::setNoLog(false);
-}
+thread_local unsigned int GlobalState::flags __attribute__((tls_model("initial-exec"))) = 0;
 
 }
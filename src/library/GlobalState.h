@@ -44,48 +44,88 @@ class GlobalState
         /* Add or remove the NATIVE, OWNCODE and NOLOG flags.
          * This function and all other set* functions have a call count,
          * meaning we must call set*(false) by the same number as set*(true)
-         * to disable the flag */
-        static void setNative(bool state);
+         * to disable the flag.
+         *
+         * These functions are the most executed code of the library: every
+         * hooked libc call queries at least one flag. The three nesting
+         * counts are packed into a single thread-local word accessed with
+         * the initial-exec TLS model (valid because this library is always
+         * LD_PRELOADed, never dlopened), and the accessors are inline, so a
+         * flag query compiles down to one TLS load and a mask. */
+        static void setNative(bool state) {
+            if (state)
+                flags += NATIVE_UNIT;
+            else
+                flags -= NATIVE_UNIT;
+        }
 
         /* Check the NATIVE flag */
-        static bool isNative(void);
+        static bool isNative(void) {
+            return (flags & NATIVE_MASK) != 0;
+        }
 
         /* Add or remove the OWNCODE and NOLOG flags. */
-        static void setOwnCode(bool state);
+        static void setOwnCode(bool state) {
+            if (state)
+                flags += OWNCODE_UNIT;
+            else
+                flags -= OWNCODE_UNIT;
+        }
+
         /* Check the OWNCODE flag */
-        static bool isOwnCode(void);
+        static bool isOwnCode(void) {
+            return (flags & OWNCODE_MASK) != 0;
+        }
 
         /* Add or remove the NOLOG flag. */
-        static void setNoLog(bool state);
+        static void setNoLog(bool state) {
+            if (state)
+                flags += NOLOG_UNIT;
+            else
+                flags -= NOLOG_UNIT;
+        }
+
         /* Check the NOLOG flag */
-        static bool isNoLog(void);
+        static bool isNoLog(void) {
+            return (flags & NOLOG_MASK) != 0;
+        }
 
     private:
 
-        /* When NATIVE flag is on, we ask each hooked function to act
-         * as closely as possible as the real function. This disable
-         * any log message, side effects, etc.
-         */
-        static thread_local int native;
-
-        /* When OWNCODE flag is on, we indicate each hooked function that
-         * the caller was our own code and not the game code. This usually
-         * make the code closer to the original function, although it is not
-         * as strong as NATIVE.
-         */
-        static thread_local int owncode;
-
-        /* When NOLOG flag is on, we ask each hooked function to not generate
-         * any log message.
+        /* Each count gets a 10-bit field, far more nesting than the RAII
+         * scopes below ever produce. Counts never go negative (scopes are
+         * balanced, and ThreadManager::update only raises them), so a
+         * field cannot borrow from its neighbour. */
+        enum : unsigned int {
+            NATIVE_UNIT   = 1u,
+            NATIVE_MASK   = 0x3ffu,
+            OWNCODE_UNIT  = 1u << 10,
+            OWNCODE_MASK  = 0x3ffu << 10,
+            NOLOG_UNIT    = 1u << 20,
+            NOLOG_MASK    = 0x3ffu << 20,
+        };
+
+        /* Packed nesting counts of the three flags.
+         *
+         * NATIVE: we ask each hooked function to act as closely as possible
+         * as the real function. This disable any log message, side effects,
+         * etc.
+         *
+         * OWNCODE: we indicate each hooked function that the caller was our
+         * own code and not the game code. This usually make the code closer
+         * to the original function, although it is not as strong as NATIVE.
+         *
+         * NOLOG: we ask each hooked function to not generate any log
+         * message.
          */
-        static thread_local int nolog;
+        static thread_local unsigned int flags __attribute__((tls_model("initial-exec")));
 };
 
 class GlobalNative
 {
 public:
-    GlobalNative();
-    ~GlobalNative();
+    GlobalNative() { GlobalState::setNative(true); }
+    ~GlobalNative() { GlobalState::setNative(false); }
 };
 
 #define NATIVECALL(expr) do{GlobalNative gn; expr;} while (false)
@@ -93,8 +133,8 @@ public:
 class GlobalOwnCode
 {
 public:
-    GlobalOwnCode();
-    ~GlobalOwnCode();
+    GlobalOwnCode() { GlobalState::setOwnCode(true); }
+    ~GlobalOwnCode() { GlobalState::setOwnCode(false); }
 };
 
 #define OWNCALL(expr) do{GlobalOwnCode goc; expr;} while (false)
@@ -102,8 +142,8 @@ public:
 class GlobalNoLog
 {
 public:
-    GlobalNoLog();
-    ~GlobalNoLog();
+    GlobalNoLog() { GlobalState::setNoLog(true); }
+    ~GlobalNoLog() { GlobalState::setNoLog(false); }
 };
 
 #define NOLOGCALL(expr) do{GlobalNoLog gnl; expr;} while (false)
@@ -34,6 +34,8 @@ void NonDeterministicTimer::initialize(void)
     ticks.tv_nsec = 0;
     lastEnterTicks = ticks;
     NATIVECALL(clock_gettime(CLOCK_MONOTONIC, &lasttime));
+    lastCoarseTime.tv_sec = 0;
+    lastCoarseTime.tv_nsec = -1;
     inFB = false;
     lastEnterTime = lasttime;
     lastExitTime = lasttime;
@@ -49,6 +51,18 @@ struct timespec NonDeterministicTimer::getTicks(void)
 
     std::lock_guard<std::mutex> lock(mutex);
 
+    /* Games may query the time thousands of times per frame. Check the
+     * coarse clock first: it only ticks every jiffy, so while it has not
+     * moved since the last refresh, the precise clock cannot be far ahead
+     * and we answer from the cached ticks value. Every coarse tick and
+     * every frame boundary goes through the full path below, which resets
+     * any accumulated drift */
+    TimeHolder coarsetime;
+    NATIVECALL(clock_gettime(CLOCK_MONOTONIC_COARSE, &coarsetime));
+    if ((coarsetime.tv_sec == lastCoarseTime.tv_sec) && (coarsetime.tv_nsec == lastCoarseTime.tv_nsec))
+        return ticks;
+    lastCoarseTime = coarsetime;
+
     /* Get the real clock time */
     TimeHolder realtime;
     NATIVECALL(clock_gettime(CLOCK_MONOTONIC, &realtime));
@@ -87,6 +101,12 @@ struct timespec NonDeterministicTimer::getTicks(void)
 void NonDeterministicTimer::enterFrameBoundary()
 {
     DEBUGLOGCALL(LCF_TIMEGET);
+
+    /* Force a full timer refresh, so the audio mixing below sees the
+     * precise elapsed time of the frame */
+    lastCoarseTime.tv_sec = 0;
+    lastCoarseTime.tv_nsec = -1;
+
     getTicks();
     inFB = true;
 
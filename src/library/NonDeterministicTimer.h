@@ -70,6 +70,11 @@ private:
     /* Last time value of the timer */
     TimeHolder lasttime;
 
+    /* Coarse clock value at the last refresh of the timer. As long as the
+     * coarse clock has not ticked, getTicks() answers from the cached
+     * ticks value without advancing the timer */
+    TimeHolder lastCoarseTime;
+
     /* Are we inside a frame boundary? */
     bool inFB;
 
@@ -26,45 +26,35 @@ namespace libtas {
 
 SDLEventQueue sdlEventQueue;
 
-SDLEventQueue::~SDLEventQueue()
-{
-    for (auto ev: eventQueue) {
-        if (game_info.video & GameInfo::SDL1)
-            delete static_cast<SDL1::SDL_Event*>(ev);
-        if (game_info.video & GameInfo::SDL2)
-            delete static_cast<SDL_Event*>(ev);
-    }
-}
-
 void SDLEventQueue::init(void)
 {
     if (game_info.video & GameInfo::SDL2) {
         /* Insert default filters */
-        droppedEvents.insert(SDL_TEXTINPUT);
-        droppedEvents.insert(SDL_TEXTEDITING);
-        droppedEvents.insert(SDL_SYSWMEVENT);
+        droppedEvents.set(SDL_TEXTINPUT);
+        droppedEvents.set(SDL_TEXTEDITING);
+        droppedEvents.set(SDL_SYSWMEVENT);
     }
 }
 
 void SDLEventQueue::disable(int type)
 {
-    droppedEvents.insert(type);
+    if ((type >= 0) && (type <= SDL_LASTEVENT))
+        droppedEvents.set(type);
 }
 
 void SDLEventQueue::enable(int type)
 {
-    std::set<int>::iterator it = droppedEvents.find(type);
-    if (it != droppedEvents.end())
-        droppedEvents.erase(it);
+    if ((type >= 0) && (type <= SDL_LASTEVENT))
+        droppedEvents.reset(type);
 }
 
 bool SDLEventQueue::isEnabled(int type)
 {
-    return droppedEvents.find(type) == droppedEvents.end();
+    if ((type < 0) || (type > SDL_LASTEVENT))
+        return true;
+    return !droppedEvents.test(type);
 }
 
-#define EVENTQUEUE_MAXLEN 1024
-
 int SDLEventQueue::insert(SDL_Event* event)
 {
     /* Before inserting the event, we have some checks in a specific order */
@@ -80,23 +70,23 @@ int SDLEventQueue::insert(SDL_Event* event)
             return 0;
     }
 
-    /* 3. Call all watchers on the event */
-    for (auto watch: watches) {
-        watch.first(watch.second, event);
+    /* 3. Call all watchers on the event. Almost no game registers one, so
+     * don't even set up the iteration in that case */
+    if (!watches.empty()) {
+        for (auto watch: watches) {
+            watch.first(watch.second, event);
+        }
     }
 
     /* 4. Check the size of the queue */
-    if (eventQueue.size() > 1024) {
+    if (ringFull()) {
         debuglog(LCF_SDL | LCF_EVENTS, "We reached the limit of the event queue size!");
         return -1;
     }
 
-    /* Building a dynamically allocated event */
-    SDL_Event* ev = new SDL_Event;
-    memcpy(ev, event, sizeof(SDL_Event));
-
-    /* Push the event at the end of the queue */
-    eventQueue.push_back(ev);
+    /* Copy the event into the next ring slot */
+    memcpy(&ring[ringTail].ev2, event, sizeof(SDL_Event));
+    ringTail = ringNext(ringTail);
 
     return 1;
 }
@@ -117,17 +107,14 @@ int SDLEventQueue::insert(SDL1::SDL_Event* event)
     }
 
     /* 3. Check the size of the queue */
-    if (eventQueue.size() > 1024) {
+    if (ringFull()) {
         debuglog(LCF_SDL | LCF_EVENTS, "We reached the limit of the event queue size!");
         return -1;
     }
 
-    /* Building a dynamically allocated event */
-    SDL1::SDL_Event* ev = new SDL1::SDL_Event;
-    memcpy(ev, event, sizeof(SDL1::SDL_Event));
-
-    /* Push the event at the end of the queue */
-    eventQueue.push_back(ev);
+    /* Copy the event into the next ring slot */
+    memcpy(&ring[ringTail].ev1, event, sizeof(SDL1::SDL_Event));
+    ringTail = ringNext(ringTail);
 
     return 0;
 }
@@ -139,37 +126,58 @@ int SDLEventQueue::pop(SDL_Event* events, int num, Uint32 minType, Uint32 maxTyp
     if (num <= 0)
         return 0;
 
-    std::list<void*>::iterator it = eventQueue.begin();
-    while (it != eventQueue.end()) {
-        SDL_Event* ev = static_cast<SDL_Event*>(*it);
+    /* Fast path: events consumed from the front of the queue just advance
+     * the head, without touching the rest of the ring. This covers games
+     * polling with the full type range, where a batch of N events costs
+     * exactly N contiguous copies */
+    if (update) {
+        while ((ringHead != ringTail) && (evi < num)) {
+            SDL_Event* ev = &ring[ringHead].ev2;
+            if (!((ev->type >= minType) && (ev->type <= maxType)))
+                break;
+            memcpy(&events[evi], ev, sizeof(SDL_Event));
+            evi++;
+            ringHead = ringNext(ringHead);
+        }
+        if ((evi >= num) || (ringHead == ringTail))
+            return evi;
+    }
 
-        /* Check if event match the filter */
-        if ((ev->type >= minType) && (ev->type <= maxType)) {
+    /* Walk the ring once, copying matching events into the caller's array.
+     * When consuming, surviving events are compacted in place so the queue
+     * stays contiguous. A whole batch is a single linear pass over the
+     * ring memory, with no allocator or list-node traffic */
+    int src = ringHead;
+    int dst = ringHead;
+    while (src != ringTail) {
+        SDL_Event* ev = &ring[src].ev2;
 
+        /* Check if event match the filter */
+        bool match = (evi < num) && (ev->type >= minType) && (ev->type <= maxType);
+        if (match) {
             /* Copy the event in the array */
             memcpy(&events[evi], ev, sizeof(SDL_Event));
             evi++;
-
-            if (update) {
-                /* Deleting the object and removing it from the list */
-                delete ev;
-                it = eventQueue.erase(it);
-            }
-            else
-                ++it;
-
-            /* Check if we reached the limit on the number of events */
-            if (evi >= num)
-                return num;
         }
-        else {
-            ++it;
+
+        if (!(update && match)) {
+            /* Event stays in the queue; shift it down over consumed slots */
+            if (update && (dst != src))
+                ring[dst] = ring[src];
+            dst = ringNext(dst);
         }
+        src = ringNext(src);
 
+        /* Once we reached the limit on the number of events, we can stop
+         * early, unless consumed slots still have to be compacted over */
+        if ((evi >= num) && (!update || (dst == src)))
+            return evi;
     }
 
-    return evi;
+    if (update)
+        ringTail = dst;
 
+    return evi;
 }
 
 int SDLEventQueue::pop(SDL1::SDL_Event* events, int num, Uint32 mask, bool update)
@@ -179,92 +187,108 @@ int SDLEventQueue::pop(SDL1::SDL_Event* events, int num, Uint32 mask, bool updat
     if (num <= 0)
         return 0;
 
-    std::list<void*>::iterator it = eventQueue.begin();
-    while (it != eventQueue.end()) {
-        SDL1::SDL_Event* ev = static_cast<SDL1::SDL_Event*>(*it);
+    /* Fast path: events consumed from the front of the queue just advance
+     * the head, as in the SDL2 variant above */
+    if (update) {
+        while ((ringHead != ringTail) && (evi < num)) {
+            SDL1::SDL_Event* ev = &ring[ringHead].ev1;
+            if (!(mask & SDL1_EVENTMASK(ev->type)))
+                break;
+            memcpy(&events[evi], ev, sizeof(SDL1::SDL_Event));
+            evi++;
+            ringHead = ringNext(ringHead);
+        }
+        if ((evi >= num) || (ringHead == ringTail))
+            return evi;
+    }
 
-        /* Check if event match the filter */
-        if (mask & SDL1_EVENTMASK(ev->type)) {
+    /* Same single compacting pass as the SDL2 variant above */
+    int src = ringHead;
+    int dst = ringHead;
+    while (src != ringTail) {
+        SDL1::SDL_Event* ev = &ring[src].ev1;
 
+        /* Check if event match the filter */
+        bool match = (evi < num) && (mask & SDL1_EVENTMASK(ev->type));
+        if (match) {
             /* Copy the event in the array */
             memcpy(&events[evi], ev, sizeof(SDL1::SDL_Event));
             evi++;
-
-            if (update) {
-                /* Deleting the object and removing it from the list */
-                delete ev;
-                it = eventQueue.erase(it);
-            }
-            else
-                ++it;
-
-            /* Check if we reached the limit on the number of events */
-            if (evi >= num)
-                return num;
-
         }
-        else {
-            ++it;
+
+        if (!(update && match)) {
+            /* Event stays in the queue; shift it down over consumed slots */
+            if (update && (dst != src))
+                ring[dst] = ring[src];
+            dst = ringNext(dst);
         }
+        src = ringNext(src);
+
+        /* Once we reached the limit on the number of events, we can stop
+         * early, unless consumed slots still have to be compacted over */
+        if ((evi >= num) && (!update || (dst == src)))
+            return evi;
     }
 
-    return evi;
+    if (update)
+        ringTail = dst;
 
+    return evi;
 }
 
 void SDLEventQueue::flush(Uint32 minType, Uint32 maxType)
 {
-    std::list<void*>::iterator it = eventQueue.begin();
-    while (it != eventQueue.end()) {
-        SDL_Event* ev = static_cast<SDL_Event*>(*it);
-
-        /* Check if event match the filter */
-        if ((ev->type >= minType) && (ev->type <= maxType)) {
-            /* Deleting the object and removing it from the list */
-            delete ev;
-            it = eventQueue.erase(it);
-        }
-        else {
-            ++it;
+    int src = ringHead;
+    int dst = ringHead;
+    while (src != ringTail) {
+        SDL_Event* ev = &ring[src].ev2;
+
+        /* Keep events that don't match the filter, compacting them down */
+        if (!((ev->type >= minType) && (ev->type <= maxType))) {
+            if (dst != src)
+                ring[dst] = ring[src];
+            dst = ringNext(dst);
         }
+        src = ringNext(src);
     }
+    ringTail = dst;
 }
 
 void SDLEventQueue::flush(Uint32 mask)
 {
-    std::list<void*>::iterator it = eventQueue.begin();
-    while (it != eventQueue.end()) {
-        SDL1::SDL_Event* ev = static_cast<SDL1::SDL_Event*>(*it);
-
-        /* Check if event match the filter */
-        if (mask & SDL1_EVENTMASK(ev->type)) {
-            /* Deleting the object and removing it from the list */
-            delete ev;
-            it = eventQueue.erase(it);
-        }
-        else {
-            ++it;
+    int src = ringHead;
+    int dst = ringHead;
+    while (src != ringTail) {
+        SDL1::SDL_Event* ev = &ring[src].ev1;
+
+        /* Keep events that don't match the filter, compacting them down */
+        if (!(mask & SDL1_EVENTMASK(ev->type))) {
+            if (dst != src)
+                ring[dst] = ring[src];
+            dst = ringNext(dst);
         }
+        src = ringNext(src);
     }
+    ringTail = dst;
 }
 
 void SDLEventQueue::applyFilter(SDL_EventFilter filter, void* userdata)
 {
-    std::list<void*>::iterator it = eventQueue.begin();
-    while (it != eventQueue.end()) {
-        SDL_Event* ev = static_cast<SDL_Event*>(*it);
+    int src = ringHead;
+    int dst = ringHead;
+    while (src != ringTail) {
+        SDL_Event* ev = &ring[src].ev2;
 
-        /* Run the filter function and check the result */
+        /* Run the filter function and keep the event if it returns 1 */
         int isKept = filter(userdata, ev);
-        if (!isKept) {
-            /* Deleting the object and removing it from the list */
-            delete ev;
-            it = eventQueue.erase(it);
-        }
-        else {
-            ++it;
+        if (isKept) {
+            if (dst != src)
+                ring[dst] = ring[src];
+            dst = ringNext(dst);
         }
+        src = ringNext(src);
     }
+    ringTail = dst;
 }
 
 void SDLEventQueue::setFilter(SDL_EventFilter filter, void* userdata)
@@ -20,8 +20,8 @@
 #ifndef LIBTAS_SDLEVENTQUEUE_H_INCLUDED
 #define LIBTAS_SDLEVENTQUEUE_H_INCLUDED
 
-#include <list>
 #include <set>
+#include <bitset>
 #include "../external/SDL1.h"
 #include <SDL2/SDL.h>
 #include "sdlevents.h" // SDL_EventFilter
@@ -37,8 +37,6 @@ namespace libtas {
 class SDLEventQueue
 {
     public:
-        ~SDLEventQueue();
-
         void init();
 
         /* Try to insert an event in the queue if conditions are met.
@@ -98,8 +96,39 @@ class SDLEventQueue
         void delWatch(SDL_EventFilter filter, void* userdata);
 
     private:
-        std::list<void*> eventQueue;
-        std::set<int> droppedEvents;
+        /* Capacity of the queue, matching the old external limit */
+        static const int QUEUE_CAPACITY = 1024;
+
+        /* One queue slot, holding either event flavor. A game only ever
+         * uses one SDL version */
+        union EventRecord {
+            SDL_Event ev2;
+            SDL1::SDL_Event ev1;
+        };
+
+        /* The events are stored contiguously in a fixed ring, so inserting
+         * never allocates, and popping a batch walks linear memory instead
+         * of chasing list nodes. Games pumping with
+         * SDL_PeepEvents(SDL_GETEVENT) drain 100+ events per frame through
+         * here. One slot is kept empty to tell a full ring from an empty
+         * one. */
+        EventRecord ring[QUEUE_CAPACITY + 1];
+        int ringHead = 0;
+        int ringTail = 0;
+
+        static int ringNext(int i) {
+            return (i == QUEUE_CAPACITY) ? 0 : (i + 1);
+        }
+
+        bool ringFull() const {
+            return ringNext(ringTail) == ringHead;
+        }
+
+        /* One bit per disabled event type, so the per-event check in
+         * insert() is a single bit test instead of a tree lookup. SDL2
+         * event types fit in 16 bits (SDL_LASTEVENT is 0xFFFF) */
+        std::bitset<SDL_LASTEVENT + 1> droppedEvents;
+
         std::set<std::pair<SDL_EventFilter,void*>> watches;
         SDL1::SDL_EventFilter filterFunc1 = nullptr;
         SDL_EventFilter filterFunc = nullptr;
@@ -22,6 +22,7 @@
 #include "hook.h"
 #include "sdlversion.h"
 #include "logging.h"
+#include "xwindows.h" // invalidateGameWindowCache()
 #include "../external/SDL1.h" // SDL_Surface
 #include "global.h"
 
@@ -64,6 +65,7 @@ DECLARE_ORIG_POINTER(SDL_UnlockSurface);
 DECLARE_ORIG_POINTER(SDL_UpperBlit)
 
 DEFINE_ORIG_POINTER(glReadPixels);
+DEFINE_ORIG_POINTER(glGetIntegerv);
 DEFINE_ORIG_POINTER(glGenFramebuffers);
 DEFINE_ORIG_POINTER(glBindFramebuffer);
 DEFINE_ORIG_POINTER(glDeleteFramebuffers);
@@ -72,6 +74,12 @@ DEFINE_ORIG_POINTER(glBindRenderbuffer);
 DEFINE_ORIG_POINTER(glDeleteRenderbuffers);
 DEFINE_ORIG_POINTER(glRenderbufferStorage);
 DEFINE_ORIG_POINTER(glFramebufferRenderbuffer);
+DEFINE_ORIG_POINTER(glGenBuffers);
+DEFINE_ORIG_POINTER(glDeleteBuffers);
+DEFINE_ORIG_POINTER(glBindBuffer);
+DEFINE_ORIG_POINTER(glBufferData);
+DEFINE_ORIG_POINTER(glMapBuffer);
+DEFINE_ORIG_POINTER(glUnmapBuffer);
 DECLARE_ORIG_POINTER(glBlitFramebuffer);
 DEFINE_ORIG_POINTER(glEnable);
 DEFINE_ORIG_POINTER(glDisable);
@@ -81,8 +89,7 @@ DEFINE_ORIG_POINTER(XGetGeometry);
 
 static bool inited = false;
 
-/* Temporary pixel arrays */
-static std::vector<uint8_t> glpixels;
+/* Temporary pixel array */
 static std::vector<uint8_t> winpixels;
 
 /* Video dimensions */
@@ -96,6 +103,22 @@ static GLuint screenFBO = 0;
 /* OpenGL render buffer */
 static GLuint screenRBO = 0;
 
+/* OpenGL pixel buffer objects, used in pairs so the readback of one frame
+ * completes behind the rendering of the next one */
+static GLuint screenPBOs[2] = {0, 0};
+
+/* Pixel format of the OpenGL readback, negotiated at init. Reading the
+ * format the driver stores internally (commonly GL_BGRA) avoids a swizzle
+ * of every pixel inside glReadPixels, and the muxer tags the dump with the
+ * matching fourcc so the encoder accepts either layout unconverted. */
+static GLenum glReadFormat = GL_RGBA;
+
+/* Index of the PBO receiving the current frame */
+static int pboIndex = 0;
+
+/* Whether the other PBO holds the previous frame's readback */
+static bool pboPending = false;
+
 /* SDL1 screen surface */
 static SDL1::SDL_Surface* screenSDL1Surf = nullptr;
 
@@ -225,7 +248,40 @@ void ScreenCapture::initScreenSurface()
         orig::glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
         orig::glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, screenRBO);
 
-        glpixels.resize(size);
+        /* Ask the driver which layout it can read back without converting.
+         * The FBO is still bound, so the answer applies to our readbacks. */
+        LINK_NAMESPACE(glGetIntegerv, "GL");
+        glReadFormat = GL_RGBA;
+        if (orig::glGetIntegerv) {
+            GLint fmt = 0, type = 0;
+            orig::glGetIntegerv(GL_IMPLEMENTATION_COLOR_READ_FORMAT, &fmt);
+            orig::glGetIntegerv(GL_IMPLEMENTATION_COLOR_READ_TYPE, &type);
+            if ((fmt == GL_BGRA) &&
+                ((type == GL_UNSIGNED_BYTE) || (type == GL_UNSIGNED_INT_8_8_8_8_REV))) {
+                debuglog(LCF_WINDOW, "Native BGRA readback negotiated for captures");
+                glReadFormat = GL_BGRA;
+            }
+        }
+
+        /* Create a pair of pixel buffer objects for asynchronous readback.
+         * If the driver doesn't expose buffer objects, we keep the
+         * synchronous glReadPixels path */
+        LINK_NAMESPACE(glGenBuffers, "GL");
+        LINK_NAMESPACE(glBindBuffer, "GL");
+        LINK_NAMESPACE(glBufferData, "GL");
+
+        if (orig::glGenBuffers && orig::glBindBuffer && orig::glBufferData) {
+            if (screenPBOs[0] == 0) {
+                orig::glGenBuffers(2, screenPBOs);
+            }
+            for (int i=0; i<2; i++) {
+                orig::glBindBuffer(GL_PIXEL_PACK_BUFFER, screenPBOs[i]);
+                orig::glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+            }
+            orig::glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        }
+        pboIndex = 0;
+        pboPending = false;
     }
 
     else if (game_info.video & GameInfo::SDL1) {
@@ -247,7 +303,6 @@ void ScreenCapture::initScreenSurface()
 void ScreenCapture::fini()
 {
     winpixels.clear();
-    glpixels.clear();
 
     destroyScreenSurface();
 
@@ -267,6 +322,13 @@ void ScreenCapture::destroyScreenSurface()
         orig::glDeleteRenderbuffers(1, &screenRBO);
         screenRBO = 0;
     }
+    if (screenPBOs[0] != 0) {
+        LINK_NAMESPACE(glDeleteBuffers, "GL");
+        orig::glDeleteBuffers(2, screenPBOs);
+        screenPBOs[0] = 0;
+        screenPBOs[1] = 0;
+        pboPending = false;
+    }
 
     /* Delete the SDL1 screen surface */
     if (screenSDL1Surf) {
@@ -292,6 +354,11 @@ void ScreenCapture::destroyScreenSurface()
 
 void ScreenCapture::resize(int w, int h)
 {
+    /* The window wrappers answer geometry queries from a cache, which
+     * this resize makes stale. Done before the early returns, as the
+     * server-side resize happened regardless. */
+    invalidateGameWindowCache();
+
     if (!inited) {
         return;
     }
@@ -369,7 +436,8 @@ const char* ScreenCapture::getPixelFormat()
     }
 
     else if (game_info.video & GameInfo::OPENGL) {
-        return "RGBA";
+        /* Report the readback format negotiated at init */
+        return (glReadFormat == GL_BGRA) ? "BGRA" : "RGBA";
     }
 
     else if (game_info.video & GameInfo::SDL1) {
@@ -389,6 +457,84 @@ const char* ScreenCapture::getPixelFormat()
     return "RGBA";
 }
 
+int ScreenCapture::getPixelLayout(int& r_off, int& g_off, int& b_off)
+{
+    MYASSERT(inited)
+
+    if ((game_info.video & GameInfo::SDL2_RENDERER) || (game_info.video & GameInfo::SDL2_SURFACE)) {
+        LINK_NAMESPACE_SDL2(SDL_GetWindowPixelFormat);
+        Uint32 sdlpixfmt = orig::SDL_GetWindowPixelFormat(gameSDLWindow);
+        /* Byte offsets of the packed formats, on a little-endian machine */
+        switch (sdlpixfmt) {
+            case SDL_PIXELFORMAT_RGBA8888:
+            case SDL_PIXELFORMAT_RGBX8888:
+                r_off = 3; g_off = 2; b_off = 1;
+                return 4;
+            case SDL_PIXELFORMAT_BGRA8888:
+            case SDL_PIXELFORMAT_BGRX8888:
+                b_off = 3; g_off = 2; r_off = 1;
+                return 4;
+            case SDL_PIXELFORMAT_ARGB8888:
+            case SDL_PIXELFORMAT_RGB888:
+                r_off = 2; g_off = 1; b_off = 0;
+                return 4;
+            case SDL_PIXELFORMAT_ABGR8888:
+            case SDL_PIXELFORMAT_BGR888:
+                b_off = 2; g_off = 1; r_off = 0;
+                return 4;
+            case SDL_PIXELFORMAT_RGB24:
+                r_off = 0; g_off = 1; b_off = 2;
+                return 3;
+            case SDL_PIXELFORMAT_BGR24:
+                b_off = 0; g_off = 1; r_off = 2;
+                return 3;
+            default:
+                return -1;
+        }
+    }
+
+    else if (game_info.video & GameInfo::OPENGL) {
+        /* Pixels were read back in the format negotiated at init */
+        if (glReadFormat == GL_BGRA) {
+            b_off = 0; g_off = 1; r_off = 2;
+        }
+        else {
+            r_off = 0; g_off = 1; b_off = 2;
+        }
+        return 4;
+    }
+
+    else if (game_info.video & GameInfo::SDL1) {
+        if (pixelSize < 3)
+            return -1;
+        switch (screenSDL1Surf->format->Rmask) {
+            case 0x000000ff: r_off = 0; break;
+            case 0x0000ff00: r_off = 1; break;
+            case 0x00ff0000: r_off = 2; break;
+            default: r_off = 3; break;
+        }
+        switch (screenSDL1Surf->format->Gmask) {
+            case 0x000000ff: g_off = 0; break;
+            case 0x0000ff00: g_off = 1; break;
+            case 0x00ff0000: g_off = 2; break;
+            default: g_off = 3; break;
+        }
+        switch (screenSDL1Surf->format->Bmask) {
+            case 0x000000ff: b_off = 0; break;
+            case 0x0000ff00: b_off = 1; break;
+            case 0x00ff0000: b_off = 2; break;
+            default: b_off = 3; break;
+        }
+        return pixelSize;
+    }
+
+    /* X11 ZPixmap data, where 32-bit pixels are stored as BGRX */
+    if (pixelSize < 3)
+        return -1;
+    b_off = 0; g_off = 1; r_off = 2;
+    return pixelSize;
+}
+
 int ScreenCapture::storePixels()
 {
     return getPixels(nullptr, true);
@@ -408,18 +554,16 @@ int ScreenCapture::getPixels(uint8_t **pixels, bool draw)
 
     if (game_info.video & GameInfo::SDL2_RENDERER) {
         LINK_NAMESPACE_SDL2(SDL_RenderReadPixels);
-        LINK_NAMESPACE_SDL2(SDL_LockTexture);
-        LINK_NAMESPACE_SDL2(SDL_UnlockTexture);
 
+        /* The backbuffer is undefined after the next present, and SDL2
+         * offers no backbuffer-to-texture copy, so the readback must
+         * happen now in every case. The upload into the backup texture is
+         * deferred to setPixels(), which redraws rarely (pauses and state
+         * loads), instead of paying it on every captured frame. */
         int ret = orig::SDL_RenderReadPixels(sdl_renderer, NULL, 0, winpixels.data(), pitch);
         if (ret < 0) {
             debuglog(LCF_DUMP | LCF_SDL | LCF_ERROR, "SDL_RenderReadPixels failed: ", orig::SDL_GetError());
         }
-        void* tex_pixels;
-        int tex_pitch;
-        orig::SDL_LockTexture(screenSDLTex, nullptr, &tex_pixels, &tex_pitch);
-        memcpy(tex_pixels, winpixels.data(), size);
-        orig::SDL_UnlockTexture(screenSDLTex);
     }
 
     else if (game_info.video & GameInfo::SDL2_SURFACE) {
@@ -465,32 +609,61 @@ int ScreenCapture::getPixels(uint8_t **pixels, bool draw)
         LINK_NAMESPACE(glDisable, "GL");
         LINK_NAMESPACE(glIsEnabled, "GL");
 
-        /* Copy the default framebuffer to our FBO */
+        /* Copy the default framebuffer to our FBO, flipping it vertically
+         * in the blit. OpenGL stores rows bottom-up, and doing the flip on
+         * the GPU here is free, where reversing the rows on the CPU after
+         * the readback costs a pass over the whole frame */
         GLboolean isFramebufferSrgb = orig::glIsEnabled(GL_FRAMEBUFFER_SRGB);
         if (isFramebufferSrgb)
             orig::glDisable(GL_FRAMEBUFFER_SRGB);
         orig::glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
         orig::glBindFramebuffer(GL_DRAW_FRAMEBUFFER, screenFBO);
-        orig::glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        orig::glBlitFramebuffer(0, 0, width, height, 0, height, width, 0, GL_COLOR_BUFFER_BIT, GL_NEAREST);
         orig::glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
         if (pixels) {
 
             /* We need to recover the pixels for encoding */
             orig::glBindFramebuffer(GL_READ_FRAMEBUFFER, screenFBO);
-            orig::glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, glpixels.data());
-            orig::glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
 
-            /*
-             * Flip image horizontally
-             * This is because OpenGL has a different reference point
-             * Code taken from http://stackoverflow.com/questions/5862097/sdl-opengl-screenshot-is-black
-             */
-
-            for (int line = 0; line < height; line++) {
-                int pos = line * pitch;
-                memcpy(&winpixels[pos], &glpixels[(size-pos)-pitch], pitch);
+            if (screenPBOs[0] != 0) {
+                LINK_NAMESPACE(glBindBuffer, "GL");
+                LINK_NAMESPACE(glMapBuffer, "GL");
+                LINK_NAMESPACE(glUnmapBuffer, "GL");
+
+                /* Issue the readback of this frame into the current PBO.
+                 * With a buffer bound to GL_PIXEL_PACK_BUFFER, glReadPixels
+                 * returns immediately and the transfer completes behind the
+                 * next frame's rendering */
+                orig::glBindBuffer(GL_PIXEL_PACK_BUFFER, screenPBOs[pboIndex]);
+                orig::glReadPixels(0, 0, width, height, glReadFormat, GL_UNSIGNED_BYTE, nullptr);
+
+                /* Map the other PBO, which holds the previous frame. The
+                 * one-frame delay is fine for encoding. On the first capture
+                 * there is no previous frame, so we map the readback just
+                 * issued, which waits for it like the synchronous path did */
+                const int mapIndex = pboPending ? (1 - pboIndex) : pboIndex;
+                orig::glBindBuffer(GL_PIXEL_PACK_BUFFER, screenPBOs[mapIndex]);
+                const uint8_t* glp = static_cast<const uint8_t*>(orig::glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY));
+
+                if (glp) {
+                    /* The FBO was flipped during the blit, so rows are
+                     * already top-down */
+                    memcpy(winpixels.data(), glp, size);
+                    orig::glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+                }
+                orig::glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+                pboPending = true;
+                pboIndex = 1 - pboIndex;
+            }
+            else {
+                /* The FBO was flipped during the blit, so we can read
+                 * straight into the output array */
+                orig::glReadPixels(0, 0, width, height, glReadFormat, GL_UNSIGNED_BYTE, winpixels.data());
             }
+
+            orig::glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
         }
 
         if (isFramebufferSrgb)
@@ -552,6 +725,19 @@ int ScreenCapture::setPixels() {
 
     if (game_info.video & GameInfo::SDL2_RENDERER) {
         LINK_NAMESPACE_SDL2(SDL_RenderCopy);
+        LINK_NAMESPACE_SDL2(SDL_LockTexture);
+        LINK_NAMESPACE_SDL2(SDL_UnlockTexture);
+
+        /* Upload the stored frame into the backup texture. Done here
+         * rather than at capture time: redraws are rare, and the texture
+         * lives on the GPU, so after a state load it would hold the
+         * pre-load frame while winpixels was restored by the state. */
+        void* tex_pixels;
+        int tex_pitch;
+        if (orig::SDL_LockTexture(screenSDLTex, nullptr, &tex_pixels, &tex_pitch) == 0) {
+            memcpy(tex_pixels, winpixels.data(), size);
+            orig::SDL_UnlockTexture(screenSDLTex);
+        }
 
         int ret;
 
@@ -592,7 +778,9 @@ int ScreenCapture::setPixels() {
             orig::glDisable(GL_FRAMEBUFFER_SRGB);
         orig::glBindFramebuffer(GL_READ_FRAMEBUFFER, screenFBO);
         orig::glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
-        orig::glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        /* The FBO content is stored flipped, flipping again in this blit
+         * restores the screen orientation */
+        orig::glBlitFramebuffer(0, 0, width, height, 0, height, width, 0, GL_COLOR_BUFFER_BIT, GL_NEAREST);
         orig::glBindFramebuffer(GL_FRAMEBUFFER, 0);
         if (isFramebufferSrgb)
             orig::glEnable(GL_FRAMEBUFFER_SRGB);
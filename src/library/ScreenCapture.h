@@ -53,7 +53,17 @@ void getDimensions(int& w, int& h);
 /* Get the pixel format as an string used by nut muxer. */
 const char* getPixelFormat();
 
-/* Capture the pixels from the screen. */
+/* Get the byte offsets of the color channels inside a stored pixel, for
+ * consumers that convert the pixels themselves.
+ * Returns the pixel size in bytes, or -1 if the format is not byte-aligned.
+ */
+int getPixelLayout(int& r_off, int& g_off, int& b_off);
+
+/* Capture the pixels from the screen.
+ * For OpenGL games the captured frame is retained GPU-side in a
+ * framebuffer object, so capturing for a later restore involves no
+ * readback at all.
+ */
 int storePixels();
 
 /* Capture the pixels from the screen and copy a pointer to this array into pixels.
@@ -61,7 +71,11 @@ int storePixels();
  */
 int getPixels(uint8_t **pixels, bool draw);
 
-/* Set the screen pixels from our buffers. */
+/* Set the screen pixels from our buffers. Used to redraw the screen on
+ * non-drawing frames and under OSD overlays. For OpenGL games this is a
+ * single GPU-to-GPU blit from the capture framebuffer, so paused redraws
+ * and frame-advance stepping never touch the bus.
+ */
 int setPixels();
 
 }
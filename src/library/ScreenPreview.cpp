@@ -0,0 +1,176 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ScreenPreview.h"
+#include "ScreenCapture.h"
+#include "GlobalState.h"
+#include "logging.h"
+#include "sealedmemfd.h"
+#include "../shared/previewbuffer.h"
+#include "../shared/messages.h"
+#include "../shared/sockethelpers.h"
+
+#include <atomic>
+#include <cstring>
+#include <vector>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace libtas {
+namespace ScreenPreview {
+
+/* Publish every this many drawn frames. Counting frames instead of time
+ * keeps the publisher deterministic, and drawn frames are already sparse
+ * during fast-forward. */
+#define PREVIEW_INTERVAL 3
+
+static PreviewBuffer* buffer = nullptr;
+
+/* Previously published frame, to compute the dirty row range */
+static std::vector<uint32_t> prev_pixels;
+
+/* Number of publish calls, to apply the interval */
+static unsigned int drawn_count = 0;
+
+void init()
+{
+    int fd = makeSealedMemfd("libtas-preview", sizeof(PreviewBuffer));
+    if (fd < 0) {
+        debuglog(LCF_WINDOW | LCF_ERROR, "Could not create the preview buffer");
+        return;
+    }
+
+    void* map = mmap(nullptr, sizeof(PreviewBuffer), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        NATIVECALL(close(fd));
+        return;
+    }
+
+    buffer = static_cast<PreviewBuffer*>(map);
+    memset(buffer, 0, sizeof(PreviewBuffer));
+    buffer->version = PREVIEW_VERSION;
+    memcpy(buffer->magic, PREVIEW_MAGIC, 4);
+
+    /* Hand the buffer to the program. The mapping holds its own reference
+     * to the memfd, so the descriptor can be closed once sent. */
+    sendMessage(MSGB_PREVIEW_FD);
+    sendFd(fd);
+    NATIVECALL(close(fd));
+
+    debuglog(LCF_WINDOW, "Created and sent the preview buffer");
+}
+
+void publish(uint64_t framecount)
+{
+    if ((drawn_count++ % PREVIEW_INTERVAL) != 0)
+        return;
+
+    uint8_t* pixels = nullptr;
+    int size = ScreenCapture::getPixels(&pixels, false);
+    if ((size <= 0) || !pixels)
+        return;
+
+    int r_off, g_off, b_off;
+    int pixel_size = ScreenCapture::getPixelLayout(r_off, g_off, b_off);
+    if (pixel_size < 0)
+        return;
+
+    int width, height;
+    ScreenCapture::getDimensions(width, height);
+    if ((width <= 0) || (height <= 0))
+        return;
+
+    if (!buffer)
+        return;
+
+    /* Downscale by the smallest integer factor that fits the buffer */
+    int factor = 1;
+    while ((width / factor > PREVIEW_MAXWIDTH) || (height / factor > PREVIEW_MAXHEIGHT))
+        factor++;
+
+    int out_width = width / factor;
+    int out_height = height / factor;
+
+    /* On a resize, publish the new dimensions and a full frame */
+    if ((buffer->width != out_width) || (buffer->height != out_height)) {
+        buffer->width = out_width;
+        buffer->height = out_height;
+        prev_pixels.clear();
+    }
+    bool full_frame = prev_pixels.empty();
+    prev_pixels.resize(static_cast<size_t>(out_width) * out_height);
+
+    PreviewSlot* slot = &buffer->frame_slots[(buffer->latest + 1) % 3];
+
+    /* An odd sequence number marks the slot as inconsistent while the rows
+     * are written */
+    slot->seq++;
+    std::atomic_thread_fence(std::memory_order_release);
+
+    /* Sample one pixel per output pixel and convert to 0xffRRGGBB, keeping
+     * track of the rows that changed since the previous published frame */
+    int pitch = width * pixel_size;
+    uint32_t dirty_first = out_height;
+    uint32_t dirty_last = 0;
+
+    for (int y = 0; y < out_height; y++) {
+        const uint8_t* src_row = pixels + static_cast<size_t>(y) * factor * pitch;
+        uint32_t* out_row = slot->pixels + static_cast<size_t>(y) * out_width;
+        uint32_t* prev_row = prev_pixels.data() + static_cast<size_t>(y) * out_width;
+
+        bool row_dirty = full_frame;
+        for (int x = 0; x < out_width; x++) {
+            const uint8_t* src = src_row + static_cast<size_t>(x) * factor * pixel_size;
+            uint32_t pixel = 0xff000000 | (src[r_off] << 16) | (src[g_off] << 8) | src[b_off];
+            out_row[x] = pixel;
+            if (prev_row[x] != pixel) {
+                prev_row[x] = pixel;
+                row_dirty = true;
+            }
+        }
+
+        if (row_dirty) {
+            if (static_cast<uint32_t>(y) < dirty_first)
+                dirty_first = y;
+            dirty_last = y;
+        }
+    }
+
+    slot->dirty_first = dirty_first;
+    slot->dirty_last = dirty_last;
+    slot->framecount = framecount;
+
+    /* Close the slot and only then point readers at it */
+    std::atomic_thread_fence(std::memory_order_release);
+    slot->seq++;
+    std::atomic_thread_fence(std::memory_order_release);
+    buffer->latest = slot - buffer->frame_slots;
+}
+
+void fini()
+{
+    if (!buffer)
+        return;
+
+    munmap(buffer, sizeof(PreviewBuffer));
+    buffer = nullptr;
+}
+
+}
+}
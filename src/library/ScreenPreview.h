@@ -0,0 +1,50 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_SCREENPREVIEW_H_INCL
+#define LIBTAS_SCREENPREVIEW_H_INCL
+
+#include <stdint.h>
+
+namespace libtas {
+
+/* Publisher of downscaled game frames into the shared-memory preview
+ * buffer described in shared/previewbuffer.h, so the preview pane of the
+ * program can display the game during fast-forward without a rendering
+ * context. The buffer is lock-free on both sides and the downscale runs
+ * on a small fraction of the drawn frames, so publishing costs a
+ * negligible fraction of the frame even at headless replay speed. */
+namespace ScreenPreview {
+
+/* Create the buffer as a sealed memfd and pass it to the program over
+ * the socket. Must be called during the init handshake. */
+void init();
+
+/* Publish a downscaled copy of the pixels stored by ScreenCapture, if the
+ * publishing interval has elapsed. Must be called at a frame boundary,
+ * after the screen pixels have been stored. */
+void publish(uint64_t framecount);
+
+/* Unmap the shared-memory buffer */
+void fini();
+
+}
+}
+
+#endif
@@ -0,0 +1,148 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SlotInfo.h"
+#include "ScreenCapture.h"
+#include "DeterministicTimer.h"
+#include "GlobalState.h"
+#include "logging.h"
+#include "sealedmemfd.h"
+#include "../shared/slotinfobuffer.h"
+#include "../shared/messages.h"
+#include "../shared/sockethelpers.h"
+
+#include <atomic>
+#include <cstring>
+#include <ctime>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace libtas {
+namespace SlotInfo {
+
+static SlotInfoBuffer* buffer = nullptr;
+
+void init()
+{
+    int fd = makeSealedMemfd("libtas-slotinfo", sizeof(SlotInfoBuffer));
+    if (fd < 0) {
+        debuglog(LCF_CHECKPOINT | LCF_ERROR, "Could not create the slot info buffer");
+        return;
+    }
+
+    void* map = mmap(nullptr, sizeof(SlotInfoBuffer), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        NATIVECALL(close(fd));
+        return;
+    }
+
+    buffer = static_cast<SlotInfoBuffer*>(map);
+    memset(buffer, 0, sizeof(SlotInfoBuffer));
+    buffer->version = SLOTINFO_VERSION;
+    memcpy(buffer->magic, SLOTINFO_MAGIC, 4);
+
+    /* Hand the buffer to the program. The mapping holds its own reference
+     * to the memfd, so the descriptor can be closed once sent. */
+    sendMessage(MSGB_SLOTINFO_FD);
+    sendFd(fd);
+    NATIVECALL(close(fd));
+
+    debuglog(LCF_CHECKPOINT, "Created and sent the slot info buffer");
+}
+
+void publish(int slot, uint64_t framecount)
+{
+    if ((slot < 0) || (slot >= SLOTINFO_SLOTS))
+        return;
+
+    if (!buffer)
+        return;
+
+    SlotInfoEntry* entry = &buffer->entries[slot];
+
+    /* An odd sequence number marks the entry as inconsistent while it is
+     * written */
+    entry->seq++;
+    std::atomic_thread_fence(std::memory_order_release);
+
+    entry->framecount = framecount;
+
+    struct timespec ticks = detTimer.getTicks();
+    entry->game_time_sec = ticks.tv_sec;
+    entry->game_time_nsec = ticks.tv_nsec;
+
+    struct timespec now;
+    NATIVECALL(clock_gettime(CLOCK_REALTIME, &now));
+    entry->save_time = now.tv_sec;
+
+    /* The thumbnail is sampled from the pixels stored at this boundary.
+     * When no pixels are available (e.g. the game did not render yet), the
+     * metadata is still published with an empty thumbnail. */
+    entry->width = 0;
+    entry->height = 0;
+
+    uint8_t* pixels = nullptr;
+    int size = ScreenCapture::getPixels(&pixels, false);
+    int r_off, g_off, b_off;
+    int pixel_size = ScreenCapture::getPixelLayout(r_off, g_off, b_off);
+    int width = 0, height = 0;
+    ScreenCapture::getDimensions(width, height);
+
+    if ((size > 0) && pixels && (pixel_size > 0) && (width > 0) && (height > 0)) {
+        /* Downscale by the smallest integer factor that fits the entry */
+        int factor = 1;
+        while ((width / factor > SLOTINFO_MAXWIDTH) || (height / factor > SLOTINFO_MAXHEIGHT))
+            factor++;
+
+        int out_width = width / factor;
+        int out_height = height / factor;
+
+        /* Sample one pixel per output pixel and convert to 0xffRRGGBB */
+        int pitch = width * pixel_size;
+        for (int y = 0; y < out_height; y++) {
+            const uint8_t* src_row = pixels + static_cast<size_t>(y) * factor * pitch;
+            uint32_t* out_row = entry->pixels + static_cast<size_t>(y) * out_width;
+            for (int x = 0; x < out_width; x++) {
+                const uint8_t* src = src_row + static_cast<size_t>(x) * factor * pixel_size;
+                out_row[x] = 0xff000000 | (src[r_off] << 16) | (src[g_off] << 8) | src[b_off];
+            }
+        }
+
+        entry->width = out_width;
+        entry->height = out_height;
+    }
+
+    entry->valid = 1;
+
+    /* Close the entry */
+    std::atomic_thread_fence(std::memory_order_release);
+    entry->seq++;
+}
+
+void fini()
+{
+    if (!buffer)
+        return;
+
+    munmap(buffer, sizeof(SlotInfoBuffer));
+    buffer = nullptr;
+}
+
+}
+}
@@ -0,0 +1,49 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_SLOTINFO_H_INCL
+#define LIBTAS_SLOTINFO_H_INCL
+
+#include <stdint.h>
+
+namespace libtas {
+
+/* Publisher of per-slot savestate information into the shared-memory
+ * buffer described in shared/slotinfobuffer.h, so the program can show
+ * the frame, the time and a thumbnail of every numbered slot without
+ * loading anything. Publishing happens once per manual savestate, so its
+ * cost does not matter at the frame boundary. */
+namespace SlotInfo {
+
+/* Create the buffer as a sealed memfd and pass it to the program over
+ * the socket. Must be called during the init handshake. */
+void init();
+
+/* Publish the information of the state just saved into a numbered slot.
+ * Must be called at a frame boundary, after the screen pixels have been
+ * stored. Indices outside the numbered slots are ignored. */
+void publish(int slot, uint64_t framecount);
+
+/* Unmap the shared-memory buffer */
+void fini();
+
+}
+}
+
+#endif
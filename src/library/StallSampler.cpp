@@ -0,0 +1,325 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "StallSampler.h"
+#include "backtrace.h"
+#include "logging.h"
+#include "frame.h" // framecount
+#include "checkpoint/ThreadManager.h"
+#include "checkpoint/ThreadInfo.h"
+#include "checkpoint/ReservedMemory.h"
+#ifdef LIBTAS_ENABLE_HUD
+#include "renderhud/RenderHUD.h"
+#endif
+
+#include <execinfo.h>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <map>
+#include <string>
+
+namespace libtas {
+namespace StallSampler {
+
+/* A frame boundary longer than this is considered a stall. Loading a large
+ * savestate can legitimately take longer, but its threads have every signal
+ * blocked while suspended, so those boundaries produce no samples. */
+static const uint64_t STALL_BUDGET_NS = 500*1000*1000;
+
+/* Period of the watchdog timer while boundaries complete in time */
+static const uint64_t WATCH_TICK_NS = 20*1000*1000;
+
+/* Period of the stack sampling during a stall */
+static const uint64_t SAMPLE_INTERVAL_NS = 10*1000*1000;
+
+/* How long to wait for the handler of a sampled thread before giving up.
+ * A thread that blocks every signal (suspended for a savestate) never
+ * answers. */
+static const uint64_t CAPTURE_TIMEOUT_NS = 5*1000*1000;
+
+#define MAXDEPTH 48
+#define MAXSAMPLES 3072
+#define WATCHDOG_STACK_SIZE (64*1024)
+
+struct Sample {
+    pid_t tid;
+    int depth;
+    void* addrs[MAXDEPTH];
+};
+
+/* State shared between the game threads and the watchdog, living in
+ * reserved memory so that it is excluded from savestates and survives
+ * state loadings */
+struct StallShared {
+    /* Set while a frame boundary is in progress, with its start time */
+    int armed;
+    uint64_t arm_time;
+
+    /* Set by the watchdog around a sampling round */
+    int sampling;
+
+    /* Set by the watchdog once a stalled boundary has samples */
+    int report_pending;
+
+    /* Watchdog process and the game pid it watches */
+    pid_t watchdog_pid;
+    pid_t game_pid;
+
+    /* Capture slot filled by the signal handler of the sampled thread.
+     * capture_tid names the thread expected to answer, so a handler
+     * delivered after its capture timed out is ignored. */
+    pid_t capture_tid;
+    volatile int capture_done;
+    int capture_depth;
+    void* capture_addrs[MAXDEPTH];
+
+    int sample_count;
+    Sample samples[MAXSAMPLES];
+
+    char stack[WATCHDOG_STACK_SIZE];
+};
+
+static_assert(sizeof(StallShared) <= ReservedMemory::STALL_SIZE, "StallShared must fit in its reserved memory segment");
+
+static StallShared* shared()
+{
+    return static_cast<StallShared*>(ReservedMemory::getAddr(ReservedMemory::STALL_ADDR));
+}
+
+/* Raw syscall timestamp, usable from the TLS-free watchdog */
+static uint64_t rawNow()
+{
+    struct timespec ts;
+    syscall(SYS_clock_gettime, CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1000000000ULL + ts.tv_nsec;
+}
+
+/* Raw syscall sleep, usable from the TLS-free watchdog */
+static void sleepNs(uint64_t ns)
+{
+    struct timespec ts;
+    ts.tv_sec = ns / 1000000000ULL;
+    ts.tv_nsec = ns % 1000000000ULL;
+    syscall(SYS_nanosleep, &ts, nullptr);
+}
+
+/* SIGPROF handler capturing the stack of the sampled thread. backtrace()
+ * does not allocate after the warm-up call done at watchdog start, so it
+ * is as signal-safe as in every sampling profiler. */
+static void profileHandler(int signum)
+{
+    StallShared* s = shared();
+
+    /* Drop stale signals from a capture that timed out */
+    if (static_cast<pid_t>(syscall(SYS_gettid)) != s->capture_tid)
+        return;
+
+    s->capture_depth = backtrace(s->capture_addrs, MAXDEPTH);
+    __atomic_store_n(&s->capture_done, 1, __ATOMIC_RELEASE);
+}
+
+/* Sample the stack of one thread, returning whether its handler answered */
+static bool sampleThread(StallShared* s, pid_t tid)
+{
+    s->capture_tid = tid;
+    s->capture_depth = 0;
+    __atomic_store_n(&s->capture_done, 0, __ATOMIC_RELEASE);
+
+    if (syscall(SYS_tgkill, s->game_pid, tid, SIGPROF) != 0)
+        return false;
+
+    const uint64_t deadline = rawNow() + CAPTURE_TIMEOUT_NS;
+    while (!__atomic_load_n(&s->capture_done, __ATOMIC_ACQUIRE)) {
+        if (rawNow() > deadline)
+            return false;
+        sched_yield();
+    }
+    return true;
+}
+
+/* Watch the frame boundary duration, and sample all registered threads for
+ * the duration of a stall. Must stay TLS-free, because it runs in a cloned
+ * worker (no NATIVECALL, no logging). */
+static int watchdogLoop(void*)
+{
+    StallShared* s = shared();
+
+    while (true) {
+        /* Exit with the game: our parent changes when it dies */
+        if (static_cast<pid_t>(syscall(SYS_getppid)) != s->game_pid)
+            return 0;
+
+        sleepNs(WATCH_TICK_NS);
+
+        if (!__atomic_load_n(&s->armed, __ATOMIC_ACQUIRE))
+            continue;
+        if (rawNow() - s->arm_time < STALL_BUDGET_NS)
+            continue;
+
+        /* The boundary blew its budget: sample every registered thread
+         * until it completes. The thread list is readable without its
+         * lock, and unlinked nodes are never freed while a reader can
+         * stand on them. */
+        __atomic_store_n(&s->sampling, 1, __ATOMIC_RELEASE);
+        while (__atomic_load_n(&s->armed, __ATOMIC_ACQUIRE) &&
+               (s->sample_count < MAXSAMPLES)) {
+            for (ThreadInfo* th = ThreadManager::thread_list; th; th = th->next) {
+                if (!th->tid)
+                    continue;
+                if ((th->state != ThreadInfo::ST_RUNNING) &&
+                    (th->state != ThreadInfo::ST_SIGNALED))
+                    continue;
+                if (s->sample_count >= MAXSAMPLES)
+                    break;
+
+                if (!sampleThread(s, th->tid))
+                    continue;
+
+                /* Store it, skipping the handler and trampoline frames */
+                const int skip = (s->capture_depth > 2) ? 2 : 0;
+                Sample* sample = &s->samples[s->sample_count];
+                sample->tid = th->tid;
+                sample->depth = s->capture_depth - skip;
+                memcpy(sample->addrs, s->capture_addrs + skip, sample->depth * sizeof(void*));
+                __atomic_store_n(&s->sample_count, s->sample_count + 1, __ATOMIC_RELEASE);
+                __atomic_store_n(&s->report_pending, 1, __ATOMIC_RELEASE);
+            }
+            sleepNs(SAMPLE_INTERVAL_NS);
+        }
+        __atomic_store_n(&s->sampling, 0, __ATOMIC_RELEASE);
+    }
+}
+
+static void startWatchdog(StallShared* s)
+{
+    /* Install our SIGPROF handler. A game installing its own handler over
+     * it would only lose us the samples. */
+    struct sigaction sigprof;
+    sigfillset(&sigprof.sa_mask);
+    sigprof.sa_flags = SA_RESTART;
+    sigprof.sa_handler = profileHandler;
+    {
+        GlobalNative gn;
+        MYASSERT(sigaction(SIGPROF, &sigprof, nullptr) == 0)
+    }
+
+    /* Warm up the unwinder: the first backtrace() call loads libgcc,
+     * which must not happen inside the signal handler */
+    void* warmup[MAXDEPTH];
+    backtrace(warmup, MAXDEPTH);
+
+    NATIVECALL(s->game_pid = getpid());
+
+    s->watchdog_pid = clone(watchdogLoop, s->stack + WATCHDOG_STACK_SIZE,
+        CLONE_VM | CLONE_FS | CLONE_FILES, nullptr);
+    if (s->watchdog_pid == -1) {
+        debuglogstdio(LCF_ERROR, "Could not clone the stall watchdog");
+        s->watchdog_pid = 0;
+        return;
+    }
+
+    debuglogstdio(LCF_INFO, "Stall watchdog started");
+}
+
+/* Aggregate the samples into a collapsed-stack file next to the game, and
+ * tell the user about it. Runs in the game thread in normal context. */
+static void writeReport(StallShared* s)
+{
+    /* Let a sampling round in progress finish, with a deadline in case
+     * the watchdog died */
+    const uint64_t deadline = rawNow() + 200*1000*1000;
+    while (__atomic_load_n(&s->sampling, __ATOMIC_ACQUIRE)) {
+        if (rawNow() > deadline)
+            break;
+        NATIVECALL(usleep(1000));
+    }
+
+    const int count = __atomic_load_n(&s->sample_count, __ATOMIC_ACQUIRE);
+
+    /* Fold identical stacks, rooted at the thread id so per-thread flames
+     * stay apart */
+    std::map<std::string, int> folded;
+    for (int i = 0; i < count; i++) {
+        const Sample* sample = &s->samples[i];
+        std::string line = "thread-" + std::to_string(sample->tid);
+        for (int d = sample->depth - 1; d >= 0; d--) {
+            line += ';';
+            line += symbolizeAddress(sample->addrs[d]);
+        }
+        folded[line]++;
+    }
+
+    char filename[64];
+    snprintf(filename, sizeof(filename), "libtas-stall-%lu.folded", framecount);
+
+    {
+        GlobalNative gn;
+        FILE* f = fopen(filename, "w");
+        if (f) {
+            for (const auto& stack : folded) {
+                fprintf(f, "%s %d\n", stack.first.c_str(), stack.second);
+            }
+            fclose(f);
+        }
+    }
+
+    debuglogstdio(LCF_WARNING | LCF_ALERT, "Frame boundary stalled, %d stack samples written to %s", count, filename);
+#ifdef LIBTAS_ENABLE_HUD
+    char message[96];
+    snprintf(message, sizeof(message), "Stall detected, profile written to %s", filename);
+    RenderHUD::insertMessage(message);
+#endif
+
+    s->sample_count = 0;
+    __atomic_store_n(&s->report_pending, 0, __ATOMIC_RELEASE);
+}
+
+void arm()
+{
+    StallShared* s = shared();
+
+    if (!s->watchdog_pid) {
+        startWatchdog(s);
+        if (!s->watchdog_pid)
+            return;
+    }
+
+    s->arm_time = rawNow();
+    __atomic_store_n(&s->armed, 1, __ATOMIC_RELEASE);
+}
+
+void disarm()
+{
+    StallShared* s = shared();
+
+    if (!s->watchdog_pid)
+        return;
+
+    __atomic_store_n(&s->armed, 0, __ATOMIC_RELEASE);
+
+    if (__atomic_load_n(&s->report_pending, __ATOMIC_ACQUIRE))
+        writeReport(s);
+}
+
+}
+}
@@ -0,0 +1,50 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_STALLSAMPLER_H_INCL
+#define LIBTAS_STALLSAMPLER_H_INCL
+
+namespace libtas {
+
+/* Watchdog sampling the stacks of all registered threads when a frame
+ * boundary exceeds its latency budget, so that a hitch in production
+ * (encoder backpressure, checkpoint contention, a stuck wait) leaves a
+ * collapsed-stack file behind instead of requiring a gdb attach while it
+ * happens.
+ *
+ * The watchdog is a cloned process like the encoder write worker, parked
+ * on a timer while boundaries complete in time. Once the budget is blown
+ * it interrupts each thread with SIGPROF, whose handler captures the
+ * stack through the cached unwinder of backtrace.cpp. The report is
+ * written by the game thread when the stalled boundary finally completes.
+ * All the shared state lives in reserved memory, so neither the samples
+ * nor the watchdog stack take part in savestates.
+ */
+namespace StallSampler {
+
+    /* Arm the watchdog at the start of a frame boundary */
+    void arm();
+
+    /* Disarm the watchdog at the end of the frame boundary, and write the
+     * collapsed-stack report if the boundary stalled */
+    void disarm();
+}
+}
+
+#endif
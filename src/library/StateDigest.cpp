@@ -0,0 +1,184 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "StateDigest.h"
+#include "ScreenCapture.h"
+#include "global.h"
+#include "checkpoint/ProcSelfMaps.h"
+#include "checkpoint/ProcMapsArea.h"
+#include "checkpoint/ReservedMemory.h"
+
+#include <cstring>
+#include <sys/mman.h>
+
+namespace libtas {
+namespace StateDigest {
+
+/* Number of pages sampled per frame. At one cache line per page, a frame
+ * touches at most 128 kB of scattered memory, which stays well below one
+ * percent of a 60 fps frame even when every access misses the cache. */
+#define DIGEST_PAGES_PER_FRAME 2048
+
+/* One 8-byte word of the stored framebuffer is hashed every this many
+ * bytes, so a 1080p frame contributes about 32k sequential samples. */
+#define DIGEST_FB_STRIDE 256
+
+/* xxHash64 mixing constants, same as the savestate page store */
+#define PRIME64_1 11400714785074694791ULL
+#define PRIME64_2 14029467366897019727ULL
+#define PRIME64_3  1609587929392839161ULL
+#define PRIME64_5  2870177450012600261ULL
+
+static inline uint64_t rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t round64(uint64_t acc, uint64_t input)
+{
+    acc += input * PRIME64_2;
+    acc = rotl64(acc, 31);
+    acc *= PRIME64_1;
+    return acc;
+}
+
+/* Which areas take part in the digest. This mirrors the checkpoint area
+ * filter, restricted to what holds deterministic game state. */
+static bool digestArea(const Area *area)
+{
+    if (area->size == 0)
+        return false;
+
+    if (!(area->prot & PROT_WRITE))
+        return false;
+
+    /* Shared mappings can be written by the X server or the GPU behind the
+     * game's back, so their content is not part of the replayable state */
+    if (area->flags & MAP_SHARED)
+        return false;
+
+    /* Our own reserved memory and the shared ring are not game state */
+    if ((area->addr == ReservedMemory::getAddr(0)) && (area->size == ReservedMemory::getSize()))
+        return false;
+
+    if (strstr(area->name, "libtas-ring"))
+        return false;
+
+    return true;
+}
+
+/* Hash one cache line at the start of each page in the global page index
+ * range [first, first+count), and advance the accumulator. Returns the
+ * number of pages actually hashed. */
+static uint64_t hashPageRange(ProcSelfMaps &procSelfMaps, uint64_t first,
+                              uint64_t count, uint64_t *total, uint64_t *h)
+{
+    Area area;
+    uint64_t index = 0;
+    uint64_t hashed = 0;
+
+    while (procSelfMaps.getNextArea(&area)) {
+        if (!digestArea(&area)) {
+            continue;
+        }
+
+        uint64_t pages = area.size / 4096;
+
+        if ((hashed < count) && (index + pages > first)) {
+            uint64_t p = (index > first) ? 0 : (first - index);
+            for (; (p < pages) && (hashed < count); p++, hashed++) {
+                const uint64_t* w = reinterpret_cast<const uint64_t*>(
+                    static_cast<char*>(area.addr) + p * 4096);
+
+                /* Mix the address in, so that a page moving without changing
+                 * content is also flagged */
+                *h = round64(*h, reinterpret_cast<uintptr_t>(w));
+                for (int i = 0; i < 8; i++) {
+                    *h = round64(*h, w[i]);
+                }
+            }
+        }
+
+        index += pages;
+    }
+
+    *total = index;
+    return hashed;
+}
+
+uint64_t compute(uint64_t framecount)
+{
+    /* Global page index where the sampling window starts this frame. Being
+     * plain data of our library, it is saved and restored with savestates,
+     * so the digest sequence is reproduced exactly across rewinds.
+     *
+     * Note that game threads are not suspended at the frame boundary: a
+     * game writing memory from a thread that is not synchronized with the
+     * frame can make a sampled page racy and flag a false divergence. Such
+     * a game is unlikely to replay deterministically in the first place. */
+    static uint64_t scan_page = 0;
+
+    /* Seed with the frame number, so that identical memory content on two
+     * different frames still yields distinct digests */
+    uint64_t h = PRIME64_5 + framecount * PRIME64_2;
+
+    ProcSelfMaps procSelfMaps(ReservedMemory::getAddr(ReservedMemory::PSM_ADDR), ReservedMemory::PSM_SIZE);
+
+    uint64_t total = 0;
+    uint64_t hashed = hashPageRange(procSelfMaps, scan_page, DIGEST_PAGES_PER_FRAME, &total, &h);
+
+    /* Wrap the window around the start of the address space when it ran
+     * past the last writable page */
+    if ((hashed < DIGEST_PAGES_PER_FRAME) && (scan_page > 0)) {
+        uint64_t remaining = DIGEST_PAGES_PER_FRAME - hashed;
+        if (remaining > scan_page)
+            remaining = scan_page;
+        procSelfMaps.reset();
+        hashPageRange(procSelfMaps, 0, remaining, &total, &h);
+    }
+
+    scan_page = (total > 0) ? ((scan_page + DIGEST_PAGES_PER_FRAME) % total) : 0;
+
+    /* Hash a strided sample of the stored framebuffer. The pixels of the
+     * current frame are stored later in the boundary, so this covers the
+     * previous drawn frame, which is just as deterministic. */
+    if (shared_config.save_screenpixels) {
+        uint8_t* pixels = nullptr;
+        int size = ScreenCapture::getPixels(&pixels, false);
+        if (pixels && (size > 0)) {
+            for (int off = 0; off + 8 <= size; off += DIGEST_FB_STRIDE) {
+                uint64_t w;
+                memcpy(&w, pixels + off, 8);
+                h = round64(h, w);
+            }
+            h = round64(h, size);
+        }
+    }
+
+    /* Final avalanche, as in xxHash64 */
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+}
+}
@@ -0,0 +1,50 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIBTAS_STATEDIGEST_H
+#define LIBTAS_STATEDIGEST_H
+
+#include <cstdint>
+
+namespace libtas {
+
+/* Sampled digest of the game state, computed at each frame boundary when
+ * enabled and sent to the program, which records it in the movie. Replaying
+ * a movie that carries digests pinpoints the exact first divergent frame,
+ * instead of eyeballing an encode for the moment a desync becomes visible.
+ *
+ * Hashing all of the game memory every frame would dwarf the frame itself,
+ * so each frame samples one cache line per page from a fixed-size window of
+ * the writable areas, and the window rotates across frames until it wraps.
+ * A single corrupted byte is only caught when its page comes around, but a
+ * diverging game state drifts further every frame, so the first flagged
+ * frame lands within one rotation of the true divergence point. The window
+ * cursor lives in our data segment, so it is saved and restored with the
+ * savestates and the digest sequence stays deterministic across rewinds.
+ */
+namespace StateDigest {
+
+    /* Compute the digest for the frame that just ended. Must be called at a
+     * frame boundary, because it borrows the reserved /proc/self/maps buffer
+     * of the checkpoint code. */
+    uint64_t compute(uint64_t framecount);
+}
+}
+
+#endif
@@ -0,0 +1,122 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "TaskPool.h"
+#include "logging.h"
+#include <unistd.h>
+#include <sched.h>
+#include <sys/wait.h>
+
+namespace libtas {
+
+namespace TaskPool {
+
+/* Shared state of one run() call */
+struct Job {
+    void (*func)(void* arg, int i);
+    void* arg;
+    int count;
+    int next; /* next task index, fetched atomically by workers */
+};
+
+static int taskWorker(void* arg)
+{
+    Job* job = static_cast<Job*>(arg);
+
+    while (true) {
+        int i = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED);
+        if (i >= job->count)
+            break;
+        job->func(job->arg, i);
+    }
+    return 0;
+}
+
+void runOnStacks(void (*func)(void* arg, int i), void* arg, int count,
+                 char* stacks, size_t stacks_size, int max_workers)
+{
+    if (count <= 0)
+        return;
+
+    long nprocs = sysconf(_SC_NPROCESSORS_ONLN);
+    int nb_workers = (nprocs > max_workers) ? max_workers : static_cast<int>(nprocs);
+    if (nb_workers > count)
+        nb_workers = count;
+
+    Job job;
+    job.func = func;
+    job.arg = arg;
+    job.count = count;
+    job.next = 0;
+
+    if (nb_workers < 2) {
+        taskWorker(&job);
+        return;
+    }
+
+    /* The calling thread acts as one of the workers */
+    pid_t workers[nb_workers];
+    size_t stack_size = stacks_size / max_workers;
+
+    int w;
+    for (w = 0; w < nb_workers - 1; w++) {
+        /* Stacks grow down, pass the top of each worker stack slot */
+        char* stack_top = stacks + (w+1) * stack_size;
+        workers[w] = clone(taskWorker, stack_top, CLONE_VM | CLONE_FS | CLONE_FILES, &job);
+        if (workers[w] == -1) {
+            debuglogstdio(LCF_ERROR, "Could not clone a task worker");
+            break;
+        }
+    }
+
+    taskWorker(&job);
+
+    for (int i = 0; i < w; i++) {
+        pid_t ret;
+        NATIVECALL(ret = waitpid(workers[i], nullptr, __WALL));
+        MYASSERT(ret == workers[i])
+    }
+}
+
+void run(void (*func)(void* arg, int i), void* arg, int count, int max_workers)
+{
+    if (count <= 0)
+        return;
+
+    long nprocs = sysconf(_SC_NPROCESSORS_ONLN);
+    int nb_workers = (nprocs > max_workers) ? max_workers : static_cast<int>(nprocs);
+
+    if (nb_workers < 2) {
+        Job job;
+        job.func = func;
+        job.arg = arg;
+        job.count = count;
+        job.next = 0;
+        taskWorker(&job);
+        return;
+    }
+
+    static const size_t WORKER_STACK_SIZE = 256 * 1024;
+    char* stacks = new char[max_workers * WORKER_STACK_SIZE];
+    runOnStacks(func, arg, count, stacks, max_workers * WORKER_STACK_SIZE, max_workers);
+    delete[] stacks;
+}
+
+}
+}
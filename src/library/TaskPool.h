@@ -0,0 +1,57 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIBTAS_TASKPOOL_H
+#define LIBTAS_TASKPOOL_H
+
+#include <cstddef>
+
+namespace libtas {
+
+/* Scoped fork-join task pool for library subsystems that want short-lived
+ * parallelism (state restore reads, compression, encoding).
+ *
+ * Workers are raw clones sharing the address space and file table but no
+ * TLS, like the checkpoint restore workers: the task function must not use
+ * errno, NATIVECALL or logging. They only live inside a run() call — they
+ * are spawned, drain the task indices, and are joined before run() returns.
+ *
+ * A persistent pool is deliberately not provided. Threads surviving a frame
+ * boundary would exist while savestates are dumped, so state content would
+ * depend on worker timing, and the checkpoint suspension would have to
+ * special-case them. A pool that never outlives the call that needed it
+ * keeps savestates deterministic with no ThreadManager involvement.
+ */
+namespace TaskPool {
+
+    /* Run func(arg, i) for every i in [0, count), distributed over up to
+     * min(nprocs, max_workers) workers including the calling thread.
+     * Returns when every task has completed. Worker stacks are taken from
+     * the heap, so this must not be called from the checkpoint handler. */
+    void run(void (*func)(void* arg, int i), void* arg, int count,
+             int max_workers);
+
+    /* Same, with worker stacks carved from a caller-provided region instead
+     * of the heap, for callers that cannot allocate memory. */
+    void runOnStacks(void (*func)(void* arg, int i), void* arg, int count,
+                     char* stacks, size_t stacks_size, int max_workers);
+}
+}
+
+#endif
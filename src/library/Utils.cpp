@@ -51,6 +51,45 @@ ssize_t Utils::writeAll(int fd, const void *buf, size_t count)
     return num_written;
 }
 
+// Fails or does entire gathered write (returns total count)
+ssize_t Utils::writeAllV(int fd, struct iovec *iov, int iovcnt)
+{
+    size_t count = 0;
+    for (int i = 0; i < iovcnt; i++)
+        count += iov[i].iov_len;
+
+    size_t num_written = 0;
+    int i = 0;
+
+    while (i < iovcnt) {
+        ssize_t rc = writev(fd, iov + i, iovcnt - i);
+        if (rc == -1) {
+            if (errno == EINTR || errno == EAGAIN) {
+                continue;
+            } else {
+                debuglogstdio(LCF_ERROR, "Gathered write at address %p failed with errno %d", iov[i].iov_base, errno);
+                return rc;
+            }
+        } else if (rc == 0) {
+            break;
+        }
+        num_written += rc;
+
+        /* Consume fully written iovecs, then advance into a partial one */
+        size_t consumed = rc;
+        while (i < iovcnt && consumed >= iov[i].iov_len) {
+            consumed -= iov[i].iov_len;
+            i++;
+        }
+        if (i < iovcnt && consumed > 0) {
+            iov[i].iov_base = static_cast<char*>(iov[i].iov_base) + consumed;
+            iov[i].iov_len -= consumed;
+        }
+    }
+    MYASSERT(num_written == count);
+    return num_written;
+}
+
 // Fails, succeeds, or partial read due to EOF (returns num read)
 // return value:
 // -1: unrecoverable error
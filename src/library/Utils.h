@@ -24,12 +24,18 @@
 
 #include <cstddef> // size_t
 #include <unistd.h> // ssize_t
+#include <sys/uio.h> // struct iovec
 
 namespace libtas {
 namespace Utils
 {
     ssize_t writeAll(int fd, const void *buf, size_t count);
     ssize_t readAll(int fd, void *buf, size_t count);
+
+    /* Gathered version of writeAll: writes all iovec buffers with as few
+     * writev syscalls as possible. The iovec array is modified to track
+     * progress across partial writes. */
+    ssize_t writeAllV(int fd, struct iovec *iov, int iovcnt);
     bool isZeroPage(void *addr);
 }
 }
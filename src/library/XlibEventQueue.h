@@ -21,6 +21,7 @@
 #define LIBTAS_XLIBEVENTQUEUE_H_INCLUDED
 
 #include <list>
+#include <atomic>
 #include <X11/X.h>
 #include <X11/Xlib.h>
 
@@ -55,12 +56,28 @@ class XlibEventQueue
          * Returns if an event was pulled. */
         bool pop(XEvent* event, Bool (*predicate)(Display *, XEvent *, XPointer), XPointer arg);
 
-        /* Return the size of the queue */
+        /* Return the size of the queue. This only reads the atomic count
+         * mirror, so busy-wait XPending/XEventsQueued loops never touch the
+         * queue state concurrently modified by the event injection. */
         int size();
 
     private:
         std::list<XEvent*> eventQueue;
 
+        /* Count of queued events, mirrored by the insert and pop paths so
+         * that size() is a single relaxed load */
+        std::atomic<int> eventCount {0};
+
+        /* Events that have been consumed from the queue, kept so that later
+         * inserts can reuse them instead of hitting the allocator */
+        std::list<XEvent*> eventPool;
+
+        /* Grab a recycled event from the pool, or allocate a new one */
+        XEvent* allocEvent();
+
+        /* Hand a consumed event back to the pool */
+        void recycleEvent(XEvent* ev);
+
         /* Generic Event cookie data to delete */
         void* cookieData;
 
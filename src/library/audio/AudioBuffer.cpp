@@ -38,14 +38,22 @@ AudioBuffer::AudioBuffer(void)
     blockSize = 0;
     loop_point_beg = 0;
     loop_point_end = 0;
+    samples = std::make_shared<std::vector<uint8_t>>();
+}
+
+void AudioBuffer::ownSamples()
+{
+    if (!samples.unique())
+        samples = std::make_shared<std::vector<uint8_t>>(*samples);
 }
 
 void AudioBuffer::makeSilent() {
+    ownSamples();
     if (format == SAMPLE_FMT_U8) {
-        memset(samples.data(), 0x80, size);
+        memset(samples->data(), 0x80, size);
     }
     else {
-        memset(samples.data(), 0, size);
+        memset(samples->data(), 0, size);
     }
 }
 
@@ -113,6 +121,23 @@ bool AudioBuffer::checkSize(void)
     return true;
 }
 
+int AudioBuffer::getAvailableSamples(int nbSamples, int position, bool loopstatic) const
+{
+    /* Loop points are only supported for uncompressed formats,
+     * mirroring getSamples() */
+    if ((format != SAMPLE_FMT_MSADPCM) && loopstatic && (loop_point_end != 0)) {
+        if ((loop_point_end - position) >= nbSamples)
+            return nbSamples;
+        else
+            return loop_point_end - position;
+    }
+
+    if ((sampleSize - position) >= nbSamples)
+        return nbSamples;
+    else
+        return sampleSize - position;
+}
+
 int AudioBuffer::getSamples(uint8_t* &outSamples, int nbSamples, int position, bool loopstatic)
 {
     switch (format) {
@@ -124,7 +149,7 @@ int AudioBuffer::getSamples(uint8_t* &outSamples, int nbSamples, int position, b
         case SAMPLE_FMT_FLT:
         case SAMPLE_FMT_DBL:
             /* Simple case, we just return a position in our sample buffer */
-            outSamples = &samples[position*alignSize];
+            outSamples = &(*samples)[position*alignSize];
 
             /* Check if we must consider loop points */
             if (loopstatic && (loop_point_end != 0)) {
@@ -151,7 +176,7 @@ int AudioBuffer::getSamples(uint8_t* &outSamples, int nbSamples, int position, b
             int lastBlock = 1 + (position + nbSamples - 1) / blockSamples;
 
             /* Pointer to the beginning of the first block to read */
-            uint8_t* firstSamples = &samples[firstBlock*blockSize];
+            uint8_t* firstSamples = &(*samples)[firstBlock*blockSize];
 
             /* Size of the portion of compressed buffer to decompress */
             int portionSize = std::min(size - firstBlock*blockSize, (lastBlock-firstBlock)*blockSize);
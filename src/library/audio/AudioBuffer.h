@@ -21,6 +21,7 @@
 #define LIBTAS_AUDIOBUFFER_H_INCL
 
 #include <vector>
+#include <memory>
 #include <stdint.h>
 #include <istream>
 #include <string.h> // memset
@@ -48,6 +49,12 @@ class AudioBuffer
          */
         int getSamples( uint8_t* &outSamples, int outNbSamples, int position, bool loopstatic);
 
+        /* Return the number of samples that getSamples() would provide,
+         * without touching or decompressing the sample data. Used by the
+         * fast-forward path that only advances source positions.
+         */
+        int getAvailableSamples(int outNbSamples, int position, bool loopstatic) const;
+
         /* Identifier of the buffer */
         int id;
 
@@ -78,8 +85,14 @@ class AudioBuffer
         /* Size of the buffer in bytes */
         int size;
 
-        /* Audio samples */
-        std::vector<uint8_t> samples;
+        /* Audio samples. The payload is refcounted and can be shared
+         * between buffers that were uploaded with identical content, so
+         * any in-place write must call ownSamples() first */
+        std::shared_ptr<std::vector<uint8_t>> samples;
+
+        /* Make sure this buffer is the sole owner of its sample payload,
+         * copying the payload if it is shared (copy-on-write) */
+        void ownSamples();
 
         /* Begin of looping section. 0 means disabled */
         int loop_point_beg;
@@ -22,8 +22,12 @@
 #include "AudioPlayer.h"
 #include "../global.h" // shared_config
 
+#include <cstring> // memcmp
+
 #define MAXBUFFERS 2048 // Max I've seen so far: 960
 #define MAXSOURCES 256 // Max I've seen so far: 112
+#define MAXPOOLEDSTORAGE 64 // Sample storage entries kept for recycling
+#define MAXSHAREDENTRIES 4096 // Shared payload table size triggering a sweep
 
 namespace libtas {
 
@@ -66,9 +70,81 @@ static struct timespec samplesToTicks(int nbSamples, int frequency)
 AudioContext::AudioContext(void)
 {
     outVolume = 1.0f;
+    command_write = 0;
+    command_read = 0;
+    for (size_t i = 0; i < COMMANDRING_SIZE; i++)
+        command_seq[i] = i;
     init();
 }
 
+bool AudioContext::queueSourceCommand(int source, SourceCommand::Op op, float value)
+{
+    uint64_t pos = command_write.load(std::memory_order_relaxed);
+    for (;;) {
+        size_t slot = pos & (COMMANDRING_SIZE - 1);
+        uint64_t seq = command_seq[slot].load(std::memory_order_acquire);
+
+        if (seq == pos) {
+            /* The slot is free, try to claim it */
+            if (command_write.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+            /* Another producer claimed it first, pos was reloaded */
+        }
+        else if (seq < pos) {
+            /* The consumer has not freed this slot yet, the ring is full */
+            return false;
+        }
+        else {
+            pos = command_write.load(std::memory_order_relaxed);
+        }
+    }
+
+    size_t slot = pos & (COMMANDRING_SIZE - 1);
+    command_ring[slot].source = source;
+    command_ring[slot].op = op;
+    command_ring[slot].value = value;
+
+    /* Publish the slot to the consumer */
+    command_seq[slot].store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+void AudioContext::applySourceCommands(void)
+{
+    for (;;) {
+        size_t slot = command_read & (COMMANDRING_SIZE - 1);
+        uint64_t seq = command_seq[slot].load(std::memory_order_acquire);
+
+        /* Stop at the first slot that is not published yet */
+        if (seq != (command_read + 1))
+            break;
+
+        const SourceCommand &cmd = command_ring[slot];
+
+        /* The source might have been deleted since the command was queued */
+        auto source = getSource(cmd.source);
+        if (source) {
+            switch (cmd.op) {
+                case SourceCommand::SET_GAIN:
+                    source->volume = cmd.value;
+                    break;
+                case SourceCommand::SET_PITCH:
+                    if (source->pitch != cmd.value)
+                        source->dirty();
+                    source->pitch = cmd.value;
+                    break;
+                case SourceCommand::SET_LOOPING:
+                    source->looping = (cmd.value != 0);
+                    break;
+            }
+        }
+
+        /* Free the slot for the producers */
+        command_seq[slot].store(command_read + COMMANDRING_SIZE, std::memory_order_release);
+        command_read++;
+    }
+}
+
 void AudioContext::init(void)
 {
     outBitDepth = shared_config.audio_bitdepth;
@@ -105,7 +181,14 @@ void AudioContext::deleteBuffer(int id)
     buffers.remove_if([id,this](std::shared_ptr<AudioBuffer> const& buffer)
         {
             if (buffer->id == id) {
-                /* Push the deleted buffer into the pool */
+                /* Push the deleted buffer into the pool, and its sample
+                 * storage into the storage pool so that a buffer of a
+                 * different size can reuse the allocation. A shared payload
+                 * cannot be recycled, other buffers still play from it */
+                if (buffer->samples.unique())
+                    recycleSampleStorage(*buffer->samples);
+                else
+                    buffer->samples = std::make_shared<std::vector<uint8_t>>();
                 buffers_pool.push_front(buffer);
                 return true;
             }
@@ -113,6 +196,117 @@ void AudioContext::deleteBuffer(int id)
         });
 }
 
+/* Helper function to round a storage capacity up to the next power of two,
+ * so that recycled entries match future requests of similar sizes */
+static size_t storageClass(size_t bytes)
+{
+    size_t capacity = 64;
+    while (capacity < bytes)
+        capacity *= 2;
+    return capacity;
+}
+
+void AudioContext::fetchSampleStorage(std::shared_ptr<std::vector<uint8_t>> &samples, size_t bytes)
+{
+    /* Detach from a shared payload, other buffers still play from it */
+    if (!samples.unique())
+        samples = std::make_shared<std::vector<uint8_t>>();
+
+    /* The current storage is large enough, nothing to do */
+    if (samples->capacity() >= bytes)
+        return;
+
+    /* Look for the smallest pooled entry that can hold the samples */
+    auto best = samples_pool.end();
+    for (auto iter = samples_pool.begin(); iter != samples_pool.end(); iter++) {
+        if (iter->capacity() >= bytes) {
+            if ((best == samples_pool.end()) || (iter->capacity() < best->capacity()))
+                best = iter;
+        }
+    }
+
+    if (best != samples_pool.end()) {
+        /* Recycle the old storage in exchange, unless it was empty */
+        samples->swap(*best);
+        samples->clear();
+        if (best->capacity() == 0)
+            samples_pool.erase(best);
+        else
+            best->clear();
+        return;
+    }
+
+    /* No entry fits, grow the storage to the next size class */
+    samples->reserve(storageClass(bytes));
+}
+
+void AudioContext::recycleSampleStorage(std::vector<uint8_t> &samples)
+{
+    if (samples.capacity() == 0)
+        return;
+
+    if (samples_pool.size() >= MAXPOOLEDSTORAGE) {
+        /* The pool is full, drop the storage */
+        std::vector<uint8_t>().swap(samples);
+        return;
+    }
+
+    samples_pool.emplace_front();
+    samples_pool.front().swap(samples);
+    samples_pool.front().clear();
+}
+
+/* FNV-1a content hash of an uploaded payload */
+static uint64_t sampleHash(const uint8_t* data, size_t size)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+void AudioContext::storeSharedSamples(std::shared_ptr<std::vector<uint8_t>> &samples, const uint8_t* data, size_t size)
+{
+    const uint64_t hash = sampleHash(data, size);
+
+    auto iter = shared_samples.find(hash);
+    if (iter != shared_samples.end()) {
+        std::shared_ptr<std::vector<uint8_t>> match = iter->second.lock();
+        /* Compare the content, guarding against a hash collision */
+        if (match && (match->size() == size) && (memcmp(match->data(), data, size) == 0)) {
+            /* Recycle our current storage in exchange for the shared one */
+            if (samples.unique())
+                recycleSampleStorage(*samples);
+            samples = match;
+            return;
+        }
+    }
+
+    /* First upload of this content: copy it, and remember the copy so
+     * that later identical uploads can share it */
+    fetchSampleStorage(samples, size);
+    samples->assign(data, data + size);
+
+    if (iter != shared_samples.end()) {
+        iter->second = samples;
+    }
+    else {
+        /* Sweep the expired entries once in a while so that the table does
+         * not grow with payloads that no buffer holds anymore */
+        if (shared_samples.size() >= MAXSHAREDENTRIES) {
+            for (auto it = shared_samples.begin(); it != shared_samples.end();) {
+                if (it->second.expired())
+                    it = shared_samples.erase(it);
+                else
+                    it++;
+            }
+        }
+        shared_samples[hash] = samples;
+    }
+}
+
 bool AudioContext::isBuffer(int id)
 {
     for (auto const& buffer : buffers) {
@@ -209,18 +403,30 @@ void AudioContext::mixAllSources(struct timespec ticks)
 
     debuglog(LCF_SOUND, "Start mixing about ", outNbSamples, " samples");
 
+    /* When sources skip the mixing (same predicate as in mixWith()), they
+     * only advance their position counters, so we don't need to silent the
+     * output buffer or feed the audio device either */
+    bool skipMixing = !shared_config.av_dumping && (shared_config.audio_mute ||
+        (shared_config.fastforward && (shared_config.fastforward_mode & SharedConfig::FF_MIXING)));
+
     /* Silent the output buffer */
-    if (outBitDepth == 8) // Unsigned 8-bit samples
-        outSamples.assign(outBytes, 0x80);
-    if (outBitDepth == 16) // Signed 16-bit samples
-        outSamples.assign(outBytes, 0);
+    if (!skipMixing) {
+        if (outBitDepth == 8) // Unsigned 8-bit samples
+            outSamples.assign(outBytes, 0x80);
+        if (outBitDepth == 16) // Signed 16-bit samples
+            outSamples.assign(outBytes, 0);
+    }
 
     std::lock_guard<std::mutex> lock(mutex);
+
+    /* Apply the parameter updates queued by the al* entry points */
+    applySourceCommands();
+
     for (auto& source : sources) {
-        source->mixWith(ticks, &outSamples[0], outBytes, outBitDepth, outNbChannels, outFrequency, outVolume);
+        source->mixWith(ticks, outSamples.data(), outBytes, outBitDepth, outNbChannels, outFrequency, outVolume);
     }
 
-    if (!audiocontext.isLoopback && !shared_config.audio_mute) {
+    if (!audiocontext.isLoopback && !shared_config.audio_mute && !skipMixing) {
         /* Play the music */
         AudioPlayer::play(*this);
     }
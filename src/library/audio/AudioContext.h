@@ -23,7 +23,9 @@
 #include <vector>
 #include <memory>
 #include <list>
+#include <map>
 #include <mutex>
+#include <atomic>
 #include "AudioBuffer.h"
 #include "AudioSource.h"
 
@@ -84,6 +86,23 @@ class AudioContext
         /* Return the buffer of requested id, or nullptr if not exists */
         std::shared_ptr<AudioBuffer> getBuffer(int id);
 
+        /* Make sure the buffer samples are a writable storage that can hold
+         * at least the given number of bytes without reallocating: detach
+         * from a shared payload and recycle pooled storage if possible.
+         * Streaming games fill hundreds of buffers per second, so growing
+         * should not hit the allocator in steady state.
+         * The previous content is not preserved */
+        void fetchSampleStorage(std::shared_ptr<std::vector<uint8_t>> &samples, size_t bytes);
+
+        /* Hand the sample storage back to the pool */
+        void recycleSampleStorage(std::vector<uint8_t> &samples);
+
+        /* Store an uploaded payload into the buffer samples. Payloads are
+         * content-hashed, so a game that uploads the same data again (or
+         * into several buffers) gets a refcounted reference to the first
+         * copy instead of another copy */
+        void storeSharedSamples(std::shared_ptr<std::vector<uint8_t>> &samples, const uint8_t* data, size_t size);
+
         /* Create a new source object and return an id of the source or -1 if it failed */
         int createSource(void);
 
@@ -103,6 +122,29 @@ class AudioContext
         /* Mutex to protect access to all audio objects */
         std::mutex mutex;
 
+        /* Deferred source parameter update, queued by the al* entry points
+         * when the mutex is contended (typically by the frame-boundary
+         * mixing) so they don't have to block on it */
+        struct SourceCommand {
+            enum Op {
+                SET_GAIN,
+                SET_PITCH,
+                SET_LOOPING,
+            };
+            int source;
+            Op op;
+            float value;
+        };
+
+        /* Queue a parameter update without taking the mutex.
+         * Returns false when the command ring is full */
+        bool queueSourceCommand(int source, SourceCommand::Op op, float value);
+
+        /* Apply all queued parameter updates. Must be called right after
+         * taking the mutex, so that queued and direct updates from one
+         * thread are applied in program order */
+        void applySourceCommands();
+
     private:
         std::list<std::shared_ptr<AudioBuffer>> buffers;
         std::list<std::shared_ptr<AudioSource>> sources;
@@ -110,6 +152,28 @@ class AudioContext
         /* Extra buffers and sources that have been deleted and can be recycled */
         std::list<std::shared_ptr<AudioBuffer>> buffers_pool;
         std::list<std::shared_ptr<AudioSource>> sources_pool;
+
+        /* Sample storage of deleted buffers, kept for recycling. Capacities
+         * are rounded up to powers of two so that entries match future
+         * requests of similar sizes */
+        std::list<std::vector<uint8_t>> samples_pool;
+
+        /* Payloads of past uploads indexed by content hash, for sharing.
+         * Entries are weak so the table does not keep payloads alive once
+         * every buffer using them is gone */
+        std::map<uint64_t, std::weak_ptr<std::vector<uint8_t>>> shared_samples;
+
+        /* Bounded multi-producer ring holding the queued source commands.
+         * Slot sequence numbers follow the classic bounded queue scheme:
+         * producers claim a slot by advancing command_write, and publish it
+         * by bumping the slot sequence for the single consumer */
+        static const size_t COMMANDRING_SIZE = 256; // must be a power of two
+        SourceCommand command_ring[COMMANDRING_SIZE];
+        std::atomic<uint64_t> command_seq[COMMANDRING_SIZE];
+        std::atomic<uint64_t> command_write;
+
+        /* Read position of the consumer, protected by the mutex */
+        uint64_t command_read;
 };
 
 extern AudioContext audiocontext;
@@ -27,8 +27,15 @@ extern "C" {
     #include <libavutil/channel_layout.h>
 }
 #include <stdlib.h>
+#include <string.h> // memcpy
+#include <list>
+#include <utility> // std::pair
 #include "../DeterministicTimer.h" // detTimer.fakeAdvanceTimer()
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 namespace libtas {
 
 /* Helper function to convert ticks into a number of bytes in the audio buffer */
@@ -44,9 +51,44 @@ int AudioSource::ticksToSamples(struct timespec ticks, int frequency)
     return static_cast<int>(samples);
 }
 
+/* Process-wide cache of initialized resampling contexts, keyed by the
+ * conversion parameters. swr_init() rebuilds the resampling filter banks,
+ * which adds up when many short-lived sources are created during effect
+ * bursts, so contexts are checked out by sources and returned drained.
+ * Access is protected by the audio context mutex like the other audio
+ * objects */
+#define MAXSWRCONTEXTS 16
+static std::list<std::pair<int64_t, SwrContext*>> swr_cache;
+
+/* Pack the conversion parameters into a cache key */
+static int64_t swrKey(int inFormat, int inChannels, int inRate, int outFormat, int outChannels, int outRate)
+{
+    return (static_cast<int64_t>(inFormat) << 60)
+        | (static_cast<int64_t>(inChannels) << 56)
+        | (static_cast<int64_t>(outFormat) << 52)
+        | (static_cast<int64_t>(outChannels) << 48)
+        | (static_cast<int64_t>(inRate) << 24)
+        | static_cast<int64_t>(outRate);
+}
+
+/* Look for a cached context with matching parameters, removing it from the
+ * cache. Returns null if no context matches */
+static SwrContext* acquireSwrContext(int64_t key)
+{
+    for (auto iter = swr_cache.begin(); iter != swr_cache.end(); iter++) {
+        if (iter->first == key) {
+            SwrContext* swr = iter->second;
+            swr_cache.erase(iter);
+            return swr;
+        }
+    }
+    return nullptr;
+}
+
 AudioSource::AudioSource(void)
 {
-    swr = swr_alloc();
+    swr = nullptr;
+    swr_key = 0;
 
     volume = 1.0f;
     pitch = 1.0f;
@@ -55,7 +97,27 @@ AudioSource::AudioSource(void)
 
 AudioSource::~AudioSource(void)
 {
-    swr_free(&swr);
+    releaseSwr();
+}
+
+void AudioSource::releaseSwr(void)
+{
+    if (!swr)
+        return;
+
+    /* Drain the leftover resampling state so the next user starts clean,
+     * keeping the initialized filter banks */
+    uint8_t scratch[2048];
+    uint8_t* out = scratch;
+    while (swr_convert(swr, &out, 256, nullptr, 0) > 0) {}
+
+    if (swr_cache.size() >= MAXSWRCONTEXTS)
+        swr_free(&swr);
+    else
+        swr_cache.emplace_front(swr_key, swr);
+
+    swr = nullptr;
+    swr_key = 0;
 }
 
 void AudioSource::init(void)
@@ -72,14 +134,12 @@ void AudioSource::rewind(void)
     position = 0;
     samples_frac = 0;
     queue_index = 0;
-    if (swr_is_initialized(swr))
-        swr_close(swr);
+    releaseSwr();
 }
 
 void AudioSource::dirty(void)
 {
-    if (swr_is_initialized(swr))
-        swr_close(swr);
+    releaseSwr();
 }
 
 int AudioSource::nbQueue()
@@ -132,6 +192,26 @@ void AudioSource::setPosition(int pos)
     }
 }
 
+/* Append samples to the mixed buffer on the passthrough path, clamped to
+ * the size of the mixed buffer. Returns the new number of mixed samples */
+static int appendPassthrough(uint8_t* begMixed, int passSamples, int outNbSamples, int alignSize, const uint8_t* begSamples, int nbSamples)
+{
+    int n = std::min(nbSamples, outNbSamples - passSamples);
+    if (n <= 0)
+        return passSamples;
+    memcpy(begMixed + passSamples*alignSize, begSamples, n*alignSize);
+    return passSamples + n;
+}
+
+/* Get the number of samples read from a buffer. When the mixing is skipped,
+ * only the sample count is computed, without touching the sample data */
+static int readBufferSamples(std::shared_ptr<AudioBuffer> buf, bool skipMixing, uint8_t* &outSamples, int nbSamples, int position, bool loopstatic)
+{
+    if (skipMixing)
+        return buf->getAvailableSamples(nbSamples, position, loopstatic);
+    return buf->getSamples(outSamples, nbSamples, position, loopstatic);
+}
+
 int AudioSource::mixWith( struct timespec ticks, uint8_t* outSamples, int outBytes, int outBitDepth, int outNbChannels, int outFrequency, float outVolume)
 {
     if (state != SOURCE_PLAYING)
@@ -147,11 +227,20 @@ int AudioSource::mixWith( struct timespec ticks, uint8_t* outSamples, int outByt
 
     std::shared_ptr<AudioBuffer> curBuf = buffer_queue[queue_index];
 
-    if (!skipMixing) {
-        /* Check if SWR context is initialized.
-         * If not, set parameters and init it
+    /* When the buffer format already matches the output format and no
+     * resampling is needed, which is the common case for ALSA games opening
+     * the device at the mixer rate, samples are read directly from the
+     * buffer instead of going through the resampler */
+    bool passthrough = (pitch == 1.0f) && (curBuf->frequency == outFrequency)
+        && (curBuf->nbChannels == outNbChannels)
+        && (((curBuf->format == AudioBuffer::SAMPLE_FMT_S16) && (outBitDepth == 16))
+            || ((curBuf->format == AudioBuffer::SAMPLE_FMT_U8) && (outBitDepth == 8)));
+
+    if (!skipMixing && !passthrough) {
+        /* Check if we hold a resampling context.
+         * If not, check one out of the cache or init a new one
          */
-        if (! swr_is_initialized(swr)) {
+        if (! swr) {
             /* Get the sample format */
             AVSampleFormat inFormat = AV_SAMPLE_FMT_U8;
             AVSampleFormat outFormat = AV_SAMPLE_FMT_U8;
@@ -181,32 +270,43 @@ int AudioSource::mixWith( struct timespec ticks, uint8_t* outSamples, int outByt
             if (outBitDepth == 16)
                 outFormat = AV_SAMPLE_FMT_S16;
 
-            /* Set channel layout */
-            if (curBuf->nbChannels == 1) {
-                MYASSERT(0 == av_opt_set_int(swr, "in_channel_layout", AV_CH_LAYOUT_MONO, 0));
-            }
-            if (curBuf->nbChannels == 2) {
-                MYASSERT(0 == av_opt_set_int(swr, "in_channel_layout", AV_CH_LAYOUT_STEREO, 0));
-            }
-            if (outNbChannels == 1) {
-                MYASSERT(0 == av_opt_set_int(swr, "out_channel_layout", AV_CH_LAYOUT_MONO, 0));
-            }
-            if (outNbChannels == 2) {
-                MYASSERT(0 == av_opt_set_int(swr, "out_channel_layout", AV_CH_LAYOUT_STEREO, 0));
-            }
+            /* Check the cache for a context with the same parameters */
+            swr_key = swrKey(inFormat, curBuf->nbChannels, static_cast<int>(curBuf->frequency*pitch),
+                outFormat, outNbChannels, outFrequency);
+            swr = acquireSwrContext(swr_key);
+
+            if (! swr) {
+                swr = swr_alloc();
 
-            /* Set sample format */
-            MYASSERT(0 == av_opt_set_sample_fmt(swr, "in_sample_fmt", inFormat, 0));
-            MYASSERT(0 == av_opt_set_sample_fmt(swr, "out_sample_fmt", outFormat, 0));
+                /* Set channel layout */
+                if (curBuf->nbChannels == 1) {
+                    MYASSERT(0 == av_opt_set_int(swr, "in_channel_layout", AV_CH_LAYOUT_MONO, 0));
+                }
+                if (curBuf->nbChannels == 2) {
+                    MYASSERT(0 == av_opt_set_int(swr, "in_channel_layout", AV_CH_LAYOUT_STEREO, 0));
+                }
+                if (outNbChannels == 1) {
+                    MYASSERT(0 == av_opt_set_int(swr, "out_channel_layout", AV_CH_LAYOUT_MONO, 0));
+                }
+                if (outNbChannels == 2) {
+                    MYASSERT(0 == av_opt_set_int(swr, "out_channel_layout", AV_CH_LAYOUT_STEREO, 0));
+                }
+
+                /* Set sample format */
+                MYASSERT(0 == av_opt_set_sample_fmt(swr, "in_sample_fmt", inFormat, 0));
+                MYASSERT(0 == av_opt_set_sample_fmt(swr, "out_sample_fmt", outFormat, 0));
 
-            /* Set sampling frequency */
-            MYASSERT(0 == av_opt_set_int(swr, "in_sample_rate", static_cast<int>(curBuf->frequency*pitch), 0));
-            MYASSERT(0 == av_opt_set_int(swr, "out_sample_rate", outFrequency, 0));
+                /* Set sampling frequency */
+                MYASSERT(0 == av_opt_set_int(swr, "in_sample_rate", static_cast<int>(curBuf->frequency*pitch), 0));
+                MYASSERT(0 == av_opt_set_int(swr, "out_sample_rate", outFrequency, 0));
 
-            /* Open the context */
-            if (swr_init(swr) < 0) {
-                debuglog(LCF_SOUND | LCF_ERROR, "Error initializing swr context");
-                return 0;
+                /* Open the context */
+                if (swr_init(swr) < 0) {
+                    debuglog(LCF_SOUND | LCF_ERROR, "Error initializing swr context");
+                    swr_free(&swr);
+                    swr = nullptr;
+                    return 0;
+                }
             }
         }
     }
@@ -220,7 +320,6 @@ int AudioSource::mixWith( struct timespec ticks, uint8_t* outSamples, int outByt
      */
     float resultVolume = (volume * outVolume) > 1.0?1.0:(volume*outVolume);
     int lvas = (int)(resultVolume * 65536.0f);
-    int rvas = (int)(resultVolume * 65536.0f);
 
     /* Number of samples to advance in the buffer. */
     int inNbSamples = ticksToSamples(ticks, static_cast<int>(curBuf->frequency*pitch));
@@ -229,13 +328,18 @@ int AudioSource::mixWith( struct timespec ticks, uint8_t* outSamples, int outByt
     int newPosition = position + inNbSamples;
 
     /* Allocate the mixed audio array */
-    int outNbSamples = outBytes / (outNbChannels * outBitDepth / 8);
-    mixedSamples.resize(outBytes);
+    int outAlignSize = outNbChannels * outBitDepth / 8;
+    int outNbSamples = outBytes / outAlignSize;
+    if (!skipMixing)
+        mixedSamples.resize(outBytes);
     uint8_t* begMixed = mixedSamples.data();
 
     int convOutSamples = 0;
+
+    /* Number of samples gathered on the passthrough path */
+    int passSamples = 0;
     uint8_t* begSamples;
-    int availableSamples = curBuf->getSamples(begSamples, inNbSamples, oldPosition, (source == SOURCE_STATIC) && looping);
+    int availableSamples = readBufferSamples(curBuf, skipMixing, begSamples, inNbSamples, oldPosition, (source == SOURCE_STATIC) && looping);
 
     if (availableSamples == inNbSamples) {
         /* We did not reach the end of the buffer, easy case */
@@ -243,22 +347,37 @@ int AudioSource::mixWith( struct timespec ticks, uint8_t* outSamples, int outByt
         position = newPosition;
         debuglog(LCF_SOUND, "  Buffer ", curBuf->id, " in read in range ", oldPosition, " - ", position);
         if (!skipMixing) {
-            convOutSamples = swr_convert(swr, &begMixed, outNbSamples, const_cast<const uint8_t**>(&begSamples), inNbSamples);
+            if (passthrough)
+                convOutSamples = appendPassthrough(begMixed, 0, outNbSamples, outAlignSize, begSamples, inNbSamples);
+            else
+                convOutSamples = swr_convert(swr, &begMixed, outNbSamples, const_cast<const uint8_t**>(&begSamples), inNbSamples);
         }
     }
     else {
         /* We reached the end of the buffer */
         debuglog(LCF_SOUND, "  Buffer ", curBuf->id, " is read from ", oldPosition, " to its end ", curBuf->sampleSize);
         if (!skipMixing) {
-            if (availableSamples > 0)
-                swr_convert(swr, nullptr, 0, const_cast<const uint8_t**>(&begSamples), availableSamples);
+            if (availableSamples > 0) {
+                if (passthrough)
+                    passSamples = appendPassthrough(begMixed, passSamples, outNbSamples, outAlignSize, begSamples, availableSamples);
+                else
+                    swr_convert(swr, nullptr, 0, const_cast<const uint8_t**>(&begSamples), availableSamples);
+            }
         }
 
         int remainingSamples = inNbSamples - availableSamples;
         if (source == SOURCE_CALLBACK) {
             /* We refill our buffer using the callback function,
-             * until we got enough bytes for this frame
+             * until we got enough bytes for this frame.
+             *
+             * The periods are gathered into one contiguous window and
+             * handed to the resampler in a single feed afterwards, so
+             * games using tiny callback buffers don't pay a resampler
+             * round-trip per period. The timer is still faked per period,
+             * so a callback reading the clock sees the time matching each
+             * period's position inside the frame.
              */
+            callbackWindow.clear();
             while (remainingSamples > 0) {
                 /* Before doing the callback, we must fake that the timer has
                  * advanced by the number of samples already read
@@ -268,9 +387,12 @@ int AudioSource::mixWith( struct timespec ticks, uint8_t* outSamples, int outByt
                 detTimer.fakeAdvanceTimer({static_cast<time_t>(extraTicks / 1000000000), static_cast<long>(extraTicks % 1000000000)});
                 callback(*curBuf);
                 detTimer.fakeAdvanceTimer({0, 0});
-                availableSamples = curBuf->getSamples(begSamples, remainingSamples, 0, false);
-                if (!skipMixing) {
-                    swr_convert(swr, nullptr, 0, const_cast<const uint8_t**>(&begSamples), availableSamples);
+                availableSamples = readBufferSamples(curBuf, skipMixing, begSamples, remainingSamples, 0, false);
+                if (!skipMixing && (availableSamples > 0)) {
+                    if (passthrough)
+                        passSamples = appendPassthrough(begMixed, passSamples, outNbSamples, outAlignSize, begSamples, availableSamples);
+                    else
+                        callbackWindow.insert(callbackWindow.end(), begSamples, begSamples + availableSamples*curBuf->alignSize);
                 }
 
                 debuglog(LCF_SOUND, "  Buffer ", curBuf->id, " is read again from 0 to ", availableSamples);
@@ -279,9 +401,18 @@ int AudioSource::mixWith( struct timespec ticks, uint8_t* outSamples, int outByt
                 remainingSamples -= availableSamples;
             }
 
+            if (!skipMixing && !passthrough && !callbackWindow.empty()) {
+                uint8_t* windowData = callbackWindow.data();
+                swr_convert(swr, nullptr, 0, const_cast<const uint8_t**>(&windowData),
+                    static_cast<int>(callbackWindow.size()) / curBuf->alignSize);
+            }
+
             if (!skipMixing) {
                 /* Get the mixed samples */
-                convOutSamples = swr_convert(swr, &begMixed, outNbSamples, nullptr, 0);
+                if (passthrough)
+                    convOutSamples = passSamples;
+                else
+                    convOutSamples = swr_convert(swr, &begMixed, outNbSamples, nullptr, 0);
             }
         }
         else {
@@ -293,11 +424,14 @@ int AudioSource::mixWith( struct timespec ticks, uint8_t* outSamples, int outByt
             if (looping) {
                 for (int i=(queue_index+1)%queue_size; remainingSamples>0; i=(i+1)%queue_size) {
                     std::shared_ptr<AudioBuffer> loopbuf = buffer_queue[i];
-                    availableSamples = loopbuf->getSamples(begSamples, remainingSamples, loopbuf->loop_point_beg, (source == SOURCE_STATIC) && looping);
+                    availableSamples = readBufferSamples(loopbuf, skipMixing, begSamples, remainingSamples, loopbuf->loop_point_beg, (source == SOURCE_STATIC) && looping);
                     debuglog(LCF_SOUND, "  Buffer ", loopbuf->id, " in read in range ", loopbuf->loop_point_beg, " - ", availableSamples);
 
                     if (!skipMixing) {
-                        swr_convert(swr, nullptr, 0, const_cast<const uint8_t**>(&begSamples), availableSamples);
+                        if (passthrough)
+                            passSamples = appendPassthrough(begMixed, passSamples, outNbSamples, outAlignSize, begSamples, availableSamples);
+                        else
+                            swr_convert(swr, nullptr, 0, const_cast<const uint8_t**>(&begSamples), availableSamples);
                     }
 
                     if (remainingSamples == availableSamples) {
@@ -310,11 +444,14 @@ int AudioSource::mixWith( struct timespec ticks, uint8_t* outSamples, int outByt
             else {
                 for (int i=queue_index+1; (remainingSamples>0) && (i<queue_size); i++) {
                     std::shared_ptr<AudioBuffer> loopbuf = buffer_queue[i];
-                    availableSamples = loopbuf->getSamples(begSamples, remainingSamples, 0, false);
+                    availableSamples = readBufferSamples(loopbuf, skipMixing, begSamples, remainingSamples, 0, false);
                     debuglog(LCF_SOUND, "  Buffer ", loopbuf->id, " in read in range 0 - ", availableSamples);
 
                     if (!skipMixing) {
-                        swr_convert(swr, nullptr, 0, const_cast<const uint8_t**>(&begSamples), availableSamples);
+                        if (passthrough)
+                            passSamples = appendPassthrough(begMixed, passSamples, outNbSamples, outAlignSize, begSamples, availableSamples);
+                        else
+                            swr_convert(swr, nullptr, 0, const_cast<const uint8_t**>(&begSamples), availableSamples);
                     }
 
                     if (remainingSamples == availableSamples) {
@@ -327,7 +464,10 @@ int AudioSource::mixWith( struct timespec ticks, uint8_t* outSamples, int outByt
 
             if (!skipMixing) {
                 /* Get the mixed samples */
-                convOutSamples = swr_convert(swr, &begMixed, outNbSamples, nullptr, 0);
+                if (passthrough)
+                    convOutSamples = passSamples;
+                else
+                    convOutSamples = swr_convert(swr, &begMixed, outNbSamples, nullptr, 0);
             }
 
             if (remainingSamples > 0) {
@@ -350,45 +490,89 @@ int AudioSource::mixWith( struct timespec ticks, uint8_t* outSamples, int outByt
 
         /* Add mixed source to the output buffer */
         if (outBitDepth == 8) {
-            for (int s=0; s<convOutSamples*outNbChannels; s+=outNbChannels) {
-                int myL = mixedSamples[s];
-                int otherL = outSamples[s];
-                int sumL = otherL + ((myL * lvas) >> 16) - 256;
-                outSamples[s] = clamptofullsignedrange(sumL, 0, UINT8_MAX);
-                if ((sumL < 0) || (sumL > UINT8_MAX))
-                    debuglog(LCF_SOUND, "Saturation during mixing");
-
-                if (outNbChannels == 2) {
-                    int myR = mixedSamples[s+1];
-                    int otherR = outSamples[s+1];
-                    int sumR = otherR + ((myR * rvas) >> 16) - 256;
-                    outSamples[s+1] = clamptofullsignedrange(sumR, 0, UINT8_MAX);
-                    if ((sumR < 0) || (sumR > UINT8_MAX))
-                        debuglog(LCF_SOUND, "Saturation during mixing");
+            uint8_t* mixedSamples8 = mixedSamples.data();
+
+            /* Both channels use the same volume scale, so the mono and
+             * stereo cases reduce to one uniform loop, as in the 16-bit
+             * path below */
+            const int totalSamples = convOutSamples*outNbChannels;
+            int s = 0;
+
+#ifdef __SSE2__
+            /* Widen to 16 bits, scale, mix and re-bias; the unsigned
+             * saturating pack performs the clamp to [0,255]. At full
+             * volume the scale is the identity and is skipped */
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i bias = _mm_set1_epi16(256);
+            const __m128i scale = _mm_set1_epi16(static_cast<int16_t>(lvas));
+            const bool fullVolume = (lvas == 65536);
+            for (; s+16 <= totalSamples; s+=16) {
+                __m128i my = _mm_loadu_si128(reinterpret_cast<__m128i*>(mixedSamples8 + s));
+                __m128i other = _mm_loadu_si128(reinterpret_cast<__m128i*>(outSamples + s));
+                __m128i mylo = _mm_unpacklo_epi8(my, zero);
+                __m128i myhi = _mm_unpackhi_epi8(my, zero);
+                if (!fullVolume) {
+                    mylo = _mm_mulhi_epu16(mylo, scale);
+                    myhi = _mm_mulhi_epu16(myhi, scale);
                 }
+                __m128i sumlo = _mm_sub_epi16(_mm_add_epi16(_mm_unpacklo_epi8(other, zero), mylo), bias);
+                __m128i sumhi = _mm_sub_epi16(_mm_add_epi16(_mm_unpackhi_epi8(other, zero), myhi), bias);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(outSamples + s), _mm_packus_epi16(sumlo, sumhi));
+            }
+#endif
+
+            /* Scalar tail, also the whole mix on non-x86 builds */
+            for (; s<totalSamples; s++) {
+                int my = mixedSamples8[s];
+                int other = outSamples[s];
+                int sum = other + ((my * lvas) >> 16) - 256;
+                outSamples[s] = clamptofullsignedrange(sum, 0, UINT8_MAX);
+                if ((sum < 0) || (sum > UINT8_MAX))
+                    debuglog(LCF_SOUND, "Saturation during mixing");
             }
         }
 
         if (outBitDepth == 16) {
             int16_t* mixedSamples16 = reinterpret_cast<int16_t*>(mixedSamples.data());
             int16_t* outSamples16 = reinterpret_cast<int16_t*>(outSamples);
-            for (int s=0; s<convOutSamples*outNbChannels; s+=outNbChannels) {
-                int myL = mixedSamples16[s];
-                int otherL = outSamples16[s];
-                int sumL = otherL + ((myL * lvas) >> 16);
-                outSamples16[s] = clamptofullsignedrange(sumL, INT16_MIN, INT16_MAX);
-                if ((sumL < INT16_MIN) || (sumL > INT16_MAX))
-                    debuglog(LCF_SOUND, "Saturation during mixing");
 
-                if (outNbChannels == 2) {
-                    int myR = mixedSamples16[s+1];
-                    int otherR = outSamples16[s+1];
-                    int sumR = otherR + ((myR * rvas) >> 16);
-                    outSamples16[s+1] = clamptofullsignedrange(sumR, INT16_MIN, INT16_MAX);
-                    if ((sumR < INT16_MIN) || (sumR > INT16_MAX))
-                        debuglog(LCF_SOUND, "Saturation during mixing");
+            /* Both channels use the same volume scale, so the mono and stereo
+             * cases reduce to one uniform loop over all interleaved samples */
+            const int totalSamples = convOutSamples*outNbChannels;
+            int s = 0;
+
+#ifdef __SSE2__
+            if (lvas == 65536) {
+                /* Full volume, the mix is a plain saturating add */
+                for (; s+8 <= totalSamples; s+=8) {
+                    __m128i my = _mm_loadu_si128(reinterpret_cast<__m128i*>(mixedSamples16 + s));
+                    __m128i other = _mm_loadu_si128(reinterpret_cast<__m128i*>(outSamples16 + s));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(outSamples16 + s), _mm_adds_epi16(other, my));
+                }
+            }
+            else {
+                /* mulhi computes (my * int16_t(lvas)) >> 16. When lvas is in
+                 * [32768, 65536) the truncation to int16_t subtracts 65536
+                 * from the scale, which subtracts exactly my from the result,
+                 * so we add it back to recover (my * lvas) >> 16 */
+                const __m128i scale = _mm_set1_epi16(static_cast<int16_t>(lvas));
+                const __m128i carry = _mm_set1_epi16((lvas >= 32768) ? -1 : 0);
+                for (; s+8 <= totalSamples; s+=8) {
+                    __m128i my = _mm_loadu_si128(reinterpret_cast<__m128i*>(mixedSamples16 + s));
+                    __m128i other = _mm_loadu_si128(reinterpret_cast<__m128i*>(outSamples16 + s));
+                    __m128i scaled = _mm_add_epi16(_mm_mulhi_epi16(my, scale), _mm_and_si128(my, carry));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(outSamples16 + s), _mm_adds_epi16(other, scaled));
                 }
             }
+#endif
+
+            /* Scalar tail, also the whole mix on non-x86 builds */
+            for (; s<totalSamples; s++) {
+                int my = mixedSamples16[s];
+                int other = outSamples16[s];
+                int sum = other + ((my * lvas) >> 16);
+                outSamples16[s] = clamptofullsignedrange(sum, INT16_MIN, INT16_MAX);
+            }
         }
     }
 
@@ -103,12 +103,22 @@ class AudioSource
         /* Indicate the current position in the buffer queue */
         int queue_index;
 
-        /* Context for resampling audio */
+        /* Context for resampling audio, checked out from a process-wide
+         * cache of initialized contexts. Null until the first mix */
         struct SwrContext *swr;
 
+        /* Conversion parameters of the checked out context, packed into the
+         * cache key */
+        int64_t swr_key;
+
         /* Temporary array of mixed samples */
         std::vector<uint8_t> mixedSamples;
 
+        /* Window gathering the periods produced by the game's audio
+         * callback during one frame, handed to the resampler in a single
+         * feed instead of one per period */
+        std::vector<uint8_t> callbackWindow;
+
         /* In case of callback type, callback function.
          * We send as an argument a pointer to the buffer to refill.
          */
@@ -128,6 +138,9 @@ class AudioSource
         /* Some parameters have changed, so we must set a new resample context */
         void dirty();
 
+        /* Return the resampling context to the process-wide cache */
+        void releaseSwr();
+
         /* Returns the number of buffers in its queue */
         int nbQueue();
 
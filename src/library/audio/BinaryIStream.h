@@ -55,6 +55,20 @@ class BinaryIStream
 
         explicit operator bool() const {return !end;}
 
+        /* Number of bytes left to read */
+        int remaining() const {return end ? 0 : (size - pos);}
+
+        /* Pointer to the next byte to read */
+        const uint8_t* current() const {return values + pos;}
+
+        /* Advance the position by the given number of bytes */
+        void skip(int n)
+        {
+            pos += n;
+            if (pos >= size)
+                end = true;
+        }
+
         friend BinaryIStream &operator>>( BinaryIStream &stream, uint8_t &v )
         {
             if (stream.end)
@@ -19,19 +19,17 @@
 
 #include "DecoderMSADPCM.h"
 #include "../logging.h"
+#include <algorithm> // std::min, std::max
 
 namespace libtas {
 
 int16_t DecoderMSADPCM::calculateSample(uint8_t nibble, uint8_t predictor, int16_t& sample1, int16_t& sample2, int16_t& delta)
 {
     /*
-     * Get a signed number out of the nibble. We need to retain the
-     * original nibble value for when we access AdaptionTable[].
+     * Get a signed number out of the nibble, without branching. We need to
+     * retain the original nibble value for when we access AdaptionTable[].
      */
-    int8_t signedNibble = static_cast<int8_t>(nibble);
-    if ((signedNibble & 0x8) == 0x8) {
-        signedNibble -= 0x10;
-    }
+    int signedNibble = (static_cast<int>(nibble) ^ 0x8) - 0x8;
 
     static const int adaptionTable[] = {
         230, 230, 230, 230, 307, 409, 512, 614,
@@ -53,24 +51,17 @@ int16_t DecoderMSADPCM::calculateSample(uint8_t nibble, uint8_t predictor, int16
             );
     sampleInt += signedNibble * delta;
 
-    /* Clamp result to 16-bit */
-    int16_t sample;
-    if (sampleInt < INT16_MIN) {
-        sample = INT16_MIN;
-    } else if (sampleInt > INT16_MAX) {
-        sample = INT16_MAX;
-    } else {
-        sample = static_cast<int16_t>(sampleInt);
-    }
+    /* Clamp result to 16-bit. min/max compile to conditional moves, keeping
+     * the decode loop free of unpredictable branches */
+    int16_t sample = static_cast<int16_t>(std::max(static_cast<int>(INT16_MIN),
+        std::min(static_cast<int>(INT16_MAX), sampleInt)));
 
-    /* Shuffle samples, get new delta */
+    /* Shuffle samples, get new delta, saturated to a lower bound of 16.
+     * The truncation to 16-bit must happen before the saturation */
     sample2 = sample1;
     sample1 = sample;
     delta = static_cast<int16_t>(adaptionTable[nibble] * delta / 256);
-
-    /* Saturate the delta to a lower bound of 16 */
-    if (delta < 16)
-        delta = 16;
+    delta = std::max<int16_t>(16, delta);
 
     return sample;
 }
@@ -93,12 +84,14 @@ void DecoderMSADPCM::toPCM(BinaryIStream &source, int nbChannels, int sampleAlig
             pcmOut.push_back(sample2);
             pcmOut.push_back(sample1);
 
-            /* Go through the bytes in this MSADPCM block. */
-            for (int bi = 2; bi < sampleAlign; bi += 2) {
+            /* Go through the bytes in this MSADPCM block, from raw bytes
+             * with the bounds check hoisted out of the loop. */
+            int bodyBytes = std::min((sampleAlign - 1) / 2, source.remaining());
+            const uint8_t* bytes = source.current();
+            source.skip(bodyBytes);
+            for (int bi = 0; bi < bodyBytes; bi++) {
                 /* Each sample is one half of a nibbleBlock. */
-                uint8_t sampleByte;
-                source >> sampleByte;
-                if (!source) break;
+                uint8_t sampleByte = bytes[bi];
                 pcmOut.push_back(calculateSample(sampleByte >>  4, predictor, sample1, sample2, delta));
                 pcmOut.push_back(calculateSample(sampleByte & 0xF, predictor, sample1, sample2, delta));
             }
@@ -124,11 +117,13 @@ void DecoderMSADPCM::toPCM(BinaryIStream &source, int nbChannels, int sampleAlig
             pcmOut.push_back(lsample1);
             pcmOut.push_back(rsample1);
 
-            /* Go through the bytes in this MSADPCM block. */
-            for (int bi = 4; bi < (sampleAlign*2); bi += 2) {
-                uint8_t sampleByte;
-                source >> sampleByte;
-                if (!source) break;
+            /* Go through the bytes in this MSADPCM block, from raw bytes
+             * with the bounds check hoisted out of the loop. */
+            int bodyBytes = std::min(sampleAlign - 2, source.remaining());
+            const uint8_t* bytes = source.current();
+            source.skip(bodyBytes);
+            for (int bi = 0; bi < bodyBytes; bi++) {
+                uint8_t sampleByte = bytes[bi];
                 /* Each sample is one half of a nibbleBlock. */
                 pcmOut.push_back(calculateSample(sampleByte >>  4, lpredictor, lsample1, lsample2, ldelta));
                 pcmOut.push_back(calculateSample(sampleByte & 0xF, rpredictor, rsample1, rsample2, rdelta));
@@ -27,8 +27,11 @@ namespace libtas {
 int snd_device_name_hint(int card, const char *iface, void ***hints)
 {
     debuglog(LCF_SOUND, __func__, " call with card ", card, " and iface ", iface);
-    /* Mimicking an array with one device */
-    void* strs[2] = {reinterpret_cast<void*>(1), nullptr};
+    /* Mimicking an array with one device. The array is immutable and
+     * process-wide, so we can hand out the same one on every probe and
+     * snd_device_name_free_hint() has nothing to release.
+     */
+    static void* strs[2] = {reinterpret_cast<void*>(1), nullptr};
     *hints = strs;
     return 0;
 }
@@ -380,12 +380,13 @@ snd_pcm_sframes_t snd_pcm_writei(snd_pcm_t *pcm, const void *buffer, snd_pcm_ufr
         ab->frequency = ref->frequency;
     }
 
-    /* Filling buffer */
+    /* Filling buffer, recycling pooled storage */
     ab->update(); // Compute alignSize
     ab->sampleSize = size;
     ab->size = size * ab->alignSize;
-    ab->samples.clear();
-    ab->samples.insert(ab->samples.end(), static_cast<const uint8_t*>(buffer), &(static_cast<const uint8_t*>(buffer))[ab->size]);
+    audiocontext.fetchSampleStorage(ab->samples, ab->size);
+    ab->samples->clear();
+    ab->samples->insert(ab->samples->end(), static_cast<const uint8_t*>(buffer), &(static_cast<const uint8_t*>(buffer))[ab->size]);
 
     sourceAlsa->buffer_queue.push_back(ab);
 
@@ -459,16 +460,17 @@ int snd_pcm_mmap_begin(snd_pcm_t *pcm, const snd_pcm_channel_area_t **areas, snd
     ab->update(); // Compute alignSize
     ab->sampleSize = *frames;
     ab->size = *frames * ab->alignSize;
-    ab->samples.resize(ab->size);
+    audiocontext.fetchSampleStorage(ab->samples, ab->size);
+    ab->samples->resize(ab->size);
     sourceAlsa->buffer_queue.push_back(ab);
 
     /* Fill the area info */
     static snd_pcm_channel_area_t my_areas[2];
-    my_areas[0].addr = ab->samples.data();
+    my_areas[0].addr = ab->samples->data();
     my_areas[0].first = 0;
     my_areas[0].step = ab->alignSize * 8; // in bits
 
-    my_areas[1].addr = ab->samples.data();
+    my_areas[1].addr = ab->samples->data();
     my_areas[1].first = ab->bitDepth; // in bits
     my_areas[1].step = ab->alignSize * 8; // in bits
 
@@ -492,6 +494,12 @@ snd_pcm_sframes_t snd_pcm_mmap_commit(snd_pcm_t *pcm, snd_pcm_uframes_t offset,
 }
 
 
+/* The hw/sw parameter space we advertise is fixed: every getter below
+ * answers from a constant or from a field of the alsa buffer, and the
+ * param objects themselves are opaque tokens (see *_malloc). Nothing is
+ * computed or allocated during negotiation, so games that re-negotiate
+ * parameters periodically and SDL's startup probe stay cheap.
+ */
 int snd_pcm_hw_params_any(snd_pcm_t *pcm, snd_pcm_hw_params_t *params)
 {
     if (GlobalState::isNative()) {
@@ -213,10 +213,10 @@ void alBufferData(ALuint buffer, ALenum format, const ALvoid *data, ALsizei size
         return;
     }
 
-    /* Copy the data into our buffer */
-    ab->samples.clear();
-    ab->samples.insert(ab->samples.end(), &((uint8_t*)data)[0], &((uint8_t*)data)[size]);
-
+    /* Store the payload content-hashed, so that a game re-uploading the
+     * same sound (or duplicating it across buffers) shares one refcounted
+     * copy instead of getting another one */
+    audiocontext.storeSharedSamples(ab->samples, static_cast<const uint8_t*>(data), size);
 }
 
 void alBufferf(ALuint buffer, ALenum param, ALfloat value)
@@ -403,6 +403,7 @@ void alDeleteSources(ALsizei n, ALuint *sources)
 {
     debuglog(LCF_OPENAL, __func__, " call - delete ", n, " sources");
     std::lock_guard<std::mutex> lock(audiocontext.mutex);
+    audiocontext.applySourceCommands();
 	for (int i=0; i<n; i++) {
         /* Check if all sources exist before removing any. */
 	    if (! audiocontext.isSource(sources[i])) {
@@ -429,7 +430,22 @@ ALboolean alIsSource(ALuint source)
 void alSourcef(ALuint source, ALenum param, ALfloat value)
 {
     debuglogstdio(LCF_OPENAL, "%s called with source %d", __func__, source);
-    std::lock_guard<std::mutex> lock(audiocontext.mutex);
+
+    /* If the mutex is contended (typically by the frame-boundary mixing),
+     * queue the simple scalar updates into the command ring instead of
+     * blocking. They are applied at the next locked audio operation */
+    std::unique_lock<std::mutex> lock(audiocontext.mutex, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        if ((param == AL_GAIN) &&
+                audiocontext.queueSourceCommand(source, AudioContext::SourceCommand::SET_GAIN, value))
+            return;
+        if ((param == AL_PITCH) &&
+                audiocontext.queueSourceCommand(source, AudioContext::SourceCommand::SET_PITCH, value))
+            return;
+        lock.lock();
+    }
+    audiocontext.applySourceCommands();
+
     auto as = audiocontext.getSource(source);
     if (!as) {
         alSetError(AL_INVALID_NAME);
@@ -534,7 +550,17 @@ void alSourcefv(ALuint source, ALenum param, ALfloat *values)
 void alSourcei(ALuint source, ALenum param, ALint value)
 {
     debuglogstdio(LCF_OPENAL, "%s called with source %d", __func__, source);
-    std::lock_guard<std::mutex> lock(audiocontext.mutex);
+
+    /* Same contention escape as in alSourcef() */
+    std::unique_lock<std::mutex> lock(audiocontext.mutex, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        if ((param == AL_LOOPING) && ((value == AL_TRUE) || (value == AL_FALSE)) &&
+                audiocontext.queueSourceCommand(source, AudioContext::SourceCommand::SET_LOOPING, value))
+            return;
+        lock.lock();
+    }
+    audiocontext.applySourceCommands();
+
     auto as = audiocontext.getSource(source);
     if (!as) {
         alSetError(AL_INVALID_NAME);
@@ -649,6 +675,7 @@ void alGetSourcef(ALuint source, ALenum param, ALfloat *value)
     }
 
     std::lock_guard<std::mutex> lock(audiocontext.mutex);
+    audiocontext.applySourceCommands();
     auto as = audiocontext.getSource(source);
     if (!as)
         return;
@@ -728,6 +755,7 @@ void alGetSourcei(ALuint source, ALenum param, ALint *value)
     }
 
     std::lock_guard<std::mutex> lock(audiocontext.mutex);
+    audiocontext.applySourceCommands();
     auto as = audiocontext.getSource(source);
     if (!as) {
         alSetError(AL_INVALID_NAME);
@@ -848,6 +876,7 @@ void alSourcePlay(ALuint source)
 {
     DEBUGLOGCALL(LCF_OPENAL);
     std::lock_guard<std::mutex> lock(audiocontext.mutex);
+    audiocontext.applySourceCommands();
     auto as = audiocontext.getSource(source);
     if (!as)
         return;
@@ -870,6 +899,7 @@ void alSourcePause(ALuint source)
 {
     DEBUGLOGCALL(LCF_OPENAL);
     std::lock_guard<std::mutex> lock(audiocontext.mutex);
+    audiocontext.applySourceCommands();
     auto as = audiocontext.getSource(source);
     if (!as)
         return;
@@ -892,6 +922,7 @@ void alSourceStop(ALuint source)
 {
     DEBUGLOGCALL(LCF_OPENAL);
     std::lock_guard<std::mutex> lock(audiocontext.mutex);
+    audiocontext.applySourceCommands();
     auto as = audiocontext.getSource(source);
     if (!as)
         return;
@@ -915,6 +946,7 @@ void alSourceRewind(ALuint source)
 {
     DEBUGLOGCALL(LCF_OPENAL);
     std::lock_guard<std::mutex> lock(audiocontext.mutex);
+    audiocontext.applySourceCommands();
     auto as = audiocontext.getSource(source);
     if (!as)
         return;
@@ -938,6 +970,7 @@ void alSourceQueueBuffers(ALuint source, ALsizei n, ALuint* buffers)
 {
     debuglog(LCF_OPENAL, "Pushing ", n, " buffers in the queue of source ", source);
     std::lock_guard<std::mutex> lock(audiocontext.mutex);
+    audiocontext.applySourceCommands();
     auto as = audiocontext.getSource(source);
     if (!as)
         return;
@@ -965,6 +998,7 @@ void alSourceUnqueueBuffers(ALuint source, ALsizei n, ALuint* buffers)
 {
     DEBUGLOGCALL(LCF_OPENAL);
     std::lock_guard<std::mutex> lock(audiocontext.mutex);
+    audiocontext.applySourceCommands();
     auto as = audiocontext.getSource(source);
     if (!as)
         return;
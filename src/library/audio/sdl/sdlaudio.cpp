@@ -108,7 +108,7 @@ void fillBufferCallback(AudioBuffer& ab)
 {
     /* Emptying the audio buffer */
     ab.makeSilent();
-    audioCallback(callbackArg, ab.samples.data(), ab.size);
+    audioCallback(callbackArg, ab.samples->data(), ab.size);
 }
 
 /* Override */ int SDL_OpenAudio(SDL_AudioSpec * desired, SDL_AudioSpec * obtained)
@@ -157,7 +157,8 @@ void fillBufferCallback(AudioBuffer& ab)
 
         buffer->size = desired->samples * buffer->alignSize;
         buffer->update(); // Yes, a second time, to fill sampleSize based on size.
-        buffer->samples.resize(buffer->size);
+        audiocontext.fetchSampleStorage(buffer->samples, buffer->size);
+        buffer->samples->resize(buffer->size);
 
         /* Push buffers in a source */
         int sourceId = audiocontext.createSource();
@@ -318,9 +319,10 @@ void SDL_MixAudio(Uint8 * dst, const Uint8 * src, Uint32 len, int volume)
         ab->frequency = ref->frequency;
     }
 
-    /* Filling buffer */
-    ab->samples.clear();
-    ab->samples.insert(ab->samples.end(), static_cast<const uint8_t*>(data), &(static_cast<const uint8_t*>(data))[len]);
+    /* Filling buffer, recycling pooled storage */
+    audiocontext.fetchSampleStorage(ab->samples, len);
+    ab->samples->clear();
+    ab->samples->insert(ab->samples->end(), static_cast<const uint8_t*>(data), &(static_cast<const uint8_t*>(data))[len]);
     ab->size = len;
     ab->update();
     sourceSDL->buffer_queue.push_back(ab);
@@ -22,6 +22,10 @@
 #include <execinfo.h>
 #include <memory>
 #include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <string>
 
 namespace libtas {
 
@@ -39,6 +43,71 @@ static const char* demangle( const char* const symbol )
     //}
 }
 
+/* Formatted line for each return address already symbolized. Symbolization
+ * (backtrace_symbols) dominates the cost of a capture, and the mapping from
+ * a return address to its line never changes, so repeated captures only pay
+ * for the raw unwind plus map lookups. */
+static std::map<void*, std::string>* symbol_cache;
+static std::mutex symbol_cache_mutex;
+
+/* Build the printable line from one backtrace_symbols() entry, extracting
+ * the "real" symbol that represents the mangled name. */
+static std::string formatSymbol(char* const symbol)
+{
+    char* end = symbol;
+    while( *end ) {
+        ++end;
+    }
+    /* Scanning is done backwards, since the module name
+     * might contain both '+' or '(' characters.
+     */
+    while( end != symbol && *end != '+' ) {
+        --end;
+    }
+    char* begin = end;
+    while( begin != symbol && *begin != '(' ) {
+        --begin;
+    }
+
+    if( begin != symbol ) {
+        std::string line(symbol, ++begin - symbol);
+        *end++ = '\0';
+        line += demangle( begin );
+        line += '+';
+        line += end;
+        return line;
+    }
+
+    return symbol;
+}
+
+std::string symbolizeAddress(void* address)
+{
+    std::lock_guard<std::mutex> lock(symbol_cache_mutex);
+    if (!symbol_cache) {
+        symbol_cache = new std::map<void*, std::string>();
+    }
+
+    auto it = symbol_cache->find(address);
+    if (it != symbol_cache->end())
+        return it->second;
+
+    std::string line;
+    char** symbols = backtrace_symbols(&address, 1);
+    if (symbols) {
+        line = formatSymbol(symbols[0]);
+        free(symbols);
+    }
+    else {
+        char buf[24];
+        snprintf(buf, sizeof(buf), "%p", address);
+        line = buf;
+    }
+
+    (*symbol_cache)[address] = line;
+    return line;
+}
+
 void printBacktrace(void)
 {
     thread_local static int recurs = 0;
@@ -49,38 +118,38 @@ void printBacktrace(void)
     //threadState.setNoLog(true);
     void* addresses[256];
     const int n = backtrace(addresses, 256);
-    char** symbols = backtrace_symbols(addresses, n);
+
+    std::lock_guard<std::mutex> lock(symbol_cache_mutex);
+    if (!symbol_cache) {
+        symbol_cache = new std::map<void*, std::string>();
+    }
+
+    /* Symbolize only the addresses we have not seen yet, in one batch */
+    void* uncached[256];
+    int nu = 0;
     for( int i = 0; i < n; ++i ) {
-        /* We parse the symbols retrieved from backtrace_symbols() to
-         * extract the "real" symbols that represent the mangled names.
-         */
-        char* const symbol = symbols[i];
-        char* end = symbol;
-        while( *end ) {
-            ++end;
-        }
-        /* Scanning is done backwards, since the module name
-         * might contain both '+' or '(' characters.
-         */
-        while( end != symbol && *end != '+' ) {
-            --end;
-        }
-        char* begin = end;
-        while( begin != symbol && *begin != '(' ) {
-            --begin;
-        }
+        if (symbol_cache->find(addresses[i]) == symbol_cache->end())
+            uncached[nu++] = addresses[i];
+    }
 
-        if( begin != symbol ) {
-            fprintf(stderr, "%.*s", static_cast<int>(++begin - symbol), symbol);
-            *end++ = '\0';
-            fprintf(stderr, "%s+%s\n", demangle( begin ), end);
-        }
-        else {
-            fprintf(stderr, "%s\n", symbol);
+    if (nu > 0) {
+        char** symbols = backtrace_symbols(uncached, nu);
+        if (symbols) {
+            for( int i = 0; i < nu; ++i ) {
+                (*symbol_cache)[uncached[i]] = formatSymbol(symbols[i]);
+            }
+            free(symbols);
         }
     }
+
+    for( int i = 0; i < n; ++i ) {
+        auto it = symbol_cache->find(addresses[i]);
+        if (it != symbol_cache->end())
+            fprintf(stderr, "%s\n", it->second.c_str());
+        else
+            fprintf(stderr, "%p\n", addresses[i]);
+    }
     fprintf(stderr, "\n");
-    free(symbols);
     //threadState.setNoLog(false);
     recurs = 0;
 }
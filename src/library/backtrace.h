@@ -20,8 +20,14 @@
 #ifndef LIBTAS_BACKTRACE_H_INCL
 #define LIBTAS_BACKTRACE_H_INCL
 
+#include <string>
+
 namespace libtas {
 void printBacktrace(void);
+
+/* Formatted line for a single return address, going through the same
+ * symbol cache as printBacktrace() */
+std::string symbolizeAddress(void* address);
 }
 
 #endif
@@ -29,6 +29,7 @@
 #include "../Utils.h"
 #include <fcntl.h>
 #include <sys/stat.h>
+#include <sys/sysmacros.h> // major, minor
 #include <unistd.h>
 #include <sys/mman.h>
 #include <cstring>
@@ -36,14 +37,26 @@
 #include <X11/Xlibint.h>
 #include <X11/Xlib-xcb.h>
 #include <sys/statvfs.h>
+#include <sys/wait.h>
 #include <sys/syscall.h>
 #include "errno.h"
 #include "../../external/xcbint.h"
 #include "../renderhud/RenderHUD.h"
 #include "ReservedMemory.h"
 #include "SaveState.h"
-
-#define ONE_MB 1024 * 1024
+#include "StateCompression.h"
+#include "ParallelRestore.h"
+#include "ParallelSave.h"
+#include "StateTier.h"
+#include "PageStore.h"
+#include "LazyRestore.h"
+#include <fnmatch.h>
+#include <vector>
+
+#ifdef LIBTAS_ENABLE_ZSTD
+#define ZSTD_STATIC_LINKING_ONLY
+#include <zstd.h>
+#endif
 
 namespace libtas {
 
@@ -71,6 +84,39 @@ static void readAnArea(SaveState &saved_area, int spmfd, SaveState &parent_state
 static size_t writeAllAreas(bool base);
 static size_t writeAnArea(int pmfd, int pfd, int spmfd, Area &area, SaveState &parent_state);
 
+static void verifyStateChecksums();
+
+/* User-configured mapping path globs excluded from savestates. The list
+ * is parsed outside of the checkpoint context and only read inside it,
+ * so no allocation happens while the threads are suspended. */
+static std::vector<std::string> ignore_patterns;
+
+/* Pid of the child performing a background savestate, stored in reserved
+ * memory so that it survives state loadings */
+static pid_t getChildPid()
+{
+    pid_t* child_pid = static_cast<pid_t*>(ReservedMemory::getAddr(ReservedMemory::CHILDPID_ADDR));
+    return *child_pid;
+}
+
+static void setChildPid(pid_t pid)
+{
+    pid_t* child_pid = static_cast<pid_t*>(ReservedMemory::getAddr(ReservedMemory::CHILDPID_ADDR));
+    *child_pid = pid;
+}
+
+void Checkpoint::waitChild()
+{
+    pid_t pid = getChildPid();
+    if (pid) {
+        debuglogstdio(LCF_CHECKPOINT, "Waiting for the background savestate to complete");
+        int ret;
+        NATIVECALL(ret = waitpid(pid, nullptr, 0));
+        MYASSERT(ret == pid)
+        setChildPid(0);
+    }
+}
+
 void Checkpoint::setSavestatePath(std::string path)
 {
     std::string pmpath = path + ".pm";
@@ -78,6 +124,15 @@ void Checkpoint::setSavestatePath(std::string path)
 
     std::string ppath = path + ".p";
     strncpy(pagespath, ppath.c_str(), 1023);
+
+    /* All savestate slots of a game share one page store, so derive its path
+     * by stripping the slot suffix from the savestate path */
+    std::string storepath = path;
+    size_t pos = storepath.rfind(".state");
+    if (pos != std::string::npos)
+        storepath.resize(pos);
+    storepath += ".pagestore";
+    PageStore::setPath(storepath);
 }
 
 void Checkpoint::setBaseSavestatePath(std::string path)
@@ -99,6 +154,58 @@ void Checkpoint::setBaseSavestateIndex(int index)
     base_ss_index = index;
 }
 
+int Checkpoint::getSavestateIndex()
+{
+    return ss_index;
+}
+
+void Checkpoint::setIgnorePatterns(const std::string& patterns)
+{
+    ignore_patterns.clear();
+    size_t start = 0;
+    while (start < patterns.size()) {
+        size_t end = patterns.find('\n', start);
+        if (end == std::string::npos)
+            end = patterns.size();
+        if (end > start)
+            ignore_patterns.emplace_back(patterns.substr(start, end - start));
+        start = end + 1;
+    }
+}
+
+/* The ring buffer bookkeeping lives in reserved memory, like the state file
+ * descriptors, so that it survives state loading. `next` is the slot that the
+ * next rewind state will be saved into, so the most recent state is in the
+ * slot just before it. */
+struct RewindRing {
+    int next;
+    int count;
+};
+
+void Checkpoint::setRewindSaveIndex()
+{
+    RewindRing* ring = static_cast<RewindRing*>(ReservedMemory::getAddr(ReservedMemory::REWIND_ADDR));
+    ss_index = SAVESTATE_SLOTS + ring->next;
+    ring->next = (ring->next + 1) % REWIND_SLOTS;
+    if (ring->count < REWIND_SLOTS)
+        ring->count++;
+}
+
+bool Checkpoint::setRewindLoadIndex()
+{
+    RewindRing* ring = static_cast<RewindRing*>(ReservedMemory::getAddr(ReservedMemory::REWIND_ADDR));
+    if (ring->count == 0)
+        return false;
+
+    /* Pop the most recent state, so that consecutive rewinds walk back in
+     * time. The pop survives the state loading because the ring lives in
+     * reserved memory. */
+    ring->next = (ring->next + REWIND_SLOTS - 1) % REWIND_SLOTS;
+    ring->count--;
+    ss_index = SAVESTATE_SLOTS + ring->next;
+    return true;
+}
+
 void Checkpoint::setCurrentToParent()
 {
     strncpy(parentpagemappath, pagemappath, 1023);
@@ -133,8 +240,20 @@ static void setPagesFd(int index, int fd)
 
 bool Checkpoint::checkCheckpoint()
 {
-    if (shared_config.savestates_in_ram)
+    /* A previous background savestate must be completed before its slot can
+     * be reused or its parent overwritten, and a tier migration before the
+     * slot memfds are touched */
+    waitChild();
+    StateTier::finish();
+
+    if (shared_config.savestates_in_ram) {
+        /* The slot is being overwritten, so drop its demoted copy, and
+         * rebalance the tiers while the restore worker stacks are free */
+        StateTier::prepareSave(ss_index);
+        StateTier::touch(ss_index);
+        StateTier::balance(ss_index, pagemappath);
         return true;
+    }
 
     /* Get an estimation of the savestate space */
     size_t savestate_size = 0;
@@ -176,8 +295,21 @@ bool Checkpoint::checkCheckpoint()
 
 bool Checkpoint::checkRestore()
 {
+    /* A previous background savestate must be completed before loading,
+     * and a tier migration before the slot memfds are read */
+    waitChild();
+    StateTier::finish();
+
     /* Check that the savestate files exist */
     if (shared_config.savestates_in_ram) {
+        /* Bring the slot back into its memfds first if it was demoted */
+        if (!StateTier::ensureResident(ss_index)) {
+#ifdef LIBTAS_ENABLE_HUD
+            RenderHUD::insertMessage("Savestate could not be brought back to RAM");
+#endif
+            return false;
+        }
+
         if (!getPagemapFd(ss_index)) {
             debuglogstdio(LCF_CHECKPOINT | LCF_ERROR, "Savestate does not exist");
 #ifdef LIBTAS_ENABLE_HUD
@@ -193,6 +325,8 @@ bool Checkpoint::checkRestore()
 #endif
             return false;
         }
+
+        StateTier::touch(ss_index);
     }
     else {
         struct stat sb;
@@ -417,6 +551,22 @@ static bool skipArea(const Area *area)
         return true;
     }
 
+    /* Don't save the shared ring used to communicate with the program.
+     * Rolling back its counters on a state load would desync both sides */
+    if (strstr(area->name, "libtas-ring")) {
+        return true;
+    }
+
+    /* Skip mappings matching a user-configured pattern. Driver arenas and
+     * shader caches can be very large and are never read back by the game,
+     * but some of them are writable, so they pass the checks below. */
+    if (area->name[0] && !ignore_patterns.empty()) {
+        for (const std::string& pattern : ignore_patterns) {
+            if (fnmatch(pattern.c_str(), area->name, 0) == 0)
+                return true;
+        }
+    }
+
     /* Save area if write permission */
     if (area->prot & PROT_WRITE) {
         return false;
@@ -434,7 +584,18 @@ static bool skipArea(const Area *area)
 
 static void readAllAreas()
 {
-    SaveState saved_state(pagemappath, pagespath, getPagemapFd(ss_index), getPagesFd(ss_index));
+    /* Verify the state file checksums first, before any memory is modified */
+    if (shared_config.checksum_savestates)
+        verifyStateChecksums();
+
+    SaveState saved_state(pagemappath, pagespath, getPagemapFd(ss_index), getPagesFd(ss_index), 0);
+
+    /* Open the shared page store in case savestates reference deduplicated
+     * pages */
+    PageStore::beginRead();
+
+    /* Prepare the lazy mapping of page runs for file-backed states */
+    LazyRestore::init();
 
     int spmfd, crfd;
     if (shared_config.incremental_savestates) {
@@ -485,17 +646,26 @@ static void readAllAreas()
 
     /* Load base and parent savestates */
     SaveState parent_state(parentpagemappath, parentpagespath, getPagemapFd(parent_ss_index), getPagesFd(parent_ss_index));
-    SaveState base_state(basepagemappath, basepagespath, getPagemapFd(base_ss_index), getPagesFd(base_ss_index));
+    SaveState base_state(basepagemappath, basepagespath, getPagemapFd(base_ss_index), getPagesFd(base_ss_index), 1);
 
     /* If the loading savestate and the parent savestate are the same, pass the
      * same SaveState object to readAnArea because two SaveState objects
      * handling the same file descriptor will mess up the file offset. */
     bool same_state = (ss_index == parent_ss_index);
+
+    /* Queue the page loads so that they are spread across the restore
+     * worker pool instead of being read one by one */
+    ParallelRestore::init();
+
     while (saved_area.addr != nullptr) {
         readAnArea(saved_state, spmfd, same_state?saved_state:parent_state, base_state);
         saved_state.nextArea();
     }
 
+    ParallelRestore::finish();
+
+    PageStore::end();
+
     if (shared_config.incremental_savestates) {
         /* Clear soft-dirty bits */
         Utils::writeAll(crfd, "4\n", 2);
@@ -523,6 +693,22 @@ static int reallocateArea(Area *saved_area, Area *current_area)
                 saved_area->print("Saved");
                 current_area->print("Current");
             }
+            /* The state holds no content for this mapping, only the backing
+             * file identity. Its content after loading is whatever the file
+             * holds now, so warn when the file changed since save time. */
+            else if ((saved_area->name[0] == '/') && (saved_area->filesize != 0)) {
+                struct stat filestat;
+                int ret;
+                NATIVECALL(ret = stat(saved_area->name, &filestat));
+                if ((ret != 0) ||
+                    (major(filestat.st_dev) != saved_area->devmajor) ||
+                    (minor(filestat.st_dev) != saved_area->devminor) ||
+                    (filestat.st_ino != saved_area->inodenum) ||
+                    (filestat.st_mtime != saved_area->mtime) ||
+                    (filestat.st_size != saved_area->filesize)) {
+                    debuglogstdio(LCF_CHECKPOINT | LCF_ERROR, "Backing file %s of a skipped mapping changed since the state was saved, its content cannot be restored", saved_area->name);
+                }
+            }
             return 0;
         }
 
@@ -779,7 +965,7 @@ static void readAnArea(SaveState &saved_state, int spmfd, SaveState &parent_stat
                  * We must read from the base savestate.
                  */
                 char base_flag = base_state.getPageFlag(curAddr);
-                MYASSERT(base_flag == Area::FULL_PAGE);
+                MYASSERT((base_flag == Area::FULL_PAGE) || (base_flag == Area::DEDUP_PAGE));
                 base_state.queuePageLoad(curAddr);
             }
             else {
@@ -792,7 +978,7 @@ static void readAnArea(SaveState &saved_state, int spmfd, SaveState &parent_stat
                      * We must read from the base savestate.
                      */
                     char base_flag = base_state.getPageFlag(curAddr);
-                    MYASSERT(base_flag == Area::FULL_PAGE);
+                    MYASSERT((base_flag == Area::FULL_PAGE) || (base_flag == Area::DEDUP_PAGE));
                     base_state.queuePageLoad(curAddr);
                 }
             }
@@ -806,11 +992,386 @@ static void readAnArea(SaveState &saved_state, int spmfd, SaveState &parent_stat
 
     /* Recover permission to the area */
     if (!(saved_area.prot & PROT_WRITE)) {
+        /* Deferred loads into this area must complete before the write
+         * permission is removed */
+        ParallelRestore::flush();
         MYASSERT(mprotect(saved_area.addr, saved_area.size, saved_area.prot) == 0)
     }
 }
 
 
+/* Optional checksumming of the savestate files. A rolling xxHash64-style
+ * word hash (same mixing constants as the page store) is fed with every byte
+ * written to each file, and the result is stored in the state header, so
+ * that verifying a file at load time is a plain sequential read. A pending
+ * buffer keeps the hash independent of how the writes are chunked. */
+#define PRIME64_1 11400714785074694791ULL
+#define PRIME64_2 14029467366897019727ULL
+#define PRIME64_3  1609587929392839161ULL
+#define PRIME64_5  2870177450012600261ULL
+
+static inline uint64_t rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t round64(uint64_t acc, uint64_t input)
+{
+    acc += input * PRIME64_2;
+    acc = rotl64(acc, 31);
+    acc *= PRIME64_1;
+    return acc;
+}
+
+struct StreamHash {
+    uint64_t acc;
+    uint64_t total;
+    unsigned char pending[8];
+    unsigned int pending_len;
+};
+
+static void hashInit(StreamHash& h)
+{
+    h.acc = PRIME64_5;
+    h.total = 0;
+    h.pending_len = 0;
+}
+
+static void hashUpdate(StreamHash& h, const void* data, size_t size)
+{
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    h.total += size;
+
+    /* Complete a pending word from a previous unaligned update */
+    if (h.pending_len > 0) {
+        while ((h.pending_len < 8) && (size > 0)) {
+            h.pending[h.pending_len++] = *p++;
+            size--;
+        }
+        if (h.pending_len < 8)
+            return;
+        uint64_t w;
+        memcpy(&w, h.pending, 8);
+        h.acc = round64(h.acc, w);
+        h.pending_len = 0;
+    }
+
+    for (; size >= 8; size -= 8, p += 8) {
+        uint64_t w;
+        memcpy(&w, p, 8);
+        h.acc = round64(h.acc, w);
+    }
+
+    while (size > 0) {
+        h.pending[h.pending_len++] = *p++;
+        size--;
+    }
+}
+
+static uint64_t hashFinal(StreamHash& h)
+{
+    if (h.pending_len > 0) {
+        uint64_t w = 0;
+        memcpy(&w, h.pending, h.pending_len);
+        h.acc = round64(h.acc, w);
+    }
+
+    /* Final avalanche, as in xxHash64 */
+    uint64_t v = h.acc + h.total;
+    v ^= v >> 33;
+    v *= PRIME64_2;
+    v ^= v >> 29;
+    v *= PRIME64_3;
+    v ^= v >> 32;
+    return v;
+}
+
+/* Checksum accumulators of the state saving in progress, indexed by file
+ * (pagemap, pages) */
+static bool checksum_states = false;
+static int checksum_pmfd = -1;
+static int checksum_pfd = -1;
+static StreamHash checksum_hash[2];
+
+/* Recompute the checksum of one savestate file and compare it against the
+ * stored one, reporting a mismatch in the log */
+static void verifyStateFile(int fd, off_t skip, uint64_t expected, const char* name)
+{
+    char buf[4096];
+    StreamHash h;
+    hashInit(h);
+
+    lseek(fd, skip, SEEK_SET);
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) > 0) {
+        hashUpdate(h, buf, n);
+    }
+
+    uint64_t computed = hashFinal(h);
+    if (computed != expected) {
+        debuglogstdio(LCF_CHECKPOINT | LCF_ERROR, "Savestate %s file checksum mismatch (computed %llx, stored %llx), the state file is corrupted !",
+            name, static_cast<unsigned long long>(computed), static_cast<unsigned long long>(expected));
+    }
+    else {
+        debuglogstdio(LCF_CHECKPOINT, "Savestate %s file checksum verified", name);
+    }
+}
+
+/* Verify the checksums of the state being loaded, before any memory is
+ * modified, so that a corrupted state file is reported before the game
+ * threads resume. States saved without checksums are left unverified. */
+static void verifyStateChecksums()
+{
+    int pmfd, pfd;
+
+    if (shared_config.savestates_in_ram) {
+        pmfd = getPagemapFd(ss_index);
+        pfd = getPagesFd(ss_index);
+        if (!pmfd)
+            return;
+    }
+    else {
+        NATIVECALL(pmfd = open(pagemappath, O_RDONLY));
+        if (pmfd == -1)
+            return;
+        NATIVECALL(pfd = open(pagespath, O_RDONLY));
+        if (pfd == -1) {
+            NATIVECALL(close(pmfd));
+            return;
+        }
+    }
+
+    StateHeader sh;
+    lseek(pmfd, 0, SEEK_SET);
+    Utils::readAll(pmfd, &sh, sizeof(sh));
+
+    if (sh.checksummed) {
+        verifyStateFile(pmfd, sizeof(StateHeader), sh.pagemap_checksum, "pagemap");
+        verifyStateFile(pfd, 0, sh.pages_checksum, "pages");
+    }
+
+    /* The file offsets are left past the end, but every reader seeks
+     * absolutely before reading */
+    if (!shared_config.savestates_in_ram) {
+        NATIVECALL(close(pmfd));
+        NATIVECALL(close(pfd));
+    }
+}
+
+/* Write savestate data, deferring to the write worker when it is running so
+ * that disk writes overlap with the pagemap scanning */
+static void stateWrite(int fd, const void* data, size_t size)
+{
+    if (checksum_states) {
+        if (fd == checksum_pmfd)
+            hashUpdate(checksum_hash[0], data, size);
+        else if (fd == checksum_pfd)
+            hashUpdate(checksum_hash[1], data, size);
+    }
+
+    if (ParallelSave::isActive())
+        ParallelSave::queueWrite(fd, data, size);
+    else
+        Utils::writeAll(fd, data, size);
+}
+
+/* Uncompressed full pages are gathered into a scatter list and written with
+ * a single writev instead of one write syscall per page, with adjacent pages
+ * coalesced into one iovec entry. The page content is stable while gathered:
+ * area protections are only restored after the dump. The list must be
+ * flushed before any other write to the pages file, so that pages land at
+ * the offsets recorded in the pagemap. */
+#define PAGE_GATHER_MAX 64
+static struct iovec page_gather[PAGE_GATHER_MAX];
+static int page_gather_count = 0;
+static int page_gather_fd = -1;
+
+static void flushPageGather()
+{
+    if (page_gather_count == 0)
+        return;
+
+    /* Gathered pages bypass stateWrite, hash them here. writeAllV modifies
+     * the iovec array to track progress, so this must come first. */
+    if (checksum_states && (page_gather_fd == checksum_pfd)) {
+        for (int i = 0; i < page_gather_count; i++)
+            hashUpdate(checksum_hash[1], page_gather[i].iov_base, page_gather[i].iov_len);
+    }
+
+    Utils::writeAllV(page_gather_fd, page_gather, page_gather_count);
+    page_gather_count = 0;
+}
+
+static void gatherPageWrite(int pfd, char* addr)
+{
+    /* Coalesce with the previous entry if the pages are adjacent */
+    if (page_gather_count > 0) {
+        struct iovec& last = page_gather[page_gather_count-1];
+        if (static_cast<char*>(last.iov_base) + last.iov_len == addr) {
+            last.iov_len += 4096;
+            return;
+        }
+    }
+
+    if (page_gather_count == PAGE_GATHER_MAX)
+        flushPageGather();
+
+    page_gather_fd = pfd;
+    page_gather[page_gather_count].iov_base = addr;
+    page_gather[page_gather_count].iov_len = 4096;
+    page_gather_count++;
+}
+
+/* Run-length writer for the per-page flag stream of an area. Flags occur in
+ * huge homogeneous runs (all-zero, all file-backed), so the pagemap file
+ * stores {count, flag} records terminated by a zero count, instead of one
+ * byte per page (see PageFlagRun in SaveState.h). Records are accumulated
+ * into a chunk which is flushed when full and at the end of each area. */
+#define FLAG_RUN_CHUNK 512
+static PageFlagRun flag_runs[FLAG_RUN_CHUNK];
+static int flag_run_count = 0;
+
+static size_t flushFlagRuns(int pmfd)
+{
+    size_t size = flag_run_count * sizeof(PageFlagRun);
+    if (size > 0)
+        stateWrite(pmfd, flag_runs, size);
+    flag_run_count = 0;
+    return size;
+}
+
+/* Append one page flag to the run stream, returning the number of bytes
+ * written to the pagemap file */
+static size_t pushPageFlag(int pmfd, char flag)
+{
+    if ((flag_run_count > 0) &&
+        (flag_runs[flag_run_count-1].flag == static_cast<uint32_t>(flag))) {
+        flag_runs[flag_run_count-1].count++;
+        return 0;
+    }
+
+    size_t written = 0;
+    if (flag_run_count == FLAG_RUN_CHUNK)
+        written = flushFlagRuns(pmfd);
+
+    flag_runs[flag_run_count].count = 1;
+    flag_runs[flag_run_count].flag = flag;
+    flag_run_count++;
+    return written;
+}
+
+/* Terminate the run stream of an area and flush it */
+static size_t endFlagRuns(int pmfd)
+{
+    size_t written = 0;
+    if (flag_run_count == FLAG_RUN_CHUNK)
+        written = flushFlagRuns(pmfd);
+
+    flag_runs[flag_run_count].count = 0;
+    flag_runs[flag_run_count].flag = 0;
+    flag_run_count++;
+    return written + flushFlagRuns(pmfd);
+}
+
+#ifdef LIBTAS_ENABLE_ZSTD
+
+/* Savestate compression writer state. Pages from all areas are accumulated
+ * into a chunk buffer which is compressed with zstd and flushed to the pages
+ * file when full. Buffers and the compression context are carved out of the
+ * reserved memory segment, because we must not allocate memory here. */
+static bool compress_states = false;
+static char* comp_in = nullptr;
+static char* comp_out = nullptr;
+static ZSTD_CCtx* comp_cctx = nullptr;
+static size_t comp_fill = 0;
+static uint64_t comp_pos = 0;
+
+static void initCompressedWrite()
+{
+    compress_states = true;
+    char* ws = static_cast<char*>(ReservedMemory::getAddr(
+        ReservedMemory::COMPRESS_ADDR + StateCompression::WRITER_OFF));
+    comp_in = ws;
+    comp_out = ws + StateCompression::CHUNK_SIZE;
+    char* cctx_ws = comp_out + StateCompression::CHUNK_SIZE + StateCompression::CHUNK_MARGIN;
+    comp_cctx = ZSTD_initStaticCCtx(cctx_ws, StateCompression::WRITER_SIZE - (cctx_ws - ws));
+    MYASSERT(comp_cctx != nullptr)
+    comp_fill = 0;
+    comp_pos = 0;
+}
+
+/* Compress and write the pending chunk, returning the number of bytes written */
+static size_t flushCompressedChunk(int pfd)
+{
+    if (comp_fill == 0)
+        return 0;
+
+    StateCompression::ChunkHeader ch;
+    ch.start = comp_pos;
+    ch.raw_size = comp_fill;
+
+    size_t csize = ZSTD_compressCCtx(comp_cctx, comp_out,
+        StateCompression::CHUNK_SIZE + StateCompression::CHUNK_MARGIN,
+        comp_in, comp_fill, 1);
+    MYASSERT(!ZSTD_isError(csize))
+    ch.comp_size = csize;
+
+    stateWrite(pfd, &ch, sizeof(ch));
+    stateWrite(pfd, comp_out, csize);
+
+    comp_pos += comp_fill;
+    comp_fill = 0;
+    return sizeof(ch) + csize;
+}
+
+#endif
+
+/* Is the shared page store consulted before appending a page? */
+static bool dedup_states = false;
+
+/* Write a single memory page into the pages file or reference it in the
+ * shared page store, setting the matching pagemap flag. Returns the number
+ * of bytes appended to the pages file. */
+static size_t writeAPage(int pfd, char* addr, char* flag)
+{
+    const char* data = addr;
+    size_t data_size = 4096;
+    uint64_t store_offset;
+
+    *flag = Area::FULL_PAGE;
+
+    if (dedup_states) {
+        store_offset = PageStore::writePage(addr);
+        if (store_offset != UINT64_MAX) {
+            /* The page content is in the store, the pages file only gets
+             * its 8-byte offset */
+            *flag = Area::DEDUP_PAGE;
+            data = reinterpret_cast<char*>(&store_offset);
+            data_size = 8;
+        }
+    }
+
+#ifdef LIBTAS_ENABLE_ZSTD
+    if (compress_states) {
+        memcpy(comp_in + comp_fill, data, data_size);
+        comp_fill += data_size;
+        if (comp_fill + 4096 > static_cast<size_t>(StateCompression::CHUNK_SIZE))
+            return flushCompressedChunk(pfd);
+        return 0;
+    }
+#endif
+    if (!ParallelSave::isActive() && data_size == 4096) {
+        gatherPageWrite(pfd, addr);
+        return data_size;
+    }
+
+    /* A page store reference must land after the gathered pages that precede
+     * it in the pages file */
+    flushPageGather();
+    stateWrite(pfd, data, data_size);
+    return data_size;
+}
+
 static size_t writeAllAreas(bool base)
 {
     int pmfd, pfd;
@@ -910,12 +1471,73 @@ static size_t writeAllAreas(bool base)
     NATIVECALL(spmfd = open("/proc/self/pagemap", O_RDONLY));
     MYASSERT(spmfd != -1);
 
-    int crfd;
+    int crfd = -1;
     if (shared_config.incremental_savestates) {
         NATIVECALL(crfd = open("/proc/self/clear_refs", O_WRONLY));
         MYASSERT(crfd != -1);
     }
 
+    /* Open the shared page store when dedup is enabled. This happens before
+     * the fork below, so that a background child appends pages through the
+     * same file description. */
+    dedup_states = shared_config.dedup_savestates && PageStore::begin();
+
+    /* When background savestates are enabled, we fork a child which performs
+     * the memory dump on its copy-on-write snapshot of the game memory,
+     * while the game can resume right away. All the savestate files were
+     * opened before forking, so the parent holds descriptors on the same
+     * file descriptions and can install them in the state slot immediately.
+     */
+    bool forked_child = false;
+    if (shared_config.background_savestates && !base) {
+        pid_t child;
+        NATIVECALL(child = fork());
+
+        if (child > 0) {
+            setChildPid(child);
+
+            if (shared_config.incremental_savestates) {
+                /* Clear the soft-dirty bits in the parent: the state content
+                 * is the memory snapshot at fork time, so modified pages must
+                 * be counted from now on */
+                Utils::writeAll(crfd, "4\n", 2);
+                NATIVECALL(close(crfd));
+            }
+            NATIVECALL(close(spmfd));
+
+            if (shared_config.savestates_in_ram) {
+                if (shared_config.incremental_savestates) {
+                    /* Install the state memfds in the slot now, the child
+                     * fills their content */
+                    if (getPagemapFd(current_ss_index)) {
+                        NATIVECALL(close(getPagemapFd(current_ss_index)));
+                        NATIVECALL(close(getPagesFd(current_ss_index)));
+                    }
+                    setPagemapFd(current_ss_index, pmfd);
+                    setPagesFd(current_ss_index, pfd);
+                }
+            }
+            else {
+                NATIVECALL(close(pmfd));
+                NATIVECALL(close(pfd));
+            }
+
+            if (dedup_states)
+                PageStore::end();
+
+            return 0;
+        }
+
+        MYASSERT(child == 0)
+        forked_child = true;
+    }
+
+    /* Start the write worker, so that file writes overlap with the pagemap
+     * scanning below. Only savestates written to disk benefit from it,
+     * writing to a memfd is a memory copy anyway. */
+    if (!shared_config.savestates_in_ram)
+        ParallelSave::init(pmfd, pfd);
+
     /* Saving the savestate header */
     StateHeader sh;
     int n=0;
@@ -926,9 +1548,33 @@ static size_t writeAllAreas(bool base)
         }
     }
     sh.thread_count = n;
-    Utils::writeAll(pmfd, &sh, sizeof(sh));
+
+#ifdef LIBTAS_ENABLE_ZSTD
+    if (shared_config.compressed_savestates) {
+        initCompressedWrite();
+        sh.compressed = 1;
+        sh.chunk_pages = StateCompression::CHUNK_PAGES;
+    }
+    else {
+        compress_states = false;
+    }
+#endif
+
+    /* The header is excluded from the checksums: it is rewritten at the end
+     * of the dump with the final values */
+    checksum_states = false;
+
+    stateWrite(pmfd, &sh, sizeof(sh));
     savestate_size += sizeof(sh);
 
+    if (shared_config.checksum_savestates) {
+        checksum_states = true;
+        checksum_pmfd = pmfd;
+        checksum_pfd = pfd;
+        hashInit(checksum_hash[0]);
+        hashInit(checksum_hash[1]);
+    }
+
     /* Load the parent savestate if any. */
     SaveState parent_state(parentpagemappath, parentpagespath, getPagemapFd(parent_ss_index), getPagesFd(parent_ss_index));
 
@@ -948,36 +1594,94 @@ static size_t writeAllAreas(bool base)
         }
     }
 
+    /* Largest file-backed areas written into this state, reported below as
+     * candidates for the exclusion patterns. Static so that no allocation
+     * happens while the threads are suspended. */
+    static const int CANDIDATE_AREAS = 5;
+    static struct {
+        size_t size;
+        char name[FILENAMESIZE];
+    } candidates[CANDIDATE_AREAS];
+    memset(candidates, 0, sizeof(candidates));
+
     /* Dump all memory areas */
     procSelfMaps.reset();
     while (procSelfMaps.getNextArea(&area)) {
         if (skipArea(&area)) {
             area.skip = true;
-            Utils::writeAll(pmfd, &area, sizeof(area));
+            /* The content of a skipped file mapping is not stored: record
+             * the identity of its backing file instead, so that loading can
+             * detect when the file changed under the mapping. */
+            if (area.name[0] == '/') {
+                struct stat filestat;
+                int ret;
+                NATIVECALL(ret = stat(area.name, &filestat));
+                if (ret == 0) {
+                    area.mtime = filestat.st_mtime;
+                    area.filesize = filestat.st_size;
+                }
+            }
+            stateWrite(pmfd, &area, sizeof(area));
             savestate_size += sizeof(area);
         }
         else {
-            savestate_size += writeAnArea(pmfd, pfd, spmfd, area, parent_state);
+            size_t written = writeAnArea(pmfd, pfd, spmfd, area, parent_state);
+            savestate_size += written;
+
+            /* Track the largest file-backed areas */
+            if (area.name[0] == '/') {
+                for (int c = 0; c < CANDIDATE_AREAS; c++) {
+                    if (written > candidates[c].size) {
+                        for (int m = CANDIDATE_AREAS - 1; m > c; m--)
+                            candidates[m] = candidates[m-1];
+                        candidates[c].size = written;
+                        strncpy(candidates[c].name, area.name, FILENAMESIZE-1);
+                        break;
+                    }
+                }
+            }
         }
     }
 
+    /* Report the largest file-backed areas, which the user can match with
+     * an exclusion pattern when the game never reads them back (driver
+     * arenas, shader caches). Only areas that matter are reported. */
+    for (int c = 0; c < CANDIDATE_AREAS; c++) {
+        if (candidates[c].size >= 16*1024*1024)
+            debuglogstdio(LCF_CHECKPOINT | LCF_INFO, "state: %zu MB written from %s, candidate for an exclusion pattern",
+                candidates[c].size / (1024*1024), candidates[c].name);
+    }
+
+    /* Write the last gathered pages */
+    flushPageGather();
+
+#ifdef LIBTAS_ENABLE_ZSTD
+    /* Flush the last partially filled chunk */
+    if (compress_states)
+        savestate_size += flushCompressedChunk(pfd);
+#endif
+
     /* Add the last null (eof) area */
     area.addr = nullptr; // End of data
     area.size = 0; // End of data
-    Utils::writeAll(pmfd, &area, sizeof(area));
+    stateWrite(pmfd, &area, sizeof(area));
     savestate_size += sizeof(area);
 
-    if (shared_config.incremental_savestates) {
-        /* Clear soft-dirty bits */
+    if (shared_config.incremental_savestates && !forked_child) {
+        /* Clear soft-dirty bits. When the dump runs in a forked child, the
+         * parent already cleared its own bits at fork time. */
         Utils::writeAll(crfd, "4\n", 2);
     }
 
-    /* Recover area protection and advise */
-    procSelfMaps.reset();
-    while (procSelfMaps.getNextArea(&area)) {
-        if (!skipArea(&area)) {
-            MYASSERT(mprotect(area.addr, area.size, area.prot) == 0)
-            MYASSERT(madvise(area.addr, area.size, MADV_NORMAL) == 0);
+    /* Recover area protection and advise. The child skips this, its address
+     * space is discarded on exit. */
+    if (!forked_child) {
+        procSelfMaps.reset();
+        while (procSelfMaps.getNextArea(&area)) {
+            if (!skipArea(&area)) {
+                MYASSERT(mprotect(area.addr, area.size, area.prot) == 0)
+                MYASSERT(madvise(area.addr, area.size, MADV_NORMAL) == 0);
+            }
         }
     }
 
@@ -987,22 +1691,41 @@ static size_t writeAllAreas(bool base)
 
     NATIVECALL(close(spmfd));
 
+    /* Wait for all queued writes to land on disk */
+    ParallelSave::finish();
+
+    /* All writes have landed, rewrite the header with the final checksums */
+    if (checksum_states) {
+        sh.checksummed = 1;
+        sh.pagemap_checksum = hashFinal(checksum_hash[0]);
+        sh.pages_checksum = hashFinal(checksum_hash[1]);
+        lseek(pmfd, 0, SEEK_SET);
+        Utils::writeAll(pmfd, &sh, sizeof(sh));
+        checksum_states = false;
+    }
+
     /* Closing the savestate files */
     if (!shared_config.savestates_in_ram) {
         NATIVECALL(close(pmfd));
         NATIVECALL(close(pfd));
     }
 
+    if (dedup_states)
+        PageStore::end();
+
     /* Rename the savestate files */
     if (shared_config.incremental_savestates && !base) {
         if (shared_config.savestates_in_ram) {
-            /* Closing the old savestate memfds and replace with the new one */
-            if (getPagemapFd(current_ss_index)) {
-                NATIVECALL(close(getPagemapFd(current_ss_index)));
-                NATIVECALL(close(getPagesFd(current_ss_index)));
+            /* Closing the old savestate memfds and replace with the new one.
+             * For a background savestate, the parent did it at fork time. */
+            if (!forked_child) {
+                if (getPagemapFd(current_ss_index)) {
+                    NATIVECALL(close(getPagemapFd(current_ss_index)));
+                    NATIVECALL(close(getPagesFd(current_ss_index)));
+                }
+                setPagemapFd(current_ss_index, pmfd);
+                setPagesFd(current_ss_index, pfd);
             }
-            setPagemapFd(current_ss_index, pmfd);
-            setPagesFd(current_ss_index, pfd);
         }
         else {
             NATIVECALL(rename(temppagemappath, pagemappath));
@@ -1010,6 +1733,11 @@ static size_t writeAllAreas(bool base)
         }
     }
 
+    if (forked_child) {
+        /* The background dump is complete */
+        _exit(0);
+    }
+
     return savestate_size;
 }
 
@@ -1019,12 +1747,27 @@ static size_t writeAnArea(int pmfd, int pfd, int spmfd, Area &area, SaveState &p
     area.print("Save");
     size_t area_size = 0;
 
-    /* Save the position of the first area page in the pages file */
-    area.page_offset = lseek(pfd, 0, SEEK_CUR);
-    MYASSERT(area.page_offset != -1)
+    /* Save the position of the first area page in the pages file. When
+     * compressing, this is a position in the uncompressed page stream. */
+#ifdef LIBTAS_ENABLE_ZSTD
+    if (compress_states) {
+        area.page_offset = comp_pos + comp_fill;
+    }
+    else
+#endif
+    if (ParallelSave::isActive()) {
+        /* The file offset lags behind the queued writes */
+        area.page_offset = ParallelSave::queuedSize(pfd);
+    }
+    else {
+        /* Pending gathered pages have not reached the file offset yet */
+        flushPageGather();
+        area.page_offset = lseek(pfd, 0, SEEK_CUR);
+        MYASSERT(area.page_offset != -1)
+    }
 
     /* Write the area struct */
-    Utils::writeAll(pmfd, &area, sizeof(area));
+    stateWrite(pmfd, &area, sizeof(area));
     area_size += sizeof(area);
 
     /* Seek at the beginning of the area pagemap */
@@ -1042,27 +1785,38 @@ static size_t writeAnArea(int pmfd, int pfd, int spmfd, Area &area, SaveState &p
     /* Current index in the pagemaps array */
     int pagemap_i = 512;
 
-    /* Chunk of savestate pagemap values */
-    char ss_pagemaps[4096];
-
-    /* Current index in the savestate pagemap array */
-    int ss_pagemap_i = 0;
+    /* Flag of the current page, appended to the run stream below */
+    char page_flag;
 
     char* endAddr = static_cast<char*>(area.endAddr);
     for (char* curAddr = static_cast<char*>(area.addr); curAddr < endAddr; curAddr += 4096, page_i++) {
 
-        /* We write a chunk of savestate pagemaps if it is full */
-        if (ss_pagemap_i >= 4096) {
-            Utils::writeAll(pmfd, ss_pagemaps, 4096);
-            ss_pagemap_i = 0;
-            area_size += 4096;
-        }
-
         /* We read pagemap flags in chunks to avoid too many read syscalls. */
         if (pagemap_i >= 512) {
             size_t remaining_pages = (nb_pages-page_i)>512?512:(nb_pages-page_i);
             Utils::readAll(spmfd, pagemaps, remaining_pages*8);
             pagemap_i = 0;
+
+            /* Bulk-skip a chunk with no present page at all. Thread stacks
+             * are mapped at their full default size (often 8 MB each) but
+             * mostly never touched, so on thread-pool-heavy games whole
+             * chunks of absent pages are the common case: emit one NO_PAGE
+             * run for the chunk instead of doing the per-page work. */
+            bool any_present = false;
+            for (size_t c = 0; c < remaining_pages; c++) {
+                if (pagemaps[c] & (0x1ull << 63)) {
+                    any_present = true;
+                    break;
+                }
+            }
+            if (!any_present && !LazyRestore::overlaps(curAddr, remaining_pages*4096)) {
+                for (size_t c = 0; c < remaining_pages; c++)
+                    area_size += pushPageFlag(pmfd, Area::NO_PAGE);
+                curAddr += (remaining_pages - 1) * 4096;
+                page_i += remaining_pages - 1;
+                pagemap_i = 512; /* force a chunk read on the next page */
+                continue;
+            }
         }
 
         /* Gather the flag for the current pagemap. */
@@ -1070,17 +1824,18 @@ static size_t writeAnArea(int pmfd, int pfd, int spmfd, Area &area, SaveState &p
         bool page_present = page & (0x1ull << 63);
         bool soft_dirty = page & (0x1ull << 55);
 
-        /* Check if page is present */
-        if (!page_present) {
-            ss_pagemaps[ss_pagemap_i++] = Area::NO_PAGE;
+        /* Check if page is present. A page of a lazily mapped range that was
+         * never faulted in is reported as absent, but its logical content is
+         * the backing savestate file, so fall through and read it. */
+        if (!page_present && !LazyRestore::contains(curAddr)) {
+            page_flag = Area::NO_PAGE;
         }
 
-        /* Check if page is zero (only check on anonymous memory)*/
-        else if ((area.flags & MAP_ANONYMOUS) && Utils::isZeroPage(static_cast<void*>(curAddr))) {
-            ss_pagemaps[ss_pagemap_i++] = Area::ZERO_PAGE;
-        }
-
-        /* Check if page was not modified since last savestate */
+        /* Check if page was not modified since last savestate. This check
+         * comes before the zero page check: an unmodified page has the same
+         * content as in the parent savestate, so we can inherit the parent
+         * flag without reading the page content at all. This way, clean
+         * pages cost a pagemap flag lookup instead of a 4096-byte scan. */
         else if (!soft_dirty && shared_config.incremental_savestates) {
             /* Copy the value of the parent savestate if any */
             if (parent_state) {
@@ -1089,34 +1844,38 @@ static size_t writeAnArea(int pmfd, int pfd, int spmfd, Area &area, SaveState &p
                 if (parent_flag == Area::NONE) {
                     /* This is not supposed to happen, saving the full page */
                     debuglogstdio(LCF_CHECKPOINT | LCF_ERROR, "Area with soft-dirty cleared but no parent page !?");
-                    ss_pagemaps[ss_pagemap_i++] = Area::FULL_PAGE;
-                    Utils::writeAll(pfd, static_cast<void*>(curAddr), 4096);
-                    area_size += 4096;
+                    area_size += writeAPage(pfd, curAddr, &page_flag);
                 }
-                else if (parent_flag == Area::FULL_PAGE) {
-                    /* Parent state stores the memory page, we must store it too */
-                    ss_pagemaps[ss_pagemap_i++] = Area::FULL_PAGE;
-                    Utils::writeAll(pfd, static_cast<void*>(curAddr), 4096);
-                    area_size += 4096;
+                else if ((parent_flag == Area::FULL_PAGE) || (parent_flag == Area::DEDUP_PAGE)) {
+                    /* Parent state stores the memory page, we must store it
+                     * too. A parent page in the page store cannot be
+                     * inherited by flag alone, but deduplication makes it a
+                     * cheap 8-byte reference. */
+                    area_size += writeAPage(pfd, curAddr, &page_flag);
                 }
                 else {
-                    ss_pagemaps[ss_pagemap_i++] = parent_flag;
+                    page_flag = parent_flag;
                 }
             }
             else {
-                ss_pagemaps[ss_pagemap_i++] = Area::BASE_PAGE;
+                page_flag = Area::BASE_PAGE;
             }
         }
+
+        /* Check if page is zero (only check on anonymous memory)*/
+        else if ((area.flags & MAP_ANONYMOUS) && Utils::isZeroPage(static_cast<void*>(curAddr))) {
+            page_flag = Area::ZERO_PAGE;
+        }
+
         else {
-            ss_pagemaps[ss_pagemap_i++] = Area::FULL_PAGE;
-            Utils::writeAll(pfd, static_cast<void*>(curAddr), 4096);
-            area_size += 4096;
+            area_size += writeAPage(pfd, curAddr, &page_flag);
         }
+
+        area_size += pushPageFlag(pmfd, page_flag);
     }
 
-    /* Writing the last savestate pagemap chunk */
-    Utils::writeAll(pmfd, ss_pagemaps, ss_pagemap_i);
-    area_size += ss_pagemap_i;
+    /* Terminate and flush the run stream of the area */
+    area_size += endFlagRuns(pmfd);
 
     return area_size;
 }
@@ -33,10 +33,29 @@ namespace Checkpoint
     void setSavestateIndex(int index);
     void setBaseSavestateIndex(int index);
 
+    /* Index of the current savestate slot */
+    int getSavestateIndex();
+
+    /* Set the user-configured list of mapping path patterns excluded from
+     * savestates, one fnmatch() glob per line */
+    void setIgnorePatterns(const std::string& patterns);
+
+    /* Advance the rewind ring buffer and select its new head slot as the
+     * current savestate slot */
+    void setRewindSaveIndex();
+
+    /* Select the most recent rewind ring slot as the current savestate slot
+     * and pop it from the ring. Returns false if the ring is empty. */
+    bool setRewindLoadIndex();
+
     void setCurrentToParent();
 
     bool checkCheckpoint();
     bool checkRestore();
+
+    /* Wait for the completion of a pending background savestate */
+    void waitChild();
+
     void handler(int signum);
 };
 }
@@ -0,0 +1,120 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "LazyRestore.h"
+#include "ReservedMemory.h"
+#include "../logging.h"
+#include "../global.h" // shared_config
+#include <sys/mman.h>
+
+namespace libtas {
+
+namespace LazyRestore {
+
+/* Only map runs at least this large, so that we don't fragment the address
+ * space with thousands of small mappings */
+static const size_t MIN_MAP_SIZE = 64 * 4096;
+
+struct Range {
+    char* addr;
+    size_t size;
+};
+
+static const int MAX_RANGES = (ReservedMemory::LAZY_SIZE - sizeof(Range)) / sizeof(Range);
+
+/* Registry of lazily mapped ranges, stored in reserved memory so that it
+ * survives state loadings. It is only reset when a new lazy loading replaces
+ * the mappings of the previous one. */
+struct Registry {
+    int count;
+    Range ranges[MAX_RANGES];
+};
+
+static bool active = false;
+
+static Registry* getRegistry()
+{
+    return static_cast<Registry*>(ReservedMemory::getAddr(ReservedMemory::LAZY_ADDR));
+}
+
+void init()
+{
+    /* Only the file-backed path qualifies: in-RAM non-incremental states
+     * reuse their memfd with an in-place rewrite, which would change the
+     * content under not-yet-faulted pages of a previous mapping. */
+    active = shared_config.mmap_loadstates && !shared_config.savestates_in_ram;
+
+    if (active) {
+        getRegistry()->count = 0;
+    }
+}
+
+bool mapRange(int fd, char* addr, off_t offset, size_t size)
+{
+    if (!active)
+        return false;
+
+    if (size < MIN_MAP_SIZE)
+        return false;
+
+    /* Page data is only page-aligned in the file when neither compression
+     * nor deduplication shifted the stream */
+    if (offset % 4096)
+        return false;
+
+    Registry* registry = getRegistry();
+    if (registry->count >= MAX_RANGES)
+        return false;
+
+    void* ret = mmap(addr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, offset);
+    if (ret == MAP_FAILED) {
+        debuglogstdio(LCF_CHECKPOINT | LCF_ERROR, "Could not map %d bytes of the pages file", size);
+        return false;
+    }
+
+    registry->ranges[registry->count].addr = addr;
+    registry->ranges[registry->count].size = size;
+    registry->count++;
+    return true;
+}
+
+bool contains(const char* addr)
+{
+    Registry* registry = getRegistry();
+    for (int i = 0; i < registry->count; i++) {
+        if ((addr >= registry->ranges[i].addr) &&
+            (addr < registry->ranges[i].addr + registry->ranges[i].size))
+            return true;
+    }
+    return false;
+}
+
+bool overlaps(const char* addr, size_t size)
+{
+    Registry* registry = getRegistry();
+    for (int i = 0; i < registry->count; i++) {
+        if ((addr < registry->ranges[i].addr + registry->ranges[i].size) &&
+            (registry->ranges[i].addr < addr + size))
+            return true;
+    }
+    return false;
+}
+
+}
+}
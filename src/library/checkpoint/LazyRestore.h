@@ -0,0 +1,64 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIBTAS_LAZYRESTORE_H
+#define LIBTAS_LAZYRESTORE_H
+
+#include <cstddef>
+#include <sys/types.h> // off_t
+
+namespace libtas {
+
+/* Restore large page runs of file-backed savestates by memory-mapping the
+ * pages file (MAP_PRIVATE) over the restored region instead of reading it.
+ * The restore cost becomes page-fault-driven and lazy: the game resumes
+ * before the whole state content is faulted in, and pages that are never
+ * touched again are never read at all.
+ *
+ * This is safe because savestate files are never modified in place: slots
+ * are replaced with unlink/creat or a rename, so a mapped inode keeps its
+ * content for as long as the mapping lives.
+ *
+ * Mapped ranges are recorded in a registry living in reserved memory, which
+ * the savestate writer consults: a page of a mapped range that was never
+ * faulted in is reported as absent by /proc/self/pagemap, but its logical
+ * content is the backing file, so the writer must read it instead of
+ * flagging it as a missing page.
+ */
+namespace LazyRestore {
+
+    /* Prepare for a state loading: activate if enabled and applicable, and
+     * reset the registry of mapped ranges */
+    void init();
+
+    /* Map a run of pages from the pages file over [addr, addr+size).
+     * Returns false if lazy restore is inactive, the run is too small, the
+     * file offset is not page-aligned or the registry is full, in which
+     * case the caller reads the run as usual. */
+    bool mapRange(int fd, char* addr, off_t offset, size_t size);
+
+    /* Is this address part of a lazily mapped range? */
+    bool contains(const char* addr);
+
+    /* Does [addr, addr+size) overlap any lazily mapped range? */
+    bool overlaps(const char* addr, size_t size);
+}
+}
+
+#endif
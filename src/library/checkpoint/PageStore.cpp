@@ -0,0 +1,239 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "PageStore.h"
+#include "ReservedMemory.h"
+#include "ParallelRestore.h"
+#include "../Utils.h"
+#include "../logging.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+#include <sys/syscall.h>
+
+namespace libtas {
+namespace PageStore {
+
+static char storepath[1024] = {'\0'};
+
+/* An index slot maps the hash of a page content to its location in the
+ * store. The offset is stored plus one so that a zeroed slot means empty,
+ * as the reserved memory segment starts zeroed. */
+struct IndexEntry {
+    uint64_t hash;
+    uint64_t offset_plus_one;
+};
+
+/* The index is an open-addressing hash table with linear probing, living in
+ * the reserved memory segment so that it survives state loading and no
+ * memory is allocated in the checkpoint signal handler. */
+static const size_t INDEX_CAPACITY = ReservedMemory::DEDUP_SIZE / sizeof(IndexEntry);
+static_assert((INDEX_CAPACITY & (INDEX_CAPACITY - 1)) == 0, "index capacity must be a power of two");
+
+/* Stop inserting when the table gets this full, so that probing always
+ * terminates on an empty slot */
+static const size_t INDEX_MAX_COUNT = INDEX_CAPACITY - INDEX_CAPACITY / 8;
+
+/* Scratch page for verifying that a matching hash is not a collision */
+static char verify_page[4096];
+
+/* The store file descriptor and the number of index entries are kept in
+ * reserved memory: for in-RAM savestates the memfd must survive state
+ * loading, and the entry count must stay in sync with the index. */
+static int* storeFd()
+{
+    return static_cast<int*>(ReservedMemory::getAddr(ReservedMemory::PAGESTORE_ADDR));
+}
+
+static int* entryCount()
+{
+    return static_cast<int*>(ReservedMemory::getAddr(ReservedMemory::PAGESTORE_ADDR)) + 1;
+}
+
+static IndexEntry* indexEntries()
+{
+    return static_cast<IndexEntry*>(ReservedMemory::getAddr(ReservedMemory::DEDUP_ADDR));
+}
+
+/* xxHash64 of a 4096-byte page with seed 0. The input length is a multiple
+ * of 32 bytes, so the tail handling of the full algorithm is not needed. */
+
+#define PRIME64_1 11400714785074694791ULL
+#define PRIME64_2 14029467366897019727ULL
+#define PRIME64_3  1609587929392839161ULL
+#define PRIME64_4  9650029242287828579ULL
+#define PRIME64_5  2870177450012600261ULL
+
+static inline uint64_t rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t round64(uint64_t acc, uint64_t input)
+{
+    acc += input * PRIME64_2;
+    acc = rotl64(acc, 31);
+    acc *= PRIME64_1;
+    return acc;
+}
+
+static inline uint64_t mergeRound64(uint64_t acc, uint64_t val)
+{
+    acc ^= round64(0, val);
+    return acc * PRIME64_1 + PRIME64_4;
+}
+
+static uint64_t hashPage(const char* addr)
+{
+    /* Pages are 8-byte aligned, so we can read the input as 64-bit words */
+    const uint64_t* p = reinterpret_cast<const uint64_t*>(addr);
+    const uint64_t* const end = p + 4096/8;
+
+    uint64_t v1 = PRIME64_1 + PRIME64_2;
+    uint64_t v2 = PRIME64_2;
+    uint64_t v3 = 0;
+    uint64_t v4 = 0 - PRIME64_1;
+
+    do {
+        v1 = round64(v1, *p++);
+        v2 = round64(v2, *p++);
+        v3 = round64(v3, *p++);
+        v4 = round64(v4, *p++);
+    } while (p < end);
+
+    uint64_t h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+    h = mergeRound64(h, v1);
+    h = mergeRound64(h, v2);
+    h = mergeRound64(h, v3);
+    h = mergeRound64(h, v4);
+
+    h += 4096;
+
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+void setPath(std::string path)
+{
+    strncpy(storepath, path.c_str(), 1023);
+}
+
+bool begin()
+{
+    int* fd = storeFd();
+
+    if (shared_config.savestates_in_ram) {
+        if (*fd == 0) {
+            *fd = syscall(SYS_memfd_create, "pagestore", 0);
+        }
+        return (*fd > 0);
+    }
+
+    if (storepath[0] == '\0')
+        return false;
+
+    NATIVECALL(*fd = open(storepath, O_RDWR | O_CREAT, 0644));
+    return (*fd > 0);
+}
+
+void beginRead()
+{
+    int* fd = storeFd();
+
+    if (shared_config.savestates_in_ram)
+        return;
+
+    if (storepath[0] == '\0')
+        return;
+
+    /* The store may not exist if no deduplicated savestate was ever saved,
+     * in which case no page load will reference it */
+    NATIVECALL(*fd = open(storepath, O_RDONLY));
+}
+
+void end()
+{
+    int* fd = storeFd();
+
+    if (!shared_config.savestates_in_ram && (*fd > 0)) {
+        NATIVECALL(close(*fd));
+        *fd = 0;
+    }
+}
+
+uint64_t writePage(char* addr)
+{
+    int fd = *storeFd();
+    IndexEntry* entries = indexEntries();
+
+    uint64_t hash = hashPage(addr);
+    size_t i = hash & (INDEX_CAPACITY - 1);
+
+    while (entries[i].offset_plus_one != 0) {
+        if (entries[i].hash == hash) {
+            /* The hash matches a stored page, but we must check the actual
+             * content before referencing it, because a hash collision would
+             * silently corrupt the savestate. The read usually hits the page
+             * cache, so this is much cheaper than storing the page. */
+            off_t offset = entries[i].offset_plus_one - 1;
+            ssize_t ret = pread(fd, verify_page, 4096, offset);
+            MYASSERT(ret == 4096)
+            if (0 == memcmp(verify_page, addr, 4096))
+                return offset;
+        }
+        i = (i + 1) & (INDEX_CAPACITY - 1);
+    }
+
+    if (static_cast<size_t>(*entryCount()) >= INDEX_MAX_COUNT) {
+        /* The index is full, the caller stores the page in its own file */
+        return UINT64_MAX;
+    }
+
+    /* New page content, append it to the store */
+    off_t offset = lseek(fd, 0, SEEK_END);
+    MYASSERT(offset != -1)
+    Utils::writeAll(fd, addr, 4096);
+
+    entries[i].hash = hash;
+    entries[i].offset_plus_one = offset + 1;
+    (*entryCount())++;
+
+    return offset;
+}
+
+void loadPage(uint64_t offset, char* addr)
+{
+    int fd = *storeFd();
+    MYASSERT(fd > 0)
+
+    if (ParallelRestore::isActive()) {
+        ParallelRestore::queueLoad(fd, addr, offset, 4096);
+        return;
+    }
+
+    ssize_t ret = pread(fd, addr, 4096, offset);
+    MYASSERT(ret == 4096)
+}
+
+}
+}
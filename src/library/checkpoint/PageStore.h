@@ -0,0 +1,67 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIBTAS_PAGESTORE_H
+#define LIBTAS_PAGESTORE_H
+
+#include <cstdint>
+#include <string>
+
+namespace libtas {
+
+/* Content-addressed store of memory pages shared by all savestate slots of a
+ * game. Pages are keyed by their xxHash64 value in a fixed-size index living
+ * in the reserved memory segment, and their content is appended once to a
+ * single append-only store file (or memfd for in-RAM savestates). Savestates
+ * then reference a page by its 8-byte offset in the store, so identical
+ * pages across slots and across the base state are only stored once.
+ *
+ * The store is append-only and never truncated, so offsets referenced by
+ * older savestates stay valid for the whole session, and on disk even across
+ * sessions. The index cannot be rebuilt from a previous session, in which
+ * case identical pages are appended again: the store degrades in size, never
+ * in correctness.
+ */
+namespace PageStore {
+
+    /* Set the path of the page store file, derived from the savestate path */
+    void setPath(std::string path);
+
+    /* Open the store for appending pages during a state saving. Returns
+     * false if no store is available. */
+    bool begin();
+
+    /* Open the store for reading pages during a state loading */
+    void beginRead();
+
+    /* Close the store file descriptor, except for in-RAM savestates where
+     * the memfd is kept for the whole session */
+    void end();
+
+    /* Store the content of the page at addr, deduplicating against the
+     * index. Returns the offset of the page in the store, or UINT64_MAX if
+     * the index is full and the page was not already stored. */
+    uint64_t writePage(char* addr);
+
+    /* Read back the page stored at the given offset into addr */
+    void loadPage(uint64_t offset, char* addr);
+}
+}
+
+#endif
@@ -0,0 +1,143 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ParallelRestore.h"
+#include "ReservedMemory.h"
+#include "../TaskPool.h"
+#include "../logging.h"
+#include <unistd.h>
+
+namespace libtas {
+
+namespace ParallelRestore {
+
+/* A single queued page load */
+struct LoadEntry {
+    int fd;
+    char* addr;
+    off_t offset;
+    size_t size;
+};
+
+/* Work queue, stored at the beginning of the LOADQUEUE reserved region */
+struct LoadQueue {
+    int count; /* number of queued entries */
+    int error; /* set by a worker when a read failed */
+    LoadEntry entries[];
+};
+
+/* Maximum number of cloned workers, bounded by the reserved stack space */
+static const int MAX_WORKERS = 8;
+
+/* Don't bother cloning workers when few loads are queued */
+static const int MIN_PARALLEL_ENTRIES = 64;
+
+static bool active = false;
+
+static LoadQueue* getQueue()
+{
+    return static_cast<LoadQueue*>(ReservedMemory::getAddr(ReservedMemory::LOADQUEUE_ADDR));
+}
+
+static int maxEntries()
+{
+    return (ReservedMemory::LOADQUEUE_SIZE - sizeof(LoadQueue)) / sizeof(LoadEntry);
+}
+
+bool isActive()
+{
+    return active;
+}
+
+void init()
+{
+    LoadQueue* queue = getQueue();
+    queue->count = 0;
+    queue->error = 0;
+    active = true;
+}
+
+void queueLoad(int fd, char* addr, off_t offset, size_t size)
+{
+    LoadQueue* queue = getQueue();
+
+    if (queue->count >= maxEntries())
+        flush();
+
+    LoadEntry& entry = queue->entries[queue->count++];
+    entry.fd = fd;
+    entry.addr = addr;
+    entry.offset = offset;
+    entry.size = size;
+}
+
+/* Perform a single queued load. Must stay async-signal-safe and TLS-free,
+ * because it also runs in cloned workers. */
+static void performLoad(const LoadEntry& entry, LoadQueue* queue)
+{
+    size_t done = 0;
+    while (done < entry.size) {
+        ssize_t ret = pread(entry.fd, entry.addr + done, entry.size - done, entry.offset + done);
+        if (ret <= 0) {
+            __atomic_store_n(&queue->error, 1, __ATOMIC_RELAXED);
+            return;
+        }
+        done += ret;
+    }
+}
+
+/* Task function run by the pool workers, so it must stay TLS-free */
+static void loadTask(void* arg, int i)
+{
+    LoadQueue* queue = static_cast<LoadQueue*>(arg);
+    performLoad(queue->entries[i], queue);
+}
+
+void flush()
+{
+    LoadQueue* queue = getQueue();
+
+    if (queue->count == 0)
+        return;
+
+    if (queue->count < MIN_PARALLEL_ENTRIES) {
+        /* Not worth cloning workers, load everything from here */
+        for (int i = 0; i < queue->count; i++)
+            performLoad(queue->entries[i], queue);
+    }
+    else {
+        /* Worker stacks are carved from the reserved memory segment,
+         * because we cannot allocate memory here */
+        char* stacks = static_cast<char*>(ReservedMemory::getAddr(ReservedMemory::WORKERSTACKS_ADDR));
+        TaskPool::runOnStacks(loadTask, queue, queue->count,
+                              stacks, ReservedMemory::WORKERSTACKS_SIZE, MAX_WORKERS);
+    }
+
+    MYASSERT(!queue->error)
+    queue->count = 0;
+}
+
+void finish()
+{
+    flush();
+    active = false;
+}
+
+}
+}
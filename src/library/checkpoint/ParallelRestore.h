@@ -0,0 +1,59 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIBTAS_PARALLELRESTORE_H
+#define LIBTAS_PARALLELRESTORE_H
+
+#include <sys/types.h> // off_t
+
+namespace libtas {
+
+/* During a state loading, page reads queued by SaveState::finishLoad are
+ * gathered here instead of being performed inline, and are executed by a
+ * small pool of workers cloned from the checkpoint handler. Because the
+ * target address ranges are disjoint, workers can pread() into memory
+ * concurrently, so a restore runs at memory/disk bandwidth instead of
+ * single-core copy speed.
+ *
+ * The work queue and the worker stacks live in the reserved memory segment,
+ * because we cannot allocate memory in the checkpoint signal handler.
+ * Workers are cloned sharing the address space and file table but nothing
+ * else; they must not use any TLS (no errno, no NATIVECALL, no logging).
+ */
+namespace ParallelRestore {
+
+    /* Is the queue collecting page loads? */
+    bool isActive();
+
+    /* Start collecting page loads */
+    void init();
+
+    /* Queue the loading of size bytes at offset in fd into addr.
+     * May process the queue if it is full. */
+    void queueLoad(int fd, char* addr, off_t offset, size_t size);
+
+    /* Process the pending page loads, possibly across workers */
+    void flush();
+
+    /* Process the pending page loads and stop collecting */
+    void finish();
+}
+}
+
+#endif
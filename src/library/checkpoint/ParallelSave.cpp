@@ -0,0 +1,221 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ParallelSave.h"
+#include "ReservedMemory.h"
+#include "../logging.h"
+#include <unistd.h>
+#include <sched.h>
+#include <cstring>
+#include <sys/wait.h>
+
+namespace libtas {
+
+namespace ParallelSave {
+
+/* Each record in the ring buffer is a header followed by the data bytes */
+struct RecordHeader {
+    uint32_t fd_index;
+    uint32_t size;
+};
+
+/* Ring buffer state, stored at the beginning of the WRITEQUEUE reserved
+ * region and followed by the data bytes. This is a single-producer
+ * single-consumer ring: head is only advanced by the checkpoint thread and
+ * tail by the write worker. Both are monotonic byte counts. */
+struct WriteQueue {
+    uint64_t head; /* bytes queued */
+    uint64_t tail; /* bytes written to disk */
+    int done; /* set when no more writes will be queued */
+    int error; /* set by the worker when a write failed */
+    int fds[2];
+    uint64_t fd_sizes[2]; /* bytes queued per file */
+};
+
+static const size_t BUF_SIZE = ReservedMemory::WRITEQUEUE_SIZE - sizeof(WriteQueue);
+
+static bool active = false;
+static pid_t worker_pid;
+
+static WriteQueue* getQueue()
+{
+    return static_cast<WriteQueue*>(ReservedMemory::getAddr(ReservedMemory::WRITEQUEUE_ADDR));
+}
+
+static char* getBuffer()
+{
+    return static_cast<char*>(ReservedMemory::getAddr(ReservedMemory::WRITEQUEUE_ADDR)) + sizeof(WriteQueue);
+}
+
+/* Copy bytes into the ring buffer at the given position, wrapping around */
+static void ringPut(uint64_t pos, const void* data, size_t size)
+{
+    char* buf = getBuffer();
+    const char* src = static_cast<const char*>(data);
+    while (size > 0) {
+        size_t off = pos % BUF_SIZE;
+        size_t seg = BUF_SIZE - off;
+        if (seg > size)
+            seg = size;
+        memcpy(buf + off, src, seg);
+        pos += seg;
+        src += seg;
+        size -= seg;
+    }
+}
+
+/* Copy bytes out of the ring buffer at the given position, wrapping around */
+static void ringGet(uint64_t pos, void* data, size_t size)
+{
+    char* buf = getBuffer();
+    char* dst = static_cast<char*>(data);
+    while (size > 0) {
+        size_t off = pos % BUF_SIZE;
+        size_t seg = BUF_SIZE - off;
+        if (seg > size)
+            seg = size;
+        memcpy(dst, buf + off, seg);
+        pos += seg;
+        dst += seg;
+        size -= seg;
+    }
+}
+
+/* Drain the ring buffer into the savestate files. Must stay TLS-free,
+ * because it runs in a cloned worker. */
+static int writeWorker(void* arg)
+{
+    WriteQueue* queue = static_cast<WriteQueue*>(arg);
+    char* buf = getBuffer();
+
+    while (true) {
+        uint64_t head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+        if (queue->tail == head) {
+            if (__atomic_load_n(&queue->done, __ATOMIC_ACQUIRE))
+                break;
+            sched_yield();
+            continue;
+        }
+
+        RecordHeader rh;
+        ringGet(queue->tail, &rh, sizeof(rh));
+
+        /* Write the record data straight from the ring buffer, in two
+         * segments when it wraps around. After a write error we keep
+         * consuming records so that the producer never blocks on a full
+         * ring, and the error is reported in finish(). */
+        uint64_t pos = queue->tail + sizeof(rh);
+        size_t remaining = rh.size;
+        while ((remaining > 0) && !queue->error) {
+            size_t off = pos % BUF_SIZE;
+            size_t seg = BUF_SIZE - off;
+            if (seg > remaining)
+                seg = remaining;
+            ssize_t ret = write(queue->fds[rh.fd_index], buf + off, seg);
+            if (ret <= 0) {
+                __atomic_store_n(&queue->error, 1, __ATOMIC_RELAXED);
+                break;
+            }
+            pos += ret;
+            remaining -= ret;
+        }
+
+        __atomic_store_n(&queue->tail, queue->tail + sizeof(rh) + rh.size, __ATOMIC_RELEASE);
+    }
+    return 0;
+}
+
+bool isActive()
+{
+    return active;
+}
+
+void init(int pagemapfd, int pagesfd)
+{
+    WriteQueue* queue = getQueue();
+    queue->head = 0;
+    queue->tail = 0;
+    queue->done = 0;
+    queue->error = 0;
+    queue->fds[0] = pagemapfd;
+    queue->fds[1] = pagesfd;
+    queue->fd_sizes[0] = 0;
+    queue->fd_sizes[1] = 0;
+
+    /* The worker runs on the last restore worker stack slot, which is free
+     * during a state saving */
+    char* stacks = static_cast<char*>(ReservedMemory::getAddr(ReservedMemory::WORKERSTACKS_ADDR));
+    char* stack_top = stacks + ReservedMemory::WORKERSTACKS_SIZE;
+
+    worker_pid = clone(writeWorker, stack_top, CLONE_VM | CLONE_FS | CLONE_FILES, queue);
+    if (worker_pid == -1) {
+        debuglogstdio(LCF_CHECKPOINT | LCF_ERROR, "Could not clone the write worker");
+        return;
+    }
+
+    active = true;
+}
+
+void queueWrite(int fd, const void* data, size_t size)
+{
+    WriteQueue* queue = getQueue();
+
+    int fd_index = (fd == queue->fds[0]) ? 0 : 1;
+    queue->fd_sizes[fd_index] += size;
+
+    /* Wait for the worker to free enough room in the ring */
+    size_t needed = sizeof(RecordHeader) + size;
+    MYASSERT(needed <= BUF_SIZE)
+    while (BUF_SIZE - (queue->head - __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE)) < needed)
+        sched_yield();
+
+    RecordHeader rh;
+    rh.fd_index = fd_index;
+    rh.size = size;
+    ringPut(queue->head, &rh, sizeof(rh));
+    ringPut(queue->head + sizeof(rh), data, size);
+
+    /* The data must be visible to the worker before the head advance */
+    __atomic_store_n(&queue->head, queue->head + needed, __ATOMIC_RELEASE);
+}
+
+uint64_t queuedSize(int fd)
+{
+    WriteQueue* queue = getQueue();
+    return queue->fd_sizes[(fd == queue->fds[0]) ? 0 : 1];
+}
+
+void finish()
+{
+    if (!active)
+        return;
+
+    WriteQueue* queue = getQueue();
+    __atomic_store_n(&queue->done, 1, __ATOMIC_RELEASE);
+
+    pid_t ret;
+    NATIVECALL(ret = waitpid(worker_pid, nullptr, __WALL));
+    MYASSERT(ret == worker_pid)
+    MYASSERT(!queue->error)
+
+    active = false;
+}
+
+}
+}
@@ -0,0 +1,62 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIBTAS_PARALLELSAVE_H
+#define LIBTAS_PARALLELSAVE_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace libtas {
+
+/* During a state saving to disk, writes to the savestate files are queued
+ * into a ring buffer and performed by a single worker cloned from the
+ * checkpoint handler. The main thread can go on scanning the pagemap and
+ * comparing pages while the worker keeps the disk busy, overlapping the two
+ * phases that would otherwise run back to back.
+ *
+ * The ring buffer lives in the reserved memory segment and the worker runs
+ * on one of the restore worker stacks, because we cannot allocate memory in
+ * the checkpoint signal handler. Like the restore workers, the write worker
+ * is cloned sharing the address space and file table but nothing else, so it
+ * must not use any TLS (no errno, no NATIVECALL, no logging).
+ */
+namespace ParallelSave {
+
+    /* Is a write worker currently draining the queue? */
+    bool isActive();
+
+    /* Start the write worker for the savestate files */
+    void init(int pagemapfd, int pagesfd);
+
+    /* Queue a write to one of the savestate files. The data is copied into
+     * the ring buffer, waiting for the worker to free room if needed. Writes
+     * are performed in queueing order. */
+    void queueWrite(int fd, const void* data, size_t size);
+
+    /* Number of bytes queued so far for the given file, which is the file
+     * offset where the next queued write will land */
+    uint64_t queuedSize(int fd);
+
+    /* Wait for the queue to drain and join the worker */
+    void finish();
+}
+}
+
+#endif
@@ -52,6 +52,8 @@ struct Area {
         ZERO_PAGE, /* Entire page is zero */
         FULL_PAGE, /* Area contains a copy of the page */
         BASE_PAGE, /* Page was not modified from base savestate */
+        DEDUP_PAGE, /* Page content lives in the shared page store, the pages
+                     * file holds its 8-byte offset in the store */
     };
 
     void* addr;
@@ -65,6 +67,11 @@ struct Area {
     ino_t inodenum;
     bool skip;
     off_t page_offset; // position of the first area page in the pages file (in bytes)
+    /* Identity of the backing file of a skipped file mapping, captured at
+     * save time. Skipped mappings are not stored in the state, so loading
+     * uses it to detect when the file changed under the mapping. */
+    time_t mtime;
+    off_t filesize;
     char name[FILENAMESIZE];
 
     void print(const char* prefix) const;
@@ -20,6 +20,7 @@
 */
 
 #include "ProcSelfMaps.h"
+#include "ReservedMemory.h"
 #include "../logging.h"
 #include <fcntl.h>
 #include <unistd.h>
@@ -29,10 +30,87 @@
 
 namespace libtas {
 
+/* Compact parsed form of one maps line (or one run of merged [heap] lines).
+ * The area name is not stored: it is copied out of the raw text on demand,
+ * located by its position inside the line. */
+struct AreaRecord {
+    void* addr;
+    void* endAddr;
+    off_t offset;
+    unsigned long devmajor;
+    unsigned long devminor;
+    ino_t inodenum;
+    uint64_t generation; /* snapshot generation when the line was last parsed */
+    int prot;
+    int flags;
+    uint32_t line_off; /* position of the line in the snapshot text */
+    uint32_t line_len;
+    uint16_t name_rel; /* position of the name inside the line, 0 if none */
+    uint16_t name_len;
+};
+
+/* The cache lives in reserved memory so that it survives state loadings and
+ * needs no allocation from the checkpoint signal handler. Records are kept in
+ * two arrays used alternately: while a snapshot fills one array, it still
+ * reads the unchanged records of the previous snapshot from the other one. */
+struct MapsCacheHeader {
+    uint64_t generation;
+    int valid; /* whether the previous snapshot text and records are usable */
+    int parity; /* which record array holds the previous snapshot */
+    int counts[2];
+    uint32_t prev_text_len;
+};
+
+static const int MAX_RECORDS = 8192;
+static const size_t RECORDS_OFF = 4096;
+static const size_t PREV_TEXT_OFF = RECORDS_OFF + 2*MAX_RECORDS*sizeof(AreaRecord);
+static const size_t PREV_TEXT_SIZE = ReservedMemory::MAPSCACHE_SIZE - PREV_TEXT_OFF;
+
+static_assert(PREV_TEXT_OFF + ReservedMemory::PSM_SIZE <= ReservedMemory::MAPSCACHE_SIZE,
+    "maps cache region cannot hold the records and a full maps text");
+
+static MapsCacheHeader* cacheHeader()
+{
+    return static_cast<MapsCacheHeader*>(ReservedMemory::getAddr(ReservedMemory::MAPSCACHE_ADDR));
+}
+
+static AreaRecord* cacheRecords(int parity)
+{
+    char* base = static_cast<char*>(ReservedMemory::getAddr(ReservedMemory::MAPSCACHE_ADDR));
+    return reinterpret_cast<AreaRecord*>(base + RECORDS_OFF + parity*MAX_RECORDS*sizeof(AreaRecord));
+}
+
+static char* cachePrevText()
+{
+    return static_cast<char*>(ReservedMemory::getAddr(ReservedMemory::MAPSCACHE_ADDR)) + PREV_TEXT_OFF;
+}
+
+/* Parse the hex address starting a maps line, without consuming input */
+static uintptr_t lineAddr(const char* line)
+{
+    uintptr_t v = 0;
+    while (1) {
+        char c = *line++;
+        if ((c >= '0') && (c <= '9')) {
+            c -= '0';
+        } else if ((c >= 'a') && (c <= 'f')) {
+            c -= 'a' - 10;
+        } else {
+            break;
+        }
+        v = v * 16 + c;
+    }
+    return v;
+}
+
 ProcSelfMaps::ProcSelfMaps(void* restoreAddr, size_t restoreLength)
     : dataIdx(0),
     numAreas(0),
-    numBytes(0)
+    numBytes(0),
+    areaIdx(0),
+    numRecords(0),
+    usingIndex(false),
+    nameStartIdx(0)
 {
     int fd;
     NATIVECALL(fd = open("/proc/self/maps", O_RDONLY));
@@ -51,11 +129,101 @@ ProcSelfMaps::ProcSelfMaps(void* restoreAddr, size_t restoreLength)
             numAreas++;
         }
     }
+
+    buildIndex();
+}
+
+void ProcSelfMaps::buildIndex()
+{
+    MapsCacheHeader* header = cacheHeader();
+    char* prevText = cachePrevText();
+
+    AreaRecord* oldRecords = cacheRecords(header->parity);
+    int oldCount = header->valid ? header->counts[header->parity] : 0;
+
+    int newParity = 1 - header->parity;
+    AreaRecord* newRecords = cacheRecords(newParity);
+
+    int oldIdx = 0;
+    int reused = 0;
+    int count = 0;
+    size_t pos = 0;
+    Area area;
+
+    while (pos < numBytes && data[pos]) {
+        if (count == MAX_RECORDS) {
+            /* More areas than the index can hold, fall back to streaming
+             * parsing for this snapshot */
+            header->valid = 0;
+            reset();
+            return;
+        }
+
+        uintptr_t addr = lineAddr(data + pos);
+
+        /* The maps file is address-ordered, so skip cached records of areas
+         * that disappeared */
+        while ((oldIdx < oldCount) &&
+               (reinterpret_cast<uintptr_t>(oldRecords[oldIdx].addr) < addr))
+            oldIdx++;
+
+        if ((oldIdx < oldCount) &&
+            (reinterpret_cast<uintptr_t>(oldRecords[oldIdx].addr) == addr) &&
+            (pos + oldRecords[oldIdx].line_len <= numBytes) &&
+            (0 == memcmp(prevText + oldRecords[oldIdx].line_off, data + pos, oldRecords[oldIdx].line_len))) {
+            /* Byte-identical line(s), reuse the parsed record */
+            newRecords[count] = oldRecords[oldIdx];
+            newRecords[count].line_off = pos;
+            pos += newRecords[count].line_len;
+            oldIdx++;
+            reused++;
+        }
+        else {
+            dataIdx = pos;
+            MYASSERT(parseNextArea(&area))
+            AreaRecord* rec = &newRecords[count];
+            rec->addr = area.addr;
+            rec->endAddr = area.endAddr;
+            rec->offset = area.offset;
+            rec->devmajor = area.devmajor;
+            rec->devminor = area.devminor;
+            rec->inodenum = area.inodenum;
+            rec->generation = header->generation;
+            rec->prot = area.prot;
+            rec->flags = area.flags;
+            rec->line_off = pos;
+            rec->line_len = dataIdx - pos;
+            rec->name_rel = nameStartIdx ? (nameStartIdx - pos) : 0;
+            rec->name_len = strlen(area.name);
+            pos = dataIdx;
+        }
+        count++;
+    }
+
+    debuglogstdio(LCF_CHECKPOINT, "Maps parsing reused %d of %d cached areas", reused, count);
+
+    /* Keep the raw text for the next snapshot to compare against */
+    if (numBytes <= PREV_TEXT_SIZE) {
+        memcpy(prevText, data, numBytes);
+        header->prev_text_len = numBytes;
+        header->valid = 1;
+    }
+    else {
+        header->valid = 0;
+    }
+    header->parity = newParity;
+    header->counts[newParity] = count;
+    header->generation++;
+
+    numRecords = count;
+    usingIndex = true;
+    reset();
 }
 
 void ProcSelfMaps::reset()
 {
     dataIdx = 0;
+    areaIdx = 0;
 }
 
 uintptr_t ProcSelfMaps::readDec()
@@ -97,6 +265,38 @@ uintptr_t ProcSelfMaps::readHex()
 }
 
 bool ProcSelfMaps::getNextArea(Area *area)
+{
+    if (!usingIndex) {
+        return parseNextArea(area);
+    }
+
+    if (areaIdx >= numRecords) {
+        area->addr = nullptr;
+        area->size = 0;
+        return false;
+    }
+
+    const AreaRecord* rec = &cacheRecords(cacheHeader()->parity)[areaIdx++];
+    area->addr = rec->addr;
+    area->endAddr = rec->endAddr;
+    area->size = static_cast<char*>(rec->endAddr) - static_cast<char*>(rec->addr);
+    area->offset = rec->offset;
+    area->prot = rec->prot;
+    area->flags = rec->flags;
+    area->devmajor = rec->devmajor;
+    area->devminor = rec->devminor;
+    area->inodenum = rec->inodenum;
+    area->skip = false;
+    area->mtime = 0;
+    area->filesize = 0;
+    if (rec->name_rel) {
+        memcpy(area->name, data + rec->line_off + rec->name_rel, rec->name_len);
+    }
+    area->name[rec->name_len] = '\0';
+    return true;
+}
+
+bool ProcSelfMaps::parseNextArea(Area *area)
 {
     if (dataIdx >= numBytes || data[dataIdx] == 0) {
         area->addr = nullptr;
@@ -149,8 +349,10 @@ bool ProcSelfMaps::getNextArea(Area *area)
     }
 
     area->name[0] = '\0';
+    nameStartIdx = 0;
     if (data[dataIdx] == '/' || data[dataIdx] == '[' || data[dataIdx] == '(') {
         // absolute pathname, or [stack], [vdso], etc.
+        nameStartIdx = dataIdx;
         size_t i = 0;
         while (data[dataIdx] != '\n') {
             area->name[i++] = data[dataIdx++];
@@ -184,6 +386,8 @@ bool ProcSelfMaps::getNextArea(Area *area)
     }
 
     area->skip = false;
+    area->mtime = 0;
+    area->filesize = 0;
 
     /* Sometimes the [heap] is split into several contiguous segments, such as
      * after a dumping was made (but why...?). This can screw up our code for
@@ -193,7 +397,8 @@ bool ProcSelfMaps::getNextArea(Area *area)
     if (strcmp(area->name, "[heap]") == 0) {
         Area next_area;
         size_t curDataIdx = dataIdx;
-        bool valid = getNextArea(&next_area); // recursive call
+        size_t curNameStartIdx = nameStartIdx;
+        bool valid = parseNextArea(&next_area); // recursive call
         if (valid && (strcmp(next_area.name, "[heap]") == 0)) {
             MYASSERT(area->endAddr == next_area.addr)
             MYASSERT(area->flags == next_area.flags)
@@ -203,6 +408,7 @@ bool ProcSelfMaps::getNextArea(Area *area)
         }
         else {
             dataIdx = curDataIdx;
+            nameStartIdx = curNameStartIdx;
         }
     }
 
@@ -37,10 +37,29 @@ class ProcSelfMaps
         uintptr_t readDec();
         uintptr_t readHex();
 
+        /* Parse the next area from the raw maps text, merging split [heap]
+         * segments. Used to build the area index, and as a fallback when
+         * the index overflowed. */
+        bool parseNextArea(Area *area);
+
+        /* Build the address-ordered index of parsed areas, reusing cached
+         * records for maps lines that did not change since last snapshot */
+        void buildIndex();
+
         char *data;
         size_t dataIdx;
         size_t numAreas;
         size_t numBytes;
+
+        /* Iteration position in the area index, and whether the index could
+         * be built for this snapshot */
+        int areaIdx;
+        int numRecords;
+        bool usingIndex;
+
+        /* Text position of the area name being parsed, filled by
+         * parseNextArea() for the index records */
+        size_t nameStartIdx;
 };
 }
 
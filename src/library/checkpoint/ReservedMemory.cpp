@@ -23,12 +23,36 @@
 #include "../logging.h"
 #include <string.h>
 #include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/* From linux/mempolicy.h, so that we don't pull the libnuma headers */
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED 1
+#endif
 
 namespace libtas {
 
 static intptr_t restoreAddr = 0;
 static size_t restoreLength = 0;
 
+static const size_t HUGE_PAGE_SIZE = 2 * ONE_MB;
+
+/* Prefer allocating the region pages from the NUMA node running the main
+ * thread, so that the checkpoint copy loops don't cross sockets. Both
+ * syscalls are best effort: init() runs on the main thread before any
+ * checkpointing. */
+static void bindToCurrentNode(void* addr, size_t length)
+{
+    unsigned int cpu, node;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) == -1)
+        return;
+
+    unsigned long nodemask = 1ul << node;
+    if (syscall(SYS_mbind, addr, length, MPOL_PREFERRED, &nodemask, 8*sizeof(nodemask), 0) == -1)
+        debuglogstdio(LCF_CHECKPOINT | LCF_WARNING, "Could not bind reserved memory to node %d", node);
+}
+
 void ReservedMemory::init()
 {
     /* Create a special place to hold restore memory.
@@ -36,12 +60,34 @@ void ReservedMemory::init()
      * the ProcSelfMaps object that need some space.
      */
     if (restoreAddr == 0) {
+
+        /* Try to back the region with 2MB huge pages first: the page copy
+         * loops of writeAnArea()/readAnArea() stream through it constantly
+         * and are TLB-bound on large states. This requires preallocated
+         * huge pages (vm.nr_hugepages), so it usually fails. */
+        size_t hugeLength = (RESTORE_TOTAL_SIZE + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+        void* addr = mmap(nullptr, hugeLength, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (addr != MAP_FAILED) {
+            debuglogstdio(LCF_CHECKPOINT, "Reserved memory is backed by huge pages");
+            restoreAddr = reinterpret_cast<intptr_t>(addr);
+            restoreLength = hugeLength;
+            bindToCurrentNode(addr, hugeLength);
+            memset(reinterpret_cast<void*>(restoreAddr), 0, restoreLength);
+            return;
+        }
+
         restoreLength = RESTORE_TOTAL_SIZE;
-        void* addr = mmap(nullptr, restoreLength + (2 * 4096), PROT_NONE,
+        addr = mmap(nullptr, restoreLength + (2 * 4096), PROT_NONE,
             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
         MYASSERT(addr != MAP_FAILED)
         restoreAddr = reinterpret_cast<intptr_t>(addr) + 4096;
         MYASSERT(mprotect(reinterpret_cast<void*>(restoreAddr), restoreLength, PROT_READ | PROT_WRITE) == 0)
+
+        /* Let transparent huge pages back as much of the region as possible */
+        madvise(reinterpret_cast<void*>(restoreAddr), restoreLength, MADV_HUGEPAGE);
+        bindToCurrentNode(reinterpret_cast<void*>(restoreAddr), restoreLength);
+
         memset(reinterpret_cast<void*>(restoreAddr), 0, restoreLength);
         // debuglogstdio(LCF_ERROR, "Setup reserved space from %p to %p", reinterpret_cast<void*>(restoreAddr+ONE_MB), reinterpret_cast<void*>(restoreAddr+restoreLength));
     }
@@ -26,21 +26,65 @@
 #include <cstddef> // size_t
 
 #define ONE_MB 1024 * 1024
-#define RESTORE_TOTAL_SIZE 5 * ONE_MB
+#define RESTORE_TOTAL_SIZE 29 * ONE_MB
+
+/* Number of regular savestate slots: base state (0), numbered states (1-9)
+ * and backtrack state (10) */
+#define SAVESTATE_SLOTS 11
+
+/* Number of extra in-RAM savestate slots used by the rewind ring buffer */
+#define REWIND_SLOTS 32
+
+/* Number of extra in-RAM savestate slots used by the greenzone lattice of
+ * the input editor. The program addresses them as regular savestate indices
+ * starting at SAVESTATE_SLOTS+REWIND_SLOTS, so this value must match
+ * Greenzone::NB_SLOTS on the program side */
+#define GREENZONE_SLOTS 32
+
+/* Number of extra slots so that the out-of-range auxiliary state indices
+ * used by the program (the pristine zygote state at index 98 and the
+ * brute-force window state at index 99) fit inside the in-RAM fd tables */
+#define AUX_SLOTS (100-SAVESTATE_SLOTS-REWIND_SLOTS-GREENZONE_SLOTS)
+
+#define TOTAL_SLOTS (SAVESTATE_SLOTS+REWIND_SLOTS+GREENZONE_SLOTS+AUX_SLOTS)
 
 namespace libtas {
 namespace ReservedMemory {
     enum Addresses {
         PAGEMAPS_ADDR = 0,
-        PAGES_ADDR = 11*sizeof(int),
-        PSM_ADDR = 22*sizeof(int),
-        STACK_ADDR = ONE_MB,
+        PAGES_ADDR = TOTAL_SLOTS*sizeof(int),
+        CHILDPID_ADDR = 2*TOTAL_SLOTS*sizeof(int),
+        REWIND_ADDR = CHILDPID_ADDR + sizeof(int),
+        PAGESTORE_ADDR = REWIND_ADDR + 2*sizeof(int),
+        LAZY_ADDR = PAGESTORE_ADDR + 2*sizeof(int),
+        TIER_ADDR = LAZY_ADDR + 16*1024,
+        PSM_ADDR = TIER_ADDR + 1024,
+        COMPRESS_ADDR = ONE_MB,
+        LOADQUEUE_ADDR = 7*ONE_MB,
+        WORKERSTACKS_ADDR = 9*ONE_MB,
+        STACK_ADDR = 10*ONE_MB,
+        DEDUP_ADDR = 14*ONE_MB,
+        WRITEQUEUE_ADDR = 22*ONE_MB,
+        MAPSCACHE_ADDR = 24*ONE_MB,
+        STALL_ADDR = 27*ONE_MB,
     };
     enum Sizes {
         PAGEMAPS_SIZE = PAGES_ADDR - PAGEMAPS_ADDR,
-        PAGES_SIZE = PSM_ADDR - PAGES_ADDR,
-        PSM_SIZE = STACK_ADDR - PSM_ADDR,
-        STACK_SIZE = RESTORE_TOTAL_SIZE - STACK_ADDR,
+        PAGES_SIZE = CHILDPID_ADDR - PAGES_ADDR,
+        CHILDPID_SIZE = REWIND_ADDR - CHILDPID_ADDR,
+        REWIND_SIZE = PAGESTORE_ADDR - REWIND_ADDR,
+        PAGESTORE_SIZE = LAZY_ADDR - PAGESTORE_ADDR,
+        LAZY_SIZE = TIER_ADDR - LAZY_ADDR,
+        TIER_SIZE = PSM_ADDR - TIER_ADDR,
+        PSM_SIZE = COMPRESS_ADDR - PSM_ADDR,
+        COMPRESS_SIZE = LOADQUEUE_ADDR - COMPRESS_ADDR,
+        LOADQUEUE_SIZE = WORKERSTACKS_ADDR - LOADQUEUE_ADDR,
+        WORKERSTACKS_SIZE = STACK_ADDR - WORKERSTACKS_ADDR,
+        STACK_SIZE = DEDUP_ADDR - STACK_ADDR,
+        DEDUP_SIZE = WRITEQUEUE_ADDR - DEDUP_ADDR,
+        WRITEQUEUE_SIZE = MAPSCACHE_ADDR - WRITEQUEUE_ADDR,
+        MAPSCACHE_SIZE = STALL_ADDR - MAPSCACHE_ADDR,
+        STALL_SIZE = RESTORE_TOTAL_SIZE - STALL_ADDR,
     };
 
     void init();
@@ -22,15 +22,28 @@
 #include "SaveState.h"
 #include "../Utils.h"
 #include "StateHeader.h"
+#include "StateCompression.h"
+#include "ReservedMemory.h"
+#include "ParallelRestore.h"
+#include "PageStore.h"
+#include "LazyRestore.h"
 #include "../logging.h"
 #include <fcntl.h>
 #include <unistd.h>
+#include <cstring>
+
+#ifdef LIBTAS_ENABLE_ZSTD
+#define ZSTD_STATIC_LINKING_ONLY
+#include <zstd.h>
+#endif
 
 namespace libtas {
 
-SaveState::SaveState(char* pagemappath, char* pagespath, int pagemapfd, int pagesfd)
+SaveState::SaveState(char* pagemappath, char* pagespath, int pagemapfd, int pagesfd, int slot)
 {
     queued_size = 0;
+    compressed = false;
+    reader_slot = slot;
 
     if (shared_config.savestates_in_ram) {
         pmfd = pagemapfd;
@@ -56,7 +69,24 @@ SaveState::SaveState(char* pagemappath, char* pagespath, int pagemapfd, int page
         MYASSERT(pfd != -1)
     }
 
-    restart();
+    /* Check in the header if the pages file is compressed */
+    StateHeader sh;
+    readHeader(sh);
+
+    if (sh.compressed) {
+#ifdef LIBTAS_ENABLE_ZSTD
+        compressed = true;
+        MYASSERT(sh.chunk_pages <= StateCompression::CHUNK_PAGES)
+        chunk_buf = nullptr;
+        dctx = nullptr;
+        chunk_start = 0;
+        chunk_raw_size = 0;
+        chunk_file_offset = 0;
+#else
+        debuglogstdio(LCF_CHECKPOINT | LCF_ERROR, "Savestate is compressed but zstd support is not compiled in");
+        MYASSERT(!sh.compressed)
+#endif
+    }
 }
 
 SaveState::~SaveState()
@@ -79,42 +109,63 @@ void SaveState::restart()
 {
     /* Seek after the savestate header */
     lseek(pmfd, sizeof(StateHeader), SEEK_SET);
-    flags_remaining = 0;
+    runs_done = true;
 
     /* Read the first area */
     nextArea();
 }
 
-char SaveState::nextFlag()
+void SaveState::nextRun()
 {
-    if (flag_i == 4096) {
-    	MYASSERT(flags_remaining > 0);
-
-    	int size = (flags_remaining > 4096 ? 4096 : flags_remaining);
+    run_i++;
+    if (run_i >= run_loaded) {
+        /* Load a chunk of records to avoid too many read syscalls. The run
+         * stream length is not known in advance, so the chunk may overlap
+         * the next area; the unused tail is put back below when the
+         * terminating record is reached. */
+        ssize_t size = Utils::readAll(pmfd, runs, sizeof(runs));
+        run_loaded = size / sizeof(PageFlagRun);
+        MYASSERT(run_loaded > 0);
+        run_i = 0;
+    }
 
-    	Utils::readAll(pmfd, flags, size);
-    	flags_remaining -= size;
+    if (runs[run_i].count == 0) {
+        /* Terminating record: the records loaded past it belong to the next
+         * area, seek back so that the file offset points right after it */
+        lseek(pmfd, -static_cast<off_t>((run_loaded - run_i - 1) * sizeof(PageFlagRun)), SEEK_CUR);
+        run_loaded = 0;
+        run_left = 0;
+        runs_done = true;
+    }
+    else {
+        run_left = runs[run_i].count;
+    }
+}
 
-    	flag_i = 0;
+char SaveState::nextFlag()
+{
+    if (run_left == 0) {
+        nextRun();
+        MYASSERT(!runs_done);
     }
 
-    current_flag = flags[flag_i++];
+    run_left--;
+    current_flag = static_cast<char>(runs[run_i].flag);
     return current_flag;
 }
 
 void SaveState::nextArea()
 {
-    if (flags_remaining > 0)
-        lseek(pmfd, flags_remaining, SEEK_CUR);
+    /* Skip the remaining run records of the current area */
+    while (!runs_done)
+        nextRun();
     Utils::readAll(pmfd, &area, sizeof(Area));
     next_pfd_offset = area.page_offset;
     current_addr = static_cast<char*>(area.addr);
-    flag_i = 4096;
-    if (area.skip) {
-        flags_remaining = 0;
-    } else {
-        flags_remaining = area.size / 4096;
-    }
+    run_i = -1;
+    run_loaded = 0;
+    run_left = 0;
+    runs_done = (area.skip || (area.size == 0));
 }
 
 Area& SaveState::getArea()
@@ -146,16 +197,31 @@ char SaveState::getPageFlag(char* addr)
     if (area.skip)
         return Area::NONE;
 
-    char flag;
-    do {
-        flag = nextFlag();
-        if (flag == Area::FULL_PAGE) {
-            next_pfd_offset += 4096;
+    /* Consume whole runs up to the queried address, so that resolving a flag
+     * costs a run lookup instead of a walk over every page in between */
+    while (current_addr <= addr) {
+        if (run_left == 0) {
+            nextRun();
+            MYASSERT(!runs_done);
+            continue;
         }
-        current_addr += 4096;
-    } while (current_addr <= addr);
 
-    return flag;
+        size_t wanted = (addr - current_addr) / 4096 + 1;
+        size_t pages = (run_left < wanted) ? run_left : wanted;
+
+        current_flag = static_cast<char>(runs[run_i].flag);
+        if (current_flag == Area::FULL_PAGE) {
+            next_pfd_offset += pages * 4096;
+        }
+        else if (current_flag == Area::DEDUP_PAGE) {
+            /* The pages file only holds the offset in the page store */
+            next_pfd_offset += pages * 8;
+        }
+        current_addr += pages * 4096;
+        run_left -= pages;
+    }
+
+    return current_flag;
 }
 
 /* Like getPageFlag(), but assumes you're going through the addresses
@@ -166,6 +232,9 @@ char SaveState::getNextPageFlag()
     if (flag == Area::FULL_PAGE) {
         next_pfd_offset += 4096;
     }
+    else if (flag == Area::DEDUP_PAGE) {
+        next_pfd_offset += 8;
+    }
     current_addr += 4096;
     return flag;
 }
@@ -173,16 +242,114 @@ char SaveState::getNextPageFlag()
 void SaveState::finishLoad()
 {
     if (queued_size > 0) {
+#ifdef LIBTAS_ENABLE_ZSTD
+        if (compressed) {
+            readCompressed(queued_offset, queued_addr, queued_size);
+            queued_size = 0;
+            return;
+        }
+#endif
+        if (LazyRestore::mapRange(pfd, queued_addr, queued_offset, queued_size)) {
+            /* The run was mapped from the pages file instead of read, its
+             * pages will be faulted in on first access */
+            queued_size = 0;
+            return;
+        }
+        if (ParallelRestore::isActive()) {
+            /* Defer the read so that it can be executed by the restore
+             * worker pool */
+            ParallelRestore::queueLoad(pfd, queued_addr, queued_offset, queued_size);
+            queued_size = 0;
+            return;
+        }
         lseek(pfd, queued_offset, SEEK_SET);
         Utils::readAll(pfd, queued_addr, queued_size);
         queued_size = 0;
     }
 }
 
+#ifdef LIBTAS_ENABLE_ZSTD
+void SaveState::readCompressed(off_t offset, char* addr, int size)
+{
+    MYASSERT(reader_slot >= 0)
+    MYASSERT(reader_slot < StateCompression::READER_SLOTS)
+
+    if (!chunk_buf) {
+        /* Carve the decompression workspace out of the reserved memory
+         * segment: the decompressed chunk, the compressed input and a
+         * static zstd context. No allocation must happen here because we
+         * run in the checkpoint signal handler. */
+        char* ws = static_cast<char*>(ReservedMemory::getAddr(
+            ReservedMemory::COMPRESS_ADDR + StateCompression::READER_OFF +
+            reader_slot * StateCompression::READER_SIZE));
+        chunk_buf = ws;
+        char* dctx_ws = ws + 2*StateCompression::CHUNK_SIZE + StateCompression::CHUNK_MARGIN;
+        dctx = ZSTD_initStaticDCtx(dctx_ws, StateCompression::READER_SIZE - (dctx_ws - ws));
+        MYASSERT(dctx != nullptr)
+    }
+
+    char* comp_in = chunk_buf + StateCompression::CHUNK_SIZE;
+
+    while (size > 0) {
+        /* Advance through the chunk headers until the chunk containing the
+         * beginning of the range. Queued loads come in increasing stream
+         * order, so we never have to seek backwards. */
+        while ((chunk_raw_size == 0) ||
+               (static_cast<uint64_t>(offset) >= chunk_start + chunk_raw_size)) {
+            StateCompression::ChunkHeader ch;
+            lseek(pfd, chunk_file_offset, SEEK_SET);
+            Utils::readAll(pfd, &ch, sizeof(ch));
+            chunk_start = ch.start;
+            chunk_raw_size = ch.raw_size;
+
+            if (static_cast<uint64_t>(offset) < ch.start + ch.raw_size) {
+                /* This chunk holds the beginning of the range */
+                Utils::readAll(pfd, comp_in, ch.comp_size);
+                size_t ret = ZSTD_decompressDCtx(dctx, chunk_buf,
+                    StateCompression::CHUNK_SIZE, comp_in, ch.comp_size);
+                MYASSERT(ret == ch.raw_size)
+            }
+            chunk_file_offset += sizeof(ch) + ch.comp_size;
+        }
+
+        /* Copy the part of the range that lies in the current chunk */
+        uint32_t chunk_off = offset - chunk_start;
+        int copy_size = chunk_raw_size - chunk_off;
+        if (copy_size > size)
+            copy_size = size;
+        memcpy(addr, chunk_buf + chunk_off, copy_size);
+        addr += copy_size;
+        offset += copy_size;
+        size -= copy_size;
+    }
+}
+#endif
+
 void SaveState::queuePageLoad(char* addr)
 {
     MYASSERT(addr + 4096 == current_addr);
 
+    if (current_flag == Area::DEDUP_PAGE) {
+        /* The pages file holds the offset of the page in the page store.
+         * Flush the queued range first, it precedes the offset in the
+         * page stream. */
+        finishLoad();
+
+        uint64_t store_offset;
+#ifdef LIBTAS_ENABLE_ZSTD
+        if (compressed) {
+            readCompressed(next_pfd_offset - 8, reinterpret_cast<char*>(&store_offset), 8);
+        }
+        else
+#endif
+        {
+            lseek(pfd, next_pfd_offset - 8, SEEK_SET);
+            Utils::readAll(pfd, &store_offset, 8);
+        }
+        PageStore::loadPage(store_offset, addr);
+        return;
+    }
+
     if (queued_size > 0) {
     	if ((next_pfd_offset - 4096) == queued_offset + queued_size &&
     	    addr == queued_addr + queued_size) {
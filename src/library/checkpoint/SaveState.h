@@ -24,12 +24,30 @@
 
 #include "ProcMapsArea.h"
 #include "StateHeader.h"
+#include <sys/types.h> // off_t
+
+#ifdef LIBTAS_ENABLE_ZSTD
+typedef struct ZSTD_DCtx_s ZSTD_DCtx;
+#endif
 
 namespace libtas {
+
+/* Record of the run-length encoded page flag stream stored in the pagemap
+ * file. Page flags occur in huge homogeneous runs (all-zero, all
+ * file-backed), so each area stores a sequence of these records, terminated
+ * by a record with a zero count, instead of one flag byte per page. */
+struct PageFlagRun {
+    uint32_t count;
+    uint32_t flag;
+};
+
 class SaveState
 {
     public:
-        SaveState(char* pagemappath, char* pagespath, int pagemapfd, int pagesfd);
+        /* reader_slot identifies which compression reader workspace from the
+         * reserved memory segment this state may use for decompressing page
+         * chunks, or -1 if the state is only queried for page flags. */
+        SaveState(char* pagemappath, char* pagespath, int pagemapfd, int pagesfd, int reader_slot = -1);
         ~SaveState();
 
 	// Also resets back to first area
@@ -53,20 +71,57 @@ class SaveState
     private:
 	char nextFlag();
 
-	char flags[4096];
+	/* Advance to the next run record of the current area, loading a chunk
+	 * of records from the pagemap file when the buffer is exhausted */
+	void nextRun();
+
+	/* Buffered chunk of run records */
+	PageFlagRun runs[512];
     char current_flag;
-	int flag_i;
-	int flags_remaining;
+	/* Index of the current record in the buffer */
+	int run_i;
+	/* Number of records loaded in the buffer */
+	int run_loaded;
+	/* Pages left in the current record */
+	uint32_t run_left;
+	/* Was the terminating record of the current area reached? */
+	bool runs_done;
 
     int pmfd, pfd;
 
     Area area;
     char* current_addr;
+
+	/* Offset of the next page in the pages file. When the state is
+	 * compressed, this is an offset in the uncompressed page stream. */
 	off_t next_pfd_offset;
 
 	char* queued_addr;
 	off_t queued_offset;
 	int queued_size;
+
+    /* Is the pages file compressed into zstd chunks? */
+    bool compressed;
+
+    int reader_slot;
+
+#ifdef LIBTAS_ENABLE_ZSTD
+    /* Copy a range of the uncompressed page stream into memory, advancing
+     * through the compressed chunks of the pages file. */
+    void readCompressed(off_t offset, char* addr, int size);
+
+    /* Decompressed chunk buffer and zstd context, carved out of the
+     * reserved memory segment on first page load. */
+    char* chunk_buf;
+    ZSTD_DCtx* dctx;
+
+    /* Range of the uncompressed page stream held in chunk_buf */
+    uint64_t chunk_start;
+    uint32_t chunk_raw_size;
+
+    /* Offset of the next chunk header in the pages file */
+    off_t chunk_file_offset;
+#endif
 };
 }
 
@@ -0,0 +1,80 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIBTAS_STATECOMPRESSION_H
+#define LIBTAS_STATECOMPRESSION_H
+
+#ifdef LIBTAS_ENABLE_ZSTD
+
+#include "ReservedMemory.h"
+#include <cstdint>
+
+namespace libtas {
+namespace StateCompression {
+
+    /* When savestate compression is enabled, the pages file does not store
+     * raw memory pages anymore. Pages are accumulated into fixed-size chunks
+     * which are compressed with zstd and appended to the file, each one
+     * prefixed with a ChunkHeader. Because pages of all areas go through the
+     * same chunk stream, page offsets stored in the savestate (page_offset
+     * and the offsets deduced from FULL_PAGE flags) are offsets in the
+     * uncompressed page stream, and readers locate the enclosing chunk by
+     * walking the chunk headers.
+     */
+
+    /* Number of 4096-byte memory pages per compressed chunk */
+    static const int CHUNK_PAGES = 128;
+
+    /* Size of the uncompressed data of a full chunk */
+    static const int CHUNK_SIZE = CHUNK_PAGES * 4096;
+
+    /* Margin over CHUNK_SIZE for the compressed buffer, so that
+     * incompressible chunks still fit (must be above ZSTD_compressBound) */
+    static const int CHUNK_MARGIN = 64 * 1024;
+
+    /* Header stored in front of each compressed chunk in the pages file */
+    struct ChunkHeader {
+        uint64_t start; /* offset of the chunk in the uncompressed page stream */
+        uint32_t raw_size; /* size of the chunk data once decompressed */
+        uint32_t comp_size; /* size of the compressed data following this header */
+    };
+
+    /* Layout of the compression workspaces inside the reserved memory
+     * segment, as offsets from ReservedMemory::COMPRESS_ADDR. The writer
+     * workspace holds the chunk being filled, the compressed output and a
+     * static zstd compression context. Each reader workspace holds the
+     * decompressed chunk and a static zstd decompression context. Two reader
+     * slots are enough because only the loading state and the base state
+     * fetch page contents during a restore.
+     */
+    enum WorkspaceOffsets {
+        WRITER_OFF = 0,
+        READER_OFF = 3*ONE_MB,
+    };
+    enum WorkspaceSizes {
+        WRITER_SIZE = READER_OFF - WRITER_OFF,
+        READER_SIZE = (ReservedMemory::COMPRESS_SIZE - READER_OFF) / 2,
+    };
+
+    static const int READER_SLOTS = 2;
+}
+}
+
+#endif
+#endif
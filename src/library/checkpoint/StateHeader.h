@@ -23,6 +23,7 @@
 #define LIBTAS_STATEHEADER_H
 
 #include <pthread.h>
+#include <cstdint>
 
 #define STATEMAXTHREADS 100
 
@@ -31,6 +32,21 @@ struct StateHeader {
     int thread_count;
     pthread_t pthread_ids[STATEMAXTHREADS];
     pid_t tids[STATEMAXTHREADS];
+
+    /* Set when the pages file stores zstd-compressed chunks instead of raw
+     * pages. We store it in the state so that restoring does not depend on
+     * the current config. */
+    int compressed = 0;
+
+    /* Number of memory pages per compressed chunk */
+    int chunk_pages = 0;
+
+    /* Set when the checksums below are filled in. They are computed over
+     * the bytes written to each state file (past this header for the
+     * pagemap file) and verified before a load touches any memory. */
+    int checksummed = 0;
+    uint64_t pagemap_checksum = 0;
+    uint64_t pages_checksum = 0;
 };
 }
 
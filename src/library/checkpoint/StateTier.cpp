@@ -0,0 +1,334 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "StateTier.h"
+#include "ReservedMemory.h"
+#include "../logging.h"
+#include "../global.h" // shared_config
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#include <cstring>
+#include <sys/wait.h>
+
+namespace libtas {
+namespace StateTier {
+
+/* Number of tiered slots allowed to keep their memfds filled */
+static const int RESIDENT_SLOTS = 4;
+
+struct TierSlot {
+    /* Is the slot content on disk instead of in its memfds? */
+    int demoted;
+    /* Unlinked temporary files holding the demoted content */
+    int disk_pmfd;
+    int disk_pfd;
+    /* Recency of the last save or load of the slot */
+    uint32_t tick;
+};
+
+/* Tier state of the regular savestate slots, stored in reserved memory so
+ * that it survives state loadings */
+struct TierTable {
+    uint32_t clock;
+    pid_t worker_pid;
+    /* Slot being migrated by the background worker, or -1 */
+    int demoting;
+    int promoting;
+    TierSlot slots[SAVESTATE_SLOTS];
+};
+
+static TierTable* getTable()
+{
+    return static_cast<TierTable*>(ReservedMemory::getAddr(ReservedMemory::TIER_ADDR));
+}
+
+/* The slot memfd tables are shared with Checkpoint.cpp, which fills them
+ * when saving */
+static int* pagemapFds()
+{
+    return static_cast<int*>(ReservedMemory::getAddr(ReservedMemory::PAGEMAPS_ADDR));
+}
+
+static int* pagesFds()
+{
+    return static_cast<int*>(ReservedMemory::getAddr(ReservedMemory::PAGES_ADDR));
+}
+
+bool isActive(int index)
+{
+    /* Tiering only makes sense for in-RAM states, and incremental states
+     * are excluded because restoring a slot walks its whole parent chain,
+     * so evicting one slot can stall the loading of every other one */
+    if (!shared_config.savestates_in_ram || shared_config.incremental_savestates)
+        return false;
+
+    /* Only the numbered and backtrack slots are tiered. The base slot (0)
+     * is unused without incremental states, and the rewind and greenzone
+     * slots recycle themselves through their own rings. */
+    return (index >= 1) && (index < SAVESTATE_SLOTS);
+}
+
+void touch(int index)
+{
+    if (!isActive(index))
+        return;
+
+    TierTable* table = getTable();
+    table->slots[index].tick = ++table->clock;
+}
+
+void finish()
+{
+    TierTable* table = getTable();
+    if (!table->worker_pid)
+        return;
+
+    pid_t ret;
+    NATIVECALL(ret = waitpid(table->worker_pid, nullptr, __WALL));
+    MYASSERT(ret == table->worker_pid)
+    table->worker_pid = 0;
+}
+
+void prepareSave(int index)
+{
+    if (!isActive(index))
+        return;
+
+    /* The slot is being overwritten, so its demoted copy is stale. The
+     * memfds stay in the slot tables, truncated by the demotion, and the
+     * saving reuses them. */
+    TierSlot* slot = &getTable()->slots[index];
+    if (slot->demoted) {
+        NATIVECALL(close(slot->disk_pmfd));
+        NATIVECALL(close(slot->disk_pfd));
+        slot->disk_pmfd = 0;
+        slot->disk_pfd = 0;
+        slot->demoted = 0;
+    }
+}
+
+/* Copy the whole content of a file into another one, truncating the
+ * destination first. Both descriptors keep their file offset at the end.
+ * Must stay TLS-free, because it also runs in the cloned worker. */
+static bool copyContent(int srcfd, int dstfd)
+{
+    char buf[65536];
+
+    if (lseek(srcfd, 0, SEEK_SET) == -1)
+        return false;
+    if (ftruncate(dstfd, 0) == -1)
+        return false;
+    if (lseek(dstfd, 0, SEEK_SET) == -1)
+        return false;
+
+    while (true) {
+        ssize_t nread = read(srcfd, buf, sizeof(buf));
+        if (nread == 0)
+            break;
+        if (nread < 0)
+            return false;
+
+        ssize_t written = 0;
+        while (written < nread) {
+            ssize_t ret = write(dstfd, buf + written, nread - written);
+            if (ret <= 0)
+                return false;
+            written += ret;
+        }
+    }
+    return true;
+}
+
+/* Perform the migration chosen by balance(). Must stay TLS-free, because
+ * it runs in a cloned worker (no errno, no NATIVECALL, no logging). */
+static int migrateWorker(void*)
+{
+    TierTable* table = getTable();
+
+    if (table->demoting >= 0) {
+        TierSlot* slot = &table->slots[table->demoting];
+        if (copyContent(pagemapFds()[table->demoting], slot->disk_pmfd) &&
+            copyContent(pagesFds()[table->demoting], slot->disk_pfd)) {
+            /* Release the memfd pages. The descriptors stay in the slot
+             * tables so that the slot still registers as filled. */
+            ftruncate(pagemapFds()[table->demoting], 0);
+            ftruncate(pagesFds()[table->demoting], 0);
+            slot->demoted = 1;
+        }
+        else {
+            close(slot->disk_pmfd);
+            close(slot->disk_pfd);
+            slot->disk_pmfd = 0;
+            slot->disk_pfd = 0;
+        }
+        table->demoting = -1;
+    }
+
+    if (table->promoting >= 0) {
+        TierSlot* slot = &table->slots[table->promoting];
+        if (copyContent(slot->disk_pmfd, pagemapFds()[table->promoting]) &&
+            copyContent(slot->disk_pfd, pagesFds()[table->promoting])) {
+            close(slot->disk_pmfd);
+            close(slot->disk_pfd);
+            slot->disk_pmfd = 0;
+            slot->disk_pfd = 0;
+            slot->demoted = 0;
+        }
+        table->promoting = -1;
+    }
+
+    return 0;
+}
+
+bool ensureResident(int index)
+{
+    if (!isActive(index))
+        return true;
+
+    TierSlot* slot = &getTable()->slots[index];
+    if (!slot->demoted)
+        return true;
+
+    /* The slot is demanded right now, so promote it synchronously */
+    debuglogstdio(LCF_CHECKPOINT, "Promoting savestate slot %d back to RAM", index);
+
+    if (!copyContent(slot->disk_pmfd, pagemapFds()[index]) ||
+        !copyContent(slot->disk_pfd, pagesFds()[index])) {
+        debuglogstdio(LCF_CHECKPOINT | LCF_ERROR, "Could not promote savestate slot %d", index);
+        return false;
+    }
+
+    NATIVECALL(close(slot->disk_pmfd));
+    NATIVECALL(close(slot->disk_pfd));
+    slot->disk_pmfd = 0;
+    slot->disk_pfd = 0;
+    slot->demoted = 0;
+    return true;
+}
+
+/* Is the slot holding a state in its memfds? A demoted slot keeps its
+ * truncated memfds, so the size must be checked too. */
+static bool isResident(int index, TierTable* table)
+{
+    if (table->slots[index].demoted)
+        return false;
+    int fd = pagemapFds()[index];
+    if (!fd)
+        return false;
+    off_t size;
+    NATIVECALL(size = lseek(fd, 0, SEEK_END));
+    return size > 0;
+}
+
+void balance(int pending, const char* pagemappath)
+{
+    if (!shared_config.savestates_in_ram || shared_config.incremental_savestates)
+        return;
+
+    /* A forked background savestate may still be filling its slot memfds,
+     * so leave the tiers alone until it completed */
+    pid_t* child_pid = static_cast<pid_t*>(ReservedMemory::getAddr(ReservedMemory::CHILDPID_ADDR));
+    if (*child_pid)
+        return;
+
+    TierTable* table = getTable();
+
+    int residents = 0;
+    int lru_index = -1;
+    int mru_demoted = -1;
+    for (int i = 1; i < SAVESTATE_SLOTS; i++) {
+        if (isResident(i, table)) {
+            residents++;
+            if (i == pending)
+                continue;
+            if ((lru_index < 0) || (table->slots[i].tick < table->slots[lru_index].tick))
+                lru_index = i;
+        }
+        else if (table->slots[i].demoted) {
+            if ((mru_demoted < 0) || (table->slots[i].tick > table->slots[mru_demoted].tick))
+                mru_demoted = i;
+        }
+    }
+
+    /* The pending slot is about to be filled, so count it against the
+     * resident budget even when it is still empty */
+    if ((pending >= 1) && (pending < SAVESTATE_SLOTS) && !isResident(pending, table))
+        residents++;
+
+    table->demoting = -1;
+    table->promoting = -1;
+
+    if ((residents > RESIDENT_SLOTS) && (lru_index >= 0)) {
+        /* Put the demoted files on the savestate filesystem, unlinked so
+         * that they vanish with the game process. They are created here in
+         * normal context, the worker only copies. */
+        char dirpath[1024];
+        strncpy(dirpath, pagemappath, 1023);
+        dirpath[1023] = '\0';
+        char* sep = strrchr(dirpath, '/');
+        if (sep)
+            *sep = '\0';
+
+        TierSlot* slot = &table->slots[lru_index];
+        NATIVECALL(slot->disk_pmfd = open(dirpath, O_TMPFILE | O_RDWR, 0600));
+        NATIVECALL(slot->disk_pfd = open(dirpath, O_TMPFILE | O_RDWR, 0600));
+        if ((slot->disk_pmfd == -1) || (slot->disk_pfd == -1)) {
+            debuglogstdio(LCF_CHECKPOINT | LCF_ERROR, "Could not create demoted state files in %s", dirpath);
+            if (slot->disk_pmfd != -1)
+                NATIVECALL(close(slot->disk_pmfd));
+            slot->disk_pmfd = 0;
+            slot->disk_pfd = 0;
+            return;
+        }
+
+        debuglogstdio(LCF_CHECKPOINT, "Demoting savestate slot %d to disk", lru_index);
+        table->demoting = lru_index;
+    }
+    else if ((residents < RESIDENT_SLOTS) && (mru_demoted >= 0)) {
+        debuglogstdio(LCF_CHECKPOINT, "Promoting savestate slot %d back to RAM", mru_demoted);
+        table->promoting = mru_demoted;
+    }
+    else {
+        return;
+    }
+
+    /* The worker runs on the restore worker stacks, which are free outside
+     * of a state loading, and is waited on by the next finish() */
+    char* stacks = static_cast<char*>(ReservedMemory::getAddr(ReservedMemory::WORKERSTACKS_ADDR));
+    char* stack_top = stacks + ReservedMemory::WORKERSTACKS_SIZE;
+
+    table->worker_pid = clone(migrateWorker, stack_top, CLONE_VM | CLONE_FS | CLONE_FILES, nullptr);
+    if (table->worker_pid == -1) {
+        debuglogstdio(LCF_CHECKPOINT | LCF_ERROR, "Could not clone the migration worker");
+        table->worker_pid = 0;
+        if (table->demoting >= 0) {
+            TierSlot* slot = &table->slots[table->demoting];
+            NATIVECALL(close(slot->disk_pmfd));
+            NATIVECALL(close(slot->disk_pfd));
+            slot->disk_pmfd = 0;
+            slot->disk_pfd = 0;
+        }
+        table->demoting = -1;
+        table->promoting = -1;
+    }
+}
+
+}
+}
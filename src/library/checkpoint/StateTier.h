@@ -0,0 +1,71 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIBTAS_STATETIER_H
+#define LIBTAS_STATETIER_H
+
+namespace libtas {
+
+/* When savestates are stored in RAM, every filled slot keeps its full
+ * (possibly compressed) memory dump in memfds, so a handful of states can
+ * already exhaust the machine memory. This module tiers the regular slots:
+ * only the most recently used ones stay in memfds, colder slots are demoted
+ * to unlinked temporary files on the savestate filesystem and promoted back
+ * on demand. The migration runs in a background worker cloned like the
+ * ParallelSave one, so neither saving nor loading stalls on the copy.
+ *
+ * The tier table lives in reserved memory so that it survives state
+ * loadings, like the memfd tables it shadows. Only the numbered and
+ * backtrack slots are tiered: the rewind and greenzone rings have their own
+ * recycling, and incremental savestates are excluded because their slots
+ * reference each other through the shared page store.
+ */
+namespace StateTier {
+
+    /* Does tiering apply to the current config and this savestate slot? */
+    bool isActive(int index);
+
+    /* Record a save or load of the slot for the recency ordering */
+    void touch(int index);
+
+    /* Wait for a pending background migration, so that the slot memfds are
+     * stable. Must be called before any other state operation. */
+    void finish();
+
+    /* A save is about to overwrite this slot: drop its demoted disk copy */
+    void prepareSave(int index);
+
+    /* Bring a demoted slot back into its memfds before loading it. Returns
+     * false if the slot could not be promoted. Runs synchronously in normal
+     * context. */
+    bool ensureResident(int index);
+
+    /* Demote the least recently used slot when more than the resident
+     * budget are in RAM, or promote the most recently used demoted slot
+     * when below it. The copy is performed by a background worker, waited
+     * on by the next finish(), so this must only run while the restore
+     * worker stacks are free. `pending` is the slot about to be saved,
+     * counted as resident and never demoted. `pagemappath` is the path of
+     * the current savestate pagemap file, used to place the demoted files
+     * on the same filesystem. */
+    void balance(int pending, const char* pagemappath);
+}
+}
+
+#endif
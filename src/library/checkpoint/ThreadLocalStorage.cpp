@@ -32,6 +32,14 @@
 
 namespace libtas {
 
+/* Note that savestates never walk thread-local storage values: the TLS
+ * blocks and pthread_key slots live in ordinary memory and are captured by
+ * the bulk page save like everything else. The only per-thread TLS state
+ * to handle here is the thread register (%fs/%gs), which is not memory and
+ * must be saved and restored through the kernel. Per-key iteration only
+ * happens in clear_pthread_keys(), when a recycled thread finishes its
+ * routine. */
+
 void ThreadLocalStorage::saveTLSState(ThreadTLSInfo *tlsInfo)
 {
 #ifdef __i386__
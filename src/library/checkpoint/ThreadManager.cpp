@@ -24,7 +24,9 @@
 #include <csignal>
 #include <algorithm> // std::find
 #include <sys/mman.h>
-#include <sys/syscall.h> // syscall, SYS_gettid
+#include <sys/syscall.h> // syscall, SYS_gettid, SYS_futex
+#include <linux/futex.h>
+#include <climits> // INT_MAX
 
 #include "ThreadManager.h"
 #include "ThreadSync.h"
@@ -40,16 +42,31 @@
 namespace libtas {
 
 ThreadInfo* ThreadManager::thread_list = nullptr;
+ThreadInfo* ThreadManager::retired_list = nullptr;
 thread_local ThreadInfo* ThreadManager::current_thread = nullptr;
 pthread_t ThreadManager::main_pthread_id = 0;
 pthread_mutex_t ThreadManager::threadStateLock = PTHREAD_MUTEX_INITIALIZER;
 pthread_mutex_t ThreadManager::threadListLock = PTHREAD_MUTEX_INITIALIZER;
 pthread_rwlock_t ThreadManager::threadResumeLock = PTHREAD_RWLOCK_INITIALIZER;
-sem_t ThreadManager::semNotifyCkptThread;
-sem_t ThreadManager::semWaitForCkptThreadSignal;
+int ThreadManager::suspendedFutex = 0;
+int ThreadManager::restoredFutex = 0;
+int ThreadManager::restoredPhaseFutex = 0;
 volatile bool ThreadManager::restoreInProgress = false;
 int ThreadManager::numThreads;
 
+/* Wrappers around the futex syscall. The suspension barrier counters are
+ * waited on and posted with raw futexes so that a single broadcast resumes
+ * every thread, instead of one semaphore rendezvous per thread. */
+static int futexWait(int* addr, int val, const struct timespec* timeout)
+{
+    return syscall(SYS_futex, addr, FUTEX_WAIT, val, timeout, nullptr, 0);
+}
+
+static void futexWake(int* addr, int num)
+{
+    syscall(SYS_futex, addr, FUTEX_WAKE, num, nullptr, nullptr, 0);
+}
+
 void ThreadManager::init()
 {
     /* Create a ThreadInfo struct for this thread */
@@ -66,9 +83,6 @@ void ThreadManager::init()
     sigaddset(&mask, SIGUSR2);
     NATIVECALL(pthread_sigmask(SIG_UNBLOCK, &mask, nullptr));
 
-    sem_init(&semNotifyCkptThread, 0, 0);
-    sem_init(&semWaitForCkptThreadSignal, 0, 0);
-
     ReservedMemory::init();
 
     setMainThread();
@@ -116,6 +130,12 @@ bool ThreadManager::isMainThread()
 {
     /* Check if main thread has been set */
     if (main_pthread_id) {
+        /* The current thread's info is cached in TLS, so the common case is
+         * one load and a compare instead of a pthread_self() call. This
+         * runs on the logging path of every hooked call, so it matters. */
+        if (current_thread)
+            return (current_thread->pthread_id == main_pthread_id);
+
         return (getThreadId() == main_pthread_id);
     }
 
@@ -152,7 +172,16 @@ ThreadInfo* ThreadManager::getNewThread()
 
 ThreadInfo* ThreadManager::getThread(pthread_t pthread_id)
 {
-    for (ThreadInfo* thread = thread_list; thread != nullptr; thread = thread->next)
+    /* The list is traversed without taking threadListLock, so this works
+     * from wrappers and signal handlers without any contention with thread
+     * creation. This is safe because writers publish fully-initialized
+     * nodes with a release store, and an unlinked node keeps its next
+     * pointer and is not freed until no thread can be standing on it
+     * (see threadIsDead).
+     */
+    for (ThreadInfo* thread = __atomic_load_n(&thread_list, __ATOMIC_ACQUIRE);
+            thread != nullptr;
+            thread = __atomic_load_n(&thread->next, __ATOMIC_ACQUIRE))
         if (thread->pthread_id == pthread_id)
             return thread;
 
@@ -257,13 +286,16 @@ void ThreadManager::addToList(ThreadInfo* thread)
         threadIsDead(cur_thread);
     }
 
-    /* Add the new thread to the list */
+    /* Add the new thread to the list. The node must be fully linked before
+     * the head is published, so that lock-free readers never see a
+     * half-initialized node.
+     */
     thread->next = thread_list;
     thread->prev = nullptr;
     if (thread_list != nullptr) {
         thread_list->prev = thread;
     }
-    thread_list = thread;
+    __atomic_store_n(&thread_list, thread, __ATOMIC_RELEASE);
 
     MYASSERT(pthread_mutex_unlock(&threadListLock) == 0)
 }
@@ -273,19 +305,29 @@ void ThreadManager::threadIsDead(ThreadInfo *thread)
     debuglog(LCF_THREAD, "Remove thread ", thread->tid, " from list");
 
     if (thread->prev != nullptr) {
-        thread->prev->next = thread->next;
+        __atomic_store_n(&thread->prev->next, thread->next, __ATOMIC_RELEASE);
     }
     if (thread->next != nullptr) {
         thread->next->prev = thread->prev;
     }
     if (thread == thread_list) {
-        thread_list = thread_list->next;
+        __atomic_store_n(&thread_list, thread->next, __ATOMIC_RELEASE);
     }
 
     if (thread->altstack.ss_sp) {
         free(thread->altstack.ss_sp);
+        thread->altstack.ss_sp = nullptr;
     }
-    delete(thread);
+
+    /* We cannot delete the struct now: a lock-free getThread() may still be
+     * standing on this node. We keep its next pointer intact so that such a
+     * reader can finish its traversal, and park the node on the retired
+     * list, chained through the prev pointer which readers never follow.
+     * Retired nodes are freed in deallocateThreads(), when no reader can
+     * remain.
+     */
+    thread->prev = retired_list;
+    retired_list = thread;
 
     saveBacktrack = true;
 }
@@ -345,6 +387,19 @@ void ThreadManager::deallocateThreads()
         /* Delete the thread struct */
         threadIsDead(thread);
     }
+
+    /* All secondary threads were told to quit, so no lock-free reader can
+     * still be traversing the list: the retired structs can finally be
+     * freed.
+     */
+    ThreadInfo *retired = retired_list;
+    retired_list = nullptr;
+    while (retired != nullptr) {
+        ThreadInfo *prev = retired->prev;
+        delete(retired);
+        retired = prev;
+    }
+
     MYASSERT(pthread_mutex_unlock(&threadListLock) == 0)
 }
 
@@ -500,127 +555,115 @@ void ThreadManager::suspendThreads()
     MYASSERT(pthread_rwlock_init(&threadResumeLock, NULL) == 0)
     MYASSERT(pthread_rwlock_wrlock(&threadResumeLock) == 0)
 
-    /* Halt all other threads - force them to call stopthisthread
-    * If any have blocked checkpointing, wait for them to unblock before
-    * signalling
-    */
-    MYASSERT(pthread_mutex_lock(&threadListLock) == 0)
+    __atomic_store_n(&suspendedFutex, 0, __ATOMIC_RELAXED);
 
-    bool needrescan = false;
-    do {
-        needrescan = false;
-        numThreads = 0;
-        ThreadInfo *next;
-        for (ThreadInfo *thread = thread_list; thread != nullptr; thread = next) {
-            debuglogstdio(LCF_THREAD | LCF_CHECKPOINT, "Signaling thread %d", thread->tid);
-            next = thread->next;
-            int ret;
-
-            /* Do various things based on thread's state */
-            switch (thread->state) {
-            case ThreadInfo::ST_RUNNING:
-            case ThreadInfo::ST_ZOMBIE:
-            case ThreadInfo::ST_FREE:
-
-                /* Thread is running. Send it a signal so it will call stopthisthread.
-                * We will need to rescan (hopefully it will be suspended by then)
-                */
-                thread->orig_state = thread->state;
-                if (updateState(thread, ThreadInfo::ST_SIGNALED, thread->state)) {
-
-                    /* Setup an alternate signal stack.
-                     *
-                     * This is a workaround for a bug when loading a savestate
-                     * which involves the stack pointer.
-                     * During a state loading, the main thread restores the
-                     * memory of the thread stacks, then resume the threads, and
-                     * each thread restore its registers.
-                     * If the stack pointer had changed, the thread is resumed
-                     * with a corrupted stack (old stack pointer, new stack memory)
-                     * and cannot reach the function to restore its stack pointer.
-                     *
-                     * The workaround is to run our signal handler function on
-                     * an alternate stack (different for each thread).
-                     * This way, this stack pointer will be the same.
-                     */
-
-                    // NATIVECALL(ret = sigaltstack(&thread->altstack, nullptr));
-                    // if (ret < 0) {
-                    //     debuglog(LCF_THREAD | LCF_CHECKPOINT | LCF_ERROR, "sigaltstack failed with error ", ret);
-                    // }
-                    // else {
-                    //     debuglog(LCF_THREAD | LCF_CHECKPOINT | LCF_ERROR, "sigaltstack with add ", thread->altstack.ss_sp);
-                    // }
-                    // struct sigaction sigusr1;
-                    // sigfillset(&sigusr1.sa_mask);
-                    // sigusr1.sa_flags = SA_RESTART | SA_ONSTACK;
-                    // sigusr1.sa_handler = stopThisThread;
-                    // {
-                    //     GlobalNative gn;
-                    //     MYASSERT(sigaction(SIGUSR1, &sigusr1, nullptr) == 0)
-                    // }
-
-                    /* Send the suspend signal to the thread */
-                    NATIVECALL(ret = pthread_kill(thread->pthread_id, SIGUSR1));
-
-                    if (ret == 0) {
-                        needrescan = true;
-                    }
-                    else {
-                        MYASSERT(ret == ESRCH)
-                        debuglog(LCF_THREAD | LCF_CHECKPOINT, "Thread", thread->tid, "has died since");
-                        threadIsDead(thread);
-                    }
-                }
-                break;
+    /* Halt all other threads - force them to call stopthisthread.
+     * First phase: signal every running thread at once, so they all enter
+     * the suspend handler in parallel instead of paying one rendezvous each.
+     */
+    MYASSERT(pthread_mutex_lock(&threadListLock) == 0)
 
-            case ThreadInfo::ST_SIGNALED:
-                NATIVECALL(ret = pthread_kill(thread->pthread_id, 0));
+    numThreads = 0;
+    ThreadInfo *next;
+    for (ThreadInfo *thread = thread_list; thread != nullptr; thread = next) {
+        next = thread->next;
+        int ret;
+
+        /* Do various things based on thread's state */
+        switch (thread->state) {
+        case ThreadInfo::ST_RUNNING:
+        case ThreadInfo::ST_ZOMBIE:
+        case ThreadInfo::ST_FREE:
+
+            /* Thread is running. Send it a signal so it will call stopthisthread. */
+            thread->orig_state = thread->state;
+            if (updateState(thread, ThreadInfo::ST_SIGNALED, thread->state)) {
+                debuglogstdio(LCF_THREAD | LCF_CHECKPOINT, "Signaling thread %d", thread->tid);
+
+                /* The suspend handler runs on an alternate signal stack.
+                 *
+                 * This is a workaround for a bug when loading a savestate
+                 * which involves the stack pointer.
+                 * During a state loading, the main thread restores the
+                 * memory of the thread stacks, then resume the threads, and
+                 * each thread restore its registers.
+                 * If the stack pointer had changed, the thread is resumed
+                 * with a corrupted stack (old stack pointer, new stack memory)
+                 * and cannot reach the function to restore its stack pointer.
+                 *
+                 * The workaround is to run our signal handler function on
+                 * an alternate stack (different for each thread).
+                 * This way, this stack pointer will be the same.
+                 */
+
+                /* Send the suspend signal to the thread */
+                NATIVECALL(ret = pthread_kill(thread->pthread_id, SIGUSR1));
 
                 if (ret == 0) {
-                    needrescan = true;
+                    numThreads++;
                 }
                 else {
                     MYASSERT(ret == ESRCH)
-                    debuglog(LCF_ERROR | LCF_THREAD | LCF_CHECKPOINT, "Signalled thread ", thread->tid, " died");
+                    debuglog(LCF_THREAD | LCF_CHECKPOINT, "Thread", thread->tid, "has died since");
                     threadIsDead(thread);
                 }
-                break;
-
-            case ThreadInfo::ST_SUSPINPROG:
-                numThreads++;
-                break;
+            }
+            break;
 
-            case ThreadInfo::ST_SUSPENDED:
-                numThreads++;
-                break;
+        case ThreadInfo::ST_SIGNALED:
+        case ThreadInfo::ST_SUSPINPROG:
+        case ThreadInfo::ST_SUSPENDED:
+            /* Thread is already on its way to suspension */
+            numThreads++;
+            break;
 
-            case ThreadInfo::ST_CKPNTHREAD:
-                break;
+        case ThreadInfo::ST_CKPNTHREAD:
+            break;
 
-            // case ThreadInfo::ST_FAKEZOMBIE:
-            //     break;
+        // case ThreadInfo::ST_FAKEZOMBIE:
+        //     break;
 
-            case ThreadInfo::ST_UNINITIALIZED:
-                break;
+        case ThreadInfo::ST_UNINITIALIZED:
+            break;
 
-            case ThreadInfo::ST_RECYCLED:
-                break;
+        case ThreadInfo::ST_RECYCLED:
+            break;
 
-            default:
-                debuglog(LCF_ERROR | LCF_THREAD | LCF_CHECKPOINT, "Unknown thread state ", thread->state);
-            }
+        default:
+            debuglog(LCF_ERROR | LCF_THREAD | LCF_CHECKPOINT, "Unknown thread state ", thread->state);
         }
-        if (needrescan) {
-            struct timespec sleepTime = { 0, 10 * 1000 };
-            NATIVECALL(nanosleep(&sleepTime, NULL));
-        }
-    } while (needrescan);
+    }
 
     MYASSERT(pthread_mutex_unlock(&threadListLock) == 0)
 
-    for (int i = 0; i < numThreads; i++) {
-        sem_wait(&semNotifyCkptThread);
+    /* Second phase: wait for all signaled threads to report their suspension
+     * on the shared counter. We wait with a timeout so that we can notice
+     * signaled threads that died before reaching the handler.
+     */
+    while (true) {
+        int count = __atomic_load_n(&suspendedFutex, __ATOMIC_ACQUIRE);
+        if (count >= numThreads)
+            break;
+
+        struct timespec timeout = { 0, 1000 * 1000 };
+        int ret = futexWait(&suspendedFutex, count, &timeout);
+
+        if ((ret == -1) && (errno == ETIMEDOUT)) {
+            /* Rescan for signaled threads that have died */
+            MYASSERT(pthread_mutex_lock(&threadListLock) == 0)
+            for (ThreadInfo *thread = thread_list; thread != nullptr; thread = next) {
+                next = thread->next;
+                if (thread->state == ThreadInfo::ST_SIGNALED) {
+                    NATIVECALL(ret = pthread_kill(thread->pthread_id, 0));
+                    if (ret == ESRCH) {
+                        debuglog(LCF_ERROR | LCF_THREAD | LCF_CHECKPOINT, "Signalled thread ", thread->tid, " died");
+                        threadIsDead(thread);
+                        numThreads--;
+                    }
+                }
+            }
+            MYASSERT(pthread_mutex_unlock(&threadListLock) == 0)
+        }
     }
 
     debuglog(LCF_THREAD | LCF_CHECKPOINT, numThreads, " threads were suspended");
@@ -667,7 +710,8 @@ void ThreadManager::stopThisThread(int signum)
 
             /* Tell the checkpoint thread that we're all saved away */
             MYASSERT(updateState(current_thread, ThreadInfo::ST_SUSPENDED, ThreadInfo::ST_SUSPINPROG))
-            sem_post(&semNotifyCkptThread);
+            __atomic_add_fetch(&suspendedFutex, 1, __ATOMIC_RELEASE);
+            futexWake(&suspendedFutex, 1);
 
             /* Then wait for the ckpt thread to write the ckpt file then wake us up */
             debuglogstdio(LCF_THREAD | LCF_CHECKPOINT, "Thread suspended");
@@ -709,18 +753,29 @@ void ThreadManager::stopThisThread(int signum)
 void ThreadManager::waitForAllRestored(ThreadInfo *thread)
 {
     if (thread->state == ThreadInfo::ST_CKPNTHREAD) {
-        for (int i = 0; i < numThreads; i++) {
-            sem_wait(&semNotifyCkptThread);
+        /* Wait for all threads to report their restoration */
+        while (true) {
+            int count = __atomic_load_n(&restoredFutex, __ATOMIC_ACQUIRE);
+            if (count >= numThreads)
+                break;
+            futexWait(&restoredFutex, count, nullptr);
         }
+        __atomic_store_n(&restoredFutex, 0, __ATOMIC_RELAXED);
 
-        /* If this was last of all, wake everyone up */
-        for (int i = 0; i < numThreads; i++) {
-            sem_post(&semWaitForCkptThreadSignal);
-        }
+        /* If this was last of all, wake everyone up with a single broadcast */
+        __atomic_add_fetch(&restoredPhaseFutex, 1, __ATOMIC_RELEASE);
+        futexWake(&restoredPhaseFutex, INT_MAX);
     }
     else {
-        sem_post(&semNotifyCkptThread);
-        sem_wait(&semWaitForCkptThreadSignal);
+        /* The phase must be read before reporting, otherwise the checkpoint
+         * thread could broadcast the next phase in between and we would wait
+         * on it forever */
+        int phase = __atomic_load_n(&restoredPhaseFutex, __ATOMIC_ACQUIRE);
+        __atomic_add_fetch(&restoredFutex, 1, __ATOMIC_RELEASE);
+        futexWake(&restoredFutex, 1);
+
+        while (__atomic_load_n(&restoredPhaseFutex, __ATOMIC_ACQUIRE) == phase)
+            futexWait(&restoredPhaseFutex, phase, nullptr);
     }
 }
 
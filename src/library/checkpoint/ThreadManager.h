@@ -30,11 +30,17 @@
 #include <atomic>
 #include <cstddef>
 #include <pthread.h>
-#include <semaphore.h>
 
 namespace libtas {
 class ThreadManager {
     static ThreadInfo* free_list;
+
+    /* Threads unlinked from thread_list are parked here (chained through
+     * their prev pointer) instead of being freed, because lock-free readers
+     * of the list may still be standing on them. They are reclaimed in
+     * deallocateThreads() when no reader can remain. */
+    static ThreadInfo* retired_list;
+
     static thread_local ThreadInfo* current_thread;
 
     // static bool inited;
@@ -43,12 +49,21 @@ class ThreadManager {
     static pthread_mutex_t threadStateLock;
     static pthread_mutex_t threadListLock;
     static pthread_rwlock_t threadResumeLock;
-    static sem_t semNotifyCkptThread;
-    static sem_t semWaitForCkptThreadSignal;
+    /* Counters of the two-phase suspension barrier, used as futexes.
+     * Suspended threads report on suspendedFutex, restored threads on
+     * restoredFutex, and the checkpoint thread releases them all with a
+     * single broadcast on the restoredPhaseFutex generation counter. */
+    static int suspendedFutex;
+    static int restoredFutex;
+    static int restoredPhaseFutex;
 
     static int numThreads;
 
 public:
+    /* List of threads, readable without taking threadListLock: writers
+     * publish fully-initialized nodes and never free an unlinked node while
+     * readers can traverse it (see getThread). Modifications still require
+     * the lock. */
     static ThreadInfo* thread_list;
 
     static volatile bool restoreInProgress;
@@ -74,7 +89,9 @@ public:
     /* Get the thread tid of another thread */
     static pid_t getThreadTid(pthread_t pthread_id);
 
-    /* Get the ThreadInfo struct from the thread id, or null if not there */
+    /* Get the ThreadInfo struct from the thread id, or null if not there.
+     * Does not take any lock, so it is safe to call from wrappers and from
+     * signal handlers. */
     static ThreadInfo* getThread(pthread_t pthread_id);
 
     /* Init the ThreadInfo by the parent thread with values passed in
@@ -91,7 +108,8 @@ public:
     /* Add a thread to the thread list */
     static void addToList(ThreadInfo* thread);
 
-    /* Remove a thread from the list and add it to the free list */
+    /* Unlink a thread from the list and park its struct on the retired
+     * list until it can be safely freed */
     static void threadIsDead(ThreadInfo *thread);
 
     /* Called when thread detach another thread */
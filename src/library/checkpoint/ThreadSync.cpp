@@ -21,17 +21,34 @@
 
 #include "ThreadSync.h"
 #include "../logging.h"
-#include <time.h> // nanosleep
 #include "../GlobalState.h"
-#include <atomic>
+#include <errno.h>
+#include <climits> // INT_MAX
 #include <pthread.h> // pthread_rwlock_t
+#include <sys/syscall.h> // syscall, SYS_futex
+#include <linux/futex.h>
+#include <unistd.h>
 
 namespace libtas {
 
-static std::atomic<int> uninitializedThreadCount(0);
+/* Number of threads created but not yet initialized, waited on as a futex
+ * so that the barrier below wakes as soon as the last thread reports in,
+ * instead of on the next polling period */
+static int uninitializedThreadCount = 0;
+
 static pthread_rwlock_t wrapperExecutionLock =
     PTHREAD_RWLOCK_WRITER_NONRECURSIVE_INITIALIZER_NP;
 
+static int futexWait(int* addr, int val)
+{
+    return syscall(SYS_futex, addr, FUTEX_WAIT, val, nullptr, nullptr, 0);
+}
+
+static void futexWake(int* addr, int num)
+{
+    syscall(SYS_futex, addr, FUTEX_WAKE, num, nullptr, nullptr, 0);
+}
+
 void ThreadSync::acquireLocks()
 {
     debuglog(LCF_THREAD | LCF_CHECKPOINT, "Waiting for other threads to exit wrappers");
@@ -51,40 +68,44 @@ void ThreadSync::releaseLocks()
 
 void ThreadSync::waitForThreadsToFinishInitialization()
 {
-    while (uninitializedThreadCount != 0) {
-        struct timespec sleepTime = { 0, 10 * 1000 * 1000 };
-        debuglog(LCF_THREAD, "Sleeping ", sleepTime.tv_nsec, " ns for thread initialization");
-        NATIVECALL(nanosleep(&sleepTime, NULL));
+    /* Block on the counter until the last initializing thread drops it to
+     * zero. The loop absorbs spurious wakes and threads created while we
+     * were waiting */
+    while (1) {
+        int count = __atomic_load_n(&uninitializedThreadCount, __ATOMIC_SEQ_CST);
+        if (count == 0)
+            break;
+        debuglog(LCF_THREAD, "Waiting for ", count, " threads to initialize");
+        futexWait(&uninitializedThreadCount, count);
     }
 }
 
 void ThreadSync::incrementUninitializedThreadCount()
 {
-    uninitializedThreadCount++;
+    __atomic_add_fetch(&uninitializedThreadCount, 1, __ATOMIC_SEQ_CST);
 }
 
 void ThreadSync::decrementUninitializedThreadCount()
 {
-    if (uninitializedThreadCount <= 0) {
+    int count = __atomic_sub_fetch(&uninitializedThreadCount, 1, __ATOMIC_SEQ_CST);
+    if (count < 0) {
         debuglog(LCF_ERROR | LCF_THREAD, "uninitializedThreadCount is negative!");
     }
-    uninitializedThreadCount--;
+    if (count == 0) {
+        /* Wake up the barrier right away */
+        futexWake(&uninitializedThreadCount, INT_MAX);
+    }
 }
 
 void ThreadSync::wrapperExecutionLockLock()
 {
-    while (1) {
-        int retVal = pthread_rwlock_tryrdlock(&wrapperExecutionLock);
-        if (retVal != 0 && retVal == EBUSY) {
-            struct timespec sleepTime = { 0, 100 * 1000 * 1000 };
-            NATIVECALL(nanosleep(&sleepTime, NULL));
-            continue;
-        }
-        if (retVal != 0 && retVal != EDEADLK) {
-            debuglog(LCF_ERROR | LCF_THREAD, "Failed to acquire lock!");
-            return;
-        }
-        break;
+    /* Block instead of polling with a sleep, so threads resume the moment
+     * a checkpoint releases the write lock. EDEADLK means this thread
+     * already holds the write lock, and is treated as before: proceed
+     * without acquiring. */
+    int retVal = pthread_rwlock_rdlock(&wrapperExecutionLock);
+    if ((retVal != 0) && (retVal != EDEADLK)) {
+        debuglog(LCF_ERROR | LCF_THREAD, "Failed to acquire lock!");
     }
 }
 
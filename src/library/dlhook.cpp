@@ -21,6 +21,8 @@
 #include "logging.h"
 #include "hook.h"
 #include <cstring>
+#include <map>
+#include <mutex>
 #include <set>
 #include "backtrace.h"
 
@@ -141,7 +143,33 @@ void *dlsym(void *handle, const char *name) throw() {
      * some arithmetic pointer shenanigan?
      */
 
-    void *addr = find_sym(name);
+    /* Whether a symbol is one of our hooks only depends on its name:
+     * libtas.so is placed ahead of everything by LD_PRELOAD and never
+     * gains or loses symbols at runtime, so the answer cannot change when
+     * the game dlopens more libraries. Cache it, as plugin-heavy engines
+     * resolve the same symbol set on every plugin load, and each find_sym
+     * costs a dlsym plus a dladdr plus a path comparison. Negative answers
+     * are cached too. Created on first use like the libraries set above. */
+    static std::map<std::string, void*>* hook_cache = nullptr;
+    static std::mutex hook_cache_mutex;
+
+    void *addr;
+    {
+        std::lock_guard<std::mutex> lock(hook_cache_mutex);
+        if (!hook_cache) {
+            hook_cache = new std::map<std::string, void*>();
+        }
+
+        auto it = hook_cache->find(name);
+        if (it != hook_cache->end()) {
+            addr = it->second;
+        }
+        else {
+            addr = find_sym(name);
+            (*hook_cache)[name] = addr;
+        }
+    }
+
     if (addr == nullptr) {
         addr = orig::dlsym(handle, name);
     }
@@ -28,12 +28,129 @@
 #include "../../shared/messages.h"
 
 #include <cstdint>
+#include <cstring>
 #include <unistd.h> // usleep
 #include <sstream>
 #include <iomanip>
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
 
 namespace libtas {
 
+/* Ring buffer between the muxer and a dedicated writer, so that a slow
+ * ffmpeg does not stall the frame boundary. The muxer output is redirected
+ * into the ring through a fopencookie() stream, and a cloned worker drains
+ * it into the real pipe. The game thread only blocks when the ring is
+ * truly full, which smooths encoding of fast-forwarded segments where the
+ * game runs much faster than ffmpeg encodes.
+ *
+ * The worker is a cloned process sharing our address space, like the
+ * savestate write worker, so it is not tracked by ThreadManager and never
+ * takes part in savestates. Its loop must stay TLS-free. */
+
+/* Deep enough for several 1080p raw frames, and at least one 4K frame */
+static const size_t QUEUE_SIZE = 64*1024*1024;
+
+static const size_t WORKER_STACK_SIZE = 64*1024;
+
+struct EncodeQueue {
+    uint64_t head; /* bytes queued, only advanced by the game thread */
+    uint64_t tail; /* bytes written to the pipe, only advanced by the worker */
+    int done; /* set when no more bytes will be queued */
+    int error; /* set by the worker when a pipe write failed */
+    int fd;
+    char* buffer;
+};
+
+/* Everything a finished encoder leaves behind while its worker drains the
+ * ring and ffmpeg encodes its tail. Kept in a list of pending states and
+ * collected by reapPending() once both processes are gone, so stopping a
+ * dump or rolling a segment returns immediately */
+struct EncodeState {
+    EncodeQueue queue;
+    char* worker_stack;
+    pid_t worker_pid;
+    pid_t ffmpeg_pid;
+    EncodeState* next;
+};
+
+static EncodeState* pending_states = nullptr;
+
+static int encodeWorker(void* arg)
+{
+    EncodeQueue* queue = static_cast<EncodeQueue*>(arg);
+
+    while (true) {
+        const uint64_t head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+        if (queue->tail == head) {
+            if (__atomic_load_n(&queue->done, __ATOMIC_ACQUIRE))
+                break;
+            sched_yield();
+            continue;
+        }
+
+        /* Write the largest contiguous segment. After a write error,
+         * ffmpeg is gone: keep consuming so the game thread never blocks
+         * on a full ring, and report the error when the dump ends. */
+        const size_t off = queue->tail % QUEUE_SIZE;
+        size_t seg = QUEUE_SIZE - off;
+        if (seg > head - queue->tail)
+            seg = head - queue->tail;
+
+        if (!queue->error) {
+            const ssize_t ret = write(queue->fd, queue->buffer + off, seg);
+            if (ret <= 0)
+                __atomic_store_n(&queue->error, 1, __ATOMIC_RELAXED);
+            else
+                seg = ret;
+        }
+
+        __atomic_store_n(&queue->tail, queue->tail + seg, __ATOMIC_RELEASE);
+    }
+
+    /* Closing the pipe sends EOF to ffmpeg, which finishes encoding and
+     * exits on its own. Nobody else closes this descriptor */
+    close(queue->fd);
+    return 0;
+}
+
+/* fopencookie() write callback: copy the muxer output into the ring,
+ * yielding while it is full */
+static ssize_t encodeQueueWrite(void* cookie, const char* buf, size_t size)
+{
+    EncodeQueue* queue = static_cast<EncodeQueue*>(cookie);
+    size_t written = 0;
+
+    while (written < size) {
+        const uint64_t tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+        const size_t space = QUEUE_SIZE - (queue->head - tail);
+
+        if (space == 0) {
+            if (queue->error)
+                return size; /* discard, ffmpeg is gone */
+            sched_yield();
+            continue;
+        }
+
+        const size_t off = queue->head % QUEUE_SIZE;
+        size_t seg = QUEUE_SIZE - off;
+        if (seg > space)
+            seg = space;
+        if (seg > size - written)
+            seg = size - written;
+
+        memcpy(queue->buffer + off, buf + written, seg);
+        written += seg;
+
+        /* The bytes must be visible to the worker before the head advance */
+        __atomic_store_n(&queue->head, queue->head + seg, __ATOMIC_RELEASE);
+    }
+
+    return size;
+}
+
 
 int AVEncoder::segment_number = 0;
 char AVEncoder::dumpfile[4096] = {0};
@@ -43,6 +160,10 @@ std::unique_ptr<AVEncoder> avencoder;
 
 
 AVEncoder::AVEncoder() {
+    /* Collect encoders that finished in the background since the last
+     * check, before setting up a new one */
+    reapPending();
+
     std::ostringstream commandline;
     commandline << "ffmpeg -hide_banner -y -f nut -i - ";
     commandline << ffmpeg_options;
@@ -55,13 +176,81 @@ AVEncoder::AVEncoder() {
     commandline << strrchr(dumpfile, '.');
     commandline << "\"";
 
-    NATIVECALL(ffmpeg_pipe = popen(commandline.str().c_str(), "w"));
-
-    if (! ffmpeg_pipe) {
+    /* Spawn ffmpeg over a pipe we own, instead of popen(), so its pid is
+     * known and can be collected without blocking after the dump ends */
+    int pipefds[2];
+    int ret;
+    NATIVECALL(ret = pipe(pipefds));
+    if (ret < 0) {
         debuglog(LCF_DUMP | LCF_ERROR, "Could not create a pipe to ffmpeg");
         return;
     }
 
+    pid_t ffmpeg_pid;
+    NATIVECALL(ffmpeg_pid = fork());
+    if (ffmpeg_pid == 0) {
+        /* Child: plug the read end into stdin and run the command through
+         * the shell, like popen() did */
+        dup2(pipefds[0], 0);
+        close(pipefds[0]);
+        close(pipefds[1]);
+        execl("/bin/sh", "sh", "-c", commandline.str().c_str(), static_cast<char*>(nullptr));
+        _exit(127);
+    }
+    close(pipefds[0]);
+
+    if (ffmpeg_pid == -1) {
+        debuglog(LCF_DUMP | LCF_ERROR, "Could not spawn ffmpeg");
+        close(pipefds[1]);
+        return;
+    }
+
+    /* Set up the ring buffer and its writer, and route the muxer output
+     * into it. If anything fails, the muxer keeps writing to the pipe
+     * directly like before */
+    encode_state = new EncodeState();
+    encode_state->queue.head = 0;
+    encode_state->queue.tail = 0;
+    encode_state->queue.done = 0;
+    encode_state->queue.error = 0;
+    encode_state->queue.fd = pipefds[1];
+    encode_state->worker_pid = -1;
+    encode_state->ffmpeg_pid = ffmpeg_pid;
+    encode_state->next = nullptr;
+
+    /* Grow the pipe as much as the kernel allows (1MB by default), so the
+     * writer hands off raw frames in large segments instead of ping-ponging
+     * with ffmpeg over 64KB of pipe capacity. A raw 1080p frame is 8MB, so
+     * this cuts the number of write/wakeup cycles per frame accordingly */
+    for (int pipe_size = 16*1024*1024; pipe_size >= 1024*1024; pipe_size /= 2) {
+        if (fcntl(encode_state->queue.fd, F_SETPIPE_SZ, pipe_size) >= 0)
+            break;
+    }
+    encode_state->queue.buffer = static_cast<char*>(mmap(nullptr, QUEUE_SIZE,
+        PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    encode_state->worker_stack = static_cast<char*>(mmap(nullptr, WORKER_STACK_SIZE,
+        PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0));
+
+    if ((encode_state->queue.buffer != MAP_FAILED) && (encode_state->worker_stack != MAP_FAILED)) {
+        encode_state->worker_pid = clone(encodeWorker, encode_state->worker_stack + WORKER_STACK_SIZE,
+            CLONE_VM | CLONE_FS | CLONE_FILES, &encode_state->queue);
+    }
+
+    if (encode_state->worker_pid != -1) {
+        cookie_io_functions_t funcs = {};
+        funcs.write = encodeQueueWrite;
+        muxer_pipe = fopencookie(&encode_state->queue, "w", funcs);
+        if (muxer_pipe) {
+            /* Unbuffered, so fwrite() goes straight into the ring */
+            setvbuf(muxer_pipe, nullptr, _IONBF, 0);
+        }
+    }
+
+    if (!muxer_pipe) {
+        ffmpeg_file = fdopen(pipefds[1], "w");
+        muxer_pipe = ffmpeg_file;
+    }
+
     if (ScreenCapture::isInited()) {
         initMuxer();
     }
@@ -77,10 +266,10 @@ void AVEncoder::initMuxer() {
 
     const char* pixfmt = ScreenCapture::getPixelFormat();
 
-    nutMuxer = new NutMuxer(width, height, shared_config.framerate_num, shared_config.framerate_den, pixfmt, audiocontext.outFrequency, audiocontext.outAlignSize, audiocontext.outNbChannels, ffmpeg_pipe);
+    nutMuxer = new NutMuxer(width, height, shared_config.framerate_num, shared_config.framerate_den, pixfmt, audiocontext.outFrequency, audiocontext.outAlignSize, audiocontext.outNbChannels, muxer_pipe);
 }
 
-void AVEncoder::encodeOneFrame(bool draw) {
+void AVEncoder::encodeOneFrame(bool draw, bool pixels_ready) {
 
     /* If the muxer is not initialized, try to initialize it. Otherwise, store
      * that we skipped one frame and we need to encode it later.
@@ -118,9 +307,28 @@ void AVEncoder::encodeOneFrame(bool draw) {
     debuglog(LCF_DUMP, "Encode a video frame");
 
     /* Access to the screen pixels, or last screen pixels if not a draw frame */
-    int size = ScreenCapture::getPixels(&pixels, draw);
+    int size = ScreenCapture::getPixels(&pixels, draw && !pixels_ready);
+
+    /* TAS footage holds long runs of identical frames (menus, lag frames).
+     * Instead of re-sending identical raw frames to ffmpeg, only advance
+     * the video pts. Non-draw frames cannot differ from the previous frame,
+     * and draw frames are compared against the last emitted one: an exact
+     * compare, unlike a hash, can never elide a frame that differs. */
+    bool repeat = false;
+    if (last_frame.size() == static_cast<size_t>(size)) {
+        if (!draw)
+            repeat = true;
+        else
+            repeat = (0 == memcmp(last_frame.data(), pixels, size));
+    }
 
-    nutMuxer->writeVideoFrame(pixels, size);
+    if (repeat) {
+        nutMuxer->repeatVideoFrame();
+    }
+    else {
+        nutMuxer->writeVideoFrame(pixels, size);
+        last_frame.assign(pixels, pixels + size);
+    }
 }
 
 AVEncoder::~AVEncoder() {
@@ -128,12 +336,71 @@ AVEncoder::~AVEncoder() {
         nutMuxer->finish();
     }
 
-    if (ffmpeg_pipe) {
+    if (!encode_state) {
+        return;
+    }
+
+    if (encode_state->worker_pid != -1) {
+        /* Flush the cookie stream into the ring, then tell the worker no
+         * more bytes are coming. It drains the ring in the background and
+         * closes the pipe, which makes ffmpeg finish and exit */
+        if (muxer_pipe) {
+            fclose(muxer_pipe);
+        }
+        __atomic_store_n(&encode_state->queue.done, 1, __ATOMIC_RELEASE);
+    }
+    else if (ffmpeg_file) {
+        /* Direct path: closing the stream sends EOF to ffmpeg */
+        fclose(ffmpeg_file);
+    }
+    else {
+        close(encode_state->queue.fd);
+    }
+
+    /* Hand the state to the pending list without waiting for either
+     * process, so stopping a dump or rolling a segment does not stall the
+     * frame boundary. reapPending() frees it once both are gone */
+    encode_state->next = pending_states;
+    pending_states = encode_state;
+    encode_state = nullptr;
+}
+
+void AVEncoder::reapPending() {
+    EncodeState** link = &pending_states;
+    while (*link) {
+        EncodeState* state = *link;
         int ret;
-        NATIVECALL(ret = pclose(ffmpeg_pipe));
-        if (ret < 0) {
-            debuglog(LCF_DUMP | LCF_ERROR, "Could not close the pipe to ffmpeg");
+
+        /* The worker must have exited before its ring and stack are freed */
+        if (state->worker_pid != -1) {
+            NATIVECALL(ret = waitpid(state->worker_pid, nullptr, __WALL | WNOHANG));
+            if (ret == 0) {
+                link = &state->next;
+                continue;
+            }
+            if (state->queue.error) {
+                debuglog(LCF_DUMP | LCF_ERROR, "Some encoded data could not be written to ffmpeg");
+            }
+            state->worker_pid = -1;
+        }
+
+        if (state->ffmpeg_pid != -1) {
+            NATIVECALL(ret = waitpid(state->ffmpeg_pid, nullptr, WNOHANG));
+            if (ret == 0) {
+                link = &state->next;
+                continue;
+            }
+            state->ffmpeg_pid = -1;
+        }
+
+        if (state->queue.buffer && (state->queue.buffer != MAP_FAILED)) {
+            munmap(state->queue.buffer, QUEUE_SIZE);
+        }
+        if (state->worker_stack && (state->worker_stack != MAP_FAILED)) {
+            munmap(state->worker_stack, WORKER_STACK_SIZE);
         }
+        *link = state->next;
+        delete state;
     }
 }
 
@@ -25,6 +25,11 @@
 #include <memory> // std::unique_ptr
 
 namespace libtas {
+
+/* Per-encoder state that outlives the AVEncoder object while its ffmpeg
+ * process and ring writer finish in the background */
+struct EncodeState;
+
 class AVEncoder {
     public:
         /* The constructor sets up the AV dumping into a file.
@@ -41,12 +46,24 @@ class AVEncoder {
         /* Encode a video and audio frame.
          * @param draw           Is this a draw frame?
          */
-        void encodeOneFrame(bool draw);
-
-        /* Close all allocated objects and close the pipe at the end of an av dump
+        /* Encode one frame. When pixels_ready is set, the stored screen
+         * pixels already hold the frame to encode (e.g. with the HUD
+         * composited in) and are not fetched again. */
+        void encodeOneFrame(bool draw, bool pixels_ready = false);
+
+        /* Close all allocated objects at the end of an av dump. The ffmpeg
+         * process and the ring writer are not waited for: they finish in
+         * the background and are collected by reapPending(), so stopping a
+         * dump or rolling a segment never stalls the frame boundary.
          */
         ~AVEncoder();
 
+        /* Collect finished background encoders without blocking. Cheap
+         * when nothing is pending; called at frame boundaries and when a
+         * new encoder starts.
+         */
+        static void reapPending();
+
         /* Filename of the encode. We use a static array because it can be set
          * very early in the game execution, before objects like std::string
          * has a chance to call its constructor.
@@ -58,13 +75,29 @@ class AVEncoder {
 
         static int segment_number;
     private:
-        FILE *ffmpeg_pipe = nullptr;
+        /* Pipe, ring buffer and process ids of this encoder. Handed over
+         * to the pending list on destruction */
+        EncodeState *encode_state = nullptr;
+
+        /* stdio stream over the pipe write end, only created when the
+         * ring writer could not be set up and the muxer writes to the
+         * pipe directly */
+        FILE *ffmpeg_file = nullptr;
+
+        /* Stream given to the muxer: either a fopencookie() stream feeding
+         * the ring buffer drained by the writer, or the pipe itself when
+         * the writer could not be set up */
+        FILE *muxer_pipe = nullptr;
+
         NutMuxer* nutMuxer = nullptr;
 
         uint8_t* pixels = nullptr;
 
         int startup_video_frames = 0;
         std::vector<uint8_t> startup_audio_bytes;
+
+        /* Copy of the last emitted video frame, for duplicate elision */
+        std::vector<uint8_t> last_frame;
 };
 
 extern std::unique_ptr<AVEncoder> avencoder;
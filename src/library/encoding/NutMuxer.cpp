@@ -20,6 +20,7 @@
 /* NutMixer taken from BizHawk <http://tasvideos.org/BizHawk.html> */
 
 #include "NutMuxer.h"
+#include "../Utils.h"
 
 #include "../logging.h"
 
@@ -109,9 +110,14 @@ unsigned int NutMuxer::CRCtable[] =
 };
 
 unsigned int NutMuxer::nutCRC32(const std::vector<uint8_t> &buf)
+{
+	return nutCRC32(buf.data(), buf.size());
+}
+
+unsigned int NutMuxer::nutCRC32(const uint8_t* buf, size_t len)
 {
 	unsigned int crc = 0;
-	for (unsigned int i = 0; i < buf.size(); i++)
+	for (size_t i = 0; i < len; i++)
 	{
 		crc ^= static_cast<unsigned int>(buf[i]) << 24;
 		crc = (crc << 4) ^ CRCtable[crc >> 28];
@@ -143,6 +149,23 @@ void NutMuxer::NutPacket::flush()
     fwrite(data.data(), 1, data.size(), underlying);
 }
 
+void NutMuxer::NutPacket::serialize(std::vector<uint8_t> &stream)
+{
+	/* The header is written straight into the output stream, remembering
+	 * where it starts so the header checksum can be computed in place */
+	size_t headerStart = stream.size();
+	writeBE64(static_cast<uint64_t>(startcode), stream);
+	writeVarU(static_cast<int>(data.size() + 4), stream); // +4 for checksum
+	if (data.size() > 4092)
+	{
+		unsigned int crc = nutCRC32(stream.data() + headerStart, stream.size() - headerStart);
+		writeBE32(crc, stream);
+	}
+
+	writeBE32(nutCRC32(data), data);
+	stream.insert(stream.end(), data.begin(), data.end());
+}
+
 void NutMuxer::NutPacket::write(const char* buffer, int count)
 {
 	data.insert(data.end(), buffer, buffer + count);
@@ -258,13 +281,21 @@ void NutMuxer::writeAudioHeader()
 
 void NutMuxer::writeFrame(const uint8_t* payload, int payloadlen, uint64_t pts, uint64_t ptsnum, uint64_t ptsden, int ptsindex, FILE *underlying)
 {
-	// create syncpoint
-	NutPacket sync(NutPacket::Syncpoint, underlying);
-	writeVarU(pts * 2 + static_cast<uint64_t>(ptsindex), sync.data); // global_key_pts
-	writeVarU(1, sync.data); // back_ptr_div_16, this is wrong
-	sync.flush();
-
-	std::vector<uint8_t> frameheader;
+	// create syncpoint, reusing the packet and buffers across frames
+	syncPacket.underlying = underlying;
+	syncPacket.data.clear();
+	writeVarU(pts * 2 + static_cast<uint64_t>(ptsindex), syncPacket.data); // global_key_pts
+	writeVarU(1, syncPacket.data); // back_ptr_div_16, this is wrong
+
+	/* The syncpoint packet and the frame header are serialized into buffers
+	 * and written together with the raw payload as a single gathered write,
+	 * so a frame costs one syscall on the muxer pipe instead of several
+	 * small ones followed by the payload. */
+	syncBuf.clear();
+	syncPacket.serialize(syncBuf);
+
+	frameHeaderBuf.clear();
+	std::vector<uint8_t> &frameheader = frameHeaderBuf;
 	frameheader.push_back(0); // frame_code
 	// frame_flags = FLAG_CODED, so:
 	int flags = 0;
@@ -281,9 +312,35 @@ void NutMuxer::writeFrame(const uint8_t* payload, int payloadlen, uint64_t pts,
 	writeVarU(payloadlen, frameheader); // data_size_msb
 
     writeBE32(nutCRC32(frameheader), frameheader); // checksum
-    fwrite(frameheader.data(), 1, frameheader.size(), underlying);
-	if (payload)
-		fwrite(payload, 1, payloadlen, underlying);
+
+	/* Flush any buffered header packets before writing to the raw
+	 * descriptor below */
+	fflush(underlying);
+
+	int fd = fileno(underlying);
+	if (fd >= 0) {
+		struct iovec iov[3];
+		iov[0].iov_base = syncBuf.data();
+		iov[0].iov_len = syncBuf.size();
+		iov[1].iov_base = frameheader.data();
+		iov[1].iov_len = frameheader.size();
+		int iovcnt = 2;
+		if (payload) {
+			iov[2].iov_base = const_cast<uint8_t*>(payload);
+			iov[2].iov_len = payloadlen;
+			iovcnt = 3;
+		}
+		Utils::writeAllV(fd, iov, iovcnt);
+	}
+	else {
+		/* Streams from fopencookie() carry no descriptor, so gather the
+		 * frame into one buffer and emit it as a single fwrite: the stream
+		 * is unbuffered, so this still reaches the ring in one write. */
+		syncBuf.insert(syncBuf.end(), frameheader.begin(), frameheader.end());
+		if (payload)
+			syncBuf.insert(syncBuf.end(), payload, payload + payloadlen);
+		fwrite(syncBuf.data(), 1, syncBuf.size(), underlying);
+	}
 }
 
 void NutMuxer::writeVideoFrame(const uint8_t* video, int len)
@@ -296,6 +353,16 @@ void NutMuxer::writeVideoFrame(const uint8_t* video, int len)
 
 }
 
+void NutMuxer::repeatVideoFrame()
+{
+	debuglog(LCF_DUMP, "Elide nut video frame identical to the previous one");
+
+	/* Only advance the video pts: the next emitted frame carries the gap in
+	 * its coded pts, and ffmpeg either extends the previous frame's duration
+	 * or re-duplicates it, depending on the output sync mode. */
+	videopts++;
+}
+
 void NutMuxer::writeAudioFrame(const uint8_t* samples, int len)
 {
 	debuglog(LCF_DUMP, "Write nut audio frame");
@@ -307,6 +374,7 @@ void NutMuxer::writeAudioFrame(const uint8_t* samples, int len)
 }
 
 NutMuxer::NutMuxer(int width, int height, int fpsnum, int fpsden, const char* pixfmt, int samplerate, int samplesize, int channels, FILE *underlying)
+	: syncPacket(NutPacket::Syncpoint, underlying)
 {
 	avparams.width = width;
 	avparams.height = height;
@@ -322,6 +390,11 @@ NutMuxer::NutMuxer(int width, int height, int fpsnum, int fpsden, const char* pi
 	audiopts = 0;
 	videopts = 0;
 
+	/* Pre-size the reused buffers so even the first frames don't grow them */
+	syncPacket.data.reserve(32);
+	syncBuf.reserve(64);
+	frameHeaderBuf.reserve(64);
+
 	writeMainHeader();
 	writeVideoHeader();
 	writeAudioHeader();
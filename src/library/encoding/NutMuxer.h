@@ -44,6 +44,7 @@ public:
 	static unsigned int CRCtable[];
 
 	static unsigned int nutCRC32(const std::vector<uint8_t> &buf);
+	static unsigned int nutCRC32(const uint8_t* buf, size_t len);
 
 	class NutPacket {
     public:
@@ -64,6 +65,10 @@ public:
 		NutPacket(StartCode startcode, FILE *underlying);
 
 		void flush();
+		/* Append the complete packet (header, data, checksum) to a stream
+		 * instead of writing it out, so that it can be gathered with other
+		 * buffers into a single write */
+		void serialize(std::vector<uint8_t> &stream);
 		void write(const char* buffer, int count);
 	};
 
@@ -122,12 +127,22 @@ public:
 
     void writeVideoFrame(const uint8_t* video, int len);
 
+	/* Account for a video frame identical to the previous one, without
+	 * re-sending the raw frame to ffmpeg */
+	void repeatVideoFrame();
+
     void writeAudioFrame(const uint8_t* samples, int len);
 
 	NutMuxer(int width, int height, int fpsnum, int fpsden, const char* pixfmt, int samplerate, int samplesize, int channels, FILE *underlying);
 
 	void finish();
 
+private:
+	/* Serialization buffers reused across frames, so the per-frame muxing
+	 * path does not allocate */
+	NutPacket syncPacket;
+	std::vector<uint8_t> syncBuf;
+	std::vector<uint8_t> frameHeaderBuf;
 };
 }
 
@@ -26,6 +26,7 @@
 
 #include <cstdlib>
 #include <forward_list>
+#include <atomic>
 #include <mutex>
 #include <unistd.h> // lseek
 #include <sys/ioctl.h>
@@ -35,41 +36,72 @@ namespace libtas {
 
 namespace FileHandleList {
 
-/* This sounds really weird, but we are constructing our list of FileHandle
- * inside a function. This forces the list to be constructed when we need it
- * (a bit like the Singleton pattern). If we simply declare the list as a
+/* The registered file handles are stored in a flat table indexed by file
+ * descriptor, so that registering and unregistering a file is a single
+ * atomic slot access instead of a walk over a mutex-guarded list. The
+ * kernel hands out distinct descriptors, so two threads opening files
+ * concurrently touch distinct slots and never contend.
+ *
+ * This sounds really weird, but we are constructing our table inside a
+ * function. This forces the table to be constructed when we need it
+ * (a bit like the Singleton pattern). If we simply declare it as a
  * static variable, then we will be using it before it has time to be
  * constructed (because some other libraries will initialize and open some files),
  * resulting in a crash.
  */
-static std::forward_list<FileHandle>& getFileList() {
-    static std::forward_list<FileHandle> filehandles;
-    return filehandles;
+
+/* Table size: enough for the soft descriptor limit of typical systems.
+ * Larger descriptors (raised limit) fall back to the overflow list below. */
+#define FILEHANDLE_TABLESIZE 65536
+
+static std::atomic<FileHandle*>* getFileTable() {
+    static std::atomic<FileHandle*>* filetable = new std::atomic<FileHandle*>[FILEHANDLE_TABLESIZE]();
+    return filetable;
+}
+
+/* Highest descriptor ever registered, to bound the table scans done at
+ * checkpoint time. */
+static std::atomic<int> maxFd(-1);
+
+/* Overflow list for descriptors beyond the table, guarded by a mutex.
+ * Practically never used. */
+static std::forward_list<FileHandle>& getOverflowList() {
+    static std::forward_list<FileHandle> overflow;
+    return overflow;
 }
 
-/* Mutex to protect the file list */
-static std::mutex& getFileListMutex() {
+static std::mutex& getOverflowMutex() {
     static std::mutex mutex;
     return mutex;
 }
 
+static void updateMaxFd(int fd)
+{
+    int prev = maxFd.load(std::memory_order_relaxed);
+    while (prev < fd && !maxFd.compare_exchange_weak(prev, fd)) {}
+}
+
 void openFile(const char* file, int fd)
 {
     if (fd < 0)
         return;
 
-    std::lock_guard<std::mutex> lock(getFileListMutex());
-    auto& filehandles = getFileList();
+    if (fd >= FILEHANDLE_TABLESIZE) {
+        std::lock_guard<std::mutex> lock(getOverflowMutex());
+        getOverflowList().emplace_front(file, fd);
+        return;
+    }
 
     /* Check if we already registered the file */
-    for (const FileHandle &fh : filehandles) {
-        if (fh.fds[0] == fd) {
-            debuglogstdio(LCF_FILEIO | LCF_ERROR, "Opened file descriptor %d was already registered!", fd);
-            return;
-        }
+    std::atomic<FileHandle*>& slot = getFileTable()[fd];
+    if (slot.load(std::memory_order_relaxed) != nullptr) {
+        debuglogstdio(LCF_FILEIO | LCF_ERROR, "Opened file descriptor %d was already registered!", fd);
+        return;
     }
 
-    filehandles.emplace_front(file, fd);
+    /* The handle is fully built before being published in its slot */
+    slot.store(new FileHandle(file, fd), std::memory_order_release);
+    updateMaxFd(fd);
 }
 
 std::pair<int, int> createPipe(int flags) {
@@ -78,8 +110,17 @@ std::pair<int, int> createPipe(int flags) {
         return std::make_pair(-1, -1);
 
     fcntl(fds[1], F_SETFL, O_NONBLOCK);
-    std::lock_guard<std::mutex> lock(getFileListMutex());
-    getFileList().emplace_front(fds);
+
+    /* Pipes are indexed by their read end, like the old list which was only
+     * searched on fds[0]. */
+    if (fds[0] >= FILEHANDLE_TABLESIZE) {
+        std::lock_guard<std::mutex> lock(getOverflowMutex());
+        getOverflowList().emplace_front(fds);
+    }
+    else {
+        getFileTable()[fds[0]].store(new FileHandle(fds), std::memory_order_release);
+        updateMaxFd(fds[0]);
+    }
     return std::make_pair(fds[0], fds[1]);
 }
 
@@ -88,40 +129,80 @@ bool closeFile(int fd)
     if (fd < 0)
         return true;
 
-    std::lock_guard<std::mutex> lock(getFileListMutex());
-    auto& filehandles = getFileList();
-
-    /* Check if we track the file */
-    for (auto prev = filehandles.before_begin(), iter = filehandles.begin(); iter != filehandles.end(); prev = iter++) {
-        if (iter->fds[0] == fd) {
-            if (iter->tracked) {
-                /* Just mark the file as closed, and tells to not close the file */
-                iter->closed = true;
-                return false;
-            }
-            else {
+    if (fd >= FILEHANDLE_TABLESIZE) {
+        std::lock_guard<std::mutex> lock(getOverflowMutex());
+        auto& overflow = getOverflowList();
+        for (auto prev = overflow.before_begin(), iter = overflow.begin(); iter != overflow.end(); prev = iter++) {
+            if (iter->fds[0] == fd) {
+                if (iter->tracked) {
+                    iter->closed = true;
+                    return false;
+                }
                 if (!unref_evdev(iter->fds[0]) || !unref_jsdev(iter->fds[0])) {
                     return false;
                 }
                 if (iter->isPipe()) {
                     NATIVECALL(close(iter->fds[1]));
                 }
-                filehandles.erase_after(prev);
+                overflow.erase_after(prev);
                 return true;
             }
         }
+        debuglogstdio(LCF_FILEIO, "Unknown file descriptor %d", fd);
+        return true;
     }
 
-    debuglogstdio(LCF_FILEIO, "Unknown file descriptor %d", fd);
+    std::atomic<FileHandle*>& slot = getFileTable()[fd];
+    FileHandle* fh = slot.load(std::memory_order_acquire);
+
+    /* Check if we track the file */
+    if (fh == nullptr) {
+        debuglogstdio(LCF_FILEIO, "Unknown file descriptor %d", fd);
+        return true;
+    }
+
+    if (fh->tracked) {
+        /* Just mark the file as closed, and tells to not close the file */
+        fh->closed = true;
+        return false;
+    }
+
+    if (!unref_evdev(fh->fds[0]) || !unref_jsdev(fh->fds[0])) {
+        return false;
+    }
+    if (fh->isPipe()) {
+        NATIVECALL(close(fh->fds[1]));
+    }
+
+    /* Claim the slot: only the thread whose exchange returns the handle
+     * deletes it, so a racy double close cannot double free. */
+    fh = slot.exchange(nullptr);
+    delete fh;
     return true;
 }
 
+/* Call the given function on every registered handle. The scans below are
+ * only performed at checkpoint time, when all other threads are suspended,
+ * so no slot can concurrently appear or be deleted. */
+template <typename F>
+static void forAllFiles(F f)
+{
+    std::atomic<FileHandle*>* filetable = getFileTable();
+    int last = maxFd.load(std::memory_order_acquire);
+    for (int fd = 0; fd <= last; fd++) {
+        FileHandle* fh = filetable[fd].load(std::memory_order_acquire);
+        if (fh != nullptr)
+            f(*fh);
+    }
+
+    std::lock_guard<std::mutex> lock(getOverflowMutex());
+    for (FileHandle &fh : getOverflowList())
+        f(fh);
+}
 
 void trackAllFiles()
 {
-    std::lock_guard<std::mutex> lock(getFileListMutex());
-
-    for (FileHandle &fh : getFileList()) {
+    forAllFiles([](FileHandle &fh) {
         debuglogstdio(LCF_FILEIO, "Track file %s (fd=%d,%d)", fh.fileName(), fh.fds[0], fh.fds[1]);
         fh.tracked = true;
         /* Save the file offset */
@@ -143,23 +224,21 @@ void trackAllFiles()
                 debuglogstdio(LCF_FILEIO, "Save file offset: %d", fh.offset());
             }
         }
-    }
+    });
 }
 
 void recoverAllFiles()
 {
-    std::lock_guard<std::mutex> lock(getFileListMutex());
-
-    for (FileHandle &fh : getFileList()) {
+    forAllFiles([](FileHandle &fh) {
 
         if (! fh.tracked) {
             debuglogstdio(LCF_FILEIO | LCF_ERROR, "File %s (fd=%d,%d) not tracked when recovering", fh.fileName(), fh.fds[0], fh.fds[1]);
-            continue;
+            return;
         }
 
         /* Skip closed files */
         if (fh.closed) {
-            continue;
+            return;
         }
 
         int offset = fh.offset();
@@ -167,7 +246,7 @@ void recoverAllFiles()
         if (fh.isPipe()) {
             /* Only recover if we have valid contents */
             if (!fh.fileNameOrPipeContents || fh.pipeSize < 0) {
-                continue;
+                return;
             }
             ret = write(fh.fds[1], fh.fileNameOrPipeContents, fh.pipeSize);
             std::free(fh.fileNameOrPipeContents);
@@ -177,7 +256,7 @@ void recoverAllFiles()
         else {
             /* Only seek if we have a valid offset */
             if (fh.fileOffset == -1) {
-                continue;
+                return;
             }
 
             ret = lseek(fh.fds[0], fh.fileOffset, SEEK_SET);
@@ -190,24 +269,22 @@ void recoverAllFiles()
         else {
             debuglogstdio(LCF_FILEIO, "Restore file %s (fd=%d,%d) offset to %d", fh.fileName(), fh.fds[0], fh.fds[1], offset);
         }
-    }
+    });
 }
 
 void closeUntrackedFiles()
 {
-    std::lock_guard<std::mutex> lock(getFileListMutex());
-
-    for (FileHandle &fh : getFileList()) {
+    forAllFiles([](FileHandle &fh) {
         if (! fh.tracked) {
             NATIVECALL(close(fh.fds[0]));
             if (fh.isPipe())
                 NATIVECALL(close(fh.fds[1]));
-            /* We don't bother updating the file handle list, because it will be
-             * replaced with the list from the loaded savestate.
+            /* We don't bother updating the file handle table, because it will be
+             * replaced with the table from the loaded savestate.
              */
             debuglogstdio(LCF_FILEIO, "Close untracked file %s (fd=%d,%d)", fh.fileName(), fh.fds[0], fh.fds[1]);
         }
-    }
+    });
 }
 
 }
@@ -51,20 +51,8 @@ SaveFile::SaveFile(const char *file) {
 
 SaveFile::~SaveFile() {
     /* Save back data into the file */
-    if (shared_config.write_savefiles_on_exit && (fd != 0)) {
-        debuglogstdio(LCF_FILEIO, "Save back into file %s", filename.c_str());
-        GlobalNative gn;
-        lseek(fd, 0, SEEK_SET);
-        int file_fd = creat(filename.c_str(), 00777);
-        if (file_fd >= 0) {
-            char tmp_buf[4096];
-            ssize_t s;
-            do {
-                s = Utils::readAll(fd, tmp_buf, 4096);
-                Utils::writeAll(file_fd, tmp_buf, 4096);
-            } while(s > 0);
-            close(file_fd);
-        }
+    if (shared_config.write_savefiles_on_exit) {
+        writeBack();
     }
 
     if (stream) {
@@ -75,6 +63,45 @@ SaveFile::~SaveFile() {
     }
 }
 
+void SaveFile::writeBack() {
+    if (fd == 0)
+        return;
+
+    debuglogstdio(LCF_FILEIO, "Save back into file %s", filename.c_str());
+    GlobalNative gn;
+    off_t filesize = lseek(fd, 0, SEEK_END);
+    lseek(fd, 0, SEEK_SET);
+    int file_fd = creat(filename.c_str(), 00777);
+    if (file_fd >= 0) {
+        off_t copied = 0;
+
+#ifdef SYS_copy_file_range
+        /* Copy the memfd pages into the page cache of the real file
+         * entirely in kernel space, without round-tripping every block
+         * through a user buffer. Kernels without the syscall (or
+         * filesystems refusing it) fall through to the copy loop. */
+        while (copied < filesize) {
+            ssize_t s = syscall(SYS_copy_file_range, fd, nullptr, file_fd, nullptr, filesize - copied, 0);
+            if (s <= 0)
+                break;
+            copied += s;
+        }
+#endif
+
+        if (copied < filesize) {
+            lseek(fd, copied, SEEK_SET);
+            char tmp_buf[4096];
+            ssize_t s;
+            do {
+                s = Utils::readAll(fd, tmp_buf, 4096);
+                if (s > 0)
+                    Utils::writeAll(file_fd, tmp_buf, s);
+            } while(s > 0);
+        }
+        close(file_fd);
+    }
+}
+
 #define ISSLASH(c) ((c) == '/')
 
 char* SaveFile::canonicalizeFile(const char *file)
@@ -173,8 +200,9 @@ FILE* SaveFile::open(const char *modes) {
         return nullptr;
 
     /*
-     * Create a memory stream with a copy of the content of the file using
-     * open_memstream. Save the stream buffer and size.
+     * The savefile contents live in an anonymous memory file created with
+     * memfd_create (see open(int) below); we hand the game a stdio stream
+     * over that descriptor.
      */
 
     closed = false;
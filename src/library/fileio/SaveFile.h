@@ -56,6 +56,10 @@ public:
     /* Flag the file as closed */
     int closeFile();
 
+    /* Copy the current savefile contents into the real file on disk, as
+     * done on exit when write_savefiles_on_exit is set */
+    void writeBack();
+
     /* Remove a savefile and return 0 for success and -1 for error (+ errno set) */
     int remove();
 
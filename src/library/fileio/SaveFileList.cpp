@@ -30,6 +30,9 @@
 #include <forward_list>
 #include <memory>
 #include <cstring>
+#include <string>
+#include <atomic>
+#include <cstdint>
 #include <unistd.h>
 #include <algorithm> // remove_if
 
@@ -42,31 +45,117 @@ static std::forward_list<std::unique_ptr<SaveFile>>& getSaveFileList() {
     return savefiles;
 }
 
+/* Generation number of the savefile list, bumped on every insertion,
+ * removal or rename, to invalidate the classification caches below. */
+static std::atomic<unsigned int> savefile_gen(1);
+
+/* Classifying a path costs one canonicalization per registered savefile
+ * plus a stat() of the actual filesystem, and during asset streaming
+ * nearly every open is not a savefile and repeats the same paths. The
+ * mode-independent part of the decision is cached in a small per-thread
+ * direct-mapped table keyed on the raw path as passed by the game, so
+ * repeated opens classify without touching the list or the kernel.
+ */
+struct ClassifyCacheEntry {
+    std::string file;
+    unsigned int gen = 0;
+    bool in_list;
+    bool savefile;
+};
+
+#define CLASSIFY_CACHE_SIZE 64
+
+/* Fill in whether the path is a registered savefile, and whether it would
+ * qualify as a new savefile if opened writable (the result of the
+ * single-argument isSaveFile() below). */
+static void classifyFile(const char *file, bool &in_list, bool &savefile)
+{
+    static thread_local ClassifyCacheEntry classify_cache[CLASSIFY_CACHE_SIZE];
+
+    unsigned int gen = savefile_gen.load(std::memory_order_acquire);
+
+    /* FNV-1a hash of the raw path */
+    uint32_t hash = 2166136261u;
+    for (const char* c = file; *c; c++)
+        hash = (hash ^ static_cast<unsigned char>(*c)) * 16777619u;
+
+    ClassifyCacheEntry &entry = classify_cache[hash % CLASSIFY_CACHE_SIZE];
+    if ((entry.gen == gen) && (entry.file == file)) {
+        in_list = entry.in_list;
+        savefile = entry.savefile;
+        return;
+    }
+
+    /* Canonicalize the probed path once and compare it against the stored
+     * canonical names, instead of one canonicalization per entry. */
+    in_list = false;
+    char* canonfile = SaveFile::canonicalizeFile(file);
+    if (canonfile) {
+        for (const auto& sf : getSaveFileList()) {
+            if (sf->filename.compare(canonfile) == 0) {
+                in_list = true;
+                break;
+            }
+        }
+        free(canonfile);
+    }
+
+    savefile = in_list ? true : isSaveFile(file);
+
+    entry.file = file;
+    entry.gen = gen;
+    entry.in_list = in_list;
+    entry.savefile = savefile;
+}
+
 /* Check if the file open permission allows for write operation */
 bool isSaveFile(const char *file, const char *modes)
 {
-    const auto& savefiles = getSaveFileList();
-    for (const auto& savefile : savefiles) {
-        if (savefile->isSameFile(file)) {
-            return true;
+    if (!file)
+        return false;
+
+    /* When savefile prevention is off the classification depends on the
+     * current flag value, so bypass the cache (the list walk only matters
+     * for savefiles registered while the flag was on). */
+    if (!shared_config.prevent_savefiles) {
+        for (const auto& savefile : getSaveFileList()) {
+            if (savefile->isSameFile(file)) {
+                return true;
+            }
         }
+        return false;
     }
 
+    bool in_list, savefile;
+    classifyFile(file, in_list, savefile);
+    if (in_list)
+        return true;
+
     if (!(strstr(modes, "w") || strstr(modes, "a") || strstr(modes, "+")))
         return false;
 
-    return isSaveFile(file);
+    return savefile;
 }
 
 bool isSaveFile(const char *file, int oflag)
 {
-    const auto& savefiles = getSaveFileList();
-    for (const auto& savefile : savefiles) {
-        if (savefile->isSameFile(file)) {
-            return true;
+    if (!file)
+        return false;
+
+    if (!shared_config.prevent_savefiles) {
+        for (const auto& savefile : getSaveFileList()) {
+            if (savefile->isSameFile(file)) {
+                return true;
+            }
         }
+        return false;
     }
 
+    bool in_list, savefile;
+    classifyFile(file, in_list, savefile);
+    if (in_list)
+        return true;
+
     if ((oflag & 0x3) == O_RDONLY)
         return false;
 
@@ -77,7 +166,7 @@ bool isSaveFile(const char *file, int oflag)
     if (oflag & O_CLOEXEC)
         return false;
 
-    return isSaveFile(file);
+    return savefile;
 }
 
 /* Detect save files (excluding the writeable flag), basically if the file is regular */
@@ -132,6 +221,7 @@ FILE *openSaveFile(const char *file, const char *modes)
     }
 
     savefiles.emplace_front(new SaveFile(file));
+    savefile_gen.fetch_add(1, std::memory_order_release);
     return savefiles.front()->open(modes);
 }
 
@@ -145,6 +235,7 @@ int openSaveFile(const char *file, int oflag)
     }
 
     savefiles.emplace_front(new SaveFile(file));
+    savefile_gen.fetch_add(1, std::memory_order_release);
     return savefiles.front()->open(oflag);
 }
 
@@ -184,6 +275,7 @@ int removeSaveFile(const char *file)
     /* If the file is not registered, create a removed savefile */
     if (shared_config.prevent_savefiles) {
         savefiles.emplace_front(new SaveFile(file));
+        savefile_gen.fetch_add(1, std::memory_order_release);
         savefiles.front()->remove();
 
         GlobalNative gn;
@@ -204,10 +296,12 @@ int renameSaveFile(const char *oldfile, const char *newfile)
     /* Remove the newfile if present */
     auto& savefiles = getSaveFileList();
     savefiles.remove_if([newfile](const std::unique_ptr<SaveFile>& s) { return (s->isSameFile(newfile));});
+    savefile_gen.fetch_add(1, std::memory_order_release);
 
     for (const auto& savefile : savefiles) {
         if (savefile->isSameFile(oldfile)) {
             savefile->filename = newfilestr;
+            savefile_gen.fetch_add(1, std::memory_order_release);
             return 0;
         }
     }
@@ -215,6 +309,7 @@ int renameSaveFile(const char *oldfile, const char *newfile)
     /* If the file is not registered, create a savefile */
     if (shared_config.prevent_savefiles) {
         savefiles.emplace_front(new SaveFile(oldfile));
+        savefile_gen.fetch_add(1, std::memory_order_release);
         savefiles.front()->open("rb");
         savefiles.front()->filename = newfilestr;
 
@@ -249,6 +344,14 @@ bool isSaveFileRemoved(const char *file)
     return true;
 }
 
+void writeBackSaveFiles()
+{
+    auto& savefiles = getSaveFileList();
+    for (const auto& savefile : savefiles) {
+        savefile->writeBack();
+    }
+}
+
 
 }
 
@@ -24,6 +24,14 @@
 
 namespace libtas {
 
+/* Intercepted savefiles live in anonymous memory files (see SaveFile) that
+ * sit outside the game address space, so taking a savestate never copies
+ * their contents: every savestate slot shares the single live memfd, and
+ * only the descriptor offsets are saved and restored (FileHandleList).
+ * The flip side is that loading a state does not roll savefile contents
+ * back; snapshotting them per slot would require capturing the memfd
+ * contents at checkpoint time and restoring them on load.
+ */
 namespace SaveFileList {
 
 /* Is the file considered a savefile? */
@@ -60,6 +68,11 @@ int getSaveFileFd(const char *file);
 /* Get if savefile was removed */
 bool isSaveFileRemoved(const char *file);
 
+/* Write every savefile back to disk, as an exiting game would. Called
+ * before an in-place (zygote) restart so the rebooted game finds its
+ * savefiles on disk like a relaunched process would */
+void writeBackSaveFiles();
+
 }
 
 }
@@ -22,6 +22,7 @@
 #include "../logging.h"
 #include "../hook.h"
 #include "SaveFileList.h"
+#include "posixiowrappers.h"
 #include "../GlobalState.h"
 
 namespace libtas {
@@ -42,10 +43,15 @@ int rename (const char *oldf, const char *newf) throw()
     /* Check if file is a savefile */
     int ret = SaveFileList::renameSaveFile(oldf, newf);
     if (ret != 1) {
+        if (ret == 0)
+            invalidateNegativeFileCache(newf);
         return ret;
     }
 
-    return orig::rename(oldf, newf);
+    ret = orig::rename(oldf, newf);
+    if (ret == 0)
+        invalidateNegativeFileCache(newf);
+    return ret;
 }
 
 /* Remove file FILENAME.  */
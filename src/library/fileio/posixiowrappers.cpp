@@ -32,9 +32,70 @@
 #include <errno.h>
 #include <cstdarg>
 #include <cstring>
+#include <set>
+#include <string>
+#include <mutex>
 
 namespace libtas {
 
+/* Negative-lookup cache, enabled with shared_config.cache_file_metadata.
+ * Games probe for files with storms of open/stat/access calls failing with
+ * ENOENT at startup; once a path failed, later probes are answered from
+ * memory without a syscall. Entries are evicted when a wrapper creates the
+ * file (O_CREAT open, creat, rename target), so the cache only goes stale
+ * if something outside the game creates files in the probed directories
+ * mid-run, which the option rules out. Only absolute paths are cached, to
+ * avoid keying relative openat lookups on a directory descriptor. A path
+ * cached from stat() on a dangling symlink is also answered ENOENT for
+ * lstat(), so the cache treats such symlinks as absent.
+ */
+static std::set<std::string>& getNegativeFileCache() {
+    static std::set<std::string> negativecache;
+    return negativecache;
+}
+
+static std::mutex& getNegativeFileCacheMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+static bool isNegativeCached(const char* file)
+{
+    if (!shared_config.cache_file_metadata)
+        return false;
+    if (!file || file[0] != '/')
+        return false;
+
+    std::lock_guard<std::mutex> lock(getNegativeFileCacheMutex());
+    return getNegativeFileCache().count(file) != 0;
+}
+
+/* Record a failed lookup. Must be called right after the original function
+ * failed, so that errno still holds the failure cause. */
+static void cacheNegativeFile(const char* file)
+{
+    if (!shared_config.cache_file_metadata)
+        return;
+    if (errno != ENOENT)
+        return;
+    if (!file || file[0] != '/')
+        return;
+
+    std::lock_guard<std::mutex> lock(getNegativeFileCacheMutex());
+    getNegativeFileCache().insert(file);
+}
+
+void invalidateNegativeFileCache(const char* file)
+{
+    if (!shared_config.cache_file_metadata)
+        return;
+    if (!file || file[0] != '/')
+        return;
+
+    std::lock_guard<std::mutex> lock(getNegativeFileCacheMutex());
+    getNegativeFileCache().erase(file);
+}
+
 DEFINE_ORIG_POINTER(open)
 DEFINE_ORIG_POINTER(open64)
 DEFINE_ORIG_POINTER(openat)
@@ -84,8 +145,18 @@ int open (const char *file, int oflag, ...)
         return SaveFileList::openSaveFile(file, oflag);
     }
 
+    if (!(oflag & O_CREAT) && isNegativeCached(file)) {
+        errno = ENOENT;
+        return -1;
+    }
+
     int fd = orig::open(file, oflag, mode);
 
+    if (fd < 0)
+        cacheNegativeFile(file);
+    else if (oflag & O_CREAT)
+        invalidateNegativeFileCache(file);
+
     /* Store the file descriptor */
     FileHandleList::openFile(file, fd);
 
@@ -125,8 +196,18 @@ int open64 (const char *file, int oflag, ...)
         return SaveFileList::openSaveFile(file, oflag);
     }
 
+    if (!(oflag & O_CREAT) && isNegativeCached(file)) {
+        errno = ENOENT;
+        return -1;
+    }
+
     int fd = orig::open64(file, oflag, mode);
 
+    if (fd < 0)
+        cacheNegativeFile(file);
+    else if (oflag & O_CREAT)
+        invalidateNegativeFileCache(file);
+
     /* Store the file descriptor */
     FileHandleList::openFile(file, fd);
 
@@ -157,8 +238,19 @@ int openat (int dirfd, const char *file, int oflag, ...)
         return SaveFileList::openSaveFile(file, oflag);
     }
 
+    /* Absolute paths ignore dirfd, so they can use the lookup cache */
+    if (!(oflag & O_CREAT) && isNegativeCached(file)) {
+        errno = ENOENT;
+        return -1;
+    }
+
     int fd = orig::openat(dirfd, file, oflag, mode);
 
+    if (fd < 0)
+        cacheNegativeFile(file);
+    else if (oflag & O_CREAT)
+        invalidateNegativeFileCache(file);
+
     /* Store the file descriptor */
     FileHandleList::openFile(file, fd);
 
@@ -189,8 +281,19 @@ int openat64 (int dirfd, const char *file, int oflag, ...)
         return SaveFileList::openSaveFile(file, oflag);
     }
 
+    /* Absolute paths ignore dirfd, so they can use the lookup cache */
+    if (!(oflag & O_CREAT) && isNegativeCached(file)) {
+        errno = ENOENT;
+        return -1;
+    }
+
     int fd = orig::openat64(dirfd, file, oflag, mode);
 
+    if (fd < 0)
+        cacheNegativeFile(file);
+    else if (oflag & O_CREAT)
+        invalidateNegativeFileCache(file);
+
     /* Store the file descriptor */
     FileHandleList::openFile(file, fd);
 
@@ -218,6 +321,9 @@ int creat (const char *file, mode_t mode)
 
     int fd = orig::creat(file, mode);
 
+    if (fd >= 0)
+        invalidateNegativeFileCache(file);
+
     /* Store the file descriptor */
     FileHandleList::openFile(file, fd);
 
@@ -242,6 +348,9 @@ int creat64 (const char *file, mode_t mode)
 
     int fd = orig::creat64(file, mode);
 
+    if (fd >= 0)
+        invalidateNegativeFileCache(file);
+
     /* Store the file descriptor */
     FileHandleList::openFile(file, fd);
 
@@ -304,7 +413,15 @@ int access(const char *name, int type) throw()
         }
     }
 
-    return orig::access(name, type);
+    if (isNegativeCached(name)) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    int ret = orig::access(name, type);
+    if (ret < 0)
+        cacheNegativeFile(name);
+    return ret;
 }
 
 int __xstat(int ver, const char *path, struct stat *buf) throw()
@@ -342,7 +459,15 @@ int __xstat(int ver, const char *path, struct stat *buf) throw()
         }
     }
 
-    return orig::__xstat(ver, path, buf);
+    if (isNegativeCached(path)) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    int ret = orig::__xstat(ver, path, buf);
+    if (ret < 0)
+        cacheNegativeFile(path);
+    return ret;
 }
 
 int __xstat64(int ver, const char *path, struct stat64 *buf) throw()
@@ -380,7 +505,15 @@ int __xstat64(int ver, const char *path, struct stat64 *buf) throw()
         }
     }
 
-    return orig::__xstat64(ver, path, buf);
+    if (isNegativeCached(path)) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    int ret = orig::__xstat64(ver, path, buf);
+    if (ret < 0)
+        cacheNegativeFile(path);
+    return ret;
 }
 
 int __lxstat(int ver, const char *path, struct stat *buf) throw()
@@ -418,7 +551,15 @@ int __lxstat(int ver, const char *path, struct stat *buf) throw()
         }
     }
 
-    return orig::__lxstat(ver, path, buf);
+    if (isNegativeCached(path)) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    int ret = orig::__lxstat(ver, path, buf);
+    if (ret < 0)
+        cacheNegativeFile(path);
+    return ret;
 }
 
 int __lxstat64(int ver, const char *path, struct stat64 *buf) throw()
@@ -456,7 +597,15 @@ int __lxstat64(int ver, const char *path, struct stat64 *buf) throw()
         }
     }
 
-    return orig::__lxstat64(ver, path, buf);
+    if (isNegativeCached(path)) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    int ret = orig::__lxstat64(ver, path, buf);
+    if (ret < 0)
+        cacheNegativeFile(path);
+    return ret;
 }
 
 int __fxstat(int ver, int fd, struct stat *buf) throw()
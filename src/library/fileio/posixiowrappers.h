@@ -67,6 +67,10 @@ OVERRIDE int __fxstat64(int ver, int fd, struct stat64 *buf) throw();
 /* Duplicate FD to FD2, closing FD2 and making it open on the same file.  */
 OVERRIDE int dup2 (int fd, int fd2) throw();
 
+/* Drop FILE from the negative-lookup cache, because a wrapper created it
+ * (e.g. the target of a rename). No-op when the cache is disabled. */
+void invalidateNegativeFileCache(const char *file);
+
 }
 
 #endif
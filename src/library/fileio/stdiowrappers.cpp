@@ -24,6 +24,8 @@
 #include "SaveFileList.h"
 #include "FileHandleList.h"
 #include "../GlobalState.h"
+#include <cstring> // strchr
+#include <fcntl.h> // posix_fadvise
 
 namespace libtas {
 
@@ -32,6 +34,22 @@ DEFINE_ORIG_POINTER(fopen64)
 DEFINE_ORIG_POINTER(fclose)
 // DEFINE_ORIG_POINTER(fileno)
 
+/* Games streaming assets through fread pay one syscall per 4 kB with the
+ * default stdio buffer. For plain read-only game streams, enlarge the
+ * buffer and advise the kernel of sequential access, which helps a lot
+ * when the game files live on slow or remote storage. fread itself is not
+ * hooked, so this is done up front at fopen time rather than by detecting
+ * the access pattern later. Both calls are advisory for correctness: they
+ * change neither the stream content nor its position. */
+static void adviseGameStream(FILE* f, const char* modes)
+{
+    if (!modes || modes[0] != 'r' || strchr(modes, '+'))
+        return;
+
+    setvbuf(f, nullptr, _IOFBF, 256*1024);
+    posix_fadvise(fileno(f), 0, 0, POSIX_FADV_SEQUENTIAL);
+}
+
 FILE *fopen (const char *filename, const char *modes)
 {
     LINK_NAMESPACE_GLOBAL(fopen);
@@ -58,6 +76,9 @@ FILE *fopen (const char *filename, const char *modes)
     /* Store the file descriptor */
     if (f) {
         FileHandleList::openFile(filename, fileno(f));
+
+        if (!GlobalState::isOwnCode())
+            adviseGameStream(f, modes);
     }
 
     return f;
@@ -85,6 +106,9 @@ FILE *fopen64 (const char *filename, const char *modes)
     /* Store the file descriptor */
     if (f) {
         FileHandleList::openFile(filename, fileno(f));
+
+        if (!GlobalState::isOwnCode())
+            adviseGameStream(f, modes);
     }
 
     return f;
@@ -23,20 +23,32 @@
 #include "global.h" // shared_config
 #include "inputs/inputs.h" // AllInputs ai object
 #include "inputs/inputevents.h"
+#include "inputs/sdlkeyboard.h" // updateKeyboardState
 #include "../shared/sockethelpers.h"
 #include "logging.h"
 #include "DeterministicTimer.h"
+#include "NonDeterministicTimer.h"
+#include "fileio/SaveFileList.h"
 #include "encoding/AVEncoder.h"
 #include "sdlwindows.h"
 #include "sdlevents.h"
 #include <iomanip>
+#include <vector>
 #include "timewrappers.h" // clock_gettime
 #include "checkpoint/ThreadManager.h"
 #include "checkpoint/Checkpoint.h"
 #include "ScreenCapture.h"
+#include "StallSampler.h"
+#include "ScreenPreview.h"
+#include "SlotInfo.h"
+#include "openglwrappers.h" // setDrawSkipping
 #include "WindowTitle.h"
 #include "SDLEventQueue.h"
 #include "xevents.h"
+#include "FrameTrace.h"
+#include "AllocTrace.h"
+#include "StateDigest.h"
+#include "steam/isteamremotestorage.h" // SteamRemoteStorage_Flush
 
 namespace libtas {
 
@@ -49,6 +61,27 @@ static unsigned long nondraw_framecount = 0;
 /* Did we do at least one savestate? */
 static bool didASavestate = false;
 
+/* Inputs streamed in advance by the program during replay. While this
+ * list covers the current frame, the frame boundary consumes the inputs
+ * locally and skips the blocking exchange with the program (free-run),
+ * saving a socket round trip per frame. */
+static std::vector<AllInputs> prefetch_inputs;
+static uint64_t prefetch_start = 0;
+
+/* Inputs of the last MSGN_ALL_INPUTS(_DELTA) message, the reference the
+ * delta-encoded input messages are decoded against. Kept apart from the
+ * live inputs, which the prefetched batches overwrite. */
+static AllInputs delta_ref_ai;
+
+/* Whether the last frame boundary was a free-run one, so the program
+ * must be told when we drop back to answering boundaries */
+static bool freerunning = false;
+
+/* CLOCK_MONOTONIC timestamp of the last input application, sent to the
+ * program at the next boundary for its end-to-end input latency
+ * measurement */
+static uint64_t input_apply_ns = 0;
+
 #ifdef LIBTAS_ENABLE_HUD
 static void receive_messages(std::function<void()> draw, RenderHUD& hud);
 #else
@@ -195,6 +228,10 @@ void frameBoundary(bool drawFB, std::function<void()> draw, bool restore_screen)
         return;
     }
 
+    /* Arm the stall watchdog, so that a boundary hitching on the encoder,
+     * a checkpoint or a stuck wait gets its stacks sampled */
+    StallSampler::arm();
+
     /*** Update time ***/
 
     /* First, increase the frame count */
@@ -208,10 +245,37 @@ void frameBoundary(bool drawFB, std::function<void()> draw, bool restore_screen)
     /* Update the deterministic timer, sleep if necessary and mix audio */
     detTimer.enterFrameBoundary();
 
+    /* Write back Steam remote-storage files modified during the frame */
+    SteamRemoteStorage_Flush();
+
+    /* Free-run: if the inputs streamed in advance by the program cover
+     * this frame, they are consumed locally and the blocking exchange
+     * below is skipped. While we free-run the program sends nothing but
+     * a batch invalidation (after an input edit, a hotkey or any state
+     * change), so poll for it without blocking. */
+    bool freerun = false;
+    if (!prefetch_inputs.empty()) {
+        int pending = pollMessage();
+        if (pending == MSGN_INPUT_BATCH_INVALIDATE) {
+            prefetch_inputs.clear();
+        }
+        else if (pending != -1) {
+            debuglog(LCF_ERROR | LCF_SOCKET, "Unexpected message during free-run ", pending);
+            prefetch_inputs.clear();
+        }
+        else if ((framecount >= prefetch_start) &&
+                 (framecount < prefetch_start + prefetch_inputs.size())) {
+            freerun = true;
+        }
+    }
+
     /* Send information to the game and notify for the beginning of the frame
      * boundary.
      */
 
+    /* Batch all the start-of-frame messages into a single socket write */
+    beginSendBatch();
+
     /* Send error messages */
     std::string alert;
     while (getAlertMsg(alert)) {
@@ -237,6 +301,28 @@ void frameBoundary(bool drawFB, std::function<void()> draw, bool restore_screen)
     sendData(&fps, sizeof(float));
     sendData(&lfps, sizeof(float));
 
+    /* Send the timestamp of the input application of the elapsed frame,
+     * for the end-to-end input latency measurement of the program */
+    if (input_apply_ns) {
+        sendMessage(MSGB_INPUT_APPLIED);
+        sendData(&input_apply_ns, sizeof(uint64_t));
+    }
+
+    /* Account for this frame, and ship the aggregated timing spans about
+     * once per second as part of this batch */
+    FrameTrace::frameDone();
+
+    /* Same for the aggregated allocation samples */
+    AllocTrace::frameDone();
+
+    /* Send the sampled state digest, for recording in the movie or checking
+     * against recorded digests */
+    if (shared_config.state_digest) {
+        uint64_t digest = StateDigest::compute(framecount);
+        sendMessage(MSGB_STATE_DIGEST);
+        sendData(&digest, sizeof(uint64_t));
+    }
+
     /* Ask the program to perform a backtrack savestate */
     if (saveBacktrack) {
         /* Only save a backtrack savestate if we did at least one savestate.
@@ -249,21 +335,47 @@ void frameBoundary(bool drawFB, std::function<void()> draw, bool restore_screen)
         saveBacktrack = false;
     }
 
+    /* Tell the program we dropped out of free-run and answer boundaries
+     * again, so it resumes sending the per-boundary messages */
+    if (freerunning && !freerun) {
+        sendMessage(MSGB_LOCKSTEP);
+        prefetch_inputs.clear();
+    }
+    freerunning = freerun;
+
     /* Last message to send */
     sendMessage(MSGB_START_FRAMEBOUNDARY);
 
+    endSendBatch();
+
+    if (freerun) {
+        /* Consume the prefetched inputs of this frame. The program still
+         * receives the boundary batch above, so the frame count, time and
+         * stats on its side stay current. */
+        *pendingInputs() = prefetch_inputs[framecount - prefetch_start];
+        publishInputs();
+    }
+    else {
 #ifdef LIBTAS_ENABLE_HUD
-    /* Get ramwatches from the program */
-    RenderHUD::resetWatches();
+        /* Get ramwatches from the program */
+        RenderHUD::resetWatches();
 #endif
 
-    int message = receiveMessage();
-    while (message == MSGN_RAMWATCH) {
-        std::string ramwatch = receiveString();
+        int message = receiveMessage();
+        while ((message == MSGN_RAMWATCH) || (message == MSGN_INPUT_BATCH_INVALIDATE)) {
+            /* An invalidation may race our drop out of free-run, it is
+             * then received here instead of the poll above */
+            if (message == MSGN_INPUT_BATCH_INVALIDATE) {
+                prefetch_inputs.clear();
+                message = receiveMessage();
+                continue;
+            }
+            std::string ramwatch = receiveString();
 #ifdef LIBTAS_ENABLE_HUD
-        RenderHUD::insertWatch(ramwatch);
+            RenderHUD::insertWatch(ramwatch);
 #endif
-        message = receiveMessage();
+            message = receiveMessage();
+        }
     }
 
     /*** Rendering ***/
@@ -279,25 +391,51 @@ void frameBoundary(bool drawFB, std::function<void()> draw, bool restore_screen)
      */
     if (!skipping_draw) {
         if (drawFB && shared_config.save_screenpixels) {
+            FrameTrace::begin(FrameTimeStats::SPAN_CAPTURE);
             ScreenCapture::storePixels();
+            FrameTrace::end(FrameTimeStats::SPAN_CAPTURE);
+
+            /* Publish a downscaled frame into the shared-memory preview
+             * buffer, while the preview pane of the program is open */
+            if (shared_config.screen_preview)
+                ScreenPreview::publish(framecount);
         }
     }
 
+    /* Whether the HUD was burned into the stored frame on the CPU, so
+     * the encoder must not fetch the screen pixels again */
+    bool hud_composited = false;
+
 #ifdef LIBTAS_ENABLE_HUD
     if (!skipping_draw && shared_config.osd_encode) {
+        FrameTrace::begin(FrameTimeStats::SPAN_HUD);
+
+        /* While dumping, composite the HUD into the captured frame on the
+         * CPU instead of drawing it with the rendering API. The blend of
+         * a few small text surfaces is much cheaper than a HUD draw pass
+         * plus the second full-frame readback the encoder would need, at
+         * the cost of the HUD not showing in the game window during the
+         * dump. Non-draw frames are repeated by the encoder anyway. */
+        if (shared_config.av_dumping && drawFB && ScreenCapture::isInited())
+            hud_composited = hud.setCompositeTarget();
+
         hud.resetOffsets();
         if (shared_config.osd & SharedConfig::OSD_FRAMECOUNT) {
             hud.renderFrame(framecount);
             // hud.renderNonDrawFrame(nondraw_framecount);
         }
         if (shared_config.osd & SharedConfig::OSD_INPUTS)
-            hud.renderInputs(ai);
+            hud.renderInputs(*ai);
 
         if (shared_config.osd & SharedConfig::OSD_MESSAGES)
             hud.renderMessages();
 
         if (shared_config.osd & SharedConfig::OSD_RAMWATCHES)
             hud.renderWatches();
+
+        if (hud_composited)
+            hud.clearCompositeTarget();
+        FrameTrace::end(FrameTimeStats::SPAN_HUD);
     }
 #endif
 
@@ -312,7 +450,9 @@ void frameBoundary(bool drawFB, std::function<void()> draw, bool restore_screen)
         }
 
         /* Write the current frame */
-        avencoder->encodeOneFrame(drawFB);
+        FrameTrace::begin(FrameTimeStats::SPAN_ENCODE);
+        avencoder->encodeOneFrame(drawFB, hud_composited);
+        FrameTrace::end(FrameTimeStats::SPAN_ENCODE);
     }
     else {
         /* If there is still an encoder object, it means we just stopped
@@ -322,38 +462,91 @@ void frameBoundary(bool drawFB, std::function<void()> draw, bool restore_screen)
             debuglog(LCF_DUMP, "Stop AV dumping");
             avencoder.reset(nullptr);
         }
+
+        /* Collect encoders finishing in the background. Cheap when none
+         * are pending */
+        AVEncoder::reapPending();
     }
 
 #ifdef LIBTAS_ENABLE_HUD
     if (!skipping_draw && !shared_config.osd_encode) {
+        FrameTrace::begin(FrameTimeStats::SPAN_HUD);
         hud.resetOffsets();
         if (shared_config.osd & SharedConfig::OSD_FRAMECOUNT) {
             hud.renderFrame(framecount);
             // hud.renderNonDrawFrame(nondraw_framecount);
         }
         if (shared_config.osd & SharedConfig::OSD_INPUTS)
-            hud.renderInputs(ai);
+            hud.renderInputs(*ai);
 
         if (shared_config.osd & SharedConfig::OSD_MESSAGES)
             hud.renderMessages();
 
         if (shared_config.osd & SharedConfig::OSD_RAMWATCHES)
             hud.renderWatches();
+        FrameTrace::end(FrameTimeStats::SPAN_HUD);
     }
 #endif
 
     /* Actual draw command */
     if (!skipping_draw) {
         GlobalNoLog gnl;
+        FrameTrace::begin(FrameTimeStats::SPAN_DRAW);
         NATIVECALL(draw());
+        FrameTrace::end(FrameTimeStats::SPAN_DRAW);
     }
 
-    /* Receive messages from the program */
-    #ifdef LIBTAS_ENABLE_HUD
-        receive_messages(draw, hud);
-    #else
-        receive_messages(draw);
-    #endif
+    /* Save a state in the rewind ring buffer, so that the program can step
+     * back one frame almost instantly. Thanks to incremental savestates, each
+     * ring state only stores the pages modified during the last frame.
+     */
+    if (shared_config.rewind_savestates && shared_config.savestates_in_ram &&
+        shared_config.incremental_savestates) {
+        Checkpoint::setRewindSaveIndex();
+        ThreadManager::checkpoint();
+
+        /* Current savestate is now the parent savestate */
+        Checkpoint::setCurrentToParent();
+
+        /* We did at least one savestate, used for backtrack savestate */
+        didASavestate = true;
+
+        /* If a rewind state was loaded, the game resumes from here. We must
+         * sync with the program exactly like a regular savestate loading
+         * (see MSGN_SAVESTATE below).
+         */
+        if (ThreadManager::restoreInProgress) {
+            /* The restored memory may hold the prefetched inputs of the
+             * captured frame, which are stale now */
+            prefetch_inputs.clear();
+            freerunning = false;
+
+            sendMessage(MSGB_LOADING_SUCCEEDED);
+
+            int message = receiveMessage();
+            MYASSERT(message == MSGN_CONFIG)
+            receiveData(&shared_config, sizeof(SharedConfig));
+
+            sendMessage(MSGB_FRAMECOUNT_TIME);
+            sendData(&framecount, sizeof(unsigned long));
+            struct timespec rewind_ticks = detTimer.getTicks();
+            sendData(&rewind_ticks, sizeof(struct timespec));
+
+            ScreenCapture::setPixels();
+        }
+    }
+
+    /* Receive messages from the program, unless we free-run on the
+     * prefetched inputs consumed above */
+    if (!freerun) {
+        FrameTrace::begin(FrameTimeStats::SPAN_WAIT);
+        #ifdef LIBTAS_ENABLE_HUD
+            receive_messages(draw, hud);
+        #else
+            receive_messages(draw);
+        #endif
+        FrameTrace::end(FrameTimeStats::SPAN_WAIT);
+    }
 
     /* Some methods of drawing on screen don't always update the full screen.
      * Our current screen may be dirty with OSD, so in that case, we must
@@ -386,6 +579,10 @@ void frameBoundary(bool drawFB, std::function<void()> draw, bool restore_screen)
      * because they used the new game inputs. */
     updateGameInputs();
 
+    /* Refresh the emulated SDL keyboard state arrays, so that the polling
+     * functions have no per-call work. */
+    updateKeyboardState();
+
     /* Push generated events. This must be done after getting the new inputs. */
     if (!(shared_config.debug_state & SharedConfig::DEBUG_NATIVE_EVENTS)) {
         generateKeyUpEvents();
@@ -397,6 +594,14 @@ void frameBoundary(bool drawFB, std::function<void()> draw, bool restore_screen)
         generateMouseButtonEvents();
     }
 
+    /* Timestamp the input application with the clock the program also
+     * reads, so it can cut its latency samples at this stage */
+    {
+        struct timespec apply_ts;
+        NATIVECALL(clock_gettime(CLOCK_MONOTONIC, &apply_ts));
+        input_apply_ns = apply_ts.tv_sec * UINT64_C(1000000000) + apply_ts.tv_nsec;
+    }
+
     syncEvents();
 
     /* Decide if we skip drawing the next frame because of fastforward.
@@ -404,7 +609,13 @@ void frameBoundary(bool drawFB, std::function<void()> draw, bool restore_screen)
      */
     skipping_draw = skipDraw(fps);
 
+    /* Swap the opengl draw dispatch so that the wrappers don't test the
+     * flag on every call. */
+    setDrawSkipping(skipping_draw);
+
     detTimer.exitFrameBoundary();
+
+    StallSampler::disarm();
 }
 
 static void pushQuitEvent(void)
@@ -457,7 +668,7 @@ static void screen_redraw(std::function<void()> draw, AllInputs preview_ai)
             // hud.renderNonDrawFrame(nondraw_framecount);
         }
         if (shared_config.osd & SharedConfig::OSD_INPUTS) {
-            hud.renderInputs(ai);
+            hud.renderInputs(*ai);
             hud.renderPreviewInputs(preview_ai);
         }
 
@@ -507,7 +718,35 @@ static void receive_messages(std::function<void()> draw)
                 break;
 
             case MSGN_ALL_INPUTS:
-                receiveData(&ai, sizeof(AllInputs));
+                /* Receive into the pending slot and swap it in, so a game
+                 * thread polling inputs never reads a half-received struct */
+                receiveData(pendingInputs(), sizeof(AllInputs));
+                delta_ref_ai = *pendingInputs();
+                publishInputs();
+                break;
+
+            case MSGN_ALL_INPUTS_DELTA:
+                *pendingInputs() = delta_ref_ai;
+                pendingInputs()->receiveDelta();
+                delta_ref_ai = *pendingInputs();
+                publishInputs();
+                break;
+
+            case MSGN_INPUT_BATCH:
+                /* Inputs streamed in advance for the upcoming replay
+                 * frames, consumed at the next frame boundaries without
+                 * an exchange with the program (free-run) */
+                receiveData(&prefetch_start, sizeof(uint64_t));
+                {
+                    uint64_t count;
+                    receiveData(&count, sizeof(uint64_t));
+                    prefetch_inputs.resize(count);
+                    receiveData(prefetch_inputs.data(), count * sizeof(AllInputs));
+                }
+                break;
+
+            case MSGN_INPUT_BATCH_INVALIDATE:
+                prefetch_inputs.clear();
                 break;
 
             case MSGN_EXPOSE:
@@ -533,6 +772,10 @@ static void receive_messages(std::function<void()> draw)
                 Checkpoint::setSavestatePath(savestatepath);
                 break;
 
+            case MSGN_SAVESTATE_IGNORE:
+                Checkpoint::setIgnorePatterns(receiveString());
+                break;
+
             case MSGN_SAVESTATE_INDEX:
                 /* Get the savestate index */
                 receiveData(&index, sizeof(int));
@@ -548,12 +791,23 @@ static void receive_messages(std::function<void()> draw)
                 /* We did at least one savestate, used for backtrack savestate */
                 didASavestate = true;
 
+                /* Publish the slot information and thumbnail of a state
+                 * saved into a numbered slot. Not done when resuming from
+                 * a state loading, which also lands here. */
+                if (!ThreadManager::restoreInProgress)
+                    SlotInfo::publish(Checkpoint::getSavestateIndex(), framecount);
+
                 /* Don't forget that when we load a savestate, the game continues
                  * from here and not from ThreadManager::restore() under.
                  * To check if we did restored or returned from a checkpoint,
                  * we look at variable ThreadManager::restoreInProgress.
                  */
                 if (ThreadManager::restoreInProgress) {
+                    /* The restored memory may hold the prefetched inputs
+                     * of the captured frame, which are stale now */
+                    prefetch_inputs.clear();
+                    freerunning = false;
+
                     /* Tell the program that the loading succeeded */
                     sendMessage(MSGB_LOADING_SUCCEEDED);
 
@@ -562,11 +816,28 @@ static void receive_messages(std::function<void()> draw)
                      * synced again.
                      */
 
-                    /* We receive the shared config struct */
+                    /* We receive the shared config struct. For an in-place
+                     * (zygote) restart, the config is preceded by a marker
+                     * message. */
                     message = receiveMessage();
+                    bool zygote_restarted = (message == MSGN_ZYGOTE_RESTART);
+                    if (zygote_restarted)
+                        message = receiveMessage();
                     MYASSERT(message == MSGN_CONFIG)
                     receiveData(&shared_config, sizeof(SharedConfig));
 
+                    if (zygote_restarted) {
+                        /* We resumed into the pristine boot state, but the
+                         * game should continue the movie rather than rewind
+                         * it. Re-run the boot-time initialization: the
+                         * program sent the current frame count and time as
+                         * the initial ones, like it does on a real restart.
+                         */
+                        framecount = shared_config.initial_framecount;
+                        nonDetTimer.initialize();
+                        detTimer.initialize();
+                    }
+
                     /* We must send again the frame count and time because it
                      * probably has changed.
                      */
@@ -597,6 +868,50 @@ static void receive_messages(std::function<void()> draw)
 
                 break;
 
+            case MSGN_ZYGOTE_RESTART:
+                /* Restart the game in place: write savefiles back as an
+                 * exiting game would, then load the pristine boot state
+                 * whose index/path were received beforehand. On success,
+                 * execution resumes in the MSGN_SAVESTATE branch above,
+                 * where the boot-time re-initialization is performed.
+                 */
+                if (shared_config.write_savefiles_on_exit)
+                    SaveFileList::writeBackSaveFiles();
+
+                ThreadManager::restore();
+
+                /* If restoring failed, we return here. We still send the
+                 * frame count and time because the program will pull a
+                 * message in either case.
+                 */
+                sendMessage(MSGB_FRAMECOUNT_TIME);
+                sendData(&framecount, sizeof(unsigned long));
+                {
+                    struct timespec ticks = detTimer.getTicks();
+                    sendData(&ticks, sizeof(struct timespec));
+                }
+
+                break;
+
+            case MSGN_REWINDSTATE:
+                /* Load the most recent state of the rewind ring buffer */
+                if (Checkpoint::setRewindLoadIndex()) {
+                    ThreadManager::restore();
+                }
+
+                /* If the ring was empty or restoring failed, we return here.
+                 * We still send the frame count and time because the program
+                 * will pull a message in either case.
+                 */
+                sendMessage(MSGB_FRAMECOUNT_TIME);
+                sendData(&framecount, sizeof(unsigned long));
+                {
+                    struct timespec ticks = detTimer.getTicks();
+                    sendData(&ticks, sizeof(struct timespec));
+                }
+
+                break;
+
             case MSGN_STOP_ENCODE:
                 if (avencoder) {
                     debuglog(LCF_DUMP, "Stop AV dumping");
@@ -21,9 +21,32 @@
 #include "dlhook.h"
 #include "logging.h"
 #include <string>
+#include <map>
 
 namespace libtas {
 
+/* Open a library and cache the handle, so that resolving many symbols from
+ * the same library in a row (e.g. the whole SDL dynapi surface at startup)
+ * only pays the library lookup once. Failed opens are not cached, because
+ * the game may load the library later.
+ */
+static void* openLibrary(const char* library)
+{
+    static std::map<std::string, void*> library_handles;
+
+    auto it = library_handles.find(library);
+    if (it != library_handles.end())
+        return it->second;
+
+    void* handle;
+    NATIVECALL(handle = dlopen(library, RTLD_LAZY));
+
+    if (handle != nullptr)
+        library_handles[library] = handle;
+
+    return handle;
+}
+
 bool link_function(void** function, const char* source, const char* library, const char *version /*= nullptr*/)
 {
     /* Test if function is already linked */
@@ -52,7 +75,7 @@ bool link_function(void** function, const char* source, const char* library, con
         if (! libpath.empty()) {
 
             /* Try to link again using a matching library */
-            NATIVECALL(handle = dlopen(libpath.c_str(), RTLD_LAZY));
+            handle = openLibrary(libpath.c_str());
 
             if (handle != NULL) {
                 NATIVECALL(*function = dlsym(handle, source));
@@ -65,7 +88,7 @@ bool link_function(void** function, const char* source, const char* library, con
         }
 
         /* If it did not succeed, try to link using the given library */
-        NATIVECALL(handle = dlopen(library, RTLD_LAZY));
+        handle = openLibrary(library);
 
         if (handle != NULL) {
             NATIVECALL(*function = dlsym(handle, source));
@@ -50,12 +50,19 @@ namespace orig { \
     decltype(&FUNC) FUNC; \
 }
 
-#define LINK_NAMESPACE(FUNC,LIB) link_function((void**)&orig::FUNC, #FUNC, "lib" LIB ".so")
-#define LINK_NAMESPACE_GLOBAL(FUNC) link_function((void**)&orig::FUNC, #FUNC, nullptr)
-#define LINK_NAMESPACE_VERSION(FUNC,LIB,V) link_function((void**)&orig::FUNC, #FUNC, "lib" LIB ".so", V)
-#define LINK_NAMESPACE_SDL1(FUNC) link_function((void**)&orig::FUNC, #FUNC, "libSDL-1.2.so.0")
-#define LINK_NAMESPACE_SDL2(FUNC) link_function((void**)&orig::FUNC, #FUNC, "libSDL2-2.0.so.0")
-#define LINK_NAMESPACE_SDLX(FUNC) (get_sdlversion()==1)?LINK_NAMESPACE_SDL1(FUNC):LINK_NAMESPACE_SDL2(FUNC)
+/* The already-linked test is done inline, so hooked functions only pay a
+ * load and a well-predicted branch on the orig:: pointer once it is
+ * resolved, instead of a function call into link_function on every
+ * invocation.
+ */
+#define LINK_NAMESPACE(FUNC,LIB) ((orig::FUNC != nullptr) || link_function((void**)&orig::FUNC, #FUNC, "lib" LIB ".so"))
+#define LINK_NAMESPACE_GLOBAL(FUNC) ((orig::FUNC != nullptr) || link_function((void**)&orig::FUNC, #FUNC, nullptr))
+#define LINK_NAMESPACE_VERSION(FUNC,LIB,V) ((orig::FUNC != nullptr) || link_function((void**)&orig::FUNC, #FUNC, "lib" LIB ".so", V))
+#define LINK_NAMESPACE_SDL1(FUNC) ((orig::FUNC != nullptr) || link_function((void**)&orig::FUNC, #FUNC, "libSDL-1.2.so.0"))
+#define LINK_NAMESPACE_SDL2(FUNC) ((orig::FUNC != nullptr) || link_function((void**)&orig::FUNC, #FUNC, "libSDL2-2.0.so.0"))
+/* Also hoist the SDL version query behind the inline test, so that it is
+ * only performed until the symbol is resolved. */
+#define LINK_NAMESPACE_SDLX(FUNC) ((orig::FUNC != nullptr) || ((get_sdlversion()==1)?LINK_NAMESPACE_SDL1(FUNC):LINK_NAMESPACE_SDL2(FUNC)))
 
 
 }
@@ -74,22 +74,60 @@ int open_evdev(const char* source, int flags)
     return evdevfds[evnum].first.first;
 }
 
+/* Events are gathered here while inputevents.cpp fans out the controller
+ * diff, and written to the pipe in a single batch by flush_evdev(), so a
+ * frame costs one FIONREAD and one write per device instead of one pair of
+ * syscalls per event.
+ *
+ * The pipe stays the backing primitive on purpose: games read() the
+ * input_event structs straight from this fd and poll()/select() on it,
+ * and the pipe gives both data delivery and readiness with native kernel
+ * semantics. An eventfd would only signal readiness and would force us to
+ * intercept every read() on the fd to serve events from userspace. */
+static struct input_event ev_pending[AllInputs::MAXJOYS][64];
+static int ev_pending_count[AllInputs::MAXJOYS];
+
 void write_evdev(struct input_event ev, int evnum)
 {
     if (evdevfds[evnum].second == 0)
         return;
 
-    /* Check pipe size and don't write if too big */
-    int pipeSize;
-    NATIVECALL(MYASSERT(ioctl(evdevfds[evnum].first.first, FIONREAD, &pipeSize) == 0));
-
-    if (pipeSize < (64*sizeof(ev)))
-        write(evdevfds[evnum].first.second, &ev, sizeof(ev));
+    if (ev_pending_count[evnum] < 64)
+        ev_pending[evnum][ev_pending_count[evnum]++] = ev;
     else {
         debuglog(LCF_JOYSTICK | LCF_WARNING, "did not write evdev event, too many already.");
     }
 }
 
+void flush_evdev(void)
+{
+    for (int i = 0; i < AllInputs::MAXJOYS; i++) {
+        if (ev_pending_count[i] == 0)
+            continue;
+
+        if (evdevfds[i].second == 0) {
+            ev_pending_count[i] = 0;
+            continue;
+        }
+
+        /* Check pipe size and don't write the events that don't fit */
+        int pipeSize;
+        NATIVECALL(MYASSERT(ioctl(evdevfds[i].first.first, FIONREAD, &pipeSize) == 0));
+
+        int room = 64 - pipeSize / static_cast<int>(sizeof(struct input_event));
+        if (room < ev_pending_count[i]) {
+            debuglog(LCF_JOYSTICK | LCF_WARNING, "did not write evdev events, too many already.");
+            if (room < 0)
+                room = 0;
+        }
+
+        int count = (room < ev_pending_count[i]) ? room : ev_pending_count[i];
+        if (count > 0)
+            write(evdevfds[i].first.second, ev_pending[i], count*sizeof(struct input_event));
+        ev_pending_count[i] = 0;
+    }
+}
+
 bool sync_evdev(int evnum)
 {
     if (evdevfds[evnum].second == 0)
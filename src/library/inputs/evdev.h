@@ -33,9 +33,12 @@ int is_evdev(const char* source);
 /* Open a fake dev file using SYS_memfd_create */
 int open_evdev(const char* source, int flags);
 
-/* Write an input event in the file */
+/* Queue an input event, delivered by the next flush_evdev() */
 void write_evdev(struct input_event ev, int evnum);
 
+/* Write all queued events into the device pipes, one batch per device */
+void flush_evdev(void);
+
 /* Block, waiting for the input event queue to become empty.
  * Return of the queue is empty.
  */
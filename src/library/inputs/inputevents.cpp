@@ -43,6 +43,7 @@
 #include <SDL2/SDL.h>
 #include <linux/joystick.h>
 #include <linux/input.h>
+#include <unordered_map>
 
 
 #ifdef LIBTAS_HAS_XINPUT
@@ -51,10 +52,45 @@
 
 namespace libtas {
 
+/* The Xlib calls used while building events take the display lock on every
+ * call, and the keysym query walks the keyboard mapping, so events that are
+ * synthesized every frame paid that cost per event and per display. The
+ * game cannot remap its keyboard or change its root window under a TAS, so
+ * both lookups are resolved once and served from our own tables. */
+static Window rootWindow(int d)
+{
+    static Window roots[GAMEDISPLAYNUM] = {};
+    static Display* displays[GAMEDISPLAYNUM] = {};
+    if (displays[d] != gameDisplays[d]) {
+        displays[d] = gameDisplays[d];
+        NOLOGCALL(roots[d] = XRootWindow(gameDisplays[d], 0));
+    }
+    return roots[d];
+}
+
+static KeyCode keysymToKeycode(int d, KeySym keysym)
+{
+    static std::unordered_map<uint64_t, KeyCode> keycodes;
+    uint64_t key = (static_cast<uint64_t>(d) << 32) | keysym;
+    auto it = keycodes.find(key);
+    if (it != keycodes.end())
+        return it->second;
+
+    KeyCode keycode;
+    NOLOGCALL(keycode = XKeysymToKeycode(gameDisplays[d], keysym));
+    keycodes.emplace(key, keycode);
+    return keycode;
+}
+
 void generateKeyUpEvents(void)
 {
     int i, j;
 
+    /* Most frames have no keyboard change at all, so we compare the full
+     * arrays first: a single compare instead of the quadratic key scan */
+    if (ai->keyboard == old_ai.keyboard)
+        return;
+
     struct timespec time = detTimer.getTicks();
     int timestamp = time.tv_sec * 1000 + time.tv_nsec / 1000000;
 
@@ -63,7 +99,7 @@ void generateKeyUpEvents(void)
             continue;
         }
         for (j=0; j<AllInputs::MAXKEYS; j++) {
-            if (old_ai.keyboard[i] == ai.keyboard[j]) {
+            if (old_ai.keyboard[i] == ai->keyboard[j]) {
                 /* Key was not released */
                 break;
             }
@@ -116,8 +152,8 @@ void generateKeyUpEvents(void)
                 event.xkey.time = timestamp; // TODO: Wrong! timestamp is from X server start
                 for (int d=0; d<GAMEDISPLAYNUM; d++) {
                     if (gameDisplays[d]) {
-                        NOLOGCALL(event.xkey.keycode = XKeysymToKeycode(gameDisplays[d], old_ai.keyboard[i]));
-                        event.xkey.root = XRootWindow(gameDisplays[d], 0);
+                        event.xkey.keycode = keysymToKeycode(d, old_ai.keyboard[i]);
+                        event.xkey.root = rootWindow(d);
                         event.xkey.display = gameDisplays[d];
                         xlibEventQueue.insert(&event);
                     }
@@ -139,8 +175,8 @@ void generateKeyUpEvents(void)
                 dev->time = timestamp; // TODO: Wrong! timestamp is from X server start
                 for (int d=0; d<GAMEDISPLAYNUM; d++) {
                     if (gameDisplays[d]) {
-                        NOLOGCALL(dev->detail = XKeysymToKeycode(gameDisplays[d], old_ai.keyboard[i]));
-                        dev->root = XRootWindow(gameDisplays[d], 0);
+                        dev->detail = keysymToKeycode(d, old_ai.keyboard[i]);
+                        dev->root = rootWindow(d);
                         xlibEventQueue.insert(&event);
                     }
                 }
@@ -159,7 +195,7 @@ void generateKeyUpEvents(void)
                 rev->time = timestamp; // TODO: Wrong! timestamp is from X server start
                 for (int d=0; d<GAMEDISPLAYNUM; d++) {
                     if (gameDisplays[d]) {
-                        NOLOGCALL(rev->detail = XKeysymToKeycode(gameDisplays[d], old_ai.keyboard[i]));
+                        rev->detail = keysymToKeycode(d, old_ai.keyboard[i]);
                         xlibEventQueue.insert(&event);
                     }
                 }
@@ -180,15 +216,20 @@ void generateKeyDownEvents(void)
 {
     int i,j,k;
 
+    /* Most frames have no keyboard change at all, so we compare the full
+     * arrays first: a single compare instead of the quadratic key scan */
+    if (ai->keyboard == old_ai.keyboard)
+        return;
+
     struct timespec time = detTimer.getTicks();
     int timestamp = time.tv_sec * 1000 + time.tv_nsec / 1000000;
 
     for (i=0; i<AllInputs::MAXKEYS; i++) {
-        if (!ai.keyboard[i]) {
+        if (!ai->keyboard[i]) {
             continue;
         }
         for (j=0; j<AllInputs::MAXKEYS; j++) {
-            if (ai.keyboard[i] == old_ai.keyboard[j]) {
+            if (ai->keyboard[i] == old_ai.keyboard[j]) {
                 /* Key was not pressed */
                 break;
             }
@@ -204,7 +245,7 @@ void generateKeyDownEvents(void)
                 event2.key.repeat = 0;
 
                 SDL_Keysym keysym;
-                xkeysymToSDL(&keysym, ai.keyboard[i]);
+                xkeysymToSDL(&keysym, ai->keyboard[i]);
                 event2.key.keysym = keysym;
 
                 sdlEventQueue.insert(&event2);
@@ -233,7 +274,7 @@ void generateKeyDownEvents(void)
                 event1.key.state = SDL_PRESSED;
 
                 SDL1::SDL_keysym keysym;
-                xkeysymToSDL1(&keysym, ai.keyboard[i]);
+                xkeysymToSDL1(&keysym, ai->keyboard[i]);
                 event1.key.keysym = keysym;
 
                 if (SDL_EnableUNICODE(-1)) {
@@ -256,8 +297,8 @@ void generateKeyDownEvents(void)
                 event.xkey.same_screen = 1;
                 for (int d=0; d<GAMEDISPLAYNUM; d++) {
                     if (gameDisplays[d]) {
-                        NOLOGCALL(event.xkey.keycode = XKeysymToKeycode(gameDisplays[d], ai.keyboard[i]));
-                        event.xkey.root = XRootWindow(gameDisplays[d], 0);
+                        event.xkey.keycode = keysymToKeycode(d, ai->keyboard[i]);
+                        event.xkey.root = rootWindow(d);
                         event.xkey.display = gameDisplays[d];
                         xlibEventQueue.insert(&event);
                     }
@@ -279,8 +320,8 @@ void generateKeyDownEvents(void)
                 dev->time = timestamp;
                 for (int d=0; d<GAMEDISPLAYNUM; d++) {
                     if (gameDisplays[d]) {
-                        NOLOGCALL(dev->detail = XKeysymToKeycode(gameDisplays[d], ai.keyboard[i]));
-                        dev->root = XRootWindow(gameDisplays[d], 0);
+                        dev->detail = keysymToKeycode(d, ai->keyboard[i]);
+                        dev->root = rootWindow(d);
                         xlibEventQueue.insert(&event);
                     }
                 }
@@ -299,7 +340,7 @@ void generateKeyDownEvents(void)
                 rev->time = timestamp;
                 for (int d=0; d<GAMEDISPLAYNUM; d++) {
                     if (gameDisplays[d]) {
-                        NOLOGCALL(rev->detail = XKeysymToKeycode(gameDisplays[d], ai.keyboard[i]));
+                        rev->detail = keysymToKeycode(d, ai->keyboard[i]);
                         xlibEventQueue.insert(&event);
                     }
                 }
@@ -312,7 +353,7 @@ void generateKeyDownEvents(void)
             for (k=0; k<AllInputs::MAXKEYS; k++)
                 if (!old_ai.keyboard[k]) {
                     /* We found an empty space to put our key*/
-                    old_ai.keyboard[k] = ai.keyboard[i];
+                    old_ai.keyboard[k] = ai->keyboard[i];
                     break;
                 }
         }
@@ -348,6 +389,12 @@ void generateControllerEvents(void)
 
     for (int ji=0; ji<shared_config.nb_controllers; ji++) {
 
+        /* Skip controllers whose state did not change, so that the per-frame
+         * work stays proportional to the actual number of input changes */
+        if ((ai->controller_axes[ji] == old_ai.controller_axes[ji]) &&
+            (ai->controller_buttons[ji] == old_ai.controller_buttons[ji]))
+            continue;
+
         /* Check if we need to generate any joystick events for that
          * particular joystick. If not, we {continue;} here because
          * we must not update the joystick state (game_ai) as specified
@@ -379,7 +426,7 @@ void generateControllerEvents(void)
 
         for (int axis=0; axis<AllInputs::MAXAXES; axis++) {
             /* Check for axes change */
-            if (ai.controller_axes[ji][axis] != old_ai.controller_axes[ji][axis]) {
+            if (ai->controller_axes[ji][axis] != old_ai.controller_axes[ji][axis]) {
                 /* We got a change in a controller axis value */
 
                 if (game_info.joystick & GameInfo::SDL2) {
@@ -389,7 +436,7 @@ void generateControllerEvents(void)
                         event2.caxis.timestamp = timestamp;
                         event2.caxis.which = ji;
                         event2.caxis.axis = SingleInput::toSDL2Axis(axis);
-                        event2.caxis.value = ai.controller_axes[ji][axis];
+                        event2.caxis.value = ai->controller_axes[ji][axis];
                         sdlEventQueue.insert(&event2);
                         debuglog(LCF_SDL | LCF_EVENTS | LCF_JOYSTICK, "Generate SDL event CONTROLLERAXISMOTION with axis ", axis);
                     }
@@ -399,7 +446,7 @@ void generateControllerEvents(void)
                         event2.jaxis.timestamp = timestamp;
                         event2.jaxis.which = ji;
                         event2.jaxis.axis = axis;
-                        event2.jaxis.value = ai.controller_axes[ji][axis];
+                        event2.jaxis.value = ai->controller_axes[ji][axis];
                         sdlEventQueue.insert(&event2);
                         debuglog(LCF_SDL | LCF_EVENTS | LCF_JOYSTICK, "Generate SDL event JOYAXISMOTION with axis ", axis);
                     }
@@ -410,7 +457,7 @@ void generateControllerEvents(void)
                     event1.type = SDL1::SDL_JOYAXISMOTION;
                     event1.jaxis.which = ji;
                     event1.jaxis.axis = axis;
-                    event1.jaxis.value = ai.controller_axes[ji][axis];
+                    event1.jaxis.value = ai->controller_axes[ji][axis];
                     sdlEventQueue.insert(&event1);
                     debuglog(LCF_SDL | LCF_EVENTS | LCF_JOYSTICK, "Generate SDL event JOYAXISMOTION with axis ", axis);
                 }
@@ -420,7 +467,7 @@ void generateControllerEvents(void)
                     ev.time = timestamp;
                     ev.type = JS_EVENT_AXIS;
                     ev.number = SingleInput::toJsdevAxis(axis);
-                    ev.value = ai.controller_axes[ji][axis];
+                    ev.value = ai->controller_axes[ji][axis];
                     write_jsdev(ev, ji);
                     debuglog(LCF_EVENTS | LCF_JOYSTICK, "Generate jsdev event JS_EVENT_AXIS with axis ", axis);
                 }
@@ -431,18 +478,18 @@ void generateControllerEvents(void)
                     ev.time.tv_usec = time.tv_nsec / 1000;
                     ev.type = EV_ABS;
                     ev.code = SingleInput::toEvdevAxis(axis);
-                    ev.value = ai.controller_axes[ji][axis];
+                    ev.value = ai->controller_axes[ji][axis];
                     write_evdev(ev, ji);
                     debuglog(LCF_EVENTS | LCF_JOYSTICK, "Generate evdev event EV_ABS with axis ", axis);
                 }
 
                 /* Upload the old AllInput struct */
-                old_ai.controller_axes[ji][axis] = ai.controller_axes[ji][axis];
+                old_ai.controller_axes[ji][axis] = ai->controller_axes[ji][axis];
             }
         }
 
         /* Check for button change */
-        unsigned short buttons = ai.controller_buttons[ji];
+        unsigned short buttons = ai->controller_buttons[ji];
         unsigned short old_buttons = old_ai.controller_buttons[ji];
 
         /* We generate the hat event separately from the buttons,
@@ -641,12 +688,16 @@ void generateControllerEvents(void)
             }
         }
     }
+
+    /* Deliver the gathered events, one pipe write per device */
+    flush_jsdev();
+    flush_evdev();
 }
 
 void generateMouseMotionEvents(void)
 {
     /* Check if we got a change in mouse position */
-    if ((ai.pointer_x == old_ai.pointer_x) && (ai.pointer_y == old_ai.pointer_y))
+    if ((ai->pointer_x == old_ai.pointer_x) && (ai->pointer_y == old_ai.pointer_y))
         return;
 
     /* Fill the event structure */
@@ -661,13 +712,13 @@ void generateMouseMotionEvents(void)
         event2.motion.which = 0; // TODO: Mouse instance id. No idea what to put here...
 
         /* Build up mouse state */
-        event2.motion.state = SingleInput::toSDL2PointerMask(ai.pointer_mask);
-        event2.motion.xrel = ai.pointer_x - old_ai.pointer_x;
-        event2.motion.yrel = ai.pointer_y - old_ai.pointer_y;
+        event2.motion.state = SingleInput::toSDL2PointerMask(ai->pointer_mask);
+        event2.motion.xrel = ai->pointer_x - old_ai.pointer_x;
+        event2.motion.yrel = ai->pointer_y - old_ai.pointer_y;
         event2.motion.x = game_ai.pointer_x;
         event2.motion.y = game_ai.pointer_y;
         sdlEventQueue.insert(&event2);
-        debuglog(LCF_SDL | LCF_EVENTS | LCF_MOUSE, "Generate SDL event MOUSEMOTION with new position (", ai.pointer_x, ",", ai.pointer_y,")");
+        debuglog(LCF_SDL | LCF_EVENTS | LCF_MOUSE, "Generate SDL event MOUSEMOTION with new position (", ai->pointer_x, ",", ai->pointer_y,")");
     }
 
     if (game_info.mouse & GameInfo::SDL1) {
@@ -676,19 +727,19 @@ void generateMouseMotionEvents(void)
         event1.motion.which = 0; // TODO: Mouse instance id. No idea what to put here...
 
         /* Build up mouse state */
-        event1.motion.state = SingleInput::toSDL1PointerMask(ai.pointer_mask);
-        event1.motion.xrel = (Sint16)(ai.pointer_x - old_ai.pointer_x);
-        event1.motion.yrel = (Sint16)(ai.pointer_y - old_ai.pointer_y);
+        event1.motion.state = SingleInput::toSDL1PointerMask(ai->pointer_mask);
+        event1.motion.xrel = (Sint16)(ai->pointer_x - old_ai.pointer_x);
+        event1.motion.yrel = (Sint16)(ai->pointer_y - old_ai.pointer_y);
         event1.motion.x = (Uint16) game_ai.pointer_x;
         event1.motion.y = (Uint16) game_ai.pointer_y;
         sdlEventQueue.insert(&event1);
-        debuglog(LCF_SDL | LCF_EVENTS | LCF_MOUSE, "Generate SDL event MOUSEMOTION with new position (", ai.pointer_x, ",", ai.pointer_y,")");
+        debuglog(LCF_SDL | LCF_EVENTS | LCF_MOUSE, "Generate SDL event MOUSEMOTION with new position (", ai->pointer_x, ",", ai->pointer_y,")");
     }
 
     if (game_info.mouse & GameInfo::XEVENTS) {
         XEvent event;
         event.xmotion.type = MotionNotify;
-        event.xmotion.state = SingleInput::toXlibPointerMask(ai.pointer_mask);
+        event.xmotion.state = SingleInput::toXlibPointerMask(ai->pointer_mask);
         event.xmotion.x = game_ai.pointer_x;
         event.xmotion.y = game_ai.pointer_y;
         event.xmotion.x_root = event.xmotion.x;
@@ -702,7 +753,7 @@ void generateMouseMotionEvents(void)
                 xlibEventQueue.insert(&event);
             }
         }
-        debuglog(LCF_EVENTS | LCF_MOUSE, "Generate Xlib event MotionNotify with new position (", ai.pointer_x, ",", ai.pointer_y,")");
+        debuglog(LCF_EVENTS | LCF_MOUSE, "Generate Xlib event MotionNotify with new position (", ai->pointer_x, ",", ai->pointer_y,")");
     }
 
 #ifdef LIBTAS_HAS_XINPUT
@@ -723,7 +774,7 @@ void generateMouseMotionEvents(void)
         dev->detail = 0;
         for (int d=0; d<GAMEDISPLAYNUM; d++) {
             if (gameDisplays[d]) {
-                dev->root = XRootWindow(gameDisplays[d], 0);
+                dev->root = rootWindow(d);
                 xlibEventQueue.insert(&event);
             }
         }
@@ -741,11 +792,11 @@ void generateMouseMotionEvents(void)
         rev->evtype = XI_RawMotion;
         rev->time = timestamp;
         rev->raw_values = static_cast<double*>(malloc(2*sizeof(double)));
-        rev->raw_values[0] = ai.pointer_x - old_ai.pointer_x;
-        rev->raw_values[1] = ai.pointer_y - old_ai.pointer_y;
+        rev->raw_values[0] = ai->pointer_x - old_ai.pointer_x;
+        rev->raw_values[1] = ai->pointer_y - old_ai.pointer_y;
         rev->valuators.values = static_cast<double*>(malloc(2*sizeof(double)));
-        rev->valuators.values[0] = ai.pointer_x - old_ai.pointer_x;
-        rev->valuators.values[1] = ai.pointer_y - old_ai.pointer_y;
+        rev->valuators.values[0] = ai->pointer_x - old_ai.pointer_x;
+        rev->valuators.values[1] = ai->pointer_y - old_ai.pointer_y;
         rev->valuators.mask = static_cast<unsigned char*>(malloc(1*sizeof(unsigned char)));
         rev->valuators.mask[0] = 0;
         XISetMask(rev->valuators.mask, 0);
@@ -762,12 +813,16 @@ void generateMouseMotionEvents(void)
 #endif
 
     /* Upload the old AllInput struct */
-    old_ai.pointer_x = ai.pointer_x;
-    old_ai.pointer_y = ai.pointer_y;
+    old_ai.pointer_x = ai->pointer_x;
+    old_ai.pointer_y = ai->pointer_y;
 }
 
 void generateMouseButtonEvents(void)
 {
+    /* Check if we got a change in the pointer buttons */
+    if (ai->pointer_mask == old_ai.pointer_mask)
+        return;
+
     struct timespec time = detTimer.getTicks();
     int timestamp = time.tv_sec * 1000 + time.tv_nsec / 1000000;
 
@@ -776,13 +831,13 @@ void generateMouseButtonEvents(void)
         SingleInput::POINTER_B4, SingleInput::POINTER_B5};
 
     for (int bi=0; bi<5; bi++) {
-        if ((ai.pointer_mask ^ old_ai.pointer_mask) & (1 << buttons[bi])) {
+        if ((ai->pointer_mask ^ old_ai.pointer_mask) & (1 << buttons[bi])) {
             /* We got a change in a button state */
 
             /* Fill the event structure */
             if (game_info.mouse & GameInfo::SDL2) {
                 SDL_Event event2;
-                if (ai.pointer_mask & (1 << buttons[bi])) {
+                if (ai->pointer_mask & (1 << buttons[bi])) {
                     event2.type = SDL_MOUSEBUTTONDOWN;
                     event2.button.state = SDL_PRESSED;
                     debuglog(LCF_SDL | LCF_EVENTS | LCF_MOUSE, "Generate SDL event MOUSEBUTTONDOWN with button ", SingleInput::toSDL2PointerButton(buttons[bi]));
@@ -804,7 +859,7 @@ void generateMouseButtonEvents(void)
 
             if (game_info.mouse & GameInfo::SDL1) {
                 SDL1::SDL_Event event1;
-                if (ai.pointer_mask & (1 << buttons[bi])) {
+                if (ai->pointer_mask & (1 << buttons[bi])) {
                     event1.type = SDL1::SDL_MOUSEBUTTONDOWN;
                     event1.button.state = SDL_PRESSED;
                     debuglog(LCF_SDL | LCF_EVENTS | LCF_MOUSE, "Generate SDL event MOUSEBUTTONDOWN with button ", SingleInput::toSDL1PointerButton(buttons[bi]));
@@ -823,7 +878,7 @@ void generateMouseButtonEvents(void)
 
             if (game_info.mouse & GameInfo::XEVENTS) {
                 XEvent event;
-                if (ai.pointer_mask & (1 << buttons[bi])) {
+                if (ai->pointer_mask & (1 << buttons[bi])) {
                     event.xbutton.type = ButtonPress;
                     debuglog(LCF_EVENTS | LCF_MOUSE, "Generate Xlib event ButtonPress with button ", SingleInput::toXlibPointerButton(buttons[bi]));
                 }
@@ -831,7 +886,7 @@ void generateMouseButtonEvents(void)
                     event.xbutton.type = ButtonRelease;
                     debuglog(LCF_EVENTS | LCF_MOUSE, "Generate Xlib event ButtonRelease with button ", SingleInput::toXlibPointerButton(buttons[bi]));
                 }
-                event.xbutton.state = SingleInput::toXlibPointerMask(ai.pointer_mask);
+                event.xbutton.state = SingleInput::toXlibPointerMask(ai->pointer_mask);
                 event.xbutton.x = game_ai.pointer_x;
                 event.xbutton.y = game_ai.pointer_y;
                 event.xbutton.x_root = event.xbutton.x;
@@ -853,7 +908,7 @@ void generateMouseButtonEvents(void)
                 XIDeviceEvent *dev = static_cast<XIDeviceEvent*>(calloc(1, sizeof(XIDeviceEvent)));
                 event.xcookie.type = GenericEvent;
                 event.xcookie.extension = xinput_opcode;
-                if (ai.pointer_mask & (1 << buttons[bi])) {
+                if (ai->pointer_mask & (1 << buttons[bi])) {
                     debuglog(LCF_EVENTS | LCF_KEYBOARD, "Generate XIEvent XI_ButtonPress with button ", bi+1);
                     event.xcookie.evtype = XI_ButtonPress;
                     dev->evtype = XI_ButtonPress;
@@ -874,13 +929,13 @@ void generateMouseButtonEvents(void)
                 dev->buttons.mask = static_cast<unsigned char*>(malloc(1*sizeof(unsigned char)));
                 dev->buttons.mask_len = 1;
                 for (int bj=0; bj<5; bj++) {
-                    if (ai.pointer_mask & (1 << buttons[bj])) {
+                    if (ai->pointer_mask & (1 << buttons[bj])) {
                         XISetMask(dev->buttons.mask, bj);
                     }
                 }
                 for (int d=0; d<GAMEDISPLAYNUM; d++) {
                     if (gameDisplays[d]) {
-                        dev->root = XRootWindow(gameDisplays[d], 0);
+                        dev->root = rootWindow(d);
                         xlibEventQueue.insert(&event);
                     }
                 }
@@ -891,7 +946,7 @@ void generateMouseButtonEvents(void)
                 XIRawEvent *rev = static_cast<XIRawEvent*>(calloc(1, sizeof(XIRawEvent)));
                 event.xcookie.type = GenericEvent;
                 event.xcookie.extension = xinput_opcode;
-                if (ai.pointer_mask & (1 << buttons[bi])) {
+                if (ai->pointer_mask & (1 << buttons[bi])) {
                     debuglog(LCF_EVENTS | LCF_KEYBOARD, "Generate XIEvent XI_RawButtonPress with button ", bi+1);
                     event.xcookie.evtype = XI_RawButtonPress;
                     rev->evtype = XI_RawButtonPress;
@@ -940,6 +995,7 @@ static void syncControllerEvents()
                 ev.number = 0;
                 ev.value = 0;
                 write_jsdev(ev, i);
+                flush_jsdev();
 
                 /* Lastly, wait for queue to become empty again, ensuring that
                  * the event have finished being processed.
@@ -958,6 +1014,7 @@ static void syncControllerEvents()
                 ev.code = SYN_REPORT;
                 ev.value = 0;
                 write_evdev(ev, i);
+                flush_evdev();
 
                 sync_evdev(i);
             }
@@ -22,8 +22,28 @@
 
 namespace libtas {
 
-/* Inputs received from libTAS */
-AllInputs ai;
+/* Double buffer of the inputs received from libTAS */
+static AllInputs input_slots[2];
+
+/* Inputs received from libTAS, pointing to the published slot */
+AllInputs* ai = &input_slots[0];
+
+/* Slot filled by the socket receive path */
+static AllInputs* pending_ai = &input_slots[1];
+
+AllInputs* pendingInputs()
+{
+    return pending_ai;
+}
+
+void publishInputs()
+{
+    AllInputs* published = ai;
+    /* An aligned pointer store cannot tear for any reader, and the release
+     * ordering publishes the filled slot content along with it */
+    __atomic_store_n(&ai, pending_ai, __ATOMIC_RELEASE);
+    pending_ai = published;
+}
 
 /* Previous inputs, used to detected pressed keys, mouse delta positions, etc. */
 AllInputs old_ai;
@@ -37,18 +57,18 @@ AllInputs game_ai;
 void updateGameInputs()
 {
     for (int i=0; i<AllInputs::MAXKEYS; i++) {
-        game_ai.keyboard[i] = ai.keyboard[i];
+        game_ai.keyboard[i] = ai->keyboard[i];
     }
 
-    game_ai.pointer_x += ai.pointer_x - old_ai.pointer_x;
-    game_ai.pointer_y += ai.pointer_y - old_ai.pointer_y;
-    game_ai.pointer_mask = ai.pointer_mask;
+    game_ai.pointer_x += ai->pointer_x - old_ai.pointer_x;
+    game_ai.pointer_y += ai->pointer_y - old_ai.pointer_y;
+    game_ai.pointer_mask = ai->pointer_mask;
 
     for (int ji=0; ji<shared_config.nb_controllers; ji++) {
         for (int axis=0; axis<AllInputs::MAXAXES; axis++) {
-            game_ai.controller_axes[ji][axis] = ai.controller_axes[ji][axis];
+            game_ai.controller_axes[ji][axis] = ai->controller_axes[ji][axis];
         }
-        game_ai.controller_buttons[ji] = ai.controller_buttons[ji];
+        game_ai.controller_buttons[ji] = ai->controller_buttons[ji];
     }
 
 }
@@ -26,8 +26,19 @@
 
 namespace libtas {
 
-/* Inputs that are sent from libTAS */
-extern AllInputs ai;
+/* Inputs that are sent from libTAS. Points to the published slot of a
+ * double buffer: the socket receive path fills the other slot through
+ * pendingInputs(), and publishInputs() swaps them with an atomic pointer
+ * store at the frame boundary, so a reader can never observe a partially
+ * received struct. */
+extern AllInputs* ai;
+
+/* Slot receiving the next inputs, never the one `ai` points to */
+AllInputs* pendingInputs();
+
+/* Publish the pending slot: `ai` is atomically repointed to it, and the
+ * previously published slot becomes the pending one */
+void publishInputs();
 
 /* Last state of the inputs, used to generate events */
 extern AllInputs old_ai;
@@ -87,27 +87,69 @@ int open_jsdev(const char* source, int flags)
             ev.number = axis;
             write_jsdev(ev, jsnum);
         }
+
+        /* Make the initial state readable right away, the next frame
+         * boundary may be far off. */
+        flush_jsdev();
     }
 
     return jsdevfds[jsnum].first.first;
 }
 
+/* Events are gathered here while inputevents.cpp fans out the controller
+ * diff, and written to the pipe in a single batch by flush_jsdev(), so a
+ * frame costs one FIONREAD and one write per device instead of one pair of
+ * syscalls per event.
+ *
+ * The pipe stays the backing primitive on purpose: games read() the
+ * js_event structs straight from this fd and poll()/select() on it, and
+ * the pipe gives both data delivery and readiness with native kernel
+ * semantics. An eventfd would only signal readiness and would force us to
+ * intercept every read() on the fd to serve events from userspace. */
+static struct js_event js_pending[AllInputs::MAXJOYS][64];
+static int js_pending_count[AllInputs::MAXJOYS];
+
 void write_jsdev(struct js_event ev, int jsnum)
 {
     if (jsdevfds[jsnum].second == 0)
         return;
 
-    /* Check pipe size and don't write if too big */
-    int pipeSize;
-    NATIVECALL(MYASSERT(ioctl(jsdevfds[jsnum].first.first, FIONREAD, &pipeSize) == 0));
-
-    if (pipeSize < (64*sizeof(ev)))
-        write(jsdevfds[jsnum].first.second, &ev, sizeof(ev));
+    if (js_pending_count[jsnum] < 64)
+        js_pending[jsnum][js_pending_count[jsnum]++] = ev;
     else {
         debuglog(LCF_JOYSTICK | LCF_WARNING, "did not write jsdev event, too many already.");
     }
 }
 
+void flush_jsdev(void)
+{
+    for (int i = 0; i < AllInputs::MAXJOYS; i++) {
+        if (js_pending_count[i] == 0)
+            continue;
+
+        if (jsdevfds[i].second == 0) {
+            js_pending_count[i] = 0;
+            continue;
+        }
+
+        /* Check pipe size and don't write the events that don't fit */
+        int pipeSize;
+        NATIVECALL(MYASSERT(ioctl(jsdevfds[i].first.first, FIONREAD, &pipeSize) == 0));
+
+        int room = 64 - pipeSize / static_cast<int>(sizeof(struct js_event));
+        if (room < js_pending_count[i]) {
+            debuglog(LCF_JOYSTICK | LCF_WARNING, "did not write jsdev events, too many already.");
+            if (room < 0)
+                room = 0;
+        }
+
+        int count = (room < js_pending_count[i]) ? room : js_pending_count[i];
+        if (count > 0)
+            write(jsdevfds[i].first.second, js_pending[i], count*sizeof(struct js_event));
+        js_pending_count[i] = 0;
+    }
+}
+
 bool sync_jsdev(int jsnum)
 {
     if (jsdevfds[jsnum].second == 0)
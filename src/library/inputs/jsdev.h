@@ -33,9 +33,12 @@ int is_jsdev(const char* source);
 /* Open a fake jsdev file using SYS_memfd_create, and write the init data */
 int open_jsdev(const char* source, int flags);
 
-/* Write an js event in the file */
+/* Queue a js event, delivered by the next flush_jsdev() */
 void write_jsdev(struct js_event ev, int jsnum);
 
+/* Write all queued events into the device pipes, one batch per device */
+void flush_jsdev(void);
+
 /* Block, waiting for the js event queue to become empty. Return true if
  * queue is empty. */
 bool sync_jsdev(int jsnum);
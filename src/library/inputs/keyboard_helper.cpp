@@ -304,7 +304,7 @@ SDL1::SDLKey X11_Translate1Keysym(KeySym xsym)
 	return key;
 }
 
-void xkeyboardToSDLkeyboard(const std::array<KeySym,AllInputs::MAXKEYS>& Xkeyboard, Uint8* SDLkeyboard) {
+void xkeyboardToSDLkeyboard(const std::array<uint32_t,AllInputs::MAXKEYS>& Xkeyboard, Uint8* SDLkeyboard) {
     memset(SDLkeyboard, 0, SDL_NUM_SCANCODES);
     for (int i=0; i<AllInputs::MAXKEYS; i++) {
         if (Xkeyboard[i]) {
@@ -314,7 +314,7 @@ void xkeyboardToSDLkeyboard(const std::array<KeySym,AllInputs::MAXKEYS>& Xkeyboa
     }
 }
 
-void xkeyboardToSDL1keyboard(const std::array<KeySym,AllInputs::MAXKEYS>& Xkeyboard, Uint8* SDLkeyboard) {
+void xkeyboardToSDL1keyboard(const std::array<uint32_t,AllInputs::MAXKEYS>& Xkeyboard, Uint8* SDLkeyboard) {
     memset(SDLkeyboard, 0, SDL1::SDLK_LAST);
     for (int i=0; i<AllInputs::MAXKEYS; i++) {
         if (Xkeyboard[i]) {
@@ -39,8 +39,8 @@ void X11_InitKeymap(void);
 /* Fill the keyboard array that SDL functions are expected,
  * based on the KeySym set we get from our AllInputs struct.
  */
-void xkeyboardToSDLkeyboard(const std::array<KeySym,AllInputs::MAXKEYS>& Xkeyboard, Uint8* SDLkeyboard);
-void xkeyboardToSDL1keyboard(const std::array<KeySym,AllInputs::MAXKEYS>& Xkeyboard, Uint8* SDLkeyboard);
+void xkeyboardToSDLkeyboard(const std::array<uint32_t,AllInputs::MAXKEYS>& Xkeyboard, Uint8* SDLkeyboard);
+void xkeyboardToSDL1keyboard(const std::array<uint32_t,AllInputs::MAXKEYS>& Xkeyboard, Uint8* SDLkeyboard);
 
 /* Fill the SDL 1 or SDL 2 full key struct based on a Xlib KeySym */
 void xkeysymToSDL(SDL_Keysym *keysym, KeySym xkeysym);
@@ -93,7 +93,16 @@ static const char joy_name[] = "XInput Controller";
     return reinterpret_cast<SDL_GameController*>(&gcids[joy]);
 }
 
-const char* xbox360Mapping = "00000000000000000000000000000000,XInput Controller,a:b0,b:b1,back:b6,dpdown:h0.4,dpleft:h0.8,dpright:h0.2,dpup:h0.1,guide:b8,leftshoulder:b4,leftstick:b9,lefttrigger:a2,leftx:a0,lefty:a1,rightshoulder:b5,rightstick:b10,righttrigger:a5,rightx:a3,righty:a4,start:b7,x:b2,y:b3,";
+static const char xbox360Mapping[] = "00000000000000000000000000000000,XInput Controller,a:b0,b:b1,back:b6,dpdown:h0.4,dpleft:h0.8,dpright:h0.2,dpup:h0.1,guide:b8,leftshoulder:b4,leftstick:b9,lefttrigger:a2,leftx:a0,lefty:a1,rightshoulder:b5,rightstick:b10,righttrigger:a5,rightx:a3,righty:a4,start:b7,x:b2,y:b3,";
+
+/* Allocate a copy of our single mapping string. The length is known at
+ * compile time, so no strlen per call. */
+static char* copyMapping()
+{
+    char* mapping = static_cast<char*>(malloc(sizeof(xbox360Mapping)));
+    memcpy(mapping, xbox360Mapping, sizeof(xbox360Mapping));
+    return mapping;
+}
 
 /* Override */ char *SDL_GameControllerMappingForGUID( SDL_JoystickGUID guid )
 {
@@ -103,10 +112,7 @@ const char* xbox360Mapping = "00000000000000000000000000000000,XInput Controller
      *
      * The game is supposed to free this, so we must allocate it.
      */
-    int mapsize = strlen(xbox360Mapping);
-    char* mapping = static_cast<char*>(malloc(mapsize+1));
-    strcpy(mapping, xbox360Mapping);
-    return mapping;
+    return copyMapping();
 }
 
 /* Override */ char *SDL_GameControllerMapping( SDL_GameController * gamecontroller )
@@ -125,10 +131,7 @@ const char* xbox360Mapping = "00000000000000000000000000000000,XInput Controller
     /* Return the mapping of my own xbox 360 controller.
      * The game is supposed to free the char*, so we must
      * allocate it. */
-    int mapsize = strlen(xbox360Mapping);
-    char* mapping = static_cast<char*>(malloc(mapsize+1));
-    strcpy(mapping, xbox360Mapping);
-    return mapping;
+    return copyMapping();
 }
 
 /* Override */ SDL_bool SDL_GameControllerGetAttached(SDL_GameController *gamecontroller)
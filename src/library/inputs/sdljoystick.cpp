@@ -293,8 +293,8 @@ int SDL_JoystickIndex(SDL_Joystick *joystick)
 
     for (int j=0; j<shared_config.nb_controllers; j++) {
         for (int a=0; a<AllInputs::MAXAXES; a++)
-            game_ai.controller_axes[j][a] = ai.controller_axes[j][a];
-        game_ai.controller_buttons[j] = ai.controller_buttons[j];
+            game_ai.controller_axes[j][a] = ai->controller_axes[j][a];
+        game_ai.controller_buttons[j] = ai->controller_buttons[j];
     }
 }
 
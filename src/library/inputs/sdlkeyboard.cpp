@@ -26,9 +26,24 @@
 
 namespace libtas {
 
+/* Persistent keyboard state arrays, updated in place at the frame boundary.
+ * Games can poll SDL_GetKeyboardState() every frame per entity, so the
+ * getters only hand out the pointer, matching real SDL semantics where the
+ * returned array stays valid and is refreshed by the event loop. */
 static Uint8 SDL_keyboard[SDL_NUM_SCANCODES] = {0};
 static Uint8 SDL1_keyboard[SDL1::SDLK_LAST] = {0};
 
+void updateKeyboardState(void)
+{
+    /* Most frames don't change the set of pressed keys, and the arrays start
+     * zeroed which matches the empty initial inputs. */
+    if (ai->keyboard == old_ai.keyboard)
+        return;
+
+    xkeyboardToSDLkeyboard(ai->keyboard, SDL_keyboard);
+    xkeyboardToSDL1keyboard(ai->keyboard, SDL1_keyboard);
+}
+
 /* Override */ const Uint8* SDL_GetKeyboardState( int* numkeys)
 {
     debuglog(LCF_SDL | LCF_KEYBOARD, __func__, " call.");
@@ -36,8 +51,6 @@ static Uint8 SDL1_keyboard[SDL1::SDLK_LAST] = {0};
     if (numkeys)
         *numkeys = SDL_NUM_SCANCODES;
 
-    xkeyboardToSDLkeyboard(ai.keyboard, SDL_keyboard);
-    //*numkeys = 512;
     return SDL_keyboard;
 }
 
@@ -48,7 +61,6 @@ static Uint8 SDL1_keyboard[SDL1::SDLK_LAST] = {0};
     if (numkeys)
         *numkeys = SDL1::SDLK_LAST;
 
-    xkeyboardToSDL1keyboard(ai.keyboard, SDL1_keyboard);
     return SDL1_keyboard;
 }
 
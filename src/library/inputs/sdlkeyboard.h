@@ -25,6 +25,11 @@
 
 namespace libtas {
 
+/* Refresh the emulated keyboard state arrays from the current inputs.
+ * Called at the frame boundary, so that SDL_GetKeyboardState() and
+ * SDL_GetKeyState() don't rebuild the arrays on every poll. */
+void updateKeyboardState(void);
+
 /* Keyboard functions */
 OVERRIDE const Uint8* SDL_GetKeyboardState(int* numkeys); // SDL 2
 OVERRIDE Uint8* SDL_GetKeyState(int* numkeys); // SDL 1
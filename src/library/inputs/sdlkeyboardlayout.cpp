@@ -317,17 +317,74 @@ static const SDL1::SDLKey SDL1_default_keymap[SDL1_NUM_SCANCODES] = {
     SDL1::SDLK_UNKNOWN, SDL1::SDLK_UNKNOWN, SDL1::SDLK_UNKNOWN,
 };
 
+/* Reverse lookup tables for the keymaps above, built lazily on first use.
+ * Each translated key event used to perform a linear scan of the keymap,
+ * which matters when input editing replays thousands of key events per
+ * second. SDL keycodes are either printable characters (< 256) or scancodes
+ * with SDLK_SCANCODE_MASK set, so two small direct-indexed tables cover all
+ * of them */
+static Uint16 scan_from_char[256];
+static Uint16 scan_from_masked[SDL_NUM_SCANCODES];
+static unsigned char scan1_from_key[SDL1::SDLK_LAST];
+static int reverse_keymap_inited = 0;
+
+static void initReverseKeymaps(void)
+{
+    int i;
+
+    /* Iterate backwards so that the lowest matching scancode wins,
+     * like the linear scans did */
+    for (i = static_cast<int>(SDL_NUM_SCANCODES) - 1; i >= 0; i--) {
+        SDL_Keycode keycode = SDL_default_keymap[i];
+        if (keycode == SDLK_UNKNOWN)
+            continue;
+        if (keycode & SDLK_SCANCODE_MASK) {
+            SDL_Keycode masked = keycode & ~SDLK_SCANCODE_MASK;
+            if (masked < static_cast<SDL_Keycode>(SDL_NUM_SCANCODES))
+                scan_from_masked[masked] = i;
+        }
+        else if (keycode < 256)
+            scan_from_char[keycode] = i;
+    }
+
+    for (i = SDL1_NUM_SCANCODES - 1; i >= 0; i--) {
+        if (SDL1_default_keymap[i] != SDL1::SDLK_UNKNOWN)
+            scan1_from_key[SDL1_default_keymap[i]] = i;
+    }
+
+    reverse_keymap_inited = 1;
+}
+
 SDL_Scancode GetScanFromKey(SDL_Keycode keycode){
-    for (int i=0; i<static_cast<int>(SDL_NUM_SCANCODES); i++)
-        if (SDL_default_keymap[i] == keycode)
-            return static_cast<SDL_Scancode>(i);
+    if (! reverse_keymap_inited)
+        initReverseKeymaps();
+
+    int i = 0;
+    if (keycode & SDLK_SCANCODE_MASK) {
+        SDL_Keycode masked = keycode & ~SDLK_SCANCODE_MASK;
+        if (masked < static_cast<SDL_Keycode>(SDL_NUM_SCANCODES))
+            i = scan_from_masked[masked];
+    }
+    else if ((keycode > 0) && (keycode < 256))
+        i = scan_from_char[keycode];
+
+    /* Unmapped keycodes hit the zero entry of the tables, which the check
+     * below turns back into SDL_SCANCODE_UNKNOWN */
+    if (SDL_default_keymap[i] == keycode)
+        return static_cast<SDL_Scancode>(i);
     return SDL_SCANCODE_UNKNOWN;
 }
 
 unsigned char GetScanFromKey1(SDL1::SDLKey key){
-    for (int i=0; i<static_cast<int>(SDL1_NUM_SCANCODES); i++)
-        if (SDL1_default_keymap[i] == key)
-            return static_cast<unsigned char>(i);
+    if (! reverse_keymap_inited)
+        initReverseKeymaps();
+
+    int i = 0;
+    if ((key > 0) && (key < SDL1::SDLK_LAST))
+        i = scan1_from_key[key];
+
+    if (SDL1_default_keymap[i] == key)
+        return static_cast<unsigned char>(i);
     return 0;
 }
 
@@ -975,6 +975,20 @@ struct udev_device {
     }
 };
 
+/* The Device tree is built once and immutable, but SDL2's joystick subsystem
+ * re-enumerates on a timer, creating and unreffing wrappers for the same
+ * devices over and over, each with its whole parent chain. The wrappers are
+ * cached per (udev context, device) pair; the cache keeps a reference of its
+ * own so the game's unref never destroys them, and every later request is
+ * allocation free. */
+static struct udev_device *getDevice(struct udev &udev, const Device &device) {
+    static std::map<std::pair<struct udev*, const Device*>, struct udev_device*> cache;
+    auto &cached = cache[std::make_pair(&udev, &device)];
+    if (!cached)
+        cached = new struct udev_device(udev, device);
+    return ref(cached);
+}
+
 struct udev_monitor : InactiveQueue { using InactiveQueue::InactiveQueue; };
 
 struct udev_enumerate {
@@ -1189,28 +1203,28 @@ namespace libtas {
     if (!udev || !syspath)
         return errno = EINVAL, nullptr;
     if (const Device *device = Device::fromSyspath(syspath))
-        return new udev_device(*udev, *device);
+        return getDevice(*udev, *device);
     return errno = ENOENT, nullptr;
 }
 /* Override */ struct udev_device *udev_device_new_from_devnum(struct udev *udev, char type, dev_t devnum) {
     if (!udev)
         return errno = EINVAL, nullptr;
     if (const Device *device = Device::fromDevnum(type, devnum))
-        return new struct udev_device(*udev, *device);
+        return getDevice(*udev, *device);
     return errno = ENOENT, nullptr;
 }
 /* Override */ struct udev_device *udev_device_new_from_subsystem_sysname(struct udev *udev, const char *subsystem, const char *sysname) {
     if (!udev || !subsystem || !sysname)
         return errno = EINVAL, nullptr;
     if (const Device *device = Device::fromSubsystemSysname(subsystem, sysname))
-        return new struct udev_device(*udev, *device);
+        return getDevice(*udev, *device);
     return errno = ENOENT, nullptr;
 }
 /* Override */ struct udev_device *udev_device_new_from_device_id(struct udev *udev, const char *id) {
     if (!udev || !id)
         return errno = EINVAL, nullptr;
     if (const Device *device = Device::fromDeviceId(id))
-        return new struct udev_device(*udev, *device);
+        return getDevice(*udev, *device);
     return errno = ENOENT, nullptr;
 }
 /* Override */ struct udev_device *udev_device_new_from_environment(struct udev *udev) {
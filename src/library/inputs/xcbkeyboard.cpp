@@ -52,15 +52,17 @@ namespace libtas {
     reply->sequence = 0;
 
     memset(reply->keys, 0, 32);
-    GlobalNoLog gnl; // Avoid logging on XkbKeycodeToKeysym
-    for (int kc=0; kc<256; kc++) {
-        KeySym ks = XkbKeycodeToKeysym(nullptr, (KeyCode)kc, 0, 0);
-        for (int i=0; i<AllInputs::MAXKEYS; i++) {
-            if (ks == game_ai.keyboard[i]) {
-                reply->keys[kc>>3] |= (1 << (kc&0x7));
-                break;
-            }
-        }
+    GlobalNoLog gnl; // Avoid logging on XKeysymToKeycode
+
+    /* Only look up the pressed keys, instead of scanning the whole keymap
+     * against them. The keycode of each pressed keysym matches the one
+     * used when generating key events. */
+    for (int i=0; i<AllInputs::MAXKEYS; i++) {
+        if (!game_ai.keyboard[i])
+            break;
+        KeyCode kc = XKeysymToKeycode(nullptr, game_ai.keyboard[i]);
+        if (kc)
+            reply->keys[kc>>3] |= (1 << (kc&0x7));
     }
 
     return reply;
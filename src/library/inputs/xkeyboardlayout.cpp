@@ -24,6 +24,9 @@
 #include <X11/keysym.h>
 #include <X11/XF86keysym.h>
 // #include <X11/X.h>
+#include <algorithm>
+#include <array>
+#include <utility>
 
 
 namespace libtas {
@@ -138,6 +141,25 @@ static const char Xlib_default_char[256] = {
     '\0'
 };
 
+/* Reverse table keysym -> keycode, built once from the static keymap and
+ * sorted for binary search, so the keysym lookups on the input injection
+ * path do not scan the whole keymap on every call. The sort is stable,
+ * so a keysym mapped by several keycodes resolves to the lowest one,
+ * like the linear scan did. */
+static const std::array<std::pair<KeySym, KeyCode>, 256>& reverseKeymap()
+{
+    static const std::array<std::pair<KeySym, KeyCode>, 256> table = [] {
+        std::array<std::pair<KeySym, KeyCode>, 256> t;
+        for (int i = 0; i < 256; i++)
+            t[i] = std::make_pair(Xlib_default_keymap[i], static_cast<KeyCode>(i));
+        std::stable_sort(t.begin(), t.end(),
+            [] (const std::pair<KeySym, KeyCode>& a, const std::pair<KeySym, KeyCode>& b)
+            { return a.first < b.first; });
+        return t;
+    }();
+    return table;
+}
+
 /* Override */ KeySym XKeycodeToKeysym(Display* display, KeyCode keycode, int index)
 {
     debuglog(LCF_KEYBOARD, __func__, " called with keycode ", (int)keycode);
@@ -157,13 +179,15 @@ static const char Xlib_default_char[256] = {
 /* Override */ KeyCode XKeysymToKeycode( Display* display, KeySym keysym)
 {
     debuglog(LCF_KEYBOARD, __func__, " called with keysym ", keysym);
+    const auto& table = reverseKeymap();
+    auto it = std::lower_bound(table.begin(), table.end(),
+        std::make_pair(keysym, static_cast<KeyCode>(0)),
+        [] (const std::pair<KeySym, KeyCode>& a, const std::pair<KeySym, KeyCode>& b)
+        { return a.first < b.first; });
+
     KeyCode kc = 0;
-    for (int i=0; i<256; i++) {
-        if (Xlib_default_keymap[i] == keysym) {
-            kc = static_cast<KeyCode>(i);
-            break;
-        }
-    }
+    if ((it != table.end()) && (it->first == keysym))
+        kc = it->second;
 
     debuglog(LCF_KEYBOARD, "   returning ", (int)kc);
     return kc;
@@ -31,15 +31,16 @@ namespace libtas {
 
 void debuglogstdio(LogCategoryFlag lcf, const char* fmt, ...)
 {
-    if ((shared_config.includeFlags & LCF_MAINTHREAD) &&
-        !ThreadManager::isMainThread())
-        return;
-    
+    /* Category check first: it is the cheapest and filters the most */
     if ((!(lcf & shared_config.includeFlags)  ||
           (lcf & shared_config.excludeFlags)) &&
          !(lcf & LCF_ALERT))
         return;
 
+    if ((shared_config.includeFlags & LCF_MAINTHREAD) &&
+        !ThreadManager::isMainThread())
+        return;
+
     /* Not printing anything if global state is set to NOLOG */
     if (GlobalState::isNoLog())
         return;
@@ -53,6 +53,16 @@
 
 namespace libtas {
 
+/* Log categories can be stripped at build time by defining LIBTAS_LOG_MASK
+ * to the bitwise OR of the categories to keep (alerts are always kept).
+ * Because lcf is a compile-time constant at call sites, the check below
+ * constant-folds and the compiler removes the whole call, argument
+ * evaluation included.
+ */
+#ifndef LIBTAS_LOG_MASK
+#define LIBTAS_LOG_MASK (~0)
+#endif
+
 /* Print the debug message using stdio functions */
 void debuglogstdio(LogCategoryFlag lcf, const char* fmt, ...);
 
@@ -88,26 +98,52 @@ inline void catlog (std::ostringstream &oss, First && first, Rest && ...rest)
  * depend on variadic templates is transfered to debuglogstdio(),
  * to keep increased size as low as possible.
  */
+/* The string building lives in its own function, kept out of line so that
+ * the checking shell in debuglog() below stays small enough for the
+ * compiler to inline it at every call site.
+ */
 template<typename ...Args>
-void debuglog(LogCategoryFlag lcf, Args ...args);
+__attribute__((noinline)) void debuglogverbose(LogCategoryFlag lcf, Args ...args)
+{
+    std::ostringstream oss;
+    catlog(oss, std::forward<Args>(args)...);
+    debuglogstdio(lcf, oss.str().c_str());
+}
+
 template<typename ...Args>
 inline void debuglog(LogCategoryFlag lcf, Args ...args)
 {
+    /* Constant-folded check, see LIBTAS_LOG_MASK above. Because this shell
+     * is inlined, a call site whose category is masked out at build time
+     * disappears entirely (together with the evaluation of side-effect-free
+     * arguments).
+     */
+    if (!(lcf & (LIBTAS_LOG_MASK | LCF_ALERT)))
+        return;
+
     /* We also check this in debuglogstdio(), but doing it here avoid building
      * all strings, because as a fraction of these will be printed.
+     * The category check comes first: it only reads two words of
+     * shared_config, whereas isMainThread() is a function call, so the
+     * common case of a disabled category pays as little as possible.
      */
+    if ((!(lcf & shared_config.includeFlags) ||
+          (lcf & shared_config.excludeFlags)) &&
+         !(lcf & LCF_ALERT))
+        return;
+
     if ((shared_config.includeFlags & LCF_MAINTHREAD) &&
         !ThreadManager::isMainThread())
         return;
 
-    if ((!(lcf & shared_config.includeFlags) ||
-          (lcf & shared_config.excludeFlags)) &&
-         !(lcf & LCF_ALERT))
+    /* Not printing anything if global state is set to NOLOG. Also checked
+     * in debuglogstdio(), but checking here (one TLS load) skips the
+     * string building.
+     */
+    if (GlobalState::isNoLog())
         return;
 
-    std::ostringstream oss;
-    catlog(oss, std::forward<Args>(args)...);
-    debuglogstdio(lcf, oss.str().c_str());
+    debuglogverbose(lcf, std::forward<Args>(args)...);
 }
 
 /* If we only want to print the function name... */
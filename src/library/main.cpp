@@ -33,8 +33,12 @@
 #include "checkpoint/Checkpoint.h"
 #include "audio/AudioContext.h"
 #include "encoding/AVEncoder.h"
+#include "ScreenPreview.h"
+#include "SlotInfo.h"
 #include <unistd.h> // getpid()
 #include "frame.h" // framecount
+#include "TimeHolder.h"
+#include "GlobalState.h" // NATIVECALL
 
 extern char**environ;
 
@@ -46,6 +50,15 @@ void SteamUser_SetUserDataFolder(std::string path);
 
 void __attribute__((constructor)) init(void)
 {
+    /* Per-stage timing of the library init, reported at the end. Most of
+     * the wall time before main() is spent in the dynamic linker and in
+     * the config handshake with the program (which blocks on the socket),
+     * not in our own work: hook resolution is lazy and the subsystem
+     * inits below are plain field setup. The report exists to catch
+     * startup regressions, which matter in restart loops. */
+    TimeHolder tm_start, tm_threads, tm_socket, tm_handshake, tm_end;
+    NATIVECALL(clock_gettime(CLOCK_MONOTONIC, &tm_start));
+
     /* Hacking `environ` to disable LD_PRELOAD for future processes */
     /* Taken from <https://stackoverflow.com/a/3275799> */
     for (int i=0; environ[i]; i++) {
@@ -59,8 +72,12 @@ void __attribute__((constructor)) init(void)
 
     ThreadManager::init();
 
+    NATIVECALL(clock_gettime(CLOCK_MONOTONIC, &tm_threads));
+
     initSocketGame();
 
+    NATIVECALL(clock_gettime(CLOCK_MONOTONIC, &tm_socket));
+
     /* Send information to the program */
 
     /* Send game process pid */
@@ -69,6 +86,11 @@ void __attribute__((constructor)) init(void)
     pid_t mypid = getpid();
     sendData(&mypid, sizeof(pid_t));
 
+    /* Hand the program the shared preview and slot info buffers, as sealed
+     * memfds passed over the socket */
+    ScreenPreview::init();
+    SlotInfo::init();
+
     /* End message */
     sendMessage(MSGB_END_INIT);
 
@@ -98,6 +120,9 @@ void __attribute__((constructor)) init(void)
                 receiveData(&index, sizeof(int));
                 Checkpoint::setBaseSavestateIndex(index);
                 break;
+            case MSGN_SAVESTATE_IGNORE:
+                Checkpoint::setIgnorePatterns(receiveString());
+                break;
             case MSGN_ENCODING_SEGMENT:
                 receiveData(&AVEncoder::segment_number, sizeof(int));
                 break;
@@ -115,7 +140,7 @@ void __attribute__((constructor)) init(void)
     /* Set the frame count to the initial frame count */
     framecount = shared_config.initial_framecount;
 
-    ai.emptyInputs();
+    ai->emptyInputs();
     old_ai.emptyInputs();
     game_ai.emptyInputs();
 
@@ -125,14 +150,34 @@ void __attribute__((constructor)) init(void)
     nonDetTimer.initialize();
     detTimer.initialize();
 
+    NATIVECALL(clock_gettime(CLOCK_MONOTONIC, &tm_handshake));
+
     /* Initialize sound parameters */
     audiocontext.init();
+
+    NATIVECALL(clock_gettime(CLOCK_MONOTONIC, &tm_end));
+
+    TimeHolder d_threads = tm_threads - tm_start;
+    TimeHolder d_socket = tm_socket - tm_threads;
+    TimeHolder d_handshake = tm_handshake - tm_socket;
+    TimeHolder d_subsystems = tm_end - tm_handshake;
+    TimeHolder d_total = tm_end - tm_start;
+    debuglogstdio(LCF_INFO, "init: threads %.2f ms, socket %.2f ms, handshake %.2f ms, subsystems %.2f ms, total %.2f ms",
+        d_threads.tv_sec * 1000.0 + d_threads.tv_nsec / 1000000.0,
+        d_socket.tv_sec * 1000.0 + d_socket.tv_nsec / 1000000.0,
+        d_handshake.tv_sec * 1000.0 + d_handshake.tv_nsec / 1000000.0,
+        d_subsystems.tv_sec * 1000.0 + d_subsystems.tv_nsec / 1000000.0,
+        d_total.tv_sec * 1000.0 + d_total.tv_nsec / 1000000.0);
 }
 
 void __attribute__((destructor)) term(void)
 {
     ThreadManager::deallocateThreads();
 
+    ScreenPreview::fini();
+
+    SlotInfo::fini();
+
     sendMessage(MSGB_QUIT);
 
     closeSocket();
@@ -19,15 +19,230 @@
 
 #include "mallocwrappers.h"
 #include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <pthread.h>
+#include <sys/mman.h>
 
 #include "logging.h"
+#include "AllocTrace.h"
 // #include "../dlhook.h"
 
+/* The glibc allocator entry points, used both as the fallback when the
+ * deterministic heap is disabled and for pointers that were allocated before
+ * the config was received. We cannot call malloc/free here, because within
+ * this library they would bind to our own overrides. */
+extern "C" {
+void *__libc_malloc (size_t size);
+void *__libc_calloc (size_t nmemb, size_t size);
+void *__libc_realloc (void *ptr, size_t size);
+void __libc_free (void *ptr);
+}
+
 namespace libtas {
 
+/* Optional deterministic heap. glibc malloc produces nondeterministic layouts
+ * and fragmentation, which inflate incremental savestates: freed-then-reused
+ * memory lands on fresh pages that stay dirty. Instead, we reserve one large
+ * arena at a fixed address hint, bump-allocate from it, and segregate frees
+ * into power-of-two size classes with LIFO reuse. Identical replays then make
+ * the same sequence of allocations and get the same addresses back.
+ *
+ * Allocation requests made before the config is received (during library and
+ * loader init) go to glibc; free() sorts pointers by address range, so both
+ * heaps can coexist safely. Blocks carry a small header with their size
+ * class, and reused blocks are zeroed like fresh ones, to keep the zeroed
+ * malloc behavior that makes games reading uninitialized memory
+ * deterministic. */
+
+#ifdef __x86_64__
+static void* const ARENA_ADDR = reinterpret_cast<void*>(0x1d0000000000);
+static const size_t ARENA_SIZE = (size_t(1) << 32); /* 4 GB of address space */
+#else
+static void* const ARENA_ADDR = reinterpret_cast<void*>(0x60000000);
+static const size_t ARENA_SIZE = (size_t(1) << 29); /* 512 MB of address space */
+#endif
+
+/* Size classes are powers of two, from 2^4 = 16 bytes to 2^30 = 1 GB */
+static const int MIN_CLASS = 4;
+static const int MAX_CLASS = 30;
+
+/* Block header, sized so that the returned pointer keeps malloc alignment.
+ * Freed blocks store the next free-list entry in their first data word. */
+struct BlockHeader {
+    size_t class_index;
+    size_t size; /* requested size, for realloc copies */
+};
+
+static char* arena_start = nullptr;
+static char* arena_cur = nullptr;
+static char* arena_end = nullptr;
+static void* free_lists[MAX_CLASS + 1] = {};
+static pthread_mutex_t heap_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static bool initArena(void)
+{
+    if (arena_start)
+        return true;
+
+    /* MAP_NORESERVE so that only the touched pages cost memory. The address
+     * is a hint: if the kernel moves us, allocations are still reproducible
+     * relative to the arena, and games run with ASLR disabled anyway. */
+    void* addr = mmap(ARENA_ADDR, ARENA_SIZE, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (addr == MAP_FAILED)
+        return false;
+
+    arena_start = static_cast<char*>(addr);
+    arena_cur = arena_start;
+    arena_end = arena_start + ARENA_SIZE;
+    return true;
+}
+
+static int classIndex(size_t size)
+{
+    int ci = MIN_CLASS;
+    while ((size_t(1) << ci) < size)
+        ci++;
+    return ci;
+}
+
+static bool inArena(void *ptr)
+{
+    return arena_start && (static_cast<char*>(ptr) >= arena_start) &&
+        (static_cast<char*>(ptr) < arena_end);
+}
+
+static void *arenaAlloc(size_t size)
+{
+    if (size == 0)
+        size = 1;
+    if (size > (size_t(1) << MAX_CLASS))
+        return nullptr;
+
+    pthread_mutex_lock(&heap_mutex);
+
+    if (!initArena()) {
+        pthread_mutex_unlock(&heap_mutex);
+        return nullptr;
+    }
+
+    int ci = classIndex(size);
+    BlockHeader* header;
+
+    if (free_lists[ci]) {
+        /* Reuse the most recently freed block of this class, and zero it
+         * like a fresh one */
+        void* ptr = free_lists[ci];
+        header = static_cast<BlockHeader*>(ptr) - 1;
+        free_lists[ci] = *static_cast<void**>(ptr);
+        header->size = size;
+        pthread_mutex_unlock(&heap_mutex);
+        memset(ptr, 0, size_t(1) << ci);
+        return ptr;
+    }
+
+    size_t block = sizeof(BlockHeader) + (size_t(1) << ci);
+    if (block > static_cast<size_t>(arena_end - arena_cur)) {
+        pthread_mutex_unlock(&heap_mutex);
+        return nullptr;
+    }
+
+    header = reinterpret_cast<BlockHeader*>(arena_cur);
+    arena_cur += block;
+    header->class_index = ci;
+    header->size = size;
+    pthread_mutex_unlock(&heap_mutex);
+
+    /* Fresh arena pages are already zeroed */
+    return header + 1;
+}
+
+static void arenaFree(void *ptr)
+{
+    BlockHeader* header = static_cast<BlockHeader*>(ptr) - 1;
+    pthread_mutex_lock(&heap_mutex);
+    *static_cast<void**>(ptr) = free_lists[header->class_index];
+    free_lists[header->class_index] = ptr;
+    pthread_mutex_unlock(&heap_mutex);
+}
+
 void *malloc (size_t size) throw()
 {
-    return calloc(1, size);
+    if (shared_config.alloc_profiling)
+        AllocTrace::record(__builtin_return_address(0), size);
+
+    if (shared_config.deterministic_heap) {
+        if (void *ptr = arenaAlloc(size))
+            return ptr;
+    }
+
+    /* We zero the memory, so that games reading uninitialized memory get
+     * deterministic values */
+    return __libc_calloc(1, size ? size : 1);
+}
+
+void *calloc (size_t nmemb, size_t size) throw()
+{
+    if (shared_config.alloc_profiling)
+        AllocTrace::record(__builtin_return_address(0), nmemb * size);
+
+    if (shared_config.deterministic_heap && nmemb && size &&
+        (nmemb <= (size_t(1) << MAX_CLASS) / size)) {
+        if (void *ptr = arenaAlloc(nmemb * size))
+            return ptr;
+    }
+
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc (void *ptr, size_t size) throw()
+{
+    if (shared_config.alloc_profiling)
+        AllocTrace::record(__builtin_return_address(0), size);
+
+    if (!ptr)
+        return malloc(size);
+
+    if (!inArena(ptr))
+        return __libc_realloc(ptr, size);
+
+    BlockHeader* header = static_cast<BlockHeader*>(ptr) - 1;
+
+    if (size == 0) {
+        arenaFree(ptr);
+        return nullptr;
+    }
+
+    /* Staying within the same size class keeps the address, which is both
+     * cheap and layout stable */
+    if ((classIndex(size) == static_cast<int>(header->class_index))) {
+        header->size = size;
+        return ptr;
+    }
+
+    void *newptr = arenaAlloc(size);
+    if (!newptr)
+        newptr = __libc_calloc(1, size);
+    if (!newptr)
+        return nullptr;
+
+    memcpy(newptr, ptr, (size < header->size) ? size : header->size);
+    arenaFree(ptr);
+    return newptr;
+}
+
+void free (void *ptr) throw()
+{
+    if (!ptr)
+        return;
+
+    if (inArena(ptr)) {
+        arenaFree(ptr);
+        return;
+    }
+
+    __libc_free(ptr);
 }
 
 }
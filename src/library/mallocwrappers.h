@@ -27,6 +27,16 @@ namespace libtas {
 /* Allocate SIZE bytes of memory.  */
 OVERRIDE void *malloc (size_t size) throw();
 
+/* Allocate NMEMB elements of SIZE bytes each, all initialized to 0.  */
+OVERRIDE void *calloc (size_t nmemb, size_t size) throw();
+
+/* Re-allocate the previously allocated block in PTR, making the new
+   block SIZE bytes long.  */
+OVERRIDE void *realloc (void *ptr, size_t size) throw();
+
+/* Free a block allocated by `malloc', `realloc' or `calloc'.  */
+OVERRIDE void free (void *ptr) throw();
+
 }
 
 #endif
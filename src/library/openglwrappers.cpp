@@ -121,6 +121,98 @@ DEFINE_ORIG_POINTER(glDrawArraysEXT);
 
 DEFINE_ORIG_POINTER(glBlitFramebuffer);
 
+/* All the draw wrappers used to test skipping_draw on every call, which puts
+ * a conditional on the hottest interception path. Instead, when skipping
+ * toggles at a frame boundary, the orig pointers of every draw function are
+ * swapped to a no-op, and restored afterwards. The wrappers then always call
+ * through the pointer unconditionally.
+ *
+ * All the skipped functions return void, so a common no-op that ignores its
+ * arguments is safe with our calling convention. Unlinked (null) pointers are
+ * also swapped to the no-op, which additionally keeps LINK_NAMESPACE from
+ * resolving the real function in the middle of a skipped frame. */
+static void noopDraw() {}
+
+struct DrawDispatchEntry {
+    void** slot;
+    void* saved;
+};
+
+#define DRAW_DISPATCH(FUNC) { reinterpret_cast<void**>(&orig::FUNC), nullptr }
+
+static DrawDispatchEntry drawDispatchTable[] = {
+    DRAW_DISPATCH(glClear),
+    DRAW_DISPATCH(glBegin),
+    DRAW_DISPATCH(glEnd),
+    DRAW_DISPATCH(glVertex2d),
+    DRAW_DISPATCH(glVertex2f),
+    DRAW_DISPATCH(glVertex2i),
+    DRAW_DISPATCH(glVertex2s),
+    DRAW_DISPATCH(glVertex3d),
+    DRAW_DISPATCH(glVertex3f),
+    DRAW_DISPATCH(glVertex3i),
+    DRAW_DISPATCH(glVertex3s),
+    DRAW_DISPATCH(glVertex4d),
+    DRAW_DISPATCH(glVertex4f),
+    DRAW_DISPATCH(glVertex4i),
+    DRAW_DISPATCH(glVertex4s),
+    DRAW_DISPATCH(glVertex2dv),
+    DRAW_DISPATCH(glVertex2fv),
+    DRAW_DISPATCH(glVertex2iv),
+    DRAW_DISPATCH(glVertex2sv),
+    DRAW_DISPATCH(glVertex3dv),
+    DRAW_DISPATCH(glVertex3fv),
+    DRAW_DISPATCH(glVertex3iv),
+    DRAW_DISPATCH(glVertex3sv),
+    DRAW_DISPATCH(glVertex4dv),
+    DRAW_DISPATCH(glVertex4fv),
+    DRAW_DISPATCH(glVertex4iv),
+    DRAW_DISPATCH(glVertex4sv),
+    DRAW_DISPATCH(glDrawArrays),
+    DRAW_DISPATCH(glDrawElements),
+    DRAW_DISPATCH(glMultiDrawArrays),
+    DRAW_DISPATCH(glMultiDrawElements),
+    DRAW_DISPATCH(glDrawRangeElements),
+    DRAW_DISPATCH(glDrawElementsBaseVertex),
+    DRAW_DISPATCH(glDrawRangeElementsBaseVertex),
+    DRAW_DISPATCH(glDrawElementsInstancedBaseVertex),
+    DRAW_DISPATCH(glMultiDrawElementsBaseVertex),
+    DRAW_DISPATCH(glDrawArraysInstancedBaseInstance),
+    DRAW_DISPATCH(glDrawElementsInstancedBaseInstance),
+    DRAW_DISPATCH(glDrawElementsInstancedBaseVertexBaseInstance),
+    DRAW_DISPATCH(glDrawTransformFeedback),
+    DRAW_DISPATCH(glDrawTransformFeedbackStream),
+    DRAW_DISPATCH(glDrawTransformFeedbackInstanced),
+    DRAW_DISPATCH(glDrawTransformFeedbackStreamInstanced),
+    DRAW_DISPATCH(glDrawArraysInstancedARB),
+    DRAW_DISPATCH(glDrawElementsInstancedARB),
+    DRAW_DISPATCH(glDrawArraysInstancedEXT),
+    DRAW_DISPATCH(glDrawElementsInstancedEXT),
+    DRAW_DISPATCH(glDrawRangeElementsEXT),
+    DRAW_DISPATCH(glMultiDrawArraysEXT),
+    DRAW_DISPATCH(glMultiDrawElementsEXT),
+    DRAW_DISPATCH(glDrawArraysEXT),
+    DRAW_DISPATCH(glBlitFramebuffer),
+};
+
+void setDrawSkipping(bool skipping)
+{
+    static bool draw_skipping = false;
+    if (skipping == draw_skipping)
+        return;
+    draw_skipping = skipping;
+
+    for (auto& entry : drawDispatchTable) {
+        if (skipping) {
+            entry.saved = *entry.slot;
+            *entry.slot = reinterpret_cast<void*>(noopDraw);
+        }
+        else {
+            *entry.slot = entry.saved;
+        }
+    }
+}
+
 void checkMesa()
 {
     /* Check only once */
@@ -415,15 +507,13 @@ void glClear(GLbitfield mask)
 {
     DEBUGLOGCALL(LCF_OGL);
     LINK_NAMESPACE(glClear, "GL");
-    if (!skipping_draw)
-        return orig::glClear(mask);
+    return orig::glClear(mask);
 }
 
 void myglClear(GLbitfield mask)
 {
     DEBUGLOGCALL(LCF_OGL);
-    if (!skipping_draw)
-        return orig::glClear(mask);
+    return orig::glClear(mask);
 }
 
 
@@ -431,176 +521,154 @@ void glBegin(GLenum mode)
 {
     DEBUGLOGCALL(LCF_OGL);
     LINK_NAMESPACE(glBegin, "GL");
-    if (!skipping_draw)
-        return orig::glBegin(mode);
+    return orig::glBegin(mode);
 }
 
 void glEnd(void)
 {
     DEBUGLOGCALL(LCF_OGL);
     LINK_NAMESPACE(glEnd, "GL");
-    if (!skipping_draw)
-        return orig::glEnd();
+    return orig::glEnd();
 }
 
 void glVertex2d( GLdouble x, GLdouble y )
 {
     DEBUGLOGCALL(LCF_OGL);
     LINK_NAMESPACE(glVertex2d, "GL");
-    if (!skipping_draw)
-        return orig::glVertex2d(x, y);
+    return orig::glVertex2d(x, y);
 }
 
 void glVertex2f( GLfloat x, GLfloat y )
 {
     DEBUGLOGCALL(LCF_OGL);
     LINK_NAMESPACE(glVertex2f, "GL");
-    if (!skipping_draw)
-        return orig::glVertex2f(x, y);
+    return orig::glVertex2f(x, y);
 }
 
 void glVertex2i( GLint x, GLint y )
 {
     DEBUGLOGCALL(LCF_OGL);
     LINK_NAMESPACE(glVertex2i, "GL");
-    if (!skipping_draw)
-        return orig::glVertex2i(x, y);
+    return orig::glVertex2i(x, y);
 }
 
 void glVertex2s( GLshort x, GLshort y )
 {
     DEBUGLOGCALL(LCF_OGL);
     LINK_NAMESPACE(glVertex2s, "GL");
-    if (!skipping_draw)
-        return orig::glVertex2s(x, y);
+    return orig::glVertex2s(x, y);
 }
 
 void glVertex3d( GLdouble x, GLdouble y, GLdouble z )
 {
     DEBUGLOGCALL(LCF_OGL);
     LINK_NAMESPACE(glVertex3d, "GL");
-    if (!skipping_draw)
-        return orig::glVertex3d(x, y, z);
+    return orig::glVertex3d(x, y, z);
 }
 
 void glVertex3f( GLfloat x, GLfloat y, GLfloat z )
 {
     DEBUGLOGCALL(LCF_OGL);
     LINK_NAMESPACE(glVertex3f, "GL");
-    if (!skipping_draw)
-        return orig::glVertex3f(x, y, z);
+    return orig::glVertex3f(x, y, z);
 }
 
 void glVertex3i( GLint x, GLint y, GLint z )
 {
     DEBUGLOGCALL(LCF_OGL);
     LINK_NAMESPACE(glVertex3i, "GL");
-    if (!skipping_draw)
-        return orig::glVertex3i(x, y, z);
+    return orig::glVertex3i(x, y, z);
 }
 
 void glVertex3s( GLshort x, GLshort y, GLshort z )
 {
     DEBUGLOGCALL(LCF_OGL);
     LINK_NAMESPACE(glVertex3s, "GL");
-    if (!skipping_draw)
-        return orig::glVertex3s(x, y, z);
+    return orig::glVertex3s(x, y, z);
 }
 
 void glVertex4d( GLdouble x, GLdouble y, GLdouble z, GLdouble w )
 {
     DEBUGLOGCALL(LCF_OGL);
     LINK_NAMESPACE(glVertex4d, "GL");
-    if (!skipping_draw)
-        return orig::glVertex4d(x, y, z, w);
+    return orig::glVertex4d(x, y, z, w);
 }
 
 void glVertex4f( GLfloat x, GLfloat y, GLfloat z, GLfloat w )
 {
     DEBUGLOGCALL(LCF_OGL);
     LINK_NAMESPACE(glVertex4f, "GL");
-    if (!skipping_draw)
-        return orig::glVertex4f(x, y, z, w);
+    return orig::glVertex4f(x, y, z, w);
 }
 
 void glVertex4i( GLint x, GLint y, GLint z, GLint w )
 {
     DEBUGLOGCALL(LCF_OGL);
     LINK_NAMESPACE(glVertex4i, "GL");
-    if (!skipping_draw)
-        return orig::glVertex4i(x, y, z, w);
+    return orig::glVertex4i(x, y, z, w);
 }
 
 void glVertex4s( GLshort x, GLshort y, GLshort z, GLshort w )
 {
     DEBUGLOGCALL(LCF_OGL);
     LINK_NAMESPACE(glVertex4s, "GL");
-    if (!skipping_draw)
-        return orig::glVertex4s(x, y, z, w);
+    return orig::glVertex4s(x, y, z, w);
 }
 
 void glVertex2dv( const GLdouble *v )
 {
     DEBUGLOGCALL(LCF_OGL);
     LINK_NAMESPACE(glVertex2dv, "GL");
-    if (!skipping_draw)
-        return orig::glVertex2dv(v);
+    return orig::glVertex2dv(v);
 }
 
 void glVertex2fv( const GLfloat *v )
 {
     DEBUGLOGCALL(LCF_OGL);
     LINK_NAMESPACE(glVertex2fv, "GL");
-    if (!skipping_draw)
-        return orig::glVertex2fv(v);
+    return orig::glVertex2fv(v);
 }
 
 void glVertex2iv( const GLint *v )
 {
     DEBUGLOGCALL(LCF_OGL);
     LINK_NAMESPACE(glVertex2iv, "GL");
-    if (!skipping_draw)
-        return orig::glVertex2iv(v);
+    return orig::glVertex2iv(v);
 }
 
 void glVertex2sv( const GLshort *v )
 {
     DEBUGLOGCALL(LCF_OGL);
     LINK_NAMESPACE(glVertex2sv, "GL");
-    if (!skipping_draw)
-        return orig::glVertex2sv(v);
+    return orig::glVertex2sv(v);
 }
 
 void glVertex3dv( const GLdouble *v )
 {
     DEBUGLOGCALL(LCF_OGL);
     LINK_NAMESPACE(glVertex3dv, "GL");
-    if (!skipping_draw)
-        return orig::glVertex3dv(v);
+    return orig::glVertex3dv(v);
 }
 
 void glVertex3fv( const GLfloat *v )
 {
     DEBUGLOGCALL(LCF_OGL);
     LINK_NAMESPACE(glVertex3fv, "GL");
-    if (!skipping_draw)
-        return orig::glVertex3fv(v);
+    return orig::glVertex3fv(v);
 }
 
 void glVertex3iv( const GLint *v )
 {
     DEBUGLOGCALL(LCF_OGL);
     LINK_NAMESPACE(glVertex3iv, "GL");
-    if (!skipping_draw)
-        return orig::glVertex3iv(v);
+    return orig::glVertex3iv(v);
 }
 
 void glVertex3sv( const GLshort *v )
 {
     DEBUGLOGCALL(LCF_OGL);
     LINK_NAMESPACE(glVertex3sv, "GL");
-    if (!skipping_draw)
-        return orig::glVertex3sv(v);
+    return orig::glVertex3sv(v);
 }
 
 
@@ -608,231 +676,199 @@ void glVertex4dv( const GLdouble *v )
 {
     DEBUGLOGCALL(LCF_OGL);
     LINK_NAMESPACE(glVertex4dv, "GL");
-    if (!skipping_draw)
-        return orig::glVertex4dv(v);
+    return orig::glVertex4dv(v);
 }
 
 void glVertex4fv( const GLfloat *v )
 {
     DEBUGLOGCALL(LCF_OGL);
     LINK_NAMESPACE(glVertex4fv, "GL");
-    if (!skipping_draw)
-        return orig::glVertex4fv(v);
+    return orig::glVertex4fv(v);
 }
 
 void glVertex4iv( const GLint *v )
 {
     DEBUGLOGCALL(LCF_OGL);
     LINK_NAMESPACE(glVertex4iv, "GL");
-    if (!skipping_draw)
-        return orig::glVertex4iv(v);
+    return orig::glVertex4iv(v);
 }
 
 void glVertex4sv( const GLshort *v )
 {
     DEBUGLOGCALL(LCF_OGL);
     LINK_NAMESPACE(glVertex4sv, "GL");
-    if (!skipping_draw)
-        return orig::glVertex4sv(v);
+    return orig::glVertex4sv(v);
 }
 
 void glDrawArrays( GLenum mode, GLint first, GLsizei count )
 {
     DEBUGLOGCALL(LCF_OGL);
     LINK_NAMESPACE(glDrawArrays, "GL");
-    if (!skipping_draw)
-        return orig::glDrawArrays(mode, first, count);
+    return orig::glDrawArrays(mode, first, count);
 }
 
 void glDrawElements( GLenum mode, GLsizei count, GLenum type, const GLvoid *indices )
 {
     DEBUGLOGCALL(LCF_OGL);
     LINK_NAMESPACE(glDrawElements, "GL");
-    if (!skipping_draw)
-        return orig::glDrawElements(mode, count, type, indices);
+    return orig::glDrawElements(mode, count, type, indices);
 }
 
 void myglDrawArrays( GLenum mode, GLint first, GLsizei count )
 {
     DEBUGLOGCALL(LCF_OGL);
-    if (!skipping_draw)
-        return orig::glDrawArrays(mode, first, count);
+    return orig::glDrawArrays(mode, first, count);
 }
 
 void myglDrawElements( GLenum mode, GLsizei count, GLenum type, const GLvoid *indices )
 {
     DEBUGLOGCALL(LCF_OGL);
-    if (!skipping_draw)
-        return orig::glDrawElements(mode, count, type, indices);
+    return orig::glDrawElements(mode, count, type, indices);
 }
 
 void myglMultiDrawArrays (GLenum mode, const GLint *first, const GLsizei *count, GLsizei drawcount)
 {
     DEBUGLOGCALL(LCF_OGL);
-    if (!skipping_draw)
-        return orig::glMultiDrawArrays(mode, first, count, drawcount);
+    return orig::glMultiDrawArrays(mode, first, count, drawcount);
 }
 
 void myglMultiDrawElements (GLenum mode, const GLsizei *count, GLenum type, const void *const*indices, GLsizei drawcount)
 {
     DEBUGLOGCALL(LCF_OGL);
-    if (!skipping_draw)
-        return orig::glMultiDrawElements(mode, count, type, indices, drawcount);
+    return orig::glMultiDrawElements(mode, count, type, indices, drawcount);
 }
 
 void myglDrawRangeElements (GLenum mode, GLuint start, GLuint end, GLsizei count, GLenum type, const void *indices)
 {
     DEBUGLOGCALL(LCF_OGL);
-    if (!skipping_draw)
-        return orig::glDrawRangeElements(mode, start, end, count, type, indices);
+    return orig::glDrawRangeElements(mode, start, end, count, type, indices);
 }
 
 void myglDrawElementsBaseVertex (GLenum mode, GLsizei count, GLenum type, const void *indices, GLint basevertex)
 {
     DEBUGLOGCALL(LCF_OGL);
-    if (!skipping_draw)
-        return orig::glDrawElementsBaseVertex(mode, count, type, indices, basevertex);
+    return orig::glDrawElementsBaseVertex(mode, count, type, indices, basevertex);
 }
 
 void myglDrawRangeElementsBaseVertex (GLenum mode, GLuint start, GLuint end, GLsizei count, GLenum type, const void *indices, GLint basevertex)
 {
     DEBUGLOGCALL(LCF_OGL);
-    if (!skipping_draw)
-        return orig::glDrawRangeElementsBaseVertex(mode, start, end, count, type, indices, basevertex);
+    return orig::glDrawRangeElementsBaseVertex(mode, start, end, count, type, indices, basevertex);
 }
 
 void myglDrawElementsInstancedBaseVertex (GLenum mode, GLsizei count, GLenum type, const void *indices, GLsizei instancecount, GLint basevertex)
 {
     DEBUGLOGCALL(LCF_OGL);
-    if (!skipping_draw)
-        return orig::glDrawElementsInstancedBaseVertex(mode, count, type, indices, instancecount, basevertex);
+    return orig::glDrawElementsInstancedBaseVertex(mode, count, type, indices, instancecount, basevertex);
 }
 
 void myglMultiDrawElementsBaseVertex (GLenum mode, const GLsizei *count, GLenum type, const void *const*indices, GLsizei drawcount, const GLint *basevertex)
 {
     DEBUGLOGCALL(LCF_OGL);
-    if (!skipping_draw)
-        return orig::glMultiDrawElementsBaseVertex(mode, count, type, indices, drawcount, basevertex);
+    return orig::glMultiDrawElementsBaseVertex(mode, count, type, indices, drawcount, basevertex);
 }
 
 void myglDrawArraysInstancedBaseInstance (GLenum mode, GLint first, GLsizei count, GLsizei instancecount, GLuint baseinstance)
 {
     DEBUGLOGCALL(LCF_OGL);
-    if (!skipping_draw)
-        return orig::glDrawArraysInstancedBaseInstance(mode, first, count, instancecount, baseinstance);
+    return orig::glDrawArraysInstancedBaseInstance(mode, first, count, instancecount, baseinstance);
 }
 
 void myglDrawElementsInstancedBaseInstance (GLenum mode, GLsizei count, GLenum type, const void *indices, GLsizei instancecount, GLuint baseinstance)
 {
     DEBUGLOGCALL(LCF_OGL);
-    if (!skipping_draw)
-        return orig::glDrawElementsInstancedBaseInstance(mode, count, type, indices, instancecount, baseinstance);
+    return orig::glDrawElementsInstancedBaseInstance(mode, count, type, indices, instancecount, baseinstance);
 }
 
 void myglDrawElementsInstancedBaseVertexBaseInstance (GLenum mode, GLsizei count, GLenum type, const void *indices, GLsizei instancecount, GLint basevertex, GLuint baseinstance)
 {
     DEBUGLOGCALL(LCF_OGL);
-    if (!skipping_draw)
-        return orig::glDrawElementsInstancedBaseVertexBaseInstance(mode, count, type, indices, instancecount, basevertex, baseinstance);
+    return orig::glDrawElementsInstancedBaseVertexBaseInstance(mode, count, type, indices, instancecount, basevertex, baseinstance);
 }
 
 void myglDrawTransformFeedback (GLenum mode, GLuint id)
 {
     DEBUGLOGCALL(LCF_OGL);
-    if (!skipping_draw)
-        return orig::glDrawTransformFeedback(mode, id);
+    return orig::glDrawTransformFeedback(mode, id);
 }
 
 void myglDrawTransformFeedbackStream (GLenum mode, GLuint id, GLuint stream)
 {
     DEBUGLOGCALL(LCF_OGL);
-    if (!skipping_draw)
-        return orig::glDrawTransformFeedbackStream(mode, id, stream);
+    return orig::glDrawTransformFeedbackStream(mode, id, stream);
 }
 
 void myglDrawTransformFeedbackInstanced (GLenum mode, GLuint id, GLsizei instancecount)
 {
     DEBUGLOGCALL(LCF_OGL);
-    if (!skipping_draw)
-        return orig::glDrawTransformFeedbackInstanced(mode, id, instancecount);
+    return orig::glDrawTransformFeedbackInstanced(mode, id, instancecount);
 }
 
 void myglDrawTransformFeedbackStreamInstanced (GLenum mode, GLuint id, GLuint stream, GLsizei instancecount)
 {
     DEBUGLOGCALL(LCF_OGL);
-    if (!skipping_draw)
-        return orig::glDrawTransformFeedbackStreamInstanced(mode, id, stream, instancecount);
+    return orig::glDrawTransformFeedbackStreamInstanced(mode, id, stream, instancecount);
 }
 
 void myglDrawArraysInstancedARB (GLenum mode, GLint first, GLsizei count, GLsizei primcount)
 {
     DEBUGLOGCALL(LCF_OGL);
-    if (!skipping_draw)
-        return orig::glDrawArraysInstancedARB(mode, first, count, primcount);
+    return orig::glDrawArraysInstancedARB(mode, first, count, primcount);
 }
 
 void myglDrawElementsInstancedARB (GLenum mode, GLsizei count, GLenum type, const void *indices, GLsizei primcount)
 {
     DEBUGLOGCALL(LCF_OGL);
-    if (!skipping_draw)
-        return orig::glDrawElementsInstancedARB(mode, count, type, indices, primcount);
+    return orig::glDrawElementsInstancedARB(mode, count, type, indices, primcount);
 }
 
 void myglDrawArraysInstancedEXT (GLenum mode, GLint start, GLsizei count, GLsizei primcount)
 {
     DEBUGLOGCALL(LCF_OGL);
-    if (!skipping_draw)
-        return orig::glDrawArraysInstancedEXT(mode, start, count, primcount);
+    return orig::glDrawArraysInstancedEXT(mode, start, count, primcount);
 }
 
 void myglDrawElementsInstancedEXT (GLenum mode, GLsizei count, GLenum type, const void *indices, GLsizei primcount)
 {
     DEBUGLOGCALL(LCF_OGL);
-    if (!skipping_draw)
-        return orig::glDrawElementsInstancedEXT(mode, count, type, indices, primcount);
+    return orig::glDrawElementsInstancedEXT(mode, count, type, indices, primcount);
 }
 
 void myglDrawRangeElementsEXT (GLenum mode, GLuint start, GLuint end, GLsizei count, GLenum type, const void *indices)
 {
     DEBUGLOGCALL(LCF_OGL);
-    if (!skipping_draw)
-        return orig::glDrawRangeElementsEXT(mode, start, end, count, type, indices);
+    return orig::glDrawRangeElementsEXT(mode, start, end, count, type, indices);
 }
 
 void myglMultiDrawArraysEXT (GLenum mode, const GLint *first, const GLsizei *count, GLsizei primcount)
 {
     DEBUGLOGCALL(LCF_OGL);
-    if (!skipping_draw)
-        return orig::glMultiDrawArraysEXT(mode, first, count, primcount);
+    return orig::glMultiDrawArraysEXT(mode, first, count, primcount);
 }
 
 void myglMultiDrawElementsEXT (GLenum mode, const GLsizei *count, GLenum type, const void *const*indices, GLsizei primcount)
 {
     DEBUGLOGCALL(LCF_OGL);
-    if (!skipping_draw)
-        return orig::glMultiDrawElementsEXT(mode, count, type, indices, primcount);
+    return orig::glMultiDrawElementsEXT(mode, count, type, indices, primcount);
 }
 
 void myglDrawArraysEXT (GLenum mode, GLint first, GLsizei count)
 {
     DEBUGLOGCALL(LCF_OGL);
-    if (!skipping_draw)
-        return orig::glDrawArraysEXT(mode, first, count);
+    return orig::glDrawArraysEXT(mode, first, count);
 }
 
 void glBlitFramebuffer (GLint srcX0, GLint srcY0, GLint srcX1, GLint srcY1, GLint dstX0, GLint dstY0, GLint dstX1, GLint dstY1, GLbitfield mask, GLenum filter)
 {
     DEBUGLOGCALL(LCF_OGL);
     LINK_NAMESPACE(glBlitFramebuffer, "GL");
-    if (!skipping_draw)
-        return orig::glBlitFramebuffer(srcX0, srcY0, srcX1, srcY1, dstX0, dstY0, dstX1, dstY1, mask, filter);
+    return orig::glBlitFramebuffer(srcX0, srcY0, srcX1, srcY1, dstX0, dstY0, dstX1, dstY1, mask, filter);
 }
 
 void myglBlitFramebuffer (GLint srcX0, GLint srcY0, GLint srcX1, GLint srcY1, GLint dstX0, GLint dstY0, GLint dstX1, GLint dstY1, GLbitfield mask, GLenum filter)
 {
     DEBUGLOGCALL(LCF_OGL);
-    if (!skipping_draw)
-        return orig::glBlitFramebuffer(srcX0, srcY0, srcX1, srcY1, dstX0, dstY0, dstX1, dstY1, mask, filter);
+    return orig::glBlitFramebuffer(srcX0, srcY0, srcX1, srcY1, dstX0, dstY0, dstX1, dstY1, mask, filter);
 }
 
 }
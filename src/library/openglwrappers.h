@@ -31,6 +31,11 @@ namespace libtas {
 
 void checkMesa();
 
+/* Swap the draw function pointers between the real functions and a no-op,
+ * so that draw skipping does not cost a conditional in every wrapper.
+ * Called at the frame boundary when the skipping state changes. */
+void setDrawSkipping(bool skipping);
+
 OVERRIDE void(*glXGetProcAddress (const GLubyte *procName))();
 OVERRIDE __GLXextFuncPtr glXGetProcAddressARB (const GLubyte *procName);
 OVERRIDE void* glXGetProcAddressEXT (const GLubyte *procName);
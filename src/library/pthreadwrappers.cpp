@@ -502,14 +502,17 @@ static void *pthread_start(void *arg)
 /* Override */ int pthread_setcancelstate (int state, int *oldstate)
 {
     LINK_NAMESPACE(pthread_setcancelstate, "pthread");
-    DEBUGLOGCALL(LCF_THREAD | LCF_TODO);
+    /* Called around every cancellable operation by some engines, so use the
+     * inline-gated logging shell instead of DEBUGLOGCALL, which always pays
+     * an out-of-line call. Same in the other hot wrappers below. */
+    debuglog(LCF_THREAD | LCF_TODO, __func__, " call.");
     return orig::pthread_setcancelstate(state, oldstate);
 }
 
 /* Override */ int pthread_setcanceltype (int type, int *oldtype)
 {
     LINK_NAMESPACE(pthread_setcanceltype, "pthread");
-    DEBUGLOGCALL(LCF_THREAD | LCF_TODO);
+    debuglog(LCF_THREAD | LCF_TODO, __func__, " call.");
     return orig::pthread_setcanceltype(type, oldtype);
 }
 
@@ -523,7 +526,7 @@ static void *pthread_start(void *arg)
 /* Override */ void pthread_testcancel (void)
 {
     LINK_NAMESPACE(pthread_testcancel, "pthread");
-    DEBUGLOGCALL(LCF_THREAD | LCF_TODO);
+    debuglog(LCF_THREAD | LCF_TODO, __func__, " call.");
     return orig::pthread_testcancel();
 }
 
@@ -533,7 +536,7 @@ int sem_timedwait (sem_t * sem, const struct timespec *abstime)
     if (GlobalState::isNative())
         return orig::sem_timedwait(sem, abstime);
 
-    DEBUGLOGCALL(LCF_THREAD | LCF_TODO);
+    debuglog(LCF_THREAD | LCF_TODO, __func__, " call.");
     return orig::sem_timedwait(sem, abstime);
 }
 
@@ -543,7 +546,7 @@ int sem_trywait (sem_t *sem) throw()
     if (GlobalState::isNative())
         return orig::sem_trywait(sem);
 
-    DEBUGLOGCALL(LCF_THREAD | LCF_TODO);
+    debuglog(LCF_THREAD | LCF_TODO, __func__, " call.");
     return orig::sem_trywait(sem);
 }
 
@@ -20,9 +20,98 @@
 #include "randomwrappers.h"
 #include "logging.h"
 #include "hook.h"
+#include <atomic>
+#include <cstdint>
 
 namespace libtas {
 
+/* Optional in-library generator behind rand()/random(). Procedural
+ * generation games call rand() millions of times during level builds, and
+ * paying the wrapper plus the libc call on each adds up. When fast_prng is
+ * set, the wrappers serve values from a thread-local buffer refilled by
+ * four interleaved xoshiro256++ streams: the independent lanes let the
+ * compiler vectorize the refill loop, and the per-call cost drops to a
+ * buffer read. The sequence differs from libc but is bit-exact across
+ * replays, which is all determinism needs.
+ *
+ * Each thread derives its own streams from the last srand()/srandom() seed
+ * and a per-thread counter, so threads never contend. Games mixing this
+ * with initstate()/setstate() keep the libc behavior by leaving the option
+ * off. */
+
+static const int PRNG_LANES = 4;
+static const int PRNG_BATCH = 64;
+
+/* Seed shared by all threads, and a generation counter so that running
+ * threads pick up a reseed */
+static uint32_t prng_seed = 1;
+static std::atomic<uint32_t> prng_generation(1);
+static std::atomic<uint32_t> prng_streams(0);
+
+static thread_local uint64_t prng_state[4][PRNG_LANES];
+static thread_local long int prng_buf[PRNG_BATCH];
+static thread_local int prng_buf_pos = PRNG_BATCH;
+static thread_local uint32_t prng_seen_generation = 0;
+
+static uint64_t splitmix64(uint64_t &x)
+{
+    x += 0x9e3779b97f4a7c15ULL;
+    uint64_t z = x;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static inline uint64_t rotl64(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+/* Refill the thread buffer, reseeding the streams first if the seed is
+ * stale. Called outside the hot path, once per PRNG_BATCH values */
+static void refillPrng(void)
+{
+    const uint32_t generation = prng_generation.load(std::memory_order_relaxed);
+    if (prng_seen_generation != generation) {
+        /* Expand the seed and a unique stream number into the lane states */
+        uint64_t x = (static_cast<uint64_t>(prng_seed) << 32)
+            ^ prng_streams.fetch_add(1, std::memory_order_relaxed);
+        for (int l = 0; l < PRNG_LANES; l++)
+            for (int w = 0; w < 4; w++)
+                prng_state[w][l] = splitmix64(x);
+        prng_seen_generation = generation;
+    }
+
+    for (int i = 0; i < PRNG_BATCH; i += PRNG_LANES) {
+        /* One xoshiro256++ step per lane. The lanes are independent, so
+         * this loop vectorizes */
+        for (int l = 0; l < PRNG_LANES; l++) {
+            const uint64_t result = rotl64(prng_state[0][l] + prng_state[3][l], 23)
+                + prng_state[0][l];
+            const uint64_t t = prng_state[1][l] << 17;
+            prng_state[2][l] ^= prng_state[0][l];
+            prng_state[3][l] ^= prng_state[1][l];
+            prng_state[1][l] ^= prng_state[2][l];
+            prng_state[0][l] ^= prng_state[3][l];
+            prng_state[2][l] ^= t;
+            prng_state[3][l] = rotl64(prng_state[3][l], 45);
+
+            /* Both rand() and random() return values in [0, 2^31-1] */
+            prng_buf[i + l] = static_cast<long int>(result & 0x7fffffff);
+        }
+    }
+    prng_buf_pos = 0;
+}
+
+static inline long int nextPrng(void)
+{
+    /* Refill on an empty buffer, and drop buffered values on a reseed */
+    if ((prng_buf_pos == PRNG_BATCH) ||
+        (prng_seen_generation != prng_generation.load(std::memory_order_relaxed)))
+        refillPrng();
+    return prng_buf[prng_buf_pos++];
+}
+
 DEFINE_ORIG_POINTER(random)
 DEFINE_ORIG_POINTER(srandom)
 DEFINE_ORIG_POINTER(initstate)
@@ -56,6 +145,8 @@ DEFINE_ORIG_POINTER(lcong48_r)
 /* Override */ long int random (void) throw()
 {
     static int count = 0;
+    if (shared_config.fast_prng)
+        return nextPrng();
     LINK_NAMESPACE_GLOBAL(random);
     long int ret = orig::random();
     debuglog(LCF_RANDOM, __func__, " call ", count++, ", returning ", ret);
@@ -65,6 +156,11 @@ DEFINE_ORIG_POINTER(lcong48_r)
 /* Override */ void srandom (unsigned int seed) throw()
 {
     debuglog(LCF_RANDOM, __func__, " call with seed ", seed);
+    if (shared_config.fast_prng) {
+        prng_seed = seed;
+        prng_generation.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
     LINK_NAMESPACE_GLOBAL(srandom);
     return orig::srandom(seed);
 }
@@ -117,6 +213,8 @@ DEFINE_ORIG_POINTER(lcong48_r)
 /* Override */ int rand (void) throw()
 {
     static int count = 0;
+    if (shared_config.fast_prng)
+        return static_cast<int>(nextPrng());
     LINK_NAMESPACE_GLOBAL(rand);
     int ret = orig::rand();
     debuglog(LCF_RANDOM, __func__, " call ", count++, ", returning ", ret);
@@ -126,6 +224,11 @@ DEFINE_ORIG_POINTER(lcong48_r)
 /* Override */ void srand (unsigned int seed) throw()
 {
     debuglog(LCF_RANDOM, __func__, " call with seed ", seed);
+    if (shared_config.fast_prng) {
+        prng_seed = seed;
+        prng_generation.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
     LINK_NAMESPACE_GLOBAL(srand);
     return orig::srand(seed);
 }
@@ -23,6 +23,7 @@
 #include "../logging.h"
 #include "../hook.h"
 #include <sstream>
+#include <cstring> // memcmp, memset
 #include "../global.h" // shared_config
 #include <fontconfig/fontconfig.h>
 // #include <X11/keysym.h>
@@ -130,15 +131,40 @@ void RenderHUD::initFonts(const char* path)
     TTF_SetFontOutline(bg_font, outline_size);
 }
 
-std::unique_ptr<SurfaceARGB> RenderHUD::createTextSurface(const char* text, Color fg_color, Color bg_color)
+uint64_t RenderHUD::packColors(Color fg_color, Color bg_color)
 {
+    const uint32_t fg = (fg_color.r << 24) | (fg_color.g << 16) | (fg_color.b << 8) | fg_color.a;
+    const uint32_t bg = (bg_color.r << 24) | (bg_color.g << 16) | (bg_color.b << 8) | bg_color.a;
+    return (static_cast<uint64_t>(fg) << 32) | bg;
+}
+
+SurfaceARGB* RenderHUD::createTextSurface(const char* text, Color fg_color, Color bg_color)
+{
+    const uint64_t colors = packColors(fg_color, bg_color);
+
+    /* Look for an already rendered surface, and move it in front. The cache
+     * holds few entries, so a linear scan is cheaper than maintaining an
+     * index next to the list */
+    for (auto iter = text_cache.begin(); iter != text_cache.end(); iter++) {
+        if ((iter->colors == colors) && (iter->text == text)) {
+            text_cache.splice(text_cache.begin(), text_cache, iter);
+            return text_cache.front().surf.get();
+        }
+    }
+
     std::unique_ptr<SurfaceARGB> fg_surf = TTF_RenderText_Blended(fg_font, text, fg_color);
     std::unique_ptr<SurfaceARGB> bg_surf = TTF_RenderText_Blended(bg_font, text, bg_color);
 
     /* Blit text onto its outline. */
     bg_surf->blit(fg_surf.get(), outline_size, outline_size);
 
-    return bg_surf;
+    text_cache.push_front({text, colors, std::move(bg_surf)});
+
+    /* Evict the least recently used surfaces */
+    while (text_cache.size() > TEXT_CACHE_SIZE)
+        text_cache.pop_back();
+
+    return text_cache.front().surf.get();
 }
 
 void RenderHUD::locationToCoords(int location, int& x, int& y)
@@ -173,6 +199,72 @@ void RenderHUD::resetOffsets()
     memset(offsets, 0, 9 * sizeof(int));
 }
 
+bool RenderHUD::setCompositeTarget()
+{
+    const int psize = ScreenCapture::getPixelLayout(composite_roff, composite_goff, composite_boff);
+    if (psize < 0)
+        return false;
+    composite_psize = psize;
+
+    /* Bring the stored pixels up to date with the rendered frame */
+    ScreenCapture::getPixels(&composite_pixels, true);
+    ScreenCapture::getDimensions(composite_w, composite_h);
+    return composite_pixels != nullptr;
+}
+
+void RenderHUD::clearCompositeTarget()
+{
+    composite_pixels = nullptr;
+}
+
+void RenderHUD::drawText(const char* text, Color fg_color, Color bg_color, int x, int y)
+{
+    if (composite_pixels) {
+        compositeSurface(createTextSurface(text, fg_color, bg_color), x, y);
+        return;
+    }
+    renderText(text, fg_color, bg_color, x, y);
+}
+
+void RenderHUD::compositeSurface(SurfaceARGB* surf, int x, int y)
+{
+    for (int j = 0; j < surf->h; j++) {
+        const int ty = y + j;
+        if ((ty < 0) || (ty >= composite_h))
+            continue;
+
+        const uint32_t* src = surf->pixels.data() + j * surf->w;
+        uint8_t* dst_row = composite_pixels + static_cast<size_t>(ty) * composite_w * composite_psize;
+
+        for (int i = 0; i < surf->w; i++) {
+            const int tx = x + i;
+            if ((tx < 0) || (tx >= composite_w))
+                continue;
+
+            const uint32_t s = src[i];
+            const int alpha = s >> 24;
+            if (alpha == 0)
+                continue;
+
+            uint8_t* d = dst_row + static_cast<size_t>(tx) * composite_psize;
+            const int sr = (s >> 16) & 0xff;
+            const int sg = (s >> 8) & 0xff;
+            const int sb = s & 0xff;
+            if (alpha == 0xFF) {
+                d[composite_roff] = sr;
+                d[composite_goff] = sg;
+                d[composite_boff] = sb;
+            }
+            else {
+                /* Same >>8 compositing as SurfaceARGB::blit() */
+                d[composite_roff] = d[composite_roff] + ((sr - d[composite_roff]) * alpha >> 8);
+                d[composite_goff] = d[composite_goff] + ((sg - d[composite_goff]) * alpha >> 8);
+                d[composite_boff] = d[composite_boff] + ((sb - d[composite_boff]) * alpha >> 8);
+            }
+        }
+    }
+}
+
 void RenderHUD::renderFrame(unsigned long framecount)
 {
     Color fg_color = {255, 255, 255, 0};
@@ -192,7 +284,7 @@ void RenderHUD::renderFrame(unsigned long framecount)
 
     int x, y;
     locationToCoords(shared_config.osd_frame_location, x, y);
-    renderText(framestr.c_str(), fg_color, bg_color, x, y);
+    drawText(framestr.c_str(), fg_color, bg_color, x, y);
 }
 
 void RenderHUD::renderNonDrawFrame(unsigned long nondraw_framecount)
@@ -203,7 +295,7 @@ void RenderHUD::renderNonDrawFrame(unsigned long nondraw_framecount)
 
     int x, y;
     locationToCoords(shared_config.osd_frame_location, x, y);
-    renderText(nondraw_framestr.c_str(), red_color, bg_color, x, y);
+    drawText(nondraw_framestr.c_str(), red_color, bg_color, x, y);
 }
 
 
@@ -219,6 +311,18 @@ void RenderHUD::renderPreviewInputs(AllInputs& ai)
 
 void RenderHUD::renderInputs(AllInputs& ai, Color fg_color)
 {
+    /* The formatted line only depends on the inputs, so rebuild it only
+     * when they changed since the last time we formatted them. The preview
+     * shares the cached line, since only the color differs. */
+    if (input_text_valid && (0 == memcmp(&input_text_ai, &ai, sizeof(AllInputs)))) {
+        if (!input_text.empty()) {
+            int x, y;
+            locationToCoords(shared_config.osd_inputs_location, x, y);
+            drawText(input_text.c_str(), fg_color, {0, 0, 0, 0}, x, y);
+        }
+        return;
+    }
+
     std::ostringstream oss;
 
     /* Restart */
@@ -265,13 +369,16 @@ void RenderHUD::renderInputs(AllInputs& ai, Color fg_color)
         }
     }
 
+    input_text_ai = ai;
+    input_text = oss.str();
+    input_text_valid = true;
+
     /* Render */
     Color bg_color = {0, 0, 0, 0};
-    std::string text = oss.str();
-    if (!text.empty()) {
+    if (!input_text.empty()) {
         int x, y;
         locationToCoords(shared_config.osd_inputs_location, x, y);
-        renderText(text.c_str(), fg_color, bg_color, x, y);
+        drawText(input_text.c_str(), fg_color, bg_color, x, y);
     }
 }
 
@@ -306,7 +413,7 @@ void RenderHUD::renderMessages()
         else {
             int x, y;
             locationToCoords(shared_config.osd_messages_location, x, y);
-            renderText(iter->first.c_str(), fg_color, bg_color, x, y);
+            drawText(iter->first.c_str(), fg_color, bg_color, x, y);
             iter++;
         }
     }
@@ -330,7 +437,7 @@ void RenderHUD::renderWatches()
     for (auto iter = watches.begin(); iter != watches.end(); iter++) {
         int x, y;
         locationToCoords(shared_config.osd_ramwatches_location, x, y);
-        renderText(iter->c_str(), fg_color, bg_color, x, y);
+        drawText(iter->c_str(), fg_color, bg_color, x, y);
     }
 }
 
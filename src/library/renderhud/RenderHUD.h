@@ -96,9 +96,31 @@ class RenderHUD
         /* Reset offsets to 0 */
         void resetOffsets();
 
+        /* Composite the HUD into the captured frame pixels on the CPU
+         * instead of drawing through the rendering API. Refreshes the
+         * captured pixels first, so the target holds the rendered frame.
+         * Returns false when the capture layout is not byte-addressable.
+         * Used while dumping: the burn-in still lands in the video, but
+         * the HUD costs no rendering work in the game's frame. */
+        bool setCompositeTarget();
+        void clearCompositeTarget();
+
     protected:
-        /* Create a texture from a text, using colors for the text and the outline */
-        std::unique_ptr<SurfaceARGB> createTextSurface(const char* text, Color fg_color, Color bg_color);
+        /* Create a surface from a text, using colors for the text and the
+         * outline. Rendered surfaces are cached, keyed on the text and the
+         * colors, so unchanged HUD elements (frame count, inputs, watches)
+         * are not re-shaped through sdl_ttf every frame. The returned
+         * pointer is owned by the cache; it stays valid until at least
+         * TEXT_CACHE_SIZE other strings have been rendered. */
+        SurfaceARGB* createTextSurface(const char* text, Color fg_color, Color bg_color);
+
+        /* Pack both colors into a single value, used as part of cache keys */
+        static uint64_t packColors(Color fg_color, Color bg_color);
+
+        /* Number of rendered strings kept in cache. Must cover all the
+         * elements displayed on one frame, so that a full HUD does not
+         * thrash its own cache */
+        static const size_t TEXT_CACHE_SIZE = 64;
 
     private:
         /* Convert a location into screen coordinates, with an offset if text
@@ -106,6 +128,18 @@ class RenderHUD
          */
         void locationToCoords(int location, int& x, int& y);
 
+        /* Either composite the text on the CPU or hand it to the subclass */
+        void drawText(const char* text, Color fg_color, Color bg_color, int x, int y);
+
+        /* Alpha-blend a rendered text surface into the composite target */
+        void compositeSurface(SurfaceARGB* surf, int x, int y);
+
+        /* Composite target, set while the HUD is burned into the captured
+         * frame instead of drawn on screen */
+        uint8_t* composite_pixels = nullptr;
+        int composite_w, composite_h;
+        int composite_psize, composite_roff, composite_goff, composite_boff;
+
         /* Generic function to display inputs on screen, using fg_color as the
          * text color */
         void renderInputs(AllInputs& ai, Color fg_color);
@@ -119,6 +153,21 @@ class RenderHUD
         /* Location offsets when displaying multiple texts on the same location */
         int offsets[9];
 
+        /* Last formatted inputs line and the inputs it was built from, so
+         * the line is not re-formatted (keysym lookups, stream insertions)
+         * while the inputs stay the same between frames */
+        AllInputs input_text_ai;
+        std::string input_text;
+        bool input_text_valid = false;
+
+        /* Rendered text surfaces, most recently used in front */
+        struct CachedText {
+            std::string text;
+            uint64_t colors;
+            std::unique_ptr<SurfaceARGB> surf;
+        };
+        std::list<CachedText> text_cache;
+
         /* Messages to print on screen with the creation time */
         static std::list<std::pair<std::string, TimeHolder>> messages;
 
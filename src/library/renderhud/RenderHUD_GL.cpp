@@ -26,7 +26,7 @@
 
 namespace libtas {
 
-DEFINE_ORIG_POINTER(glGetIntegerv)
+DECLARE_ORIG_POINTER(glGetIntegerv)
 DEFINE_ORIG_POINTER(glGenTextures)
 DEFINE_ORIG_POINTER(glDeleteTextures)
 DEFINE_ORIG_POINTER(glBindTexture)
@@ -43,8 +43,8 @@ DECLARE_ORIG_POINTER(glBlitFramebuffer)
 DEFINE_ORIG_POINTER(glUseProgram)
 DEFINE_ORIG_POINTER(glPixelStorei)
 
-GLuint RenderHUD_GL::texture = 0;
 GLuint RenderHUD_GL::fbo = 0;
+std::list<RenderHUD_GL::CachedTexture> RenderHUD_GL::texture_cache;
 
 RenderHUD_GL::RenderHUD_GL() : RenderHUD() {}
 
@@ -54,7 +54,7 @@ RenderHUD_GL::~RenderHUD_GL() {
 
 void RenderHUD_GL::init()
 {
-    if (texture == 0) {
+    if (fbo == 0) {
         LINK_NAMESPACE(glGenTextures, "GL");
         LINK_NAMESPACE(glGetIntegerv, "GL");
         LINK_NAMESPACE(glActiveTexture, "GL");
@@ -66,40 +66,58 @@ void RenderHUD_GL::init()
         LINK_NAMESPACE(glFramebufferTexture2D, "GL");
         LINK_NAMESPACE(glDeleteFramebuffers, "GL");
 
-
-        /* Get previous active texture */
-        GLint oldTex;
-        orig::glGetIntegerv(GL_TEXTURE_BINDING_2D, &oldTex);
-        GLint oldActiveTex;
-        orig::glGetIntegerv(GL_ACTIVE_TEXTURE, &oldActiveTex);
-
-        orig::glActiveTexture(GL_TEXTURE0);
-        orig::glGenTextures(1, &texture);
-
         orig::glGenFramebuffers(1, &fbo);
-
-        if (oldTex != 0) {
-            orig::glBindTexture(GL_TEXTURE_2D, oldTex);
-        }
-        /* Restore previous active texture */
-        if (oldActiveTex != 0) {
-            orig::glActiveTexture(oldActiveTex);
-        }
     }
 }
 
 void RenderHUD_GL::fini()
 {
-    if (texture != 0) {
-        orig::glDeleteTextures(1, &texture);
-        texture = 0;
+    /* The text textures belong to the destroyed GL context */
+    for (const CachedTexture& entry : texture_cache) {
+        orig::glDeleteTextures(1, &entry.texture);
     }
+    texture_cache.clear();
+
     if (fbo != 0) {
         orig::glDeleteFramebuffers(1, &fbo);
         fbo = 0;
     }
 }
 
+const RenderHUD_GL::CachedTexture* RenderHUD_GL::getTextTexture(const char* text, Color fg_color, Color bg_color)
+{
+    const uint64_t colors = packColors(fg_color, bg_color);
+
+    /* Look for an already uploaded texture, and move it in front */
+    for (auto iter = texture_cache.begin(); iter != texture_cache.end(); iter++) {
+        if ((iter->colors == colors) && (iter->text == text)) {
+            texture_cache.splice(texture_cache.begin(), texture_cache, iter);
+            return &texture_cache.front();
+        }
+    }
+
+    /* Render the text and upload it into a fresh texture */
+    SurfaceARGB* surf = createTextSurface(text, fg_color, bg_color);
+
+    GLuint texture;
+    orig::glGenTextures(1, &texture);
+    orig::glBindTexture(GL_TEXTURE_2D, texture);
+    orig::glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    orig::glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    orig::glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, surf->w, surf->h, 0, GL_BGRA, GL_UNSIGNED_BYTE, surf->pixels.data());
+
+    texture_cache.push_front({text, colors, texture, surf->w, surf->h});
+
+    /* Evict the least recently used textures, using the same bound as the
+     * surface cache */
+    while (texture_cache.size() > TEXT_CACHE_SIZE) {
+        orig::glDeleteTextures(1, &texture_cache.back().texture);
+        texture_cache.pop_back();
+    }
+
+    return &texture_cache.front();
+}
+
 void RenderHUD_GL::renderText(const char* text, Color fg_color, Color bg_color, int x, int y)
 {
     LINK_NAMESPACE(glBindTexture, "GL");
@@ -135,30 +153,23 @@ void RenderHUD_GL::renderText(const char* text, Color fg_color, Color bg_color,
     GLint oldActiveTex;
     orig::glGetIntegerv(GL_ACTIVE_TEXTURE, &oldActiveTex);
 
-    /* Create our text as a texture */
+    /* Get our text as a texture, uploaded on the first frame it appears */
     orig::glActiveTexture(GL_TEXTURE0);
-    orig::glBindTexture(GL_TEXTURE_2D, texture);
+    const CachedTexture* entry = getTextTexture(text, fg_color, bg_color);
 
     orig::glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-
-    std::unique_ptr<SurfaceARGB> surf = createTextSurface(text, fg_color, bg_color);
-
-    orig::glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    orig::glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    orig::glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, surf->w, surf->h, 0, GL_BGRA, GL_UNSIGNED_BYTE, surf->pixels.data());
-    orig::glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+    orig::glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, entry->texture, 0);
 
     /* Blit the textured framebuffer into the screen and flip y-coord */
     int width, height;
     ScreenCapture::getDimensions(width, height);
 
     /* Change the coords so that the text fills on screen */
-    x = (x + surf->w + 5) > width ? (width - surf->w - 5) : x;
-    y = (y + surf->h + 5) > height ? (height - surf->h - 5) : y;
+    x = (x + entry->w + 5) > width ? (width - entry->w - 5) : x;
+    y = (y + entry->h + 5) > height ? (height - entry->h - 5) : y;
 
     orig::glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
-    orig::glBlitFramebuffer(0, 0, surf->w, surf->h, x, height-y, x+surf->w, height-(y+surf->h),
+    orig::glBlitFramebuffer(0, 0, entry->w, entry->h, x, height-y, x+entry->w, height-(y+entry->h),
                       GL_COLOR_BUFFER_BIT, GL_NEAREST);
     orig::glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
 
@@ -42,8 +42,24 @@ class RenderHUD_GL : public RenderHUD
 
         void renderText(const char* text, Color fg_color, Color bg_color, int x, int y);
     private:
-        static GLuint texture;
         static GLuint fbo;
+
+        /* Uploaded text textures, most recently used in front. Unchanged
+         * HUD elements cost one framebuffer blit per frame, without going
+         * through sdl_ttf or glTexImage2D again. Static like the fbo,
+         * because the GL objects belong to the game GL context, not to a
+         * specific instance of this class */
+        struct CachedTexture {
+            std::string text;
+            uint64_t colors;
+            GLuint texture;
+            int w, h;
+        };
+        static std::list<CachedTexture> texture_cache;
+
+        /* Look up or upload the texture for the given text, and return the
+         * cache entry. Assumes texture unit 0 is active */
+        const CachedTexture* getTextTexture(const char* text, Color fg_color, Color bg_color);
 };
 }
 
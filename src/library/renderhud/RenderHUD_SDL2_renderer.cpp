@@ -45,7 +45,7 @@ void RenderHUD_SDL2_renderer::renderText(const char* text, Color fg_color, Color
     LINK_NAMESPACE_SDL2(SDL_CreateTextureFromSurface);
     LINK_NAMESPACE_SDL2(SDL_RenderCopy);
 
-    std::unique_ptr<SurfaceARGB> surf = createTextSurface(text, fg_color, bg_color);
+    SurfaceARGB* surf = createTextSurface(text, fg_color, bg_color);
     SDL_Surface* sdlsurf = orig::SDL_CreateRGBSurfaceFrom(surf->pixels.data(), surf->w, surf->h, 32, surf->pitch, 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
     SDL_Texture* tex = orig::SDL_CreateTextureFromSurface(renderer, sdlsurf);
 
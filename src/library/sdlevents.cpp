@@ -128,26 +128,36 @@ void pushNativeSDLEvents(void)
      * as it is the native function of getting events.
      * i.e. all other functions call this function internally.
      */
+    /* Fetch events in chunks rather than one per call, so draining a busy
+     * native queue costs a few calls into SDL instead of one per event */
+    const int chunk = 64;
+
     int SDLver = get_sdlversion();
     if (SDLver == 1) {
-        SDL1::SDL_Event ev;
-        while (orig::SDL_PeepEvents(reinterpret_cast<SDL_Event*>(&ev), 1, SDL_GETEVENT, SDL1::SDL_ALLEVENTS, 0)) {
-            if (ev.type == SDL1::SDL_QUIT) {
-                is_exiting = true;
+        SDL1::SDL_Event evs[chunk];
+        int nevents;
+        while ((nevents = orig::SDL_PeepEvents(reinterpret_cast<SDL_Event*>(evs), chunk, SDL_GETEVENT, SDL1::SDL_ALLEVENTS, 0)) > 0) {
+            for (int i = 0; i < nevents; i++) {
+                if (evs[i].type == SDL1::SDL_QUIT) {
+                    is_exiting = true;
+                }
+                if (! isBannedEvent(&evs[i]))
+                    sdlEventQueue.insert(&evs[i]);
             }
-            if (! isBannedEvent(&ev))
-                sdlEventQueue.insert(&ev);
         }
     }
 
     if (SDLver == 2) {
-        SDL_Event ev;
-        while (orig::SDL_PeepEvents(&ev, 1, SDL_GETEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT)) {
-            if (ev.type == SDL_QUIT) {
-                is_exiting = true;
+        SDL_Event evs[chunk];
+        int nevents;
+        while ((nevents = orig::SDL_PeepEvents(evs, chunk, SDL_GETEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT)) > 0) {
+            for (int i = 0; i < nevents; i++) {
+                if (evs[i].type == SDL_QUIT) {
+                    is_exiting = true;
+                }
+                if (! isBannedEvent(&evs[i]))
+                    sdlEventQueue.insert(&evs[i]);
             }
-            if (! isBannedEvent(&ev))
-                sdlEventQueue.insert(&ev);
         }
     }
 }
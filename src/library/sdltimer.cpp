@@ -24,6 +24,14 @@
 
 namespace libtas {
 
+/* SDL timers are not emulated: we pass them through to SDL, which services
+ * the callbacks on its own timer thread using real time. Emulating them
+ * deterministically would mean keeping our own timer registry keyed on
+ * deterministic ticks and dispatching expired callbacks at the frame
+ * boundary; until that exists, there is no per-timer bookkeeping here to
+ * optimize. Kept as LCF_TODO below for that reason.
+ */
+
 DECLARE_ORIG_POINTER(SDL_AddTimer);
 DECLARE_ORIG_POINTER(SDL_RemoveTimer);
 
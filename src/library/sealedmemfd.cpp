@@ -0,0 +1,60 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "sealedmemfd.h"
+#include "GlobalState.h"
+
+#include <fcntl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/* The sealing constants are missing from old glibc headers */
+#ifndef MFD_ALLOW_SEALING
+#define MFD_ALLOW_SEALING 0x0002U
+#endif
+#ifndef F_ADD_SEALS
+#define F_ADD_SEALS 1033
+#define F_SEAL_SEAL 0x0001
+#define F_SEAL_SHRINK 0x0002
+#define F_SEAL_GROW 0x0004
+#endif
+
+namespace libtas {
+
+int makeSealedMemfd(const char* name, size_t size)
+{
+    int fd = syscall(SYS_memfd_create, name, MFD_ALLOW_SEALING);
+    if (fd < 0)
+        return -1;
+
+    int ret;
+    NATIVECALL(ret = ftruncate(fd, size));
+    if (ret < 0) {
+        NATIVECALL(close(fd));
+        return -1;
+    }
+
+    /* Freeze the size. Failing to seal is not fatal, the program checks
+     * the size before mapping anyway. */
+    fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL);
+
+    return fd;
+}
+
+}
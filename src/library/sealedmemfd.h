@@ -0,0 +1,36 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_SEALEDMEMFD_H_INCL
+#define LIBTAS_SEALEDMEMFD_H_INCL
+
+#include <cstddef>
+
+namespace libtas {
+
+/* Create an anonymous memfd of the given size, sealed against resizing,
+ * to be passed to the program over the socket (see sendFd()). The seals
+ * guarantee the size to the program, so it can map the buffer without
+ * ever risking a SIGBUS from a shrink. Returns the file descriptor, or
+ * -1 on failure. */
+int makeSealedMemfd(const char* name, size_t size);
+
+}
+
+#endif
@@ -47,6 +47,43 @@ DEFINE_ORIG_POINTER(pthread_sigqueue);
 static int origUsrMaskProcess = 0;
 static thread_local int origUsrMaskThread = 0;
 
+/* Shadow of the thread's kernel signal mask, used to elide redundant mask
+ * syscalls. Some engines toggle their mask thousands of times per second
+ * around timer callbacks, mostly setting it to the value it already has.
+ * When the shadow shows that a change would leave the kernel mask as it is,
+ * the call is answered from the shadow without entering the kernel. The mask
+ * is per-thread for both sigprocmask and pthread_sigmask on Linux, so one
+ * thread-local shadow covers both. The shadow starts unknown, and is learned
+ * from the first call that pins the mask down; it is dropped again when our
+ * own code changes the mask natively. */
+static thread_local bool shadowMaskValid = false;
+static thread_local sigset_t shadowMask;
+
+static bool sameSigset(const sigset_t *a, const sigset_t *b)
+{
+    for (int s = 1; s < NSIG; s++)
+        if (sigismember(a, s) != sigismember(b, s))
+            return false;
+    return true;
+}
+
+/* Apply a mask change on a set, mirroring what the kernel would do */
+static void applySigmask(sigset_t *target, int how, const sigset_t *set)
+{
+    if (how == SIG_SETMASK) {
+        *target = *set;
+        return;
+    }
+    for (int s = 1; s < NSIG; s++) {
+        if (sigismember(set, s) != 1)
+            continue;
+        if (how == SIG_BLOCK)
+            sigaddset(target, s);
+        else if (how == SIG_UNBLOCK)
+            sigdelset(target, s);
+    }
+}
+
 /* Override */ sighandler_t signal (int sig, sighandler_t handler) throw()
 {
     DEBUGLOGCALL(LCF_SIGNAL);
@@ -81,6 +118,9 @@ static thread_local int origUsrMaskThread = 0;
     /* Remove our signals from the list of blocked signals */
     int oldmask = orig::sigblock(mask & ~bannedMask);
 
+    /* The kernel mask changed outside of the shadowed calls */
+    shadowMaskValid = false;
+
     /* Add which of our signals were blocked */
     oldmask |= origUsrMaskProcess;
 
@@ -100,6 +140,9 @@ static thread_local int origUsrMaskThread = 0;
     /* Remove our signals from the list of blocked signals */
     int oldmask = orig::sigsetmask(mask & ~bannedMask);
 
+    /* The kernel mask changed outside of the shadowed calls */
+    shadowMaskValid = false;
+
     /* Update which of our signals were blocked */
     oldmask |= origUsrMaskProcess; // logical 'or' works here because the SIGUSRX
                             // mask bits are always cleared in oldmask
@@ -129,8 +172,12 @@ static thread_local int origUsrMaskThread = 0;
     DEBUGLOGCALL(LCF_SIGNAL);
     LINK_NAMESPACE_GLOBAL(sigprocmask);
 
-    if (GlobalState::isNative())
+    if (GlobalState::isNative()) {
+        /* Our own code changes the mask behind the shadow's back */
+        if (set)
+            shadowMaskValid = false;
         return orig::sigprocmask(how, set, oset);
+    }
 
     sigset_t newset;
     if (set) {
@@ -139,13 +186,48 @@ static thread_local int origUsrMaskThread = 0;
         sigdelset(&newset, SIGUSR2);
     }
 
-    int ret = orig::sigprocmask(how, set?&newset:set, oset);
+    /* Answer from the shadow when the change would keep the kernel mask
+     * as it is, which is the common case for mask-toggling engines */
+    bool noop = shadowMaskValid && !set;
+    if (shadowMaskValid && set) {
+        sigset_t target = shadowMask;
+        applySigmask(&target, how, &newset);
+        noop = sameSigset(&target, &shadowMask);
+    }
+
+    int ret = 0;
+    if (noop) {
+        if (oset)
+            *oset = shadowMask;
+    }
+    else {
+        ret = orig::sigprocmask(how, set?&newset:set, oset);
+    }
 
     if (ret != -1) {
+        /* Track the resulting kernel mask. For an incremental change, it can
+         * only be derived when the starting mask is known, either from the
+         * shadow or from the old mask returned by the kernel */
+        if (!noop) {
+            if (set && (how == SIG_SETMASK)) {
+                shadowMask = newset;
+                shadowMaskValid = true;
+            }
+            else if (set && shadowMaskValid) {
+                applySigmask(&shadowMask, how, &newset);
+            }
+            else if (oset) {
+                shadowMask = *oset;
+                if (set)
+                    applySigmask(&shadowMask, how, &newset);
+                shadowMaskValid = true;
+            }
+        }
+
         if (oset) {
-            if (origUsrMaskProcess & SIGUSR1)
+            if (origUsrMaskProcess & sigmask(SIGUSR1))
                 sigaddset(oset, SIGUSR1);
-            if (origUsrMaskProcess & SIGUSR2)
+            if (origUsrMaskProcess & sigmask(SIGUSR2))
                 sigaddset(oset, SIGUSR2);
         }
 
@@ -286,8 +368,12 @@ static thread_local int origUsrMaskThread = 0;
      * threads to unblock SIGUSR1 and SIGUSR2, so we only allow native threads
      * to unblock.
      */
-    if (GlobalState::isNative() && (how == SIG_UNBLOCK))
+    if (GlobalState::isNative() && (how == SIG_UNBLOCK)) {
+        /* Our own code changes the mask behind the shadow's back */
+        if (newmask)
+            shadowMaskValid = false;
         return orig::pthread_sigmask(how, newmask, oldmask);
+    }
 
     if (newmask) {
         if (how == SIG_BLOCK)
@@ -320,13 +406,46 @@ static thread_local int origUsrMaskThread = 0;
         sigdelset(&tmpmask, SIGUSR2);
     }
 
-    int ret = orig::pthread_sigmask(how, (newmask==nullptr)?nullptr:&tmpmask, oldmask);
+    /* Answer from the shadow when the change would keep the kernel mask
+     * as it is, which is the common case for mask-toggling engines */
+    bool noop = shadowMaskValid && !newmask;
+    if (shadowMaskValid && newmask) {
+        sigset_t target = shadowMask;
+        applySigmask(&target, how, &tmpmask);
+        noop = sameSigset(&target, &shadowMask);
+    }
+
+    int ret = 0;
+    if (noop) {
+        if (oldmask)
+            *oldmask = shadowMask;
+    }
+    else {
+        ret = orig::pthread_sigmask(how, (newmask==nullptr)?nullptr:&tmpmask, oldmask);
+    }
 
     if (ret != -1) {
+        /* Track the resulting kernel mask, like in sigprocmask() */
+        if (!noop) {
+            if (newmask && (how == SIG_SETMASK)) {
+                shadowMask = tmpmask;
+                shadowMaskValid = true;
+            }
+            else if (newmask && shadowMaskValid) {
+                applySigmask(&shadowMask, how, &tmpmask);
+            }
+            else if (oldmask) {
+                shadowMask = *oldmask;
+                if (newmask)
+                    applySigmask(&shadowMask, how, &tmpmask);
+                shadowMaskValid = true;
+            }
+        }
+
         if (oldmask) {
-            if (origUsrMaskThread & SIGUSR1)
+            if (origUsrMaskThread & sigmask(SIGUSR1))
                 sigaddset(oldmask, SIGUSR1);
-            if (origUsrMaskThread & SIGUSR2)
+            if (origUsrMaskThread & sigmask(SIGUSR2))
                 sigaddset(oldmask, SIGUSR2);
         }
 
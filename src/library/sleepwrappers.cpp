@@ -26,6 +26,7 @@
 #include "backtrace.h"
 #include "GlobalState.h"
 #include "hook.h"
+#include "global.h" // shared_config
 
 namespace libtas {
 
@@ -34,6 +35,17 @@ DEFINE_ORIG_POINTER(clock_nanosleep);
 DEFINE_ORIG_POINTER(select);
 DEFINE_ORIG_POINTER(pselect);
 
+/* During fast-forward with sleep skipping enabled, sleeps should not reach
+ * the kernel at all: the main thread has already transferred the wait to the
+ * deterministic timer, and secondary threads only yield instead of really
+ * waiting. The per-frame pacing sleep in DeterministicTimer is skipped by
+ * the same setting, so no time is waited anywhere.
+ */
+static bool skipSleeps(void)
+{
+    return shared_config.fastforward && (shared_config.fastforward_mode & SharedConfig::FF_SLEEP);
+}
+
 /* Override */ void SDL_Delay(unsigned int sleep)
 {
     LINK_NAMESPACE_GLOBAL(nanosleep);
@@ -55,6 +67,12 @@ DEFINE_ORIG_POINTER(pselect);
      */
     if (sleep && mainT) {
         detTimer.addDelay(ts);
+        if (! skipSleeps())
+            sched_yield();
+        return;
+    }
+
+    if (skipSleeps()) {
         sched_yield();
         return;
     }
@@ -81,6 +99,12 @@ DEFINE_ORIG_POINTER(pselect);
      */
     if (usec && mainT) {
         detTimer.addDelay(ts);
+        if (! skipSleeps())
+            sched_yield();
+        return 0;
+    }
+
+    if (skipSleeps()) {
         sched_yield();
         return 0;
     }
@@ -105,6 +129,12 @@ DEFINE_ORIG_POINTER(pselect);
      */
     if (mainT && (requested_time->tv_sec || requested_time->tv_nsec)) {
         detTimer.addDelay(*requested_time);
+        if (! skipSleeps())
+            sched_yield();
+        return 0;
+    }
+
+    if (skipSleeps()) {
         sched_yield();
         return 0;
     }
@@ -143,6 +173,12 @@ DEFINE_ORIG_POINTER(pselect);
     if (mainT) {
 
         detTimer.addDelay(sleeptime);
+        if (! skipSleeps())
+            sched_yield();
+        return 0;
+    }
+
+    if (skipSleeps()) {
         sched_yield();
         return 0;
     }
@@ -179,6 +215,12 @@ DEFINE_ORIG_POINTER(pselect);
         ts.tv_nsec = timeout->tv_usec * 1000;
         detTimer.addDelay(ts);
 
+        if (! skipSleeps())
+            sched_yield();
+        return 0;
+    }
+
+    if (skipSleeps()) {
         sched_yield();
         return 0;
     }
@@ -213,6 +255,12 @@ DEFINE_ORIG_POINTER(pselect);
     if (mainT && (timeout->tv_sec || timeout->tv_nsec)) {
         detTimer.addDelay(*timeout);
 
+        if (! skipSleeps())
+            sched_yield();
+        return 0;
+    }
+
+    if (skipSleeps()) {
         sched_yield();
         return 0;
     }
@@ -19,29 +19,126 @@
 
 #include "isteamremotestorage.h"
 #include "../logging.h"
+#include "../GlobalState.h"
 #include "../Utils.h"
 
 #include <unistd.h>
 #include <fcntl.h>
+#include <map>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <cstring>
 
 namespace libtas {
 
-bool ISteamRemoteStorage::FileWrite( const char *pchFile, const void *pvData, int cubData )
+/* Remote-storage files are held in an in-memory cache and only written back
+ * to disk at the frame boundary (SteamRemoteStorage_Flush below), so games
+ * that persist settings every frame never stall on file I/O mid-frame.
+ * Multiple FileWrite calls to the same file within a frame coalesce into a
+ * single disk write. The backing files still live in /tmp for now.
+ */
+struct RemoteFile {
+    std::vector<char> data;
+    /* Content differs from the on-disk file */
+    bool dirty = false;
+    /* File does not exist (absent on first access, or deleted) */
+    bool deleted = false;
+};
+
+static std::map<std::string, RemoteFile>& getFileCache() {
+    static std::map<std::string, RemoteFile> filecache;
+    return filecache;
+}
+
+static std::mutex& getFileCacheMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+/* Set when any cached file is dirty, so the per-frame flush is a single
+ * atomic load when there is nothing to do. */
+static std::atomic<bool> cache_dirty(false);
+
+/* Get the cache entry of a file, loading the on-disk content on first
+ * access. Must be called with the cache mutex held. */
+static RemoteFile& getFile(const char* pchFile)
 {
-    DEBUGLOGCALL(LCF_STEAM);
+    auto& filecache = getFileCache();
+    auto it = filecache.find(pchFile);
+    if (it != filecache.end())
+        return it->second;
+
+    RemoteFile& file = filecache[pchFile];
 
-    /* Store the file locally, in /tmp for now */
     std::string path = "/tmp/";
     path += pchFile;
-    int fd = open(path.c_str(), O_WRONLY | O_TRUNC | O_CREAT, 0666);
-    if (fd < 0)
-        return false;
 
-    Utils::writeAll(fd, pvData, cubData);
+    GlobalNative gn;
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        file.deleted = true;
+        return file;
+    }
 
-    if (close(fd) < 0) {
-        return false;        
+    off_t filesize = lseek(fd, 0, SEEK_END);
+    lseek(fd, 0, SEEK_SET);
+    if (filesize > 0) {
+        file.data.resize(filesize);
+        Utils::readAll(fd, file.data.data(), filesize);
     }
+    close(fd);
+    return file;
+}
+
+void SteamRemoteStorage_Flush()
+{
+    if (!cache_dirty.load(std::memory_order_acquire))
+        return;
+
+    std::lock_guard<std::mutex> lock(getFileCacheMutex());
+    cache_dirty.store(false, std::memory_order_release);
+
+    for (auto& entry : getFileCache()) {
+        RemoteFile& file = entry.second;
+        if (!file.dirty)
+            continue;
+        file.dirty = false;
+
+        std::string path = "/tmp/";
+        path += entry.first;
+
+        debuglogstdio(LCF_STEAM, "Flush remote storage file %s", entry.first.c_str());
+
+        GlobalNative gn;
+        if (file.deleted) {
+            unlink(path.c_str());
+            continue;
+        }
+
+        int fd = open(path.c_str(), O_WRONLY | O_TRUNC | O_CREAT, 0666);
+        if (fd >= 0) {
+            Utils::writeAll(fd, file.data.data(), file.data.size());
+            close(fd);
+        }
+    }
+}
+
+bool ISteamRemoteStorage::FileWrite( const char *pchFile, const void *pvData, int cubData )
+{
+    DEBUGLOGCALL(LCF_STEAM);
+
+    if (cubData < 0)
+        return false;
+
+    std::lock_guard<std::mutex> lock(getFileCacheMutex());
+    RemoteFile& file = getFile(pchFile);
+    const char* data = static_cast<const char*>(pvData);
+    file.data.assign(data, data + cubData);
+    file.deleted = false;
+    file.dirty = true;
+    cache_dirty.store(true, std::memory_order_release);
 
 	return true;
 }
@@ -50,20 +147,17 @@ int	ISteamRemoteStorage::FileRead( const char *pchFile, void *pvData, int cubDat
 {
     DEBUGLOGCALL(LCF_STEAM);
 
-    /* Read the file from /tmp for now */
-    std::string path = "/tmp/";
-    path += pchFile;
-    int fd = open(path.c_str(), O_RDONLY);
-    if (fd < 0)
+    std::lock_guard<std::mutex> lock(getFileCacheMutex());
+    RemoteFile& file = getFile(pchFile);
+    if (file.deleted || cubDataToRead < 0)
         return 0;
 
-    int ret = Utils::readAll(fd, pvData, cubDataToRead);
-
-    if (close(fd) < 0) {
-        return 0;
-    }
+    size_t readsize = file.data.size();
+    if (static_cast<size_t>(cubDataToRead) < readsize)
+        readsize = cubDataToRead;
+    memcpy(pvData, file.data.data(), readsize);
 
-	return ret;
+	return readsize;
 }
 
 SteamAPICall_t ISteamRemoteStorage::FileWriteAsync( const char *pchFile, const void *pvData, unsigned int cubData )
@@ -97,10 +191,13 @@ bool ISteamRemoteStorage::FileForget( const char *pchFile )
 bool ISteamRemoteStorage::FileDelete( const char *pchFile )
 {
     DEBUGLOGCALL(LCF_STEAM);
-    /* Read the file from /tmp for now */
-    std::string path = "/tmp/";
-    path += pchFile;
-    unlink(path.c_str());
+
+    std::lock_guard<std::mutex> lock(getFileCacheMutex());
+    RemoteFile& file = getFile(pchFile);
+    file.data.clear();
+    file.deleted = true;
+    file.dirty = true;
+    cache_dirty.store(true, std::memory_order_release);
 	return true;
 }
 
@@ -143,10 +240,9 @@ bool ISteamRemoteStorage::FileWriteStreamCancel( UGCFileWriteStreamHandle_t writ
 bool ISteamRemoteStorage::FileExists( const char *pchFile )
 {
     DEBUGLOGCALL(LCF_STEAM);
-    /* Read the file from /tmp for now */
-    std::string path = "/tmp/";
-    path += pchFile;
-    return (access(path.c_str(), F_OK) == 0);
+
+    std::lock_guard<std::mutex> lock(getFileCacheMutex());
+    return !getFile(pchFile).deleted;
 }
 
 bool ISteamRemoteStorage::FilePersisted( const char *pchFile )
@@ -158,23 +254,13 @@ bool ISteamRemoteStorage::FilePersisted( const char *pchFile )
 int	ISteamRemoteStorage::GetFileSize( const char *pchFile )
 {
     DEBUGLOGCALL(LCF_STEAM);
-    /* Read the file from /tmp for now */
-    std::string path = "/tmp/";
-    path += pchFile;
 
-    int fd = open(path.c_str(), O_RDONLY);
-    if (fd < 0)
+    std::lock_guard<std::mutex> lock(getFileCacheMutex());
+    RemoteFile& file = getFile(pchFile);
+    if (file.deleted)
         return 0;
 
-    int ret = lseek(fd, 0, SEEK_END);
-
-    close(fd);
-
-    if (ret < 0) {
-        return 0;
-    }
-
-	return ret;
+	return file.data.size();
 }
 
 int64_t ISteamRemoteStorage::GetFileTimestamp( const char *pchFile )
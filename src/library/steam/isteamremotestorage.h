@@ -12,6 +12,11 @@
 
 namespace libtas {
 
+/* Write back dirty cached remote-storage files to disk. Called at the frame
+ * boundary, so that games saving settings every frame never do file I/O on
+ * the frame path (writes are coalesced in the in-memory cache). */
+void SteamRemoteStorage_Flush();
+
 //-----------------------------------------------------------------------------
 // Purpose: Functions for accessing, reading and writing files stored remotely
 //			and cached locally
@@ -23,6 +23,13 @@
 
 namespace libtas {
 
+/* Stats and achievements are deliberately stubbed: nothing is stored and
+ * nothing is persisted, so every call is O(1) with a fixed answer. Stats
+ * persisted across runs would make a game's behavior depend on state
+ * outside the movie inputs, and even in-session storage would change what
+ * existing movies observe. Keep it this way rather than growing a real
+ * backing store. */
+
 bool ISteamUserStats::RequestCurrentStats()
 {
     DEBUGLOGCALL(LCF_STEAM);
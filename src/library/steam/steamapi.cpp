@@ -68,6 +68,12 @@ void SteamAPI_UnregisterCallback( void *pCallback )
     debuglog(LCF_STEAM, __func__, " call.");
 }
 
+/* The interface accessors below construct their objects lazily on first use,
+ * as function-local statics. SteamAPI_Init() itself does no work, so a
+ * restarted game only pays for the few interfaces it actually asks for, and
+ * each of those costs a single vtable pointer write since the emulated
+ * interfaces carry no state. */
+
 ISteamClient *SteamClient()
 {
     DEBUGLOGCALL(LCF_STEAM);
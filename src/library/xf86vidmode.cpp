@@ -23,17 +23,60 @@
 #include "hook.h"
 #include "logging.h"
 
+#include <cstdlib>
+#include <cstring>
+
 namespace libtas {
 
 DEFINE_ORIG_POINTER(XF86VidModeGetModeLine);
 DEFINE_ORIG_POINTER(XF86VidModeGetAllModeLines);
 
+/* Cached snapshots of the patched mode data, so games that poll the display
+ * configuration every frame don't pay an X round trip per call. The display
+ * configuration cannot change under a TASed game, so the snapshots are only
+ * invalidated when the virtual resolution setting changes. */
+static int cached_screen_width = -1;
+static int cached_screen_height = -1;
+
+static bool modeline_cached = false;
+static int cached_dotclock;
+static XF86VidModeModeLine cached_modeline;
+
+static bool modeinfo_cached = false;
+static XF86VidModeModeInfo cached_modeinfo;
+
+static bool staleCache()
+{
+    return (cached_screen_width != shared_config.screen_width) ||
+        (cached_screen_height != shared_config.screen_height);
+}
+
+static void resetCache()
+{
+    modeline_cached = false;
+    modeinfo_cached = false;
+    cached_screen_width = shared_config.screen_width;
+    cached_screen_height = shared_config.screen_height;
+}
+
 Bool XF86VidModeGetModeLine(Display* dpy, int screen, int* dotclock, XF86VidModeModeLine* modeline)
 {
     DEBUGLOGCALL(LCF_WINDOW);
+
+    if (staleCache())
+        resetCache();
+
+    if (modeline_cached) {
+        *dotclock = cached_dotclock;
+        *modeline = cached_modeline;
+        return True;
+    }
+
     LINK_NAMESPACE(XF86VidModeGetModeLine, "Xxf86vm");
 
     Bool ret = orig::XF86VidModeGetModeLine(dpy, screen, dotclock, modeline);
+    if (!ret)
+        return ret;
 
     if (shared_config.screen_width) {
         /* Change the settings. Offsets for h/vsync come from my monitor, it
@@ -49,42 +92,65 @@ Bool XF86VidModeGetModeLine(Display* dpy, int screen, int* dotclock, XF86VidMode
         modeline->vtotal = shared_config.screen_width + 45;
     }
 
+    cached_dotclock = *dotclock;
+    cached_modeline = *modeline;
+    modeline_cached = true;
+
     return ret;
 }
 
 Bool XF86VidModeGetAllModeLines(Display *dpy, int screen, int *modecount_return, XF86VidModeModeInfo ***modesinfo)
 {
     DEBUGLOGCALL(LCF_WINDOW);
-    LINK_NAMESPACE(XF86VidModeGetAllModeLines, "Xxf86vm");
 
-    Bool ret = orig::XF86VidModeGetAllModeLines(dpy, screen, modecount_return, modesinfo);
+    if (staleCache())
+        resetCache();
 
-    if (shared_config.screen_width) {
-        /* Copy the first mode (current one) in another object */
-        XF86VidModeModeInfo *modeinfo = static_cast<XF86VidModeModeInfo*>(malloc(sizeof(XF86VidModeModeInfo)));
-        memcpy(modeinfo, (*(*modesinfo)), sizeof(XF86VidModeModeInfo));
+    /* Only the virtual resolution path builds its own single-mode list; the
+     * passthrough result keeps the ownership of the real extension and is
+     * not cached */
+    if (!modeinfo_cached) {
+        LINK_NAMESPACE(XF86VidModeGetAllModeLines, "Xxf86vm");
+
+        Bool ret = orig::XF86VidModeGetAllModeLines(dpy, screen, modecount_return, modesinfo);
+        if (!ret || !shared_config.screen_width)
+            return ret;
+
+        /* Snapshot the first mode (current one) */
+        memcpy(&cached_modeinfo, (*(*modesinfo)), sizeof(XF86VidModeModeInfo));
 
         /* Free the old result */
         XFree((*modesinfo));
 
         /* Change the settings. Offsets for h/vsync come from my monitor, it
          * shouldn't matter really. */
-        modeinfo->hdisplay = shared_config.screen_height;
-        modeinfo->hsyncstart = shared_config.screen_height + 88;
-        modeinfo->hsyncend = shared_config.screen_height + 132;
-        modeinfo->htotal = shared_config.screen_height + 280;
-
-        modeinfo->vdisplay = shared_config.screen_width;
-        modeinfo->vsyncstart = shared_config.screen_width + 4;
-        modeinfo->vsyncend = shared_config.screen_width + 9;
-        modeinfo->vtotal = shared_config.screen_width + 45;
-
-        /* Set the correct returned values */
-        *modecount_return = 1;
-        *modesinfo = &modeinfo;
+        cached_modeinfo.hdisplay = shared_config.screen_height;
+        cached_modeinfo.hsyncstart = shared_config.screen_height + 88;
+        cached_modeinfo.hsyncend = shared_config.screen_height + 132;
+        cached_modeinfo.htotal = shared_config.screen_height + 280;
+
+        cached_modeinfo.vdisplay = shared_config.screen_width;
+        cached_modeinfo.vsyncstart = shared_config.screen_width + 4;
+        cached_modeinfo.vsyncend = shared_config.screen_width + 9;
+        cached_modeinfo.vtotal = shared_config.screen_width + 45;
+        cached_modeinfo.privsize = 0;
+        cached_modeinfo.c_private = nullptr;
+
+        modeinfo_cached = true;
     }
 
-    return ret;
+    /* Serve the single synthesized mode from the snapshot. The pointer list
+     * and the mode live in one allocation, so the single XFree() of the
+     * caller releases everything. */
+    XF86VidModeModeInfo **modes = static_cast<XF86VidModeModeInfo**>(malloc(sizeof(XF86VidModeModeInfo*) + sizeof(XF86VidModeModeInfo)));
+    XF86VidModeModeInfo *mode = reinterpret_cast<XF86VidModeModeInfo*>(modes + 1);
+    *mode = cached_modeinfo;
+    modes[0] = mode;
+
+    *modecount_return = 1;
+    *modesinfo = modes;
+
+    return True;
 }
 
 }
@@ -23,16 +23,54 @@
 #include "hook.h"
 #include "logging.h"
 
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
 namespace libtas {
 
 DEFINE_ORIG_POINTER(XRRGetCrtcInfo);
 
+/* Cached snapshot of the patched crtc info, so games that poll the display
+ * configuration every frame don't pay an X round trip per call. The display
+ * configuration cannot change under a TASed game, so the snapshot is only
+ * invalidated when the virtual resolution setting changes. The returned
+ * object is still allocated per call, because the caller frees it with
+ * XRRFreeCrtcInfo(). */
+static bool crtc_cached = false;
+static RRCrtc cached_crtc;
+static int cached_screen_width = -1;
+static int cached_screen_height = -1;
+static XRRCrtcInfo cached_info;
+static std::vector<RROutput> cached_outputs;
+static std::vector<RROutput> cached_possible;
+
 OVERRIDE XRRCrtcInfo *XRRGetCrtcInfo (Display *dpy, XRRScreenResources *resources, RRCrtc crtc)
 {
     DEBUGLOGCALL(LCF_WINDOW);
+
+    if (crtc_cached && (cached_crtc == crtc) &&
+        (cached_screen_width == shared_config.screen_width) &&
+        (cached_screen_height == shared_config.screen_height)) {
+
+        /* Serve a copy of the snapshot. XRRGetCrtcInfo() stores the output
+         * arrays in the same allocation as the struct, and XRRFreeCrtcInfo()
+         * is a single free, so the copy mirrors that layout. */
+        size_t size = sizeof(XRRCrtcInfo) + (cached_outputs.size() + cached_possible.size()) * sizeof(RROutput);
+        XRRCrtcInfo *crtcInfo = static_cast<XRRCrtcInfo*>(malloc(size));
+        *crtcInfo = cached_info;
+        crtcInfo->outputs = reinterpret_cast<RROutput*>(crtcInfo + 1);
+        memcpy(crtcInfo->outputs, cached_outputs.data(), cached_outputs.size() * sizeof(RROutput));
+        crtcInfo->possible = crtcInfo->outputs + cached_outputs.size();
+        memcpy(crtcInfo->possible, cached_possible.data(), cached_possible.size() * sizeof(RROutput));
+        return crtcInfo;
+    }
+
     LINK_NAMESPACE(XRRGetCrtcInfo, "Xrandr");
 
     XRRCrtcInfo *crtcInfo = orig::XRRGetCrtcInfo(dpy, resources, crtc);
+    if (!crtcInfo)
+        return crtcInfo;
 
     if (shared_config.screen_width) {
         /* Change the settings. */
@@ -47,6 +85,15 @@ OVERRIDE XRRCrtcInfo *XRRGetCrtcInfo (Display *dpy, XRRScreenResources *resource
         }
     }
 
+    /* Snapshot the patched result for the next calls */
+    cached_info = *crtcInfo;
+    cached_outputs.assign(crtcInfo->outputs, crtcInfo->outputs + crtcInfo->noutput);
+    cached_possible.assign(crtcInfo->possible, crtcInfo->possible + crtcInfo->npossible);
+    cached_crtc = crtc;
+    cached_screen_width = shared_config.screen_width;
+    cached_screen_height = shared_config.screen_height;
+    crtc_cached = true;
+
     return crtcInfo;
 }
 
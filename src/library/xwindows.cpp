@@ -29,6 +29,10 @@
 #include "backtrace.h"
 #include "inputs/xinput.h"
 
+#include <map>
+#include <mutex>
+#include <string>
+
 namespace libtas {
 
 DEFINE_ORIG_POINTER(XOpenDisplay);
@@ -46,6 +50,28 @@ DEFINE_ORIG_POINTER(XSelectInput);
 DEFINE_ORIG_POINTER(XResizeWindow);
 DEFINE_ORIG_POINTER(XConfigureWindow);
 DEFINE_ORIG_POINTER(XQueryExtension);
+DECLARE_ORIG_POINTER(XGetGeometry);
+DEFINE_ORIG_POINTER(XGetWindowAttributes);
+
+/* Cached answers of XGetGeometry and XGetWindowAttributes on the game
+ * window. Engines query the window geometry every frame, and each query
+ * is a full X round trip, which matters for games running uncapped. Under
+ * libTAS the window only changes through our own resize path, so the
+ * cache is filled from the first real query and invalidated by
+ * ScreenCapture::resize and the (un)map/destroy hooks below. */
+static bool geometry_cached = false;
+static Window cached_root;
+static int cached_x, cached_y;
+static unsigned int cached_width, cached_height, cached_border, cached_depth;
+
+static bool attributes_cached = false;
+static XWindowAttributes cached_attributes;
+
+void invalidateGameWindowCache()
+{
+    geometry_cached = false;
+    attributes_cached = false;
+}
 
 Bool XQueryExtension(Display* display, const char* name, int* major_opcode_return, int* first_event_return, int* first_error_return) {
     debuglog(LCF_WINDOW, __func__, " called with name ", name);
@@ -144,6 +170,7 @@ int XDestroyWindow(Display *display, Window w)
     ScreenCapture::fini();
 
     gameXWindow = 0;
+    invalidateGameWindowCache();
 
     /* Tells the program we don't have a window anymore to gather inputs */
     sendMessage(MSGB_WINDOW_ID);
@@ -162,6 +189,10 @@ int XMapWindow(Display *display, Window w)
 
     int ret = orig::XMapWindow(display, w);
 
+    /* The cached attributes hold the map state */
+    if (w == gameXWindow)
+        invalidateGameWindowCache();
+
     /* We must wait until the window is mapped to send it to the program.
      * We are checking the content of gameXWindow to see if we must send it
      */
@@ -183,6 +214,10 @@ int XUnmapWindow(Display *display, Window w)
 
     int ret = orig::XUnmapWindow(display, w);
 
+    /* The cached attributes hold the map state */
+    if (w == gameXWindow)
+        invalidateGameWindowCache();
+
     pushNativeXlibEvents();
 
     return ret;
@@ -195,6 +230,10 @@ int XMapRaised(Display *display, Window w)
 
     int ret = orig::XMapRaised(display, w);
 
+    /* The cached attributes hold the map state */
+    if (w == gameXWindow)
+        invalidateGameWindowCache();
+
     /* We must wait until the window is mapped to send it to the program.
      * We are checking the content of gameXWindow to see if we must send it
      */
@@ -240,7 +279,78 @@ Atom XInternAtom(Display* display, const char* atom_name, Bool only_if_exists)
 {
     debuglog(LCF_WINDOW, __func__, " call with atom ", atom_name);
     LINK_NAMESPACE_GLOBAL(XInternAtom);
-    return orig::XInternAtom(display, atom_name, only_if_exists);
+
+    if (GlobalState::isNative())
+        return orig::XInternAtom(display, atom_name, only_if_exists);
+
+    /* Atoms are server-global and immutable, so a successful result can
+     * serve every later query of the same name without a round trip. A
+     * None result is not cached: another client may intern the atom at
+     * any time, so only_if_exists queries must keep asking the server. */
+    static std::map<std::string, Atom> atom_cache;
+    static std::mutex atom_mutex;
+
+    {
+        std::lock_guard<std::mutex> lock(atom_mutex);
+        auto it = atom_cache.find(atom_name);
+        if (it != atom_cache.end())
+            return it->second;
+    }
+
+    Atom atom = orig::XInternAtom(display, atom_name, only_if_exists);
+    if (atom != None) {
+        std::lock_guard<std::mutex> lock(atom_mutex);
+        atom_cache[atom_name] = atom;
+    }
+    return atom;
+}
+
+Status XGetGeometry(Display* display, Drawable d, Window* root_return, int* x_return, int* y_return, unsigned int* width_return, unsigned int* height_return, unsigned int* border_width_return, unsigned int* depth_return)
+{
+    LINK_NAMESPACE_GLOBAL(XGetGeometry);
+
+    /* Only the game window is under our control, anything else is
+     * forwarded to the server */
+    if (GlobalState::isNative() || (gameXWindow == 0) || (d != gameXWindow))
+        return orig::XGetGeometry(display, d, root_return, x_return, y_return, width_return, height_return, border_width_return, depth_return);
+
+    DEBUGLOGCALL(LCF_WINDOW);
+
+    if (!geometry_cached) {
+        Status ret = orig::XGetGeometry(display, d, &cached_root, &cached_x, &cached_y, &cached_width, &cached_height, &cached_border, &cached_depth);
+        if (!ret)
+            return ret;
+        geometry_cached = true;
+    }
+
+    *root_return = cached_root;
+    *x_return = cached_x;
+    *y_return = cached_y;
+    *width_return = cached_width;
+    *height_return = cached_height;
+    *border_width_return = cached_border;
+    *depth_return = cached_depth;
+    return 1;
+}
+
+Status XGetWindowAttributes(Display* display, Window w, XWindowAttributes* window_attributes_return)
+{
+    LINK_NAMESPACE_GLOBAL(XGetWindowAttributes);
+
+    if (GlobalState::isNative() || (gameXWindow == 0) || (w != gameXWindow))
+        return orig::XGetWindowAttributes(display, w, window_attributes_return);
+
+    DEBUGLOGCALL(LCF_WINDOW);
+
+    if (!attributes_cached) {
+        Status ret = orig::XGetWindowAttributes(display, w, &cached_attributes);
+        if (!ret)
+            return ret;
+        attributes_cached = true;
+    }
+
+    *window_attributes_return = cached_attributes;
+    return 1;
 }
 
 int XSelectInput(Display *display, Window w, long event_mask)
@@ -48,6 +48,16 @@ OVERRIDE void XSetWMName(Display *display, Window w, XTextProperty *text_prop);
 
 OVERRIDE Atom XInternAtom(Display* display, const char*	atom_name, Bool only_if_exists);
 
+OVERRIDE Status XGetGeometry(Display* display, Drawable d, Window* root_return, int* x_return, int* y_return, unsigned int* width_return, unsigned int* height_return, unsigned int* border_width_return, unsigned int* depth_return);
+
+OVERRIDE Status XGetWindowAttributes(Display* display, Window w, XWindowAttributes* window_attributes_return);
+
+/* Invalidate the cached geometry and attributes of the game window.
+ * Called from our own resize path (ScreenCapture::resize), the only way
+ * the window can change size under libTAS, and when the window is
+ * (un)mapped or destroyed. */
+void invalidateGameWindowCache();
+
 OVERRIDE int XSelectInput(Display *display, Window w, long event_mask);
 
 OVERRIDE int XMoveWindow(Display* display, Window w, int x, int y);
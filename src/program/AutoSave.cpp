@@ -26,6 +26,13 @@
 static time_t last_time_saved = time(nullptr);
 static int nb_frame_advance = 0;
 
+/* Moviefile of the last autosave, target of the incremental saves */
+static std::string last_autosave;
+
+/* Content hash of the last autosaved movie, to skip saves whose edits
+ * cancelled out */
+static uint64_t last_autosave_hash = 0;
+
 void AutoSave::update(Context* context, MovieFile& movie)
 {
 	/* Check if autosave is enabled */
@@ -43,6 +50,26 @@ void AutoSave::update(Context* context, MovieFile& movie)
 		nb_frame_advance = 0;
 		time(&last_time_saved);
 
+		/* Append the modified frames to the last autosave when possible, so
+		 * the save cost is proportional to the edit size instead of the
+		 * movie length */
+		if (!last_autosave.empty() && movie.canAppendTo(last_autosave)) {
+			/* Skip the save entirely when the edits cancelled out since the
+			 * last autosave (such as an undone change), the file content
+			 * would be identical */
+			uint64_t hash = movie.contentHash();
+			if (hash == last_autosave_hash) {
+				movie.modifiedSinceLastAutoSave = false;
+				return;
+			}
+
+			std::cout << "Autosave movie to " << last_autosave << std::endl;
+			movie.saveMovieIncremental(last_autosave);
+			last_autosave_hash = hash;
+			movie.modifiedSinceLastAutoSave = false;
+			return;
+		}
+
 		/* Build the autosave filename */
 		size_t sep = context->config.moviefile.find_last_of("/");
 		std::string moviename;
@@ -70,6 +97,8 @@ void AutoSave::update(Context* context, MovieFile& movie)
 
 		/* Save the movie */
 		movie.saveMovie(moviename);
+		last_autosave = moviename;
+		last_autosave_hash = movie.contentHash();
 
 		movie.modifiedSinceLastAutoSave = false;
 	}
@@ -0,0 +1,246 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "BruteForce.h"
+#include "Context.h"
+#include "MovieFile.h"
+
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <cstring>
+#include <unistd.h>
+#include <fcntl.h>
+
+/* Watched value types, matching the RamWatch type names */
+enum WatchType {
+    WATCH_INT8,
+    WATCH_UINT8,
+    WATCH_INT16,
+    WATCH_UINT16,
+    WATCH_INT32,
+    WATCH_UINT32,
+    WATCH_INT64,
+    WATCH_UINT64,
+    WATCH_FLOAT,
+    WATCH_DOUBLE,
+};
+
+static int parseWatchType(const std::string& name)
+{
+    if (name == "int8") return WATCH_INT8;
+    if (name == "uint8") return WATCH_UINT8;
+    if (name == "int16") return WATCH_INT16;
+    if (name == "uint16") return WATCH_UINT16;
+    if (name == "int32") return WATCH_INT32;
+    if (name == "uint32") return WATCH_UINT32;
+    if (name == "int64") return WATCH_INT64;
+    if (name == "uint64") return WATCH_UINT64;
+    if (name == "float") return WATCH_FLOAT;
+    if (name == "double") return WATCH_DOUBLE;
+    return -1;
+}
+
+bool BruteForce::load(Context* c, MovieFile& movie, const std::string& path)
+{
+    context = c;
+    active = false;
+    finished = false;
+    state_saved = false;
+
+    start_frame = 0;
+    frame_count = 0;
+    total_candidates = 0;
+    done_candidates = 0;
+    watch_address = 0;
+    watch_type = -1;
+    maximize = true;
+    has_best = false;
+    best_score = 0;
+
+    uint64_t seed = 0;
+
+    std::ifstream script(path);
+    if (!script) {
+        std::cerr << "bot: could not open script " << path << std::endl;
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(script, line)) {
+        if (line.empty() || (line[0] == '#'))
+            continue;
+
+        /* Alphabet entries use the text movie input format, so they can be
+         * copied from and to a movie inputs file */
+        if (line[0] == '|') {
+            AllInputs ai;
+            ai.emptyInputs();
+            movie.readFrame(line, ai);
+            alphabet_lines.push_back(line);
+            alphabet.push_back(ai);
+            continue;
+        }
+
+        size_t sep = line.find('=');
+        if (sep == std::string::npos) {
+            std::cerr << "bot: malformed script line: " << line << std::endl;
+            return false;
+        }
+        std::string key = line.substr(0, sep);
+        std::string value = line.substr(sep + 1);
+
+        if (key == "start_frame")
+            start_frame = std::stoul(value);
+        else if (key == "frame_count")
+            frame_count = std::stoul(value);
+        else if (key == "candidates")
+            total_candidates = std::stoi(value);
+        else if (key == "seed")
+            seed = std::stoull(value);
+        else if (key == "watch_address")
+            watch_address = std::stoull(value, nullptr, 0);
+        else if (key == "watch_type")
+            watch_type = parseWatchType(value);
+        else if (key == "goal")
+            maximize = (value != "min");
+        else {
+            std::cerr << "bot: unknown script key: " << key << std::endl;
+            return false;
+        }
+    }
+
+    if ((frame_count == 0) || (total_candidates <= 0) ||
+        (watch_address == 0) || (watch_type < 0) || alphabet.empty()) {
+        std::cerr << "bot: the script must set frame_count, candidates, "
+            "watch_address, watch_type and at least one input line" << std::endl;
+        return false;
+    }
+
+    rng.seed(seed);
+    candidate.resize(frame_count);
+    generateCandidate();
+
+    active = true;
+    return true;
+}
+
+bool BruteForce::overrideInputs(unsigned long framecount, AllInputs& ai)
+{
+    if (!active || finished)
+        return false;
+    if ((framecount < start_frame) || (framecount >= endFrame()))
+        return false;
+
+    ai = alphabet[candidate[framecount - start_frame]];
+    return true;
+}
+
+bool BruteForce::readWatch(double *value)
+{
+    std::string mempath = "/proc/" + std::to_string(context->game_pid) + "/mem";
+    int fd = open(mempath.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    uint64_t raw = 0;
+    static const size_t sizes[] = {1, 1, 2, 2, 4, 4, 8, 8, 4, 8};
+    ssize_t ret = pread(fd, &raw, sizes[watch_type], watch_address);
+    close(fd);
+    if (ret != static_cast<ssize_t>(sizes[watch_type]))
+        return false;
+
+    switch (watch_type) {
+        case WATCH_INT8:
+            *value = static_cast<int8_t>(raw); break;
+        case WATCH_UINT8:
+            *value = static_cast<uint8_t>(raw); break;
+        case WATCH_INT16:
+            *value = static_cast<int16_t>(raw); break;
+        case WATCH_UINT16:
+            *value = static_cast<uint16_t>(raw); break;
+        case WATCH_INT32:
+            *value = static_cast<int32_t>(raw); break;
+        case WATCH_UINT32:
+            *value = static_cast<uint32_t>(raw); break;
+        case WATCH_INT64:
+            *value = static_cast<double>(static_cast<int64_t>(raw)); break;
+        case WATCH_UINT64:
+            *value = static_cast<double>(raw); break;
+        case WATCH_FLOAT: {
+            float f;
+            memcpy(&f, &raw, sizeof(float));
+            *value = f;
+            break;
+        }
+        case WATCH_DOUBLE:
+            memcpy(value, &raw, sizeof(double)); break;
+        default:
+            return false;
+    }
+    return true;
+}
+
+bool BruteForce::nextCandidate()
+{
+    double score;
+    if (readWatch(&score)) {
+        if (!has_best || (maximize ? (score > best_score) : (score < best_score))) {
+            has_best = true;
+            best_score = score;
+            best = candidate;
+            std::cout << "bot: candidate " << (done_candidates + 1)
+                << " improved the score to " << best_score << std::endl;
+        }
+    }
+    else {
+        std::cerr << "bot: could not read the watched value at 0x"
+            << std::hex << watch_address << std::dec << std::endl;
+    }
+
+    done_candidates++;
+    if (done_candidates >= total_candidates) {
+        finished = true;
+        return false;
+    }
+
+    generateCandidate();
+    return true;
+}
+
+void BruteForce::generateCandidate()
+{
+    std::uniform_int_distribution<int> dist(0, alphabet.size() - 1);
+    for (unsigned long i = 0; i < frame_count; i++)
+        candidate[i] = dist(rng);
+}
+
+void BruteForce::printReport()
+{
+    std::cout << "bot: searched " << done_candidates << " candidates over frames "
+        << start_frame << ".." << (endFrame() - 1) << std::endl;
+    if (!has_best) {
+        std::cout << "bot: no candidate could be scored" << std::endl;
+        return;
+    }
+    std::cout << "bot: best score " << best_score
+        << ", inputs in the text movie format:" << std::endl;
+    for (unsigned long i = 0; i < frame_count; i++)
+        std::cout << alphabet_lines[best[i]] << std::endl;
+}
@@ -0,0 +1,126 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_BRUTEFORCE_H_INCLUDED
+#define LIBTAS_BRUTEFORCE_H_INCLUDED
+
+#include "../shared/AllInputs.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <random>
+
+class Context;
+class MovieFile;
+
+/* Input brute-forcing engine, driven by GameLoop from the command line with
+ * --bot. A script file describes a frame window, an alphabet of candidate
+ * inputs per frame and a watched memory value to optimize. The game loop
+ * saves a RAM state at the start of the window, feeds a generated input
+ * sequence for the window frames with every fast-forward skipping flag set,
+ * reads the watched value back from game memory, restores the state and
+ * repeats, so each candidate costs one state load plus the window frames
+ * and no rendering. The best sequence is printed in the text movie input
+ * format, ready to paste into a movie.
+ *
+ * The script is a text file with one key=value per line, and one line per
+ * alphabet entry in the text movie input format:
+ *
+ *     start_frame=1200
+ *     frame_count=20
+ *     candidates=500
+ *     seed=1
+ *     watch_address=0x804a0c8
+ *     watch_type=int32
+ *     goal=max
+ *     |57:|0:0:0|
+ *     ...
+ *
+ * Several instances can explore disjoint seed ranges in parallel with
+ * --instance, one game per core.
+ */
+class BruteForce {
+public:
+    /* Savestate index used for the window start state, outside the numbered
+     * slots and the greenzone lattice range */
+    static const int STATE_INDEX = 99;
+
+    BruteForce() : context(nullptr), active(false), finished(false) {}
+
+    /* Whether the game loop saved the window start state already. Set by
+     * GameLoop when the start frame is first reached */
+    bool state_saved = false;
+
+    /* Parse the script file, using the movie input parser for the alphabet
+     * lines. Returns false and deactivates on a malformed script. */
+    bool load(Context* c, MovieFile& movie, const std::string& path);
+
+    bool isActive() const { return active; }
+    bool isFinished() const { return finished; }
+
+    unsigned long startFrame() const { return start_frame; }
+    unsigned long endFrame() const { return start_frame + frame_count; }
+
+    /* Replace the inputs of one frame inside the window with the current
+     * candidate sequence. Returns true when the inputs were overridden. */
+    bool overrideInputs(unsigned long framecount, AllInputs& ai);
+
+    /* Score the candidate that just finished against the watched value and
+     * generate the next one. Returns false when the search is over. */
+    bool nextCandidate();
+
+    /* Print the best sequence and its score on stdout */
+    void printReport();
+
+private:
+    void generateCandidate();
+
+    /* Read the watched value from the game memory, as a double */
+    bool readWatch(double *value);
+
+    Context* context;
+
+    /* One entry per script input line: the original line for the report,
+     * and the decoded inputs fed to the game */
+    std::vector<std::string> alphabet_lines;
+    std::vector<AllInputs> alphabet;
+
+    /* Current and best candidate, as alphabet indices per window frame */
+    std::vector<int> candidate;
+    std::vector<int> best;
+
+    unsigned long start_frame;
+    unsigned long frame_count;
+    int total_candidates;
+    int done_candidates;
+
+    uintptr_t watch_address;
+    int watch_type;
+    bool maximize;
+
+    double best_score;
+    bool has_best;
+
+    std::mt19937_64 rng;
+
+    bool active;
+    bool finished;
+};
+
+#endif
@@ -20,42 +20,108 @@
 #ifndef LIBTAS_CONCURRENTQUEUE_H_INCLUDED
 #define LIBTAS_CONCURRENTQUEUE_H_INCLUDED
 
-#include <queue>
-#include <mutex>
+#include <atomic>
+#include <thread>
+#include <cstdint>
+#include <unistd.h> // write()
 
-/* Thread-safe queue, will be used for a single producer/single consumer model
- * taken from https://juanchopanzacpp.wordpress.com/2013/02/26/concurrent-queue-c11/
+/* Thread-safe queue for a single producer/single consumer model,
+ * implemented as a lock-free ring buffer so the UI and GameLoop threads
+ * never contend on a mutex or pay a futex wakeup on this path.
+ *
+ * Each side owns one counter and keeps a cached copy of the other side's
+ * counter, only reloading it when the cached value says the queue is
+ * empty (or full). A drain loop of try_pop() thus costs one atomic
+ * acquire per batch of items, not one per item. The counters and the
+ * cached copies live on separate cache lines to avoid false sharing.
  */
 template <typename T>
 class ConcurrentQueue {
 public:
 
+    /* Must be a power of two. Both queues in the program carry a handful
+     * of small items per frame, so this never fills up in practice */
+    static const size_t CAPACITY = 1024;
+
     bool empty() const
     {
-        /* We should not need to protect this function with a mutex */
-        return queue_.empty();
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
     }
 
     void pop(T& item)
     {
-        std::unique_lock<std::mutex> mlock(mutex_);
-        item = queue_.front();
-        queue_.pop();
+        while (!try_pop(item)) {
+            std::this_thread::yield();
+        }
     }
 
     void push(const T& item)
     {
-        std::unique_lock<std::mutex> mlock(mutex_);
-        queue_.push(item);
+        const size_t h = head.load(std::memory_order_relaxed);
+
+        /* Reload the consumer counter only when the cached copy says the
+         * queue is full */
+        if (h - cached_tail >= CAPACITY) {
+            cached_tail = tail.load(std::memory_order_acquire);
+            while (h - cached_tail >= CAPACITY) {
+                std::this_thread::yield();
+                cached_tail = tail.load(std::memory_order_acquire);
+            }
+        }
+
+        buffer[h & (CAPACITY-1)] = item;
+        head.store(h + 1, std::memory_order_release);
+
+        if (notify_fd >= 0) {
+            const uint64_t one = 1;
+            if (write(notify_fd, &one, sizeof(one)) < 0) {}
+        }
+    }
+
+    /* Register an eventfd that push() signals, so the consumer can wait for
+     * items in a poll() together with other descriptors instead of waking
+     * up periodically to check the queue. The consumer is responsible for
+     * draining the eventfd counter when woken. */
+    void setNotifyFd(int fd)
+    {
+        notify_fd = fd;
     }
 
-    ConcurrentQueue()=default;
+    /* Non-blocking pop, returns false when the queue is empty */
+    bool try_pop(T& item)
+    {
+        const size_t t = tail.load(std::memory_order_relaxed);
+
+        /* Reload the producer counter only when the cached copy says the
+         * queue is empty */
+        if (t == cached_head) {
+            cached_head = head.load(std::memory_order_acquire);
+            if (t == cached_head)
+                return false;
+        }
+
+        item = buffer[t & (CAPACITY-1)];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    ConcurrentQueue() : head(0), cached_tail(0), tail(0), cached_head(0) {}
     ConcurrentQueue(const ConcurrentQueue&) = delete;            // disable copying
     ConcurrentQueue& operator=(const ConcurrentQueue&) = delete; // disable assignment
 
 private:
-    std::queue<T> queue_;
-    std::mutex mutex_;
+    T buffer[CAPACITY];
+
+    /* Producer side */
+    alignas(64) std::atomic<size_t> head;
+    size_t cached_tail;
+
+    /* Consumer side */
+    alignas(64) std::atomic<size_t> tail;
+    size_t cached_head;
+
+    /* Optional eventfd signaled on push */
+    int notify_fd = -1;
 };
 
 #endif
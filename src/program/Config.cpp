@@ -21,6 +21,56 @@
 #include "Config.h"
 #include <fcntl.h>
 #include <unistd.h> // access
+#include <sys/stat.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+/* Layout version of the binary launch cache, bump when the cached fields
+ * change */
+static const uint32_t CACHE_MAGIC = 0x4343544C; /* "LTCC" */
+static const uint32_t CACHE_VERSION = 1;
+
+struct CacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    /* Guards against SharedConfig layout changes without a version bump */
+    uint32_t sc_size;
+    uint32_t padding;
+    /* Identity of the settings file the cache was built from */
+    int64_t ini_mtime_sec;
+    int64_t ini_mtime_nsec;
+    int64_t ini_size;
+};
+
+static bool readBlock(const std::vector<char>& buf, size_t& pos, void* dest, size_t size)
+{
+    if (pos + size > buf.size())
+        return false;
+    memcpy(dest, buf.data() + pos, size);
+    pos += size;
+    return true;
+}
+
+static bool readString(const std::vector<char>& buf, size_t& pos, std::string& str)
+{
+    uint32_t len;
+    if (!readBlock(buf, pos, &len, sizeof(len)))
+        return false;
+    if (pos + len > buf.size())
+        return false;
+    str.assign(buf.data() + pos, len);
+    pos += len;
+    return true;
+}
+
+static void writeString(FILE* f, const std::string& str)
+{
+    uint32_t len = str.size();
+    fwrite(&len, sizeof(len), 1, f);
+    fwrite(str.data(), 1, len, f);
+}
 
 QString Config::iniPath(const std::string& gamepath) const {
     /* Get the game executable name from path */
@@ -70,6 +120,7 @@ void Config::save(const std::string& gamepath) {
     settings.setValue("moviefile", moviefile.c_str());
     settings.setValue("dumpfile", dumpfile.c_str());
     settings.setValue("ffmpegoptions", ffmpegoptions.c_str());
+    settings.setValue("savestate_ignore_paths", savestate_ignore_paths.c_str());
     settings.setValue("libdir", libdir.c_str());
     settings.setValue("rundir", rundir.c_str());
     settings.setValue("on_movie_end", on_movie_end);
@@ -78,6 +129,7 @@ void Config::save(const std::string& gamepath) {
     settings.setValue("autosave_frames", autosave_frames);
     settings.setValue("autosave_count", autosave_count);
     settings.setValue("auto_restart", auto_restart);
+    settings.setValue("zygote_restart", zygote_restart);
 
     settings.beginGroup("keymapping");
 
@@ -124,6 +176,9 @@ void Config::save(const std::string& gamepath) {
     settings.setValue("osd_inputs_location", sc.osd_inputs_location);
     settings.setValue("prevent_savefiles", sc.prevent_savefiles);
     settings.setValue("recycle_threads", sc.recycle_threads);
+    settings.setValue("deterministic_heap", sc.deterministic_heap);
+    settings.setValue("alloc_profiling", sc.alloc_profiling);
+    settings.setValue("fast_prng", sc.fast_prng);
     settings.setValue("audio_bitdepth", sc.audio_bitdepth);
     settings.setValue("audio_channels", sc.audio_channels);
     settings.setValue("audio_frequency", sc.audio_frequency);
@@ -148,9 +203,21 @@ void Config::save(const std::string& gamepath) {
     settings.setValue("save_screenpixels", sc.save_screenpixels);
     settings.setValue("incremental_savestates", sc.incremental_savestates);
     settings.setValue("savestates_in_ram", sc.savestates_in_ram);
+    settings.setValue("compressed_savestates", sc.compressed_savestates);
+    settings.setValue("background_savestates", sc.background_savestates);
+    settings.setValue("dedup_savestates", sc.dedup_savestates);
+    settings.setValue("checksum_savestates", sc.checksum_savestates);
+    settings.setValue("rewind_savestates", sc.rewind_savestates);
+    settings.setValue("mmap_loadstates", sc.mmap_loadstates);
     settings.setValue("backtrack_savestate", sc.backtrack_savestate);
+    settings.setValue("state_digest", sc.state_digest);
 
     settings.endGroup();
+
+    /* Rewrite the binary cache so that it matches the settings file that
+     * was just written */
+    settings.sync();
+    saveCache(gamepath);
 }
 
 void Config::load(const std::string& gamepath) {
@@ -172,6 +239,11 @@ void Config::load(const std::string& gamepath) {
     if (gamepath.empty())
         return;
 
+    /* The binary cache holds the resolved per-game settings: one read
+     * replaces the text parsing below when it matches the settings file */
+    if (loadCache(gamepath))
+        return;
+
     /* Open the preferences for the game */
     QSettings settings(iniPath(gamepath), QSettings::IniFormat);
     settings.setFallbacksEnabled(false);
@@ -185,6 +257,7 @@ void Config::load(const std::string& gamepath) {
     dumpfile = settings.value("dumpfile", default_dumpfile.c_str()).toString().toStdString();
 
     ffmpegoptions = settings.value("ffmpegoptions", ffmpegoptions.c_str()).toString().toStdString();
+    savestate_ignore_paths = settings.value("savestate_ignore_paths", savestate_ignore_paths.c_str()).toString().toStdString();
 
     libdir = settings.value("libdir", "").toString().toStdString();
     rundir = settings.value("rundir", "").toString().toStdString();
@@ -195,6 +268,7 @@ void Config::load(const std::string& gamepath) {
     autosave_frames = settings.value("autosave_frames", autosave_frames).toInt();
     autosave_count = settings.value("autosave_count", autosave_count).toInt();
     auto_restart = settings.value("auto_restart", auto_restart).toBool();
+    zygote_restart = settings.value("zygote_restart", zygote_restart).toBool();
 
     /* Load key mapping */
 
@@ -245,6 +319,9 @@ void Config::load(const std::string& gamepath) {
     sc.osd_inputs_location = settings.value("osd_inputs_location", sc.osd_inputs_location).toInt();
     sc.prevent_savefiles = settings.value("prevent_savefiles", sc.prevent_savefiles).toBool();
     sc.recycle_threads = settings.value("recycle_threads", sc.recycle_threads).toBool();
+    sc.deterministic_heap = settings.value("deterministic_heap", sc.deterministic_heap).toBool();
+    sc.alloc_profiling = settings.value("alloc_profiling", sc.alloc_profiling).toBool();
+    sc.fast_prng = settings.value("fast_prng", sc.fast_prng).toBool();
     sc.audio_bitdepth = settings.value("audio_bitdepth", sc.audio_bitdepth).toInt();
     sc.audio_channels = settings.value("audio_channels", sc.audio_channels).toInt();
     sc.audio_frequency = settings.value("audio_frequency", sc.audio_frequency).toInt();
@@ -261,7 +338,14 @@ void Config::load(const std::string& gamepath) {
     sc.save_screenpixels = settings.value("save_screenpixels", sc.save_screenpixels).toBool();
     sc.incremental_savestates = settings.value("incremental_savestates", sc.incremental_savestates).toBool();
     sc.savestates_in_ram = settings.value("savestates_in_ram", sc.savestates_in_ram).toBool();
+    sc.compressed_savestates = settings.value("compressed_savestates", sc.compressed_savestates).toBool();
+    sc.background_savestates = settings.value("background_savestates", sc.background_savestates).toBool();
+    sc.dedup_savestates = settings.value("dedup_savestates", sc.dedup_savestates).toBool();
+    sc.checksum_savestates = settings.value("checksum_savestates", sc.checksum_savestates).toBool();
+    sc.rewind_savestates = settings.value("rewind_savestates", sc.rewind_savestates).toBool();
+    sc.mmap_loadstates = settings.value("mmap_loadstates", sc.mmap_loadstates).toBool();
     sc.backtrack_savestate = settings.value("backtrack_savestate", sc.backtrack_savestate).toBool();
+    sc.state_digest = settings.value("state_digest", sc.state_digest).toBool();
     sc.opengl_soft = settings.value("opengl_soft", sc.opengl_soft).toBool();
 
     size = settings.beginReadArray("main_gettimes_threshold");
@@ -272,4 +356,178 @@ void Config::load(const std::string& gamepath) {
     settings.endArray();
 
     settings.endGroup();
+
+    /* The settings existed but the cache did not match them (stale, old
+     * version, or first run since the cache was introduced): build it from
+     * the values that were just parsed */
+    saveCache(gamepath);
+}
+
+bool Config::loadCache(const std::string& gamepath)
+{
+    std::string inipath = iniPath(gamepath).toStdString();
+    struct stat inistat;
+    if (stat(inipath.c_str(), &inistat) != 0)
+        return false;
+
+    FILE* f = fopen((inipath + ".cache").c_str(), "rb");
+    if (!f)
+        return false;
+
+    /* Read the whole cache in one go */
+    fseek(f, 0, SEEK_END);
+    long cache_size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    std::vector<char> buf((cache_size > 0) ? cache_size : 0);
+    size_t read_size = fread(buf.data(), 1, buf.size(), f);
+    fclose(f);
+    if (buf.empty() || (read_size != buf.size()))
+        return false;
+
+    size_t pos = 0;
+    CacheHeader ch;
+    if (!readBlock(buf, pos, &ch, sizeof(ch)))
+        return false;
+
+    /* The cache must describe the settings file as it is now */
+    if ((ch.magic != CACHE_MAGIC) ||
+        (ch.version != CACHE_VERSION) ||
+        (ch.sc_size != sizeof(SharedConfig)) ||
+        (ch.ini_mtime_sec != inistat.st_mtim.tv_sec) ||
+        (ch.ini_mtime_nsec != inistat.st_mtim.tv_nsec) ||
+        (ch.ini_size != inistat.st_size))
+        return false;
+
+    /* Decode into a copy, so that a truncated cache leaves the config
+     * untouched and the caller parses the text settings instead */
+    Config tmp = *this;
+
+    bool ok = readBlock(buf, pos, &tmp.sc, sizeof(tmp.sc));
+
+    ok = ok && readString(buf, pos, tmp.gameargs);
+    ok = ok && readString(buf, pos, tmp.moviefile);
+    ok = ok && readString(buf, pos, tmp.dumpfile);
+    ok = ok && readString(buf, pos, tmp.ffmpegoptions);
+    ok = ok && readString(buf, pos, tmp.savestate_ignore_paths);
+    ok = ok && readString(buf, pos, tmp.libdir);
+    ok = ok && readString(buf, pos, tmp.rundir);
+
+    ok = ok && readBlock(buf, pos, &tmp.on_movie_end, sizeof(tmp.on_movie_end));
+    ok = ok && readBlock(buf, pos, &tmp.autosave, sizeof(tmp.autosave));
+    ok = ok && readBlock(buf, pos, &tmp.autosave_delay_sec, sizeof(tmp.autosave_delay_sec));
+    ok = ok && readBlock(buf, pos, &tmp.autosave_frames, sizeof(tmp.autosave_frames));
+    ok = ok && readBlock(buf, pos, &tmp.autosave_count, sizeof(tmp.autosave_count));
+    ok = ok && readBlock(buf, pos, &tmp.auto_restart, sizeof(tmp.auto_restart));
+    ok = ok && readBlock(buf, pos, &tmp.zygote_restart, sizeof(tmp.zygote_restart));
+
+    uint32_t count = 0;
+    ok = ok && readBlock(buf, pos, &count, sizeof(count));
+    if (ok) {
+        tmp.km.hotkey_mapping.clear();
+        for (uint32_t i = 0; ok && (i < count); i++) {
+            uint32_t keysym;
+            int32_t type;
+            ok = readBlock(buf, pos, &keysym, sizeof(keysym)) &&
+                 readBlock(buf, pos, &type, sizeof(type));
+            if (ok) {
+                HotKey hk;
+                hk.type = static_cast<HotKeyType>(type);
+                tmp.km.hotkey_mapping[keysym] = hk;
+            }
+        }
+    }
+
+    ok = ok && readBlock(buf, pos, &count, sizeof(count));
+    if (ok) {
+        tmp.km.input_mapping.clear();
+        for (uint32_t i = 0; ok && (i < count); i++) {
+            uint32_t keysym;
+            int32_t type;
+            uint32_t value;
+            ok = readBlock(buf, pos, &keysym, sizeof(keysym)) &&
+                 readBlock(buf, pos, &type, sizeof(type)) &&
+                 readBlock(buf, pos, &value, sizeof(value));
+            if (ok) {
+                SingleInput si;
+                si.type = type;
+                si.value = value;
+                tmp.km.input_mapping[keysym] = si;
+            }
+        }
+    }
+
+    if (!ok)
+        return false;
+
+    *this = tmp;
+    return true;
+}
+
+void Config::saveCache(const std::string& gamepath)
+{
+    std::string inipath = iniPath(gamepath).toStdString();
+    struct stat inistat;
+    if (stat(inipath.c_str(), &inistat) != 0)
+        return;
+
+    std::string cachepath = inipath + ".cache";
+    FILE* f = fopen(cachepath.c_str(), "wb");
+    if (!f)
+        return;
+
+    CacheHeader ch;
+    ch.magic = CACHE_MAGIC;
+    ch.version = CACHE_VERSION;
+    ch.sc_size = sizeof(SharedConfig);
+    ch.padding = 0;
+    ch.ini_mtime_sec = inistat.st_mtim.tv_sec;
+    ch.ini_mtime_nsec = inistat.st_mtim.tv_nsec;
+    ch.ini_size = inistat.st_size;
+    fwrite(&ch, sizeof(ch), 1, f);
+
+    fwrite(&sc, sizeof(sc), 1, f);
+
+    writeString(f, gameargs);
+    writeString(f, moviefile);
+    writeString(f, dumpfile);
+    writeString(f, ffmpegoptions);
+    writeString(f, savestate_ignore_paths);
+    writeString(f, libdir);
+    writeString(f, rundir);
+
+    fwrite(&on_movie_end, sizeof(on_movie_end), 1, f);
+    fwrite(&autosave, sizeof(autosave), 1, f);
+    fwrite(&autosave_delay_sec, sizeof(autosave_delay_sec), 1, f);
+    fwrite(&autosave_frames, sizeof(autosave_frames), 1, f);
+    fwrite(&autosave_count, sizeof(autosave_count), 1, f);
+    fwrite(&auto_restart, sizeof(auto_restart), 1, f);
+    fwrite(&zygote_restart, sizeof(zygote_restart), 1, f);
+
+    uint32_t count = km.hotkey_mapping.size();
+    fwrite(&count, sizeof(count), 1, f);
+    for (auto& hmap : km.hotkey_mapping) {
+        uint32_t keysym = hmap.first;
+        int32_t type = hmap.second.type;
+        fwrite(&keysym, sizeof(keysym), 1, f);
+        fwrite(&type, sizeof(type), 1, f);
+    }
+
+    count = km.input_mapping.size();
+    fwrite(&count, sizeof(count), 1, f);
+    for (auto& imap : km.input_mapping) {
+        uint32_t keysym = imap.first;
+        int32_t type = imap.second.type;
+        uint32_t value = imap.second.value;
+        fwrite(&keysym, sizeof(keysym), 1, f);
+        fwrite(&type, sizeof(type), 1, f);
+        fwrite(&value, sizeof(value), 1, f);
+    }
+
+    /* A partially written cache must not be picked up at the next launch */
+    if (ferror(f)) {
+        fclose(f);
+        unlink(cachepath.c_str());
+        return;
+    }
+    fclose(f);
 }
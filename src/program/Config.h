@@ -61,9 +61,36 @@ public:
     /* Was the dump file modified */
     bool dumpfile_modified;
 
+    /* Mapping path patterns excluded from savestates, one fnmatch() glob
+     * per line. Lets users skip driver arenas and shader caches that the
+     * game never reads back */
+    std::string savestate_ignore_paths;
+
+    /* Was the exclusion list modified, or rolled back in the game by a
+     * state loading */
+    bool savestate_ignore_modified = false;
+
     /* Were we started up with the -d option? */
     bool dumping;
 
+    /* Restrict a command-line dump to movie frames [start, end).
+     * A start of 0 encodes from the beginning; an end of 0 encodes until
+     * the movie end. Used for segmented dumping, where several instances
+     * each encode a slice of the movie in parallel. */
+    unsigned long dump_range_start = 0;
+    unsigned long dump_range_end = 0;
+
+    /* Were we started with --verify? The movie plays unattended with every
+     * fast-forward skipping flag set, and the program exits when the movie
+     * ends, reporting the reached frame and game time on stdout. Together
+     * with --instance, a batch of movies can be checked in parallel. */
+    bool verifying = false;
+
+    /* Script file for the input brute-forcing bot started with --bot, or
+     * empty when the bot is off. The script format is described in
+     * BruteForce.h */
+    std::string botfile;
+
     /* Path of the libraries used by the game */
     std::string libdir;
 
@@ -111,6 +138,10 @@ public:
     /* Do we restart the game when it exits? */
     bool auto_restart = false;
 
+    /* Do we implement restarts as loads of a pristine boot state into the
+     * running process (zygote mode), instead of relaunching the game? */
+    bool zygote_restart = false;
+
     /* Save the config into the config file */
     void save(const std::string& gamepath);
 
@@ -119,6 +150,12 @@ public:
 
 private:
     QString iniPath(const std::string& gamepath) const;
+
+    /* Binary cache of the resolved per-game settings, stored beside the
+     * settings file and invalidated by its mtime and size. Launching reads
+     * it back in one read instead of parsing the text settings. */
+    bool loadCache(const std::string& gamepath);
+    void saveCache(const std::string& gamepath);
 };
 
 #endif
@@ -78,6 +78,12 @@ struct Context {
     /* PID of the game */
     pid_t game_pid;
 
+    /* Buffers shared with the game, received as sealed memfds during the
+     * init handshake, or -1 when the game did not send them. Closed when
+     * the game instance exits. */
+    int preview_fd = -1;
+    int slotinfo_fd = -1;
+
     /* Attaching gdb? */
     bool attach_gdb = false;
 
@@ -96,6 +102,15 @@ struct Context {
     /* A frame number when the game pauses */
     unsigned long pause_frame = 0;
 
+    /* A frame number that the input editor asked to seek to, using the
+     * greenzone states. Zero when no seek is pending */
+    unsigned long seek_frame = 0;
+
+    /* Set when the movie was edited, together with the first modified frame,
+     * so the game loop prunes the greenzone states past the edit */
+    bool greenzone_invalid = false;
+    unsigned long greenzone_invalid_frame = 0;
+
     /* Can we use incremental savestates? */
     bool is_soft_dirty = false;
 
@@ -35,6 +35,7 @@
 #include <string>
 #include <sstream>
 #include <iostream>
+#include <iomanip>
 #include <cerrno>
 #include <unistd.h> // fork()
 #include <fcntl.h> // O_RDWR, O_CREAT
@@ -42,6 +43,8 @@
 #include <csignal> // kill
 #include <sys/stat.h> // stat
 #include <sys/wait.h> // waitpid
+#include <sys/eventfd.h>
+#include <poll.h>
 #include <X11/X.h>
 
 #include <sys/personality.h>
@@ -50,8 +53,19 @@
 # define personality(pers) ((long)syscall(SYS_personality, pers))
 #endif
 
-GameLoop::GameLoop(Context* c) : context(c), keysyms(xcb_key_symbols_alloc(c->conn), xcb_key_symbols_free) {
+GameLoop::GameLoop(Context* c) : context(c), greenzone(c), keysyms(xcb_key_symbols_alloc(c->conn), xcb_key_symbols_free) {
     movie = MovieFile(context);
+
+    /* Hotkeys pushed by the UI wake up the paused loop through this eventfd */
+    hotkey_event_fd = eventfd(0, EFD_NONBLOCK);
+    context->hotkey_queue.setNotifyFd(hotkey_event_fd);
+}
+
+uint64_t GameLoop::monotonicNs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * UINT64_C(1000000000) + now.tv_nsec;
 }
 
 void GameLoop::launchGameThread()
@@ -199,7 +213,38 @@ void GameLoop::start()
             return;
         }
 
-        emit startFrameBoundary();
+        /* Publish the coalesced per-frame UI updates. A forced publish when
+         * paused, so a single frame advance updates the UI at once */
+        ram_ui_pending = true;
+        publishUIUpdates(!context->config.sc.running);
+
+        /* The game free-runs on a streamed input batch: it does not
+         * listen at the boundary, so only watch for anything that must
+         * interrupt the replay and invalidate the batch */
+        if (!library_lockstep) {
+            freerunBoundary();
+            continue;
+        }
+
+        /* Maintain the greenzone while the game waits at the boundary */
+        bool botDone = false;
+        if (context->game_window) {
+            if (bot.isActive()) {
+                /* The bot owns the savestates during a search, so the
+                 * greenzone lattice is not filled */
+                botDone = botFrameBoundary();
+            }
+            else {
+                pruneGreenzone();
+                captureGreenzoneState();
+            }
+        }
+
+        /* Capture the pristine boot state used by in-place restarts. Done
+         * before the window id check, as the first boundary may come before
+         * the game created its window */
+        if (context->config.zygote_restart && !bot.isActive())
+            captureZygoteState();
 
         /* We are at a frame boundary */
         /* If we did not yet receive the game window id, just make the game running */
@@ -209,6 +254,18 @@ void GameLoop::start()
             /* Check if game is still running */
             int ret = waitpid(context->game_pid, nullptr, WNOHANG);
             if (ret == context->game_pid) {
+                if (bot.isActive()) {
+                    std::cerr << "bot: game exited during the search" << std::endl;
+                    bot.printReport();
+                    exit(2);
+                }
+                if (context->config.verifying) {
+                    std::cout << "verification: game exited at frame "
+                        << context->framecount << " of "
+                        << context->config.sc.movie_framecount
+                        << " movie frames" << std::endl;
+                    exit(2);
+                }
                 emit alertToShow(QString("Game did not exit normally..."));
                 loopExit();
                 return;
@@ -223,29 +280,77 @@ void GameLoop::start()
                     ar_advance = true;
             }
 
+            /* Drain every pending event before possibly sleeping, so a batch
+             * of queued events already read into the xcb buffer is dispatched
+             * now. Such events don't make the connection readable, so they
+             * would otherwise wait out the poll timeout one by one. We stop
+             * at the first event that advanced the frame or changed the loop
+             * state, so each press of a frame advance batch still advances
+             * one frame. */
             struct HotKey hk;
-            uint8_t eventType = nextEvent(hk);
-
+            uint8_t eventType;
             bool hasFrameAdvanced = false;
-            if (eventType) {
-                hasFrameAdvanced = processEvent(eventType, hk);
+
+            /* First process the event that interrupted the last free-run,
+             * it was consumed but could not be handled at the time */
+            if (deferred_event_type) {
+                hasFrameAdvanced = processEvent(deferred_event_type, deferred_hk);
+                deferred_event_type = 0;
+            }
+
+            if (!hasFrameAdvanced) {
+                while ((eventType = nextEvent(hk))) {
+                    hasFrameAdvanced = processEvent(eventType, hk);
+                    if (hasFrameAdvanced || context->config.sc.running ||
+                        (context->status == Context::QUITTING))
+                        break;
+                }
+            }
+
+            /* Seek requests from the input editor are handled here, so that
+             * they work while the game is paused */
+            if (context->seek_frame) {
+                seekToFrame();
             }
 
             endInnerLoop = context->config.sc.running || ar_advance ||
                 hasFrameAdvanced || (context->status == Context::QUITTING);
 
             if (!endInnerLoop) {
+                /* No more frames are coming for now, flush any update still
+                 * held back by the throttle */
+                publishUIUpdates(true);
                 sleepSendPreview();
             }
         } while (!endInnerLoop);
 
         AllInputs ai;
         processInputs(ai);
+
+        /* The bot replaces the inputs inside its search window */
+        bot.overrideInputs(context->framecount, ai);
+
         prev_ai = ai;
 
-        /* Set the status to restart */
+        /* Start a ranged command-line dump when its first frame is reached */
+        if (context->config.dumping && !context->config.sc.av_dumping &&
+            context->config.dump_range_start &&
+            (context->framecount == context->config.dump_range_start)) {
+            context->config.sc.av_dumping = true;
+            context->config.sc_modified = true;
+            context->config.dumpfile_modified = true;
+            emit sharedConfigChanged();
+        }
+
+        /* Set the status to restart. In zygote mode, the restart is done in
+         * place by loading the pristine boot state, saving the exec and
+         * engine boot of a relaunch. A failed in-place restart falls back
+         * to the relaunch path */
         if (ai.restart) {
-            context->status = Context::RESTARTING;
+            if (!(context->config.zygote_restart && zygote_captured &&
+                  restartFromZygote())) {
+                context->status = Context::RESTARTING;
+            }
         }
 
         bool shouldQuit = false;
@@ -265,11 +370,26 @@ void GameLoop::start()
                 /* Pause and disable fast-forward */
                 context->config.sc.running = false;
                 context->config.sc.fastforward = false;
+
+                /* Re-enable presentation if the seek forced it off */
+                exitTurboSeek();
+
                 context->config.sc_modified = true;
                 emit sharedConfigChanged();
             }
         }
 
+        /* A verification run is done once the last movie frame has been fed */
+        if (context->config.verifying &&
+            (context->config.sc.movie_framecount == (context->framecount + 1))) {
+            shouldQuit = true;
+        }
+
+        /* The bot search is over once every candidate was scored */
+        if (botDone) {
+            shouldQuit = true;
+        }
+
         endFrameMessages(ai);
 
         if (shouldQuit) {
@@ -298,6 +418,32 @@ void GameLoop::init()
     if (context->status != Context::RESTARTING)
         context->encoding_segment = 0;
 
+    /* A new game run gets a fresh divergence report */
+    digest_divergence_frame = 0;
+
+    /* The pristine boot state belongs to one game instance: a relaunched
+     * process must capture its own */
+    zygote_captured = false;
+
+    /* A freshly launched game answers every frame boundary */
+    library_lockstep = true;
+    batch_invalidated = false;
+    deferred_event_type = 0;
+
+    /* A freshly launched game holds no input delta reference */
+    input_keyframe_pending = true;
+    frames_since_keyframe = 0;
+
+    /* Reset the UI update coalescing */
+    last_ui_publish = 0;
+    frame_ui_pending = false;
+    ram_ui_pending = false;
+    fps_ui_pending = false;
+    fts_ui_pending = false;
+    alloc_ui_pending = false;
+    last_fps = 0;
+    last_lfps = 0;
+
     /* Extract the game executable name from the game executable path */
     size_t sep = context->gamepath.find_last_of("/");
     if (sep != std::string::npos)
@@ -305,8 +451,39 @@ void GameLoop::init()
     else
         context->gamename = context->gamepath;
 
-    /* Remove savestates again in case we did not exist cleanly the previous time */
-    remove_savestates(context);
+    /* Remove savestates again in case we did not exist cleanly the previous time.
+     * Don't touch them when dumping from the command line: they are not used
+     * there, and a concurrent instance of the same game may own them. */
+    if (!context->config.dumping && !context->config.verifying &&
+        context->config.botfile.empty())
+        remove_savestates(context);
+
+    /* A ranged command-line dump quits at the range end through the
+     * pause_frame mechanism */
+    if (context->config.dumping && context->config.dump_range_end)
+        context->pause_frame = context->config.dump_range_end;
+
+    /* A verification run renders nothing: force every fast-forward
+     * skipping flag, like a turbo seek */
+    if (context->config.verifying)
+        context->config.sc.fastforward_mode = SharedConfig::FF_SLEEP |
+            SharedConfig::FF_MIXING | SharedConfig::FF_RENDERING;
+
+    /* A bot run renders nothing either, and needs cheap state restores, so
+     * incremental RAM states are forced on */
+    if (!context->config.botfile.empty()) {
+        if (!bot.load(context, movie, context->config.botfile))
+            exit(1);
+        context->config.sc.savestates_in_ram = true;
+        context->config.sc.incremental_savestates = true;
+        context->config.sc.fastforward_mode = SharedConfig::FF_SLEEP |
+            SharedConfig::FF_MIXING | SharedConfig::FF_RENDERING;
+    }
+
+    /* Greenzone states belong to the game process, so they did not survive */
+    greenzone.clear();
+    context->seek_frame = 0;
+    context->greenzone_invalid = false;
 
     /* Remove the file socket */
     removeSocket();
@@ -321,6 +498,8 @@ void GameLoop::init()
     ar_delay = 50;
     ar_freq = 2;
 
+    ff_mode_before_seek = -1;
+
     /* Compute the MD5 hash of the game binary */
     context->md5_game.clear();
     std::ostringstream cmd;
@@ -407,6 +586,20 @@ void GameLoop::initProcessMessages()
                 receiveData(&context->game_pid, sizeof(pid_t));
                 break;
 
+            /* Get the shared buffers, as sealed memfds passed over the
+             * socket. The preview and savestate panes map them. */
+            case MSGB_PREVIEW_FD:
+                if (context->preview_fd >= 0)
+                    close(context->preview_fd);
+                context->preview_fd = receiveFd();
+                break;
+
+            case MSGB_SLOTINFO_FD:
+                if (context->slotinfo_fd >= 0)
+                    close(context->slotinfo_fd);
+                context->slotinfo_fd = receiveFd();
+                break;
+
             default:
                 // ui_print("Message init: unknown message\n");
                 loopExit();
@@ -434,6 +627,12 @@ void GameLoop::initProcessMessages()
         sendString(context->config.ffmpegoptions);
     }
 
+    /* Send the savestate exclusion patterns */
+    if (!context->config.savestate_ignore_paths.empty()) {
+        sendMessage(MSGN_SAVESTATE_IGNORE);
+        sendString(context->config.savestate_ignore_paths);
+    }
+
     /* Build and send the base savestate path/index */
     if (context->config.sc.incremental_savestates) {
         sendMessage(MSGN_BASE_SAVESTATE_INDEX);
@@ -468,7 +667,7 @@ bool GameLoop::startFrameMessages()
     int message = receiveMessage();
 
     while (message != MSGB_START_FRAMEBOUNDARY) {
-        float fps, lfps;
+        uint64_t digest;
         switch (message) {
         case MSGB_WINDOW_ID:
             receiveData(&context->game_window, sizeof(Window));
@@ -500,28 +699,86 @@ bool GameLoop::startFrameMessages()
                 context->config.sc.movie_framecount = context->framecount;
             }
             receiveData(&context->current_time, sizeof(struct timespec));
-            emit frameCountChanged();
+            frame_ui_pending = true;
             break;
         case MSGB_GAMEINFO:
             receiveData(&context->game_info, sizeof(context->game_info));
             emit gameInfoChanged(context->game_info);
             break;
         case MSGB_FPS:
-            receiveData(&fps, sizeof(float));
-            receiveData(&lfps, sizeof(float));
-            emit fpsChanged(fps, lfps);
+            receiveData(&last_fps, sizeof(float));
+            receiveData(&last_lfps, sizeof(float));
+            fps_ui_pending = true;
             break;
         case MSGB_ENCODING_SEGMENT:
             receiveData(&context->encoding_segment, sizeof(int));
             break;
+        case MSGB_FRAMETIME_STATS:
+            receiveData(&last_fts, sizeof(FrameTimeStats));
+            fts_ui_pending = true;
+            break;
+        case MSGB_ALLOC_STATS:
+            receiveData(&last_alloc_stats, sizeof(AllocStats));
+            alloc_ui_pending = true;
+            break;
+        case MSGB_INPUT_APPLIED:
+            /* Timestamp of the input application of the elapsed frame */
+            receiveData(&lat_apply, sizeof(uint64_t));
+            break;
         case MSGB_DO_BACKTRACK_SAVESTATE:
             context->hotkey_queue.push(HOTKEY_SAVESTATE_BACKTRACK);
             break;
+        case MSGB_LOCKSTEP:
+            /* The game dropped out of free-run and answers the frame
+             * boundaries again */
+            library_lockstep = true;
+            break;
+        case MSGB_STATE_DIGEST:
+            receiveData(&digest, sizeof(uint64_t));
+            /* The digest of frame N is stored at movie index N-1, next to
+             * the inputs that produced it */
+            if (context->framecount > 0) {
+                unsigned long pos = context->framecount - 1;
+                if (context->config.sc.recording == SharedConfig::RECORDING_WRITE) {
+                    if (movie.digest_list.size() <= pos)
+                        movie.digest_list.resize(pos + 1, 0);
+                    movie.digest_list[pos] = digest;
+                }
+                else if ((context->config.sc.recording == SharedConfig::RECORDING_READ) &&
+                         (digest_divergence_frame == 0) &&
+                         (pos < movie.digest_list.size()) &&
+                         (movie.digest_list[pos] != 0) &&
+                         (movie.digest_list[pos] != digest)) {
+                    digest_divergence_frame = context->framecount;
+                    std::cerr << "digest: first divergence from the movie at frame "
+                        << digest_divergence_frame << std::endl;
+                    emit alertToShow(QString("The game state diverged from the movie at frame %1").arg(digest_divergence_frame));
+                }
+            }
+            break;
         case MSGB_QUIT:
+            if (bot.isActive()) {
+                /* Finished a bot search, print the best input sequence */
+                bot.printReport();
+                exit(0);
+            }
             if (context->config.dumping) {
                 /* Finished running a dump from the command line */
                 exit(0);
             }
+            if (context->config.verifying) {
+                /* Finished a verification run. The printed frame and game
+                 * time only depend on the movie, so this line can be
+                 * compared between runs and machines. */
+                bool complete = (context->framecount >= context->config.sc.movie_framecount);
+                std::cout << "verification: replayed " << context->framecount
+                    << " of " << context->config.sc.movie_framecount
+                    << " movie frames, game time "
+                    << context->current_time.tv_sec << "."
+                    << std::setfill('0') << std::setw(9) << context->current_time.tv_nsec
+                    << std::endl;
+                exit(complete ? 0 : 1);
+            }
             return true;
         case -1:
             std::cerr << "The connection to the game was lost. Exiting" << std::endl;
@@ -533,6 +790,48 @@ bool GameLoop::startFrameMessages()
         message = receiveMessage();
     }
 
+    /* Complete the pending latency sample: the frame advanced by the
+     * sampled key press has run up to this boundary. The stage checks
+     * guard against a boundary that carried no application timestamp. */
+    if (lat_pending) {
+        uint64_t now = monotonicNs();
+        if (lat_apply && (lat_dispatch >= lat_event_arrival) &&
+            (lat_send >= lat_dispatch) && (lat_apply >= lat_send) &&
+            (now >= lat_apply)) {
+            const uint64_t stage_ns[InputLatencyStats::STAGE_COUNT] = {
+                lat_dispatch - lat_event_arrival,
+                lat_send - lat_dispatch,
+                lat_apply - lat_send,
+                now - lat_apply,
+            };
+            for (int s = 0; s < InputLatencyStats::STAGE_COUNT; s++) {
+                lat_stats.stage_sum_ns[s] += stage_ns[s];
+                if (stage_ns[s] > lat_stats.stage_max_ns[s])
+                    lat_stats.stage_max_ns[s] = stage_ns[s];
+            }
+
+            uint64_t total_ms = (now - lat_event_arrival) / 1000000;
+            int bucket = 0;
+            while (total_ms && (bucket < InputLatencyStats::NB_BUCKETS - 1)) {
+                total_ms >>= 1;
+                bucket++;
+            }
+            lat_stats.buckets[bucket]++;
+            lat_stats.samples++;
+
+            /* Frame advances are user-paced, so no publish throttle is
+             * needed here */
+            emit inputLatencyChanged(lat_stats);
+        }
+        lat_pending = false;
+    }
+    lat_apply = 0;
+
+    /* The game free-runs on a streamed input batch, it is not listening:
+     * don't send the per-boundary messages */
+    if (!library_lockstep)
+        return false;
+
     /* Send ram watches */
     if (context->config.sc.osd & SharedConfig::OSD_RAMWATCHES) {
         std::string ramwatch;
@@ -544,6 +843,10 @@ bool GameLoop::startFrameMessages()
         }
     }
 
+    /* Flush the frozen watch poke list with one batched write, directly
+     * from this thread so it lands before the game resumes */
+    emit pokeFrozenWatches();
+
     sendMessage(MSGN_START_FRAMEBOUNDARY);
 
     return false;
@@ -563,6 +866,10 @@ uint8_t GameLoop::nextEvent(struct HotKey &hk)
         }
         else {
             event = xcb_poll_for_event(context->conn);
+            /* Timestamp the arrival of a real X event, the start of an
+             * end-to-end latency sample */
+            if (event)
+                lat_event_arrival = monotonicNs();
         }
 
         if (!event) {
@@ -570,7 +877,9 @@ uint8_t GameLoop::nextEvent(struct HotKey &hk)
                 return 0;
             }
             else {
-                /* Processing a hotkey pushed by the UI */
+                /* Processing a hotkey pushed by the UI, with no X event
+                 * arrival to measure the latency from */
+                lat_event_arrival = 0;
                 context->hotkey_queue.pop(hk.type);
                 return XCB_KEY_PRESS;
             }
@@ -657,12 +966,11 @@ uint8_t GameLoop::nextEvent(struct HotKey &hk)
                 free(keymap_reply);
 
                 /* Check if this KeySym with or without modifiers is mapped to a hotkey */
-                if (context->config.km.hotkey_mapping.find(ks | modifiers) != context->config.km.hotkey_mapping.end()) {
-                    hk = context->config.km.hotkey_mapping[ks | modifiers];
-                    return response_type;
-                }
-                else if (context->config.km.hotkey_mapping.find(ks) != context->config.km.hotkey_mapping.end()) {
-                    hk = context->config.km.hotkey_mapping[ks];
+                auto hit = context->config.km.hotkey_mapping.find(ks | modifiers);
+                if (hit == context->config.km.hotkey_mapping.end())
+                    hit = context->config.km.hotkey_mapping.find(ks);
+                if (hit != context->config.km.hotkey_mapping.end()) {
+                    hk = hit->second;
                     return response_type;
                 }
                 else
@@ -680,8 +988,9 @@ uint8_t GameLoop::nextEvent(struct HotKey &hk)
 
 void GameLoop::notifyControllerEvent(xcb_keysym_t ks, bool pressed)
 {
-    if (context->config.km.input_mapping.find(ks) != context->config.km.input_mapping.end()) {
-        SingleInput si = context->config.km.input_mapping[ks];
+    auto it = context->config.km.input_mapping.find(ks);
+    if (it != context->config.km.input_mapping.end()) {
+        SingleInput si = it->second;
         if (si.inputTypeIsController())
             emit controllerButtonToggled(si.inputTypeToControllerNumber(), si.inputTypeToInputNumber(), pressed);
     }
@@ -713,6 +1022,13 @@ bool GameLoop::processEvent(uint8_t type, struct HotKey &hk)
                 context->config.sc_modified = true;
             }
             ar_ticks = 0; // Activate auto-repeat
+
+            /* Start a latency sample when the advance comes from a real
+             * key press whose arrival was timestamped */
+            if (lat_event_arrival) {
+                lat_dispatch = monotonicNs();
+                lat_pending = true;
+            }
             return true;
 
         case HOTKEY_PLAYPAUSE:
@@ -768,14 +1084,52 @@ bool GameLoop::processEvent(uint8_t type, struct HotKey &hk)
                 movie.saveMovie(moviepath, context->framecount);
             }
 
+            /* Building the savestate path */
+            std::string savestatepath = context->config.savestatedir + '/';
+            savestatepath += context->gamename;
+            savestatepath += ".state" + std::to_string(statei);
+
+            /* If the greenzone captured a state at the boundary of this very
+             * frame, duplicate its files into the slot instead of asking the
+             * game to dump its memory again. The copy reflinks when the
+             * filesystem supports it, making the save metadata-speed.
+             * Incremental states are excluded, because their pagemaps refer to
+             * the parent lineage that the game tracks for its own slots. */
+            if (!context->config.sc.savestates_in_ram &&
+                !context->config.sc.incremental_savestates) {
+                int gslot = greenzone.nearestState(context->framecount);
+                if ((gslot >= 0) && (greenzone.stateFrame(gslot) == context->framecount)) {
+                    std::string greenstatepath = context->config.savestatedir + '/';
+                    greenstatepath += context->gamename;
+                    greenstatepath += ".state" + std::to_string(Greenzone::FIRST_INDEX + gslot);
+
+                    if ((copy_file(greenstatepath + ".pm", savestatepath + ".pm") == 0) &&
+                        (copy_file(greenstatepath + ".p", savestatepath + ".p") == 0)) {
+                        if (context->config.sc.osd & SharedConfig::OSD_MESSAGES) {
+                            std::string msg;
+                            if (hk.type == HOTKEY_SAVESTATE_BACKTRACK) {
+                                msg = "Backtrack state saved";
+                            }
+                            else {
+                                msg = "State ";
+                                msg += std::to_string(statei);
+                                msg += " saved";
+                            }
+                            sendMessage(MSGN_OSD_MSG);
+                            sendString(msg);
+                        }
+
+                        emit savestatePerformed(statei, context->framecount);
+                        return false;
+                    }
+                }
+            }
+
             /* Send the savestate index */
             sendMessage(MSGN_SAVESTATE_INDEX);
             sendData(&statei, sizeof(int));
 
             /* Send the savestate path */
-            std::string savestatepath = context->config.savestatedir + '/';
-            savestatepath += context->gamename;
-            savestatepath += ".state" + std::to_string(statei);
             if (! context->config.sc.savestates_in_ram) {
                 sendMessage(MSGN_SAVESTATE_PATH);
                 sendString(savestatepath);
@@ -914,8 +1268,10 @@ bool GameLoop::processEvent(uint8_t type, struct HotKey &hk)
                         /* Fast-forward to savestate frame */
                         context->config.sc.recording = SharedConfig::RECORDING_READ;
                         context->config.sc.movie_framecount = movie.nbFrames();
+                        enterTurboSeek();
                         context->pause_frame = movie.savestateFramecount();
                         context->config.sc.running = true;
+                        context->config.sc.fastforward = true;
                         context->config.sc_modified = true;
 
                         emit sharedConfigChanged();
@@ -998,11 +1354,23 @@ bool GameLoop::processEvent(uint8_t type, struct HotKey &hk)
                 sendMessage(MSGN_CONFIG);
                 sendData(&context->config.sc, sizeof(SharedConfig));
 
+                /* The exclusion pattern list stored in the game was rolled back
+                 * by the memory loading too, flush it at the next boundary */
+                context->config.savestate_ignore_modified =
+                    !context->config.savestate_ignore_paths.empty();
+
+                /* So was the input delta reference, send a keyframe */
+                input_keyframe_pending = true;
+
                 if (context->config.sc.recording == SharedConfig::RECORDING_WRITE) {
                     /* When in writing move, we load the movie associated
                      * with the savestate.
                      */
                     movie.loadInputs(moviepath);
+
+                    /* The movie was replaced, so the greenzone states past
+                     * the savestate frame no longer match it */
+                    greenzone.invalidateAfter(movie.savestateFramecount());
                 }
 
                 /* If the movie was modified since last state load, increment
@@ -1056,6 +1424,100 @@ bool GameLoop::processEvent(uint8_t type, struct HotKey &hk)
             return false;
         }
 
+        case HOTKEY_REWIND:
+
+            /* Step back one frame by loading the most recent state of the
+             * rewind ring buffer that the game fills at each frame boundary.
+             */
+        {
+
+            /* Loading is not allowed if currently encoding */
+            if (context->config.sc.av_dumping) {
+                emit alertToShow(QString("Loading is not allowed when in the middle of video encoding"));
+                return false;
+            }
+
+            /* The ring buffer is only filled when the required savestate
+             * options are enabled */
+            if (!(context->config.sc.rewind_savestates &&
+                  context->config.sc.savestates_in_ram &&
+                  context->config.sc.incremental_savestates)) {
+                emit alertToShow(QString("Rewind requires incremental savestates stored in RAM, and the rewind option enabled"));
+                return false;
+            }
+
+            /* No movie prefix check is needed: rewind states are taken from
+             * the movie being played or recorded, so they always match. */
+
+            sendMessage(MSGN_REWINDSTATE);
+
+            emit inputsToBeChanged();
+
+            int message = receiveMessage();
+            /* Loading is not assured to succeed, the following must
+             * only be done if it's the case.
+             */
+
+            bool didLoad = message == MSGB_LOADING_SUCCEEDED;
+            if (didLoad) {
+                /* The copy of SharedConfig that the game stores may not
+                 * be the same as this one due to memory loading, so we
+                 * send it.
+                 */
+                sendMessage(MSGN_CONFIG);
+                sendData(&context->config.sc, sizeof(SharedConfig));
+
+                /* The exclusion pattern list stored in the game was rolled back
+                 * by the memory loading too, flush it at the next boundary */
+                context->config.savestate_ignore_modified =
+                    !context->config.savestate_ignore_paths.empty();
+
+                /* So was the input delta reference, send a keyframe */
+                input_keyframe_pending = true;
+
+                /* If the movie was modified since last state load, increment
+                 * the rerecord count. */
+                if (movie.modifiedSinceLastStateLoad) {
+                    context->rerecord_count++;
+                    emit rerecordChanged();
+                    movie.modifiedSinceLastStateLoad = false;
+                }
+
+                message = receiveMessage();
+            }
+
+            /* The frame count has changed, we must get the new one */
+            if (message != MSGB_FRAMECOUNT_TIME) {
+                std::cerr << "Got wrong message after state loading" << std::endl;
+
+                if (!context->config.sc.opengl_soft) {
+                    emit alertToShow(QString("Crash after loading the savestate. Savestates are unstable unless you check Video>Force software rendering"));
+                }
+
+                return false;
+            }
+            receiveData(&context->framecount, sizeof(unsigned long));
+            if (context->config.sc.recording == SharedConfig::RECORDING_WRITE) {
+                context->config.sc.movie_framecount = context->framecount;
+            }
+            receiveData(&context->current_time, sizeof(struct timespec));
+
+            emit inputsChanged();
+            emit frameCountChanged();
+
+            if (context->config.sc.osd & SharedConfig::OSD_MESSAGES) {
+                sendMessage(MSGN_OSD_MSG);
+                if (didLoad)
+                    sendString(std::string("Rewound one frame"));
+                else
+                    sendString(std::string("No rewind state available"));
+            }
+
+            sendMessage(MSGN_EXPOSE);
+
+            return false;
+        }
+
         case HOTKEY_READWRITE:
             /* Switch between movie write and read-only */
             switch (context->config.sc.recording) {
@@ -1199,12 +1661,490 @@ bool GameLoop::processEvent(uint8_t type, struct HotKey &hk)
     return false;
 }
 
+void GameLoop::enterTurboSeek()
+{
+    /* The library already knows how to skip rendering, screen capture, HUD
+     * and audio mixing from the fast-forward mode flags, so seeking only
+     * has to force them all, regardless of the user settings */
+    if (ff_mode_before_seek < 0)
+        ff_mode_before_seek = context->config.sc.fastforward_mode;
+    context->config.sc.fastforward_mode = SharedConfig::FF_SLEEP |
+        SharedConfig::FF_MIXING | SharedConfig::FF_RENDERING;
+}
+
+void GameLoop::exitTurboSeek()
+{
+    if (ff_mode_before_seek >= 0) {
+        context->config.sc.fastforward_mode = ff_mode_before_seek;
+        ff_mode_before_seek = -1;
+    }
+}
+
+void GameLoop::freerunBoundary()
+{
+    /* Frozen watches are poked directly into the game memory, so they
+     * keep being written every frame even while the game free-runs */
+    emit pokeFrozenWatches();
+
+    /* Consume at most one event, and keep it for the next lockstep
+     * boundary: processing it now could send messages the game is not
+     * listening to */
+    if (!deferred_event_type) {
+        struct HotKey hk;
+        uint8_t eventType = nextEvent(hk);
+        if (eventType) {
+            deferred_event_type = eventType;
+            deferred_hk = hk;
+        }
+    }
+
+    /* Anything that must alter the replay invalidates the batch, making
+     * the game answer the next boundary so it can be handled there */
+    if (!batch_invalidated &&
+        (deferred_event_type || context->seek_frame ||
+         context->greenzone_invalid || context->config.sc_modified ||
+         context->config.dumpfile_modified ||
+         (context->status != Context::ACTIVE))) {
+        sendMessage(MSGN_INPUT_BATCH_INVALIDATE);
+        batch_invalidated = true;
+    }
+}
+
+void GameLoop::pruneGreenzone()
+{
+    if (context->greenzone_invalid) {
+        greenzone.invalidateAfter(context->greenzone_invalid_frame);
+        greenzone.setCursor(context->greenzone_invalid_frame);
+        context->greenzone_invalid = false;
+    }
+}
+
+void GameLoop::captureGreenzoneState()
+{
+    /* Saving is not allowed if currently encoding */
+    if (context->config.sc.av_dumping)
+        return;
+
+    /* Like the rewind ring buffer, the lattice is only filled when states
+     * are cheap: incremental and stored in RAM */
+    if (!(context->config.sc.savestates_in_ram &&
+          context->config.sc.incremental_savestates))
+        return;
+
+    if (!greenzone.shouldCapture(context->framecount))
+        return;
+
+    int slot = greenzone.pickSlot(context->framecount);
+    if (slot < 0)
+        return;
+
+    /* Tell the game to save its state. Unlike the numbered slots, we don't
+     * save the movie alongside: states past an edit are invalidated, so a
+     * valid state always matches the current movie */
+    int statei = Greenzone::FIRST_INDEX + slot;
+    sendMessage(MSGN_SAVESTATE_INDEX);
+    sendData(&statei, sizeof(int));
+
+    std::string savestatepath = context->config.savestatedir + '/';
+    savestatepath += context->gamename;
+    savestatepath += ".state" + std::to_string(statei);
+    if (! context->config.sc.savestates_in_ram) {
+        sendMessage(MSGN_SAVESTATE_PATH);
+        sendString(savestatepath);
+    }
+    else {
+        /* Create empty savestate files if stored in RAM */
+        std::string pagemappath = savestatepath + ".pm";
+        std::string pagespath = savestatepath + ".p";
+        std::ofstream opm(pagemappath);
+        opm.close();
+        std::ofstream op(pagespath);
+        op.close();
+    }
+
+    sendMessage(MSGN_SAVESTATE);
+
+    greenzone.stateCaptured(slot, context->framecount);
+}
+
+void GameLoop::seekToFrame()
+{
+    /* Apply pending invalidations before looking for a state */
+    pruneGreenzone();
+
+    unsigned long target = context->seek_frame;
+    context->seek_frame = 0;
+
+    /* Loading is not allowed if currently encoding */
+    if (context->config.sc.av_dumping) {
+        emit alertToShow(QString("Seeking is not allowed when in the middle of video encoding"));
+        return;
+    }
+
+    if (target == context->framecount)
+        return;
+
+    /* Load the nearest state at or before the target, when it gets us
+     * closer than the current frame does */
+    int slot = greenzone.nearestState(target);
+    if (slot >= 0) {
+        unsigned long state_frame = greenzone.stateFrame(slot);
+        if ((target < context->framecount) || (state_frame > context->framecount)) {
+            if (!loadGreenzoneState(slot))
+                return;
+        }
+    }
+    else if (target < context->framecount) {
+        /* We cannot go backward without a state */
+        emit alertToShow(QString("No greenzone state exists before the target frame"));
+        return;
+    }
+
+    greenzone.setCursor(target);
+
+    if (context->framecount < target) {
+        /* Fast-forward the remaining frames. When in writing mode, we switch
+         * to playback so that we don't record over the movie */
+        if (context->config.sc.recording == SharedConfig::RECORDING_WRITE) {
+            context->config.sc.recording = SharedConfig::RECORDING_READ;
+            context->config.sc.movie_framecount = movie.nbFrames();
+        }
+        enterTurboSeek();
+        context->pause_frame = target;
+        context->config.sc.running = true;
+        context->config.sc.fastforward = true;
+        context->config.sc_modified = true;
+        emit sharedConfigChanged();
+    }
+    else if (context->config.sc.running) {
+        /* We landed on the target, stay paused */
+        context->config.sc.running = false;
+        context->config.sc_modified = true;
+        emit sharedConfigChanged();
+    }
+}
+
+bool GameLoop::loadGreenzoneState(int slot)
+{
+    /* Send the savestate index */
+    int statei = Greenzone::FIRST_INDEX + slot;
+    sendMessage(MSGN_SAVESTATE_INDEX);
+    sendData(&statei, sizeof(int));
+
+    if (! context->config.sc.savestates_in_ram) {
+        std::string savestatepath = context->config.savestatedir + '/';
+        savestatepath += context->gamename;
+        savestatepath += ".state" + std::to_string(statei);
+        sendMessage(MSGN_SAVESTATE_PATH);
+        sendString(savestatepath);
+    }
+
+    /* No movie prefix check is needed: states past an edit were invalidated,
+     * so this state was captured from the movie as it currently is */
+    sendMessage(MSGN_LOADSTATE);
+
+    emit inputsToBeChanged();
+
+    int message = receiveMessage();
+    /* Loading is not assured to succeed, the following must
+     * only be done if it's the case.
+     */
+
+    bool didLoad = message == MSGB_LOADING_SUCCEEDED;
+    if (didLoad) {
+        /* The copy of SharedConfig that the game stores may not
+         * be the same as this one due to memory loading, so we
+         * send it.
+         */
+        sendMessage(MSGN_CONFIG);
+        sendData(&context->config.sc, sizeof(SharedConfig));
+
+        /* The exclusion pattern list stored in the game was rolled back
+         * by the memory loading too, flush it at the next boundary */
+        context->config.savestate_ignore_modified =
+            !context->config.savestate_ignore_paths.empty();
+
+        /* So was the input delta reference, send a keyframe */
+        input_keyframe_pending = true;
+
+        /* If the movie was modified since last state load, increment
+         * the rerecord count. */
+        if (movie.modifiedSinceLastStateLoad) {
+            context->rerecord_count++;
+            emit rerecordChanged();
+            movie.modifiedSinceLastStateLoad = false;
+        }
+
+        message = receiveMessage();
+    }
+
+    /* The frame count has changed, we must get the new one */
+    if (message != MSGB_FRAMECOUNT_TIME) {
+        std::cerr << "Got wrong message after state loading" << std::endl;
+        return false;
+    }
+    receiveData(&context->framecount, sizeof(unsigned long));
+    if (context->config.sc.recording == SharedConfig::RECORDING_WRITE) {
+        context->config.sc.movie_framecount = context->framecount;
+    }
+    receiveData(&context->current_time, sizeof(struct timespec));
+
+    emit inputsChanged();
+    emit frameCountChanged();
+
+    sendMessage(MSGN_EXPOSE);
+
+    return didLoad;
+}
+
+void GameLoop::captureZygoteState()
+{
+    if (zygote_captured)
+        return;
+
+    /* Saving is not allowed if currently encoding */
+    if (context->config.sc.av_dumping)
+        return;
+
+    /* The state must be the pristine boot state: only capture at the first
+     * frame boundary of this game instance */
+    if (context->framecount != context->config.sc.initial_framecount)
+        return;
+
+    int statei = ZYGOTE_INDEX;
+    sendMessage(MSGN_SAVESTATE_INDEX);
+    sendData(&statei, sizeof(int));
+
+    std::string savestatepath = context->config.savestatedir + '/';
+    savestatepath += context->gamename;
+    savestatepath += ".state" + std::to_string(statei);
+    if (! context->config.sc.savestates_in_ram) {
+        sendMessage(MSGN_SAVESTATE_PATH);
+        sendString(savestatepath);
+    }
+    else {
+        /* Create empty savestate files if stored in RAM */
+        std::string pagemappath = savestatepath + ".pm";
+        std::string pagespath = savestatepath + ".p";
+        std::ofstream opm(pagemappath);
+        opm.close();
+        std::ofstream op(pagespath);
+        op.close();
+    }
+
+    sendMessage(MSGN_SAVESTATE);
+
+    zygote_captured = true;
+}
+
+bool GameLoop::restartFromZygote()
+{
+    /* Loading is not allowed if currently encoding */
+    if (context->config.sc.av_dumping)
+        return false;
+
+    /* A real restart writes savefiles back on exit, so the in-place restart
+     * flushes them before loading the boot state: the rebooted game then
+     * reads them from disk like a relaunched process would */
+    bool wsf = context->config.sc.write_savefiles_on_exit;
+    context->config.sc.write_savefiles_on_exit =
+        (context->config.sc.recording != SharedConfig::NO_RECORDING);
+    sendMessage(MSGN_CONFIG);
+    sendData(&context->config.sc, sizeof(SharedConfig));
+    context->config.sc.write_savefiles_on_exit = wsf;
+
+    /* Send the savestate index */
+    int statei = ZYGOTE_INDEX;
+    sendMessage(MSGN_SAVESTATE_INDEX);
+    sendData(&statei, sizeof(int));
+
+    if (! context->config.sc.savestates_in_ram) {
+        std::string savestatepath = context->config.savestatedir + '/';
+        savestatepath += context->gamename;
+        savestatepath += ".state" + std::to_string(statei);
+        sendMessage(MSGN_SAVESTATE_PATH);
+        sendString(savestatepath);
+    }
+
+    sendMessage(MSGN_ZYGOTE_RESTART);
+
+    emit inputsToBeChanged();
+
+    int message = receiveMessage();
+    if (message != MSGB_LOADING_SUCCEEDED) {
+        /* Loading failed, the game kept running: pull the frame count and
+         * time like after a failed regular load, and let the caller fall
+         * back to a full relaunch */
+        if (message == MSGB_FRAMECOUNT_TIME) {
+            receiveData(&context->framecount, sizeof(unsigned long));
+            receiveData(&context->current_time, sizeof(struct timespec));
+        }
+        return false;
+    }
+
+    /* Resync like after a regular load, except the game must continue the
+     * movie instead of rewinding it: send the current frame count and time
+     * as the initial ones, mirroring what initProcessMessages sends to a
+     * relaunched process */
+    sendMessage(MSGN_ZYGOTE_RESTART);
+
+    struct timespec it = context->config.sc.initial_time;
+    unsigned long ifc = context->config.sc.initial_framecount;
+    context->config.sc.initial_time = context->current_time;
+    context->config.sc.initial_framecount = context->framecount;
+    sendMessage(MSGN_CONFIG);
+    sendData(&context->config.sc, sizeof(SharedConfig));
+
+    /* The exclusion pattern list stored in the game was rolled back
+     * by the memory loading too, flush it at the next boundary */
+    context->config.savestate_ignore_modified =
+        !context->config.savestate_ignore_paths.empty();
+
+    /* So was the input delta reference, send a keyframe */
+    input_keyframe_pending = true;
+    context->config.sc.initial_time = it;
+    context->config.sc.initial_framecount = ifc;
+
+    message = receiveMessage();
+    if (message != MSGB_FRAMECOUNT_TIME) {
+        std::cerr << "Got wrong message after zygote restart" << std::endl;
+        return false;
+    }
+    receiveData(&context->framecount, sizeof(unsigned long));
+    receiveData(&context->current_time, sizeof(struct timespec));
+
+    emit inputsChanged();
+    emit frameCountChanged();
+
+    sendMessage(MSGN_EXPOSE);
+
+    return true;
+}
+
+void GameLoop::publishUIUpdates(bool force)
+{
+    if (!(frame_ui_pending || ram_ui_pending || fps_ui_pending || fts_ui_pending || alloc_ui_pending))
+        return;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    int64_t now_ms = now.tv_sec * 1000LL + now.tv_nsec / 1000000LL;
+    if (!force && ((now_ms - last_ui_publish) < 33))
+        return;
+    last_ui_publish = now_ms;
+
+    if (frame_ui_pending) {
+        frame_ui_pending = false;
+        emit frameCountChanged();
+    }
+    if (ram_ui_pending) {
+        ram_ui_pending = false;
+        emit startFrameBoundary();
+    }
+    if (fps_ui_pending) {
+        fps_ui_pending = false;
+        emit fpsChanged(last_fps, last_lfps);
+    }
+    if (fts_ui_pending) {
+        fts_ui_pending = false;
+        emit frameTimeStatsChanged(last_fts);
+    }
+    if (alloc_ui_pending) {
+        alloc_ui_pending = false;
+        emit allocStatsChanged(last_alloc_stats);
+    }
+}
+
+bool GameLoop::botFrameBoundary()
+{
+    int statei = BruteForce::STATE_INDEX;
+
+    if ((context->framecount == bot.startFrame()) && !bot.state_saved) {
+        /* Save the window start state. RAM states were forced on, so only
+         * the empty placeholder files are needed */
+        sendMessage(MSGN_SAVESTATE_INDEX);
+        sendData(&statei, sizeof(int));
+
+        std::string savestatepath = context->config.savestatedir + '/';
+        savestatepath += context->gamename;
+        savestatepath += ".state" + std::to_string(statei);
+        std::ofstream opm(savestatepath + ".pm");
+        opm.close();
+        std::ofstream op(savestatepath + ".p");
+        op.close();
+
+        sendMessage(MSGN_SAVESTATE);
+
+        bot.state_saved = true;
+        return false;
+    }
+
+    if (context->framecount != bot.endFrame())
+        return false;
+
+    /* The candidate sequence has played out, score it */
+    if (!bot.nextCandidate())
+        return true;
+
+    /* Load the window start state back for the next candidate */
+    sendMessage(MSGN_SAVESTATE_INDEX);
+    sendData(&statei, sizeof(int));
+    sendMessage(MSGN_LOADSTATE);
+
+    int message = receiveMessage();
+    if (message == MSGB_LOADING_SUCCEEDED) {
+        /* The copy of SharedConfig that the game stores may not be the same
+         * as this one due to memory loading, so we send it */
+        sendMessage(MSGN_CONFIG);
+        sendData(&context->config.sc, sizeof(SharedConfig));
+
+        /* The exclusion pattern list stored in the game was rolled back
+         * by the memory loading too, flush it at the next boundary */
+        context->config.savestate_ignore_modified =
+            !context->config.savestate_ignore_paths.empty();
+
+        /* So was the input delta reference, send a keyframe */
+        input_keyframe_pending = true;
+
+        message = receiveMessage();
+    }
+
+    /* The frame count has changed, we must get the new one */
+    if (message != MSGB_FRAMECOUNT_TIME) {
+        std::cerr << "bot: got wrong message after state loading, aborting "
+            "the search" << std::endl;
+        return true;
+    }
+    receiveData(&context->framecount, sizeof(unsigned long));
+    if (context->config.sc.recording == SharedConfig::RECORDING_WRITE) {
+        context->config.sc.movie_framecount = context->framecount;
+    }
+    receiveData(&context->current_time, sizeof(struct timespec));
+
+    emit frameCountChanged();
+
+    return false;
+}
 
 void GameLoop::sleepSendPreview()
 {
-    /* Sleep a bit to not surcharge the processor */
-    struct timespec tim = {0, 17L*1000L*1000L};
-    nanosleep(&tim, NULL);
+    /* Wait until something happens instead of sleeping a fixed delay: a
+     * hotkey pushed by the UI signals the eventfd and an X key press makes
+     * the connection readable, so both are handled on the next loop
+     * iteration without waiting out a sleep. The timeout keeps the input
+     * preview below tracking the pointer at roughly frame rate. */
+    struct pollfd fds[2];
+    fds[0].fd = xcb_get_file_descriptor(context->conn);
+    fds[0].events = POLLIN;
+    fds[1].fd = hotkey_event_fd;
+    fds[1].events = POLLIN;
+    poll(fds, 2, 17);
+
+    if (fds[1].revents & POLLIN) {
+        /* Drain the eventfd counter, the items are popped by nextEvent() */
+        uint64_t val;
+        if (read(hotkey_event_fd, &val, sizeof(val)) < 0) {}
+    }
 
     /* Send a preview of inputs so that the game can display them
      * on the HUD */
@@ -1349,6 +2289,9 @@ void GameLoop::endFrameMessages(AllInputs &ai)
         context->config.sc_modified = true;
     }
 
+    /* Batch all the end-of-frame messages into a single socket write */
+    beginSendBatch();
+
     /* Send shared config if modified */
     if (context->config.sc_modified) {
         /* Send config */
@@ -1365,15 +2308,84 @@ void GameLoop::endFrameMessages(AllInputs &ai)
         context->config.dumpfile_modified = false;
     }
 
-    /* Send inputs and end of frame */
-    sendMessage(MSGN_ALL_INPUTS);
-    sendData(&ai, sizeof(AllInputs));
+    /* Send the savestate exclusion patterns if modified, or if a state
+     * loading rolled back the list stored in the game */
+    if (context->config.savestate_ignore_modified) {
+        sendMessage(MSGN_SAVESTATE_IGNORE);
+        sendString(context->config.savestate_ignore_paths);
+        context->config.savestate_ignore_modified = false;
+    }
+
+    /* Send inputs and end of frame. Consecutive frames usually differ by
+     * a button or two, so most frames only carry a delta against the
+     * previous input message */
+    if (input_keyframe_pending || (frames_since_keyframe >= INPUT_KEYFRAME_INTERVAL)) {
+        sendMessage(MSGN_ALL_INPUTS);
+        sendData(&ai, sizeof(AllInputs));
+        input_keyframe_pending = false;
+        frames_since_keyframe = 0;
+    }
+    else {
+        sendMessage(MSGN_ALL_INPUTS_DELTA);
+        ai.sendDelta(delta_ref_ai);
+        frames_since_keyframe++;
+    }
+    delta_ref_ai = ai;
+
+    /* Stream the inputs of the upcoming replay frames in one batch, so
+     * the game runs the covered frames without waiting for an answer at
+     * each boundary (free-run). Only granted when nothing may interrupt
+     * the replay, and stopped short of every frame where this loop must
+     * act: the movie-end transition, a pending pause target and the start
+     * of a ranged dump. OSD ram watches need a message at each boundary,
+     * so they disable the batch. */
+    if ((context->config.sc.recording == SharedConfig::RECORDING_READ) &&
+        context->config.sc.running && (context->status == Context::ACTIVE) &&
+        !bot.isActive() && !context->seek_frame && !context->greenzone_invalid &&
+        !(context->config.sc.osd & SharedConfig::OSD_RAMWATCHES)) {
+
+        uint64_t batch_start = context->framecount + 1;
+        uint64_t batch_end = movie.nbFrames() ? (movie.nbFrames() - 1) : 0;
+        if (context->pause_frame && ((context->pause_frame - 1) < batch_end))
+            batch_end = context->pause_frame - 1;
+        if (context->config.dumping && context->config.dump_range_start &&
+            !context->config.sc.av_dumping &&
+            (context->config.dump_range_start < batch_end))
+            batch_end = context->config.dump_range_start;
+        if (batch_end > (batch_start + INPUT_BATCH_FRAMES))
+            batch_end = batch_start + INPUT_BATCH_FRAMES;
+
+        /* A restart input is executed by this loop, not by the game, so
+         * the batch also stops short of it */
+        for (uint64_t f = batch_start; f < batch_end; f++) {
+            if (movie.input_list[f].restart) {
+                batch_end = f;
+                break;
+            }
+        }
+
+        if (batch_end > batch_start) {
+            uint64_t batch_count = batch_end - batch_start;
+            sendMessage(MSGN_INPUT_BATCH);
+            sendData(&batch_start, sizeof(uint64_t));
+            sendData(&batch_count, sizeof(uint64_t));
+            sendData(movie.input_list.data() + batch_start, batch_count * sizeof(AllInputs));
+            library_lockstep = false;
+            batch_invalidated = false;
+        }
+    }
 
     if ((context->status == Context::QUITTING) || (context->status == Context::RESTARTING)) {
         sendMessage(MSGN_USERQUIT);
     }
 
     sendMessage(MSGN_END_FRAMEBOUNDARY);
+
+    endSendBatch();
+
+    /* The inputs of the sampled frame advance are on the socket now */
+    if (lat_pending)
+        lat_send = monotonicNs();
 }
 
 
@@ -1396,6 +2408,20 @@ bool GameLoop::haveFocus()
 
 void GameLoop::loopExit()
 {
+    /* Show the final values of the throttled UI updates */
+    publishUIUpdates(true);
+
+    /* Close the shared buffers of this game instance. A restarted game
+     * sends fresh ones during its init handshake. */
+    if (context->preview_fd >= 0) {
+        close(context->preview_fd);
+        context->preview_fd = -1;
+    }
+    if (context->slotinfo_fd >= 0) {
+        close(context->slotinfo_fd);
+        context->slotinfo_fd = -1;
+    }
+
     /* We need to restart the game if we got a restart input, or if:
      * - auto-restart is set
      * - we are playing or recording a movie
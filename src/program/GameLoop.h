@@ -25,6 +25,11 @@
 
 #include "Context.h"
 #include "MovieFile.h"
+#include "InputLatencyStats.h"
+#include "../shared/FrameTimeStats.h"
+#include "../shared/AllocStats.h"
+#include "Greenzone.h"
+#include "BruteForce.h"
 #include <xcb/xcb_keysyms.h>
 
 class GameLoop : public QObject {
@@ -34,9 +39,17 @@ public:
     void start();
     MovieFile movie;
 
+    /* Lattice of automatic savestates used for seeking in the input editor.
+     * Public so that the input editor can query the nearest state to the
+     * selected frame and prefetch it. */
+    Greenzone greenzone;
+
 private:
     Context* context;
 
+    /* Input brute-forcing engine, active when started with --bot */
+    BruteForce bot;
+
     /*
      * Frame advance auto-repeat variables.
      * If ar_ticks is >= 0 (auto-repeat activated), it increases by one every
@@ -53,13 +66,93 @@ private:
     /* Last saved/loaded savestate */
     int current_savestate;
 
+    /* Savestate index of the pristine boot state used by in-place (zygote)
+     * restarts, outside the numbered slots, the rewind ring and the
+     * greenzone lattice range */
+    static const int ZYGOTE_INDEX = 98;
+
+    /* Whether the pristine boot state was captured for this game instance */
+    bool zygote_captured;
+
+    /* Fast-forward mode of the user before a seek forced every skipping
+     * flag, or -1 when no seek is in progress */
+    int ff_mode_before_seek;
+
+    /* Number of replay frames streamed to the game in one batch, which it
+     * consumes without answering the frame boundaries (free-run). A pause
+     * or an edit only takes effect once the batch is invalidated, so the
+     * batch is kept small enough for that to stay well under a second
+     * even at normal speed */
+    static const unsigned int INPUT_BATCH_FRAMES = 256;
+
+    /* Whether the game answers the frame boundaries in lockstep, or
+     * free-runs on a streamed input batch */
+    bool library_lockstep;
+
+    /* Whether the invalidation of the live input batch was already sent */
+    bool batch_invalidated;
+
+    /* Event consumed while the game was free-running, kept to be
+     * processed at the next lockstep boundary */
+    uint8_t deferred_event_type;
+    HotKey deferred_hk;
+
     /* Inputs from the previous frame */
     AllInputs prev_ai;
 
+    /* Reference of the delta-encoded input messages: the inputs of the
+     * last MSGN_ALL_INPUTS(_DELTA) sent. A full keyframe is sent
+     * periodically, at game start, and after every state load, which
+     * rolls back the reference held by the game. */
+    AllInputs delta_ref_ai;
+    bool input_keyframe_pending;
+    unsigned int frames_since_keyframe;
+    static const unsigned int INPUT_KEYFRAME_INTERVAL = 256;
+
     /* Calibration offsets */
     int pointer_offset_x;
     int pointer_offset_y;
 
+    /* eventfd signaled when the UI pushes a hotkey, so the paused loop can
+     * wait on it together with the X connection instead of sleeping */
+    int hotkey_event_fd;
+
+    /* First frame whose state digest differed from the one recorded in the
+     * movie, or 0 if no divergence was seen. Only the first divergence is
+     * reported, every frame after it differs as well. */
+    unsigned long digest_divergence_frame;
+
+    /* Coalescing of the per-frame UI updates. Emitting a queued signal per
+     * frame floods the UI event loop during fast-forward, so the updates
+     * below are only published at ~30 Hz. The latest values win: the frame
+     * count and time live in the context, the fps and frame time stats in
+     * the members below, and the pending flags only record that something
+     * changed since the last publish. */
+    /* End-to-end latency sampling of frame advances. The arrival time of
+     * the X event currently dispatched, the stage timestamps of the
+     * pending sample, and the accumulated stats. One sample is in flight
+     * at most, completed when the advanced frame boundary ends. */
+    uint64_t lat_event_arrival = 0;
+    uint64_t lat_dispatch = 0;
+    uint64_t lat_send = 0;
+    uint64_t lat_apply = 0;
+    bool lat_pending = false;
+    InputLatencyStats lat_stats = {};
+
+    /* Current CLOCK_MONOTONIC time in nanoseconds, the clock the game
+     * stamps its input application with */
+    static uint64_t monotonicNs();
+
+    int64_t last_ui_publish;
+    bool frame_ui_pending;
+    bool ram_ui_pending;
+    bool fps_ui_pending;
+    bool fts_ui_pending;
+    bool alloc_ui_pending;
+    float last_fps, last_lfps;
+    FrameTimeStats last_fts;
+    AllocStats last_alloc_stats;
+
     void init();
 
     void initProcessMessages();
@@ -83,6 +176,55 @@ private:
 
     void processInputs(AllInputs &ai);
 
+    /* Handle a frame boundary while the game free-runs on a streamed
+     * input batch. The game is not listening to the socket, so nothing is
+     * sent except the batch invalidation when something must interrupt
+     * the replay */
+    void freerunBoundary();
+
+    /* Prune the greenzone states past an edited frame, if any edit happened */
+    void pruneGreenzone();
+
+    /* Capture a greenzone state at the current frame boundary if the lattice
+     * wants one */
+    void captureGreenzoneState();
+
+    /* Handle a pending seek request from the input editor, by loading the
+     * nearest greenzone state and fast-forwarding the remaining frames */
+    void seekToFrame();
+
+    /* Force every fast-forward skipping flag while seeking to a frame, so
+     * the game catches up as fast as possible without rendering, HUD or
+     * audio mixing. The user mode is restored when the target is reached */
+    void enterTurboSeek();
+    void exitTurboSeek();
+
+    /* Tell the game to load a greenzone state. Returns true if the game
+     * loaded it */
+    bool loadGreenzoneState(int slot);
+
+    /* Capture the pristine boot state used by in-place (zygote) restarts.
+     * Only captures at the first frame boundary of a game instance */
+    void captureZygoteState();
+
+    /* Restart the game in place by loading the pristine boot state, instead
+     * of relaunching the process. The movie continues like after a real
+     * restart. Returns false if no restart was done and the caller should
+     * fall back to a relaunch */
+    bool restartFromZygote();
+
+    /* Drive the brute-forcing bot at the frame boundary: save a state when
+     * the search window starts, and at the window end score the candidate,
+     * load the state back and move to the next one. Returns true when the
+     * search is over and the program should quit */
+    bool botFrameBoundary();
+
+    /* Emit the pending coalesced UI updates, unless the last publish was
+     * less than a UI refresh period ago. A forced publish ignores the
+     * throttle, for when the game pauses and no later frame would flush
+     * the held-back values */
+    void publishUIUpdates(bool force);
+
     void endFrameMessages(AllInputs &ai);
 
     /* Determine if we are allowed to send inputs to the game, based on which
@@ -106,6 +248,9 @@ signals:
     void controllerButtonToggled(int controller_id, int button, bool pressed);
     void inputsToBeSent(AllInputs &allinputs);
     void gameInfoChanged(GameInfo game_info);
+    void frameTimeStatsChanged(FrameTimeStats stats);
+    void allocStatsChanged(AllocStats stats);
+    void inputLatencyChanged(InputLatencyStats stats);
 
     /* Signals for notifying the input editor */
     void isInputEditorVisible(bool &isVisible);
@@ -118,6 +263,9 @@ signals:
 
     void getRamWatch(std::string &watch);
 
+    /* Write the frozen ram watches back at a frame boundary */
+    void pokeFrozenWatches();
+
     /* register a savestate */
     void savestatePerformed(int slot, unsigned long frame);
 };
@@ -0,0 +1,145 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Greenzone.h"
+
+Greenzone::Greenzone(Context* c) : context(c)
+{
+    clear();
+}
+
+void Greenzone::clear()
+{
+    for (int i = 0; i < NB_SLOTS; i++) {
+        states[i].framecount = 0;
+        states[i].valid = false;
+    }
+    cursor = 0;
+}
+
+bool Greenzone::shouldCapture(unsigned long frame)
+{
+    if (frame % CAPTURE_INTERVAL)
+        return false;
+
+    /* Don't capture twice at the same frame, which can happen after a state
+     * of the lattice was loaded */
+    for (int i = 0; i < NB_SLOTS; i++) {
+        if (states[i].valid && (states[i].framecount == frame))
+            return false;
+    }
+
+    return true;
+}
+
+int Greenzone::pickSlot(unsigned long frame)
+{
+    for (int i = 0; i < NB_SLOTS; i++) {
+        if (!states[i].valid)
+            return i;
+    }
+
+    /* Every slot is taken, we must evict a state. We keep the oldest state
+     * so that early frames always stay reachable, and among the others we
+     * evict the state whose removal leaves the smallest hole, preferring
+     * states away from the cursor. This keeps the lattice dense where the
+     * user works and thins it out behind */
+
+    /* Find the oldest state */
+    int oldest = 0;
+    for (int i = 1; i < NB_SLOTS; i++) {
+        if (states[i].framecount < states[oldest].framecount)
+            oldest = i;
+    }
+
+    int best = -1;
+    unsigned long best_gap = 0;
+    bool best_far = false;
+    for (int i = 0; i < NB_SLOTS; i++) {
+        if (i == oldest)
+            continue;
+
+        /* Compute the gap between the neighbours of this state, which is the
+         * hole that evicting it would leave */
+        unsigned long prev = 0;
+        unsigned long next = frame;
+        for (int j = 0; j < NB_SLOTS; j++) {
+            if (j == i)
+                continue;
+            if ((states[j].framecount <= states[i].framecount) && (states[j].framecount > prev))
+                prev = states[j].framecount;
+            if ((states[j].framecount > states[i].framecount) && (states[j].framecount < next))
+                next = states[j].framecount;
+        }
+        unsigned long gap = next - prev;
+
+        /* A state is evictable first when it is both away from the cursor
+         * and away from the frame being captured, so the lattice also stays
+         * dense near the current playback position */
+        bool far = ((states[i].framecount + DENSE_WINDOW < cursor) ||
+                    (states[i].framecount > cursor + DENSE_WINDOW)) &&
+                   (states[i].framecount + DENSE_WINDOW < frame);
+
+        if ((best < 0) || (far && !best_far) || ((far == best_far) && (gap < best_gap))) {
+            best = i;
+            best_gap = gap;
+            best_far = far;
+        }
+    }
+
+    return best;
+}
+
+void Greenzone::stateCaptured(int slot, unsigned long frame)
+{
+    states[slot].framecount = frame;
+    states[slot].valid = true;
+}
+
+int Greenzone::nearestState(unsigned long frame)
+{
+    int best = -1;
+    for (int i = 0; i < NB_SLOTS; i++) {
+        if (!states[i].valid)
+            continue;
+        if (states[i].framecount > frame)
+            continue;
+        if ((best < 0) || (states[i].framecount > states[best].framecount))
+            best = i;
+    }
+    return best;
+}
+
+unsigned long Greenzone::stateFrame(int slot)
+{
+    return states[slot].framecount;
+}
+
+void Greenzone::invalidateAfter(unsigned long frame)
+{
+    for (int i = 0; i < NB_SLOTS; i++) {
+        if (states[i].valid && (states[i].framecount > frame))
+            states[i].valid = false;
+    }
+}
+
+void Greenzone::setCursor(unsigned long frame)
+{
+    cursor = frame;
+}
@@ -0,0 +1,97 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_GREENZONE_H_INCLUDED
+#define LIBTAS_GREENZONE_H_INCLUDED
+
+#include "Context.h"
+
+/* Bookkeeping of the greenzone: a lattice of savestates that the game loop
+ * captures automatically at frame boundaries, so that the input editor can
+ * seek to a frame by loading the nearest state and fast-forwarding the rest,
+ * instead of replaying the movie from the beginning.
+ *
+ * This class only tracks which frame each slot holds. The actual states are
+ * saved and loaded by the game loop using the regular savestate messages,
+ * with slot indices placed after the numbered slots and the rewind ring of
+ * the library.
+ */
+class Greenzone {
+public:
+    Greenzone(Context* c);
+
+    /* Number of lattice slots. Must match GREENZONE_SLOTS in the library
+     * ReservedMemory.h */
+    static const int NB_SLOTS = 32;
+
+    /* First savestate index of the lattice, placed after the regular slots
+     * and the rewind ring (SAVESTATE_SLOTS + REWIND_SLOTS in the library
+     * ReservedMemory.h) */
+    static const int FIRST_INDEX = 43;
+
+    /* Forget every state, when a game is launched */
+    void clear();
+
+    /* Check if a state should be captured at the boundary of this frame */
+    bool shouldCapture(unsigned long frame);
+
+    /* Choose the slot to capture into, evicting a state if every slot is
+     * taken. Returns -1 if no slot could be freed */
+    int pickSlot(unsigned long frame);
+
+    /* Record that a state was captured into a slot */
+    void stateCaptured(int slot, unsigned long frame);
+
+    /* Return the slot holding the most recent state at or before the given
+     * frame, or -1 if there is none */
+    int nearestState(unsigned long frame);
+
+    /* Return the frame of the state held by a slot */
+    unsigned long stateFrame(int slot);
+
+    /* Forget every state past an edited frame. The state captured at the
+     * boundary of that very frame stays valid, because it was taken before
+     * the inputs of the frame were played */
+    void invalidateAfter(unsigned long frame);
+
+    /* Set the frame the user is working on. The lattice stays dense around
+     * it and is thinned out further away */
+    void setCursor(unsigned long frame);
+
+private:
+    Context* context;
+
+    /* Interval between two captured states */
+    static const unsigned long CAPTURE_INTERVAL = 25;
+
+    /* Distance from the cursor within which states are never evicted first */
+    static const unsigned long DENSE_WINDOW = 500;
+
+    struct State {
+        unsigned long framecount;
+        bool valid;
+    };
+
+    State states[NB_SLOTS];
+
+    /* Frame the user is working on */
+    unsigned long cursor;
+};
+
+#endif
@@ -0,0 +1,54 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_INPUTLATENCYSTATS_H_INCLUDED
+#define LIBTAS_INPUTLATENCYSTATS_H_INCLUDED
+
+#include <cstdint>
+
+/* End-to-end latency of frame advances, accumulated by the game loop. One
+ * sample runs from the arrival of the X key event in the program to the
+ * completion of the advanced frame boundary, cut at each pipeline stage.
+ * Only advances coming from a real key press are sampled, so auto-repeat
+ * and hotkeys queued by the UI don't pollute the numbers. All timestamps
+ * are CLOCK_MONOTONIC, which the game also stamps its input application
+ * with, so the stages are comparable across the two processes. */
+struct InputLatencyStats {
+    enum Stage {
+        STAGE_DISPATCH, /* X event arrival -> hotkey dispatch */
+        STAGE_SEND,     /* dispatch -> inputs written to the socket */
+        STAGE_APPLY,    /* socket write -> input application in the game */
+        STAGE_PRESENT,  /* input application -> end of the frame boundary */
+        STAGE_COUNT
+    };
+
+    /* Sum and maximum of each stage over the sampled advances, in
+     * nanoseconds */
+    uint64_t stage_sum_ns[STAGE_COUNT];
+    uint64_t stage_max_ns[STAGE_COUNT];
+
+    /* Histogram of the total latency. Bucket 0 counts the samples below
+     * one millisecond, bucket i the ones in [2^(i-1), 2^i) ms */
+    static const int NB_BUCKETS = 10;
+    uint32_t buckets[NB_BUCKETS];
+
+    uint32_t samples;
+};
+
+#endif
@@ -19,6 +19,7 @@
 
 #include "KeyMapping.h"
 #include <X11/Xlib.h>
+#include <cstdio> // snprintf
 #include <cstring>
 #include <iostream>
 
@@ -51,20 +52,38 @@ bool is_modifier(xcb_keysym_t ks)
     return false;
 }
 
+/* Modifier flag of each keycode, or 0 for non-modifier keys. Built once
+ * from the keyboard layout, so building the modifier set of a keymap only
+ * reads the pressed bits instead of resolving every pressed keycode to a
+ * keysym. The layout is read once at startup in the whole program, so the
+ * table never needs a rebuild. */
+static xcb_keysym_t keycode_modifier_flags[256];
+static bool keycode_modifier_flags_built = false;
+
 xcb_keysym_t build_modifiers(unsigned char keyboard_state[], xcb_key_symbols_t *keysyms)
 {
-    xcb_keysym_t modifiers = 0;
-
-    for (int i=0; i<256; i++) {
-        if (keyboard_state[i/8] & (1 << (i % 8))) {
-            xcb_keysym_t ks = xcb_key_symbols_get_keysym(keysyms, i, 0);
+    if (!keycode_modifier_flags_built) {
+        for (int k=0; k<256; k++) {
+            xcb_keysym_t ks = xcb_key_symbols_get_keysym(keysyms, k, 0);
+            keycode_modifier_flags[k] = 0;
             for (ModifierKey modifier : modifier_list) {
                 if (modifier.ks == ks) {
-                    modifiers |= modifier.flag;
+                    keycode_modifier_flags[k] = modifier.flag;
                     break;
                 }
             }
         }
+        keycode_modifier_flags_built = true;
+    }
+
+    xcb_keysym_t modifiers = 0;
+    for (int i=0; i<32; i++) {
+        if (keyboard_state[i] == 0)
+            continue;
+        for (int j=0; j<8; j++) {
+            if ((keyboard_state[i] >> j) & 0x1)
+                modifiers |= keycode_modifier_flags[(i << 3) | j];
+        }
     }
     return modifiers;
 }
@@ -96,6 +115,7 @@ void KeyMapping::init(xcb_connection_t* conn)
     hotkey_list.push_back({{SingleInput::IT_KEYBOARD, XK_F8}, HOTKEY_LOADSTATE8, "Load State 8"});
     hotkey_list.push_back({{SingleInput::IT_KEYBOARD, XK_F9}, HOTKEY_LOADSTATE9, "Load State 9"});
     hotkey_list.push_back({{SingleInput::IT_KEYBOARD, XK_F10}, HOTKEY_LOADSTATE_BACKTRACK, "Load Backtrack State"});
+    hotkey_list.push_back({{SingleInput::IT_NONE, 0}, HOTKEY_REWIND, "Rewind One Frame"});
     hotkey_list.push_back({{SingleInput::IT_NONE, 0}, HOTKEY_TOGGLE_ENCODE, "Toggle encode"});
     hotkey_list.push_back({{SingleInput::IT_NONE, 0}, HOTKEY_CALIBRATE_MOUSE, "Calibrate Mouse"});
 
@@ -124,6 +144,7 @@ void KeyMapping::init(xcb_connection_t* conn)
         si.type = SingleInput::IT_KEYBOARD;
         si.value = static_cast<int>(ks);
         si.description = XKeysymToString(ks); // AFAIK there is no xcb counterpart to this...
+        input_index[ks] = input_list.size();
         input_list.push_back(si);
     }
 
@@ -141,98 +162,29 @@ void KeyMapping::init(xcb_connection_t* conn)
     /* Add restart mapping */
     input_list.push_back({SingleInput::IT_RESTART, 1, "Restart"});
 
-    /* Add controller mapping */
-    input_list.push_back({SingleInput::IT_CONTROLLER1_BUTTON_A, 1, "Joy1 A"});
-    input_list.push_back({SingleInput::IT_CONTROLLER1_BUTTON_B, 1, "Joy1 B"});
-    input_list.push_back({SingleInput::IT_CONTROLLER1_BUTTON_X, 1, "Joy1 X"});
-    input_list.push_back({SingleInput::IT_CONTROLLER1_BUTTON_Y, 1, "Joy1 Y"});
-    input_list.push_back({SingleInput::IT_CONTROLLER1_BUTTON_BACK, 1, "Joy1 Back"});
-    input_list.push_back({SingleInput::IT_CONTROLLER1_BUTTON_GUIDE, 1, "Joy1 Guide"});
-    input_list.push_back({SingleInput::IT_CONTROLLER1_BUTTON_START, 1, "Joy1 Start"});
-    input_list.push_back({SingleInput::IT_CONTROLLER1_BUTTON_LEFTSTICK, 1, "Joy1 LeftStick"});
-    input_list.push_back({SingleInput::IT_CONTROLLER1_BUTTON_RIGHTSTICK, 1, "Joy1 RightStick"});
-    input_list.push_back({SingleInput::IT_CONTROLLER1_BUTTON_LEFTSHOULDER, 1, "Joy1 LeftShoulder"});
-    input_list.push_back({SingleInput::IT_CONTROLLER1_BUTTON_RIGHTSHOULDER, 1, "Joy1 RightShoulder"});
-    input_list.push_back({SingleInput::IT_CONTROLLER1_BUTTON_DPAD_UP, 1, "Joy1 Up"});
-    input_list.push_back({SingleInput::IT_CONTROLLER1_BUTTON_DPAD_DOWN, 1, "Joy1 Down"});
-    input_list.push_back({SingleInput::IT_CONTROLLER1_BUTTON_DPAD_LEFT, 1, "Joy1 Left"});
-    input_list.push_back({SingleInput::IT_CONTROLLER1_BUTTON_DPAD_RIGHT, 1, "Joy1 Right"});
-
-    input_list.push_back({SingleInput::IT_CONTROLLER1_AXIS_LEFTX, 1, "Joy1 LeftStickX"});
-    input_list.push_back({SingleInput::IT_CONTROLLER1_AXIS_LEFTY, 1, "Joy1 LeftStickY"});
-    input_list.push_back({SingleInput::IT_CONTROLLER1_AXIS_RIGHTX, 1, "Joy1 RightStickX"});
-    input_list.push_back({SingleInput::IT_CONTROLLER1_AXIS_RIGHTY, 1, "Joy1 RightStickY"});
-    input_list.push_back({SingleInput::IT_CONTROLLER1_AXIS_TRIGGERLEFT, 1, "Joy1 LeftTrigger"});
-    input_list.push_back({SingleInput::IT_CONTROLLER1_AXIS_TRIGGERRIGHT, 1, "Joy1 RightTrigger"});
-
-    input_list.push_back({SingleInput::IT_CONTROLLER2_BUTTON_A, 1, "Joy2 A"});
-    input_list.push_back({SingleInput::IT_CONTROLLER2_BUTTON_B, 1, "Joy2 B"});
-    input_list.push_back({SingleInput::IT_CONTROLLER2_BUTTON_X, 1, "Joy2 X"});
-    input_list.push_back({SingleInput::IT_CONTROLLER2_BUTTON_Y, 1, "Joy2 Y"});
-    input_list.push_back({SingleInput::IT_CONTROLLER2_BUTTON_BACK, 1, "Joy2 Back"});
-    input_list.push_back({SingleInput::IT_CONTROLLER2_BUTTON_GUIDE, 1, "Joy2 Guide"});
-    input_list.push_back({SingleInput::IT_CONTROLLER2_BUTTON_START, 1, "Joy2 Start"});
-    input_list.push_back({SingleInput::IT_CONTROLLER2_BUTTON_LEFTSTICK, 1, "Joy2 LeftStick"});
-    input_list.push_back({SingleInput::IT_CONTROLLER2_BUTTON_RIGHTSTICK, 1, "Joy2 RightStick"});
-    input_list.push_back({SingleInput::IT_CONTROLLER2_BUTTON_LEFTSHOULDER, 1, "Joy2 LeftShoulder"});
-    input_list.push_back({SingleInput::IT_CONTROLLER2_BUTTON_RIGHTSHOULDER, 1, "Joy2 RightShoulder"});
-    input_list.push_back({SingleInput::IT_CONTROLLER2_BUTTON_DPAD_UP, 1, "Joy2 Up"});
-    input_list.push_back({SingleInput::IT_CONTROLLER2_BUTTON_DPAD_DOWN, 1, "Joy2 Down"});
-    input_list.push_back({SingleInput::IT_CONTROLLER2_BUTTON_DPAD_LEFT, 1, "Joy2 Left"});
-    input_list.push_back({SingleInput::IT_CONTROLLER2_BUTTON_DPAD_RIGHT, 1, "Joy2 Right"});
-
-    input_list.push_back({SingleInput::IT_CONTROLLER2_AXIS_LEFTX, 1, "Joy2 LeftStickX"});
-    input_list.push_back({SingleInput::IT_CONTROLLER2_AXIS_LEFTY, 1, "Joy2 LeftStickY"});
-    input_list.push_back({SingleInput::IT_CONTROLLER2_AXIS_RIGHTX, 1, "Joy2 RightStickX"});
-    input_list.push_back({SingleInput::IT_CONTROLLER2_AXIS_RIGHTY, 1, "Joy2 RightStickY"});
-    input_list.push_back({SingleInput::IT_CONTROLLER2_AXIS_TRIGGERLEFT, 1, "Joy2 LeftTrigger"});
-    input_list.push_back({SingleInput::IT_CONTROLLER2_AXIS_TRIGGERRIGHT, 1, "Joy2 RightTrigger"});
-
-    input_list.push_back({SingleInput::IT_CONTROLLER3_BUTTON_A, 1, "Joy3 A"});
-    input_list.push_back({SingleInput::IT_CONTROLLER3_BUTTON_B, 1, "Joy3 B"});
-    input_list.push_back({SingleInput::IT_CONTROLLER3_BUTTON_X, 1, "Joy3 X"});
-    input_list.push_back({SingleInput::IT_CONTROLLER3_BUTTON_Y, 1, "Joy3 Y"});
-    input_list.push_back({SingleInput::IT_CONTROLLER3_BUTTON_BACK, 1, "Joy3 Back"});
-    input_list.push_back({SingleInput::IT_CONTROLLER3_BUTTON_GUIDE, 1, "Joy3 Guide"});
-    input_list.push_back({SingleInput::IT_CONTROLLER3_BUTTON_START, 1, "Joy3 Start"});
-    input_list.push_back({SingleInput::IT_CONTROLLER3_BUTTON_LEFTSTICK, 1, "Joy3 LeftStick"});
-    input_list.push_back({SingleInput::IT_CONTROLLER3_BUTTON_RIGHTSTICK, 1, "Joy3 RightStick"});
-    input_list.push_back({SingleInput::IT_CONTROLLER3_BUTTON_LEFTSHOULDER, 1, "Joy3 LeftShoulder"});
-    input_list.push_back({SingleInput::IT_CONTROLLER3_BUTTON_RIGHTSHOULDER, 1, "Joy3 RightShoulder"});
-    input_list.push_back({SingleInput::IT_CONTROLLER3_BUTTON_DPAD_UP, 1, "Joy3 Up"});
-    input_list.push_back({SingleInput::IT_CONTROLLER3_BUTTON_DPAD_DOWN, 1, "Joy3 Down"});
-    input_list.push_back({SingleInput::IT_CONTROLLER3_BUTTON_DPAD_LEFT, 1, "Joy3 Left"});
-    input_list.push_back({SingleInput::IT_CONTROLLER3_BUTTON_DPAD_RIGHT, 1, "Joy3 Right"});
-
-    input_list.push_back({SingleInput::IT_CONTROLLER3_AXIS_LEFTX, 1, "Joy3 LeftStickX"});
-    input_list.push_back({SingleInput::IT_CONTROLLER3_AXIS_LEFTY, 1, "Joy3 LeftStickY"});
-    input_list.push_back({SingleInput::IT_CONTROLLER3_AXIS_RIGHTX, 1, "Joy3 RightStickX"});
-    input_list.push_back({SingleInput::IT_CONTROLLER3_AXIS_RIGHTY, 1, "Joy3 RightStickY"});
-    input_list.push_back({SingleInput::IT_CONTROLLER3_AXIS_TRIGGERLEFT, 1, "Joy3 LeftTrigger"});
-    input_list.push_back({SingleInput::IT_CONTROLLER3_AXIS_TRIGGERRIGHT, 1, "Joy3 RightTrigger"});
-
-    input_list.push_back({SingleInput::IT_CONTROLLER4_BUTTON_A, 1, "Joy4 A"});
-    input_list.push_back({SingleInput::IT_CONTROLLER4_BUTTON_B, 1, "Joy4 B"});
-    input_list.push_back({SingleInput::IT_CONTROLLER4_BUTTON_X, 1, "Joy4 X"});
-    input_list.push_back({SingleInput::IT_CONTROLLER4_BUTTON_Y, 1, "Joy4 Y"});
-    input_list.push_back({SingleInput::IT_CONTROLLER4_BUTTON_BACK, 1, "Joy4 Back"});
-    input_list.push_back({SingleInput::IT_CONTROLLER4_BUTTON_GUIDE, 1, "Joy4 Guide"});
-    input_list.push_back({SingleInput::IT_CONTROLLER4_BUTTON_START, 1, "Joy4 Start"});
-    input_list.push_back({SingleInput::IT_CONTROLLER4_BUTTON_LEFTSTICK, 1, "Joy4 LeftStick"});
-    input_list.push_back({SingleInput::IT_CONTROLLER4_BUTTON_RIGHTSTICK, 1, "Joy4 RightStick"});
-    input_list.push_back({SingleInput::IT_CONTROLLER4_BUTTON_LEFTSHOULDER, 1, "Joy4 LeftShoulder"});
-    input_list.push_back({SingleInput::IT_CONTROLLER4_BUTTON_RIGHTSHOULDER, 1, "Joy4 RightShoulder"});
-    input_list.push_back({SingleInput::IT_CONTROLLER4_BUTTON_DPAD_UP, 1, "Joy4 Up"});
-    input_list.push_back({SingleInput::IT_CONTROLLER4_BUTTON_DPAD_DOWN, 1, "Joy4 Down"});
-    input_list.push_back({SingleInput::IT_CONTROLLER4_BUTTON_DPAD_LEFT, 1, "Joy4 Left"});
-    input_list.push_back({SingleInput::IT_CONTROLLER4_BUTTON_DPAD_RIGHT, 1, "Joy4 Right"});
-
-    input_list.push_back({SingleInput::IT_CONTROLLER4_AXIS_LEFTX, 1, "Joy4 LeftStickX"});
-    input_list.push_back({SingleInput::IT_CONTROLLER4_AXIS_LEFTY, 1, "Joy4 LeftStickY"});
-    input_list.push_back({SingleInput::IT_CONTROLLER4_AXIS_RIGHTX, 1, "Joy4 RightStickX"});
-    input_list.push_back({SingleInput::IT_CONTROLLER4_AXIS_RIGHTY, 1, "Joy4 RightStickY"});
-    input_list.push_back({SingleInput::IT_CONTROLLER4_AXIS_TRIGGERLEFT, 1, "Joy4 LeftTrigger"});
-    input_list.push_back({SingleInput::IT_CONTROLLER4_AXIS_TRIGGERRIGHT, 1, "Joy4 RightTrigger"});
+    /* Add controller mapping. The labels are composed from tables indexed
+     * by the button and axis numbers, and the input type is rebuilt from
+     * the same numbers, so the four controller blocks stay in sync with
+     * the enums by construction. */
+    static const char* const button_labels[] = {
+        "A", "B", "X", "Y", "Back", "Guide", "Start",
+        "LeftStick", "RightStick", "LeftShoulder", "RightShoulder",
+        "Up", "Down", "Left", "Right"};
+    static const char* const axis_labels[] = {
+        "LeftStickX", "LeftStickY", "RightStickX", "RightStickY",
+        "LeftTrigger", "RightTrigger"};
+
+    char label[32];
+    for (int joy = 1; joy <= 4; joy++) {
+        for (size_t b = 0; b < sizeof(button_labels)/sizeof(button_labels[0]); b++) {
+            snprintf(label, sizeof(label), "Joy%d %s", joy, button_labels[b]);
+            input_list.push_back({(joy << SingleInput::IT_CONTROLLER_ID_SHIFT) + static_cast<int>(b), 1, label});
+        }
+        for (size_t a = 0; a < sizeof(axis_labels)/sizeof(axis_labels[0]); a++) {
+            snprintf(label, sizeof(label), "Joy%d %s", joy, axis_labels[a]);
+            input_list.push_back({((joy << SingleInput::IT_CONTROLLER_ID_SHIFT) | SingleInput::IT_CONTROLLER_AXIS_MASK) + static_cast<int>(a), 1, label});
+        }
+    }
 
     /* Set default inputs */
     default_inputs();
@@ -240,13 +192,9 @@ void KeyMapping::init(xcb_connection_t* conn)
 
 std::string KeyMapping::input_description(KeySym ks)
 {
-    for (auto iter : input_list) {
-        if (iter.type == SingleInput::IT_KEYBOARD) {
-            if (iter.value == ks) {
-                return iter.description;
-            }
-        }
-    }
+    auto iter = input_index.find(ks);
+    if (iter != input_index.end())
+        return input_list[iter->second].description;
 
     return "";
 }
@@ -393,8 +341,9 @@ void KeyMapping::buildAllInputs(AllInputs& ai, xcb_connection_t *conn, xcb_windo
 
                 /* Checking the mapped input for that key */
                 SingleInput si = {SingleInput::IT_NONE,0};
-                if (input_mapping.find(ks) != input_mapping.end())
-                    si = input_mapping[ks];
+                auto it = input_mapping.find(ks);
+                if (it != input_mapping.end())
+                    si = it->second;
 
                 if (si.type == SingleInput::IT_NONE) {
                     /* Key is mapped to nothing */
@@ -28,7 +28,7 @@
 #include <xcb/xcb_keysyms.h>
 // #include <X11/Xlib.h>
 #include <X11/keysym.h>
-#include <map>
+#include <unordered_map>
 #include <vector>
 #include <array>
 #include <string>
@@ -67,6 +67,7 @@ typedef int HotKeyType; enum
     HOTKEY_LOADSTATE8,
     HOTKEY_LOADSTATE9,
     HOTKEY_LOADSTATE_BACKTRACK,
+    HOTKEY_REWIND, // Load the most recent state of the rewind ring buffer
     HOTKEY_TOGGLE_ENCODE, // Start/stop audio/video encoding
     HOTKEY_CALIBRATE_MOUSE, // Calibrate mouse cursor position
     HOTKEY_LEN
@@ -129,14 +130,22 @@ class KeyMapping {
         /* Initialize hotkeys and mapping list */
         void init(xcb_connection_t* conn);
 
-        /* Map keyboard KeySym to a single input of a keyboard or controller */
-        std::map<xcb_keysym_t,SingleInput> input_mapping;
+        /* Map keyboard KeySym to a single input of a keyboard or controller.
+         * Hash tables, so that dispatching a key event is constant-time: the
+         * tables are only rebuilt on remap, but probed on every key event
+         * between a keypress and the frame advance */
+        std::unordered_map<xcb_keysym_t,SingleInput> input_mapping;
 
         /* List of inputs that can be mapped to a single key */
         std::vector<SingleInput> input_list;
 
+        /* Index of the keyboard entries of input_list by keysym, so that
+         * input_description() is a hash probe instead of a scan of the
+         * whole list for every displayed mapping */
+        std::unordered_map<xcb_keysym_t, size_t> input_index;
+
         /* Map keyboard KeySym to a hotkey */
-        std::map<xcb_keysym_t,HotKey> hotkey_mapping;
+        std::unordered_map<xcb_keysym_t,HotKey> hotkey_mapping;
 
         /* List of hotkeys */
         std::vector<HotKey> hotkey_list;
@@ -0,0 +1,332 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MovieDiff.h"
+#include "MovieFile.h"
+
+/* Chunk size bounds, in frames. The average is driven by the rolling hash
+ * mask: one boundary every ~128 frames of differing content. */
+#define CHUNK_MIN 32
+#define CHUNK_MAX 4096
+#define CHUNK_MASK UINT64_C(127)
+
+/* How many chunks ahead we look for a re-synchronization point before
+ * declaring a plain replacement */
+#define RESYNC_HORIZON 256
+
+/* Primes of xxHash64, reused for mixing */
+#define PRIME64_1 UINT64_C(11400714785074694791)
+#define PRIME64_2 UINT64_C(14029467366897019727)
+
+uint64_t MovieDiff::frameHash(const AllInputs& ai)
+{
+    uint64_t h = 0;
+    for (int i = 0; i < AllInputs::MAXKEYS; i++)
+        h = (h ^ ai.keyboard[i]) * PRIME64_1;
+    h = (h ^ static_cast<uint32_t>(ai.pointer_x)) * PRIME64_1;
+    h = (h ^ static_cast<uint32_t>(ai.pointer_y)) * PRIME64_1;
+    h = (h ^ ai.pointer_mask) * PRIME64_1;
+    for (int j = 0; j < AllInputs::MAXJOYS; j++) {
+        for (int a = 0; a < AllInputs::MAXAXES; a++)
+            h = (h ^ static_cast<uint16_t>(ai.controller_axes[j][a])) * PRIME64_1;
+        h = (h ^ ai.controller_buttons[j]) * PRIME64_1;
+    }
+    h = (h ^ ai.restart) * PRIME64_1;
+
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    return h;
+}
+
+/* Hash every frame of a movie */
+static void hashMovie(MovieFile& movie, std::vector<uint64_t>& hashes)
+{
+    unsigned long n = movie.nbFrames();
+    hashes.resize(n);
+    AllInputs ai;
+    for (unsigned long i = 0; i < n; i++) {
+        movie.getInputs(ai, i);
+        hashes[i] = MovieDiff::frameHash(ai);
+    }
+}
+
+/* Cut the frame range [lo, hi) into content-defined chunks, appending the
+ * chunk start positions. A boundary is placed where a rolling hash of the
+ * frames since the last boundary takes a fixed value, so identical input
+ * runs are cut identically in both movies whatever precedes them. */
+static void cutChunks(const std::vector<uint64_t>& h, unsigned long lo,
+    unsigned long hi, std::vector<unsigned long>& starts)
+{
+    starts.clear();
+    if (lo >= hi)
+        return;
+
+    starts.push_back(lo);
+    uint64_t roll = 0;
+    unsigned long start = lo;
+    for (unsigned long i = lo; i < hi; i++) {
+        roll = roll * PRIME64_2 + h[i];
+        unsigned long len = i + 1 - start;
+        if ((len >= CHUNK_MIN) &&
+            (((roll & CHUNK_MASK) == CHUNK_MASK) || (len >= CHUNK_MAX))) {
+            start = i + 1;
+            roll = 0;
+            if (start < hi)
+                starts.push_back(start);
+        }
+    }
+}
+
+/* Hash of one chunk, covering its length and its frame hashes */
+static uint64_t chunkHash(const std::vector<uint64_t>& h, unsigned long lo,
+    unsigned long hi)
+{
+    uint64_t x = (hi - lo) * PRIME64_1;
+    for (unsigned long i = lo; i < hi; i++)
+        x = (x ^ h[i]) * PRIME64_2;
+    return x;
+}
+
+/* Check that two chunks hold the same frame hash sequence, guarding the
+ * chunk hash against combination collisions */
+static bool chunksEqual(const std::vector<uint64_t>& ha, unsigned long alo,
+    unsigned long ahi, const std::vector<uint64_t>& hb, unsigned long blo,
+    unsigned long bhi)
+{
+    if ((ahi - alo) != (bhi - blo))
+        return false;
+    for (unsigned long i = 0; i < (ahi - alo); i++) {
+        if (ha[alo + i] != hb[blo + i])
+            return false;
+    }
+    return true;
+}
+
+/* Append an op, merging it into the previous one when both have the same
+ * type and are contiguous */
+static void pushOp(std::vector<MovieDiffOp>& ops, int type,
+    unsigned long first_start, unsigned long first_count,
+    unsigned long second_start, unsigned long second_count)
+{
+    if ((first_count == 0) && (second_count == 0))
+        return;
+    if (!ops.empty() && (ops.back().type == type) &&
+        (ops.back().first_start + ops.back().first_count == first_start) &&
+        (ops.back().second_start + ops.back().second_count == second_start)) {
+        ops.back().first_count += first_count;
+        ops.back().second_count += second_count;
+        return;
+    }
+    ops.push_back({type, first_start, first_count, second_start, second_count});
+}
+
+std::vector<MovieDiffOp> MovieDiff::diff(MovieFile& first, MovieFile& second)
+{
+    std::vector<MovieDiffOp> ops;
+
+    std::vector<uint64_t> ha, hb;
+    hashMovie(first, ha);
+    hashMovie(second, hb);
+    unsigned long n = ha.size();
+    unsigned long m = hb.size();
+
+    /* Trim the common prefix and suffix, covering the whole movie when only
+     * a region in the middle was edited */
+    unsigned long pre = 0;
+    while ((pre < n) && (pre < m) && (ha[pre] == hb[pre]))
+        pre++;
+    unsigned long suf = 0;
+    while ((suf < n - pre) && (suf < m - pre) &&
+           (ha[n - 1 - suf] == hb[m - 1 - suf]))
+        suf++;
+
+    pushOp(ops, MovieDiffOp::EQUAL, 0, pre, 0, pre);
+
+    /* Chunk the differing middle of both movies */
+    std::vector<unsigned long> ca, cb;
+    cutChunks(ha, pre, n - suf, ca);
+    cutChunks(hb, pre, m - suf, cb);
+
+    std::vector<uint64_t> cha(ca.size()), chb(cb.size());
+    for (size_t i = 0; i < ca.size(); i++)
+        cha[i] = chunkHash(ha, ca[i], (i + 1 < ca.size()) ? ca[i + 1] : (n - suf));
+    for (size_t i = 0; i < cb.size(); i++)
+        chb[i] = chunkHash(hb, cb[i], (i + 1 < cb.size()) ? cb[i + 1] : (m - suf));
+
+    auto aEnd = [&](size_t i) { return (i + 1 < ca.size()) ? ca[i + 1] : (n - suf); };
+    auto bEnd = [&](size_t i) { return (i + 1 < cb.size()) ? cb[i + 1] : (m - suf); };
+
+    size_t ia = 0, ib = 0;
+    while ((ia < ca.size()) && (ib < cb.size())) {
+        if ((cha[ia] == chb[ib]) &&
+            chunksEqual(ha, ca[ia], aEnd(ia), hb, cb[ib], bEnd(ib))) {
+            pushOp(ops, MovieDiffOp::EQUAL, ca[ia], aEnd(ia) - ca[ia],
+                cb[ib], bEnd(ib) - cb[ib]);
+            ia++;
+            ib++;
+            continue;
+        }
+
+        /* Look for the nearest re-synchronization point: either the current
+         * chunk of one movie appears further in the other (insertion or
+         * deletion), or neither does (replacement) */
+        size_t k = 0, l = 0;
+        for (size_t s = ib + 1; (s < cb.size()) && (s - ib <= RESYNC_HORIZON); s++) {
+            if (chb[s] == cha[ia]) {
+                k = s - ib;
+                break;
+            }
+        }
+        for (size_t s = ia + 1; (s < ca.size()) && (s - ia <= RESYNC_HORIZON); s++) {
+            if (cha[s] == chb[ib]) {
+                l = s - ia;
+                break;
+            }
+        }
+
+        if ((k == 0) && (l == 0)) {
+            pushOp(ops, MovieDiffOp::REPLACE, ca[ia], aEnd(ia) - ca[ia],
+                cb[ib], bEnd(ib) - cb[ib]);
+            ia++;
+            ib++;
+        }
+        else if ((l == 0) || ((k != 0) && (k <= l))) {
+            /* k chunks of the second movie were inserted before the match */
+            pushOp(ops, MovieDiffOp::INSERT, ca[ia], 0,
+                cb[ib], bEnd(ib + k - 1) - cb[ib]);
+            ib += k;
+        }
+        else {
+            /* l chunks of the first movie were deleted */
+            pushOp(ops, MovieDiffOp::DELETE, ca[ia], aEnd(ia + l - 1) - ca[ia],
+                cb[ib], 0);
+            ia += l;
+        }
+    }
+
+    /* One movie ran out of chunks, the rest of the other is an insertion
+     * or a deletion */
+    if (ia < ca.size())
+        pushOp(ops, MovieDiffOp::DELETE, ca[ia], (n - suf) - ca[ia], m - suf, 0);
+    if (ib < cb.size())
+        pushOp(ops, MovieDiffOp::INSERT, n - suf, 0, cb[ib], (m - suf) - cb[ib]);
+
+    pushOp(ops, MovieDiffOp::EQUAL, n - suf, suf, m - suf, suf);
+
+    return ops;
+}
+
+/* One non-equal diff range in base coordinates, with its replacement range
+ * in the variant movie */
+struct Change {
+    unsigned long base_start, base_count;
+    unsigned long src_start, src_count;
+};
+
+static void changesFromOps(const std::vector<MovieDiffOp>& ops,
+    std::vector<Change>& changes)
+{
+    changes.clear();
+    for (const MovieDiffOp& op : ops) {
+        if (op.type != MovieDiffOp::EQUAL)
+            changes.push_back({op.first_start, op.first_count,
+                op.second_start, op.second_count});
+    }
+}
+
+/* Check whether two changes touch the same base range. Insertions have a
+ * zero base count but still conflict with a change at the same point. */
+static bool changesOverlap(const Change& x, const Change& y)
+{
+    unsigned long xlen = (x.base_count > 0) ? x.base_count : 1;
+    unsigned long ylen = (y.base_count > 0) ? y.base_count : 1;
+    return (x.base_start < y.base_start + ylen) &&
+           (y.base_start < x.base_start + xlen);
+}
+
+int MovieDiff::merge(MovieFile& base, MovieFile& ours, MovieFile& theirs,
+    std::vector<AllInputs>& merged,
+    std::vector<std::pair<unsigned long, unsigned long>>& conflicts)
+{
+    std::vector<Change> co, ct;
+    std::vector<MovieDiffOp> dours = diff(base, ours);
+    std::vector<MovieDiffOp> dtheirs = diff(base, theirs);
+    changesFromOps(dours, co);
+    changesFromOps(dtheirs, ct);
+
+    merged.clear();
+    conflicts.clear();
+
+    AllInputs ai;
+    unsigned long bpos = 0;
+    size_t io = 0, it = 0;
+
+    while ((io < co.size()) || (it < ct.size())) {
+        /* Take the change starting first in the base; ties go to our side */
+        bool takeOurs;
+        if (it >= ct.size())
+            takeOurs = true;
+        else if (io >= co.size())
+            takeOurs = false;
+        else
+            takeOurs = (co[io].base_start <= ct[it].base_start);
+
+        const Change& c = takeOurs ? co[io] : ct[it];
+
+        /* Copy the unchanged base frames before the change */
+        for (unsigned long p = bpos; p < c.base_start; p++) {
+            base.getInputs(ai, p);
+            merged.push_back(ai);
+        }
+
+        /* Append the replacement frames of the winning side */
+        MovieFile& src = takeOurs ? ours : theirs;
+        for (unsigned long q = 0; q < c.src_count; q++) {
+            src.getInputs(ai, c.src_start + q);
+            merged.push_back(ai);
+        }
+
+        bpos = c.base_start + c.base_count;
+        if (takeOurs)
+            io++;
+        else
+            it++;
+
+        /* Changes of the other side touching the same base range are
+         * conflicts: they are dropped, keeping the side applied above */
+        size_t& other = takeOurs ? it : io;
+        std::vector<Change>& olist = takeOurs ? ct : co;
+        while ((other < olist.size()) && changesOverlap(c, olist[other])) {
+            conflicts.push_back({olist[other].base_start,
+                olist[other].base_count});
+            if (olist[other].base_start + olist[other].base_count > bpos)
+                bpos = olist[other].base_start + olist[other].base_count;
+            other++;
+        }
+    }
+
+    /* Copy the base tail after the last change */
+    for (unsigned long p = bpos; p < base.nbFrames(); p++) {
+        base.getInputs(ai, p);
+        merged.push_back(ai);
+    }
+
+    return conflicts.size();
+}
@@ -0,0 +1,71 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_MOVIEDIFF_H_INCLUDED
+#define LIBTAS_MOVIEDIFF_H_INCLUDED
+
+#include "../shared/AllInputs.h"
+#include <vector>
+#include <cstdint>
+
+class MovieFile;
+
+/* One range of a movie comparison. The coordinates of an EQUAL or REPLACE
+ * range cover both movies; an INSERT only exists in the second movie and a
+ * DELETE only in the first, with the count of the absent side being 0. */
+struct MovieDiffOp {
+    enum Type { EQUAL, INSERT, DELETE, REPLACE };
+
+    int type;
+    unsigned long first_start, first_count;
+    unsigned long second_start, second_count;
+};
+
+/* Comparison of movie input streams, without exporting them to text.
+ *
+ * The diff trims the common prefix and suffix with plain comparisons, then
+ * cuts the differing middle of both movies into content-defined chunks: a
+ * boundary is placed where a rolling hash of the recent frames takes a
+ * particular value, so the same input run produces the same chunks in both
+ * movies whatever precedes it. Chunks are then matched by hash, which
+ * re-synchronizes after insertions and deletions, so the work after the
+ * trim is proportional to the changed region, not to the movie length.
+ *
+ * The three-way merge diffs both variants against the common base and
+ * replays the non-overlapping changes of both sides; overlapping changes
+ * are conflicts, resolved by keeping the change that starts first in the
+ * base (ours on ties). */
+class MovieDiff {
+public:
+    /* Hash of one frame of inputs */
+    static uint64_t frameHash(const AllInputs& ai);
+
+    /* Compare the inputs of two movies. The returned ranges cover both
+     * movies entirely, in order */
+    static std::vector<MovieDiffOp> diff(MovieFile& first, MovieFile& second);
+
+    /* Merge the changes of ours and theirs relative to base into merged.
+     * The dropped side of each conflict is appended to conflicts as a base
+     * range. Returns the number of conflicts */
+    static int merge(MovieFile& base, MovieFile& ours, MovieFile& theirs,
+        std::vector<AllInputs>& merged,
+        std::vector<std::pair<unsigned long, unsigned long>>& conflicts);
+};
+
+#endif
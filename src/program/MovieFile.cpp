@@ -21,16 +21,190 @@
 #include <sstream>
 #include <iomanip>
 #include <iostream>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <vector>
 #include <fcntl.h> // O_RDONLY, O_WRONLY, O_CREAT
 #include <X11/X.h> // ButtonXMask
 #include <errno.h>
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifdef LIBTAS_ENABLE_ZSTD
+#include <zstd.h>
+#endif
 
 #include "MovieFile.h"
 #include "utils.h"
 #include "../shared/version.h"
 
-MovieFile::MovieFile(Context* c) : modifiedSinceLastSave(false), modifiedSinceLastAutoSave(false), modifiedSinceLastStateLoad(false), context(c) {}
+/* Header of the binary movie format. The inputs are stored as fixed-stride
+ * records in a page-aligned section, so a frame is addressable in O(1) and
+ * the whole file can be parsed from a single mmap, instead of shelling out
+ * to gzip and tar and parsing one line of text per frame. The config file
+ * and the annotations are embedded as text blobs, so the QSettings parsing
+ * is shared with the old format. */
+struct BinaryMovieHeader {
+	char magic[4];            // "LTMB"
+	uint32_t version;
+	uint64_t framecount;
+	uint32_t stride;          // bytes per decoded frame record
+	uint8_t keyboard_support;
+	uint8_t mouse_support;
+	uint8_t nb_controllers;
+	uint8_t frames_compressed; // frame section is zstd-compressed
+	uint64_t config_offset;
+	uint64_t config_size;
+	uint64_t annotations_offset;
+	uint64_t annotations_size;
+	uint64_t frames_offset;    // page-aligned
+	uint64_t frames_size;      // stored size of the frame section
+	uint64_t frames_raw_size;  // size of the decoded frame section
+
+	/* Journal of frame edits appended after the frame section, so that an
+	 * autosave only writes the frames modified since the last save. Each
+	 * entry is a uint64 frame index followed by one uncompressed record,
+	 * and the entries are replayed in order on top of the base section.
+	 * framecount above holds the movie length including the journal. */
+	uint64_t journal_offset;
+	uint64_t journal_count;
+
+	/* Sampled per-frame state digests, added in version 2. One uint64 per
+	 * frame, stored only on a full save; digests of frames recorded since
+	 * then are kept in memory until the next full save. Version 1 movies do
+	 * not have these fields, so they must only be read when version >= 2. */
+	uint64_t digests_offset;
+	uint64_t digests_count;
+
+	/* Frame markers, added in version 3. Each entry is a uint64 frame index
+	 * followed by a uint32 text length and the text bytes, in frame order.
+	 * Only a full save writes them, so journal appending is disabled while
+	 * a marker change is pending. Only read when version >= 3. */
+	uint64_t markers_offset;
+	uint64_t markers_size;
+	uint64_t markers_count;
+
+	/* Seek index, added in version 4. The frame section is compressed in
+	 * independent chunks of chunk_frames frames, and the table at
+	 * chunks_offset holds one uint64 stored size per chunk, so frame N is
+	 * reachable by decompressing a single chunk instead of the whole
+	 * section. A chunk whose stored size equals its raw size is stored
+	 * uncompressed (compression did not help). chunk_frames == 0 means a
+	 * single compressed blob, as written by versions before 4. Only read
+	 * when version >= 4. */
+	uint64_t chunk_frames;
+	uint64_t chunks_offset;
+	uint64_t chunks_count;
+
+	/* Content hash, added in version 5. A Merkle-style hash of the input
+	 * frames as maintained by MovieFile::contentHash(), written on every
+	 * save and checked on load, so a corrupted or truncated frame section is
+	 * reported. 0 means the movie carries no hash. Only read when
+	 * version >= 5. */
+	uint64_t content_hash;
+};
+
+static const char BINARY_MOVIE_MAGIC[4] = {'L', 'T', 'M', 'B'};
+static const uint32_t BINARY_MOVIE_VERSION = 5;
+
+/* Frames per compressed chunk. At the typical stride this keeps chunks in
+ * the megabyte range: small enough that random access decompresses little,
+ * large enough that the compression ratio barely suffers */
+static const uint64_t BINARY_MOVIE_CHUNK_FRAMES = 65536;
+
+/* Size of a frame record, depending on the movie settings, mirroring the
+ * fields of the text format */
+static size_t frameStride(bool keyboard, bool mouse, int nb_controllers)
+{
+	size_t stride = 1; // restart byte
+	if (keyboard)
+		stride += AllInputs::MAXKEYS * 4;
+	if (mouse)
+		stride += 12; // x, y, button mask
+	stride += nb_controllers * (AllInputs::MAXAXES * 2 + 2);
+	return stride;
+}
+
+/* Encode a frame of inputs into a fixed-stride record */
+static void encodeFrame(const AllInputs& inputs, bool keyboard, bool mouse, int nb_controllers, uint8_t* rec)
+{
+	if (keyboard) {
+		for (int k=0; k<AllInputs::MAXKEYS; k++) {
+			uint32_t ks = static_cast<uint32_t>(inputs.keyboard[k]);
+			memcpy(rec, &ks, 4);
+			rec += 4;
+		}
+	}
+
+	if (mouse) {
+		int32_t x = inputs.pointer_x;
+		int32_t y = inputs.pointer_y;
+		uint32_t mask = inputs.pointer_mask;
+		memcpy(rec, &x, 4);
+		memcpy(rec + 4, &y, 4);
+		memcpy(rec + 8, &mask, 4);
+		rec += 12;
+	}
+
+	for (int joy=0; joy<nb_controllers; joy++) {
+		for (int axis=0; axis<AllInputs::MAXAXES; axis++) {
+			int16_t a = inputs.controller_axes[joy][axis];
+			memcpy(rec, &a, 2);
+			rec += 2;
+		}
+		uint16_t b = inputs.controller_buttons[joy];
+		memcpy(rec, &b, 2);
+		rec += 2;
+	}
+
+	*rec = inputs.restart ? 1 : 0;
+}
+
+/* Decode a fixed-stride record into a frame of inputs */
+static void decodeFrame(AllInputs& inputs, bool keyboard, bool mouse, int nb_controllers, const uint8_t* rec)
+{
+	inputs.emptyInputs();
+
+	if (keyboard) {
+		for (int k=0; k<AllInputs::MAXKEYS; k++) {
+			uint32_t ks;
+			memcpy(&ks, rec, 4);
+			inputs.keyboard[k] = ks;
+			rec += 4;
+		}
+	}
+
+	if (mouse) {
+		int32_t x, y;
+		uint32_t mask;
+		memcpy(&x, rec, 4);
+		memcpy(&y, rec + 4, 4);
+		memcpy(&mask, rec + 8, 4);
+		inputs.pointer_x = x;
+		inputs.pointer_y = y;
+		inputs.pointer_mask = mask;
+		rec += 12;
+	}
+
+	for (int joy=0; joy<nb_controllers; joy++) {
+		for (int axis=0; axis<AllInputs::MAXAXES; axis++) {
+			int16_t a;
+			memcpy(&a, rec, 2);
+			inputs.controller_axes[joy][axis] = a;
+			rec += 2;
+		}
+		uint16_t b;
+		memcpy(&b, rec, 2);
+		inputs.controller_buttons[joy] = b;
+		rec += 2;
+	}
+
+	inputs.restart = (*rec != 0);
+}
+
+MovieFile::MovieFile(Context* c) : modifiedSinceLastSave(false), modifiedSinceLastAutoSave(false), modifiedSinceLastStateLoad(false), input_load_count(0), context(c), edit_group_depth(0), journal_dirty_start(0), journal_entry_count(0), journal_base_frames(0), markers_modified(false) {}
 
 const char* MovieFile::errorString(int error_code) {
 	static std::string err;
@@ -51,6 +225,362 @@ const char* MovieFile::errorString(int error_code) {
 	}
 }
 
+/* Validate a binary movie header against the file size, before touching any
+ * section. Version 1 movies are still read, they just carry no digest
+ * section. */
+static bool validateBinaryHeader(const uint8_t* base, size_t filesize)
+{
+	const BinaryMovieHeader* header = reinterpret_cast<const BinaryMovieHeader*>(base);
+
+	if ((memcmp(header->magic, BINARY_MOVIE_MAGIC, 4) != 0) ||
+		(header->version < 1) || (header->version > BINARY_MOVIE_VERSION) ||
+		(header->nb_controllers > AllInputs::MAXJOYS) ||
+		(header->stride != frameStride(header->keyboard_support, header->mouse_support, header->nb_controllers)) ||
+		(header->frames_raw_size % header->stride != 0) ||
+		(header->config_offset + header->config_size > filesize) ||
+		(header->annotations_offset + header->annotations_size > filesize) ||
+		(header->frames_offset + header->frames_size > filesize) ||
+		(header->journal_offset + header->journal_count * (8 + header->stride) > filesize) ||
+		((header->version >= 2) && (header->digests_offset + header->digests_count * 8 > filesize)) ||
+		((header->version >= 3) && (header->markers_offset + header->markers_size > filesize)) ||
+		((header->version >= 4) && (header->chunks_offset + header->chunks_count * 8 > filesize))) {
+		return false;
+	}
+
+	/* Validate the seek index: the chunk table must cover the raw section
+	 * and its stored sizes must add up to the stored section */
+	if ((header->version >= 4) && header->frames_compressed && (header->chunk_frames > 0)) {
+		uint64_t chunk_bytes = header->chunk_frames * header->stride;
+		uint64_t expected_chunks = (header->frames_raw_size + chunk_bytes - 1) / chunk_bytes;
+		uint64_t stored_total = 0;
+		const uint64_t* sizes = reinterpret_cast<const uint64_t*>(base + header->chunks_offset);
+		for (uint64_t c = 0; c < header->chunks_count; c++)
+			stored_total += sizes[c];
+		if ((header->chunks_count != expected_chunks) || (stored_total != header->frames_size))
+			return false;
+	}
+
+	return true;
+}
+
+bool MovieFile::isBinaryMovie(const std::string& moviefile)
+{
+	std::ifstream movie_stream(moviefile, std::ifstream::binary);
+	if (!movie_stream)
+		return false;
+
+	char magic[4];
+	movie_stream.read(magic, 4);
+	if (!movie_stream)
+		return false;
+
+	return memcmp(magic, BINARY_MOVIE_MAGIC, 4) == 0;
+}
+
+int MovieFile::extractBinaryMovie(const std::string& moviefile)
+{
+	/* Empty the temp directory */
+	std::string configfile = context->config.tempmoviedir + "/config.ini";
+	std::string inputfile = context->config.tempmoviedir + "/inputs";
+	std::string annotationsfile = context->config.tempmoviedir + "/annotations.txt";
+	unlink(configfile.c_str());
+	unlink(inputfile.c_str());
+	unlink(annotationsfile.c_str());
+
+	/* Map the whole moviefile */
+	int fd = open(moviefile.c_str(), O_RDONLY);
+	if (fd < 0)
+		return ENOMOVIE;
+
+	struct stat moviestat;
+	if (fstat(fd, &moviestat) < 0) {
+		::close(fd);
+		return EBADARCHIVE;
+	}
+	size_t filesize = moviestat.st_size;
+
+	if (filesize < sizeof(BinaryMovieHeader)) {
+		::close(fd);
+		return EBADARCHIVE;
+	}
+
+	void* map = mmap(nullptr, filesize, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (map == MAP_FAILED)
+		return EBADARCHIVE;
+
+	const uint8_t* base = static_cast<const uint8_t*>(map);
+	const BinaryMovieHeader* header = reinterpret_cast<const BinaryMovieHeader*>(base);
+
+	if (!validateBinaryHeader(base, filesize)) {
+		munmap(map, filesize);
+		return EBADARCHIVE;
+	}
+
+	/* Write the config and annotations files into the temp directory, where
+	 * the rest of the code expects them */
+	std::ofstream config_stream(configfile, std::ofstream::binary);
+	config_stream.write(reinterpret_cast<const char*>(base + header->config_offset), header->config_size);
+	config_stream.close();
+	if (!config_stream) {
+		munmap(map, filesize);
+		return ENOCONFIG;
+	}
+
+	std::ofstream annotations_stream(annotationsfile, std::ofstream::binary);
+	annotations_stream.write(reinterpret_cast<const char*>(base + header->annotations_offset), header->annotations_size);
+	annotations_stream.close();
+
+	/* Decompress the frame section if needed */
+	const uint8_t* frames = base + header->frames_offset;
+	std::vector<uint8_t> raw;
+	if (header->frames_compressed) {
+#ifdef LIBTAS_ENABLE_ZSTD
+		raw.resize(header->frames_raw_size);
+		if ((header->version >= 4) && (header->chunk_frames > 0)) {
+			/* Chunked section: decompress each chunk independently */
+			uint64_t chunk_bytes = header->chunk_frames * header->stride;
+			const uint64_t* sizes = reinterpret_cast<const uint64_t*>(base + header->chunks_offset);
+			const uint8_t* src = frames;
+			for (uint64_t c = 0; c < header->chunks_count; c++) {
+				uint64_t off = c * chunk_bytes;
+				uint64_t raw_chunk = std::min(chunk_bytes, header->frames_raw_size - off);
+				if (sizes[c] == raw_chunk) {
+					/* Chunk stored uncompressed */
+					memcpy(raw.data() + off, src, raw_chunk);
+				}
+				else {
+					size_t dsize = ZSTD_decompress(raw.data() + off, raw_chunk, src, sizes[c]);
+					if (ZSTD_isError(dsize) || (dsize != raw_chunk)) {
+						munmap(map, filesize);
+						return EBADARCHIVE;
+					}
+				}
+				src += sizes[c];
+			}
+		}
+		else {
+			size_t dsize = ZSTD_decompress(raw.data(), raw.size(), frames, header->frames_size);
+			if (ZSTD_isError(dsize) || (dsize != raw.size())) {
+				munmap(map, filesize);
+				return EBADARCHIVE;
+			}
+		}
+		frames = raw.data();
+#else
+		munmap(map, filesize);
+		return EBADARCHIVE;
+#endif
+	}
+
+	/* Decode the fixed-stride frame records into the input list, using the
+	 * movie settings from the header because the config file has not been
+	 * parsed yet at this point */
+	uint64_t base_count = header->frames_raw_size / header->stride;
+
+	input_list.clear();
+	input_list.reserve(header->framecount);
+
+	AllInputs ai;
+	for (uint64_t f = 0; f < base_count; f++) {
+		decodeFrame(ai, header->keyboard_support, header->mouse_support, header->nb_controllers, frames + f*header->stride);
+		input_list.push_back(ai);
+	}
+
+	/* Bring the input list to the movie length, which can differ from the
+	 * base section when the journal appended or truncated frames */
+	ai.emptyInputs();
+	input_list.resize(header->framecount, ai);
+
+	/* Replay the journal entries on top of the base section, in order.
+	 * Entries beyond the movie length belong to a later truncated part. */
+	const uint8_t* entry = base + header->journal_offset;
+	for (uint64_t e = 0; e < header->journal_count; e++) {
+		uint64_t frame;
+		memcpy(&frame, entry, 8);
+		if (frame < header->framecount)
+			decodeFrame(input_list[frame], header->keyboard_support, header->mouse_support, header->nb_controllers, entry + 8);
+		entry += 8 + header->stride;
+	}
+
+	/* Load the recorded state digests, if any */
+	digest_list.clear();
+	if (header->version >= 2) {
+		digest_list.resize(header->digests_count);
+		memcpy(digest_list.data(), base + header->digests_offset, header->digests_count * 8);
+	}
+
+	/* Load the frame markers, if any */
+	markers.clear();
+	markers_modified = false;
+	if (header->version >= 3) {
+		const uint8_t* mark = base + header->markers_offset;
+		const uint8_t* mark_end = mark + header->markers_size;
+		for (uint64_t m = 0; m < header->markers_count; m++) {
+			uint64_t frame;
+			uint32_t length;
+			if (mark + 12 > mark_end)
+				break;
+			memcpy(&frame, mark, 8);
+			memcpy(&length, mark + 8, 4);
+			mark += 12;
+			if (length > static_cast<uint64_t>(mark_end - mark))
+				break;
+			markers[frame] = std::string(reinterpret_cast<const char*>(mark), length);
+			mark += length;
+		}
+	}
+
+	/* Remember the journal state, so further incremental saves to this
+	 * moviefile keep appending to it */
+	journal_path = moviefile;
+	journal_dirty_start = input_list.size();
+	journal_entry_count = header->journal_count;
+	journal_base_frames = base_count;
+
+	/* Check the content seal, if the movie carries one. The chunk hashes of
+	 * the previous input list are all stale at this point. */
+	chunk_hashes.clear();
+	dirty_chunks.clear();
+	if ((header->version >= 5) && (header->content_hash != 0) &&
+		(contentHash() != header->content_hash)) {
+		std::cerr << "Warning: movie content hash mismatch, the moviefile may be corrupted!" << std::endl;
+	}
+
+	munmap(map, filesize);
+	return 0;
+}
+
+int MovieFile::loadInputsRange(const std::string& moviefile, uint64_t start,
+	uint64_t count, std::vector<AllInputs>& inputs)
+{
+	inputs.clear();
+
+	int fd = open(moviefile.c_str(), O_RDONLY);
+	if (fd < 0)
+		return ENOMOVIE;
+
+	struct stat moviestat;
+	if (fstat(fd, &moviestat) < 0) {
+		::close(fd);
+		return EBADARCHIVE;
+	}
+	size_t filesize = moviestat.st_size;
+
+	if (filesize < sizeof(BinaryMovieHeader)) {
+		::close(fd);
+		return EBADARCHIVE;
+	}
+
+	void* map = mmap(nullptr, filesize, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (map == MAP_FAILED)
+		return EBADARCHIVE;
+
+	const uint8_t* base = static_cast<const uint8_t*>(map);
+	const BinaryMovieHeader* header = reinterpret_cast<const BinaryMovieHeader*>(base);
+
+	if (!validateBinaryHeader(base, filesize)) {
+		munmap(map, filesize);
+		return EBADARCHIVE;
+	}
+
+	/* Clamp the range to the movie length */
+	if (start >= header->framecount) {
+		munmap(map, filesize);
+		return 0;
+	}
+	if (count > header->framecount - start)
+		count = header->framecount - start;
+
+	AllInputs ai;
+	ai.emptyInputs();
+	inputs.resize(count, ai);
+
+	/* Frames of the base section covered by the range. Frames past the
+	 * base section were appended by the journal and stay empty here until
+	 * the journal replay below. */
+	uint64_t base_count = header->frames_raw_size / header->stride;
+	uint64_t base_start = std::min(start, base_count);
+	uint64_t base_end = std::min(start + count, base_count);
+
+	if (base_start < base_end) {
+		const uint8_t* frames = base + header->frames_offset;
+		std::vector<uint8_t> raw;
+		uint64_t raw_start = base_start; // frame index of raw[0]
+
+		if (header->frames_compressed) {
+#ifdef LIBTAS_ENABLE_ZSTD
+			if ((header->version >= 4) && (header->chunk_frames > 0)) {
+				/* Decompress only the chunks covering the range, located
+				 * through the seek index */
+				const uint64_t* sizes = reinterpret_cast<const uint64_t*>(base + header->chunks_offset);
+				uint64_t chunk_bytes = header->chunk_frames * header->stride;
+				uint64_t c0 = base_start / header->chunk_frames;
+				uint64_t c1 = (base_end - 1) / header->chunk_frames;
+
+				const uint8_t* src = frames;
+				for (uint64_t c = 0; c < c0; c++)
+					src += sizes[c];
+
+				raw.resize(std::min((c1 - c0 + 1) * chunk_bytes, header->frames_raw_size - c0 * chunk_bytes));
+				raw_start = c0 * header->chunk_frames;
+				for (uint64_t c = c0; c <= c1; c++) {
+					uint64_t off = (c - c0) * chunk_bytes;
+					uint64_t raw_chunk = std::min(chunk_bytes, header->frames_raw_size - c * chunk_bytes);
+					if (sizes[c] == raw_chunk) {
+						memcpy(raw.data() + off, src, raw_chunk);
+					}
+					else {
+						size_t dsize = ZSTD_decompress(raw.data() + off, raw_chunk, src, sizes[c]);
+						if (ZSTD_isError(dsize) || (dsize != raw_chunk)) {
+							munmap(map, filesize);
+							return EBADARCHIVE;
+						}
+					}
+					src += sizes[c];
+				}
+			}
+			else {
+				/* Single compressed blob, no seek index: the whole section
+				 * must be decompressed */
+				raw.resize(header->frames_raw_size);
+				size_t dsize = ZSTD_decompress(raw.data(), raw.size(), frames, header->frames_size);
+				if (ZSTD_isError(dsize) || (dsize != raw.size())) {
+					munmap(map, filesize);
+					return EBADARCHIVE;
+				}
+				raw_start = 0;
+			}
+			frames = raw.data();
+#else
+			munmap(map, filesize);
+			return EBADARCHIVE;
+#endif
+		}
+		else {
+			/* Uncompressed section: address the records in place */
+			raw_start = 0;
+		}
+
+		for (uint64_t f = base_start; f < base_end; f++)
+			decodeFrame(inputs[f - start], header->keyboard_support, header->mouse_support, header->nb_controllers, frames + (f - raw_start)*header->stride);
+	}
+
+	/* Replay the journal entries falling inside the range */
+	const uint8_t* entry = base + header->journal_offset;
+	for (uint64_t e = 0; e < header->journal_count; e++) {
+		uint64_t frame;
+		memcpy(&frame, entry, 8);
+		if ((frame >= start) && (frame < start + count))
+			decodeFrame(inputs[frame - start], header->keyboard_support, header->mouse_support, header->nb_controllers, entry + 8);
+		entry += 8 + header->stride;
+	}
+
+	munmap(map, filesize);
+	return 0;
+}
+
 int MovieFile::extractMovie(const std::string& moviefile)
 {
 	if (moviefile.empty())
@@ -60,6 +590,10 @@ int MovieFile::extractMovie(const std::string& moviefile)
 	if (access(moviefile.c_str(), F_OK) != 0)
 		return ENOMOVIE;
 
+	/* The binary format is parsed in-process from a single mmap */
+	if (isBinaryMovie(moviefile))
+		return extractBinaryMovie(moviefile);
+
 	/* Empty the temp directory */
 	std::string configfile = context->config.tempmoviedir + "/config.ini";
 	std::string inputfile = context->config.tempmoviedir + "/inputs";
@@ -150,28 +684,27 @@ int MovieFile::loadMovie(const std::string& moviefile)
     }
     config.endArray();
 
-    /* Open the input file and parse each line to fill our input list */
-    std::string input_file = context->config.tempmoviedir + "/inputs";
-    std::ifstream input_stream(input_file);
-    std::string line;
+    /* Open the input file and parse each line to fill our input list. The
+     * binary format already decoded the inputs during extraction. */
+    if (!isBinaryMovie(moviefile)) {
+        input_list.clear();
+        /* Text movies predate state digests and frame markers */
+        digest_list.clear();
+        markers.clear();
+        markers_modified = false;
 
-    input_list.clear();
-
-    while (std::getline(input_stream, line)) {
-        if (!line.empty() && (line[0] == '|')) {
-            AllInputs ai;
-            readFrame(line, ai);
-            input_list.push_back(ai);
-        }
+        parseInputsText(context->config.tempmoviedir + "/inputs");
     }
 
 	if (context->config.sc.movie_framecount != input_list.size()) {
-		std::cerr << "Warning: movie framecount and movie config mismatch!" << std::endl;
+		/* An incremental save only updates the framecount in the binary
+		 * header, not in the embedded config file, so only warn about a
+		 * mismatch on text movies */
+		if (!isBinaryMovie(moviefile))
+			std::cerr << "Warning: movie framecount and movie config mismatch!" << std::endl;
 		context->config.sc.movie_framecount = input_list.size();
 	}
 
-    input_stream.close();
-
 	/* Load annotations if available */
 	std::string annotations_file = context->config.tempmoviedir + "/annotations.txt";
     std::ifstream annotations_stream(annotations_file);
@@ -183,6 +716,8 @@ int MovieFile::loadMovie(const std::string& moviefile)
 		annotations = "";
 	}
 
+	rebuildInputCounts();
+	input_load_count++;
 	return 0;
 }
 
@@ -193,27 +728,24 @@ int MovieFile::loadMovie()
 
 int MovieFile::loadInputs(const std::string& moviefile)
 {
-	/* Extract the moviefile in the temp directory */
+	/* Extract the moviefile in the temp directory. The binary format already
+	 * decoded the inputs during extraction. */
 	int ret = extractMovie(moviefile);
 	if (ret < 0)
 		return ret;
 
-    /* Open the input file and parse each line to fill our input list */
-    std::string input_file = context->config.tempmoviedir + "/inputs";
-    std::ifstream input_stream(input_file);
-    std::string line;
+    if (isBinaryMovie(moviefile)) {
+        rebuildInputCounts();
+        input_load_count++;
+        return 0;
+    }
 
+    /* Parse the whole input file to fill our input list */
     input_list.clear();
+    parseInputsText(context->config.tempmoviedir + "/inputs");
 
-    while (std::getline(input_stream, line)) {
-        if (!line.empty() && (line[0] == '|')) {
-            AllInputs ai;
-            readFrame(line, ai);
-            input_list.push_back(ai);
-        }
-    }
-
-    input_stream.close();
+	rebuildInputCounts();
+	input_load_count++;
 	return 0;
 }
 
@@ -223,15 +755,6 @@ int MovieFile::saveMovie(const std::string& moviefile, unsigned long nb_frames)
 	if (moviefile.empty())
 		return ENOMOVIE;
 
-    /* Format and write input frames into the input file */
-    std::string input_file = context->config.tempmoviedir + "/inputs";
-    std::ofstream input_stream(input_file, std::ofstream::trunc);
-
-    for (auto it = input_list.begin(); it != input_list.end(); ++it) {
-        writeFrame(input_stream, *it);
-    }
-    input_stream.close();
-
     /* Save some parameters into the config file */
 	QString configfile = context->config.tempmoviedir.c_str();
 	configfile += "/config.ini";
@@ -291,20 +814,254 @@ int MovieFile::saveMovie(const std::string& moviefile, unsigned long nb_frames)
 	annotations_stream << annotations;
 	annotations_stream.close();
 
-	/* Build the tar command */
-	std::ostringstream oss;
-	oss << "tar -czUf \"";
-	oss << moviefile;
-	oss << "\" -C ";
-	oss << context->config.tempmoviedir;
-	oss << " inputs config.ini annotations.txt";
+	/* Write the whole moviefile in the binary format, without forking any
+	 * compression process */
+	return saveBinaryMovie(moviefile);
+}
 
-	/* Execute the tar command */
-	// std::cout << oss.str() << std::endl;
-	int ret = system(oss.str().c_str());
+int MovieFile::saveBinaryMovie(const std::string& moviefile)
+{
+	/* Embed the config file that was just saved into the temp directory */
+	std::string configfile = context->config.tempmoviedir + "/config.ini";
+	std::ifstream config_stream(configfile, std::ifstream::binary);
+	if (!config_stream)
+		return ENOCONFIG;
+	std::string config_blob((std::istreambuf_iterator<char>(config_stream)),
+		std::istreambuf_iterator<char>());
+	config_stream.close();
+
+	/* Encode the inputs as fixed-stride records */
+	bool keyboard = context->config.sc.keyboard_support;
+	bool mouse = context->config.sc.mouse_support;
+	int nb_controllers = context->config.sc.nb_controllers;
+	size_t stride = frameStride(keyboard, mouse, nb_controllers);
+
+	std::vector<uint8_t> raw(input_list.size() * stride);
+	for (size_t f = 0; f < input_list.size(); f++)
+		encodeFrame(input_list[f], keyboard, mouse, nb_controllers, raw.data() + f*stride);
+
+	/* Compress the frame section in-process. Autosaves run this on every
+	 * save, so use the fastest compression level. The section is cut into
+	 * independent chunks with a stored-size table (the seek index), so
+	 * readers can decompress any frame range without starting from the
+	 * beginning of the movie. */
+	const uint8_t* frames = raw.data();
+	size_t frames_size = raw.size();
+	bool frames_compressed = false;
+	std::vector<uint8_t> comp;
+	std::vector<uint64_t> chunk_sizes;
+#ifdef LIBTAS_ENABLE_ZSTD
+	size_t chunk_bytes = BINARY_MOVIE_CHUNK_FRAMES * stride;
+	comp.reserve(raw.size() / 2);
+	std::vector<uint8_t> chunk_comp(ZSTD_compressBound(chunk_bytes));
+	for (size_t off = 0; off < raw.size(); off += chunk_bytes) {
+		size_t raw_chunk = std::min(chunk_bytes, raw.size() - off);
+		size_t csize = ZSTD_compress(chunk_comp.data(), chunk_comp.size(), raw.data() + off, raw_chunk, 1);
+		if (!ZSTD_isError(csize) && (csize < raw_chunk)) {
+			comp.insert(comp.end(), chunk_comp.data(), chunk_comp.data() + csize);
+			chunk_sizes.push_back(csize);
+		}
+		else {
+			/* Store the chunk raw, flagged by its size in the table */
+			comp.insert(comp.end(), raw.data() + off, raw.data() + off + raw_chunk);
+			chunk_sizes.push_back(raw_chunk);
+		}
+	}
+	frames = comp.data();
+	frames_size = comp.size();
+	frames_compressed = true;
+#endif
+
+	/* Digests beyond the movie length belong to a truncated part */
+	uint64_t digests_count = digest_list.size();
+	if (digests_count > input_list.size())
+		digests_count = input_list.size();
+
+	/* Serialize the frame markers, skipping the ones beyond the movie
+	 * length. The map iterates in frame order. */
+	std::string markers_blob;
+	uint64_t markers_count = 0;
+	for (const auto& marker : markers) {
+		if (marker.first >= input_list.size())
+			break;
+		uint64_t frame = marker.first;
+		uint32_t length = marker.second.size();
+		markers_blob.append(reinterpret_cast<const char*>(&frame), 8);
+		markers_blob.append(reinterpret_cast<const char*>(&length), 4);
+		markers_blob.append(marker.second);
+		markers_count++;
+	}
 
-	if (!WIFEXITED(ret) || (WEXITSTATUS(ret) != 0))
+	/* Fill the header, aligning the frame section on a page boundary so it
+	 * stays memory-mappable */
+	BinaryMovieHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, BINARY_MOVIE_MAGIC, 4);
+	header.version = BINARY_MOVIE_VERSION;
+	header.framecount = input_list.size();
+	header.stride = stride;
+	header.keyboard_support = keyboard;
+	header.mouse_support = mouse;
+	header.nb_controllers = nb_controllers;
+	header.frames_compressed = frames_compressed;
+	header.config_offset = sizeof(header);
+	header.config_size = config_blob.size();
+	header.annotations_offset = header.config_offset + header.config_size;
+	header.annotations_size = annotations.size();
+	header.digests_offset = header.annotations_offset + header.annotations_size;
+	header.digests_count = digests_count;
+	header.markers_offset = header.digests_offset + digests_count * 8;
+	header.markers_size = markers_blob.size();
+	header.markers_count = markers_count;
+	header.chunk_frames = frames_compressed ? BINARY_MOVIE_CHUNK_FRAMES : 0;
+	header.chunks_offset = header.markers_offset + header.markers_size;
+	header.chunks_count = chunk_sizes.size();
+	header.frames_offset = (header.chunks_offset + header.chunks_count * 8 + 4095) & ~UINT64_C(4095);
+	header.frames_size = frames_size;
+	header.frames_raw_size = raw.size();
+	header.journal_offset = header.frames_offset + header.frames_size;
+	header.journal_count = 0;
+	header.content_hash = contentHash();
+
+	/* Write into a temporary file next to the target, so a crash or a disk
+	 * full in the middle of the save cannot destroy the previous movie */
+	std::string tmpfile = moviefile + ".tmp";
+	std::ofstream movie_stream(tmpfile, std::ofstream::binary | std::ofstream::trunc);
+	if (!movie_stream)
+		return EBADARCHIVE;
+
+	movie_stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	movie_stream.write(config_blob.data(), config_blob.size());
+	movie_stream.write(annotations.data(), annotations.size());
+	movie_stream.write(reinterpret_cast<const char*>(digest_list.data()), digests_count * 8);
+	movie_stream.write(markers_blob.data(), markers_blob.size());
+	movie_stream.write(reinterpret_cast<const char*>(chunk_sizes.data()), chunk_sizes.size() * 8);
+
+	/* Pad up to the frame section */
+	std::vector<char> pad(header.frames_offset - (header.chunks_offset + header.chunks_count * 8), 0);
+	movie_stream.write(pad.data(), pad.size());
+
+	movie_stream.write(reinterpret_cast<const char*>(frames), frames_size);
+	movie_stream.close();
+
+	if (!movie_stream) {
+		unlink(tmpfile.c_str());
 		return EBADARCHIVE;
+	}
+
+	/* Flush the file to disk before renaming it over the previous movie,
+	 * so the replacement is atomic even across a crash */
+	int fd = open(tmpfile.c_str(), O_WRONLY);
+	if (fd >= 0) {
+		fsync(fd);
+		::close(fd);
+	}
+	if (rename(tmpfile.c_str(), moviefile.c_str()) != 0) {
+		unlink(tmpfile.c_str());
+		return EBADARCHIVE;
+	}
+
+	/* A full save compacts the journal: everything is in the base section */
+	journal_path = moviefile;
+	journal_dirty_start = input_list.size();
+	journal_entry_count = 0;
+	journal_base_frames = input_list.size();
+	markers_modified = false;
+
+	return 0;
+}
+
+bool MovieFile::canAppendTo(const std::string& moviefile)
+{
+	/* The journal belongs to a single moviefile */
+	if (moviefile.empty() || (moviefile != journal_path))
+		return false;
+
+	/* The journal only carries input edits, so a changed marker set needs
+	 * a full save */
+	if (markers_modified)
+		return false;
+
+	if (access(moviefile.c_str(), F_OK) != 0)
+		return false;
+
+	/* Compact with a full save when the journal would grow beyond a quarter
+	 * of the movie, which happens after early edits or many autosaves */
+	unsigned long pending = 0;
+	if (input_list.size() > journal_dirty_start)
+		pending = input_list.size() - journal_dirty_start;
+	if (journal_entry_count + pending > input_list.size() / 4)
+		return false;
+
+	return true;
+}
+
+int MovieFile::saveMovieIncremental(const std::string& moviefile)
+{
+	if (!canAppendTo(moviefile))
+		return saveMovie(moviefile);
+
+	int fd = open(moviefile.c_str(), O_RDWR);
+	if (fd < 0)
+		return saveMovie(moviefile);
+
+	/* Re-read the header of the file and check it matches the journal state,
+	 * in case the file was replaced behind our back */
+	BinaryMovieHeader header;
+	if ((pread(fd, &header, sizeof(header), 0) != sizeof(header)) ||
+		(memcmp(header.magic, BINARY_MOVIE_MAGIC, 4) != 0) ||
+		(header.version != BINARY_MOVIE_VERSION) ||
+		(header.journal_count != journal_entry_count) ||
+		(header.frames_raw_size != journal_base_frames * header.stride) ||
+		/* A changed movie setting changes the record stride */
+		(header.stride != frameStride(context->config.sc.keyboard_support,
+			context->config.sc.mouse_support, context->config.sc.nb_controllers))) {
+		::close(fd);
+		return saveMovie(moviefile);
+	}
+
+	bool keyboard = header.keyboard_support;
+	bool mouse = header.mouse_support;
+	int nb_controllers = header.nb_controllers;
+	size_t stride = header.stride;
+
+	/* Encode one journal entry per modified frame */
+	unsigned long pending = 0;
+	if (input_list.size() > journal_dirty_start)
+		pending = input_list.size() - journal_dirty_start;
+
+	std::vector<uint8_t> entries(pending * (8 + stride));
+	for (unsigned long e = 0; e < pending; e++) {
+		uint64_t frame = journal_dirty_start + e;
+		uint8_t* entry = entries.data() + e * (8 + stride);
+		memcpy(entry, &frame, 8);
+		encodeFrame(input_list[frame], keyboard, mouse, nb_controllers, entry + 8);
+	}
+
+	/* Append the entries first and update the header afterwards, so a save
+	 * interrupted in the middle leaves the previous consistent movie */
+	off_t entries_offset = header.journal_offset + header.journal_count * (8 + stride);
+	if (pwrite(fd, entries.data(), entries.size(), entries_offset) != static_cast<ssize_t>(entries.size())) {
+		::close(fd);
+		return saveMovie(moviefile);
+	}
+
+	/* Persist the entries before the header that references them, so the
+	 * ordering also holds across a crash */
+	fdatasync(fd);
+
+	header.framecount = input_list.size();
+	header.journal_count += pending;
+	header.content_hash = contentHash();
+	if (pwrite(fd, &header, sizeof(header), 0) != sizeof(header)) {
+		::close(fd);
+		return saveMovie(moviefile);
+	}
+
+	::close(fd);
+
+	journal_dirty_start = input_list.size();
+	journal_entry_count = header.journal_count;
 
 	return 0;
 }
@@ -377,6 +1134,128 @@ int MovieFile::writeFrame(std::ostream& input_stream, const AllInputs& inputs)
     return 1;
 }
 
+/* Helpers of the text importer: parse a number at the cursor, advancing it
+ * past the digits. The text format only ever writes plain lower-case hex
+ * and decimal, so these beat the locale-aware stream extractors of
+ * readFrame() by a wide margin. */
+static inline uint32_t scanHex(const char*& p)
+{
+    uint32_t v = 0;
+    for (;; p++) {
+        const char c = *p;
+        if ((c >= '0') && (c <= '9')) v = (v << 4) | (c - '0');
+        else if ((c >= 'a') && (c <= 'f')) v = (v << 4) | (c - 'a' + 10);
+        else if ((c >= 'A') && (c <= 'F')) v = (v << 4) | (c - 'A' + 10);
+        else return v;
+    }
+}
+
+static inline int scanInt(const char*& p)
+{
+    const bool neg = (*p == '-');
+    if (neg) p++;
+    int v = 0;
+    while ((*p >= '0') && (*p <= '9'))
+        v = v * 10 + (*p++ - '0');
+    return neg ? -v : v;
+}
+
+void MovieFile::parseInputsText(const std::string& input_file)
+{
+    /* Map the decompressed inputs file and parse it in one pass. Lines are
+     * split with memchr, which the C library vectorizes, and the fields
+     * are decoded with the scanners above. The per-frame istringstream of
+     * readFrame() dominates the load time of long text movies. */
+    int fd = open(input_file.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+
+    struct stat filestat;
+    if ((fstat(fd, &filestat) != 0) || (filestat.st_size == 0)) {
+        ::close(fd);
+        return;
+    }
+
+    const char* data = static_cast<const char*>(mmap(nullptr, filestat.st_size, PROT_READ, MAP_PRIVATE, fd, 0));
+    ::close(fd);
+    if (data == MAP_FAILED)
+        return;
+
+    const char* const end = data + filestat.st_size;
+
+    /* Reserve the frame store in one go. This scans the file twice, but
+     * counting newlines runs at memory speed */
+    size_t frames = 0;
+    for (const char* q = data; (q = static_cast<const char*>(memchr(q, '\n', end - q))); q++)
+        frames++;
+    input_list.reserve(input_list.size() + frames);
+
+    AllInputs ai;
+    const char* p = data;
+    while (p < end) {
+        const char* nl = static_cast<const char*>(memchr(p, '\n', end - p));
+        const char* const lineend = nl ? nl : end;
+
+        if ((p < lineend) && (*p == '|')) {
+            ai.emptyInputs();
+            const char* q = p;
+
+            /* Read keyboard inputs */
+            if (context->config.sc.keyboard_support) {
+                q++;
+                if ((q < lineend) && (*q != '|')) {
+                    for (int k=0; k<AllInputs::MAXKEYS; k++) {
+                        ai.keyboard[k] = scanHex(q);
+                        if ((q < lineend) && (*q == ':'))
+                            q++;
+                        else
+                            break;
+                    }
+                }
+            }
+
+            /* Read mouse inputs */
+            if (context->config.sc.mouse_support) {
+                q++;
+                ai.pointer_x = scanInt(q);
+                if (q < lineend) q++;
+                ai.pointer_y = scanInt(q);
+                if (q < lineend) q++;
+                for (int b=0; (b<5) && (q < lineend); b++, q++) {
+                    if (*q != '.')
+                        ai.pointer_mask |= (1 << (SingleInput::POINTER_B1 + b));
+                }
+            }
+
+            /* Read controller inputs */
+            for (int joy=0; joy<context->config.sc.nb_controllers; joy++) {
+                q++;
+                for (int axis=0; axis<AllInputs::MAXAXES; axis++) {
+                    ai.controller_axes[joy][axis] = scanInt(q);
+                    if (q < lineend) q++;
+                }
+                for (int b=0; (b<15) && (q < lineend); b++, q++) {
+                    if (*q != '.')
+                        ai.controller_buttons[joy] |= (1 << b);
+                }
+            }
+
+            /* Read restart input */
+            q++;
+            if ((q < lineend) && (*q == 'R'))
+                ai.restart = true;
+
+            input_list.push_back(ai);
+        }
+
+        if (!nl)
+            break;
+        p = nl + 1;
+    }
+
+    munmap(const_cast<char*>(data), filestat.st_size);
+}
+
 int MovieFile::readFrame(std::string& line, AllInputs& inputs)
 {
     inputs.emptyInputs();
@@ -468,8 +1347,9 @@ int MovieFile::setInputs(const AllInputs& inputs, unsigned long pos, bool keep_i
 {
     /* Check that we are writing to the next frame */
     if (pos == input_list.size()) {
+        recordEdit(pos, {}, {inputs});
         input_list.push_back(inputs);
-		wasModified();
+		wasModified(pos);
         return 0;
     }
     else if (pos < input_list.size()) {
@@ -478,13 +1358,15 @@ int MovieFile::setInputs(const AllInputs& inputs, unsigned long pos, bool keep_i
 		 * the end.
          */
 		if (keep_inputs) {
+			recordEdit(pos, {input_list[pos]}, {inputs});
 			input_list[pos] = inputs;
 		}
 		else {
+			recordEdit(pos, std::vector<AllInputs>(input_list.begin() + pos, input_list.end()), {inputs});
 	        input_list.resize(pos);
 	        input_list.push_back(inputs);
 		}
-		wasModified();
+		wasModified(pos);
         return 0;
     }
     else {
@@ -520,8 +1402,9 @@ void MovieFile::insertInputsBefore(const AllInputs& inputs, unsigned long pos)
 	if (pos > input_list.size())
 		return;
 
+	recordEdit(pos, {}, {inputs});
 	input_list.insert(input_list.begin() + pos, inputs);
-	wasModified();
+	wasModified(pos);
 }
 
 void MovieFile::deleteInputs(unsigned long pos)
@@ -529,14 +1412,17 @@ void MovieFile::deleteInputs(unsigned long pos)
 	if (pos >= input_list.size())
 		return;
 
+	recordEdit(pos, {input_list[pos]}, {});
 	input_list.erase(input_list.begin() + pos);
-	wasModified();
+	wasModified(pos);
 }
 
 void MovieFile::truncateInputs(unsigned long size)
 {
+	if (size < input_list.size())
+		recordEdit(size, std::vector<AllInputs>(input_list.begin() + size, input_list.end()), {});
 	input_list.resize(size);
-	wasModified();
+	wasModified(size);
 }
 
 void MovieFile::setLockedInputs(AllInputs& inputs)
@@ -552,10 +1438,262 @@ void MovieFile::setLockedInputs(AllInputs& inputs)
 	}
 }
 
+void MovieFile::beginEditGroup()
+{
+	edit_group_depth++;
+}
+
+void MovieFile::endEditGroup()
+{
+	if (--edit_group_depth > 0)
+		return;
+	edit_group_depth = 0;
+
+	if (current_group.empty())
+		return;
+
+	undo_stack.push_back(std::move(current_group));
+	current_group.clear();
+
+	/* A new edit invalidates the redone future */
+	redo_stack.clear();
+
+	/* Cap the history length */
+	if (undo_stack.size() > 256)
+		undo_stack.erase(undo_stack.begin());
+}
+
+void MovieFile::countFrame(const AllInputs& inputs, int dir)
+{
+	std::set<SingleInput> frame_inputs;
+	inputs.extractInputs(frame_inputs);
+	for (const SingleInput& si : frame_inputs) {
+		if (dir > 0) {
+			input_counts[si]++;
+		}
+		else {
+			auto it = input_counts.find(si);
+			if ((it != input_counts.end()) && (--it->second == 0))
+				input_counts.erase(it);
+		}
+	}
+}
+
+void MovieFile::rebuildInputCounts()
+{
+	input_counts.clear();
+	for (const AllInputs& ai : input_list)
+		countFrame(ai, 1);
+
+	/* The whole input list changed, every chunk hash is stale */
+	chunk_hashes.clear();
+	dirty_chunks.clear();
+}
+
+uint64_t MovieFile::hashFrame(const AllInputs& inputs)
+{
+	/* FNV-1a over the frame fields, field by field so that struct padding
+	 * does not leak into the hash */
+	uint64_t h = UINT64_C(14695981039346656037);
+	auto mix = [&h] (uint64_t v) {
+		h = (h ^ v) * UINT64_C(1099511628211);
+	};
+
+	for (uint32_t ks : inputs.keyboard)
+		mix(ks);
+	mix(static_cast<uint32_t>(inputs.pointer_x));
+	mix(static_cast<uint32_t>(inputs.pointer_y));
+	mix(inputs.pointer_mask);
+	for (int joy=0; joy<AllInputs::MAXJOYS; joy++) {
+		for (int axis=0; axis<AllInputs::MAXAXES; axis++)
+			mix(static_cast<uint16_t>(inputs.controller_axes[joy][axis]));
+		mix(inputs.controller_buttons[joy]);
+	}
+	mix(inputs.restart ? 1 : 0);
+
+	return h;
+}
+
+void MovieFile::dirtyHashRange(unsigned long pos, size_t before_len, size_t after_len)
+{
+	unsigned long first = pos / HASH_CHUNK_FRAMES;
+
+	if (before_len == after_len) {
+		/* In-place replacement, only the covered chunks change */
+		unsigned long last = before_len ? (pos + before_len - 1) / HASH_CHUNK_FRAMES : first;
+		for (unsigned long c = first; c <= last; c++)
+			dirty_chunks.insert(c);
+	}
+	else {
+		/* The frames after the splice shifted, drop every chunk from the
+		 * first touched one. Missing chunks are recomputed lazily. */
+		if (chunk_hashes.size() > first)
+			chunk_hashes.resize(first);
+		dirty_chunks.erase(dirty_chunks.lower_bound(first), dirty_chunks.end());
+	}
+}
+
+uint64_t MovieFile::contentHash()
+{
+	unsigned long nb_chunks = (input_list.size() + HASH_CHUNK_FRAMES - 1) / HASH_CHUNK_FRAMES;
+
+	/* Recompute the dirty chunks, and the ones beyond the end of the vector */
+	if (chunk_hashes.size() > nb_chunks)
+		chunk_hashes.resize(nb_chunks);
+	unsigned long first_missing = chunk_hashes.size();
+	chunk_hashes.resize(nb_chunks);
+
+	for (unsigned long c = 0; c < nb_chunks; c++) {
+		if ((c < first_missing) && !dirty_chunks.count(c))
+			continue;
+
+		uint64_t h = UINT64_C(14695981039346656037);
+		unsigned long end = std::min(input_list.size(), static_cast<size_t>((c + 1) * HASH_CHUNK_FRAMES));
+		for (unsigned long f = c * HASH_CHUNK_FRAMES; f < end; f++)
+			h = (h ^ hashFrame(input_list[f])) * UINT64_C(1099511628211);
+		chunk_hashes[c] = h;
+	}
+	dirty_chunks.clear();
+
+	/* Combine the chunk hashes and the movie length */
+	uint64_t h = UINT64_C(14695981039346656037);
+	for (uint64_t ch : chunk_hashes)
+		h = (h ^ ch) * UINT64_C(1099511628211);
+	h = (h ^ input_list.size()) * UINT64_C(1099511628211);
+	return h;
+}
+
+void MovieFile::recordEdit(unsigned long pos, std::vector<AllInputs> before, std::vector<AllInputs> after)
+{
+	/* Every mutation of the input list goes through here, so the counts and
+	 * the chunk hashes are kept in sync even when no edit group is open */
+	for (const AllInputs& ai : before)
+		countFrame(ai, -1);
+	for (const AllInputs& ai : after)
+		countFrame(ai, 1);
+	dirtyHashRange(pos, before.size(), after.size());
+
+	if (edit_group_depth <= 0)
+		return;
+
+	InputEdit edit;
+	edit.pos = pos;
+	edit.before = std::move(before);
+	edit.after = std::move(after);
+	current_group.push_back(std::move(edit));
+}
+
+bool MovieFile::canUndo() const
+{
+	return !undo_stack.empty();
+}
+
+bool MovieFile::canRedo() const
+{
+	return !redo_stack.empty();
+}
+
+unsigned long MovieFile::firstEditFrame(const std::vector<InputEdit>& group)
+{
+	unsigned long first = group[0].pos;
+	for (const auto& edit : group) {
+		if (edit.pos < first)
+			first = edit.pos;
+	}
+	return first;
+}
+
+unsigned long MovieFile::undoFrame() const
+{
+	return firstEditFrame(undo_stack.back());
+}
+
+unsigned long MovieFile::redoFrame() const
+{
+	return firstEditFrame(redo_stack.back());
+}
+
+bool MovieFile::undo()
+{
+	if (undo_stack.empty())
+		return false;
+
+	std::vector<InputEdit>& group = undo_stack.back();
+
+	/* Apply the inverse of each splice, in reverse order */
+	for (auto it = group.rbegin(); it != group.rend(); it++) {
+		input_list.erase(input_list.begin() + it->pos, input_list.begin() + it->pos + it->after.size());
+		input_list.insert(input_list.begin() + it->pos, it->before.begin(), it->before.end());
+		for (const AllInputs& ai : it->after)
+			countFrame(ai, -1);
+		for (const AllInputs& ai : it->before)
+			countFrame(ai, 1);
+		dirtyHashRange(it->pos, it->after.size(), it->before.size());
+	}
+
+	wasModified(firstEditFrame(group));
+
+	redo_stack.push_back(std::move(group));
+	undo_stack.pop_back();
+	return true;
+}
+
+bool MovieFile::redo()
+{
+	if (redo_stack.empty())
+		return false;
+
+	std::vector<InputEdit>& group = redo_stack.back();
+
+	/* Apply each splice again, in order */
+	for (const auto& edit : group) {
+		input_list.erase(input_list.begin() + edit.pos, input_list.begin() + edit.pos + edit.before.size());
+		input_list.insert(input_list.begin() + edit.pos, edit.after.begin(), edit.after.end());
+		for (const AllInputs& ai : edit.before)
+			countFrame(ai, -1);
+		for (const AllInputs& ai : edit.after)
+			countFrame(ai, 1);
+		dirtyHashRange(edit.pos, edit.before.size(), edit.after.size());
+	}
+
+	wasModified(firstEditFrame(group));
+
+	undo_stack.push_back(std::move(group));
+	redo_stack.pop_back();
+	return true;
+}
+
+void MovieFile::setMarker(unsigned long frame, const std::string& text)
+{
+	if (text.empty()) {
+		if (!markers.erase(frame))
+			return;
+	}
+	else {
+		auto it = markers.find(frame);
+		if ((it != markers.end()) && (it->second == text))
+			return;
+		markers[frame] = text;
+	}
+
+	markers_modified = true;
+	modifiedSinceLastSave = true;
+	modifiedSinceLastAutoSave = true;
+}
+
 void MovieFile::close()
 {
 	input_list.clear();
+	input_counts.clear();
+	chunk_hashes.clear();
+	dirty_chunks.clear();
 	locked_inputs.clear();
+	markers.clear();
+	markers_modified = false;
+	undo_stack.clear();
+	redo_stack.clear();
+	current_group.clear();
+	edit_group_depth = 0;
 }
 
 bool MovieFile::isPrefix(const MovieFile& movie, unsigned int frame)
@@ -574,9 +1712,22 @@ bool MovieFile::isPrefix(const MovieFile& movie)
 	return isPrefix(movie, fc);
 }
 
-void MovieFile::wasModified()
+void MovieFile::wasModified(unsigned long first_frame)
 {
 	modifiedSinceLastSave = true;
 	modifiedSinceLastAutoSave = true;
 	modifiedSinceLastStateLoad = true;
+
+	/* Lower the journal watermark, so an incremental save appends every
+	 * frame from the first modified one */
+	if (first_frame < journal_dirty_start)
+		journal_dirty_start = first_frame;
+
+	/* Tell the game loop that the greenzone states past the edit are stale */
+	if (context) {
+		if (!context->greenzone_invalid || (first_frame < context->greenzone_invalid_frame)) {
+			context->greenzone_invalid = true;
+			context->greenzone_invalid_frame = first_frame;
+		}
+	}
 }
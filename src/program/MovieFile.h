@@ -29,6 +29,7 @@
 #include <vector>
 #include <set>
 #include <map>
+#include <cstdint>
 
 class MovieFile {
 public:
@@ -43,17 +44,52 @@ public:
     /* Error string associated with an error code */
     static const char* errorString(int error_code);
 
+    /* Check if a moviefile uses the binary format, based on its magic bytes */
+    static bool isBinaryMovie(const std::string& moviefile);
+
     /* The list of inputs. We need this to be public because a movie may
      * check if another movie is a prefix
      */
     std::vector<AllInputs> input_list;
 
+    /* Sampled state digest of each frame boundary, recorded when the game
+     * runs with state digests enabled. The digest of frame N is stored at
+     * index N-1, next to the inputs that produced it. A zero entry means no
+     * digest was recorded for that frame. Only a full save writes them into
+     * the moviefile; incremental journal saves leave the stored list behind
+     * the input list. */
+    std::vector<uint64_t> digest_list;
+
+    /* Text markers placed on frames from the input editor, keyed by frame
+     * number. The map is ordered, so the editor can query the markers of a
+     * visible row range with lower_bound instead of scanning all of them.
+     * Only a full save writes them into the moviefile, so changing a marker
+     * disables journal appending until the next save. */
+    std::map<unsigned long, std::string> markers;
+
     /* List of locked single inputs. They won't be modified even in recording mode */
     std::set<SingleInput> locked_inputs;
 
     /* List of non-default input names */
     std::map<SingleInput, std::string> input_names;
 
+    /* Number of frames where each input is pressed, maintained by the edit
+     * splices so the input editor can rebuild its column set from the map
+     * keys instead of scanning the whole movie. Inputs whose count drops to
+     * zero are erased. */
+    std::map<SingleInput, unsigned long> input_counts;
+
+    /* Recount the pressed inputs of the whole movie, after the input list
+     * was reloaded from a file */
+    void rebuildInputCounts();
+
+    /* Merkle-style hash of the movie inputs: frames are hashed in fixed
+     * chunks and the chunk hashes are combined, with stale chunks recomputed
+     * lazily, so the cost after an edit is proportional to the chunks it
+     * touched. Written into the binary movie header on save and checked on
+     * load. */
+    uint64_t contentHash();
+
     /* Flag storing if the movie has been modified since last save.
      * Used for prompting a message when the game exits if the user wants
      * to save.
@@ -70,7 +106,12 @@ public:
     /* Annotations to be saved inside the movie file */
     std::string annotations;
 
-    MovieFile() {};
+    /* Counter incremented each time the input list is reloaded from a file.
+     * The input editor uses it to know when its column set must be rebuilt,
+     * instead of rescanning the whole movie at every state load. */
+    unsigned long input_load_count;
+
+    MovieFile() : context(nullptr), edit_group_depth(0) {};
 
     /* Prepare a movie file from the context */
     MovieFile(Context* c);
@@ -89,6 +130,15 @@ public:
      * Returns 0 if no error, or a negative value if an error occured */
     int loadInputs(const std::string& moviefile);
 
+    /* Read a range of frames from a binary moviefile without loading it,
+     * using the seek index to decompress only the chunks covering the
+     * range, so tools can random-access a frame range of a million-frame
+     * movie without decompressing it from the start. The journal entries
+     * falling inside the range are applied. Frames beyond the movie length
+     * are not returned. Returns 0 if no error, or a negative value */
+    static int loadInputsRange(const std::string& moviefile, uint64_t start,
+        uint64_t count, std::vector<AllInputs>& inputs);
+
     /* Write the inputs into a file and compress to the whole moviefile */
     int saveMovie();
     int saveMovie(const std::string& moviefile);
@@ -96,6 +146,15 @@ public:
     /* Write only the n first frames of input into the movie file. Used for savestate movies */
     int saveMovie(const std::string& moviefile, unsigned long frame_nb);
 
+    /* Check if the frames modified since the last save can be appended to
+     * the journal of this moviefile, instead of rewriting it entirely */
+    bool canAppendTo(const std::string& moviefile);
+
+    /* Append the modified frames to the journal of the moviefile, or fall
+     * back to a full save when appending is not possible.
+     * Returns 0 if no error, or a negative value if an error occured */
+    int saveMovieIncremental(const std::string& moviefile);
+
     /* Get the number of frames of the current movie */
     unsigned long nbFrames();
 
@@ -126,8 +185,36 @@ public:
     /* Copy locked inputs from the current inputs to the inputs in argument */
     void setLockedInputs(AllInputs& inputs);
 
-    /* Helper function called when the movie has been modified */
-    void wasModified();
+    /* Set or replace the marker text of a frame, removing the marker when
+     * the text is empty */
+    void setMarker(unsigned long frame, const std::string& text);
+
+    /* Helper function called when the movie has been modified. The frame
+     * parameter is the first frame affected by the edit, so that an
+     * incremental save only appends the frames from that point on. */
+    void wasModified(unsigned long first_frame = 0);
+
+    /* Undo history. Mutations of the input list are only recorded while an
+     * edit group is open, so frames written during recording don't fill the
+     * history. All mutations between beginEditGroup() and endEditGroup()
+     * form one undo step, and each step only stores the frames it touched,
+     * so the memory cost is proportional to the size of the edit, not to
+     * the length of the movie. Groups can be nested. */
+    void beginEditGroup();
+    void endEditGroup();
+
+    /* Check if there is a step to undo/redo */
+    bool canUndo() const;
+    bool canRedo() const;
+
+    /* First frame that would be affected by an undo/redo, so the caller can
+     * refuse to rewrite frames that were already played */
+    unsigned long undoFrame() const;
+    unsigned long redoFrame() const;
+
+    /* Apply one undo/redo step. Returns false if the history is empty */
+    bool undo();
+    bool redo();
 
     /* Close the moviefile */
     void close();
@@ -148,6 +235,80 @@ public:
 private:
     Context* context;
 
+    /* Parse a whole text-format inputs file into the input list. Does the
+     * same job as calling readFrame() on every line, but maps the file and
+     * splits lines and fields with memchr and hand-rolled number scanning,
+     * so legacy movies with millions of frames import in a fraction of a
+     * second instead of minutes */
+    void parseInputsText(const std::string& input_file);
+
+    /* Map a binary moviefile, validate its header, write the config and
+     * annotations files into the temp directory and decode the frame records
+     * into the input list.
+     * Returns 0 if no error, or a negative value if an error occured */
+    int extractBinaryMovie(const std::string& moviefile);
+
+    /* Write the whole moviefile in the binary format, embedding the config
+     * file that was just saved into the temp directory.
+     * Returns 0 if no error, or a negative value if an error occured */
+    int saveBinaryMovie(const std::string& moviefile);
+
+    /* One recorded mutation of the input list, as a splice: the frames in
+     * `before` at position `pos` were replaced by the frames in `after`.
+     * Replacing an empty range is an insertion, replacing by an empty range
+     * is a deletion, so every mutation fits this single form. */
+    struct InputEdit {
+        unsigned long pos;
+        std::vector<AllInputs> before;
+        std::vector<AllInputs> after;
+    };
+
+    /* Record a mutation into the open edit group, if any, and keep the
+     * per-input counts in sync with the splice */
+    void recordEdit(unsigned long pos, std::vector<AllInputs> before, std::vector<AllInputs> after);
+
+    /* Add `dir` to the count of every input pressed in the frame */
+    void countFrame(const AllInputs& inputs, int dir);
+
+    /* Hash one frame of inputs */
+    static uint64_t hashFrame(const AllInputs& inputs);
+
+    /* Invalidate the chunk hashes covering a splice of the input list */
+    void dirtyHashRange(unsigned long pos, size_t before_len, size_t after_len);
+
+    /* Frames per hash chunk */
+    static const unsigned long HASH_CHUNK_FRAMES = 512;
+
+    /* Per-chunk hashes of the input list. A chunk listed in dirty_chunks or
+     * beyond the end of the vector is stale and recomputed by contentHash() */
+    std::vector<uint64_t> chunk_hashes;
+    std::set<unsigned long> dirty_chunks;
+
+    /* First frame touched by a group of edits */
+    static unsigned long firstEditFrame(const std::vector<InputEdit>& group);
+
+    /* Undo/redo stacks of edit groups */
+    std::vector<std::vector<InputEdit>> undo_stack;
+    std::vector<std::vector<InputEdit>> redo_stack;
+
+    /* Edits recorded since the outermost beginEditGroup() */
+    std::vector<InputEdit> current_group;
+
+    /* Nesting depth of the open edit groups */
+    int edit_group_depth;
+
+    /* Journal state of the last saved binary moviefile: which file the
+     * journal belongs to, the first frame not persisted in it yet, and how
+     * many entries were already appended after its base frame section */
+    std::string journal_path;
+    unsigned long journal_dirty_start;
+    unsigned long journal_entry_count;
+    unsigned long journal_base_frames;
+
+    /* Flag storing if the markers changed since the last full save. The
+     * journal only carries input edits, so this forces a full save. */
+    bool markers_modified;
+
 };
 
 #endif
@@ -0,0 +1,279 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Headless movie replay, without the Qt interface. This main drives the same
+ * Context/Config/MovieFile/GameLoop logic as the GUI, but links only QtCore
+ * (for the settings files), creates no window and starts the game at once,
+ * so a farm box can pack one instance per verification job. An X server is
+ * still required by the game itself and for the keyboard layout.
+ */
+
+#include "GameLoop.h"
+#include "Context.h"
+#include "utils.h" // create_dir
+
+#include <QLocale>
+#include <limits.h> // PATH_MAX
+#include <libgen.h> // dirname
+#include <xcb/xcb.h>
+#include <unistd.h>
+#include <string.h>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <fcntl.h>
+#include <getopt.h>
+
+static Context context;
+
+static void print_usage(void)
+{
+    std::cout << "Usage: libTAS-cli [options] -r MOVIE game_executable_relative_path [game_cmdline_arguments]" << std::endl;
+    std::cout << "Replay MOVIE unattended without rendering and exit when it ends," << std::endl;
+    std::cout << "printing the reached frame and game time (see libTAS --verify)." << std::endl;
+    std::cout << "Options are:" << std::endl;
+    std::cout << "  -r, --read MOVIE    Play game inputs from MOVIE file" << std::endl;
+    std::cout << "  -i, --instance ID   Suffix the socket with ID, so that multiple instances" << std::endl;
+    std::cout << "                      can run concurrently" << std::endl;
+    std::cout << "  -s, --states DIR    Read and write savestates in DIR instead of the default" << std::endl;
+    std::cout << "                      data directory, e.g. a shared directory holding the" << std::endl;
+    std::cout << "                      segment states of a distributed verification run" << std::endl;
+    std::cout << "  -l, --load SLOT     Load the state in the given slot (1-9) at startup, to" << std::endl;
+    std::cout << "                      start verifying from a segment boundary instead of" << std::endl;
+    std::cout << "                      replaying the movie from the beginning" << std::endl;
+    std::cout << "  -h, --help          Show this message" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    qRegisterMetaTypeStreamOperators<HotKey>("HotKey");
+    qRegisterMetaTypeStreamOperators<SingleInput>("SingleInput");
+
+    /* Parsing arguments */
+    int c;
+    char buf[PATH_MAX];
+    char* abspath;
+    std::ofstream o;
+    std::string moviefile;
+    std::string statesdir;
+    int load_slot = 0;
+
+    static struct option long_options[] =
+    {
+        {"read", required_argument, nullptr, 'r'},
+        {"instance", required_argument, nullptr, 'i'},
+        {"states", required_argument, nullptr, 's'},
+        {"load", required_argument, nullptr, 'l'},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0}
+    };
+    int option_index = 0;
+
+    while ((c = getopt_long (argc, argv, "+r:i:s:l:h", long_options, &option_index)) != -1) {
+        switch (c) {
+            case 'r':
+                /* Playback movie file */
+                o.open(optarg, std::ofstream::app);
+                o.close();
+
+                abspath = realpath(optarg, buf);
+                if (abspath) {
+                    moviefile = abspath;
+                    context.config.sc.recording = SharedConfig::RECORDING_READ;
+                }
+                break;
+            case 'i':
+                /* Use a per-instance socket and shared memory ring (see
+                 * socketPath() in sockethelpers.cpp) */
+                setenv("LIBTAS_INSTANCE", optarg, 1);
+                break;
+            case 's':
+                /* Savestate directory, applied after the config is loaded */
+                abspath = realpath(optarg, buf);
+                if (abspath) {
+                    statesdir = abspath;
+                }
+                else {
+                    std::cerr << "Cannot access states directory " << optarg << std::endl;
+                    return -1;
+                }
+                break;
+            case 'l':
+                load_slot = std::stoi(optarg);
+                if ((load_slot < 1) || (load_slot > 9)) {
+                    std::cerr << "The state slot to load must be between 1 and 9" << std::endl;
+                    return -1;
+                }
+                break;
+            case '?':
+                std::cout << "Unknown option character" << std::endl;
+                break;
+            case 'h':
+                print_usage();
+                return 0;
+            default:
+                return -1;
+        }
+    }
+
+    if (moviefile.empty()) {
+        std::cout << "A movie to play must be given with -r" << std::endl;
+        return -1;
+    }
+
+    if (optind >= argc) {
+        print_usage();
+        return -1;
+    }
+
+    /* Game path */
+    abspath = realpath(argv[optind], buf);
+    if (abspath) {
+        context.gamepath = abspath;
+    }
+
+    /* Game arguments */
+    for (int i = optind+1; i < argc; i++) {
+        context.config.gameargs += argv[i];
+        context.config.gameargs += " ";
+    }
+
+    /* Open connection with the server. The game needs it anyway, and the
+     * keyboard layout is queried through it. */
+    context.conn = xcb_connect(NULL,NULL);
+    if (xcb_connection_has_error(context.conn))
+    {
+        std::cerr << "Cannot open display" << std::endl;
+        return -1;
+    }
+
+    context.config.km.init(context.conn);
+
+    /* libTAS.so path */
+    ssize_t count = readlink( "/proc/self/exe", buf, PATH_MAX );
+    std::string binpath = std::string( buf, (count > 0) ? count : 0 );
+    char* binpathptr = const_cast<char*>(binpath.c_str());
+    context.libtaspath = dirname(binpathptr);
+    context.libtaspath += "/libtas.so";
+
+    /* Create the working directories */
+    char *path = getenv("XDG_CONFIG_HOME");
+    if (path) {
+        context.config.configdir = path;
+    }
+    else {
+        context.config.configdir = getenv("HOME");
+        context.config.configdir += "/.config";
+    }
+    context.config.configdir += "/libTAS";
+    if (create_dir(context.config.configdir) < 0) {
+        std::cerr << "Cannot create dir " << context.config.configdir << std::endl;
+        return -1;
+    }
+
+    /* Now that we have the config dir, we load the game-specific config */
+    context.config.load(context.gamepath);
+
+    context.config.moviefile = moviefile;
+
+    std::string data_dir;
+    path = getenv("XDG_DATA_HOME");
+    if (path) {
+        data_dir = path;
+    }
+    else {
+        data_dir = getenv("HOME");
+        data_dir += "/.local/share";
+    }
+    data_dir += "/libTAS";
+
+    if (create_dir(data_dir) < 0) {
+        std::cerr << "Cannot create dir " << data_dir << std::endl;
+        return -1;
+    }
+
+    if (context.config.steamuserdir.empty()) {
+        context.config.steamuserdir = data_dir + "/steam";
+    }
+    if (create_dir(context.config.steamuserdir) < 0) {
+        std::cerr << "Cannot create dir " << context.config.steamuserdir << std::endl;
+        return -1;
+    }
+
+    if (context.config.tempmoviedir.empty()) {
+        context.config.tempmoviedir = data_dir + "/movie";
+    }
+    if (create_dir(context.config.tempmoviedir) < 0) {
+        std::cerr << "Cannot create dir " << context.config.tempmoviedir << std::endl;
+        return -1;
+    }
+
+    if (!statesdir.empty()) {
+        context.config.savestatedir = statesdir;
+    }
+    if (context.config.savestatedir.empty()) {
+        context.config.savestatedir = data_dir + "/states";
+    }
+    if (create_dir(context.config.savestatedir) < 0) {
+        std::cerr << "Cannot create dir " << context.config.savestatedir << std::endl;
+        return -1;
+    }
+
+    /* Check if incremental savestates is supported by checking the soft-dirty bit */
+    int fd = open("/proc/self/pagemap", O_RDONLY);
+    if (fd != -1) {
+        lseek(fd, static_cast<off_t>((reinterpret_cast<uintptr_t>(&context)/4096)*8), SEEK_SET);
+
+        uint64_t page;
+        int ret = ::read(fd, &page, 8);
+        if (ret != -1) {
+            context.is_soft_dirty = page & (0x1ull << 55);
+        }
+        close(fd);
+    }
+
+    QLocale::setDefault(QLocale("C"));
+    std::locale::global(std::locale::classic());
+
+    /* The loaded config may carry interactive settings; force the
+     * verification profile */
+    context.config.dumping = false;
+    context.config.verifying = true;
+    context.config.sc.recording = SharedConfig::RECORDING_READ;
+    context.config.sc.running = true;
+    context.config.sc.fastforward = true;
+    context.config.sc.av_dumping = false;
+
+    /* Run the game loop on this thread. In verification mode it exits the
+     * process when the movie ends or the game dies; a plain return means
+     * the connection to the game was lost. */
+    /* Queue the startup state load, processed at the first frame boundary.
+     * The state and its movie must have been placed in the states directory
+     * beforehand, and the movie must be a prefix of the replayed one. */
+    if (load_slot > 0) {
+        context.hotkey_queue.push(static_cast<HotKeyType>(HOTKEY_LOADSTATE1 + (load_slot - 1)));
+    }
+
+    context.status = Context::STARTING;
+    GameLoop gameLoop(&context);
+    gameLoop.start();
+
+    std::cerr << "verification: lost the game before the movie end" << std::endl;
+    return 3;
+}
@@ -38,10 +38,9 @@
 #include <iostream>
 #include <fcntl.h>
 #include <getopt.h>
+#include <stdio.h> // sscanf
 
 
-#define SOCKET_FILENAME "/tmp/libTAS.socket"
-
 // std::vector<std::string> shared_libs;
 Context context;
 
@@ -50,7 +49,23 @@ static void print_usage(void)
     std::cout << "Usage: libTAS [options] game_executable_relative_path [game_cmdline_arguments]" << std::endl;
     std::cout << "Options are:" << std::endl;
     std::cout << "  -d, --dump FILE     Start a audio/video encode into the specified FILE" << std::endl;
+    std::cout << "      --dump-range FIRST:LAST" << std::endl;
+    std::cout << "                      Only encode movie frames [FIRST,LAST). Together with" << std::endl;
+    std::cout << "                      --instance, several dumps of the same movie can run in" << std::endl;
+    std::cout << "                      parallel, each encoding its own slice" << std::endl;
+    std::cout << "  -i, --instance ID   Suffix the socket with ID, so that multiple libTAS" << std::endl;
+    std::cout << "                      instances can run concurrently" << std::endl;
     std::cout << "  -r, --read MOVIE    Play game inputs from MOVIE file" << std::endl;
+    std::cout << "      --verify        Together with -r, replay the movie unattended without" << std::endl;
+    std::cout << "                      rendering and exit when it ends, printing the reached" << std::endl;
+    std::cout << "                      frame and game time. The printed line is deterministic," << std::endl;
+    std::cout << "                      so runs of the same movie can be compared across machines" << std::endl;
+    std::cout << "      --bot SCRIPT    Run the input brute-forcing bot driven by SCRIPT: save a" << std::endl;
+    std::cout << "                      state at the script start frame, play a generated input" << std::endl;
+    std::cout << "                      sequence, read the watched memory value, restore the" << std::endl;
+    std::cout << "                      state and repeat, printing the best sequence at the end." << std::endl;
+    std::cout << "                      Together with --instance, several searches with distinct" << std::endl;
+    std::cout << "                      seeds can run in parallel" << std::endl;
     std::cout << "  -w, --write MOVIE   Record game inputs into the specified MOVIE file" << std::endl;
     std::cout << "  -h, --help          Show this message" << std::endl;
 }
@@ -76,13 +91,17 @@ int main(int argc, char **argv)
         {"read", required_argument, nullptr, 'r'},
         {"write", required_argument, nullptr, 'w'},
         {"dump", required_argument, nullptr, 'd'},
+        {"dump-range", required_argument, nullptr, 'R'},
+        {"verify", no_argument, nullptr, 'V'},
+        {"bot", required_argument, nullptr, 'B'},
+        {"instance", required_argument, nullptr, 'i'},
         {"help", no_argument, nullptr, 'h'},
         {nullptr, 0, nullptr, 0}
     };
     int option_index = 0;
 
     // std::string libname;
-    while ((c = getopt_long (argc, argv, "+r:w:d:h", long_options, &option_index)) != -1) {
+    while ((c = getopt_long (argc, argv, "+r:w:d:i:h", long_options, &option_index)) != -1) {
         switch (c) {
             case 'r':
             case 'w':
@@ -110,6 +129,36 @@ int main(int argc, char **argv)
                     context.config.dumping = true;
                 }
                 break;
+            case 'R':
+                /* Only dump the specified range of movie frames */
+                if (sscanf(optarg, "%lu:%lu", &context.config.dump_range_start,
+                        &context.config.dump_range_end) != 2) {
+                    std::cout << "Could not parse the dump range, expecting FIRST:LAST" << std::endl;
+                    return -1;
+                }
+                break;
+            case 'V':
+                /* Headless movie verification */
+                context.config.verifying = true;
+                break;
+            case 'B':
+                /* Input brute-forcing script */
+                abspath = realpath(optarg, buf);
+                if (abspath) {
+                    context.config.botfile = abspath;
+                }
+                else {
+                    std::cout << "Could not find the bot script " << optarg << std::endl;
+                    return -1;
+                }
+                break;
+            case 'i':
+                /* Use a per-instance socket and shared memory ring, so that
+                 * multiple libTAS instances can run concurrently. Exported
+                 * as an environment variable so that the game inherits it
+                 * (see socketPath() in sockethelpers.cpp). */
+                setenv("LIBTAS_INSTANCE", optarg, 1);
+                break;
             case '?':
                 std::cout << "Unknown option character" << std::endl;
                 break;
@@ -121,6 +170,16 @@ int main(int argc, char **argv)
         }
     }
 
+    if (context.config.verifying && (context.config.sc.recording != SharedConfig::RECORDING_READ)) {
+        std::cout << "--verify requires a movie to play with -r" << std::endl;
+        return -1;
+    }
+
+    if (!context.config.botfile.empty() && context.config.verifying) {
+        std::cout << "--bot and --verify cannot be combined" << std::endl;
+        return -1;
+    }
+
     /* Game path */
     abspath = realpath(argv[optind], buf);
     if (abspath) {
@@ -0,0 +1,202 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_COMPAREKERNELS_H_INCLUDED
+#define LIBTAS_COMPAREKERNELS_H_INCLUDED
+
+#include <cstdint>
+#include <cstddef>
+#include "CompareEnums.h"
+
+/* Vectorized comparison kernels for the ram search engine.
+ *
+ * compare_buffer() evaluates a comparison over a whole buffer of values and
+ * fills one discard byte per value, with the same semantics as
+ * RamWatch::check(): nonzero means the value must be dropped, and NaN/Inf
+ * values are always dropped. finite_buffer() only applies the NaN/Inf filter.
+ *
+ * The kernels are written with the compiler vector extensions, so one
+ * generic loop covers every scalar type. On x86 they are compiled twice,
+ * once for the baseline instruction set and once for AVX2, and the variant
+ * is picked at runtime; other architectures use the scalar loop.
+ */
+
+#if defined(__x86_64__) || defined(__i386__)
+#define RAMSEARCH_VECTOR_KERNELS
+#endif
+
+/* A finite value is one where value - value == 0: NaN and Inf both yield
+ * NaN, and the expression is trivially true for integer types. */
+
+template <class T>
+inline void compare_scalar(const T* values, const T* previous_values, size_t n, T compare_value, CompareOperator compare_operator, uint8_t* discard)
+{
+    for (size_t i = 0; i < n; i++) {
+        T value = values[i];
+        T compare = previous_values ? previous_values[i] : compare_value;
+        bool keep = ((value - value) == T(0));
+        switch (compare_operator) {
+            case CompareOperator::Equal:
+                keep = keep && (value == compare);
+                break;
+            case CompareOperator::NotEqual:
+                keep = keep && (value != compare);
+                break;
+            case CompareOperator::Less:
+                keep = keep && (value < compare);
+                break;
+            case CompareOperator::Greater:
+                keep = keep && (value > compare);
+                break;
+            case CompareOperator::LessEqual:
+                keep = keep && (value <= compare);
+                break;
+            case CompareOperator::GreaterEqual:
+                keep = keep && (value >= compare);
+                break;
+        }
+        discard[i] = keep ? 0 : 1;
+    }
+}
+
+template <class T>
+inline void finite_scalar(const T* values, size_t n, uint8_t* discard)
+{
+    for (size_t i = 0; i < n; i++) {
+        T value = values[i];
+        discard[i] = ((value - value) == T(0)) ? 0 : 1;
+    }
+}
+
+#ifdef RAMSEARCH_VECTOR_KERNELS
+
+/* Generic vector loop, instantiated for 16-byte (SSE) and 32-byte (AVX2)
+ * vectors. It must be inlined into the per-target wrappers below so that it
+ * is compiled with their instruction set. Loads go through memcpy because
+ * the buffers come from raw reads and are not necessarily aligned. */
+template <class T, int VECBYTES>
+__attribute__((always_inline))
+inline void compare_vec(const T* values, const T* previous_values, size_t n, T compare_value, CompareOperator compare_operator, uint8_t* discard)
+{
+    typedef T vec __attribute__((vector_size(VECBYTES)));
+    const int lanes = VECBYTES / sizeof(T);
+
+    size_t i = 0;
+    for (; i + lanes <= n; i += lanes) {
+        vec value;
+        __builtin_memcpy(&value, values + i, sizeof(vec));
+
+        vec compare;
+        if (previous_values)
+            __builtin_memcpy(&compare, previous_values + i, sizeof(vec));
+        else
+            compare = value - value + compare_value;
+
+        /* Comparisons on vectors yield integer lane masks (all ones when
+         * true), which are combined with the finite mask */
+        auto keep = ((value - value) == T(0));
+        switch (compare_operator) {
+            case CompareOperator::Equal:
+                keep &= (value == compare);
+                break;
+            case CompareOperator::NotEqual:
+                keep &= (value != compare);
+                break;
+            case CompareOperator::Less:
+                keep &= (value < compare);
+                break;
+            case CompareOperator::Greater:
+                keep &= (value > compare);
+                break;
+            case CompareOperator::LessEqual:
+                keep &= (value <= compare);
+                break;
+            case CompareOperator::GreaterEqual:
+                keep &= (value >= compare);
+                break;
+        }
+
+        for (int j = 0; j < lanes; j++)
+            discard[i+j] = keep[j] ? 0 : 1;
+    }
+
+    compare_scalar(values + i, previous_values ? previous_values + i : nullptr, n - i, compare_value, compare_operator, discard + i);
+}
+
+template <class T, int VECBYTES>
+__attribute__((always_inline))
+inline void finite_vec(const T* values, size_t n, uint8_t* discard)
+{
+    typedef T vec __attribute__((vector_size(VECBYTES)));
+    const int lanes = VECBYTES / sizeof(T);
+
+    size_t i = 0;
+    for (; i + lanes <= n; i += lanes) {
+        vec value;
+        __builtin_memcpy(&value, values + i, sizeof(vec));
+
+        auto keep = ((value - value) == T(0));
+        for (int j = 0; j < lanes; j++)
+            discard[i+j] = keep[j] ? 0 : 1;
+    }
+
+    finite_scalar(values + i, n - i, discard + i);
+}
+
+template <class T>
+__attribute__((target("avx2")))
+void compare_buffer_avx2(const T* values, const T* previous_values, size_t n, T compare_value, CompareOperator compare_operator, uint8_t* discard)
+{
+    compare_vec<T, 32>(values, previous_values, n, compare_value, compare_operator, discard);
+}
+
+template <class T>
+__attribute__((target("avx2")))
+void finite_buffer_avx2(const T* values, size_t n, uint8_t* discard)
+{
+    finite_vec<T, 32>(values, n, discard);
+}
+
+#endif
+
+template <class T>
+void compare_buffer(const T* values, const T* previous_values, size_t n, T compare_value, CompareOperator compare_operator, uint8_t* discard)
+{
+#ifdef RAMSEARCH_VECTOR_KERNELS
+    if (__builtin_cpu_supports("avx2"))
+        return compare_buffer_avx2(values, previous_values, n, compare_value, compare_operator, discard);
+    return compare_vec<T, 16>(values, previous_values, n, compare_value, compare_operator, discard);
+#else
+    compare_scalar(values, previous_values, n, compare_value, compare_operator, discard);
+#endif
+}
+
+template <class T>
+void finite_buffer(const T* values, size_t n, uint8_t* discard)
+{
+#ifdef RAMSEARCH_VECTOR_KERNELS
+    if (__builtin_cpu_supports("avx2"))
+        return finite_buffer_avx2(values, n, discard);
+    return finite_vec<T, 16>(values, n, discard);
+#else
+    finite_scalar(values, n, discard);
+#endif
+}
+
+#endif
@@ -19,5 +19,215 @@
 
 #include "IRamWatchDetailed.h"
 
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm> // std::upper_bound
+#include <cstdio>
+#include <cstring>
+
 bool IRamWatchDetailed::isValid;
 pid_t IRamWatchDetailed::game_pid;
+
+/* On-disk layout of a saved value history: this header, the frame column,
+ * then the value column, oldest sample first so that the frame column is
+ * strictly increasing */
+struct GhostHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t count;
+    uint32_t stride;
+    uint32_t padding;
+};
+
+static const uint32_t GHOST_MAGIC = 0x4847544C; /* "LTGH" */
+static const uint32_t GHOST_VERSION = 1;
+
+IRamWatchDetailed::~IRamWatchDetailed()
+{
+    record(false);
+    unload_ghost();
+}
+
+void IRamWatchDetailed::record(bool enable)
+{
+    if (enable == recording)
+        return;
+
+    if (enable) {
+        void* frames = mmap(nullptr, HISTORY_SAMPLES * sizeof(unsigned long),
+            PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        void* values = mmap(nullptr, HISTORY_SAMPLES * value_size(),
+            PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if ((frames == MAP_FAILED) || (values == MAP_FAILED)) {
+            if (frames != MAP_FAILED)
+                munmap(frames, HISTORY_SAMPLES * sizeof(unsigned long));
+            if (values != MAP_FAILED)
+                munmap(values, HISTORY_SAMPLES * value_size());
+            return;
+        }
+        history_frames = static_cast<unsigned long*>(frames);
+        history_values = static_cast<char*>(values);
+        history_stride = value_size();
+    }
+    else {
+        munmap(history_frames, HISTORY_SAMPLES * sizeof(unsigned long));
+        munmap(history_values, HISTORY_SAMPLES * history_stride);
+        history_frames = nullptr;
+        history_values = nullptr;
+        history_stride = 0;
+    }
+
+    history_head = 0;
+    history_count = 0;
+    recording = enable;
+}
+
+void IRamWatchDetailed::record_sample(unsigned long frame, const void* buf)
+{
+    if (!recording)
+        return;
+
+    /* Loading a state moved the game back in time: drop the samples that
+     * the replay is about to record again */
+    while (history_count &&
+           (history_frames[(history_head + history_count - 1) % HISTORY_SAMPLES] >= frame))
+        history_count--;
+
+    /* Full ring: recycle the oldest sample */
+    if (history_count == HISTORY_SAMPLES) {
+        history_head = (history_head + 1) % HISTORY_SAMPLES;
+        history_count--;
+    }
+
+    const size_t slot = (history_head + history_count) % HISTORY_SAMPLES;
+    history_frames[slot] = frame;
+    memcpy(history_values + slot * history_stride, buf, history_stride);
+    history_count++;
+}
+
+unsigned long IRamWatchDetailed::sample_frame(size_t i) const
+{
+    return history_frames[(history_head + i) % HISTORY_SAMPLES];
+}
+
+const void* IRamWatchDetailed::sample_value(size_t i) const
+{
+    return history_values + ((history_head + i) % HISTORY_SAMPLES) * history_stride;
+}
+
+bool IRamWatchDetailed::save_history(const std::string& path) const
+{
+    if (!history_count)
+        return false;
+
+    FILE* f = fopen(path.c_str(), "wb");
+    if (!f)
+        return false;
+
+    GhostHeader gh;
+    gh.magic = GHOST_MAGIC;
+    gh.version = GHOST_VERSION;
+    gh.count = history_count;
+    gh.stride = history_stride;
+    gh.padding = 0;
+    fwrite(&gh, sizeof(gh), 1, f);
+
+    /* The ring may wrap, write each column sample by sample */
+    for (size_t i = 0; i < history_count; i++) {
+        uint64_t frame = sample_frame(i);
+        fwrite(&frame, sizeof(frame), 1, f);
+    }
+    for (size_t i = 0; i < history_count; i++)
+        fwrite(sample_value(i), history_stride, 1, f);
+
+    bool ok = !ferror(f);
+    fclose(f);
+    return ok;
+}
+
+bool IRamWatchDetailed::load_ghost(const std::string& path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat filestat;
+    if (fstat(fd, &filestat) != 0) {
+        close(fd);
+        return false;
+    }
+
+    GhostHeader gh;
+    if (read(fd, &gh, sizeof(gh)) != sizeof(gh)) {
+        close(fd);
+        return false;
+    }
+
+    if ((gh.magic != GHOST_MAGIC) ||
+        (gh.version != GHOST_VERSION) ||
+        (gh.count == 0) ||
+        (gh.stride != value_size()) ||
+        (sizeof(gh) + gh.count * (sizeof(uint64_t) + gh.stride) >
+            static_cast<uint64_t>(filestat.st_size))) {
+        close(fd);
+        return false;
+    }
+
+    void* map = mmap(nullptr, filestat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return false;
+
+    unload_ghost();
+    ghost_map = map;
+    ghost_map_size = filestat.st_size;
+    ghost_frames = reinterpret_cast<const uint64_t*>(static_cast<char*>(map) + sizeof(GhostHeader));
+    ghost_values = static_cast<char*>(map) + sizeof(GhostHeader) + gh.count * sizeof(uint64_t);
+    ghost_count = gh.count;
+    ghost_stride = gh.stride;
+    ghost_cursor = 0;
+    return true;
+}
+
+void IRamWatchDetailed::unload_ghost()
+{
+    if (ghost_map)
+        munmap(ghost_map, ghost_map_size);
+    ghost_map = nullptr;
+    ghost_map_size = 0;
+    ghost_frames = nullptr;
+    ghost_values = nullptr;
+    ghost_count = 0;
+    ghost_stride = 0;
+    ghost_cursor = 0;
+}
+
+const void* IRamWatchDetailed::ghost_at(unsigned long frame)
+{
+    if (!ghost_count || (ghost_frames[0] > frame))
+        return nullptr;
+
+    /* Queries come frame by frame in order, so advancing the cursor is the
+     * common case. After a backward jump (state load, or the scaling pass
+     * of the graph), search the column again */
+    if (ghost_frames[ghost_cursor] > frame) {
+        const uint64_t* it = std::upper_bound(ghost_frames, ghost_frames + ghost_count, frame);
+        ghost_cursor = (it - ghost_frames) - 1;
+    }
+    while ((ghost_cursor + 1 < ghost_count) && (ghost_frames[ghost_cursor + 1] <= frame))
+        ghost_cursor++;
+
+    return ghost_values + ghost_cursor * ghost_stride;
+}
+
+bool IRamWatchDetailed::ghost_value(unsigned long frame, std::string& str)
+{
+    const void* buf = ghost_at(frame);
+    if (!buf)
+        return false;
+
+    str = format(buf);
+    return true;
+}
@@ -20,7 +20,7 @@
 #ifndef LIBTAS_IRAMWATCHDETAILED_H_INCLUDED
 #define LIBTAS_IRAMWATCHDETAILED_H_INCLUDED
 
-// #include <cstdint>
+#include <cstdint>
 // #include <sys/types.h>
 #include <string>
 #include <vector>
@@ -28,7 +28,7 @@
 class IRamWatchDetailed {
 public:
     IRamWatchDetailed(uintptr_t addr) : address(addr) {};
-    virtual ~IRamWatchDetailed() = default;
+    virtual ~IRamWatchDetailed();
 
     /* Return the current value of the ram watch as a string */
     virtual std::string value_str() = 0;
@@ -41,10 +41,84 @@ public:
     /* Returns the index of the stored type */
     virtual int type() = 0;
 
+    /* Update the cached value string from raw bytes gathered by the batched
+     * watch poller, flagging whether the displayed value changed */
+    virtual void update_value(const void* buf, bool valid) = 0;
+
+    /* Size in bytes of the watched value */
+    virtual size_t value_size() const = 0;
+
+    /* Convert raw value bytes into a double, for the history graph */
+    virtual double to_double(const void* buf) = 0;
+
+    /* Format raw value bytes the way value_str() does, for history and
+     * ghost samples */
+    virtual std::string format(const void* buf) = 0;
+
+    /* Enable or disable freezing: capture the current value, which the
+     * frozen watch poke list writes back at every frame boundary */
+    virtual void freeze(bool enable) = 0;
+
     uintptr_t address;
     std::string label;
     bool hex;
 
+    /* Value string cached by the batched watch poller */
+    std::string cached_str;
+    bool value_changed = false;
+
+    /* Raw bytes and validity of the previous poll, to skip re-formatting
+     * a value that did not change */
+    char prev_value[8];
+    bool prev_valid = false;
+    bool has_prev = false;
+
+    /* Raw bytes written back every frame while frozen */
+    bool frozen = false;
+    char frozen_value[8];
+
+    /* Value history: a columnar ring of samples appended by the batched
+     * watch poller while `recording` is set. Two parallel columns live in
+     * lazily-committed anonymous mappings: the frame of each sample, and
+     * its raw bytes at a fixed value_size() stride. The graph view reads
+     * the columns in place. */
+    bool recording = false;
+
+    /* Enable or disable the history recording, mapping or unmapping the
+     * columns. Disabling discards the recorded samples */
+    void record(bool enable);
+
+    /* Append one sample from the batch buffer of the poller. A sample at or
+     * before the last recorded frame truncates the newer tail first, so the
+     * frame column stays strictly increasing across state loads */
+    void record_sample(unsigned long frame, const void* buf);
+
+    /* Read accessors of the graph view, index 0 being the oldest sample */
+    size_t sample_count() const { return history_count; }
+    unsigned long sample_frame(size_t i) const;
+    const void* sample_value(size_t i) const;
+
+    /* Ghost run: the value history of a reference run, memory-mapped from
+     * a file written by save_history(). The columns are served by frame,
+     * for displaying the reference value next to the live one. */
+
+    /* Write the recorded history to a file, oldest sample first */
+    bool save_history(const std::string& path) const;
+
+    /* Map a saved history as the ghost of this watch. Fails when the file
+     * is not a history or its value size does not match the watch */
+    bool load_ghost(const std::string& path);
+    void unload_ghost();
+    bool has_ghost() const { return ghost_count != 0; }
+
+    /* Raw bytes of the ghost sample at or before a frame, or nullptr when
+     * the ghost run has no sample there yet. Successive queries advance a
+     * cursor, a query going back in time searches the column again */
+    const void* ghost_at(unsigned long frame);
+
+    /* Format the ghost sample at or before a frame, like value_str() */
+    bool ghost_value(unsigned long frame, std::string& str);
+
     bool isPointer;
     std::vector<int> pointer_offsets;
     uintptr_t base_address;
@@ -52,6 +126,34 @@ public:
     static pid_t game_pid;
     static bool isValid;
 
+private:
+    /* Maximum number of retained history samples. The columns are only
+     * faulted in as samples land, so the virtual size costs nothing
+     * upfront */
+    static const size_t HISTORY_SAMPLES = 1 << 20;
+
+    /* The two history columns */
+    unsigned long *history_frames = nullptr;
+    char *history_values = nullptr;
+
+    /* Stride of the value column, captured when the columns are mapped so
+     * the destructor does not need the (virtual) value size */
+    size_t history_stride = 0;
+
+    /* Ring index of the oldest sample, and number of valid samples */
+    size_t history_head = 0;
+    size_t history_count = 0;
+
+    /* Memory-mapped ghost columns, pointing into ghost_map */
+    const uint64_t* ghost_frames = nullptr;
+    const char* ghost_values = nullptr;
+    size_t ghost_count = 0;
+    size_t ghost_stride = 0;
+    void* ghost_map = nullptr;
+    size_t ghost_map_size = 0;
+
+    /* Index of the last served ghost sample */
+    size_t ghost_cursor = 0;
 };
 
 #endif
@@ -0,0 +1,86 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MemSectionCache.h"
+
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+const std::vector<MemSection>& MemSectionCache::sections(pid_t pid, uint64_t stamp)
+{
+    if (has_cache && (pid == cached_pid) && (stamp == cached_stamp))
+        return cached_sections;
+
+    refresh(pid);
+    cached_pid = pid;
+    cached_stamp = stamp;
+    has_cache = true;
+    return cached_sections;
+}
+
+void MemSectionCache::refresh(pid_t pid)
+{
+    /* Compose the filename for the /proc memory map, and open it. */
+    std::ostringstream oss;
+    oss << "/proc/" << pid << "/maps";
+    std::ifstream mapsfile(oss.str());
+    if (!mapsfile) {
+        std::cerr << "Could not open " << oss.str() << std::endl;
+        cached_lines.clear();
+        cached_sections.clear();
+        return;
+    }
+
+    std::vector<std::string> lines;
+    std::string line;
+    while (std::getline(mapsfile, line))
+        lines.push_back(line);
+
+    std::vector<MemSection> sections;
+    sections.reserve(lines.size());
+
+    /* Walk the old and new lines together: an unchanged line reuses its
+     * parsed section, a new one is parsed, and old lines skipped over are
+     * mappings that disappeared. The heap flag driving the classification
+     * is replayed from the reused sections, so a parse in the middle of
+     * the walk still sees the right state. */
+    MemSection::reset();
+    size_t j = 0;
+    for (std::string& l : lines) {
+        size_t k = j;
+        while ((k < cached_lines.size()) && (cached_lines[k] != l))
+            k++;
+
+        if (k < cached_lines.size()) {
+            sections.push_back(cached_sections[k]);
+            if (cached_sections[k].type == MemSection::MemHeap)
+                MemSection::heap_discovered = true;
+            j = k + 1;
+        }
+        else {
+            MemSection section;
+            section.readMap(l);
+            sections.push_back(section);
+        }
+    }
+
+    cached_lines = std::move(lines);
+    cached_sections = std::move(sections);
+}
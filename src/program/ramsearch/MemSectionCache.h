@@ -0,0 +1,58 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_MEMSECTIONCACHE_H_INCLUDED
+#define LIBTAS_MEMSECTIONCACHE_H_INCLUDED
+
+#include <sys/types.h>
+#include <string>
+#include <vector>
+
+#include "MemSection.h"
+
+/* Generation-cached store of the parsed memory sections of the game.
+ *
+ * Parsing /proc/pid/maps costs a string-stream run per line, which adds up
+ * on games with thousands of mappings, and the section types depend on the
+ * line order so they cannot be derived per line in isolation. The cache
+ * keeps the raw lines next to their parsed sections: a query with the stamp
+ * of the previous query returns the stored sections without touching /proc,
+ * and a refresh diffs the new lines against the stored ones so only the
+ * mappings that actually changed are re-parsed. */
+class MemSectionCache {
+public:
+    /* Sections of process `pid`. The stamp identifies the game state the
+     * caller is at (frame and rerecord count): when it matches the previous
+     * query, the stored sections are returned without touching /proc. */
+    const std::vector<MemSection>& sections(pid_t pid, uint64_t stamp);
+
+private:
+    /* Re-read the maps file and re-parse the changed lines */
+    void refresh(pid_t pid);
+
+    pid_t cached_pid = -1;
+    uint64_t cached_stamp = 0;
+    bool has_cache = false;
+
+    /* Raw maps lines kept for the diffing, aligned with the sections */
+    std::vector<std::string> cached_lines;
+    std::vector<MemSection> cached_sections;
+};
+
+#endif
@@ -0,0 +1,518 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_RAMSEARCH_H_INCLUDED
+#define LIBTAS_RAMSEARCH_H_INCLUDED
+
+#include <cstdint>
+#include "CompareEnums.h"
+#include "CompareKernels.h"
+#include "TypeIndex.h"
+#include "MemSection.h"
+#include "RamWatch.h" // fmt_from_type
+#include <cstring>
+#include <vector>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+/* Scan engine holding the candidate addresses of a ram search.
+ *
+ * The first scan takes a structure-of-arrays snapshot: candidate addresses
+ * are encoded as runs of consecutive addresses (an unknown-value scan over a
+ * section is a handful of runs, not tens of millions of pointers), and the
+ * values live in a flat typed arena indexed by snapshot position. Refinement
+ * scans never rewrite the snapshot: they clear bits in a survivor bitmap and
+ * update the surviving values in place. A rank index over the bitmap maps
+ * view rows to snapshot positions, so the Qt model only materializes the
+ * rows of the visible viewport.
+ *
+ * Game memory is read in large batches: the first scan reads each memory
+ * section in multi-megabyte chunks from one worker thread per core, and a
+ * refinement scan gathers the surviving addresses into iovec batches, so
+ * scanning costs a handful of syscalls per section instead of one per
+ * address.
+ */
+class IRamSearch {
+public:
+    virtual ~IRamSearch() = default;
+
+    /* Number of surviving candidate addresses */
+    virtual size_t size() const = 0;
+
+    /* Candidate address of a row */
+    virtual uintptr_t address(size_t row) const = 0;
+
+    /* Format the stored previous value of a row into a string */
+    virtual const char* previousToString(size_t row, bool hex) = 0;
+
+    /* Fetch the current value of a row and format it into a string */
+    virtual const char* currentToString(size_t row, bool hex) = 0;
+
+    /* Scan the given memory sections, already filtered by the caller,
+     * keeping the addresses that pass the comparison. The scan is
+     * distributed over one worker thread per core, and the progress
+     * callback is invoked from the workers with the number of scanned
+     * bytes. */
+    virtual void newSearch(pid_t pid, const std::vector<MemSection>& sections, CompareType compare_type, CompareOperator compare_operator, double compare_value_db, std::function<void(int)> progress) = 0;
+
+    /* Check all surviving candidates against the comparison, clearing the
+     * survivor bit of the ones that fail and storing the current value of
+     * the ones that pass. The progress callback is invoked regularly with
+     * the number of checked addresses. */
+    virtual void search(CompareType compare_type, CompareOperator compare_operator, double compare_value_db, std::function<void(int)> progress) = 0;
+
+    /* Ask a running scan to stop early, from another thread. The workers
+     * stop at the next work item or batch boundary, and the results
+     * gathered so far stay valid. */
+    virtual void cancel() = 0;
+
+    /* Returns the index of the stored type */
+    virtual int type() const = 0;
+};
+
+template <class T>
+class RamSearch : public IRamSearch {
+public:
+    size_t size() const
+    {
+        return survivor_count;
+    }
+
+    uintptr_t address(size_t row) const
+    {
+        return snapshotAddress(selectRow(row));
+    }
+
+    const char* previousToString(size_t row, bool hex)
+    {
+        static char str[30];
+        snprintf(str, 30, fmt_from_type<T>(hex), previous_values[selectRow(row)]);
+        return str;
+    }
+
+    const char* currentToString(size_t row, bool hex)
+    {
+        struct iovec local, remote;
+        T value = 0;
+        local.iov_base = static_cast<void*>(&value);
+        local.iov_len = sizeof(T);
+        remote.iov_base = reinterpret_cast<void*>(address(row));
+        remote.iov_len = sizeof(T);
+        process_vm_readv(game_pid, &local, 1, &remote, 1, 0);
+
+        static char str[30];
+        snprintf(str, 30, fmt_from_type<T>(hex), value);
+        return str;
+    }
+
+    void newSearch(pid_t pid, const std::vector<MemSection>& sections, CompareType compare_type, CompareOperator compare_operator, double compare_value_db, std::function<void(int)> progress)
+    {
+        game_pid = pid;
+        cancel_flag = false;
+        runs.clear();
+        previous_values.clear();
+        survivor_bits.clear();
+        survivor_ranks.clear();
+        snapshot_count = 0;
+        survivor_count = 0;
+
+        /* Split the sections into chunk-sized work items, so that one giant
+         * heap section is still shared between the workers */
+        struct WorkItem {
+            uintptr_t addr;
+            uintptr_t endaddr;
+        };
+        std::vector<WorkItem> items;
+
+        for (const MemSection& section : sections) {
+            for (uintptr_t addr = section.addr; addr < section.endaddr; addr += CHUNK_SIZE) {
+                WorkItem item;
+                item.addr = addr;
+                item.endaddr = (section.endaddr - addr > CHUNK_SIZE) ? (addr + CHUNK_SIZE) : section.endaddr;
+                items.push_back(item);
+            }
+        }
+
+        /* Each work item gets its own result vectors, so the workers never
+         * contend and the concatenation below preserves the address order */
+        std::vector<std::vector<Run>> item_runs(items.size());
+        std::vector<std::vector<T>> item_values(items.size());
+
+        std::atomic<size_t> next_item(0);
+        std::atomic<int> scanned_size(0);
+
+        auto worker = [&] () {
+            std::vector<char> chunk(CHUNK_SIZE);
+            std::vector<uint8_t> discard(CHUNK_SIZE / sizeof(T));
+
+            while (true) {
+                size_t w = next_item.fetch_add(1);
+                if (w >= items.size() || cancel_flag)
+                    break;
+
+                for (uintptr_t addr = items[w].addr; addr < items[w].endaddr; ) {
+                    size_t want = items[w].endaddr - addr;
+
+                    struct iovec local, remote;
+                    local.iov_base = static_cast<void*>(chunk.data());
+                    local.iov_len = want;
+                    remote.iov_base = reinterpret_cast<void*>(addr);
+                    remote.iov_len = want;
+
+                    ssize_t got = process_vm_readv(game_pid, &local, 1, &remote, 1, 0);
+                    if (got < 0)
+                        got = 0;
+
+                    /* Run the vectorized comparison over the local buffer.
+                     * For now we only store aligned addresses. */
+                    size_t nvals = static_cast<size_t>(got) / sizeof(T);
+
+                    /* If only insert addresses that match the compare */
+                    if (compare_type == CompareType::Value)
+                        compare_buffer(reinterpret_cast<const T*>(chunk.data()), static_cast<const T*>(nullptr), nvals, static_cast<T>(compare_value_db), compare_operator, discard.data());
+                    /* Insert all addresses, still checking for non NaN/Inf values */
+                    else
+                        finite_buffer(reinterpret_cast<const T*>(chunk.data()), nvals, discard.data());
+
+                    for (size_t i = 0; i < nvals; i++) {
+                        if (discard[i])
+                            continue;
+
+                        T value;
+                        memcpy(&value, chunk.data() + i*sizeof(T), sizeof(T));
+
+                        /* Extend the last run when the address is consecutive */
+                        uintptr_t cand = addr + i*sizeof(T);
+                        if (!item_runs[w].empty() &&
+                            (cand == item_runs[w].back().base + item_runs[w].back().count*sizeof(T))) {
+                            item_runs[w].back().count++;
+                        }
+                        else {
+                            Run run;
+                            run.base = cand;
+                            run.first = 0;
+                            run.count = 1;
+                            item_runs[w].push_back(run);
+                        }
+                        item_values[w].push_back(value);
+                    }
+
+                    /* A short read stops at the first unreadable page, skip it */
+                    if (static_cast<size_t>(got) < want)
+                        addr += got + 4096;
+                    else
+                        addr += got;
+                }
+
+                /* Report progress once per item, the Qt connection becomes a
+                 * queued one when emitting from a worker thread */
+                progress(scanned_size.fetch_add(items[w].endaddr - items[w].addr) + static_cast<int>(items[w].endaddr - items[w].addr));
+            }
+        };
+
+        unsigned int nthreads = std::thread::hardware_concurrency();
+        if (nthreads == 0)
+            nthreads = 1;
+        if (nthreads > items.size())
+            nthreads = items.size();
+
+        std::vector<std::thread> threads;
+        for (unsigned int t = 1; t < nthreads; t++)
+            threads.push_back(std::thread(worker));
+        if (nthreads > 0)
+            worker();
+        for (auto &th : threads)
+            th.join();
+
+        /* Concatenate the per-item results in item order, assigning the
+         * snapshot indices and merging runs that continue across an item
+         * boundary, so the candidate list stays sorted by address */
+        size_t total = 0;
+        for (size_t w = 0; w < items.size(); w++)
+            total += item_values[w].size();
+        previous_values.reserve(total);
+
+        for (size_t w = 0; w < items.size(); w++) {
+            for (const Run& r : item_runs[w]) {
+                if (!runs.empty() &&
+                    (r.base == runs.back().base + runs.back().count*sizeof(T))) {
+                    runs.back().count += r.count;
+                }
+                else {
+                    Run run = r;
+                    run.first = snapshot_count;
+                    runs.push_back(run);
+                }
+                snapshot_count += r.count;
+            }
+            previous_values.insert(previous_values.end(), item_values[w].begin(), item_values[w].end());
+        }
+
+        /* All snapshot candidates start as survivors, with the unused tail
+         * bits of the last word cleared */
+        survivor_bits.assign((snapshot_count + 63) / 64, UINT64_MAX);
+        if (snapshot_count % 64)
+            survivor_bits.back() = (UINT64_C(1) << (snapshot_count % 64)) - 1;
+        survivor_ranks.resize(survivor_bits.size());
+        buildRanks();
+    }
+
+    void search(CompareType compare_type, CompareOperator compare_operator, double compare_value_db, std::function<void(int)> progress)
+    {
+        std::vector<struct iovec> remotes;
+        std::vector<uint64_t> batch_idx;
+        std::vector<char> iov_ok;
+        std::vector<char> buf;
+        std::vector<T> prev_batch;
+        std::vector<uint8_t> discard;
+
+        cancel_flag = false;
+
+        int count = 0;
+        size_t run_i = 0;
+        uint64_t idx = 0;
+
+        while (idx < snapshot_count && !cancel_flag) {
+
+            /* Gather a batch of surviving addresses, merging consecutive
+             * ones into a single iovec */
+            remotes.clear();
+            batch_idx.clear();
+            size_t batch_bytes = 0;
+            while (remotes.size() < MAX_IOVS) {
+                idx = nextSurvivor(idx);
+                if (idx >= snapshot_count)
+                    break;
+
+                while (runs[run_i].first + runs[run_i].count <= idx)
+                    run_i++;
+                uintptr_t a = runs[run_i].base + (idx - runs[run_i].first)*sizeof(T);
+
+                if (!remotes.empty() &&
+                    (a == reinterpret_cast<uintptr_t>(remotes.back().iov_base) + remotes.back().iov_len)) {
+                    remotes.back().iov_len += sizeof(T);
+                }
+                else {
+                    struct iovec iov;
+                    iov.iov_base = reinterpret_cast<void*>(a);
+                    iov.iov_len = sizeof(T);
+                    remotes.push_back(iov);
+                }
+                batch_idx.push_back(idx);
+                batch_bytes += sizeof(T);
+                idx++;
+            }
+
+            if (batch_idx.empty())
+                break;
+
+            buf.resize(batch_bytes);
+            iov_ok.assign(remotes.size(), 1);
+
+            /* Read the batch, resuming after unreadable ranges. A short read
+             * stops inside the first unreadable iovec, which is flagged and
+             * skipped, its addresses will be dropped below. */
+            size_t iov_done = 0;
+            size_t filled = 0;
+            while (iov_done < remotes.size()) {
+                struct iovec local;
+                local.iov_base = static_cast<void*>(buf.data() + filled);
+                local.iov_len = batch_bytes - filled;
+
+                ssize_t got = process_vm_readv(game_pid, &local, 1, &remotes[iov_done], remotes.size() - iov_done, 0);
+                if (got < 0)
+                    got = 0;
+
+                /* Consume fully read iovecs */
+                while ((iov_done < remotes.size()) &&
+                       (static_cast<size_t>(got) >= remotes[iov_done].iov_len)) {
+                    got -= remotes[iov_done].iov_len;
+                    filled += remotes[iov_done].iov_len;
+                    iov_done++;
+                }
+
+                /* The next iovec is (partially) unreadable */
+                if (iov_done < remotes.size()) {
+                    iov_ok[iov_done] = 0;
+                    filled += remotes[iov_done].iov_len;
+                    iov_done++;
+                }
+            }
+
+            /* Run the vectorized comparison over the whole batch. The batch
+             * buffer holds one value per candidate in snapshot order, so the
+             * previous values are gathered to line up with it. */
+            size_t nvals = batch_idx.size();
+            discard.resize(nvals);
+            const T* prev = nullptr;
+            if (compare_type == CompareType::Previous) {
+                prev_batch.resize(nvals);
+                for (size_t i = 0; i < nvals; i++)
+                    prev_batch[i] = previous_values[batch_idx[i]];
+                prev = prev_batch.data();
+            }
+            compare_buffer(reinterpret_cast<const T*>(buf.data()), prev, nvals, static_cast<T>(compare_value_db), compare_operator, discard.data());
+
+            /* Walk the batch values, clearing the survivor bit of the
+             * candidates that failed and updating the value of the others */
+            size_t iov_i = 0;
+            size_t iov_off = 0;
+            size_t buf_off = 0;
+            for (size_t i = 0; i < nvals; i++) {
+
+                if (!(count++ & 0xfff)) {
+                    progress(count);
+                }
+
+                bool ok = iov_ok[iov_i];
+                size_t val_off = buf_off;
+
+                iov_off += sizeof(T);
+                buf_off += sizeof(T);
+                if (iov_off == remotes[iov_i].iov_len) {
+                    iov_i++;
+                    iov_off = 0;
+                }
+
+                uint64_t si = batch_idx[i];
+                if (!ok || discard[i]) {
+                    survivor_bits[si >> 6] &= ~(UINT64_C(1) << (si & 63));
+                    continue;
+                }
+
+                T value;
+                memcpy(&value, buf.data() + val_off, sizeof(T));
+                previous_values[si] = value;
+            }
+        }
+
+        buildRanks();
+    }
+
+    void cancel()
+    {
+        cancel_flag = true;
+    }
+
+    int type() const
+    {
+        return type_index<T>();
+    }
+
+private:
+    /* Sections are read with a few process_vm_readv calls of this size */
+    static const size_t CHUNK_SIZE = 4 * 1024 * 1024;
+
+    /* Maximum number of remote ranges per process_vm_readv call (IOV_MAX) */
+    static const size_t MAX_IOVS = 1024;
+
+    /* A run of candidates at consecutive addresses, sizeof(T) apart */
+    struct Run {
+        uintptr_t base;   /* address of the first candidate */
+        uint64_t first;   /* snapshot index of the first candidate */
+        uint64_t count;   /* number of candidates */
+    };
+
+    pid_t game_pid;
+
+    /* Set from another thread to make a running scan stop early */
+    std::atomic<bool> cancel_flag {false};
+
+    std::vector<Run> runs;
+
+    /* Value arena indexed by snapshot position, updated in place */
+    std::vector<T> previous_values;
+
+    /* One bit per snapshot candidate, cleared when a refinement drops it,
+     * with the number of survivors before each word for rank queries */
+    std::vector<uint64_t> survivor_bits;
+    std::vector<uint64_t> survivor_ranks;
+    uint64_t snapshot_count = 0;
+    uint64_t survivor_count = 0;
+
+    /* Rebuild the rank index and the survivor count from the bitmap */
+    void buildRanks()
+    {
+        uint64_t cum = 0;
+        for (size_t w = 0; w < survivor_bits.size(); w++) {
+            survivor_ranks[w] = cum;
+            cum += __builtin_popcountll(survivor_bits[w]);
+        }
+        survivor_count = cum;
+    }
+
+    /* Find the first surviving snapshot index at or after idx, or
+     * snapshot_count when there is none */
+    uint64_t nextSurvivor(uint64_t idx) const
+    {
+        while (idx < snapshot_count) {
+            uint64_t word = survivor_bits[idx >> 6] >> (idx & 63);
+            if (word)
+                return idx + __builtin_ctzll(word);
+            idx = (idx | 63) + 1;
+        }
+        return snapshot_count;
+    }
+
+    /* Snapshot index of the nth surviving candidate: binary search the rank
+     * index for the bitmap word, then scan its bits */
+    uint64_t selectRow(size_t row) const
+    {
+        size_t lo = 0;
+        size_t hi = survivor_ranks.size();
+        while (hi - lo > 1) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (survivor_ranks[mid] <= row)
+                lo = mid;
+            else
+                hi = mid;
+        }
+
+        uint64_t word = survivor_bits[lo];
+        uint64_t remaining = row - survivor_ranks[lo];
+        while (remaining > 0) {
+            word &= word - 1;
+            remaining--;
+        }
+        return lo*64 + __builtin_ctzll(word);
+    }
+
+    /* Address of a snapshot index: binary search the run containing it */
+    uintptr_t snapshotAddress(uint64_t idx) const
+    {
+        size_t lo = 0;
+        size_t hi = runs.size();
+        while (hi - lo > 1) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (runs[mid].first <= idx)
+                lo = mid;
+            else
+                hi = mid;
+        }
+        return runs[lo].base + (idx - runs[lo].first)*sizeof(T);
+    }
+};
+
+#endif
@@ -24,6 +24,7 @@
 #include "TypeIndex.h"
 #include <sstream>
 #include <iostream>
+#include <cstring>
 #include <sys/uio.h>
 
 template <class T>
@@ -62,28 +63,88 @@ public:
         return value;
     }
 
-    std::string value_str()
+    std::string to_string(T value, bool valid)
     {
+        if (!valid)
+            return std::string("??????");
+
         std::ostringstream oss;
         if (hex) oss << std::hex;
         /* Output char and unsigned char as integer values. There might be a
          * more elegant solution.
          */
         if (std::is_same<T, char>::value) {
-            oss << static_cast<int>(get_value());
+            oss << static_cast<int>(value);
         }
         else if (std::is_same<T, unsigned char>::value) {
-            oss << static_cast<unsigned int>(get_value());
+            oss << static_cast<unsigned int>(value);
         }
         else {
-            oss << get_value();
+            oss << value;
         }
-        if (!isValid)
-            return std::string("??????");
-
         return oss.str();
     }
 
+    std::string value_str()
+    {
+        T value = get_value();
+        return to_string(value, isValid);
+    }
+
+    void update_value(const void* buf, bool valid)
+    {
+        /* Skip the string formatting when the raw bytes match the previous
+         * poll, which is the common case of an idle watch */
+        if (has_prev && (valid == prev_valid)
+            && (!valid || (memcmp(prev_value, buf, sizeof(T)) == 0))) {
+            value_changed = false;
+            return;
+        }
+
+        T value = 0;
+        if (valid) {
+            memcpy(&value, buf, sizeof(T));
+            memcpy(prev_value, buf, sizeof(T));
+        }
+        prev_valid = valid;
+        has_prev = true;
+
+        std::string str = to_string(value, valid);
+        value_changed = (str != cached_str);
+        cached_str = str;
+    }
+
+    size_t value_size() const
+    {
+        return sizeof(T);
+    }
+
+    double to_double(const void* buf)
+    {
+        T value;
+        memcpy(&value, buf, sizeof(T));
+        return static_cast<double>(value);
+    }
+
+    std::string format(const void* buf)
+    {
+        T value;
+        memcpy(&value, buf, sizeof(T));
+        return to_string(value, true);
+    }
+
+    void freeze(bool enable)
+    {
+        if (enable) {
+            T value = get_value();
+            /* Don't freeze a value we could not read */
+            if (!isValid)
+                return;
+            memcpy(frozen_value, &value, sizeof(T));
+        }
+        frozen = enable;
+    }
+
     int poke_value(std::string str_value)
     {
         std::istringstream iss(str_value);
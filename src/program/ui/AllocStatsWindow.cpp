@@ -0,0 +1,99 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QHeaderView>
+#include <QVBoxLayout>
+
+#include "AllocStatsWindow.h"
+#include "MainWindow.h"
+
+/* Estimated bytes per second, formatted with a binary unit */
+static QString formatRate(double bytes_per_sec)
+{
+    const char* units[] = {"B/s", "KiB/s", "MiB/s", "GiB/s"};
+    int unit = 0;
+    while ((bytes_per_sec >= 1024.0) && (unit < 3)) {
+        bytes_per_sec /= 1024.0;
+        unit++;
+    }
+    return QString("%1 %2").arg(bytes_per_sec, 0, 'f', 1).arg(units[unit]);
+}
+
+AllocStatsWindow::AllocStatsWindow(QWidget *parent, Qt::WindowFlags flags) : QDialog(parent, flags)
+{
+    setWindowTitle("Allocation profile");
+
+    siteTable = new QTableWidget(AllocStats::MAX_SITES, 4, this);
+    siteTable->setHorizontalHeaderLabels({"Callsite", "Allocs/s", "Bytes/s", "Avg size"});
+    siteTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+    siteTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    siteTable->verticalHeader()->hide();
+    siteTable->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+
+    totalLabel = new QLabel(tr("Enable Runtime > Allocation profiling to collect samples"));
+
+    QVBoxLayout *mainLayout = new QVBoxLayout;
+    mainLayout->addWidget(siteTable, 1);
+    mainLayout->addWidget(totalLabel);
+    setLayout(mainLayout);
+
+    qRegisterMetaType<AllocStats>("AllocStats");
+
+    /* We need connections to the game loop, so we access it through our parent */
+    MainWindow *mw = qobject_cast<MainWindow*>(parent);
+    if (mw) {
+        connect(mw->gameLoop, &GameLoop::allocStatsChanged, this, &AllocStatsWindow::update);
+    }
+}
+
+void AllocStatsWindow::update(AllocStats stats)
+{
+    if (stats.interval_ns == 0)
+        return;
+
+    const double seconds = stats.interval_ns / 1000000000.0;
+
+    for (int i = 0; i < AllocStats::MAX_SITES; i++) {
+        if (i >= static_cast<int>(stats.site_count)) {
+            for (int col = 0; col < 4; col++)
+                siteTable->setItem(i, col, new QTableWidgetItem(""));
+            continue;
+        }
+
+        /* Scale the sampled values back to estimates of the real traffic */
+        const AllocStats::Site &site = stats.sites[i];
+        const double count = static_cast<double>(site.count) * stats.sample_rate;
+        const double bytes = static_cast<double>(site.bytes) * stats.sample_rate;
+
+        siteTable->setItem(i, 0, new QTableWidgetItem(
+            QString("0x%1").arg(site.address, 0, 16)));
+        siteTable->setItem(i, 1, new QTableWidgetItem(
+            QString("%1").arg(count / seconds, 0, 'f', 0)));
+        siteTable->setItem(i, 2, new QTableWidgetItem(formatRate(bytes / seconds)));
+        siteTable->setItem(i, 3, new QTableWidgetItem(
+            QString("%1").arg(site.count ? (site.bytes / site.count) : 0)));
+    }
+
+    const double total_bytes = static_cast<double>(stats.total_bytes) * stats.sample_rate;
+    const double total_count = static_cast<double>(stats.total_count) * stats.sample_rate;
+    totalLabel->setText(QString("Total: %1 allocs/s, %2 (sampled 1 in %3)")
+        .arg(total_count / seconds, 0, 'f', 0)
+        .arg(formatRate(total_bytes / seconds))
+        .arg(stats.sample_rate));
+}
@@ -0,0 +1,46 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_ALLOCSTATSWINDOW_H_INCLUDED
+#define LIBTAS_ALLOCSTATSWINDOW_H_INCLUDED
+
+#include <QDialog>
+#include <QLabel>
+#include <QTableWidget>
+
+#include "../../shared/AllocStats.h"
+
+/* Table of the heaviest allocation callsites received from the game,
+ * refreshed at each aggregation interval. Values are scaled by the
+ * sampling rate, so they estimate the real allocation traffic */
+class AllocStatsWindow : public QDialog {
+    Q_OBJECT
+public:
+    AllocStatsWindow(QWidget *parent = Q_NULLPTR, Qt::WindowFlags flags = 0);
+
+private:
+    QTableWidget *siteTable;
+    QLabel *totalLabel;
+
+public slots:
+    /* Receive one aggregated sample from the game loop */
+    void update(AllocStats stats);
+};
+
+#endif
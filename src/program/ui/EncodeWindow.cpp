@@ -53,6 +53,14 @@ EncodeWindow::EncodeWindow(Context* c, QWidget *parent, Qt::WindowFlags flags) :
     videoChoice->addItem("H.264 RGB", "libx264rgb");
     videoChoice->addItem("H.265", "libx265");
     videoChoice->addItem("raw video", "rawvideo");
+    /* Hardware encoders. The frames still cross the pipe to ffmpeg, but
+     * compression runs on the GPU encode block, leaving the CPU cores to
+     * the game. Appended after the software codecs so that saved codec
+     * indices from older configs keep their meaning. */
+    videoChoice->addItem("H.264 (VAAPI hardware)", "h264_vaapi");
+    videoChoice->addItem("H.265 (VAAPI hardware)", "hevc_vaapi");
+    videoChoice->addItem("H.264 (NVENC hardware)", "h264_nvenc");
+    videoChoice->addItem("H.265 (NVENC hardware)", "hevc_nvenc");
     connect(videoChoice, static_cast<void (QComboBox::*)(int)>(&QComboBox::activated), this, &EncodeWindow::slotUpdate);
 
     videoBitrate = new QSpinBox();
@@ -136,7 +144,18 @@ void EncodeWindow::update_config()
 
 void EncodeWindow::slotUpdate()
 {
-    QString options = QString("-c:v %1 -b:v %2k -c:a %3 -b:a %4k").arg(videoChoice->currentData().toString()).arg(videoBitrate->value()).arg(audioChoice->currentData().toString()).arg(audioBitrate->value());
+    QString videoCodec = videoChoice->currentData().toString();
+
+    QString options;
+
+    /* VAAPI encoders only accept frames living in GPU memory, so open the
+     * render node and upload the raw frames right after they leave the pipe.
+     * NVENC accepts system-memory frames directly and needs no extra flags. */
+    if (videoCodec.contains("vaapi")) {
+        options += "-vaapi_device /dev/dri/renderD128 -vf format=nv12,hwupload ";
+    }
+
+    options += QString("-c:v %1 -b:v %2k -c:a %3 -b:a %4k").arg(videoCodec).arg(videoBitrate->value()).arg(audioChoice->currentData().toString()).arg(audioBitrate->value());
     ffmpegOptions->setText(options);
 }
 
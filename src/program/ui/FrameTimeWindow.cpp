@@ -0,0 +1,199 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QFormLayout>
+#include <QVBoxLayout>
+#include <QGroupBox>
+#include <QPainter>
+
+#include "FrameTimeWindow.h"
+#include "MainWindow.h"
+
+static const char* spanNames[FrameTimeStats::SPAN_COUNT] = {
+    "Sleep", "Audio mixing", "Screen capture", "OSD", "Encoding", "Draw", "Waiting on program"
+};
+
+static const char* latencyStageNames[InputLatencyStats::STAGE_COUNT] = {
+    "Key event to dispatch", "Dispatch to socket", "Socket to game inputs", "Game inputs to boundary"
+};
+
+const QColor FrameTimeGraph::spanColors[FrameTimeStats::SPAN_COUNT] = {
+    QColor(120, 120, 120), /* sleep */
+    QColor(80, 160, 80),   /* audio */
+    QColor(80, 120, 200),  /* capture */
+    QColor(200, 180, 80),  /* hud */
+    QColor(200, 80, 80),   /* encode */
+    QColor(150, 80, 200),  /* draw */
+    QColor(80, 200, 200),  /* wait */
+};
+
+FrameTimeGraph::FrameTimeGraph(QWidget *parent) : QWidget(parent)
+{
+    setMinimumSize(HISTORY_LENGTH * 4, 200);
+}
+
+float FrameTimeGraph::spanMsPerFrame(const FrameTimeStats &stats, int span)
+{
+    if ((stats.interval_ticks == 0) || (stats.frames == 0))
+        return 0.0f;
+
+    /* Convert ticks into wall time using the interval as the reference */
+    const double span_ns = static_cast<double>(stats.span_ticks[span])
+        * stats.interval_ns / stats.interval_ticks;
+    return span_ns / stats.frames / 1000000.0;
+}
+
+void FrameTimeGraph::append(FrameTimeStats stats)
+{
+    history.push_back(stats);
+    while (history.size() > HISTORY_LENGTH)
+        history.pop_front();
+    QWidget::update();
+}
+
+void FrameTimeGraph::paintEvent(QPaintEvent *event)
+{
+    QPainter painter(this);
+    painter.fillRect(rect(), QColor(30, 30, 30));
+
+    if (history.empty())
+        return;
+
+    /* Scale the graph so the tallest column fills the height */
+    float max_ms = 0.0f;
+    for (const FrameTimeStats &stats : history) {
+        float total_ms = 0.0f;
+        for (int s = 0; s < FrameTimeStats::SPAN_COUNT; s++)
+            total_ms += spanMsPerFrame(stats, s);
+        if (total_ms > max_ms)
+            max_ms = total_ms;
+    }
+    if (max_ms <= 0.0f)
+        return;
+
+    const float column_width = static_cast<float>(width()) / HISTORY_LENGTH;
+
+    for (size_t i = 0; i < history.size(); i++) {
+        const FrameTimeStats &stats = history[i];
+        const int x = static_cast<int>(i * column_width);
+        const int w = static_cast<int>((i+1) * column_width) - x;
+
+        /* Stack the spans from the bottom up */
+        float bottom_ms = 0.0f;
+        for (int s = 0; s < FrameTimeStats::SPAN_COUNT; s++) {
+            const float span_ms = spanMsPerFrame(stats, s);
+            if (span_ms <= 0.0f)
+                continue;
+            const int y0 = height() - static_cast<int>(bottom_ms / max_ms * height());
+            const int y1 = height() - static_cast<int>((bottom_ms + span_ms) / max_ms * height());
+            painter.fillRect(x, y1, w, y0 - y1, spanColors[s]);
+            bottom_ms += span_ms;
+        }
+    }
+
+    /* Print the scale of the graph */
+    painter.setPen(Qt::white);
+    painter.drawText(5, 15, QString("%1 ms/frame").arg(max_ms, 0, 'f', 2));
+}
+
+FrameTimeWindow::FrameTimeWindow(QWidget *parent, Qt::WindowFlags flags) : QDialog(parent, flags)
+{
+    setWindowTitle("Frame timing");
+
+    graph = new FrameTimeGraph();
+
+    QFormLayout *legendLayout = new QFormLayout;
+    for (int s = 0; s < FrameTimeStats::SPAN_COUNT; s++) {
+        QLabel *colorLabel = new QLabel(spanNames[s]);
+        colorLabel->setStyleSheet(QString("color: rgb(%1, %2, %3)")
+            .arg(FrameTimeGraph::spanColors[s].red())
+            .arg(FrameTimeGraph::spanColors[s].green())
+            .arg(FrameTimeGraph::spanColors[s].blue()));
+        spanLabels[s] = new QLabel(tr("-"));
+        legendLayout->addRow(colorLabel, spanLabels[s]);
+    }
+    frameLabel = new QLabel(tr("-"));
+    legendLayout->addRow(new QLabel(tr("Frames per interval:")), frameLabel);
+
+    /* Frame advance latency, sampled from real key presses */
+    QGroupBox *latencyBox = new QGroupBox(tr("Frame advance latency"));
+    QFormLayout *latencyLayout = new QFormLayout;
+    for (int s = 0; s < InputLatencyStats::STAGE_COUNT; s++) {
+        latencyStageLabels[s] = new QLabel(tr("-"));
+        latencyLayout->addRow(new QLabel(latencyStageNames[s]), latencyStageLabels[s]);
+    }
+    latencyHistLabel = new QLabel(tr("-"));
+    latencyLayout->addRow(new QLabel(tr("Total:")), latencyHistLabel);
+    latencyBox->setLayout(latencyLayout);
+
+    QVBoxLayout *mainLayout = new QVBoxLayout;
+    mainLayout->addWidget(graph, 1);
+    mainLayout->addLayout(legendLayout);
+    mainLayout->addWidget(latencyBox);
+    setLayout(mainLayout);
+
+    qRegisterMetaType<FrameTimeStats>("FrameTimeStats");
+    qRegisterMetaType<InputLatencyStats>("InputLatencyStats");
+
+    /* We need connections to the game loop, so we access it through our parent */
+    MainWindow *mw = qobject_cast<MainWindow*>(parent);
+    if (mw) {
+        connect(mw->gameLoop, &GameLoop::frameTimeStatsChanged, this, &FrameTimeWindow::update);
+        connect(mw->gameLoop, &GameLoop::inputLatencyChanged, this, &FrameTimeWindow::updateLatency);
+    }
+}
+
+void FrameTimeWindow::update(FrameTimeStats stats)
+{
+    graph->append(stats);
+
+    for (int s = 0; s < FrameTimeStats::SPAN_COUNT; s++) {
+        const float span_ms = FrameTimeGraph::spanMsPerFrame(stats, s);
+        const float percent = stats.interval_ticks ?
+            (100.0f * stats.span_ticks[s] / stats.interval_ticks) : 0.0f;
+        spanLabels[s]->setText(QString("%1 ms/frame (%2 %)")
+            .arg(span_ms, 0, 'f', 3).arg(percent, 0, 'f', 1));
+    }
+    frameLabel->setText(QString("%1").arg(stats.frames));
+}
+
+void FrameTimeWindow::updateLatency(InputLatencyStats stats)
+{
+    if (!stats.samples)
+        return;
+
+    for (int s = 0; s < InputLatencyStats::STAGE_COUNT; s++) {
+        const float avg_ms = static_cast<float>(stats.stage_sum_ns[s]) / stats.samples / 1000000.0f;
+        const float max_ms = stats.stage_max_ns[s] / 1000000.0f;
+        latencyStageLabels[s]->setText(QString("%1 ms avg, %2 ms max")
+            .arg(avg_ms, 0, 'f', 2).arg(max_ms, 0, 'f', 2));
+    }
+
+    /* Histogram of the total latency, one count per power-of-two bucket */
+    QString hist = QString("%1 samples:").arg(stats.samples);
+    for (int b = 0; b < InputLatencyStats::NB_BUCKETS; b++) {
+        if (!stats.buckets[b])
+            continue;
+        if (b == 0)
+            hist += QString("  <1 ms: %1").arg(stats.buckets[b]);
+        else
+            hist += QString("  %1-%2 ms: %3").arg(1 << (b-1)).arg(1 << b).arg(stats.buckets[b]);
+    }
+    latencyHistLabel->setText(hist);
+}
@@ -0,0 +1,79 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_FRAMETIMEWINDOW_H_INCLUDED
+#define LIBTAS_FRAMETIMEWINDOW_H_INCLUDED
+
+#include <QDialog>
+#include <QLabel>
+#include <QWidget>
+#include <deque>
+
+#include "../../shared/FrameTimeStats.h"
+#include "../InputLatencyStats.h"
+
+/* Graph of the frame time spans received from the game, one stacked
+ * column per aggregation interval */
+class FrameTimeGraph : public QWidget {
+    Q_OBJECT
+public:
+    FrameTimeGraph(QWidget *parent = Q_NULLPTR);
+
+    /* Append one aggregated sample */
+    void append(FrameTimeStats stats);
+
+    /* Average wall time per frame of one span in a sample, in milliseconds */
+    static float spanMsPerFrame(const FrameTimeStats &stats, int span);
+
+    /* Colors of the spans, shared with the window legend */
+    static const QColor spanColors[FrameTimeStats::SPAN_COUNT];
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+
+private:
+    /* Number of samples kept, one per aggregation interval (about 1s) */
+    static const size_t HISTORY_LENGTH = 120;
+
+    std::deque<FrameTimeStats> history;
+};
+
+class FrameTimeWindow : public QDialog {
+    Q_OBJECT
+public:
+    FrameTimeWindow(QWidget *parent = Q_NULLPTR, Qt::WindowFlags flags = 0);
+
+private:
+    FrameTimeGraph *graph;
+    QLabel *spanLabels[FrameTimeStats::SPAN_COUNT];
+    QLabel *frameLabel;
+
+    /* End-to-end frame advance latency, per pipeline stage */
+    QLabel *latencyStageLabels[InputLatencyStats::STAGE_COUNT];
+    QLabel *latencyHistLabel;
+
+public slots:
+    /* Receive one aggregated sample from the game loop */
+    void update(FrameTimeStats stats);
+
+    /* Receive the accumulated frame advance latency stats */
+    void updateLatency(InputLatencyStats stats);
+};
+
+#endif
@@ -73,7 +73,7 @@ QVariant InputEditorModel::headerData(int section, Qt::Orientation orientation,
                 return QString(tr(""));
             if (section == 1)
                 return QString(tr("Frame"));
-            return QString(input_set[section-2].description.c_str());
+            return cached_descriptions[section-2];
         }
     }
     return QVariant();
@@ -86,11 +86,13 @@ QVariant InputEditorModel::data(const QModelIndex &index, int role) const
     }
 
     if (role == Qt::FontRole) {
-        QFont font;
+        /* Cached fonts, so cells don't construct one at every repaint */
+        static const QFont normal_font = QFont();
+        static const QFont bold_font = [] { QFont f; f.setBold(true); return f; }();
         if ((index.column() == 0) && (index.row() == last_savestate)) {
-            font.setBold(true);
+            return bold_font;
         }
-        return font;
+        return normal_font;
     }
 
     if (role == Qt::BackgroundRole) {
@@ -102,15 +104,20 @@ QVariant InputEditorModel::data(const QModelIndex &index, int role) const
         // if (index.column() == 0)
         //     return QBrush(QColor(0xff, 0xfe, 0xee));
 
+        /* Cached base colors, so cells don't construct one at every repaint */
+        static const QColor current_color = QColor(0xb5, 0xe7, 0xf7);
+        static const QColor past_color = QColor(0xd2, 0xf9, 0xd3);
+        static const QColor future_color = QColor(0xfe, 0xfe, 0xe8);
+
         QColor color;
 
         /* Main color */
         if (index.row() == static_cast<int>(context->framecount))
-            color.setRgb(0xb5, 0xe7, 0xf7);
+            color = current_color;
         else if (index.row() < static_cast<int>(context->framecount))
-            color.setRgb(0xd2, 0xf9, 0xd3);
+            color = past_color;
         else
-            color.setRgb(0xfe, 0xfe, 0xe8);
+            color = future_color;
 
         /* Frame column */
         if (index.column() <= 1) {
@@ -126,6 +133,12 @@ QVariant InputEditorModel::data(const QModelIndex &index, int role) const
             }
         }
 
+        /* Frame carrying a marker, shown on the frame columns */
+        if ((index.column() <= 1) && (movie->markers.find(index.row()) != movie->markers.end())) {
+            static const QColor marker_color = QColor(0xf9, 0xd7, 0xa0);
+            color = marker_color;
+        }
+
         /* Frame containing a savestate */
         for (unsigned int i=0; i<savestate_frames.size(); i++) {
             if (savestate_frames[i] == index.row()) {
@@ -137,6 +150,16 @@ QVariant InputEditorModel::data(const QModelIndex &index, int role) const
         return QBrush(color);
     }
 
+    if (role == Qt::ToolTipRole) {
+        /* Show the marker text when hovering the frame columns */
+        if (index.column() <= 1) {
+            auto marker = movie->markers.find(index.row());
+            if (marker != movie->markers.end())
+                return QString(marker->second.c_str());
+        }
+        return QVariant();
+    }
+
     if (role == Qt::DisplayRole) {
         if (index.row() >= movie->input_list.size()) {
             return QVariant();
@@ -153,21 +176,24 @@ QVariant InputEditorModel::data(const QModelIndex &index, int role) const
             return index.row();
         }
 
-        const AllInputs ai = movie->input_list[index.row()];
-        const SingleInput si = input_set[index.column()-2];
+        const AllInputs &ai = movie->input_list[index.row()];
+        const SingleInput &si = input_set[index.column()-2];
 
         /* Get the value of the single input in movie inputs */
         int value = ai.getInput(si);
 
         if (si.isAnalog()) {
-            return QString().setNum(value);
+            return value;
         }
 
         if (value) {
-            return QString(si.description.c_str());
+            /* Return the cached string of the column description, instead of
+             * converting it at every repaint */
+            return cached_descriptions[index.column()-2];
         }
         else {
-            return QString("");
+            static const QString empty_string = QString("");
+            return empty_string;
         }
     }
 
@@ -179,13 +205,13 @@ QVariant InputEditorModel::data(const QModelIndex &index, int role) const
             return QVariant();
         }
 
-        const SingleInput si = input_set[index.column()-2];
+        const SingleInput &si = input_set[index.column()-2];
 
         /* Don't edit locked input */
         if (movie->locked_inputs.find(si) != movie->locked_inputs.end())
             return QVariant();
 
-        const AllInputs ai = movie->input_list[index.row()];
+        const AllInputs &ai = movie->input_list[index.row()];
 
         /* Get the value of the single input in movie inputs */
         int value = ai.getInput(si);
@@ -214,17 +240,20 @@ bool InputEditorModel::setData(const QModelIndex &index, const QVariant &value,
         if (movie->locked_inputs.find(si) != movie->locked_inputs.end())
             return false;
 
+        movie->beginEditGroup();
+
         /* Add a row if necessary */
         if (index.row() == movie->input_list.size()) {
             insertRows(movie->input_list.size(), 1, QModelIndex());
         }
 
-        AllInputs &ai = movie->input_list[index.row()];
+        AllInputs ai = movie->input_list[index.row()];
 
         int ivalue = value.toInt();
 
         ai.setInput(si, ivalue);
-        movie->wasModified();
+        movie->setInputs(ai, index.row(), true);
+        movie->endEditGroup();
         emit dataChanged(index, index, {role});
         return true;
     }
@@ -234,15 +263,11 @@ bool InputEditorModel::setData(const QModelIndex &index, const QVariant &value,
 
 void InputEditorModel::buildInputSet()
 {
-    std::set<SingleInput> new_input_set;
-
-    /* Gather all unique inputs from the movie */
-    for (const AllInputs &ai : movie->input_list) {
-        ai.extractInputs(new_input_set);
-    }
-
+    /* The movie maintains the count of every pressed input, so the unique
+     * inputs are the map keys, already ordered like the old full scan */
     input_set.clear();
-    for (SingleInput si : new_input_set) {
+    for (const auto& counted_input : movie->input_counts) {
+        SingleInput si = counted_input.first;
 
         /* Gather input name in the movie if there is one */
         auto it = movie->input_names.find(si);
@@ -264,6 +289,11 @@ void InputEditorModel::buildInputSet()
         input_set.push_back(si);
     }
 
+    /* Rebuild the cached column strings */
+    cached_descriptions.clear();
+    for (const SingleInput &si : input_set) {
+        cached_descriptions.push_back(QString(si.description.c_str()));
+    }
 }
 
 bool InputEditorModel::toggleInput(const QModelIndex &index)
@@ -282,15 +312,18 @@ bool InputEditorModel::toggleInput(const QModelIndex &index)
     if (movie->locked_inputs.find(si) != movie->locked_inputs.end())
         return false;
 
+    movie->beginEditGroup();
+
     /* Add a row if necessary */
     if (index.row() == movie->input_list.size()) {
         insertRows(movie->input_list.size(), 1, QModelIndex());
     }
 
-    AllInputs &ai = movie->input_list[index.row()];
+    AllInputs ai = movie->input_list[index.row()];
 
     int value = ai.toggleInput(si);
-    movie->wasModified();
+    movie->setInputs(ai, index.row(), true);
+    movie->endEditGroup();
 
     emit dataChanged(index, index);
 
@@ -307,6 +340,7 @@ std::string InputEditorModel::inputLabel(int column)
 void InputEditorModel::renameLabel(int column, std::string label)
 {
     input_set[column-2].description = label;
+    cached_descriptions[column-2] = QString(label.c_str());
     movie->input_names[input_set[column-2]] = label;
     emit dataChanged(createIndex(0, column), createIndex(rowCount(), column));
     emit inputSetChanged();
@@ -347,9 +381,11 @@ bool InputEditorModel::insertRows(int row, int count, const QModelIndex &parent)
     AllInputs ai;
     ai.emptyInputs();
 
+    movie->beginEditGroup();
     for (int i=0; i<count; i++) {
         movie->insertInputsBefore(ai, row);
     }
+    movie->endEditGroup();
 
     endInsertRows();
 
@@ -369,9 +405,11 @@ bool InputEditorModel::removeRows(int row, int count, const QModelIndex &parent)
 
     beginRemoveRows(parent, row, row+count-1);
 
+    movie->beginEditGroup();
     for (int i=0; i<count; i++) {
         movie->deleteInputs(row);
     }
+    movie->endEditGroup();
 
     endRemoveRows();
 
@@ -423,10 +461,12 @@ int InputEditorModel::pasteInputs(int row)
         beginInsertRows(QModelIndex(), rowCount(), rowCount() + insertedFrames - 1);
     }
 
+    movie->beginEditGroup();
     for (size_t r = 0; r < paste_ais.size(); r++) {
         movie->setInputs(paste_ais[r], row + r, true);
         addUniqueInputs(paste_ais[r]);
     }
+    movie->endEditGroup();
 
     if (insertedFrames > 0) {
         endInsertRows();
@@ -466,10 +506,12 @@ int InputEditorModel::pasteInsertInputs(int row)
 
     beginInsertRows(QModelIndex(), row, row + paste_ais.size() - 1);
 
+    movie->beginEditGroup();
     for (size_t r = 0; r < paste_ais.size(); r++) {
         movie->insertInputsBefore(paste_ais[r], row + r);
         addUniqueInputs(paste_ais[r]);
     }
+    movie->endEditGroup();
 
     endInsertRows();
 
@@ -495,6 +537,7 @@ void InputEditorModel::addUniqueInput(const SingleInput &si)
 
     beginInsertColumns(QModelIndex(), columnCount(), columnCount());
     input_set.push_back(si);
+    cached_descriptions.push_back(QString(si.description.c_str()));
     endInsertColumns();
     emit inputSetChanged();
 }
@@ -547,11 +590,15 @@ void InputEditorModel::clearUniqueInput(int column)
     if (movie->locked_inputs.find(si) != movie->locked_inputs.end())
         return;
 
-    for (int f = static_cast<int>(context->framecount); f < movie->input_list.size(); f++) {
-        movie->input_list[f].setInput(si, 0);
+    movie->beginEditGroup();
+    for (size_t f = context->framecount; f < movie->input_list.size(); f++) {
+        if (movie->input_list[f].getInput(si) == 0)
+            continue;
+        AllInputs ai = movie->input_list[f];
+        ai.setInput(si, 0);
+        movie->setInputs(ai, f, true);
     }
-
-    movie->wasModified();
+    movie->endEditGroup();
 }
 
 bool InputEditorModel::isLockedUniqueInput(int column)
@@ -589,10 +636,79 @@ void InputEditorModel::lockUniqueInput(int column, bool locked)
 
 void InputEditorModel::clearInput(int row)
 {
-    movie->input_list[row].emptyInputs();
+    AllInputs ai;
+    ai.emptyInputs();
+
+    movie->beginEditGroup();
+    movie->setInputs(ai, row, true);
+    movie->endEditGroup();
+
     emit dataChanged(createIndex(row, 0), createIndex(row, columnCount()));
+}
 
-    movie->wasModified();
+void InputEditorModel::seekToFrame(unsigned long frame)
+{
+    /* The game loop polls this field at each frame boundary, even while the
+     * game is paused */
+    context->seek_frame = frame;
+}
+
+std::string InputEditorModel::getMarker(unsigned long frame)
+{
+    auto marker = movie->markers.find(frame);
+    if (marker != movie->markers.end())
+        return marker->second;
+    return "";
+}
+
+void InputEditorModel::setMarker(unsigned long frame, const std::string& text)
+{
+    movie->setMarker(frame, text);
+
+    /* Only the frame columns display markers */
+    emit dataChanged(createIndex(frame, 0), createIndex(frame, 1));
+}
+
+bool InputEditorModel::undoInputs()
+{
+    if (!movie->canUndo())
+        return false;
+
+    /* Don't rewrite frames that were already played */
+    if (movie->undoFrame() < context->framecount)
+        return false;
+
+    beginResetModel();
+    movie->undo();
+    endResetModel();
+
+    /* The step may have changed the movie length */
+    context->config.sc.movie_framecount = movie->nbFrames();
+    context->config.sc_modified = true;
+    emit frameCountChanged();
+
+    return true;
+}
+
+bool InputEditorModel::redoInputs()
+{
+    if (!movie->canRedo())
+        return false;
+
+    /* Don't rewrite frames that were already played */
+    if (movie->redoFrame() < context->framecount)
+        return false;
+
+    beginResetModel();
+    movie->redo();
+    endResetModel();
+
+    /* The step may have changed the movie length */
+    context->config.sc.movie_framecount = movie->nbFrames();
+    context->config.sc_modified = true;
+    emit frameCountChanged();
+
+    return true;
 }
 
 void InputEditorModel::beginModifyInputs()
@@ -602,7 +718,14 @@ void InputEditorModel::beginModifyInputs()
 
 void InputEditorModel::endModifyInputs()
 {
-    buildInputSet();
+    /* Only rescan the whole movie for new columns when the input list was
+     * reloaded from a file. State loads that keep the current movie cannot
+     * introduce inputs, and rescanning 500k frames at every load would
+     * freeze the UI */
+    if (input_set_load_count != movie->input_load_count) {
+        input_set_load_count = movie->input_load_count;
+        buildInputSet();
+    }
     endResetModel();
     emit inputSetChanged();
 }
@@ -643,6 +766,13 @@ void InputEditorModel::update()
     else {
         emit dataChanged(createIndex(context->framecount,0), createIndex(context->framecount,columnCount()));
         // emit dataChanged(createIndex(0,0), createIndex(rowCount(),columnCount()));
+
+        /* Also repaint the row that was the current frame, because its
+         * background color changed */
+        if (last_current_frame != context->framecount) {
+            emit dataChanged(createIndex(last_current_frame,0), createIndex(last_current_frame,columnCount()));
+            last_current_frame = context->framecount;
+        }
     }
 }
 
@@ -650,7 +780,9 @@ void InputEditorModel::resetInputs()
 {
     beginResetModel();
     input_set.clear();
+    cached_descriptions.clear();
     savestate_frames.fill(-1);
+    last_current_frame = 0;
     endResetModel();
     emit inputSetChanged();
 }
@@ -97,6 +97,20 @@ public:
     /* Paste insert selected inputs. Returns the number of pasted inputs */
     int pasteInsertInputs(int row);
 
+    /* Ask the game loop to seek to a frame using the greenzone states */
+    void seekToFrame(unsigned long frame);
+
+    /* Return the marker text of a frame, or an empty string */
+    std::string getMarker(unsigned long frame);
+
+    /* Set or clear the marker text of a frame */
+    void setMarker(unsigned long frame, const std::string& text);
+
+    /* Undo/redo the last editing operation. Returns false if there is
+     * nothing to undo/redo, or if the step would rewrite past inputs */
+    bool undoInputs();
+    bool redoInputs();
+
 public slots:
     /* Toggle a single input and return the new value */
     bool toggleInput(const QModelIndex &index);
@@ -129,6 +143,17 @@ private:
     /* Set of inputs present in the movie */
     std::vector<SingleInput> input_set;
 
+    /* Cached QString of each column description, so that repaints don't
+     * rebuild it for every cell */
+    std::vector<QString> cached_descriptions;
+
+    /* Value of MovieFile::input_load_count when the input set was built, so
+     * that state loads which don't reload the movie skip the full rescan */
+    unsigned long input_set_load_count = 0;
+
+    /* Row that was the current frame at the last update, to repaint it */
+    unsigned long last_current_frame = 0;
+
     /* Array of framecount for savestates */
     std::array<unsigned long, 10> savestate_frames;
 
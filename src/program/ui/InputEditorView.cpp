@@ -19,9 +19,42 @@
 
 #include <QInputDialog>
 #include <QHeaderView>
+#include <QStyledItemDelegate>
+#include <QPainter>
 
 #include "InputEditorView.h"
 #include "MainWindow.h"
+#include "../utils.h"
+
+/* Item delegate painting cells directly from the cached model data. The
+ * default delegate goes through the full QStyle machinery per cell, which
+ * dominates repaint time on wide controller layouts; a cell here is one
+ * background fill and one text draw. */
+class InputEditorDelegate : public QStyledItemDelegate {
+public:
+    InputEditorDelegate(QObject *parent = Q_NULLPTR) : QStyledItemDelegate(parent) {}
+
+    void paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const override
+    {
+        const QAbstractItemModel *model = index.model();
+
+        if (option.state & QStyle::State_Selected) {
+            painter->fillRect(option.rect, option.palette.highlight());
+            painter->setPen(option.palette.color(QPalette::HighlightedText));
+        }
+        else {
+            /* The model caches its brushes, so this does not allocate */
+            painter->fillRect(option.rect, model->data(index, Qt::BackgroundRole).value<QBrush>());
+            painter->setPen(option.palette.color(QPalette::Text));
+        }
+
+        const QString text = model->data(index, Qt::DisplayRole).toString();
+        if (!text.isEmpty()) {
+            painter->setFont(model->data(index, Qt::FontRole).value<QFont>());
+            painter->drawText(option.rect, Qt::AlignCenter, text);
+        }
+    }
+};
 
 InputEditorView::InputEditorView(Context* c, QWidget *parent) : QTableView(parent), context(c)
 {
@@ -33,13 +66,25 @@ InputEditorView::InputEditorView(Context* c, QWidget *parent) : QTableView(paren
 
     MovieFile *movie = nullptr;
     MainWindow *mw = qobject_cast<MainWindow*>(parent->parent());
+    gameLoop = nullptr;
     if (mw) {
-        movie = &mw->gameLoop->movie;
+        gameLoop = mw->gameLoop;
+        movie = &gameLoop->movie;
     }
+    prefetched_slot = -1;
 
     inputEditorModel = new InputEditorModel(context, movie);
     setModel(inputEditorModel);
 
+    /* Lightweight cell painting, the analog editors still come from the
+     * styled delegate base */
+    setItemDelegate(new InputEditorDelegate(this));
+
+    /* Warm up the page cache of the state a seek from the selected frame
+     * would load, hiding the I/O latency of a cold state file behind the
+     * time the user spends editing */
+    connect(selectionModel(), &QItemSelectionModel::currentRowChanged, this, &InputEditorView::prefetchNearestState);
+
     connect(inputEditorModel, &InputEditorModel::inputSetChanged, this, &InputEditorView::resizeAllColumns);
 
     /* Horizontal header */
@@ -79,7 +124,7 @@ InputEditorView::InputEditorView(Context* c, QWidget *parent) : QTableView(paren
     connect(this, &QWidget::customContextMenuRequested, this, &InputEditorView::mainMenu);
 
     menu = new QMenu(this);
-    QAction* a = menu->addAction(tr("Insert"), this, &InputEditorView::insertInput, QKeySequence(Qt::CTRL + Qt::Key_Plus));
+    QAction* a = menu->addAction(tr("Undo"), this, &InputEditorView::undoInputs, QKeySequence::Undo);
 
     /* Shortcuts for context menus are special, they won't work by default
      * because the menu is hidden, so actions need to be added to the View as
@@ -94,6 +139,19 @@ InputEditorView::InputEditorView(Context* c, QWidget *parent) : QTableView(paren
 
     this->addAction(a);
 
+    a = menu->addAction(tr("Redo"), this, &InputEditorView::redoInputs, QKeySequence::Redo);
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 10, 0))
+    a->setShortcutVisibleInContextMenu(true);
+#endif
+    this->addAction(a);
+
+    menu->addSeparator();
+    a = menu->addAction(tr("Insert"), this, &InputEditorView::insertInput, QKeySequence(Qt::CTRL + Qt::Key_Plus));
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 10, 0))
+    a->setShortcutVisibleInContextMenu(true);
+#endif
+    this->addAction(a);
+
     menu->addAction(tr("Insert # frames"), this, &InputEditorView::insertInputs);
 
     a = menu->addAction(tr("Delete"), this, &InputEditorView::deleteInput, QKeySequence(Qt::CTRL + Qt::Key_Minus));
@@ -134,9 +192,37 @@ InputEditorView::InputEditorView(Context* c, QWidget *parent) : QTableView(paren
 #endif
     this->addAction(a);
 
+    a = menu->addAction(tr("Seek to frame"), this, &InputEditorView::seekToFrame, QKeySequence(Qt::CTRL + Qt::Key_G));
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 10, 0))
+    a->setShortcutVisibleInContextMenu(true);
+#endif
+    this->addAction(a);
+
+    a = menu->addAction(tr("Set marker"), this, &InputEditorView::setMarker, QKeySequence(Qt::CTRL + Qt::Key_M));
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 10, 0))
+    a->setShortcutVisibleInContextMenu(true);
+#endif
+    this->addAction(a);
+
     keyDialog = new KeyPressedDialog(this);
 }
 
+void InputEditorView::prefetchNearestState(const QModelIndex &current, const QModelIndex &previous)
+{
+    if (!gameLoop)
+        return;
+
+    if (context->config.sc.savestates_in_ram)
+        return;
+
+    int slot = gameLoop->greenzone.nearestState(current.row());
+    if ((slot < 0) || (slot == prefetched_slot))
+        return;
+
+    prefetch_savestate(context, Greenzone::FIRST_INDEX + slot);
+    prefetched_slot = slot;
+}
+
 void InputEditorView::resizeAllColumns()
 {
 
@@ -354,6 +440,45 @@ void InputEditorView::truncateInputs()
     inputEditorModel->removeRows(index.row()+1, nbRows-index.row()-1);
 }
 
+void InputEditorView::seekToFrame()
+{
+    const QModelIndex index = selectionModel()->currentIndex();
+
+    /* If no row was selected, return */
+    if (!index.isValid())
+        return;
+
+    inputEditorModel->seekToFrame(index.row());
+}
+
+void InputEditorView::setMarker()
+{
+    const QModelIndex index = selectionModel()->currentIndex();
+
+    /* If no row was selected, return */
+    if (!index.isValid())
+        return;
+
+    QString text = QString(inputEditorModel->getMarker(index.row()).c_str());
+
+    bool ok;
+    text = QInputDialog::getText(this, tr("Frame marker"),
+        tr("Marker text (empty to remove the marker):"), QLineEdit::Normal, text, &ok);
+
+    if (ok)
+        inputEditorModel->setMarker(index.row(), text.toStdString());
+}
+
+void InputEditorView::undoInputs()
+{
+    inputEditorModel->undoInputs();
+}
+
+void InputEditorView::redoInputs()
+{
+    inputEditorModel->redoInputs();
+}
+
 void InputEditorView::clearInput()
 {
     for (const QModelIndex index : selectionModel()->selectedRows()) {
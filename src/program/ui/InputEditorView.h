@@ -27,6 +27,8 @@
 #include "../Context.h"
 #include "KeyPressedDialog.h"
 
+class GameLoop;
+
 class InputEditorView : public QTableView {
     Q_OBJECT
 
@@ -55,6 +57,10 @@ public slots:
     void cutInputs();
     void pasteInputs();
     void pasteInsertInputs();
+    void seekToFrame();
+    void setMarker();
+    void undoInputs();
+    void redoInputs();
 
 protected:
     void mousePressEvent(QMouseEvent *event) override;
@@ -63,8 +69,19 @@ protected:
 private slots:
     void resizeAllColumns();
 
+    /* Prefetch the greenzone state nearest the selected frame, so that an
+     * upcoming seek does not stall on a cold state file */
+    void prefetchNearestState(const QModelIndex &current, const QModelIndex &previous);
+
 private:
     Context *context;
+
+    /* Game loop owning the greenzone, for the state prefetching */
+    GameLoop *gameLoop;
+
+    /* Last greenzone slot that was prefetched */
+    int prefetched_slot;
+
     QMenu *horMenu;
     QMenu *menu;
     int contextSection;
@@ -31,6 +31,7 @@
 
 #include "MainWindow.h"
 #include "../MovieFile.h"
+#include "../MovieDiff.h"
 #include "ErrorChecking.h"
 #include "../../shared/version.h"
 
@@ -64,17 +65,27 @@ MainWindow::MainWindow(Context* c) : QMainWindow(), context(c)
     connect(gameLoop, &GameLoop::askToShow, this, &MainWindow::alertOffer);
 
     /* Create other windows */
-    encodeWindow = new EncodeWindow(c, this);
-    inputWindow = new InputWindow(c, this);
-    executableWindow = new ExecutableWindow(c, this);
-    controllerTabWindow = new ControllerTabWindow(c, this);
+    /* Most tool windows are only built on their first open (see the
+     * getters), so that a cold start only pays for the main window. The
+     * input editor must exist from the start because its model records
+     * the movie inputs, and the game information window because it would
+     * miss the game info signal sent at launch. */
+    encodeWindow = nullptr;
+    inputWindow = nullptr;
+    executableWindow = nullptr;
+    controllerTabWindow = nullptr;
+    frameTimeWindow = nullptr;
+    allocStatsWindow = nullptr;
+    ramSearchWindow = nullptr;
+    ramWatchWindow = nullptr;
+    osdWindow = nullptr;
+    annotationsWindow = nullptr;
+    autoSaveWindow = nullptr;
+    previewWindow = nullptr;
+    saveStateWindow = nullptr;
+
     gameInfoWindow = new GameInfoWindow(this);
-    ramSearchWindow = new RamSearchWindow(c, this);
-    ramWatchWindow = new RamWatchWindow(c, this);
     inputEditorWindow = new InputEditorWindow(c, this);
-    osdWindow = new OsdWindow(c, this);
-    annotationsWindow = new AnnotationsWindow(c, this);
-    autoSaveWindow = new AutoSaveWindow(c, this);
 
     connect(inputEditorWindow->inputEditorView->inputEditorModel, &InputEditorModel::frameCountChanged, this, &MainWindow::updateFrameCountTime);
     connect(gameLoop, &GameLoop::inputsToBeChanged, inputEditorWindow->inputEditorView->inputEditorModel, &InputEditorModel::beginModifyInputs);
@@ -84,7 +95,6 @@ MainWindow::MainWindow(Context* c) : QMainWindow(), context(c)
     connect(gameLoop, &GameLoop::inputsToBeEdited, inputEditorWindow->inputEditorView->inputEditorModel, &InputEditorModel::beginEditInputs);
     connect(gameLoop, &GameLoop::inputsEdited, inputEditorWindow->inputEditorView->inputEditorModel, &InputEditorModel::endEditInputs);
     connect(gameLoop, &GameLoop::isInputEditorVisible, inputEditorWindow, &InputEditorWindow::isWindowVisible, Qt::DirectConnection);
-    connect(gameLoop, &GameLoop::getRamWatch, ramWatchWindow, &RamWatchWindow::slotGet, Qt::DirectConnection);
     connect(gameLoop, &GameLoop::savestatePerformed, inputEditorWindow->inputEditorView->inputEditorModel, &InputEditorModel::registerSavestate);
 
     /* Menu */
@@ -309,7 +319,24 @@ MainWindow::MainWindow(Context* c) : QMainWindow(), context(c)
 
     /* We are dumping from the command line */
     if (context->config.dumping) {
-        slotToggleEncode();
+        /* With a dump range, the game loop starts the encode itself when
+         * the first frame of the range is reached */
+        if (context->config.dump_range_start == 0)
+            slotToggleEncode();
+        slotPause(false);
+        slotFastForward(true);
+        slotLaunch();
+    }
+
+    /* We are verifying a movie from the command line */
+    if (context->config.verifying) {
+        slotPause(false);
+        slotFastForward(true);
+        slotLaunch();
+    }
+
+    /* We are running the brute-forcing bot from the command line */
+    if (!context->config.botfile.empty()) {
         slotPause(false);
         slotFastForward(true);
         slotLaunch();
@@ -324,6 +351,115 @@ MainWindow::~MainWindow()
         game_thread.detach();
 }
 
+/* Create-on-first-use accessors of the secondary windows. The getters of
+ * windows reflecting the config call their update function once, since the
+ * window may be created long after the config was loaded. */
+EncodeWindow* MainWindow::getEncodeWindow()
+{
+    if (!encodeWindow) {
+        encodeWindow = new EncodeWindow(context, this);
+        encodeWindow->update_config();
+    }
+    return encodeWindow;
+}
+
+InputWindow* MainWindow::getInputWindow()
+{
+    if (!inputWindow) {
+        inputWindow = new InputWindow(context, this);
+        inputWindow->update();
+    }
+    return inputWindow;
+}
+
+ExecutableWindow* MainWindow::getExecutableWindow()
+{
+    if (!executableWindow) {
+        executableWindow = new ExecutableWindow(context, this);
+        executableWindow->update_config();
+    }
+    return executableWindow;
+}
+
+ControllerTabWindow* MainWindow::getControllerTabWindow()
+{
+    if (!controllerTabWindow)
+        controllerTabWindow = new ControllerTabWindow(context, this);
+    return controllerTabWindow;
+}
+
+FrameTimeWindow* MainWindow::getFrameTimeWindow()
+{
+    if (!frameTimeWindow)
+        frameTimeWindow = new FrameTimeWindow(this);
+    return frameTimeWindow;
+}
+
+AllocStatsWindow* MainWindow::getAllocStatsWindow()
+{
+    if (!allocStatsWindow)
+        allocStatsWindow = new AllocStatsWindow(this);
+    return allocStatsWindow;
+}
+
+RamSearchWindow* MainWindow::getRamSearchWindow()
+{
+    if (!ramSearchWindow)
+        ramSearchWindow = new RamSearchWindow(context, this);
+    return ramSearchWindow;
+}
+
+RamWatchWindow* MainWindow::getRamWatchWindow()
+{
+    if (!ramWatchWindow) {
+        ramWatchWindow = new RamWatchWindow(context, this);
+        connect(gameLoop, &GameLoop::getRamWatch, ramWatchWindow, &RamWatchWindow::slotGet, Qt::DirectConnection);
+        connect(gameLoop, &GameLoop::pokeFrozenWatches, ramWatchWindow, &RamWatchWindow::slotFlushFrozen, Qt::DirectConnection);
+    }
+    return ramWatchWindow;
+}
+
+OsdWindow* MainWindow::getOsdWindow()
+{
+    if (!osdWindow) {
+        osdWindow = new OsdWindow(context, this);
+        osdWindow->update_config();
+    }
+    return osdWindow;
+}
+
+AnnotationsWindow* MainWindow::getAnnotationsWindow()
+{
+    if (!annotationsWindow) {
+        annotationsWindow = new AnnotationsWindow(context, this);
+        annotationsWindow->update();
+    }
+    return annotationsWindow;
+}
+
+AutoSaveWindow* MainWindow::getAutoSaveWindow()
+{
+    if (!autoSaveWindow) {
+        autoSaveWindow = new AutoSaveWindow(context, this);
+        autoSaveWindow->update_config();
+    }
+    return autoSaveWindow;
+}
+
+PreviewWindow* MainWindow::getPreviewWindow()
+{
+    if (!previewWindow)
+        previewWindow = new PreviewWindow(context, this);
+    return previewWindow;
+}
+
+SaveStateWindow* MainWindow::getSaveStateWindow()
+{
+    if (!saveStateWindow)
+        saveStateWindow = new SaveStateWindow(context, this);
+    return saveStateWindow;
+}
+
 bool MainWindow::eventFilter(QObject *obj, QEvent *event)
 {
     if (event->type() == QEvent::MouseButtonRelease) {
@@ -589,7 +725,7 @@ void MainWindow::createMenus()
 
     action = fileMenu->addAction(tr("Open Executable..."), this, &MainWindow::slotBrowseGamePath);
     disabledActionsOnStart.append(action);
-    action = fileMenu->addAction(tr("Executable Options..."), executableWindow, &ExecutableWindow::exec);
+    action = fileMenu->addAction(tr("Executable Options..."), this, [this]{ getExecutableWindow()->exec(); });
     disabledActionsOnStart.append(action);
 
     /* Movie Menu */
@@ -602,15 +738,21 @@ void MainWindow::createMenus()
     saveMovieAction->setEnabled(false);
     exportMovieAction = movieMenu->addAction(tr("Export Movie..."), this, &MainWindow::slotExportMovie);
     exportMovieAction->setEnabled(false);
+    compareMovieAction = movieMenu->addAction(tr("Compare Movie..."), this, &MainWindow::slotCompareMovie);
+    compareMovieAction->setEnabled(false);
+    compareMovieAction->setToolTip("Compare the inputs of the current movie with another movie file");
+    mergeMovieAction = movieMenu->addAction(tr("Merge Movie..."), this, &MainWindow::slotMergeMovie);
+    mergeMovieAction->setEnabled(false);
+    mergeMovieAction->setToolTip("Merge the changes of another movie variant into the current movie, relative to a common base movie");
 
     movieMenu->addSeparator();
 
-    annotateMovieAction = movieMenu->addAction(tr("Annotations..."), annotationsWindow, &AnnotationsWindow::show);
+    annotateMovieAction = movieMenu->addAction(tr("Annotations..."), this, [this]{ getAnnotationsWindow()->show(); });
     annotateMovieAction->setEnabled(false);
 
     movieMenu->addSeparator();
 
-    movieMenu->addAction(tr("Autosave..."), autoSaveWindow, &AutoSaveWindow::show);
+    movieMenu->addAction(tr("Autosave..."), this, [this]{ getAutoSaveWindow()->show(); });
 
     movieMenu->addSeparator();
 
@@ -620,6 +762,14 @@ void MainWindow::createMenus()
     autoRestartAction->setToolTip("When checked, the game will automatically restart if closed, except when using the Stop button");
     disabledActionsOnStart.append(autoRestartAction);
 
+    zygoteRestartAction = movieMenu->addAction(tr("In-place game restarts"), this, &MainWindow::slotZygoteRestart);
+    zygoteRestartAction->setCheckable(true);
+    zygoteRestartAction->setToolTip("When checked, game restarts are performed by loading a pristine boot state into the running process, skipping the game relaunch and engine boot");
+
+    stateDigestAction = movieMenu->addAction(tr("Record state digests"), this, &MainWindow::slotStateDigest);
+    stateDigestAction->setCheckable(true);
+    stateDigestAction->setToolTip("Record a sampled digest of the game state at each frame into the movie. Replaying the movie reports the exact first frame where the game diverged from it");
+
     QMenu *movieEndMenu = movieMenu->addMenu(tr("On Movie End"));
     movieEndMenu->addActions(movieEndGroup->actions());
     movieMenu->addAction(tr("Input Editor..."), inputEditorWindow, &InputEditorWindow::show);
@@ -647,7 +797,7 @@ void MainWindow::createMenus()
 #ifdef LIBTAS_ENABLE_HUD
     QMenu *osdMenu = videoMenu->addMenu(tr("OSD"));
     osdMenu->addActions(osdGroup->actions());
-    osdMenu->addAction(tr("OSD Options..."), osdWindow, &OsdWindow::exec);
+    osdMenu->addAction(tr("OSD Options..."), this, [this]{ getOsdWindow()->exec(); });
     osdMenu->addSeparator();
     osdEncodeAction = osdMenu->addAction(tr("OSD on video encode"), this, &MainWindow::slotOsdEncode);
     osdEncodeAction->setCheckable(true);
@@ -708,11 +858,44 @@ void MainWindow::createMenus()
     ramStateAction->setToolTip("Storing savestates in RAM can provide a speed-up, but beware of your available memory");
     disabledActionsOnStart.append(ramStateAction);
 
+    compressedStateAction = savestateMenu->addAction(tr("Compressed savestates"), this, &MainWindow::slotCompressedState);
+    compressedStateAction->setCheckable(true);
+    compressedStateAction->setToolTip("Compress savestate memory pages with zstd, reducing the savestate size and disk writes. Requires the library to be built with zstd support");
+    disabledActionsOnStart.append(compressedStateAction);
+
+    backgroundStateAction = savestateMenu->addAction(tr("Background savestates"), this, &MainWindow::slotBackgroundState);
+    backgroundStateAction->setCheckable(true);
+    backgroundStateAction->setToolTip("Perform the savestate memory dump in a forked process, so that the game only freezes for the duration of the fork");
+    disabledActionsOnStart.append(backgroundStateAction);
+
+    dedupStateAction = savestateMenu->addAction(tr("Deduplicated savestates"), this, &MainWindow::slotDedupState);
+    dedupStateAction->setCheckable(true);
+    dedupStateAction->setToolTip("Store identical memory pages only once in a page store shared by all savestate slots, largely reducing the disk usage of multiple slots");
+    disabledActionsOnStart.append(dedupStateAction);
+
+    checksumStateAction = savestateMenu->addAction(tr("Checksummed savestates"), this, &MainWindow::slotChecksumState);
+    checksumStateAction->setCheckable(true);
+    checksumStateAction->setToolTip("Store a checksum of the state files when saving and verify it when loading, so that a corrupted savestate is reported at load time instead of crashing the game later");
+    disabledActionsOnStart.append(checksumStateAction);
+
+    rewindStateAction = savestateMenu->addAction(tr("Rewind savestates"), this, &MainWindow::slotRewindState);
+    rewindStateAction->setCheckable(true);
+    rewindStateAction->setToolTip("Save a state at each frame boundary in a ring buffer, so that the rewind hotkey can step back one frame almost instantly. Requires incremental savestates stored in RAM");
+    disabledActionsOnStart.append(rewindStateAction);
+
+    mmapStateAction = savestateMenu->addAction(tr("Memory-mapped loading"), this, &MainWindow::slotMmapState);
+    mmapStateAction->setCheckable(true);
+    mmapStateAction->setToolTip("Load file-backed states by memory-mapping the pages file, so that the state content is faulted in lazily and the game resumes earlier");
+    disabledActionsOnStart.append(mmapStateAction);
+
     backtrackStateAction = savestateMenu->addAction(tr("Backtrack savestate"), this, &MainWindow::slotBacktrackState);
     backtrackStateAction->setCheckable(true);
     backtrackStateAction->setToolTip("Save a state whenether a thread is created/destroyed, so that you can rewind to the earliest time possible");
     disabledActionsOnStart.append(backtrackStateAction);
 
+    QAction *ignoreAction = savestateMenu->addAction(tr("Excluded memory areas..."), this, &MainWindow::slotSavestateIgnore);
+    ignoreAction->setToolTip("Skip memory areas whose mapped file path matches one of these patterns when saving a state. The game reports large file-backed areas as candidates in its log");
+
     saveScreenAction = runtimeMenu->addAction(tr("Save screen"), this, &MainWindow::slotSaveScreen);
     saveScreenAction->setCheckable(true);
     saveScreenAction->setToolTip("Save the screen pixels on memory, used for video encode, OSD, etc. You probably want this to be checked except if the screen is going black");
@@ -727,6 +910,19 @@ void MainWindow::createMenus()
     steamAction->setToolTip("Implement a dummy Steam client, to be able to launch some Steam games");
     steamAction->setCheckable(true);
     disabledActionsOnStart.append(steamAction);
+    deterministicHeapAction = runtimeMenu->addAction(tr("Deterministic heap allocator"), this, &MainWindow::slotDeterministicHeap);
+    deterministicHeapAction->setToolTip("Serve game allocations from a deterministic arena, so identical replays produce identical heap layouts. Reduces incremental savestate sizes. Can crash on some games");
+    deterministicHeapAction->setCheckable(true);
+    disabledActionsOnStart.append(deterministicHeapAction);
+
+    fastPrngAction = runtimeMenu->addAction(tr("Fast PRNG"), this, &MainWindow::slotFastPrng);
+    fastPrngAction->setToolTip("Serve rand()/random() from a fast in-library generator instead of libc. The random sequence differs from libc but stays identical across replays. Speeds up procedural level generation");
+    fastPrngAction->setCheckable(true);
+    disabledActionsOnStart.append(fastPrngAction);
+
+    allocProfilingAction = runtimeMenu->addAction(tr("Allocation profiling"), this, &MainWindow::slotAllocProfiling);
+    allocProfilingAction->setToolTip("Sample game allocations and show per-callsite rates in Tools > Allocation profile. Helps picking savestate intervals and memory exclusion rules");
+    allocProfilingAction->setCheckable(true);
 
     QMenu *asyncMenu = runtimeMenu->addMenu(tr("Asynchronous events"));
     asyncMenu->setToolTip("Only useful if the game pulls events asynchronously. We wait until all events are processed at the beginning of each frame");
@@ -758,7 +954,7 @@ void MainWindow::createMenus()
 
     /* Tools Menu */
     QMenu *toolsMenu = menuBar()->addMenu(tr("Tools"));
-    configEncodeAction = toolsMenu->addAction(tr("Configure encode..."), encodeWindow, &EncodeWindow::exec);
+    configEncodeAction = toolsMenu->addAction(tr("Configure encode..."), this, [this]{ getEncodeWindow()->exec(); });
     toggleEncodeAction = toolsMenu->addAction(tr("Start encode"), this, &MainWindow::slotToggleEncode);
 
     toolsMenu->addSeparator();
@@ -774,17 +970,21 @@ void MainWindow::createMenus()
     toolsMenu->addSeparator();
 
     toolsMenu->addAction(tr("Game information..."), gameInfoWindow, &GameInfoWindow::exec);
+    toolsMenu->addAction(tr("Frame timing..."), this, [this]{ getFrameTimeWindow()->show(); });
+    toolsMenu->addAction(tr("Allocation profile..."), this, [this]{ getAllocStatsWindow()->show(); });
+    toolsMenu->addAction(tr("Game preview..."), this, [this]{ getPreviewWindow()->show(); });
+    toolsMenu->addAction(tr("Savestate slots..."), this, [this]{ getSaveStateWindow()->show(); });
 
     toolsMenu->addSeparator();
 
-    toolsMenu->addAction(tr("Ram Search..."), ramSearchWindow, &RamSearchWindow::show);
-    toolsMenu->addAction(tr("Ram Watch..."), ramWatchWindow, &RamWatchWindow::show);
+    toolsMenu->addAction(tr("Ram Search..."), this, [this]{ getRamSearchWindow()->show(); });
+    toolsMenu->addAction(tr("Ram Watch..."), this, [this]{ getRamWatchWindow()->show(); });
 
     /* Input Menu */
     QMenu *inputMenu = menuBar()->addMenu(tr("Input"));
     inputMenu->setToolTipsVisible(true);
 
-    inputMenu->addAction(tr("Configure mapping..."), inputWindow, &InputWindow::exec);
+    inputMenu->addAction(tr("Configure mapping..."), this, [this]{ getInputWindow()->exec(); });
 
     keyboardAction = inputMenu->addAction(tr("Keyboard support"));
     keyboardAction->setCheckable(true);
@@ -797,7 +997,7 @@ void MainWindow::createMenus()
     joystickMenu->addActions(joystickGroup->actions());
     disabledWidgetsOnStart.append(joystickMenu);
 
-    inputMenu->addAction(tr("Joystick inputs..."), controllerTabWindow, &ControllerTabWindow::show);
+    inputMenu->addAction(tr("Joystick inputs..."), this, [this]{ getControllerTabWindow()->show(); });
 
     action = inputMenu->addAction(tr("Recalibrate mouse position"), this, &MainWindow::slotCalibrateMouse);
     action->setToolTip("If there is an offset between the system cursor and the game cursor, select this while paused, then click on the game cursor to register an offset. This does not affect movie sync");
@@ -825,6 +1025,8 @@ void MainWindow::updateStatus()
             }
             saveMovieAction->setEnabled(false);
             exportMovieAction->setEnabled(false);
+            compareMovieAction->setEnabled(false);
+            mergeMovieAction->setEnabled(false);
 
             movieBox->setCheckable(true);
             movieBox->setChecked(context->config.sc.recording != SharedConfig::NO_RECORDING);
@@ -874,6 +1076,9 @@ void MainWindow::updateStatus()
             if (context->config.sc.recording != SharedConfig::NO_RECORDING) {
                 saveMovieAction->setEnabled(true);
                 exportMovieAction->setEnabled(true);
+                compareMovieAction->setEnabled(true);
+                /* Merging rewrites the input list, so it needs write mode */
+                mergeMovieAction->setEnabled(context->config.sc.recording == SharedConfig::RECORDING_WRITE);
             }
 
             break;
@@ -989,10 +1194,11 @@ void MainWindow::updateFps(float fps, float lfps)
 
 void MainWindow::updateRam()
 {
-    if (ramSearchWindow->isVisible()) {
+    if (ramSearchWindow && ramSearchWindow->isVisible()) {
         ramSearchWindow->update();
     }
-    ramWatchWindow->update();
+    if (ramWatchWindow)
+        ramWatchWindow->update();
 }
 
 void MainWindow::updateInputEditor()
@@ -1058,7 +1264,8 @@ void MainWindow::updateMovieParams()
             context->config.sc.recording = SharedConfig::RECORDING_READ;
             context->config.sc_modified = true;
         }
-        annotationsWindow->update();
+        if (annotationsWindow)
+            annotationsWindow->update();
     }
     else {
         movieFrameCount->setValue(0);
@@ -1072,7 +1279,8 @@ void MainWindow::updateMovieParams()
             context->config.sc.recording = SharedConfig::RECORDING_WRITE;
             context->config.sc_modified = true;
         }
-        annotationsWindow->clear();
+        if (annotationsWindow)
+            annotationsWindow->clear();
     }
 }
 
@@ -1143,10 +1351,19 @@ void MainWindow::updateUIFromConfig()
     preventSavefileAction->setChecked(context->config.sc.prevent_savefiles);
     recycleThreadsAction->setChecked(context->config.sc.recycle_threads);
     steamAction->setChecked(context->config.sc.virtual_steam);
+    deterministicHeapAction->setChecked(context->config.sc.deterministic_heap);
+    allocProfilingAction->setChecked(context->config.sc.alloc_profiling);
+    fastPrngAction->setChecked(context->config.sc.fast_prng);
     setCheckboxesFromMask(asyncGroup, context->config.sc.async_events);
 
     incrementalStateAction->setChecked(context->config.sc.incremental_savestates);
     ramStateAction->setChecked(context->config.sc.savestates_in_ram);
+    compressedStateAction->setChecked(context->config.sc.compressed_savestates);
+    backgroundStateAction->setChecked(context->config.sc.background_savestates);
+    dedupStateAction->setChecked(context->config.sc.dedup_savestates);
+    checksumStateAction->setChecked(context->config.sc.checksum_savestates);
+    rewindStateAction->setChecked(context->config.sc.rewind_savestates);
+    mmapStateAction->setChecked(context->config.sc.mmap_loadstates);
     backtrackStateAction->setChecked(context->config.sc.backtrack_savestate);
 
     setCheckboxesFromMask(fastforwardGroup, context->config.sc.fastforward_mode);
@@ -1154,6 +1371,8 @@ void MainWindow::updateUIFromConfig()
     setRadioFromList(movieEndGroup, context->config.on_movie_end);
 
     autoRestartAction->setChecked(context->config.auto_restart);
+    zygoteRestartAction->setChecked(context->config.zygote_restart);
+    stateDigestAction->setChecked(context->config.sc.state_digest);
 
     updateStatusBar();
 }
@@ -1300,11 +1519,17 @@ void MainWindow::slotGamePathChanged()
 
     /* Update the UI accordingly */
     updateUIFromConfig();
-    encodeWindow->update_config();
-    executableWindow->update_config();
-    inputWindow->update();
-    osdWindow->update_config();
-    autoSaveWindow->update_config();
+    /* Windows not created yet read the config when they are (see the getters) */
+    if (encodeWindow)
+        encodeWindow->update_config();
+    if (executableWindow)
+        executableWindow->update_config();
+    if (inputWindow)
+        inputWindow->update();
+    if (osdWindow)
+        osdWindow->update_config();
+    if (autoSaveWindow)
+        autoSaveWindow->update_config();
 }
 
 void MainWindow::slotBrowseMoviePath()
@@ -1348,6 +1573,111 @@ void MainWindow::slotExportMovie()
     }
 }
 
+void MainWindow::slotCompareMovie()
+{
+    if (context->config.sc.recording == SharedConfig::NO_RECORDING)
+        return;
+
+    QString filename = QFileDialog::getOpenFileName(this, tr("Choose a movie to compare with"), context->config.moviefile.c_str(), tr("libTAS movie files (*.ltm)"));
+    if (filename.isNull())
+        return;
+
+    MovieFile other(context);
+    int ret = other.loadInputs(filename.toStdString());
+    if (ret < 0) {
+        QMessageBox::warning(this, "Warning", MovieFile::errorString(ret));
+        return;
+    }
+
+    std::vector<MovieDiffOp> ops = MovieDiff::diff(gameLoop->movie, other);
+
+    /* Build a summary of the differing ranges, 1-based like the input editor */
+    QString report;
+    int changes = 0;
+    for (const MovieDiffOp& op : ops) {
+        if (op.type == MovieDiffOp::EQUAL)
+            continue;
+        changes++;
+        if (changes > 20)
+            continue;
+        switch (op.type) {
+            case MovieDiffOp::REPLACE:
+                report += tr("Frames %1-%2 differ (%3 frames in the other movie)\n")
+                    .arg(op.first_start + 1).arg(op.first_start + op.first_count)
+                    .arg(op.second_count);
+                break;
+            case MovieDiffOp::INSERT:
+                report += tr("%1 frames of the other movie are inserted before frame %2\n")
+                    .arg(op.second_count).arg(op.first_start + 1);
+                break;
+            case MovieDiffOp::DELETE:
+                report += tr("Frames %1-%2 are absent from the other movie\n")
+                    .arg(op.first_start + 1).arg(op.first_start + op.first_count);
+                break;
+        }
+    }
+    if (changes == 0)
+        report = tr("The movies have identical inputs");
+    else if (changes > 20)
+        report += tr("... and %1 more differing ranges").arg(changes - 20);
+
+    QMessageBox::information(this, tr("Movie comparison"), report);
+}
+
+void MainWindow::slotMergeMovie()
+{
+    if (context->config.sc.recording != SharedConfig::RECORDING_WRITE)
+        return;
+
+    QString basefile = QFileDialog::getOpenFileName(this, tr("Choose the common base movie"), context->config.moviefile.c_str(), tr("libTAS movie files (*.ltm)"));
+    if (basefile.isNull())
+        return;
+    QString theirsfile = QFileDialog::getOpenFileName(this, tr("Choose the movie to merge in"), context->config.moviefile.c_str(), tr("libTAS movie files (*.ltm)"));
+    if (theirsfile.isNull())
+        return;
+
+    MovieFile baseMovie(context);
+    int ret = baseMovie.loadInputs(basefile.toStdString());
+    if (ret < 0) {
+        QMessageBox::warning(this, "Warning", MovieFile::errorString(ret));
+        return;
+    }
+    MovieFile theirsMovie(context);
+    ret = theirsMovie.loadInputs(theirsfile.toStdString());
+    if (ret < 0) {
+        QMessageBox::warning(this, "Warning", MovieFile::errorString(ret));
+        return;
+    }
+
+    std::vector<AllInputs> merged;
+    std::vector<std::pair<unsigned long, unsigned long>> conflicts;
+    MovieDiff::merge(baseMovie, gameLoop->movie, theirsMovie, merged, conflicts);
+
+    /* Rewrite the input list with the merged one, as a single undo step */
+    gameLoop->movie.beginEditGroup();
+    gameLoop->movie.truncateInputs(0);
+    for (size_t i = 0; i < merged.size(); i++)
+        gameLoop->movie.insertInputsBefore(merged[i], i);
+    gameLoop->movie.endEditGroup();
+
+    /* The whole movie changed, so the input editor must rebuild its columns */
+    gameLoop->movie.input_load_count++;
+    context->config.sc.movie_framecount = gameLoop->movie.nbFrames();
+    context->config.sc_modified = true;
+    movieFrameCount->setValue(context->config.sc.movie_framecount);
+    inputEditorWindow->inputEditorView->update();
+
+    QString report = tr("Merged %1 frames").arg(merged.size());
+    if (!conflicts.empty()) {
+        report += tr(", with %1 conflicting changes dropped:\n").arg(conflicts.size());
+        for (size_t i = 0; (i < conflicts.size()) && (i < 10); i++)
+            report += tr("Around frame %1\n").arg(conflicts[i].first + 1);
+        if (conflicts.size() > 10)
+            report += tr("...");
+    }
+    QMessageBox::information(this, tr("Movie merge"), report);
+}
+
 void MainWindow::slotPauseMovie()
 {
     context->pause_frame = QInputDialog::getInt(this, tr("Pause Movie"),
@@ -1355,6 +1685,18 @@ void MainWindow::slotPauseMovie()
         context->pause_frame);
 }
 
+void MainWindow::slotSavestateIgnore()
+{
+    bool ok;
+    QString text = QInputDialog::getMultiLineText(this, tr("Excluded memory areas"),
+        tr("Mapped file path patterns excluded from savestates, one fnmatch() glob per line:"),
+        QString(context->config.savestate_ignore_paths.c_str()), &ok);
+    if (ok) {
+        context->config.savestate_ignore_paths = text.toStdString();
+        context->config.savestate_ignore_modified = true;
+    }
+}
+
 void MainWindow::slotPause(bool checked)
 {
     if (context->status == Context::INACTIVE) {
@@ -1520,6 +1862,9 @@ BOOLSLOT(slotSaveScreen, context->config.sc.save_screenpixels)
 BOOLSLOT(slotPreventSavefile, context->config.sc.prevent_savefiles)
 BOOLSLOT(slotRecycleThreads, context->config.sc.recycle_threads)
 BOOLSLOT(slotSteam, context->config.sc.virtual_steam)
+BOOLSLOT(slotDeterministicHeap, context->config.sc.deterministic_heap)
+BOOLSLOT(slotAllocProfiling, context->config.sc.alloc_profiling)
+BOOLSLOT(slotFastPrng, context->config.sc.fast_prng)
 BOOLSLOT(slotAsyncEvents, context->config.sc.async_events)
 
 void MainWindow::slotMovieEnd()
@@ -1529,8 +1874,16 @@ void MainWindow::slotMovieEnd()
 
 BOOLSLOT(slotIncrementalState, context->config.sc.incremental_savestates)
 BOOLSLOT(slotRamState, context->config.sc.savestates_in_ram)
+BOOLSLOT(slotCompressedState, context->config.sc.compressed_savestates)
+BOOLSLOT(slotBackgroundState, context->config.sc.background_savestates)
+BOOLSLOT(slotDedupState, context->config.sc.dedup_savestates)
+BOOLSLOT(slotChecksumState, context->config.sc.checksum_savestates)
+BOOLSLOT(slotRewindState, context->config.sc.rewind_savestates)
+BOOLSLOT(slotMmapState, context->config.sc.mmap_loadstates)
 BOOLSLOT(slotBacktrackState, context->config.sc.backtrack_savestate)
 BOOLSLOT(slotAutoRestart, context->config.auto_restart)
+BOOLSLOT(slotZygoteRestart, context->config.zygote_restart)
+BOOLSLOT(slotStateDigest, context->config.sc.state_digest)
 
 void MainWindow::alertOffer(QString alert_msg, void* promise)
 {
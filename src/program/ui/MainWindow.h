@@ -38,12 +38,16 @@
 #include "InputWindow.h"
 #include "ControllerTabWindow.h"
 #include "GameInfoWindow.h"
+#include "FrameTimeWindow.h"
+#include "AllocStatsWindow.h"
 #include "RamSearchWindow.h"
 #include "RamWatchWindow.h"
 #include "InputEditorWindow.h"
 #include "OsdWindow.h"
 #include "AnnotationsWindow.h"
 #include "AutoSaveWindow.h"
+#include "PreviewWindow.h"
+#include "SaveStateWindow.h"
 #include "../GameLoop.h"
 #include "../Context.h"
 
@@ -61,26 +65,53 @@ public:
     GameLoop *gameLoop;
     Context *context;
 
+    /* Secondary tool windows. Except for the input editor and the game
+     * information window, they are created on first open through the
+     * getters below, so that a cold start only builds the main window.
+     * The pointers stay null until then. */
     EncodeWindow* encodeWindow;
     InputWindow* inputWindow;
     ExecutableWindow* executableWindow;
     ControllerTabWindow* controllerTabWindow;
     GameInfoWindow* gameInfoWindow;
+    FrameTimeWindow* frameTimeWindow;
+    AllocStatsWindow* allocStatsWindow;
     RamSearchWindow* ramSearchWindow;
     RamWatchWindow* ramWatchWindow;
     InputEditorWindow* inputEditorWindow;
     OsdWindow* osdWindow;
     AnnotationsWindow* annotationsWindow;
     AutoSaveWindow* autoSaveWindow;
+    PreviewWindow* previewWindow;
+    SaveStateWindow* saveStateWindow;
+
+    /* Create-on-first-use accessors of the secondary windows above */
+    EncodeWindow* getEncodeWindow();
+    InputWindow* getInputWindow();
+    ExecutableWindow* getExecutableWindow();
+    ControllerTabWindow* getControllerTabWindow();
+    FrameTimeWindow* getFrameTimeWindow();
+    AllocStatsWindow* getAllocStatsWindow();
+    RamSearchWindow* getRamSearchWindow();
+    RamWatchWindow* getRamWatchWindow();
+    OsdWindow* getOsdWindow();
+    AnnotationsWindow* getAnnotationsWindow();
+    AutoSaveWindow* getAutoSaveWindow();
+    PreviewWindow* getPreviewWindow();
+    SaveStateWindow* getSaveStateWindow();
 
     QList<QWidget*> disabledWidgetsOnStart;
     QList<QAction*> disabledActionsOnStart;
 
     QAction *saveMovieAction;
     QAction *exportMovieAction;
+    QAction *compareMovieAction;
+    QAction *mergeMovieAction;
     QAction *annotateMovieAction;
 
     QAction *autoRestartAction;
+    QAction *zygoteRestartAction;
+    QAction *stateDigestAction;
     QActionGroup *movieEndGroup;
     QActionGroup *screenResGroup;
 
@@ -105,8 +136,17 @@ public:
 
     QAction *incrementalStateAction;
     QAction *ramStateAction;
+    QAction *compressedStateAction;
+    QAction *backgroundStateAction;
+    QAction *dedupStateAction;
+    QAction *checksumStateAction;
+    QAction *rewindStateAction;
+    QAction *mmapStateAction;
     QAction *backtrackStateAction;
     QAction *steamAction;
+    QAction *deterministicHeapAction;
+    QAction *allocProfilingAction;
+    QAction *fastPrngAction;
     QActionGroup *waitGroup;
     QActionGroup *asyncGroup;
 
@@ -252,6 +292,8 @@ private slots:
     void slotMoviePathChanged();
     void slotSaveMovie();
     void slotExportMovie();
+    void slotCompareMovie();
+    void slotMergeMovie();
     void slotPause(bool checked);
     void slotFastForward(bool checked);
     void slotMovieEnable(bool checked);
@@ -275,12 +317,24 @@ private slots:
     void slotPauseMovie();
     void slotIncrementalState(bool checked);
     void slotRamState(bool checked);
+    void slotCompressedState(bool checked);
+    void slotBackgroundState(bool checked);
+    void slotDedupState(bool checked);
+    void slotChecksumState(bool checked);
+    void slotRewindState(bool checked);
+    void slotMmapState(bool checked);
     void slotBacktrackState(bool checked);
+    void slotSavestateIgnore();
     void slotRecycleThreads(bool checked);
     void slotSteam(bool checked);
+    void slotDeterministicHeap(bool checked);
+    void slotAllocProfiling(bool checked);
+    void slotFastPrng(bool checked);
     void slotAsyncEvents(bool checked);
     void slotCalibrateMouse();
     void slotAutoRestart(bool checked);
+    void slotZygoteRestart(bool checked);
+    void slotStateDigest(bool checked);
 };
 
 #endif
@@ -19,12 +19,115 @@
 
 #include "PointerScanModel.h"
 
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+/* Header of the pointer map file, followed by the static then the dynamic
+ * PointerPair arrays, both sorted by pointer value */
+struct PointerMapHeader {
+    uint64_t magic;
+    uint64_t framecount;
+    /* Rerecord count when the map was built. The count only grows when a
+     * state load discards modified inputs, which is the one case where a
+     * replay can reach the same frame with different memory contents */
+    uint64_t rerecords;
+    uint64_t static_count;
+    uint64_t dynamic_count;
+};
+
+static const uint64_t POINTERMAP_MAGIC = 0x4c54415350545232; /* "LTASPTR2" */
+
+/* Sections are read with a few process_vm_readv calls of this size */
+static const size_t SCAN_CHUNK_SIZE = 1024 * 1024;
+
 PointerScanModel::PointerScanModel(Context* c, QObject *parent) : QAbstractTableModel(parent), context(c) {}
 
+PointerScanModel::~PointerScanModel()
+{
+    unloadPointerMap();
+}
+
+std::string PointerScanModel::pointerMapPath() const
+{
+    return context->config.savestatedir + "/" + context->gamename + ".pointermap";
+}
+
+void PointerScanModel::unloadPointerMap()
+{
+    if (map_base) {
+        munmap(map_base, map_length);
+        map_base = nullptr;
+        map_length = 0;
+    }
+    static_pairs = nullptr;
+    static_count = 0;
+    dynamic_pairs = nullptr;
+    dynamic_count = 0;
+}
+
+bool PointerScanModel::loadPointerMap()
+{
+    /* The current mapping can be reused if it was taken at the same frame
+     * of the same replay */
+    if (map_base) {
+        const PointerMapHeader* header = static_cast<const PointerMapHeader*>(map_base);
+        if ((header->framecount == context->framecount) &&
+            (header->rerecords == context->rerecord_count))
+            return true;
+        unloadPointerMap();
+    }
+
+    int fd = open(pointerMapPath().c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat sb;
+    if (fstat(fd, &sb) < 0 || static_cast<size_t>(sb.st_size) < sizeof(PointerMapHeader)) {
+        close(fd);
+        return false;
+    }
+
+    void* base = mmap(nullptr, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return false;
+
+    const PointerMapHeader* header = static_cast<const PointerMapHeader*>(base);
+    size_t expected = sizeof(PointerMapHeader) + (header->static_count + header->dynamic_count) * sizeof(PointerPair);
+    if ((header->magic != POINTERMAP_MAGIC) ||
+        (header->framecount != context->framecount) ||
+        (header->rerecords != context->rerecord_count) ||
+        (static_cast<size_t>(sb.st_size) < expected)) {
+        munmap(base, sb.st_size);
+        return false;
+    }
+
+    map_base = base;
+    map_length = sb.st_size;
+    static_pairs = reinterpret_cast<const PointerPair*>(header + 1);
+    static_count = header->static_count;
+    dynamic_pairs = static_pairs + static_count;
+    dynamic_count = header->dynamic_count;
+    return true;
+}
+
 void PointerScanModel::locatePointers()
 {
-    pointer_map.clear();
-    static_pointer_map.clear();
+    /* Reuse the pointer map spilled by a previous scan at the same frame.
+     * The game runs without address randomization, so a rescan after a game
+     * restart sees the same addresses and can binary-search the file
+     * instead of redoing the scan. */
+    if (loadPointerMap())
+        return;
+
+    own_static_pairs.clear();
+    own_dynamic_pairs.clear();
 
     /* Compose the filename for the /proc memory map, and open it. */
     std::ostringstream oss;
@@ -39,7 +142,7 @@ void PointerScanModel::locatePointers()
     MemSection::reset();
 
     std::vector<MemSection> memory_sections;
-    int total_size = 0;
+    size_t total_size = 0;
     while (std::getline(mapsfile, line)) {
 
         MemSection section;
@@ -47,122 +150,272 @@ void PointerScanModel::locatePointers()
 
         /* Only store sections that could contain pointers */
         if (section.type & (MemSection::MemDataRW | MemSection::MemBSS | MemSection::MemHeap | MemSection::MemAnonymousMappingRW)) {
-        // if (section.type & (MemSection::MemDataRW | MemSection::MemBSS | MemSection::MemHeap)) {
             memory_sections.push_back(section);
             total_size += section.size;
         }
     }
 
-    /* Read all memory and store all pointers */
-    int cur_size = 0;
-    for (const MemSection &section : memory_sections) {
-
-        struct iovec local, remote;
-        for (uintptr_t addr = section.addr; addr < section.endaddr; addr += 4096) {
-
-            /* Read values in chunks of 4096 bytes so we lower the number
-             * of `process_vm_readv` calls.
-             */
-            uintptr_t chunk[4096/sizeof(uintptr_t)];
-            local.iov_base = static_cast<void*>(chunk);
-            local.iov_len = 4096;
-            remote.iov_base = reinterpret_cast<void*>(addr);
-            remote.iov_len = 4096;
-
-            int readValues = process_vm_readv(context->game_pid, &local, 1, &remote, 1, 0);
-            if (readValues < 0) {
-                continue;
-            }
-
-            for (unsigned int i = 0; i < readValues/sizeof(uintptr_t); i++, cur_size += sizeof(uintptr_t)) {
-
-                /* Update progress bar */
-                if (!(cur_size & 0xfff)) {
-                    emit signalProgress((int)(100 * ((float)cur_size / total_size)));
-                }
+    /* Split the sections into chunk-sized work items shared between one
+     * worker thread per core */
+    struct WorkItem {
+        uintptr_t addr;
+        uintptr_t endaddr;
+        bool is_static;
+    };
+    std::vector<WorkItem> items;
 
-                /* Check if the value could be a pointer */
-                bool isPointer = false;
+    for (const MemSection &section : memory_sections) {
+        for (uintptr_t addr = section.addr; addr < section.endaddr; addr += SCAN_CHUNK_SIZE) {
+            WorkItem item;
+            item.addr = addr;
+            item.endaddr = (section.endaddr - addr > SCAN_CHUNK_SIZE) ? (addr + SCAN_CHUNK_SIZE) : section.endaddr;
+            item.is_static = section.type & (MemSection::MemDataRW | MemSection::MemBSS);
+            items.push_back(item);
+        }
+    }
 
-                for (const MemSection &ms : memory_sections) {
-                    /* If pointing to a static section, we can skip it */
-                    if (ms.type & (MemSection::MemDataRW | MemSection::MemBSS)) {
-                        continue;
+    unsigned int nthreads = std::thread::hardware_concurrency();
+    if (nthreads == 0)
+        nthreads = 1;
+    if (nthreads > items.size())
+        nthreads = items.size();
+    if (nthreads == 0)
+        nthreads = 1;
+
+    /* Per-thread staging vectors, merged and sorted below */
+    std::vector<std::vector<PointerPair>> t_static(nthreads);
+    std::vector<std::vector<PointerPair>> t_dynamic(nthreads);
+
+    std::atomic<size_t> next_item(0);
+    std::atomic<size_t> scanned_size(0);
+
+    auto worker = [&] (unsigned int tid) {
+        std::vector<uintptr_t> chunk(SCAN_CHUNK_SIZE / sizeof(uintptr_t));
+
+        while (true) {
+            size_t w = next_item.fetch_add(1);
+            if (w >= items.size())
+                break;
+
+            for (uintptr_t addr = items[w].addr; addr < items[w].endaddr; ) {
+                size_t want = items[w].endaddr - addr;
+
+                struct iovec local, remote;
+                local.iov_base = static_cast<void*>(chunk.data());
+                local.iov_len = want;
+                remote.iov_base = reinterpret_cast<void*>(addr);
+                remote.iov_len = want;
+
+                ssize_t got = process_vm_readv(context->game_pid, &local, 1, &remote, 1, 0);
+                if (got < 0)
+                    got = 0;
+
+                for (size_t i = 0; i < static_cast<size_t>(got)/sizeof(uintptr_t); i++) {
+
+                    /* Check if the value could be a pointer */
+                    bool isPointer = false;
+
+                    for (const MemSection &ms : memory_sections) {
+                        /* If pointing to a static section, we can skip it */
+                        if (ms.type & (MemSection::MemDataRW | MemSection::MemBSS)) {
+                            continue;
+                        }
+
+                        /* We take advantage of the fact that sections are ordered */
+                        if (chunk[i] < ms.addr) {
+                            break;
+                        }
+                        if (chunk[i] < ms.endaddr) {
+                            isPointer = true;
+                            break;
+                        }
                     }
 
-                    /* We take advantage of the fact that sections are ordered */
-                    if (chunk[i] < ms.addr) {
-                        break;
-                    }
-                    if (chunk[i] < ms.endaddr) {
-                        isPointer = true;
-                        break;
+                    if (isPointer) {
+                        PointerPair pair;
+                        pair.value = chunk[i];
+                        pair.addr = addr + i*sizeof(uintptr_t);
+                        if (items[w].is_static)
+                            t_static[tid].push_back(pair);
+                        else
+                            t_dynamic[tid].push_back(pair);
                     }
                 }
 
-                if (isPointer) {
-                    uintptr_t stored_addr = addr + i*sizeof(uintptr_t);
-                    if (section.type & (MemSection::MemDataRW | MemSection::MemBSS)) {
-                        static_pointer_map.insert(std::make_pair(chunk[i], stored_addr));
-                    }
-                    else {
-                        pointer_map.insert(std::make_pair(chunk[i], stored_addr));
-                    }
-                }
+                /* A short read stops at the first unreadable page, skip it */
+                if (static_cast<size_t>(got) < want)
+                    addr += got + 4096;
+                else
+                    addr += got;
             }
+
+            /* Update progress bar, the Qt connection becomes a queued one
+             * when emitting from a worker thread */
+            size_t scanned = scanned_size.fetch_add(items[w].endaddr - items[w].addr) + (items[w].endaddr - items[w].addr);
+            emit signalProgress((int)(100 * ((float)scanned / total_size)));
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned int t = 1; t < nthreads; t++)
+        threads.push_back(std::thread(worker, t));
+    if (!items.empty())
+        worker(0);
+    for (auto &th : threads)
+        th.join();
+
+    for (unsigned int t = 0; t < nthreads; t++) {
+        own_static_pairs.insert(own_static_pairs.end(), t_static[t].begin(), t_static[t].end());
+        own_dynamic_pairs.insert(own_dynamic_pairs.end(), t_dynamic[t].begin(), t_dynamic[t].end());
+    }
+
+    auto byValue = [] (const PointerPair& a, const PointerPair& b) {
+        return (a.value != b.value) ? (a.value < b.value) : (a.addr < b.addr);
+    };
+    std::sort(own_static_pairs.begin(), own_static_pairs.end(), byValue);
+    std::sort(own_dynamic_pairs.begin(), own_dynamic_pairs.end(), byValue);
+
+    /* Spill the sorted arrays to the pointer map file and map it */
+    {
+        std::ofstream mapfile(pointerMapPath(), std::ofstream::binary | std::ofstream::trunc);
+        if (mapfile) {
+            PointerMapHeader header;
+            header.magic = POINTERMAP_MAGIC;
+            header.framecount = context->framecount;
+            header.rerecords = context->rerecord_count;
+            header.static_count = own_static_pairs.size();
+            header.dynamic_count = own_dynamic_pairs.size();
+            mapfile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            mapfile.write(reinterpret_cast<const char*>(own_static_pairs.data()), own_static_pairs.size() * sizeof(PointerPair));
+            mapfile.write(reinterpret_cast<const char*>(own_dynamic_pairs.data()), own_dynamic_pairs.size() * sizeof(PointerPair));
         }
     }
+
+    if (loadPointerMap()) {
+        own_static_pairs.clear();
+        own_static_pairs.shrink_to_fit();
+        own_dynamic_pairs.clear();
+        own_dynamic_pairs.shrink_to_fit();
+    }
+    else {
+        /* Could not write or map the file, search the heap vectors */
+        static_pairs = own_static_pairs.data();
+        static_count = own_static_pairs.size();
+        dynamic_pairs = own_dynamic_pairs.data();
+        dynamic_count = own_dynamic_pairs.size();
+    }
 }
 
 
 void PointerScanModel::findPointerChain(uintptr_t addr, int ml, int max_offset)
 {
     static unsigned long last_scan_frame = 1 << 30;
-    /* Don't locate pointers again if this is the same frame */
-    if (last_scan_frame != context->framecount) {
+    static unsigned int last_scan_rerecords = 0;
+    /* Don't locate pointers again if this is the same frame of the same
+     * replay */
+    if ((last_scan_frame != context->framecount) ||
+        (last_scan_rerecords != context->rerecord_count)) {
         locatePointers();
         last_scan_frame = context->framecount;
+        last_scan_rerecords = context->rerecord_count;
     }
 
     beginResetModel();
 
     max_level = ml;
     pointer_chains.clear();
-    int offsets[10];
 
-    // std::cout << "max offset " << max_offset << std::endl;
-
-    recursiveFind(addr, 0, offsets, max_offset);
-
-    endResetModel();
-}
+    /* Breadth-first search: each level holds the addresses we want pointers
+     * to, with the offset taken to reach it and a link to its parent node,
+     * so a chain is rebuilt by walking the parents */
+    struct Node {
+        uintptr_t addr;
+        int offset;
+        int parent;
+    };
+    std::vector<std::vector<Node>> levels(max_level + 1);
+
+    Node root;
+    root.addr = addr;
+    root.offset = 0;
+    root.parent = -1;
+    levels[0].push_back(root);
+
+    auto byValue = [] (const PointerPair& p, uintptr_t v) {
+        return p.value < v;
+    };
+
+    for (int level = 0; level < max_level; level++) {
+        if (levels[level].empty())
+            break;
+
+        bool last = (level == max_level - 1);
+
+        unsigned int nthreads = std::thread::hardware_concurrency();
+        if (nthreads == 0)
+            nthreads = 1;
+        if (nthreads > levels[level].size())
+            nthreads = levels[level].size();
+
+        /* Per-thread staging for the next frontier and the found chains,
+         * merged in thread order below so the result is deterministic */
+        std::vector<std::vector<Node>> next_parts(nthreads);
+        std::vector<std::vector<std::pair<uintptr_t, std::vector<int>>>> chain_parts(nthreads);
+
+        auto worker = [&] (unsigned int tid) {
+            const std::vector<Node>& frontier = levels[level];
+            size_t begin = frontier.size() * tid / nthreads;
+            size_t end = frontier.size() * (tid + 1) / nthreads;
+
+            for (size_t ni = begin; ni < end; ni++) {
+                const Node& n = frontier[ni];
+
+                /* Search inside static data: a match ends a chain */
+                const PointerPair* it = std::lower_bound(static_pairs, static_pairs + static_count, n.addr - max_offset, byValue);
+                for (; (it != static_pairs + static_count) && (it->value <= n.addr); it++) {
+
+                    /* Rebuild the offsets along the path, stored from the
+                     * target end as the recursive search did */
+                    std::vector<int> offsets(level + 1);
+                    offsets[level] = n.addr - it->value;
+                    int p = ni;
+                    for (int l = level; l > 0; l--) {
+                        offsets[l-1] = levels[l][p].offset;
+                        p = levels[l][p].parent;
+                    }
+                    chain_parts[tid].push_back(std::make_pair(it->addr, offsets));
+                }
 
-void PointerScanModel::recursiveFind(uintptr_t addr, int level, int offsets[], int max_offset)
-{
-    /* Search inside static data */
-    auto iter = static_pointer_map.lower_bound(addr - max_offset);
-    while ((iter != static_pointer_map.end()) && (iter->first <= addr)) {
-        offsets[level] = addr - iter->first;
-        uintptr_t base_address = iter->second;
-        // std::cout << "Found static chain with last offset " << std::dec << offsets[level] << " and base address " << std::hex << base_address << std::endl;
-        std::vector<int> offset_vec(offsets, offsets + level + 1);
-        pointer_chains.push_back(std::make_pair(base_address,offset_vec));
-        iter++;
+                /* Stop if we reached the last level */
+                if (last)
+                    continue;
+
+                /* Search inside dynamic data: a match extends the frontier */
+                it = std::lower_bound(dynamic_pairs, dynamic_pairs + dynamic_count, n.addr - max_offset, byValue);
+                for (; (it != dynamic_pairs + dynamic_count) && (it->value <= n.addr); it++) {
+                    Node next;
+                    next.addr = it->addr;
+                    next.offset = n.addr - it->value;
+                    next.parent = ni;
+                    next_parts[tid].push_back(next);
+                }
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (unsigned int t = 1; t < nthreads; t++)
+            threads.push_back(std::thread(worker, t));
+        worker(0);
+        for (auto &th : threads)
+            th.join();
+
+        for (unsigned int t = 0; t < nthreads; t++) {
+            pointer_chains.insert(pointer_chains.end(), chain_parts[t].begin(), chain_parts[t].end());
+            levels[level+1].insert(levels[level+1].end(), next_parts[t].begin(), next_parts[t].end());
+        }
     }
 
-    /* Stop if we reached the last level */
-    if (level == (max_level-1))
-        return;
-
-    /* Search inside dynamic data */
-    iter = pointer_map.lower_bound(addr - max_offset);
-    while ((iter != pointer_map.end()) && (iter->first <= addr)) {
-        offsets[level] = addr - iter->first;
-        uintptr_t base_address = iter->second;
-        // std::cout << "Found chain with offset " << std::dec << offsets[level] << " and base address " << std::hex << base_address << std::endl;
-        recursiveFind(base_address, level+1, offsets, max_offset);
-        iter++;
-    }
+    endResetModel();
 }
 
 int PointerScanModel::rowCount(const QModelIndex & /*parent*/) const
@@ -22,8 +22,6 @@
 
 #include <QAbstractTableModel>
 #include <vector>
-#include <map>
-// #include <pair>
 #include <memory>
 #include <sys/types.h>
 #include <sstream>
@@ -31,9 +29,6 @@
 #include <iostream>
 
 #include "../Context.h"
-// #include "../ramsearch/IRamWatch.h"
-// #include "../ramsearch/CompareEnums.h"
-// #include "../ramsearch/RamWatch.h"
 #include "../ramsearch/MemSection.h"
 
 class PointerScanModel : public QAbstractTableModel {
@@ -41,12 +36,14 @@ class PointerScanModel : public QAbstractTableModel {
 
 public:
     PointerScanModel(Context* c, QObject *parent = Q_NULLPTR);
+    ~PointerScanModel();
 
-    /* Map of pointers (key) and addresses (value) */
-    std::multimap<uintptr_t,uintptr_t> pointer_map;
-
-    /* Map of pointers (key) and addresses (value) that are in a static area */
-    std::multimap<uintptr_t,uintptr_t> static_pointer_map;
+    /* One located pointer: the value it holds and the address it is
+     * stored at */
+    struct PointerPair {
+        uintptr_t value;
+        uintptr_t addr;
+    };
 
     /* Results of pointer scan */
     std::vector<std::pair<uintptr_t, std::vector<int>>> pointer_chains;
@@ -54,7 +51,9 @@ public:
     /* Max size of pointer chain */
     int max_level = 5;
 
-    /* Store all pointers from the game memory into a map */
+    /* Store all pointers from the game memory into two value-sorted arrays
+     * (static and dynamic storage locations), spilled to a memory-mapped
+     * file so a later session at the same frame can reuse them */
     void locatePointers();
 
     /* Find all chains of pointers that start from a static address and
@@ -66,8 +65,30 @@ public:
 private:
     Context *context;
 
-    /* Recursive call for the pointer chain search */
-    void recursiveFind(uintptr_t addr, int level, int offsets[], int max_offset);
+    /* Value-sorted pointer arrays, pointing into the mapped file, or into
+     * the fallback vectors below when the file could not be written */
+    const PointerPair *static_pairs = nullptr;
+    size_t static_count = 0;
+    const PointerPair *dynamic_pairs = nullptr;
+    size_t dynamic_count = 0;
+
+    /* Memory mapping of the pointer map file */
+    void *map_base = nullptr;
+    size_t map_length = 0;
+
+    /* Fallback storage when the pointer map file cannot be used */
+    std::vector<PointerPair> own_static_pairs;
+    std::vector<PointerPair> own_dynamic_pairs;
+
+    /* Path of the pointer map file for the current game */
+    std::string pointerMapPath() const;
+
+    /* Map the pointer map file if it matches the current frame. Returns
+     * false when there is no usable file. */
+    bool loadPointerMap();
+
+    /* Release the current mapping */
+    void unloadPointerMap();
 
     int rowCount(const QModelIndex &parent = QModelIndex()) const override;
 
@@ -158,7 +158,7 @@ void PointerScanWindow::slotAdd()
         watch->base_address = chain.first;
         watch->pointer_offsets = chain.second;
         std::reverse(watch->pointer_offsets.begin(), watch->pointer_offsets.end());
-        mw->ramWatchWindow->editWindow->fill(watch);
-        mw->ramWatchWindow->slotAdd();
+        mw->getRamWatchWindow()->editWindow->fill(watch);
+        mw->getRamWatchWindow()->slotAdd();
     }
 }
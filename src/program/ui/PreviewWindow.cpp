@@ -0,0 +1,190 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QPainter>
+#include <atomic>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "PreviewWindow.h"
+#include "../../shared/previewbuffer.h"
+
+PreviewWindow::PreviewWindow(Context* c, QWidget *parent, Qt::WindowFlags flags) : QDialog(parent, flags), context(c), buffer(nullptr), buffer_pid(0), shown_framecount(0)
+{
+    setWindowTitle("Game preview");
+
+    /* Poll the buffer at roughly the display rate. The timer only runs
+     * while the pane is shown. */
+    timer = new QTimer(this);
+    timer->setInterval(33);
+    connect(timer, &QTimer::timeout, this, &PreviewWindow::refresh);
+}
+
+QSize PreviewWindow::sizeHint() const
+{
+    return QSize(PREVIEW_MAXWIDTH / 2, PREVIEW_MAXHEIGHT / 2);
+}
+
+void PreviewWindow::showEvent(QShowEvent *event)
+{
+    enablePreview(true);
+    timer->start();
+    QDialog::showEvent(event);
+}
+
+void PreviewWindow::hideEvent(QHideEvent *event)
+{
+    timer->stop();
+    unmapBuffer();
+    enablePreview(false);
+    QDialog::hideEvent(event);
+}
+
+void PreviewWindow::enablePreview(bool enabled)
+{
+    context->config.sc.screen_preview = enabled;
+    context->config.sc_modified = true;
+}
+
+bool PreviewWindow::mapBuffer()
+{
+    if (buffer && (buffer_pid == context->game_pid))
+        return true;
+
+    unmapBuffer();
+
+    if (!context->game_pid)
+        return false;
+
+    /* The game passes the buffer as a sealed memfd during its init
+     * handshake, so not having it yet just means trying again at the
+     * next tick. The descriptor belongs to the context, only the mapping
+     * is ours. */
+    int fd = context->preview_fd;
+    if (fd < 0)
+        return false;
+
+    struct stat filestat;
+    if ((fstat(fd, &filestat) < 0) || (filestat.st_size < static_cast<off_t>(sizeof(PreviewBuffer))))
+        return false;
+
+    void* map = mmap(nullptr, sizeof(PreviewBuffer), PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+        return false;
+
+    buffer = static_cast<const PreviewBuffer*>(map);
+    if ((memcmp(buffer->magic, PREVIEW_MAGIC, 4) != 0) || (buffer->version != PREVIEW_VERSION)) {
+        unmapBuffer();
+        return false;
+    }
+
+    buffer_pid = context->game_pid;
+    shown_framecount = 0;
+    return true;
+}
+
+void PreviewWindow::unmapBuffer()
+{
+    if (buffer)
+        munmap(const_cast<void*>(static_cast<const void*>(buffer)), sizeof(PreviewBuffer));
+    buffer = nullptr;
+    buffer_pid = 0;
+}
+
+void PreviewWindow::refresh()
+{
+    if (context->status == Context::INACTIVE) {
+        unmapBuffer();
+        return;
+    }
+
+    if (!mapBuffer())
+        return;
+
+    uint32_t latest = buffer->latest % 3;
+    const PreviewSlot* slot = &buffer->frame_slots[latest];
+
+    /* An odd sequence number means the writer is inside the slot, so we
+     * just retry at the next tick */
+    uint32_t seq = slot->seq;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (seq & 1)
+        return;
+
+    if (slot->framecount == shown_framecount)
+        return;
+
+    int width = buffer->width;
+    int height = buffer->height;
+    if ((width <= 0) || (width > PREVIEW_MAXWIDTH) || (height <= 0) || (height > PREVIEW_MAXHEIGHT))
+        return;
+
+    bool full_copy = false;
+    if ((image.width() != width) || (image.height() != height)) {
+        image = QImage(width, height, QImage::Format_RGB32);
+        full_copy = true;
+    }
+
+    /* The dirty range is relative to the previously published frame, so it
+     * only applies when that frame is the one being shown. Otherwise some
+     * publishes were missed and the whole frame is copied. */
+    const PreviewSlot* prev_slot = &buffer->frame_slots[(latest + 2) % 3];
+    if (prev_slot->framecount != shown_framecount)
+        full_copy = true;
+
+    uint32_t first = slot->dirty_first;
+    uint32_t last = slot->dirty_last;
+    if (full_copy) {
+        first = 0;
+        last = height - 1;
+    }
+    if ((first > last) || (last >= static_cast<uint32_t>(height))) {
+        shown_framecount = slot->framecount;
+        return;
+    }
+
+    for (uint32_t y = first; y <= last; y++)
+        memcpy(image.scanLine(y), slot->pixels + static_cast<size_t>(y) * width, width * 4);
+
+    /* Discard the copy if the writer reused the slot during it */
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot->seq != seq) {
+        shown_framecount = 0;
+        return;
+    }
+
+    shown_framecount = slot->framecount;
+    update();
+}
+
+void PreviewWindow::paintEvent(QPaintEvent *event)
+{
+    QPainter painter(this);
+    painter.fillRect(rect(), Qt::black);
+
+    if (image.isNull())
+        return;
+
+    /* Scale the frame to the pane, keeping the aspect ratio */
+    QSize scaled = image.size().scaled(size(), Qt::KeepAspectRatio);
+    QRect target(QPoint((width() - scaled.width()) / 2, (height() - scaled.height()) / 2), scaled);
+    painter.drawImage(target, image);
+}
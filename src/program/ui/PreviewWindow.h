@@ -0,0 +1,71 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_PREVIEWWINDOW_H_INCLUDED
+#define LIBTAS_PREVIEWWINDOW_H_INCLUDED
+
+#include <QDialog>
+#include <QImage>
+#include <QTimer>
+#include <stdint.h>
+
+#include "../Context.h"
+
+struct PreviewBuffer;
+struct PreviewSlot;
+
+/* Pane displaying the downscaled frames that the game publishes into the
+ * shared-memory preview buffer, so the game can be monitored during
+ * fast-forward without watching its window. Publishing is only enabled in
+ * the game while this pane is shown, so a closed pane costs nothing. */
+class PreviewWindow : public QDialog {
+    Q_OBJECT
+public:
+    PreviewWindow(Context *c, QWidget *parent = Q_NULLPTR, Qt::WindowFlags flags = 0);
+
+    QSize sizeHint() const override;
+
+protected:
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+    void paintEvent(QPaintEvent *event) override;
+
+private slots:
+    /* Poll the shared-memory buffer for a new frame */
+    void refresh();
+
+private:
+    /* Enable or disable the frame publishing in the game */
+    void enablePreview(bool enabled);
+
+    /* Map the shared-memory buffer of the current game, if not done yet */
+    bool mapBuffer();
+    void unmapBuffer();
+
+    Context *context;
+    QTimer *timer;
+
+    const PreviewBuffer* buffer;
+    int buffer_pid;
+
+    QImage image;
+    uint64_t shown_framecount;
+};
+
+#endif
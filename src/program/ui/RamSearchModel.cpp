@@ -19,11 +19,21 @@
 
 #include "RamSearchModel.h"
 
-RamSearchModel::RamSearchModel(Context* c, QObject *parent) : QAbstractTableModel(parent), context(c) {}
+#include <unistd.h> // usleep
+
+RamSearchModel::RamSearchModel(Context* c, QObject *parent) : QAbstractTableModel(parent), context(c), searching(false) {}
+
+RamSearchModel::~RamSearchModel()
+{
+    if (ramsearch)
+        ramsearch->cancel();
+    if (search_thread.joinable())
+        search_thread.join();
+}
 
 int RamSearchModel::rowCount(const QModelIndex & /*parent*/) const
 {
-   return ramwatches.size();
+   return (ramsearch && !searching) ? ramsearch->size() : 0;
 }
 
 int RamSearchModel::columnCount(const QModelIndex & /*parent*/) const
@@ -51,14 +61,13 @@ QVariant RamSearchModel::headerData(int section, Qt::Orientation orientation, in
 QVariant RamSearchModel::data(const QModelIndex &index, int role) const
 {
     if (role == Qt::DisplayRole) {
-        const std::unique_ptr<IRamWatch> &watch = ramwatches.at(index.row());
         switch(index.column()) {
             case 0:
-                return QString("%1").arg(watch->address, 0, 16);
+                return QString("%1").arg(ramsearch->address(index.row()), 0, 16);
             case 1:
-                return QString(watch->tostring_current(hex));
+                return QString(ramsearch->currentToString(index.row(), hex));
             case 2:
-                return QString(watch->tostring(hex));
+                return QString(ramsearch->previousToString(index.row(), hex));
             default:
                 return QString();
         }
@@ -66,25 +75,18 @@ QVariant RamSearchModel::data(const QModelIndex &index, int role) const
     return QVariant();
 }
 
-int RamSearchModel::predictWatchCount(int type_filter)
+uint64_t RamSearchModel::sectionStamp() const
 {
-    /* Compose the filename for the /proc memory map, and open it. */
-    std::ostringstream oss;
-    oss << "/proc/" << context->game_pid << "/maps";
-    std::ifstream mapsfile(oss.str());
-    if (!mapsfile) {
-        std::cerr << "Could not open " << oss.str() << std::endl;
-        return 0;
-    }
-
-    std::string line;
-    MemSection::reset();
+    /* A state load that discarded modified inputs bumps the rerecord count,
+     * so the pair identifies the memory contents like the pointer map does */
+    return (static_cast<uint64_t>(context->rerecord_count) << 32)
+        ^ static_cast<uint64_t>(context->framecount);
+}
 
+int RamSearchModel::predictWatchCount(int type_filter)
+{
     int total_size = 0;
-    while (std::getline(mapsfile, line)) {
-        MemSection section;
-        section.readMap(line);
-
+    for (const MemSection& section : section_cache.sections(context->game_pid, sectionStamp())) {
         /* Filter based on type */
         if (!(type_filter & section.type))
             continue;
@@ -97,31 +99,103 @@ int RamSearchModel::predictWatchCount(int type_filter)
 
 int RamSearchModel::watchCount()
 {
-    return ramwatches.size();
+    return (ramsearch && !searching) ? ramsearch->size() : 0;
 }
 
 void RamSearchModel::searchWatches(CompareType ct, CompareOperator co, double cv)
 {
+    if (!ramsearch || searching)
+        return;
+
     compare_type = ct;
     compare_operator = co;
     compare_value = cv;
 
     beginResetModel();
+    startSearch(false, 0);
+}
+
+void RamSearchModel::startSearch(bool first_scan, int type_filter)
+{
+    if (search_thread.joinable())
+        search_thread.join();
+
+    searching = true;
+    pid_t pid = context->game_pid;
+
+    /* Ask the game loop to pause at the next frame boundary, so the scanned
+     * values stay consistent while the batched reads run. The worker below
+     * waits for the pause to take effect before reading */
+    paused_for_scan = false;
+    if (pause_during_scan && (context->status == Context::ACTIVE) &&
+        context->config.sc.running) {
+        context->hotkey_queue.push(HOTKEY_PLAYPAUSE);
+        paused_for_scan = true;
+    }
+
+    /* Filter the cached sections on the UI thread, the worker captures its
+     * own copy */
+    std::vector<MemSection> sections;
+    if (first_scan) {
+        for (const MemSection& section : section_cache.sections(pid, sectionStamp())) {
+            if (type_filter & section.type)
+                sections.push_back(section);
+        }
+    }
+
+    search_thread = std::thread([this, first_scan, sections, pid] () {
+        auto report = [this] (int value) { progress_queue.push(value); };
+
+        /* Wait for the frame boundary to process the pause, with a cap in
+         * case the game quit in between */
+        if (paused_for_scan) {
+            for (int i = 0; context->config.sc.running && (i < 2000); i++)
+                usleep(1000);
+        }
+
+        if (first_scan)
+            ramsearch->newSearch(pid, sections, compare_type,
+                compare_operator, compare_value, report);
+        else
+            ramsearch->search(compare_type, compare_operator, compare_value,
+                report);
+
+        emit searchFinished();
+    });
+}
+
+void RamSearchModel::cancelSearch()
+{
+    if (ramsearch)
+        ramsearch->cancel();
+}
 
-    int count = 0;
-    ramwatches.erase(
-        std::remove_if(ramwatches.begin(), ramwatches.end(),
-            [this, &count] (std::unique_ptr<IRamWatch> &watch) {
-                if (!(count++ & 0xfff)) {
-                    emit signalProgress(count);
-                }
-                return watch->check_update(compare_type, compare_operator, compare_value);
-            }),
-        ramwatches.end());
+void RamSearchModel::finishSearch()
+{
+    if (search_thread.joinable())
+        search_thread.join();
+
+    /* Resume the game if the scan paused it */
+    if (paused_for_scan) {
+        paused_for_scan = false;
+        if ((context->status == Context::ACTIVE) && !context->config.sc.running)
+            context->hotkey_queue.push(HOTKEY_PLAYPAUSE);
+    }
 
+    searching = false;
     endResetModel();
 }
 
+uintptr_t RamSearchModel::address(int row)
+{
+    return ramsearch->address(row);
+}
+
+int RamSearchModel::type()
+{
+    return ramsearch->type();
+}
+
 void RamSearchModel::update()
 {
     emit dataChanged(createIndex(0,1), createIndex(rowCount(),1));
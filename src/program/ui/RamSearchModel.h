@@ -23,31 +23,42 @@
 #include <QAbstractTableModel>
 #include <vector>
 #include <memory>
+#include <thread>
+#include <atomic>
 #include <sys/types.h>
 #include <sstream>
 #include <fstream>
 #include <iostream>
 
 #include "../Context.h"
-#include "../ramsearch/IRamWatch.h"
+#include "../ConcurrentQueue.h"
 #include "../ramsearch/CompareEnums.h"
-#include "../ramsearch/RamWatch.h"
+#include "../ramsearch/RamSearch.h"
 #include "../ramsearch/MemSection.h"
+#include "../ramsearch/MemSectionCache.h"
 
 class RamSearchModel : public QAbstractTableModel {
     Q_OBJECT
 
 public:
     RamSearchModel(Context* c, QObject *parent = Q_NULLPTR);
+    ~RamSearchModel();
 
     void update();
 
-    /* List of watches */
-    std::vector<std::unique_ptr<IRamWatch>> ramwatches;
+    /* Scan engine holding the candidate addresses */
+    std::unique_ptr<IRamSearch> ramsearch;
+
+    /* Progress values pushed by the scan thread, drained by the window */
+    ConcurrentQueue<int> progress_queue;
 
     /* Flag if we display values in hex or decimal */
     bool hex;
 
+    /* Pause the game at a frame boundary for the duration of a scan, so
+     * values don't move between the batched reads and pollute refinements */
+    bool pause_during_scan = true;
+
     /* Comparison parameters so that we can display with addresses would be
      * removed by the search */
     CompareType compare_type;
@@ -55,106 +66,59 @@ public:
     double compare_value;
 
     template <class T>
-    // void new_watches(pid_t pid, int type_filter, CompareType compare_type, CompareOperator compare_operator, double compare_value, Fl_Hor_Fill_Slider *search_progress)
     void newWatches(int type_filter, CompareType ct, CompareOperator co, double cv)
     {
+        if (searching)
+            return;
+
         compare_type = ct;
         compare_operator = co;
         compare_value = cv;
 
         beginResetModel();
+        ramsearch.reset(new RamSearch<T>());
+        startSearch(true, type_filter);
+    }
 
-        ramwatches.clear();
-        ramwatches.reserve(0);
-
-        IRamWatch::game_pid = context->game_pid;
-
-        /* Compose the filename for the /proc memory map, and open it. */
-        std::ostringstream oss;
-        oss << "/proc/" << context->game_pid << "/maps";
-        std::ifstream mapsfile(oss.str());
-        if (!mapsfile) {
-            std::cerr << "Could not open " << oss.str() << std::endl;
-            return;
-        }
-
-        std::string line;
-        MemSection::reset();
-
-        int cur_size = 0;
-        while (std::getline(mapsfile, line)) {
-
-            MemSection section;
-            section.readMap(line);
-
-            /* Filter based on type */
-            if (!(type_filter & section.type))
-                continue;
-
-            /* Reserve the vector space so we avoid multiple reallocations */
-            ramwatches.reserve(ramwatches.size() + section.size/sizeof(T));
-
-            /* For now we only store aligned addresses */
-            std::unique_ptr<RamWatch<T>> watch(nullptr);
-
-            struct iovec local, remote;
+    /* Flag if a scan is running on the worker thread */
+    bool isSearching() const { return searching; }
 
-            for (uintptr_t addr = section.addr; addr < section.endaddr; addr += 4096) {
+    /* Ask the running scan to stop early, keeping the partial results */
+    void cancelSearch();
 
-                /* Read values in chunks of 4096 bytes so we lower the number
-                 * of `process_vm_readv` calls.
-                 */
-                T chunk[4096/sizeof(T)];
-                local.iov_base = static_cast<void*>(chunk);
-                local.iov_len = 4096;
-                remote.iov_base = reinterpret_cast<void*>(addr);
-                remote.iov_len = 4096;
+    /* Complete the model reset on the UI thread, after searchFinished() */
+    void finishSearch();
 
-                int readValues = process_vm_readv(context->game_pid, &local, 1, &remote, 1, 0);
-                if (readValues < 0) {
-                    continue;
-                }
+    int predictWatchCount(int type_filter);
+    int watchCount();
+    void searchWatches(CompareType ct, CompareOperator co, double cv);
 
-                for (unsigned int i = 0; i < readValues/sizeof(T); i++, cur_size += sizeof(T)) {
+    /* Candidate address of a row, to fill the watch edit window */
+    uintptr_t address(int row);
 
-                    if (!(cur_size & 0xfff)) {
-                        emit signalProgress(cur_size);
-                    }
+    /* Index of the searched type */
+    int type();
 
-                    if (! watch)
-                        watch = std::unique_ptr<RamWatch<T>>(new RamWatch<T>(addr+i*sizeof(T)));
-                    else
-                        /* Reusing a watch object that wasn't inserted */
-                        watch->address = addr+i*sizeof(T);
+private:
+    Context *context;
 
-                    watch->previous_value = chunk[i];
+    /* Parsed memory sections of the game, reused as long as the game stays
+     * at the same frame of the same replay */
+    MemSectionCache section_cache;
 
-                    /* If only insert watches that match the compare */
-                    if (compare_type == CompareType::Value) {
-                        if (!watch->check(chunk[i], compare_type, compare_operator, compare_value)) {
-                            ramwatches.push_back(std::move(watch));
-                        }
-                    }
+    /* Stamp identifying the game state for the section cache */
+    uint64_t sectionStamp() const;
 
-                    /* Insert all watches, still checking for non NaN/Inf values */
-                    else {
-                        if (std::isfinite(chunk[i])) {
-                            ramwatches.push_back(std::move(watch));
-                        }
-                    }
-                }
-            }
-        }
+    /* Thread running the scan engine, so long scans don't block the UI */
+    std::thread search_thread;
+    std::atomic<bool> searching;
 
-        endResetModel();
-    }
+    /* Whether the running scan paused the game, to resume it afterwards */
+    bool paused_for_scan = false;
 
-    int predictWatchCount(int type_filter);
-    int watchCount();
-    void searchWatches(CompareType ct, CompareOperator co, double cv);
-
-private:
-    Context *context;
+    /* Run the first scan or a refinement on the worker thread. Completion
+     * is notified through searchFinished(). */
+    void startSearch(bool first_scan, int type_filter);
 
     int rowCount(const QModelIndex &parent = QModelIndex()) const override;
 
@@ -165,7 +129,9 @@ private:
     QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
 
 signals:
-    void signalProgress(int);
+    /* Emitted from the scan thread when the scan completed or was
+     * cancelled, so the connection to the window is a queued one */
+    void searchFinished();
 
 };
 
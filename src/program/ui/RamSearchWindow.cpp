@@ -48,9 +48,13 @@ RamSearchWindow::RamSearchWindow(Context* c, QWidget *parent, Qt::WindowFlags fl
     ramSearchModel = new RamSearchModel(context);
     ramSearchView->setModel(ramSearchModel);
 
-    /* Progress bar */
+    /* Progress bar, fed by polling the progress queue of the scan thread */
     searchProgress = new QProgressBar();
-    connect(ramSearchModel, &RamSearchModel::signalProgress, searchProgress, &QProgressBar::setValue);
+    connect(ramSearchModel, &RamSearchModel::searchFinished, this, &RamSearchWindow::slotSearchFinished);
+
+    searchTimer = new QTimer(this);
+    searchTimer->setInterval(50);
+    connect(searchTimer, &QTimer::timeout, this, &RamSearchWindow::slotPollSearch);
 
     watchCount = new QLabel();
     // watchCount->setHeight(searchProgress->height());
@@ -140,6 +144,9 @@ RamSearchWindow::RamSearchWindow(Context* c, QWidget *parent, Qt::WindowFlags fl
     formatLayout->addRow(new QLabel(tr("Display:")), displayBox);
     formatGroupBox->setLayout(formatLayout);
 
+    pauseScanBox = new QCheckBox("Pause game while scanning");
+    pauseScanBox->setChecked(true);
+
     /* Buttons */
     QPushButton *newButton = new QPushButton(tr("New"));
     connect(newButton, &QAbstractButton::clicked, this, &RamSearchWindow::slotNew);
@@ -147,12 +154,17 @@ RamSearchWindow::RamSearchWindow(Context* c, QWidget *parent, Qt::WindowFlags fl
     QPushButton *searchButton = new QPushButton(tr("Search"));
     connect(searchButton, &QAbstractButton::clicked, this, &RamSearchWindow::slotSearch);
 
+    stopButton = new QPushButton(tr("Stop"));
+    stopButton->setEnabled(false);
+    connect(stopButton, &QAbstractButton::clicked, this, &RamSearchWindow::slotStop);
+
     QPushButton *addButton = new QPushButton(tr("Add Watch"));
     connect(addButton, &QAbstractButton::clicked, this, &RamSearchWindow::slotAdd);
 
     QDialogButtonBox *buttonBox = new QDialogButtonBox();
     buttonBox->addButton(newButton, QDialogButtonBox::ActionRole);
     buttonBox->addButton(searchButton, QDialogButtonBox::ActionRole);
+    buttonBox->addButton(stopButton, QDialogButtonBox::ActionRole);
     buttonBox->addButton(addButton, QDialogButtonBox::ActionRole);
 
     /* Create the options layout */
@@ -161,6 +173,7 @@ RamSearchWindow::RamSearchWindow(Context* c, QWidget *parent, Qt::WindowFlags fl
     optionLayout->addWidget(compareGroupBox);
     optionLayout->addWidget(operatorGroupBox);
     optionLayout->addWidget(formatGroupBox);
+    optionLayout->addWidget(pauseScanBox);
     optionLayout->addStretch(1);
     optionLayout->addWidget(buttonBox);
 
@@ -203,6 +216,9 @@ void RamSearchWindow::slotNew()
     if (context->status != Context::ACTIVE)
         return;
 
+    if (ramSearchModel->isSearching())
+        return;
+
     /* Build the memory region flag variable */
     int memregions = 0;
     if (memTextBox->isChecked())
@@ -233,12 +249,16 @@ void RamSearchWindow::slotNew()
     getCompareParameters(compare_type, compare_operator, compare_value);
 
     ramSearchModel->hex = (displayBox->currentIndex() == 1);
+    ramSearchModel->pause_during_scan = pauseScanBox->isChecked();
 
     watchCount->hide();
-    searchProgress->show();
+    searchProgress->setValue(0);
     searchProgress->setMaximum(ramSearchModel->predictWatchCount(memregions));
+    searchProgress->show();
 
-    /* Call the RamSearch new function using the right type as template */
+    /* Call the RamSearch new function using the right type as template.
+     * The scan runs on a worker thread, slotSearchFinished() is called when
+     * it completes. */
     switch (typeBox->currentIndex()) {
         case 0:
             ramSearchModel->newWatches<unsigned char>(memregions, compare_type, compare_operator, compare_value);
@@ -272,31 +292,72 @@ void RamSearchWindow::slotNew()
             break;
     }
 
-    searchProgress->hide();
-    watchCount->show();
-
-    /* Update address count */
-    watchCount->setText(QString("%1 addresses").arg(ramSearchModel->watchCount()));
+    stopButton->setEnabled(true);
+    searchTimer->start();
 }
 
 void RamSearchWindow::slotSearch()
 {
+    if (ramSearchModel->isSearching())
+        return;
+
     CompareType compare_type;
     CompareOperator compare_operator;
     double compare_value;
     getCompareParameters(compare_type, compare_operator, compare_value);
 
-    searchProgress->setMaximum(ramSearchModel->watchCount());
+    ramSearchModel->pause_during_scan = pauseScanBox->isChecked();
+
     watchCount->hide();
+    searchProgress->setValue(0);
+    searchProgress->setMaximum(ramSearchModel->watchCount());
     searchProgress->show();
 
     ramSearchModel->searchWatches(compare_type, compare_operator, compare_value);
 
-    /* Update address count */
+    /* No scan was started when there are no candidates yet */
+    if (!ramSearchModel->isSearching()) {
+        searchProgress->hide();
+        watchCount->show();
+        return;
+    }
+
+    stopButton->setEnabled(true);
+    searchTimer->start();
+}
+
+void RamSearchWindow::slotStop()
+{
+    ramSearchModel->cancelSearch();
+}
+
+void RamSearchWindow::slotPollSearch()
+{
+    /* Drain the progress values pushed by the scan workers, keeping the
+     * most recent one */
+    int value;
+    bool has_value = false;
+    while (ramSearchModel->progress_queue.try_pop(value))
+        has_value = true;
+
+    if (has_value)
+        searchProgress->setValue(value);
+}
+
+void RamSearchWindow::slotSearchFinished()
+{
+    searchTimer->stop();
+    stopButton->setEnabled(false);
+
+    /* Drain the progress values left in the queue */
+    int value;
+    while (ramSearchModel->progress_queue.try_pop(value)) {}
+
+    ramSearchModel->finishSearch();
+
     searchProgress->hide();
     watchCount->show();
     watchCount->setText(QString("%1 addresses").arg(ramSearchModel->watchCount()));
-
 }
 
 void RamSearchWindow::slotAdd()
@@ -316,7 +377,7 @@ void RamSearchWindow::slotAdd()
 
     MainWindow *mw = qobject_cast<MainWindow*>(parent());
     if (mw) {
-        mw->ramWatchWindow->editWindow->fill(ramSearchModel->ramwatches.at(row));
-        mw->ramWatchWindow->slotAdd();
+        mw->getRamWatchWindow()->editWindow->fill(ramSearchModel->address(row), ramSearchModel->type());
+        mw->getRamWatchWindow()->slotAdd();
     }
 }
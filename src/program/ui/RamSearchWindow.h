@@ -28,6 +28,8 @@
 #include <QComboBox>
 #include <QProgressBar>
 #include <QLabel>
+#include <QPushButton>
+#include <QTimer>
 #include <memory>
 
 #include "RamSearchModel.h"
@@ -48,6 +50,10 @@ private:
     RamSearchModel *ramSearchModel;
     QProgressBar *searchProgress;
     QLabel *watchCount;
+    QPushButton *stopButton;
+
+    /* Timer draining the progress queue while a scan is running */
+    QTimer *searchTimer;
 
     QCheckBox *memTextBox;
     QCheckBox *memDataROBox;
@@ -74,12 +80,17 @@ private:
     QComboBox *typeBox;
     QComboBox *displayBox;
 
+    QCheckBox *pauseScanBox;
+
     void getCompareParameters(CompareType& compare_type, CompareOperator& compare_operator, double& compare_value);
 
 private slots:
     void slotNew();
     void slotSearch();
+    void slotStop();
     void slotAdd();
+    void slotPollSearch();
+    void slotSearchFinished();
 
 };
 
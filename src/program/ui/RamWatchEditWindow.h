@@ -29,7 +29,6 @@
 #include <QDialogButtonBox>
 #include <memory> // std::unique_ptr
 
-#include "../ramsearch/IRamWatch.h"
 #include "../ramsearch/IRamWatchDetailed.h"
 
 class RamWatchEditWindow : public QDialog {
@@ -40,7 +39,7 @@ public:
 
     void clear();
     void fill(std::unique_ptr<IRamWatchDetailed> &watch);
-    void fill(std::unique_ptr<IRamWatch> &watch);
+    void fill(uintptr_t addr, int type_index);
 
     std::unique_ptr<IRamWatchDetailed> ramwatch;
 
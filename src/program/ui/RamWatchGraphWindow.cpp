@@ -0,0 +1,142 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QPainter>
+#include <QVBoxLayout>
+
+#include "RamWatchGraphWindow.h"
+
+RamWatchGraph::RamWatchGraph(QWidget *parent) : QWidget(parent)
+{
+    setMinimumSize(480, 200);
+}
+
+void RamWatchGraph::paintEvent(QPaintEvent *event)
+{
+    QPainter painter(this);
+    painter.fillRect(rect(), QColor(30, 30, 30));
+
+    if (!watch)
+        return;
+
+    const size_t count = watch->sample_count();
+    if (count < 2)
+        return;
+
+    /* Show the newest slice that fits the width, one sample per pixel */
+    size_t first = 0;
+    if (count > static_cast<size_t>(width()))
+        first = count - width();
+
+    /* Scale the curve to the value range of the slice, ghost included */
+    double min = watch->to_double(watch->sample_value(first));
+    double max = min;
+    for (size_t i = first; i < count; i++) {
+        double v = watch->to_double(watch->sample_value(i));
+        if (v < min) min = v;
+        if (v > max) max = v;
+
+        if (watch->has_ghost()) {
+            const void* g = watch->ghost_at(watch->sample_frame(i));
+            if (g) {
+                v = watch->to_double(g);
+                if (v < min) min = v;
+                if (v > max) max = v;
+            }
+        }
+    }
+    if (max == min)
+        max = min + 1.0;
+
+    /* Draw the ghost run first, sampled at the frames of the live slice so
+     * both curves share the x axis */
+    if (watch->has_ghost()) {
+        painter.setPen(QColor(110, 130, 210));
+        int ghost_prev_x = 0, ghost_prev_y = 0;
+        bool ghost_prev = false;
+        for (size_t i = first; i < count; i++) {
+            const void* g = watch->ghost_at(watch->sample_frame(i));
+            if (!g) {
+                ghost_prev = false;
+                continue;
+            }
+            const double v = watch->to_double(g);
+            const int x = static_cast<int>(i - first);
+            const int y = height() - 1
+                - static_cast<int>((v - min) / (max - min) * (height() - 1));
+            if (ghost_prev)
+                painter.drawLine(ghost_prev_x, ghost_prev_y, x, y);
+            ghost_prev_x = x;
+            ghost_prev_y = y;
+            ghost_prev = true;
+        }
+    }
+
+    painter.setPen(QColor(80, 200, 120));
+    int prev_x = 0, prev_y = 0;
+    for (size_t i = first; i < count; i++) {
+        const double v = watch->to_double(watch->sample_value(i));
+        const int x = static_cast<int>(i - first);
+        const int y = height() - 1
+            - static_cast<int>((v - min) / (max - min) * (height() - 1));
+        if (i > first)
+            painter.drawLine(prev_x, prev_y, x, y);
+        prev_x = x;
+        prev_y = y;
+    }
+
+    /* Print the value range and the frame span of the slice */
+    painter.setPen(Qt::white);
+    painter.drawText(5, 15, QString("%1 .. %2").arg(min).arg(max));
+    painter.drawText(5, height() - 5, QString("frames %1 .. %2")
+        .arg(watch->sample_frame(first)).arg(watch->sample_frame(count - 1)));
+}
+
+RamWatchGraphWindow::RamWatchGraphWindow(QWidget *parent, Qt::WindowFlags flags) : QDialog(parent, flags)
+{
+    setWindowTitle("Watch graph");
+
+    graph = new RamWatchGraph();
+
+    QVBoxLayout *mainLayout = new QVBoxLayout;
+    mainLayout->addWidget(graph, 1);
+    setLayout(mainLayout);
+}
+
+void RamWatchGraphWindow::setWatch(IRamWatchDetailed *w)
+{
+    graph->watch = w;
+    if (w) {
+        if (!w->label.empty())
+            setWindowTitle(QString("Watch graph: %1").arg(w->label.c_str()));
+        else
+            setWindowTitle(QString("Watch graph: %1").arg(w->address, 0, 16));
+    }
+    graph->update();
+}
+
+IRamWatchDetailed* RamWatchGraphWindow::watch()
+{
+    return graph->watch;
+}
+
+void RamWatchGraphWindow::refresh()
+{
+    graph->update();
+}
@@ -0,0 +1,58 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_RAMWATCHGRAPHWINDOW_H_INCLUDED
+#define LIBTAS_RAMWATCHGRAPHWINDOW_H_INCLUDED
+
+#include <QDialog>
+#include <QWidget>
+
+#include "../ramsearch/IRamWatchDetailed.h"
+
+/* Curve of the recorded value history of one watch, one pixel column per
+ * sample, reading the history columns in place */
+class RamWatchGraph : public QWidget {
+    Q_OBJECT
+public:
+    RamWatchGraph(QWidget *parent = Q_NULLPTR);
+
+    /* The graphed watch, owned by the watch model */
+    IRamWatchDetailed *watch = nullptr;
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+};
+
+class RamWatchGraphWindow : public QDialog {
+    Q_OBJECT
+public:
+    RamWatchGraphWindow(QWidget *parent = Q_NULLPTR, Qt::WindowFlags flags = 0);
+
+    /* Set or clear the graphed watch */
+    void setWatch(IRamWatchDetailed *watch);
+    IRamWatchDetailed *watch();
+
+    /* Repaint with the latest recorded samples */
+    void refresh();
+
+private:
+    RamWatchGraph *graph;
+};
+
+#endif
@@ -19,8 +19,57 @@
 
 #include "RamWatchModel.h"
 
+#include <sys/uio.h>
+
 RamWatchModel::RamWatchModel(QObject *parent) : QAbstractTableModel(parent) {}
 
+/* Read a set of remote ranges into `buf` with as few process_vm_readv calls
+ * as possible, marking in `ok` the ranges that could not be read. A short
+ * read stops inside the first unreadable range, which is skipped. */
+static void readBatch(pid_t pid, std::vector<struct iovec>& remotes, char* buf, std::vector<char>& ok)
+{
+    /* Maximum number of remote ranges per process_vm_readv call (IOV_MAX) */
+    const size_t MAX_IOVS = 1024;
+
+    ok.assign(remotes.size(), 1);
+
+    size_t batch_bytes = 0;
+    for (const struct iovec& iov : remotes)
+        batch_bytes += iov.iov_len;
+
+    size_t iov_done = 0;
+    size_t filled = 0;
+    while (iov_done < remotes.size()) {
+        size_t iov_count = remotes.size() - iov_done;
+        if (iov_count > MAX_IOVS)
+            iov_count = MAX_IOVS;
+
+        struct iovec local;
+        local.iov_base = static_cast<void*>(buf + filled);
+        local.iov_len = batch_bytes - filled;
+
+        ssize_t got = process_vm_readv(pid, &local, 1, &remotes[iov_done], iov_count, 0);
+        if (got < 0)
+            got = 0;
+
+        /* Consume fully read ranges */
+        size_t iov_end = iov_done + iov_count;
+        while ((iov_done < iov_end) &&
+               (static_cast<size_t>(got) >= remotes[iov_done].iov_len)) {
+            got -= remotes[iov_done].iov_len;
+            filled += remotes[iov_done].iov_len;
+            iov_done++;
+        }
+
+        /* The next range is (partially) unreadable */
+        if ((iov_done < iov_end) && (static_cast<size_t>(got) < remotes[iov_done].iov_len)) {
+            ok[iov_done] = 0;
+            filled += remotes[iov_done].iov_len;
+            iov_done++;
+        }
+    }
+}
+
 int RamWatchModel::rowCount(const QModelIndex & /*parent*/) const
 {
    return ramwatches.size();
@@ -55,10 +104,14 @@ QVariant RamWatchModel::data(const QModelIndex &index, int role) const
         switch(index.column()) {
             case 0:
                 if (watch->isPointer)
-                    return QString("P->%1").arg(watch->address, 0, 16);
+                    return QString(watch->frozen ? "[F] P->%1" : "P->%1").arg(watch->address, 0, 16);
                 else
-                    return QString("%1").arg(watch->address, 0, 16);
+                    return QString(watch->frozen ? "[F] %1" : "%1").arg(watch->address, 0, 16);
             case 1:
+                /* The batched poller caches the value string, fall back to
+                 * a direct read for a watch that was never polled yet */
+                if (!watch->cached_str.empty())
+                    return QString(watch->cached_str.c_str());
                 return QString(watch->value_str().c_str());
             case 2:
                 return QString(watch->label.c_str());
@@ -84,7 +137,142 @@ void RamWatchModel::removeWatch(int row)
 }
 
 
-void RamWatchModel::update()
+void RamWatchModel::update(unsigned long framecount)
+{
+    size_t n = ramwatches.size();
+    if (n == 0)
+        return;
+
+    pid_t pid = IRamWatchDetailed::game_pid;
+
+    std::vector<uintptr_t> addrs(n);
+    std::vector<char> valid(n, 1);
+
+    size_t max_levels = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (ramwatches[i]->isPointer) {
+            addrs[i] = ramwatches[i]->base_address;
+            if (ramwatches[i]->pointer_offsets.size() > max_levels)
+                max_levels = ramwatches[i]->pointer_offsets.size();
+        }
+        else {
+            addrs[i] = ramwatches[i]->address;
+        }
+    }
+
+    std::vector<struct iovec> remotes;
+    std::vector<size_t> rows;
+    std::vector<char> ok;
+
+    /* Resolve the pointer chains of all watches together, with one batched
+     * read per chain level */
+    std::vector<uintptr_t> pointers;
+    for (size_t level = 0; level < max_levels; level++) {
+        remotes.clear();
+        rows.clear();
+        for (size_t i = 0; i < n; i++) {
+            if (!ramwatches[i]->isPointer || !valid[i])
+                continue;
+            if (level >= ramwatches[i]->pointer_offsets.size())
+                continue;
+
+            struct iovec iov;
+            iov.iov_base = reinterpret_cast<void*>(addrs[i]);
+            iov.iov_len = sizeof(uintptr_t);
+            remotes.push_back(iov);
+            rows.push_back(i);
+        }
+
+        if (remotes.empty())
+            break;
+
+        pointers.resize(rows.size());
+        readBatch(pid, remotes, reinterpret_cast<char*>(pointers.data()), ok);
+
+        for (size_t r = 0; r < rows.size(); r++) {
+            size_t i = rows[r];
+            if (!ok[r])
+                valid[i] = 0;
+            else
+                addrs[i] = pointers[r] + ramwatches[i]->pointer_offsets[level];
+        }
+    }
+
+    /* Gather the values of all watches with a single batched read */
+    remotes.clear();
+    rows.clear();
+    std::vector<size_t> offsets;
+    size_t total_bytes = 0;
+    for (size_t i = 0; i < n; i++) {
+        /* Keep the resolved address for the display */
+        if (ramwatches[i]->isPointer)
+            ramwatches[i]->address = addrs[i];
+
+        if (!valid[i]) {
+            ramwatches[i]->update_value(nullptr, false);
+            continue;
+        }
+
+        struct iovec iov;
+        iov.iov_base = reinterpret_cast<void*>(addrs[i]);
+        iov.iov_len = ramwatches[i]->value_size();
+        remotes.push_back(iov);
+        rows.push_back(i);
+        offsets.push_back(total_bytes);
+        total_bytes += iov.iov_len;
+    }
+
+    std::vector<char> buf(total_bytes);
+    readBatch(pid, remotes, buf.data(), ok);
+
+    for (size_t r = 0; r < rows.size(); r++) {
+        size_t i = rows[r];
+        ramwatches[i]->update_value(buf.data() + offsets[r], ok[r]);
+
+        /* Append into the value history straight from the batch buffer,
+         * no extra syscall is involved */
+        if (ok[r] && ramwatches[i]->recording)
+            ramwatches[i]->record_sample(framecount, buf.data() + offsets[r]);
+    }
+
+    /* Emit a single repaint signal covering the span from the first to the
+     * last row whose displayed value changed, so one poll costs at most one
+     * view update */
+    size_t first = n, last = n;
+    for (size_t i = 0; i < n; i++) {
+        if (!ramwatches[i]->value_changed)
+            continue;
+        if (first == n)
+            first = i;
+        last = i;
+    }
+    if (first != n)
+        emit dataChanged(createIndex(first, 0), createIndex(last, 1));
+}
+
+void RamWatchModel::flushFrozen()
 {
-    emit dataChanged(createIndex(0,0), createIndex(rowCount(),1));
+    std::vector<struct iovec> locals;
+    std::vector<struct iovec> remotes;
+
+    for (const std::unique_ptr<IRamWatchDetailed> &watch : ramwatches) {
+        if (!watch->frozen)
+            continue;
+
+        struct iovec local, remote;
+        local.iov_base = static_cast<void*>(watch->frozen_value);
+        local.iov_len = watch->value_size();
+        remote.iov_base = reinterpret_cast<void*>(watch->address);
+        remote.iov_len = watch->value_size();
+        locals.push_back(local);
+        remotes.push_back(remote);
+    }
+
+    if (remotes.empty())
+        return;
+
+    /* One write flushes the whole poke list. A frozen watch that became
+     * unwritable truncates the write, the remaining values will be poked
+     * again at the next frame boundary anyway. */
+    process_vm_writev(IRamWatchDetailed::game_pid, locals.data(), locals.size(), remotes.data(), remotes.size(), 0);
 }
@@ -46,7 +46,13 @@ public:
     void addWatch(std::unique_ptr<IRamWatchDetailed> ramwatch);
     void removeWatch(int row);
 
-    void update();
+    /* Poll the values of all watches with batched reads, recording into
+     * the value history of the watches that ask for it */
+    void update(unsigned long framecount);
+
+    /* Write the captured value of every frozen watch back into the game
+     * with a single batched process_vm_writev */
+    void flushFrozen();
 };
 
 #endif
@@ -22,6 +22,8 @@
 #include <QDialogButtonBox>
 #include <QVBoxLayout>
 #include <QHeaderView>
+#include <QFileDialog>
+#include <QMessageBox>
 
 #include "RamWatchWindow.h"
 
@@ -52,6 +54,18 @@ RamWatchWindow::RamWatchWindow(Context* c, QWidget *parent, Qt::WindowFlags flag
     QPushButton *removeWatch = new QPushButton(tr("Remove Watch"));
     connect(removeWatch, &QAbstractButton::clicked, this, &RamWatchWindow::slotRemove);
 
+    QPushButton *freezeWatch = new QPushButton(tr("Freeze Watch"));
+    connect(freezeWatch, &QAbstractButton::clicked, this, &RamWatchWindow::slotFreeze);
+
+    QPushButton *graphWatch = new QPushButton(tr("Graph Watch"));
+    connect(graphWatch, &QAbstractButton::clicked, this, &RamWatchWindow::slotGraph);
+
+    QPushButton *saveHistory = new QPushButton(tr("Save History"));
+    connect(saveHistory, &QAbstractButton::clicked, this, &RamWatchWindow::slotSaveHistory);
+
+    QPushButton *ghostWatch = new QPushButton(tr("Ghost Watch"));
+    connect(ghostWatch, &QAbstractButton::clicked, this, &RamWatchWindow::slotGhost);
+
     QPushButton *scanWatch = new QPushButton(tr("Scan Pointer"));
     connect(scanWatch, &QAbstractButton::clicked, this, &RamWatchWindow::slotScanPointer);
 
@@ -59,6 +73,10 @@ RamWatchWindow::RamWatchWindow(Context* c, QWidget *parent, Qt::WindowFlags flag
     buttonBox->addButton(addWatch, QDialogButtonBox::ActionRole);
     buttonBox->addButton(editWatch, QDialogButtonBox::ActionRole);
     buttonBox->addButton(removeWatch, QDialogButtonBox::ActionRole);
+    buttonBox->addButton(freezeWatch, QDialogButtonBox::ActionRole);
+    buttonBox->addButton(graphWatch, QDialogButtonBox::ActionRole);
+    buttonBox->addButton(saveHistory, QDialogButtonBox::ActionRole);
+    buttonBox->addButton(ghostWatch, QDialogButtonBox::ActionRole);
     buttonBox->addButton(scanWatch, QDialogButtonBox::ActionRole);
 
     /* Create the main layout */
@@ -70,13 +88,17 @@ RamWatchWindow::RamWatchWindow(Context* c, QWidget *parent, Qt::WindowFlags flag
     setLayout(mainLayout);
 
     editWindow = new RamWatchEditWindow(this);
+    graphWindow = new RamWatchGraphWindow(this);
     pointerScanWindow = new PointerScanWindow(c, this);
 }
 
 void RamWatchWindow::update()
 {
     IRamWatchDetailed::game_pid = context->game_pid;
-    ramWatchModel->update();
+    ramWatchModel->update(context->framecount);
+
+    if (graphWindow->isVisible())
+        graphWindow->refresh();
 }
 
 void RamWatchWindow::slotAdd()
@@ -104,6 +126,14 @@ void RamWatchWindow::slotGet(std::string &watch)
     watch += ": ";
     watch += ramWatchModel->ramwatches[index]->value_str();
 
+    /* Show the same-frame value of the ghost run next to the live one */
+    std::string ghost;
+    if (ramWatchModel->ramwatches[index]->ghost_value(context->framecount, ghost)) {
+        watch += " (ghost ";
+        watch += ghost;
+        watch += ")";
+    }
+
     index++;
 }
 
@@ -124,8 +154,13 @@ void RamWatchWindow::slotEdit()
     /* Modify the watch */
     if (editWindow->ramwatch) {
         editWindow->ramwatch->game_pid = context->game_pid;
+
+        /* Detach the graph from the watch being replaced */
+        if (graphWindow->watch() == ramWatchModel->ramwatches[row].get())
+            graphWindow->setWatch(nullptr);
+
         ramWatchModel->ramwatches[row] = std::move(editWindow->ramwatch);
-        ramWatchModel->update();
+        ramWatchModel->update(context->framecount);
     }
 }
 
@@ -139,9 +174,108 @@ void RamWatchWindow::slotRemove()
         return;
 
     int row = index.row();
+
+    /* Detach the graph from the watch being removed */
+    if (graphWindow->watch() == ramWatchModel->ramwatches.at(row).get())
+        graphWindow->setWatch(nullptr);
+
     ramWatchModel->removeWatch(row);
 }
 
+void RamWatchWindow::slotFreeze()
+{
+    const QModelIndex index = ramWatchView->selectionModel()->currentIndex();
+
+    /* If no watch was selected, return */
+    if (!index.isValid())
+        return;
+
+    int row = index.row();
+    IRamWatchDetailed::game_pid = context->game_pid;
+
+    /* Toggle freezing, capturing the current value */
+    ramWatchModel->ramwatches.at(row)->freeze(!ramWatchModel->ramwatches.at(row)->frozen);
+
+    /* Repaint so the frozen marker shows up */
+    ramWatchView->viewport()->update();
+}
+
+void RamWatchWindow::slotFlushFrozen()
+{
+    IRamWatchDetailed::game_pid = context->game_pid;
+    ramWatchModel->flushFrozen();
+}
+
+void RamWatchWindow::slotGraph()
+{
+    const QModelIndex index = ramWatchView->selectionModel()->currentIndex();
+
+    /* If no watch was selected, return */
+    if (!index.isValid())
+        return;
+
+    int row = index.row();
+    IRamWatchDetailed *watch = ramWatchModel->ramwatches.at(row).get();
+
+    /* Start recording the value history. The sampling itself happens inside
+     * the batched poll, and keeps running when the graph is closed */
+    watch->record(true);
+
+    graphWindow->setWatch(watch);
+    graphWindow->show();
+}
+
+void RamWatchWindow::slotSaveHistory()
+{
+    const QModelIndex index = ramWatchView->selectionModel()->currentIndex();
+
+    /* If no watch was selected, return */
+    if (!index.isValid())
+        return;
+
+    IRamWatchDetailed *watch = ramWatchModel->ramwatches.at(index.row()).get();
+
+    if (watch->sample_count() == 0) {
+        QMessageBox::warning(this, tr("libTAS"),
+            tr("This watch has no recorded history. Use Graph Watch to start recording."));
+        return;
+    }
+
+    QString path = QFileDialog::getSaveFileName(this, tr("Save watch history"),
+        QString(), tr("Watch history files (*.lth);;All files (*)"));
+    if (path.isEmpty())
+        return;
+
+    if (!watch->save_history(path.toStdString()))
+        QMessageBox::warning(this, tr("libTAS"), tr("Could not save the watch history."));
+}
+
+void RamWatchWindow::slotGhost()
+{
+    const QModelIndex index = ramWatchView->selectionModel()->currentIndex();
+
+    /* If no watch was selected, return */
+    if (!index.isValid())
+        return;
+
+    IRamWatchDetailed *watch = ramWatchModel->ramwatches.at(index.row()).get();
+
+    /* Toggle: a watch that already follows a ghost drops it */
+    if (watch->has_ghost()) {
+        watch->unload_ghost();
+        return;
+    }
+
+    QString path = QFileDialog::getOpenFileName(this, tr("Load ghost history"),
+        QString(), tr("Watch history files (*.lth);;All files (*)"));
+    if (path.isEmpty())
+        return;
+
+    if (!watch->load_ghost(path.toStdString()))
+        QMessageBox::warning(this, tr("libTAS"),
+            tr("Could not load the ghost history: not a history file, or its value type does not match the watch."));
+}
+
 void RamWatchWindow::slotScanPointer()
 {
     const QModelIndex index = ramWatchView->selectionModel()->currentIndex();
@@ -25,6 +25,7 @@
 
 #include "RamWatchModel.h"
 #include "RamWatchEditWindow.h"
+#include "RamWatchGraphWindow.h"
 #include "PointerScanWindow.h"
 #include "../Context.h"
 
@@ -36,6 +37,7 @@ public:
     void update();
 
     RamWatchEditWindow *editWindow;
+    RamWatchGraphWindow *graphWindow;
     PointerScanWindow *pointerScanWindow;
 
 private:
@@ -47,10 +49,15 @@ private:
 public slots:
     void slotAdd();
     void slotGet(std::string &watch);
+    void slotFlushFrozen();
 
 private slots:
     void slotEdit();
     void slotRemove();
+    void slotFreeze();
+    void slotGraph();
+    void slotSaveHistory();
+    void slotGhost();
     void slotScanPointer();
 
 };
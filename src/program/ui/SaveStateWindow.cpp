@@ -0,0 +1,203 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <QDateTime>
+#include <QGridLayout>
+#include <QGroupBox>
+#include <QImage>
+#include <QPixmap>
+#include <QVBoxLayout>
+#include <atomic>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "SaveStateWindow.h"
+#include "../utils.h"
+
+SaveStateWindow::SaveStateWindow(Context* c, QWidget *parent, Qt::WindowFlags flags) : QDialog(parent, flags), context(c), buffer(nullptr), buffer_pid(0)
+{
+    setWindowTitle("Savestate slots");
+
+    /* One box per slot, in a grid of three columns */
+    QGridLayout* grid = new QGridLayout;
+    for (int slot = 0; slot < SLOTINFO_SLOTS; slot++) {
+        QGroupBox* box = new QGroupBox((slot == SLOTINFO_SLOTS - 1) ?
+            tr("Backtrack") : tr("Slot %1").arg(slot));
+
+        thumbLabels[slot] = new QLabel;
+        thumbLabels[slot]->setMinimumSize(SLOTINFO_MAXWIDTH, SLOTINFO_MAXHEIGHT);
+        thumbLabels[slot]->setAlignment(Qt::AlignCenter);
+
+        textLabels[slot] = new QLabel(tr("empty"));
+        textLabels[slot]->setAlignment(Qt::AlignCenter);
+
+        QVBoxLayout* boxLayout = new QVBoxLayout;
+        boxLayout->addWidget(thumbLabels[slot]);
+        boxLayout->addWidget(textLabels[slot]);
+        box->setLayout(boxLayout);
+
+        /* Hovering a box prefetches the state files of the slot, so that
+         * loading it afterwards hits a warm page cache */
+        box->installEventFilter(this);
+        boxes[slot] = box;
+
+        grid->addWidget(box, slot / 3, slot % 3);
+        shown_seq[slot] = 0;
+    }
+    setLayout(grid);
+
+    /* The slots only change on user savestates, so a slow poll is enough.
+     * The timer only runs while the pane is shown. */
+    timer = new QTimer(this);
+    timer->setInterval(500);
+    connect(timer, &QTimer::timeout, this, &SaveStateWindow::refresh);
+}
+
+bool SaveStateWindow::eventFilter(QObject *obj, QEvent *event)
+{
+    if (event->type() == QEvent::Enter) {
+        for (int slot = 0; slot < SLOTINFO_SLOTS; slot++) {
+            if (obj == boxes[slot]) {
+                prefetch_savestate(context, slot);
+                break;
+            }
+        }
+    }
+    return QDialog::eventFilter(obj, event);
+}
+
+void SaveStateWindow::showEvent(QShowEvent *event)
+{
+    refresh();
+    timer->start();
+    QDialog::showEvent(event);
+}
+
+void SaveStateWindow::hideEvent(QHideEvent *event)
+{
+    timer->stop();
+    unmapBuffer();
+    QDialog::hideEvent(event);
+}
+
+bool SaveStateWindow::mapBuffer()
+{
+    if (buffer && (buffer_pid == context->game_pid))
+        return true;
+
+    unmapBuffer();
+
+    if (!context->game_pid)
+        return false;
+
+    /* The game passes the buffer as a sealed memfd during its init
+     * handshake, so not having it yet just means trying again at the
+     * next tick. The descriptor belongs to the context, only the mapping
+     * is ours. */
+    int fd = context->slotinfo_fd;
+    if (fd < 0)
+        return false;
+
+    struct stat filestat;
+    if ((fstat(fd, &filestat) < 0) || (filestat.st_size < static_cast<off_t>(sizeof(SlotInfoBuffer))))
+        return false;
+
+    void* map = mmap(nullptr, sizeof(SlotInfoBuffer), PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+        return false;
+
+    buffer = static_cast<const SlotInfoBuffer*>(map);
+    if ((memcmp(buffer->magic, SLOTINFO_MAGIC, 4) != 0) || (buffer->version != SLOTINFO_VERSION)) {
+        unmapBuffer();
+        return false;
+    }
+
+    buffer_pid = context->game_pid;
+    for (int slot = 0; slot < SLOTINFO_SLOTS; slot++)
+        shown_seq[slot] = 0;
+    return true;
+}
+
+void SaveStateWindow::unmapBuffer()
+{
+    if (buffer)
+        munmap(const_cast<void*>(static_cast<const void*>(buffer)), sizeof(SlotInfoBuffer));
+    buffer = nullptr;
+    buffer_pid = 0;
+}
+
+void SaveStateWindow::refresh()
+{
+    if (context->status == Context::INACTIVE) {
+        unmapBuffer();
+        return;
+    }
+
+    if (!mapBuffer())
+        return;
+
+    for (int slot = 0; slot < SLOTINFO_SLOTS; slot++) {
+        const SlotInfoEntry* entry = &buffer->entries[slot];
+
+        /* An odd sequence number means the writer is inside the entry, so
+         * we just retry at the next tick */
+        uint32_t seq = entry->seq;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if ((seq & 1) || (seq == shown_seq[slot]))
+            continue;
+
+        if (!entry->valid)
+            continue;
+
+        uint64_t framecount = entry->framecount;
+        uint64_t game_sec = entry->game_time_sec;
+        uint32_t game_nsec = entry->game_time_nsec;
+        uint64_t save_time = entry->save_time;
+
+        int width = entry->width;
+        int height = entry->height;
+        QImage image;
+        if ((width > 0) && (width <= SLOTINFO_MAXWIDTH) &&
+            (height > 0) && (height <= SLOTINFO_MAXHEIGHT)) {
+            image = QImage(width, height, QImage::Format_RGB32);
+            for (int y = 0; y < height; y++)
+                memcpy(image.scanLine(y), entry->pixels + static_cast<size_t>(y) * width, width * 4);
+        }
+
+        /* Discard the copy if the writer reused the entry during it */
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (entry->seq != seq)
+            continue;
+
+        if (!image.isNull())
+            thumbLabels[slot]->setPixmap(QPixmap::fromImage(image));
+        else
+            thumbLabels[slot]->clear();
+
+        textLabels[slot]->setText(tr("frame %1, game time %2.%3 s\nsaved at %4")
+            .arg(framecount)
+            .arg(game_sec)
+            .arg(game_nsec / 100000000)
+            .arg(QDateTime::fromSecsSinceEpoch(save_time).toString("hh:mm:ss")));
+
+        shown_seq[slot] = seq;
+    }
+}
@@ -0,0 +1,73 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_SAVESTATEWINDOW_H_INCLUDED
+#define LIBTAS_SAVESTATEWINDOW_H_INCLUDED
+
+#include <QDialog>
+#include <QGroupBox>
+#include <QLabel>
+#include <QTimer>
+#include <stdint.h>
+
+#include "../Context.h"
+#include "../../shared/slotinfobuffer.h"
+
+/* Pane displaying the content of every numbered savestate slot: frame,
+ * game time, save time and a thumbnail of the saved frame. The game
+ * publishes the information into a shared-memory buffer at each save, so
+ * showing it costs no disk I/O and no message on the socket. */
+class SaveStateWindow : public QDialog {
+    Q_OBJECT
+public:
+    SaveStateWindow(Context *c, QWidget *parent = Q_NULLPTR, Qt::WindowFlags flags = 0);
+
+protected:
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+
+    /* Watch the slot boxes for hovering, to prefetch the hovered state */
+    bool eventFilter(QObject *obj, QEvent *event) override;
+
+private slots:
+    /* Poll the shared-memory buffer for updated slots */
+    void refresh();
+
+private:
+    /* Map the shared-memory buffer of the current game, if not done yet */
+    bool mapBuffer();
+    void unmapBuffer();
+
+    Context *context;
+    QTimer *timer;
+
+    const SlotInfoBuffer* buffer;
+    int buffer_pid;
+
+    /* One box, one thumbnail and one caption per numbered slot */
+    QGroupBox* boxes[SLOTINFO_SLOTS];
+    QLabel* thumbLabels[SLOTINFO_SLOTS];
+    QLabel* textLabels[SLOTINFO_SLOTS];
+
+    /* Sequence number of the entry shown for each slot, to skip the
+     * repaint of unchanged slots */
+    uint32_t shown_seq[SLOTINFO_SLOTS];
+};
+
+#endif
@@ -18,7 +18,12 @@
  */
 
 #include "utils.h"
+#include "Greenzone.h"
+#include <fcntl.h> // open, posix_fadvise
 #include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h> // SYS_copy_file_range
+#include <linux/fs.h> // FICLONE
 #include <cerrno> // errno
 #include <cstring> // strerror
 #include <iostream>
@@ -59,4 +64,113 @@ void remove_savestates(Context* context)
         std::string savestatepspath = savestateprefix + ".state" + std::to_string(i) + ".p";
         unlink(savestatepspath.c_str());
     }
+
+    /* Also remove the placeholder files of the greenzone states */
+    for (int i=Greenzone::FIRST_INDEX; i<Greenzone::FIRST_INDEX+Greenzone::NB_SLOTS; i++) {
+        std::string savestatepmpath = savestateprefix + ".state" + std::to_string(i) + ".pm";
+        unlink(savestatepmpath.c_str());
+        std::string savestatepspath = savestateprefix + ".state" + std::to_string(i) + ".p";
+        unlink(savestatepspath.c_str());
+    }
+}
+
+void prefetch_savestate(Context* context, int statei)
+{
+    /* States stored in RAM live in memfds of the game process, there is
+     * no page cache to warm up */
+    if (context->config.sc.savestates_in_ram)
+        return;
+
+    std::string savestateprefix = context->config.savestatedir + '/';
+    savestateprefix += context->gamename;
+    savestateprefix += ".state" + std::to_string(statei);
+
+    const std::string paths[2] = {savestateprefix + ".pm", savestateprefix + ".p"};
+    for (const std::string& path : paths) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            continue;
+
+        /* The readahead keeps going after the file is closed, so this only
+         * costs the time to queue it */
+        posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+        close(fd);
+    }
+}
+
+int copy_file(const std::string& src, const std::string& dest)
+{
+    int srcfd = open(src.c_str(), O_RDONLY);
+    if (srcfd < 0) {
+        std::cerr << "Error opening " << src << ": " << strerror(errno) << std::endl;
+        return -1;
+    }
+
+    struct stat sb;
+    if (fstat(srcfd, &sb) < 0) {
+        std::cerr << "Error accessing " << src << ": " << strerror(errno) << std::endl;
+        close(srcfd);
+        return -1;
+    }
+
+    int destfd = open(dest.c_str(), O_WRONLY | O_CREAT | O_TRUNC, sb.st_mode & 0777);
+    if (destfd < 0) {
+        std::cerr << "Error creating " << dest << ": " << strerror(errno) << std::endl;
+        close(srcfd);
+        return -1;
+    }
+
+#ifdef FICLONE
+    /* Share the extents instead of duplicating them, when the filesystem
+     * supports it. Only metadata is written, whatever the file size */
+    if (ioctl(destfd, FICLONE, srcfd) == 0) {
+        close(srcfd);
+        close(destfd);
+        return 0;
+    }
+#endif
+
+    /* Copy in the kernel, without bouncing the data through userspace. Called
+     * through syscall() so that building against an old glibc still works */
+    off_t remaining = sb.st_size;
+#ifdef SYS_copy_file_range
+    while (remaining > 0) {
+        ssize_t n = syscall(SYS_copy_file_range, srcfd, nullptr, destfd, nullptr, static_cast<size_t>(remaining), 0u);
+        if (n <= 0)
+            break;
+        remaining -= n;
+    }
+#endif
+
+    /* Fall back to a plain read/write loop, for kernels or filesystem pairs
+     * where copy_file_range is not available */
+    if (remaining > 0) {
+        lseek(srcfd, sb.st_size - remaining, SEEK_SET);
+        lseek(destfd, sb.st_size - remaining, SEEK_SET);
+        char buf[65536];
+        ssize_t n;
+        while ((n = read(srcfd, buf, sizeof(buf))) > 0) {
+            ssize_t written = 0;
+            while (written < n) {
+                ssize_t w = write(destfd, buf + written, n - written);
+                if (w < 0) {
+                    std::cerr << "Error writing " << dest << ": " << strerror(errno) << std::endl;
+                    close(srcfd);
+                    close(destfd);
+                    return -1;
+                }
+                written += w;
+            }
+            remaining -= n;
+        }
+    }
+
+    close(srcfd);
+    close(destfd);
+
+    if (remaining > 0) {
+        std::cerr << "Error copying " << src << ": " << strerror(errno) << std::endl;
+        return -1;
+    }
+    return 0;
 }
@@ -29,4 +29,15 @@ int create_dir(std::string& path);
 /* Remove savestate files */
 void remove_savestates(Context* context);
 
+/* Hint the kernel to read the files of a savestate slot into the page cache,
+ * so that an upcoming load of a cold state does not stall on disk or
+ * network I/O */
+void prefetch_savestate(Context* context, int statei);
+
+/* Copy a file, trying a reflink first so that the duplication is
+ * metadata-speed on filesystems supporting it (XFS, btrfs), then
+ * copy_file_range so the data does not cross into userspace, then a plain
+ * read/write loop. Returns 0 on success or -1 on error */
+int copy_file(const std::string& src, const std::string& dest);
+
 #endif
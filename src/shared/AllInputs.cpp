@@ -18,9 +18,21 @@
  */
 
 #include "AllInputs.h"
+#include "sockethelpers.h"
 #include <X11/keysym.h>
 #include <iostream>
 
+/* Sections of the delta-encoded wire format. The restart flag is a bool,
+ * so its value is carried in the flag byte directly. */
+enum {
+    DELTA_KEYBOARD = 0x01,
+    DELTA_POINTER_COORDS = 0x02,
+    DELTA_POINTER_MASK = 0x04,
+    DELTA_CONTROLLER_AXES = 0x08,
+    DELTA_CONTROLLER_BUTTONS = 0x10,
+    DELTA_RESTART = 0x20,
+};
+
 void AllInputs::emptyInputs() {
     int i,j;
     for (i=0; i<MAXKEYS; i++)
@@ -166,6 +178,59 @@ int AllInputs::toggleInput(const SingleInput &si)
     return !value;
 }
 
+void AllInputs::sendDelta(const AllInputs& ref) const
+{
+    uint8_t flags = 0;
+    if (keyboard != ref.keyboard)
+        flags |= DELTA_KEYBOARD;
+    if ((pointer_x != ref.pointer_x) || (pointer_y != ref.pointer_y))
+        flags |= DELTA_POINTER_COORDS;
+    if (pointer_mask != ref.pointer_mask)
+        flags |= DELTA_POINTER_MASK;
+    if (controller_axes != ref.controller_axes)
+        flags |= DELTA_CONTROLLER_AXES;
+    if (controller_buttons != ref.controller_buttons)
+        flags |= DELTA_CONTROLLER_BUTTONS;
+    if (restart)
+        flags |= DELTA_RESTART;
+
+    sendData(&flags, sizeof(uint8_t));
+
+    if (flags & DELTA_KEYBOARD)
+        sendData(keyboard.data(), MAXKEYS * sizeof(uint32_t));
+    if (flags & DELTA_POINTER_COORDS) {
+        sendData(&pointer_x, sizeof(int));
+        sendData(&pointer_y, sizeof(int));
+    }
+    if (flags & DELTA_POINTER_MASK)
+        sendData(&pointer_mask, sizeof(unsigned int));
+    if (flags & DELTA_CONTROLLER_AXES)
+        sendData(controller_axes.data(), MAXJOYS * MAXAXES * sizeof(short));
+    if (flags & DELTA_CONTROLLER_BUTTONS)
+        sendData(controller_buttons.data(), MAXJOYS * sizeof(unsigned short));
+}
+
+void AllInputs::receiveDelta()
+{
+    uint8_t flags;
+    receiveData(&flags, sizeof(uint8_t));
+
+    if (flags & DELTA_KEYBOARD)
+        receiveData(keyboard.data(), MAXKEYS * sizeof(uint32_t));
+    if (flags & DELTA_POINTER_COORDS) {
+        receiveData(&pointer_x, sizeof(int));
+        receiveData(&pointer_y, sizeof(int));
+    }
+    if (flags & DELTA_POINTER_MASK)
+        receiveData(&pointer_mask, sizeof(unsigned int));
+    if (flags & DELTA_CONTROLLER_AXES)
+        receiveData(controller_axes.data(), MAXJOYS * MAXAXES * sizeof(short));
+    if (flags & DELTA_CONTROLLER_BUTTONS)
+        receiveData(controller_buttons.data(), MAXJOYS * sizeof(unsigned short));
+
+    restart = flags & DELTA_RESTART;
+}
+
 void AllInputs::extractInputs(std::set<SingleInput> &input_set) const
 {
     for (const KeySym& ks : keyboard) {
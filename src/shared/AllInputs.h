@@ -26,6 +26,7 @@
 typedef unsigned long int KeySym;
 #include <array>
 #include <set>
+#include <cstdint>
 
 /* Input structure that is filled by libTAS and send to the game every frame
  * Structure is inspired by SDL.
@@ -38,10 +39,9 @@ class AllInputs {
         static const int MAXAXES = 6;
 
         /* Keyboard state. Each element is a (X11) KeySym of a pressed key.
-         * KeySym is a 4-byte integer struct containing a key symbol or meaning,
-         * not the physical key itself, so it can contain misc or non-latin symbols
-         * for example. It should work well with computers with
-         * different keyboard layouts.
+         * A KeySym contains a key symbol or meaning, not the physical key
+         * itself, so it can contain misc or non-latin symbols for example.
+         * It should work well with computers with different keyboard layouts.
          *
          * We choose a set of keys of a fixed size, instead of a bitmap of all
          * keys. The drawback is that we are limited by the number of
@@ -50,9 +50,15 @@ class AllInputs {
          * - Bitmap: ~2400 different KeySym / 8 = 300 bytes
          * and there would be a highly non-trivial translation between bitmap
          * position and equivalent KeySym.
+         *
+         * KeySym values only use 29 bits, so they are stored as 4-byte
+         * integers even though the X11 KeySym type is 8 bytes. The program
+         * keeps one AllInputs per movie frame, so halving the keyboard array
+         * matters for long movies. The binary moviefile format already
+         * stores keysyms this way.
          */
 
-        std::array<KeySym,MAXKEYS> keyboard;
+        std::array<uint32_t,MAXKEYS> keyboard;
 
         /* Pointer coordinates relative to the origin of the game window */
         int pointer_x;
@@ -101,6 +107,16 @@ class AllInputs {
         /* Extract all single inputs and insert them in the set */
         void extractInputs(std::set<SingleInput> &set) const;
 
+        /* Send the inputs over the socket as a delta against a reference,
+         * one flag byte followed by the sections that changed. Consecutive
+         * frames usually differ by a button or two, so the message shrinks
+         * from the full struct to a few bytes. */
+        void sendDelta(const AllInputs& ref) const;
+
+        /* Receive a delta from the socket and apply it onto the current
+         * content, which must equal the reference used by the sender */
+        void receiveDelta();
+
 };
 
 #endif
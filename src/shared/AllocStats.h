@@ -0,0 +1,66 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_ALLOCSTATS_H_INCLUDED
+#define LIBTAS_ALLOCSTATS_H_INCLUDED
+
+#include <cstdint>
+
+/* Aggregated allocation samples, recorded by the malloc wrappers and
+ * shipped to the program about once per second (MSGB_ALLOC_STATS).
+ *
+ * Allocations are sampled 1-in-sample_rate, so counts and bytes are
+ * estimates: multiply by sample_rate to approximate the real traffic.
+ * Callsites are the return addresses of the sampled malloc/calloc/realloc
+ * calls, aggregated in the library and truncated here to the heaviest
+ * sites by bytes. */
+struct AllocStats {
+    /* Number of callsites kept per interval */
+    static const int MAX_SITES = 16;
+
+    struct Site {
+        /* Return address of the allocation call */
+        uint64_t address;
+
+        /* Sampled number of allocations from this site */
+        uint64_t count;
+
+        /* Sampled bytes requested from this site */
+        uint64_t bytes;
+    };
+
+    /* The heaviest callsites of the interval, sorted by bytes */
+    Site sites[MAX_SITES];
+
+    /* Number of valid entries in sites */
+    uint32_t site_count;
+
+    /* One allocation out of sample_rate is recorded */
+    uint32_t sample_rate;
+
+    /* Sampled allocations and bytes over the whole interval, including
+     * callsites that did not make the cut */
+    uint64_t total_count;
+    uint64_t total_bytes;
+
+    /* Wall-clock length of the interval in nanoseconds */
+    uint64_t interval_ns;
+};
+
+#endif
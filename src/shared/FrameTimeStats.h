@@ -0,0 +1,59 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_FRAMETIMESTATS_H_INCLUDED
+#define LIBTAS_FRAMETIMESTATS_H_INCLUDED
+
+#include <cstdint>
+
+/* Aggregated frame timing spans, recorded by the library and shipped to
+ * the program about once per second (MSGB_FRAMETIME_STATS).
+ *
+ * Spans are accumulated in timestamp-counter ticks, so the recording cost
+ * on the hot path is a pair of rdtsc reads. The tick rate does not need
+ * to be known by either side: the struct carries both the tick length and
+ * the wall-clock length of the interval, so the program can convert a
+ * span into wall time with span_ticks * interval_ns / interval_ticks.
+ */
+struct FrameTimeStats {
+    enum Span {
+        SPAN_SLEEP,     /* frame pacing sleep in exitFrameBoundary() */
+        SPAN_AUDIO,     /* audio mixing */
+        SPAN_CAPTURE,   /* screen capture */
+        SPAN_HUD,       /* OSD rendering */
+        SPAN_ENCODE,    /* audio/video encoding */
+        SPAN_DRAW,      /* the game draw command */
+        SPAN_WAIT,      /* waiting on messages from the program */
+        SPAN_COUNT
+    };
+
+    /* Ticks spent inside each span during the interval */
+    uint64_t span_ticks[SPAN_COUNT];
+
+    /* Ticks spanning the whole interval */
+    uint64_t interval_ticks;
+
+    /* Wall-clock length of the interval in nanoseconds */
+    uint64_t interval_ns;
+
+    /* Number of frame boundaries during the interval */
+    uint32_t frames;
+};
+
+#endif
@@ -127,6 +127,14 @@ struct SharedConfig {
      */
     bool write_savefiles_on_exit = false;
 
+    /* Answer repeated failing file lookups (open/stat/access returning
+     * ENOENT) from memory instead of the kernel. Games probe for assets
+     * with storms of failing lookups at startup. Opt-in, because it is only
+     * safe when nothing outside the game creates files in the probed
+     * directories while it runs.
+     */
+    bool cache_file_metadata = false;
+
     /** Sound config **/
     /* Bit depth of the buffer (usually 8 or 16) */
     int audio_bitdepth = 16;
@@ -167,6 +175,11 @@ struct SharedConfig {
 
     bool save_screenpixels = true;
 
+    /* Publish downscaled frames into the shared-memory preview buffer, so
+     * the program can display the game while its window is not watchable.
+     * Enabled while the preview pane of the program is open. */
+    bool screen_preview = false;
+
     /* Initial system time at game startup */
     struct timespec initial_time = {1, 0};
 
@@ -180,9 +193,42 @@ struct SharedConfig {
     /* Storing savestates in RAM */
     bool savestates_in_ram = false;
 
+    /* Compressing savestate memory pages with zstd. Only effective if the
+     * library was built with zstd support. */
+    bool compressed_savestates = false;
+
+    /* Perform the savestate memory dump in a forked child process on a
+     * copy-on-write snapshot, so that the game resumes immediately */
+    bool background_savestates = false;
+
+    /* Deduplicating savestate memory pages into a content-addressed store
+     * shared by all slots, so that identical pages across slots are only
+     * stored once */
+    bool dedup_savestates = false;
+
+    /* Saving a state in the rewind ring buffer at each frame boundary, so
+     * that we can step back one frame almost instantly. Only effective with
+     * incremental savestates stored in RAM. */
+    bool rewind_savestates = false;
+
+    /* Loading file-backed savestates by memory-mapping large page runs of
+     * the pages file instead of reading them, so that the state content is
+     * faulted in lazily and the game resumes earlier */
+    bool mmap_loadstates = false;
+
+    /* Storing a checksum of the savestate files when saving, verified when
+     * loading, so that a corrupted state file is reported at load time
+     * instead of crashing the game minutes later */
+    bool checksum_savestates = false;
+
     /* Saving a backtrack savestate each time a thread is created/destroyed */
     bool backtrack_savestate = true;
 
+    /* Computing a sampled digest of the game writable memory and framebuffer
+     * at each frame boundary, and sending it to the program. Digests recorded
+     * in a movie pinpoint the exact first divergent frame when replaying. */
+    bool state_digest = false;
+
     /* Debug flags */
     enum DebugFlags {
         DEBUG_UNCONTROLLED_TIME = 0x01, // Using undeterministic timer
@@ -193,6 +239,22 @@ struct SharedConfig {
 
     bool recycle_threads = true;
 
+    /* Serve game allocations from a deterministic arena allocator instead of
+     * glibc malloc, so that identical replays produce identical heap layouts.
+     * This reduces incremental savestate sizes, because freed-then-reused
+     * memory ends up at the same addresses instead of dirtying new pages. */
+    bool deterministic_heap = false;
+
+    /* Sample game allocations and send per-callsite counts and bytes to the
+     * program, to show which subsystems dirty memory between savestates */
+    bool alloc_profiling = false;
+
+    /* Serve rand()/random() from an in-library batched xoshiro generator
+     * instead of forwarding each call to libc. The sequence differs from
+     * libc but is bit-exact across replays, and much cheaper for games
+     * calling rand() millions of times during level generation */
+    bool fast_prng = false;
+
     /* An enum indicating which lang are we enforcing */
     enum LocaleType
     {
@@ -131,6 +131,12 @@ enum {
      */
     MSGN_LOADSTATE,
 
+    /*
+     * Ask the game to load the most recent state of the rewind ring buffer
+     * Argument: none
+     */
+    MSGN_REWINDSTATE,
+
     /*
      * Tells the program that the loading succeeded
      * Argument: none
@@ -220,6 +226,97 @@ enum {
      * Argument: size_t (string length) then char[len]
      */
     MSGN_STEAM_USER_DATA_PATH,
+
+    /*
+     * Send aggregated frame timing spans to the program.
+     * Argument: FrameTimeStats
+     */
+    MSGB_FRAMETIME_STATS,
+
+    /*
+     * Send the sampled state digest of the current frame to the program.
+     * Argument: uint64_t
+     */
+    MSGB_STATE_DIGEST,
+
+    /*
+     * Send aggregated allocation samples to the program.
+     * Argument: AllocStats
+     */
+    MSGB_ALLOC_STATS,
+
+    /*
+     * Restart the game in place by loading the pristine boot state whose
+     * index/path were sent beforehand, instead of relaunching the process.
+     * Sent a second time after the post-load MSGN_CONFIG so the game
+     * re-runs its boot-time frame count and timer initialization.
+     * Argument: none
+     */
+    MSGN_ZYGOTE_RESTART,
+
+    /*
+     * Stream the inputs of the upcoming replay frames in one batch. The
+     * game consumes them locally (free-run) and stops answering frame
+     * boundaries until the batch is exhausted or invalidated, so the
+     * program must not send anything but MSGN_INPUT_BATCH_INVALIDATE
+     * while the batch is live.
+     * Argument: uint64_t (first frame) then uint64_t (frame count) then
+     * AllInputs[count]
+     */
+    MSGN_INPUT_BATCH,
+
+    /*
+     * Invalidate the streamed input batch, making the game answer the
+     * next frame boundary again.
+     * Argument: none
+     */
+    MSGN_INPUT_BATCH_INVALIDATE,
+
+    /*
+     * Send the list of mapping path patterns excluded from savestates,
+     * one fnmatch() glob per line. An empty list clears the exclusions.
+     * Argument: size_t (string length) then char[len]
+     */
+    MSGN_SAVESTATE_IGNORE,
+
+    /*
+     * Notify that the game dropped out of free-run and answers frame
+     * boundaries again, so the program resumes sending the per-boundary
+     * messages. Sent as part of the frame boundary batch.
+     * Argument: none
+     */
+    MSGB_LOCKSTEP,
+
+    /*
+     * Send the CLOCK_MONOTONIC timestamp of the last input application,
+     * as part of the frame boundary batch, for the end-to-end input
+     * latency measurement of the program.
+     * Argument: uint64_t (nanoseconds)
+     */
+    MSGB_INPUT_APPLIED,
+
+    /*
+     * Hand the program the shared preview buffer, as a sealed memfd passed
+     * over the stream socket, during the init handshake.
+     * Argument: file descriptor (SCM_RIGHTS, see sendFd())
+     */
+    MSGB_PREVIEW_FD,
+
+    /*
+     * Hand the program the shared savestate slot info buffer, as a sealed
+     * memfd passed over the stream socket, during the init handshake.
+     * Argument: file descriptor (SCM_RIGHTS, see sendFd())
+     */
+    MSGB_SLOTINFO_FD,
+
+    /*
+     * Send the inputs of the frame as a delta against the inputs of the
+     * previous MSGN_ALL_INPUTS(_DELTA) message. The program sends a full
+     * MSGN_ALL_INPUTS keyframe periodically and after every state load,
+     * which rolls back the reference held by the game.
+     * Argument: see AllInputs::sendDelta()
+     */
+    MSGN_ALL_INPUTS_DELTA,
 };
 
 #endif
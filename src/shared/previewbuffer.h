@@ -0,0 +1,77 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_PREVIEWBUFFER_H_INCLUDED
+#define LIBTAS_PREVIEWBUFFER_H_INCLUDED
+
+#include <stdint.h>
+
+/* Layout of the shared-memory game preview buffer.
+ *
+ * The library downscales some of the captured frames and writes them into
+ * this buffer, which lives in an anonymous sealed memfd passed to the
+ * program over the socket (see sendFd()), so the program can display the
+ * game without a rendering context and without any message on the socket.
+ *
+ * The writer cycles over three slots and never blocks: each slot carries a
+ * sequence number that is odd while the slot is being written, so the
+ * reader maps the memfd read-only, copies the latest slot and retries
+ * later if the sequence number was odd or changed during the copy. The
+ * dirty row range tells the reader which rows differ from the previously
+ * published frame, so an idle screen costs almost nothing to repaint. */
+
+#define PREVIEW_MAGIC "LTPV"
+#define PREVIEW_VERSION 1
+
+/* Frames are downscaled by an integer factor until they fit */
+#define PREVIEW_MAXWIDTH 854
+#define PREVIEW_MAXHEIGHT 480
+
+struct PreviewSlot {
+    /* Incremented before and after the slot is written, odd while the
+     * content is inconsistent */
+    uint32_t seq;
+
+    /* Range of rows that differ from the previously published frame */
+    uint32_t dirty_first;
+    uint32_t dirty_last;
+
+    /* Frame of the game at which the slot was published */
+    uint64_t framecount;
+
+    /* Downscaled frame, stored as rows of 0xffRRGGBB pixels */
+    uint32_t pixels[PREVIEW_MAXWIDTH * PREVIEW_MAXHEIGHT];
+};
+
+struct PreviewBuffer {
+    char magic[4];
+    uint32_t version;
+
+    /* Dimensions of the downscaled frames */
+    int32_t width;
+    int32_t height;
+
+    /* Index of the slot that was completely written last */
+    uint32_t latest;
+
+    /* Not named "slots", which Qt defines as a macro */
+    struct PreviewSlot frame_slots[3];
+};
+
+#endif
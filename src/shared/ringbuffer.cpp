@@ -0,0 +1,334 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ringbuffer.h"
+#include <atomic>
+#include <cstring>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+
+/* Name of the region in /dev/shm, suffixed with the instance id when
+ * several program/game pairs run concurrently (see socketPath() in
+ * sockethelpers.cpp). Checkpoint::skipArea() matches the "libtas-ring"
+ * substring to keep the region out of savestates */
+static const char* ringName(void)
+{
+    static char name[64] = {0};
+    if (!name[0]) {
+        const char* instance = getenv("LIBTAS_INSTANCE");
+        if (instance && instance[0])
+            snprintf(name, sizeof(name), "/libtas-ring-%s", instance);
+        else
+            snprintf(name, sizeof(name), "/libtas-ring");
+    }
+    return name;
+}
+
+#define RING_MAGIC 0x52544C54 /* "TLTR" */
+
+/* Capacity of one direction. Must be a power of two, so free-running
+ * counters can be reduced to an index with a mask. One frame boundary
+ * exchanges well under a kilobyte, so this never fills up in the steady
+ * state; larger payloads are streamed through in chunks. */
+#define RING_CAPACITY (64*1024)
+
+/* How many times a side rereads the counters before sleeping on the
+ * futex. At high fast-forward rates the other side catches up within the
+ * spin, so neither side ever enters the kernel. */
+#define RING_SPIN_COUNT 4000
+
+/* One direction of the transport. Written by one process, read by the
+ * other. `head` counts bytes ever written and `tail` bytes ever read,
+ * both free-running; the reader sleeps on `head` and the writer on
+ * `tail`, and the waiter counters let the other side skip the wake
+ * syscall when no one is asleep. */
+struct RingHalf {
+    std::atomic<uint32_t> head;
+    std::atomic<uint32_t> head_waiters;
+    std::atomic<uint32_t> tail;
+    std::atomic<uint32_t> tail_waiters;
+    uint8_t buffer[RING_CAPACITY];
+};
+
+struct RingRegion {
+    uint32_t magic;
+    RingHalf to_game;    /* written by the program, read by the game */
+    RingHalf to_program; /* written by the game, read by the program */
+};
+
+static RingRegion* ring_region = nullptr;
+
+/* Ring written by us / read by us, depending on which side we are */
+static RingHalf* send_half = nullptr;
+static RingHalf* recv_half = nullptr;
+
+/* Socket polled to detect the death of the other side */
+static int peer_socket = -1;
+
+static int futex(std::atomic<uint32_t>* addr, int op, uint32_t val, const struct timespec* timeout)
+{
+    return syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), op, val, timeout, nullptr, 0);
+}
+
+/* Check if the other side is still alive, by polling the socket that is
+ * kept open next to the ring */
+static bool isPeerAlive(void)
+{
+    if (peer_socket < 0)
+        return true;
+
+    struct pollfd pfd;
+    pfd.fd = peer_socket;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    if (poll(&pfd, 1, 0) <= 0)
+        return true;
+
+    if (pfd.revents & (POLLHUP | POLLERR | POLLNVAL))
+        return false;
+
+    if (pfd.revents & POLLIN) {
+        /* Data on the socket while the ring is connected means the other
+         * side closed it (recv returns 0), because all traffic goes
+         * through the ring */
+        char c;
+        if (recv(peer_socket, &c, 1, MSG_PEEK | MSG_DONTWAIT) == 0)
+            return false;
+    }
+
+    return true;
+}
+
+/* Wait for the counter to leave the observed value. Returns false when
+ * the other side died while we were waiting. */
+static bool waitOnCounter(std::atomic<uint32_t>* counter, std::atomic<uint32_t>* waiters, uint32_t observed)
+{
+    for (int i = 0; i < RING_SPIN_COUNT; i++) {
+        if (counter->load(std::memory_order_acquire) != observed)
+            return true;
+    }
+
+    /* Wake up periodically to check that the other side is still there */
+    const struct timespec timeout = {0, 100L*1000L*1000L};
+
+    while (counter->load(std::memory_order_acquire) == observed) {
+        waiters->fetch_add(1, std::memory_order_seq_cst);
+        futex(counter, FUTEX_WAIT, observed, &timeout);
+        waiters->fetch_sub(1, std::memory_order_seq_cst);
+
+        if (!isPeerAlive())
+            return false;
+    }
+
+    return true;
+}
+
+static void wakeCounter(std::atomic<uint32_t>* counter, std::atomic<uint32_t>* waiters)
+{
+    if (waiters->load(std::memory_order_seq_cst) != 0)
+        futex(counter, FUTEX_WAKE, 1, nullptr);
+}
+
+static void initRegion(RingRegion* region)
+{
+    region->to_game.head.store(0);
+    region->to_game.head_waiters.store(0);
+    region->to_game.tail.store(0);
+    region->to_game.tail_waiters.store(0);
+    region->to_program.head.store(0);
+    region->to_program.head_waiters.store(0);
+    region->to_program.tail.store(0);
+    region->to_program.tail_waiters.store(0);
+    region->magic = RING_MAGIC;
+}
+
+bool initRingGame(void)
+{
+    /* Escape hatch for test/ipcbench: declining to create the region makes
+     * both sides fall back to the socket, so the two transports can be
+     * measured against each other */
+    const char* disable = getenv("LIBTAS_DISABLE_RING");
+    if (disable && disable[0])
+        return false;
+
+    const int fd = shm_open(ringName(), O_CREAT | O_TRUNC | O_RDWR, 0600);
+    if (fd < 0)
+        return false;
+
+    if (ftruncate(fd, sizeof(RingRegion)) < 0) {
+        close(fd);
+        shm_unlink(ringName());
+        return false;
+    }
+
+    void* addr = mmap(nullptr, sizeof(RingRegion), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        shm_unlink(ringName());
+        return false;
+    }
+
+    ring_region = static_cast<RingRegion*>(addr);
+    initRegion(ring_region);
+    send_half = &ring_region->to_program;
+    recv_half = &ring_region->to_game;
+    return true;
+}
+
+bool initRingProgram(void)
+{
+    const int fd = shm_open(ringName(), O_RDWR, 0600);
+    if (fd < 0)
+        return false;
+
+    void* addr = mmap(nullptr, sizeof(RingRegion), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED)
+        return false;
+
+    ring_region = static_cast<RingRegion*>(addr);
+    if (ring_region->magic != RING_MAGIC) {
+        closeRing();
+        return false;
+    }
+
+    send_half = &ring_region->to_game;
+    recv_half = &ring_region->to_program;
+    return true;
+}
+
+void setRingPeerSocket(int fd)
+{
+    peer_socket = fd;
+}
+
+void closeRing(void)
+{
+    if (ring_region) {
+        munmap(ring_region, sizeof(RingRegion));
+        ring_region = nullptr;
+        send_half = nullptr;
+        recv_half = nullptr;
+    }
+    peer_socket = -1;
+}
+
+void removeRing(void)
+{
+    shm_unlink(ringName());
+}
+
+bool isRingConnected(void)
+{
+    return ring_region != nullptr;
+}
+
+void ringSend(const void* elem, size_t size)
+{
+    const uint8_t* data = static_cast<const uint8_t*>(elem);
+    RingHalf* half = send_half;
+
+    while (size > 0) {
+        const uint32_t tail = half->tail.load(std::memory_order_acquire);
+        const uint32_t head = half->head.load(std::memory_order_relaxed);
+        const uint32_t space = RING_CAPACITY - (head - tail);
+
+        if (space == 0) {
+            if (!waitOnCounter(&half->tail, &half->tail_waiters, tail))
+                return;
+            continue;
+        }
+
+        uint32_t chunk = size < space ? size : space;
+
+        /* The chunk may wrap around the end of the buffer */
+        const uint32_t index = head & (RING_CAPACITY - 1);
+        const uint32_t contiguous = RING_CAPACITY - index;
+        if (chunk <= contiguous) {
+            memcpy(half->buffer + index, data, chunk);
+        }
+        else {
+            memcpy(half->buffer + index, data, contiguous);
+            memcpy(half->buffer, data + contiguous, chunk - contiguous);
+        }
+
+        half->head.store(head + chunk, std::memory_order_release);
+        wakeCounter(&half->head, &half->head_waiters);
+
+        data += chunk;
+        size -= chunk;
+    }
+}
+
+size_t ringBytesAvailable(void)
+{
+    RingHalf* half = recv_half;
+    const uint32_t head = half->head.load(std::memory_order_acquire);
+    const uint32_t tail = half->tail.load(std::memory_order_relaxed);
+    return head - tail;
+}
+
+int ringReceive(void* elem, size_t size)
+{
+    uint8_t* data = static_cast<uint8_t*>(elem);
+    RingHalf* half = recv_half;
+    size_t received = 0;
+
+    while (received < size) {
+        const uint32_t head = half->head.load(std::memory_order_acquire);
+        const uint32_t tail = half->tail.load(std::memory_order_relaxed);
+        const uint32_t available = head - tail;
+
+        if (available == 0) {
+            if (!waitOnCounter(&half->head, &half->head_waiters, head))
+                return received;
+            continue;
+        }
+
+        uint32_t chunk = (size - received) < available ? (size - received) : available;
+
+        const uint32_t index = tail & (RING_CAPACITY - 1);
+        const uint32_t contiguous = RING_CAPACITY - index;
+        if (chunk <= contiguous) {
+            memcpy(data + received, half->buffer + index, chunk);
+        }
+        else {
+            memcpy(data + received, half->buffer + index, contiguous);
+            memcpy(data + received + contiguous, half->buffer, chunk - contiguous);
+        }
+
+        half->tail.store(tail + chunk, std::memory_order_release);
+        wakeCounter(&half->tail, &half->tail_waiters);
+
+        received += chunk;
+    }
+
+    return received;
+}
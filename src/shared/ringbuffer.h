@@ -0,0 +1,76 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_RINGBUFFER_H_INCL
+#define LIBTAS_RINGBUFFER_H_INCL
+
+#include <cstddef>
+
+/* Shared-memory transport between the program and the game, made of one
+ * ring buffer per direction. The frame boundary exchanges many small
+ * messages, and going through the socket costs two syscalls per message,
+ * which dominates the boundary at high fast-forward rates. Each ring is
+ * written by one side and read by the other, so a message is a plain
+ * memcpy guarded by a pair of atomic counters. A side that finds the ring
+ * empty (or full) spins briefly, then sleeps on a futex; the other side
+ * only issues the wake syscall when someone declared itself asleep, so
+ * the steady state where both sides keep up runs without any syscall.
+ *
+ * The region must stay out of savestates: loading a state while the ring
+ * counters roll back would desync both sides. Checkpoint::skipArea()
+ * recognizes the region by its file name.
+ */
+
+/* Create the shared region. Called by the game before listening on the
+ * socket, so the program cannot connect before the region exists.
+ * Returns false if the region could not be created, in which case both
+ * sides keep using the socket. */
+bool initRingGame(void);
+
+/* Map the region created by the game. Called by the program after the
+ * socket connection succeeded. Returns false if the region could not be
+ * mapped. */
+bool initRingProgram(void);
+
+/* Set the socket used to detect that the other side died, so a blocked
+ * read does not sleep forever on a futex no one will wake. */
+void setRingPeerSocket(int fd);
+
+/* Unmap the region */
+void closeRing(void);
+
+/* Remove a stale region from a previous run */
+void removeRing(void);
+
+/* Check if the shared region is usable */
+bool isRingConnected(void);
+
+/* Send data through the ring, blocking while it is full. Messages larger
+ * than the ring are streamed through it in chunks. */
+void ringSend(const void* elem, size_t size);
+
+/* Receive data from the ring, blocking while it is empty. Follows the
+ * recv() convention: returns the number of bytes read, or 0 when the
+ * other side is gone. */
+int ringReceive(void* elem, size_t size);
+
+/* Number of bytes that can be received without blocking */
+size_t ringBytesAvailable(void);
+
+#endif
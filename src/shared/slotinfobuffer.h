@@ -0,0 +1,81 @@
+/*
+    Copyright 2015-2018 Clément Gallet <clement.gallet@ens-lyon.org>
+
+    This file is part of libTAS.
+
+    libTAS is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    libTAS is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with libTAS.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBTAS_SLOTINFOBUFFER_H_INCLUDED
+#define LIBTAS_SLOTINFOBUFFER_H_INCLUDED
+
+#include <stdint.h>
+
+/* Layout of the shared-memory savestate slot information buffer.
+ *
+ * Each time the game saves a state into one of the numbered slots, the
+ * library writes the frame count, the game time, the wall-clock time and a
+ * downscaled thumbnail of the saved frame into this buffer, which lives in
+ * an anonymous sealed memfd passed to the program over the socket (see
+ * sendFd()). The program maps it read-only and can show what every slot
+ * holds without any disk I/O or message on the socket.
+ *
+ * Each entry carries a sequence number that is odd while the entry is
+ * being written, so a reader copies the entry and retries later if the
+ * sequence number was odd or changed during the copy. */
+
+#define SLOTINFO_MAGIC "LTSI"
+#define SLOTINFO_VERSION 1
+
+/* The numbered savestate slots, including the backtrack slot */
+#define SLOTINFO_SLOTS 11
+
+/* Thumbnails are downscaled by an integer factor until they fit */
+#define SLOTINFO_MAXWIDTH 214
+#define SLOTINFO_MAXHEIGHT 120
+
+struct SlotInfoEntry {
+    /* Incremented before and after the entry is written, odd while the
+     * content is inconsistent */
+    uint32_t seq;
+
+    /* Zero until a state was saved into the slot */
+    uint32_t valid;
+
+    /* Frame of the game at which the state was saved */
+    uint64_t framecount;
+
+    /* Game time at which the state was saved */
+    uint64_t game_time_sec;
+    uint32_t game_time_nsec;
+
+    /* Wall-clock time of the save, seconds since the epoch */
+    uint64_t save_time;
+
+    /* Dimensions of the thumbnail */
+    int32_t width;
+    int32_t height;
+
+    /* Downscaled saved frame, stored as rows of 0xffRRGGBB pixels */
+    uint32_t pixels[SLOTINFO_MAXWIDTH * SLOTINFO_MAXHEIGHT];
+};
+
+struct SlotInfoBuffer {
+    char magic[4];
+    uint32_t version;
+
+    struct SlotInfoEntry entries[SLOTINFO_SLOTS];
+};
+
+#endif
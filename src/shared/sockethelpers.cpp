@@ -18,6 +18,7 @@
  */
 
 #include "sockethelpers.h"
+#include "ringbuffer.h"
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <cstdlib>
@@ -25,19 +26,59 @@
 #include <sys/un.h>
 #include <iostream>
 #include <vector>
-
-#define SOCKET_FILENAME "/tmp/libTAS.socket"
+#include <cstring>
+#include <cstdint>
+#include <cstdio>
 
 /* Socket to communicate between the program and the game */
 static int socket_fd = 0;
 
+/* Path of the socket file, suffixed with the instance id when several
+ * program/game pairs run concurrently (segmented dumping). The program
+ * sets LIBTAS_INSTANCE before launching the game, so both sides and the
+ * shared memory ring agree on the same id. */
+static const char* socketPath(void)
+{
+    static char path[64] = {0};
+    if (!path[0]) {
+        const char* instance = getenv("LIBTAS_INSTANCE");
+        if (instance && instance[0])
+            snprintf(path, sizeof(path), "/tmp/libTAS-%s.socket", instance);
+        else
+            snprintf(path, sizeof(path), "/tmp/libTAS.socket");
+    }
+    return path;
+}
+
+/* Build the socket address from the runtime socket path */
+static struct sockaddr_un socketAddr(void)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socketPath(), sizeof(addr.sun_path)-1);
+    return addr;
+}
+
+/* Sends batched between beginSendBatch() and endSendBatch(), pushed to the
+ * socket with a single send() call */
+static std::vector<uint8_t> send_batch;
+static bool send_batching = false;
+
+/* Bytes already pulled from the socket but not consumed yet. Refilled with
+ * one large recv() instead of one recv() per message field */
+static uint8_t recv_buffer[4096];
+static size_t recv_buffer_start = 0;
+static size_t recv_buffer_size = 0;
+
 void removeSocket(void){
-    unlink(SOCKET_FILENAME);
+    unlink(socketPath());
+    removeRing();
 }
 
 bool initSocketProgram(void)
 {
-    const struct sockaddr_un addr = { AF_UNIX, SOCKET_FILENAME };
+    const struct sockaddr_un addr = socketAddr();
     socket_fd = socket(AF_UNIX, SOCK_STREAM, 0);
 
     struct timespec tim = {0, 500L*1000L*1000L};
@@ -58,6 +99,11 @@ bool initSocketProgram(void)
     }
     std::cout << "Attempt " << retry + 1 << ": Connected." << std::endl;
 
+    /* The game created the shared ring before listening on the socket, so
+     * it must exist by now. If mapping it fails, we keep the socket. */
+    if (initRingProgram())
+        setRingPeerSocket(socket_fd);
+
     return true;
 }
 
@@ -68,11 +114,11 @@ bool initSocketGame(void)
      * In this case, we just return immediately.
      */
     struct stat st;
-    int result = stat(SOCKET_FILENAME, &st);
+    int result = stat(socketPath(), &st);
     if (result == 0)
         return false;
 
-    const struct sockaddr_un addr = { AF_UNIX, SOCKET_FILENAME };
+    const struct sockaddr_un addr = socketAddr();
     const int tmp_fd = socket(AF_UNIX, SOCK_STREAM, 0);
     if (bind(tmp_fd, reinterpret_cast<const struct sockaddr*>(&addr), sizeof(struct sockaddr_un)))
     {
@@ -80,6 +126,10 @@ bool initSocketGame(void)
         exit(-1);
     }
 
+    /* Create the shared ring before listening, so the program can map it
+     * as soon as its connection succeeds */
+    const bool ring = initRingGame();
+
     if (listen(tmp_fd, 1))
     {
         std::cerr << "Couldn't listen on client socket." << std::endl;
@@ -93,17 +143,54 @@ bool initSocketGame(void)
     }
 
     close(tmp_fd);
+
+    if (ring)
+        setRingPeerSocket(socket_fd);
+
     return true;
 }
 
 void closeSocket(void)
 {
+    closeRing();
     close(socket_fd);
 }
 
+void beginSendBatch(void)
+{
+    /* The ring is already a single memcpy per message, batching on top of
+     * it would only add another copy */
+    if (isRingConnected())
+        return;
+    send_batching = true;
+}
+
+void endSendBatch(void)
+{
+    if (!send_batching)
+        return;
+    send_batching = false;
+
+    size_t sent = 0;
+    while (sent < send_batch.size()) {
+        ssize_t ret = send(socket_fd, send_batch.data() + sent, send_batch.size() - sent, 0);
+        if (ret <= 0)
+            break;
+        sent += ret;
+    }
+    send_batch.clear();
+}
+
 void sendData(const void* elem, size_t size)
 {
-    send(socket_fd, elem, size, 0);
+    if (send_batching) {
+        const uint8_t* data = static_cast<const uint8_t*>(elem);
+        send_batch.insert(send_batch.end(), data, data + size);
+    }
+    else if (isRingConnected())
+        ringSend(elem, size);
+    else
+        send(socket_fd, elem, size, 0);
 }
 
 void sendMessage(int message)
@@ -120,7 +207,32 @@ void sendString(const std::string& str)
 
 int receiveData(void* elem, size_t size)
 {
-    return recv(socket_fd, elem, size, 0);
+    if (isRingConnected())
+        return ringReceive(elem, size);
+
+    uint8_t* data = static_cast<uint8_t*>(elem);
+    size_t received = 0;
+
+    while (received < size) {
+        if (recv_buffer_size == 0) {
+            const ssize_t ret = recv(socket_fd, recv_buffer, sizeof(recv_buffer), 0);
+            if (ret <= 0)
+                return received > 0 ? received : ret;
+            recv_buffer_start = 0;
+            recv_buffer_size = ret;
+        }
+
+        size_t chunk = size - received;
+        if (chunk > recv_buffer_size)
+            chunk = recv_buffer_size;
+
+        memcpy(data + received, recv_buffer + recv_buffer_start, chunk);
+        recv_buffer_start += chunk;
+        recv_buffer_size -= chunk;
+        received += chunk;
+    }
+
+    return received;
 }
 
 int receiveMessage()
@@ -132,6 +244,87 @@ int receiveMessage()
     return msg;
 }
 
+int pollMessage()
+{
+    if (isRingConnected()) {
+        if (ringBytesAvailable() < sizeof(int))
+            return -1;
+        return receiveMessage();
+    }
+
+    /* Top up the buffered bytes without blocking. A partial message id
+     * stays in the buffer until the next call. */
+    if (recv_buffer_size < sizeof(int)) {
+        if (recv_buffer_start > 0) {
+            memmove(recv_buffer, recv_buffer + recv_buffer_start, recv_buffer_size);
+            recv_buffer_start = 0;
+        }
+        const ssize_t ret = recv(socket_fd, recv_buffer + recv_buffer_size,
+            sizeof(recv_buffer) - recv_buffer_size, MSG_DONTWAIT);
+        if (ret > 0)
+            recv_buffer_size += ret;
+    }
+
+    if (recv_buffer_size < sizeof(int))
+        return -1;
+
+    return receiveMessage();
+}
+
+void sendFd(int fd)
+{
+    /* One byte of regular data carries the ancillary message, as ancillary
+     * data cannot be sent alone on a stream socket */
+    uint8_t byte = 0;
+    struct iovec iov;
+    iov.iov_base = &byte;
+    iov.iov_len = 1;
+
+    char ctrl[CMSG_SPACE(sizeof(int))] = {};
+    struct msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl;
+    msg.msg_controllen = sizeof(ctrl);
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+    sendmsg(socket_fd, &msg, 0);
+}
+
+int receiveFd()
+{
+    uint8_t byte;
+    struct iovec iov;
+    iov.iov_base = &byte;
+    iov.iov_len = 1;
+
+    char ctrl[CMSG_SPACE(sizeof(int))];
+    struct msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl;
+    msg.msg_controllen = sizeof(ctrl);
+
+    /* The kernel never merges the carrier byte with preceding stream data,
+     * so this read starts exactly at the ancillary message */
+    const ssize_t ret = recvmsg(socket_fd, &msg, 0);
+    if (ret <= 0)
+        return -1;
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    if (!cmsg || (cmsg->cmsg_level != SOL_SOCKET) || (cmsg->cmsg_type != SCM_RIGHTS))
+        return -1;
+
+    int fd;
+    memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+    return fd;
+}
+
 std::string receiveString()
 {
     size_t str_size;
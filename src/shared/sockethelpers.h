@@ -35,6 +35,13 @@ bool initSocketGame(void);
 /* Close the socket connection */
 void closeSocket(void);
 
+/* Gather every send until the matching endSendBatch() into one buffer,
+ * pushed to the socket with a single send() call. Used around the bursts
+ * of small messages at the frame boundary, so they cost one syscall
+ * instead of one per field. Must not span a receive. */
+void beginSendBatch(void);
+void endSendBatch(void);
+
 /* Send data over the socket. Data is stored at the beginning of
  * pointer elem, and has the specified size in bytes.
  */
@@ -54,6 +61,22 @@ int receiveData(void* elem, size_t size);
 /* Receive a message */
 int receiveMessage();
 
+/* Check without blocking whether a full message id arrived, and consume
+ * and return it, or return -1 when nothing (or only part of an id) is
+ * there yet. The caller must know that the next bytes of the stream, if
+ * any, are a message id. */
+int pollMessage();
+
+/* Pass an open file descriptor to the peer (SCM_RIGHTS), attached to one
+ * byte of regular data. The descriptor always travels on the stream
+ * socket, even when the shared ring carries the data messages, so the
+ * peer must consume it with a matching receiveFd() before asking for
+ * anything else on the stream. Must not be called inside a send batch. */
+void sendFd(int fd);
+
+/* Receive a file descriptor passed by the peer, or -1 on failure */
+int receiveFd();
+
 /* Receive a string object from the socket. */
 std::string receiveString();
 
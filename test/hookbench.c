@@ -0,0 +1,95 @@
+// Per-call overhead benchmark for the hooked wrappers.
+//
+// Run it twice and diff the numbers:
+//     ./hookbench
+//     LD_PRELOAD=path/to/libtas.so ./hookbench
+//
+// Output is one CSV line per operation:
+//     op,iterations,total_ns,ns_per_call
+//
+// Timing uses the raw clock_gettime syscall so that the measurement
+// itself does not go through the libtas clock wrappers, which return
+// deterministic fake time when the library is preloaded.
+//
+// glDrawArrays and the other GL wrappers need a live GL context, so they
+// are not measured by this standalone binary.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#define ITERATIONS 1000000
+
+static long long raw_now_ns(void)
+{
+    struct timespec ts;
+    syscall(SYS_clock_gettime, CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void report(const char *op, long long total_ns)
+{
+    printf("%s,%d,%lld,%.1f\n", op, ITERATIONS, total_ns,
+           (double)total_ns / ITERATIONS);
+}
+
+// Sink keeping the compiler from discarding the benchmarked calls
+static volatile long long sink;
+
+static void bench_clock_gettime(void)
+{
+    struct timespec ts;
+    long long start = raw_now_ns();
+    for (int i = 0; i < ITERATIONS; i++) {
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        sink += ts.tv_nsec;
+    }
+    report("clock_gettime", raw_now_ns() - start);
+}
+
+static void bench_gettimeofday(void)
+{
+    struct timeval tv;
+    long long start = raw_now_ns();
+    for (int i = 0; i < ITERATIONS; i++) {
+        gettimeofday(&tv, NULL);
+        sink += tv.tv_usec;
+    }
+    report("gettimeofday", raw_now_ns() - start);
+}
+
+static void bench_malloc_free(void)
+{
+    long long start = raw_now_ns();
+    for (int i = 0; i < ITERATIONS; i++) {
+        void *p = malloc(64);
+        sink += (long long)p;
+        free(p);
+    }
+    report("malloc_free_64", raw_now_ns() - start);
+}
+
+static void bench_mutex_lock_unlock(void)
+{
+    pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+    long long start = raw_now_ns();
+    for (int i = 0; i < ITERATIONS; i++) {
+        pthread_mutex_lock(&mutex);
+        pthread_mutex_unlock(&mutex);
+    }
+    report("mutex_lock_unlock", raw_now_ns() - start);
+}
+
+int main()
+{
+    printf("op,iterations,total_ns,ns_per_call\n");
+    bench_clock_gettime();
+    bench_gettimeofday();
+    bench_malloc_free();
+    bench_mutex_lock_unlock();
+    return 0;
+}
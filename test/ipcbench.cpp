@@ -0,0 +1,136 @@
+// Round-trip benchmark for the program<->game socket protocol.
+//
+// Forks into a program half and a game half wired up with the real
+// sockethelpers/ringbuffer code, then replays a synthetic frame boundary
+// at max speed: the program sends a batched input message, the game
+// answers with a time message, and one round trip is complete when the
+// answer is read. The exchange sizes mirror the real frame boundary
+// (a message id pair around an AllInputs-sized payload one way, a
+// timespec-sized payload the other way).
+//
+// Both transports are measured: the shared-memory ring, then the plain
+// socket with the ring disabled through LIBTAS_DISABLE_RING.
+//
+// Output is one CSV line per transport:
+//     transport,roundtrips,rt_per_sec,p50_ns,p90_ns,p99_ns,max_ns
+
+#include "../src/shared/sockethelpers.h"
+#include "../src/shared/messages.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define ROUNDTRIPS 100000
+
+/* Matches the size of AllInputs on the wire */
+#define INPUT_SIZE 136
+
+static long long now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* Game half: answer each input message with a time message */
+static void runGame(void)
+{
+    if (!initSocketGame())
+        _exit(1);
+
+    char input[INPUT_SIZE];
+    struct timespec fake_time = {0, 0};
+
+    for (int i = 0; i < ROUNDTRIPS; i++) {
+        receiveMessage();
+        receiveData(input, sizeof(input));
+        receiveMessage();
+
+        sendMessage(MSGB_START_FRAMEBOUNDARY);
+        sendData(&fake_time, sizeof(fake_time));
+        sendMessage(MSGB_START_FRAMEBOUNDARY);
+    }
+
+    closeSocket();
+    _exit(0);
+}
+
+/* Program half: drive the exchange and time each round trip */
+static void runProgram(const char* transport)
+{
+    if (!initSocketProgram()) {
+        fprintf(stderr, "could not connect to the game half\n");
+        exit(1);
+    }
+
+    char input[INPUT_SIZE] = {};
+    struct timespec fake_time;
+    std::vector<long long> latencies(ROUNDTRIPS);
+
+    for (int i = 0; i < ROUNDTRIPS; i++) {
+        const long long start = now_ns();
+
+        beginSendBatch();
+        sendMessage(MSGN_ALL_INPUTS);
+        sendData(input, sizeof(input));
+        sendMessage(MSGN_END_FRAMEBOUNDARY);
+        endSendBatch();
+
+        receiveMessage();
+        receiveData(&fake_time, sizeof(fake_time));
+        receiveMessage();
+
+        latencies[i] = now_ns() - start;
+    }
+
+    closeSocket();
+
+    std::sort(latencies.begin(), latencies.end());
+    long long total = 0;
+    for (long long l : latencies)
+        total += l;
+
+    printf("%s,%d,%.0f,%lld,%lld,%lld,%lld\n", transport, ROUNDTRIPS,
+           ROUNDTRIPS / (total / 1e9),
+           latencies[ROUNDTRIPS/2],
+           latencies[(ROUNDTRIPS*90)/100],
+           latencies[(ROUNDTRIPS*99)/100],
+           latencies[ROUNDTRIPS-1]);
+}
+
+static void runOnce(const char* transport)
+{
+    removeSocket();
+
+    pid_t pid = fork();
+    if (pid == 0)
+        runGame();
+
+    runProgram(transport);
+
+    int status;
+    waitpid(pid, &status, 0);
+    removeSocket();
+}
+
+int main()
+{
+    /* Do not collide with a real libTAS session */
+    char instance[32];
+    snprintf(instance, sizeof(instance), "bench%d", getpid());
+    setenv("LIBTAS_INSTANCE", instance, 1);
+
+    printf("transport,roundtrips,rt_per_sec,p50_ns,p90_ns,p99_ns,max_ns\n");
+
+    runOnce("ring");
+
+    setenv("LIBTAS_DISABLE_RING", "1", 1);
+    runOnce("socket");
+
+    return 0;
+}
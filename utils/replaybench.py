@@ -0,0 +1,109 @@
+#!/usr/bin/env python
+# Replays reference movies through libTAS-cli and appends throughput
+# numbers to a JSON-lines trend file, one record per run. Meant for a
+# nightly cron on a machine holding the reference games, so commits that
+# slow the replay path show up as numbers.
+#
+# Usage: ./replaybench.py manifest.json [trend.jsonl]
+#
+# The manifest lists the benchmarks:
+# {
+#   "cli": "/path/to/libTAS-cli",
+#   "benchmarks": [
+#     {"name": "Celeste_any",
+#      "game": "/path/to/Celeste.bin.x86_64",
+#      "movie": "../movies/Celeste_any.ltm",
+#      "args": []}
+#   ]
+# }
+#
+# Each record holds the frames replayed, wall seconds, frames/second,
+# peak RSS of the game+cli pair, and the exit status, plus the git
+# revision of the libTAS checkout when available.
+
+import json
+import os
+import re
+import resource
+import subprocess
+import sys
+import time
+
+regex_result = re.compile(
+    r'verification: replayed (\d+) of (\d+) movie frames, game time ([\d.]+)')
+
+def git_revision():
+    try:
+        return subprocess.check_output(
+            ['git', 'rev-parse', 'HEAD'],
+            cwd=os.path.dirname(os.path.abspath(__file__)),
+            stderr=subprocess.STDOUT).strip().decode()
+    except Exception:
+        return None
+
+def run_benchmark(cli, bench, instance):
+    cmd = [cli, '-r', bench['movie'], '-i', str(instance), bench['game']]
+    cmd += bench.get('args', [])
+
+    start = time.time()
+    proc = subprocess.Popen(cmd, stdout=subprocess.PIPE,
+                            stderr=subprocess.PIPE)
+    out, err = proc.communicate()
+    wall = time.time() - start
+
+    # Peak RSS of the waited-for children (cli and game), in kilobytes
+    rss_kb = resource.getrusage(resource.RUSAGE_CHILDREN).ru_maxrss
+
+    result = {
+        'name': bench['name'],
+        'status': proc.returncode,
+        'wall_seconds': round(wall, 3),
+        'peak_rss_kb': rss_kb,
+    }
+
+    match = regex_result.search(out.decode(errors='replace'))
+    if match:
+        frames = int(match.group(1))
+        result['frames'] = frames
+        result['movie_frames'] = int(match.group(2))
+        result['game_time'] = match.group(3)
+        result['fps'] = round(frames / wall, 1) if wall > 0 else None
+    else:
+        result['error'] = err.decode(errors='replace')[-500:]
+
+    return result
+
+def main():
+    if len(sys.argv) < 2:
+        sys.stderr.write(__doc__ or 'usage: replaybench.py manifest.json [trend.jsonl]\n')
+        return 1
+
+    with open(sys.argv[1]) as f:
+        manifest = json.load(f)
+
+    trend_path = sys.argv[2] if len(sys.argv) > 2 else 'replaybench-trend.jsonl'
+
+    record = {
+        'timestamp': time.strftime('%Y-%m-%dT%H:%M:%S'),
+        'revision': git_revision(),
+        'results': [],
+    }
+
+    cli = manifest['cli']
+    for i, bench in enumerate(manifest['benchmarks']):
+        sys.stderr.write('replaying %s...\n' % bench['name'])
+        record['results'].append(run_benchmark(cli, bench, 'bench%d' % i))
+
+    with open(trend_path, 'a') as f:
+        f.write(json.dumps(record) + '\n')
+
+    print(json.dumps(record, indent=2))
+
+    failed = [r['name'] for r in record['results'] if r['status'] != 0]
+    if failed:
+        sys.stderr.write('failed: %s\n' % ', '.join(failed))
+        return 1
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main())